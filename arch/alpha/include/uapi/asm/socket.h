@@ -115,4 +115,6 @@
 #define SO_TXTIME		61
 #define SCM_TXTIME		SO_TXTIME
 
+#define SCM_ZEROCOPY_NOTIF	62
+
 #endif /* _UAPI_ASM_SOCKET_H */
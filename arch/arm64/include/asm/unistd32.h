@@ -819,6 +819,12 @@ __SYSCALL(__NR_pkey_free, sys_pkey_free)
 __SYSCALL(__NR_statx, sys_statx)
 #define __NR_rseq 398
 __SYSCALL(__NR_rseq, sys_rseq)
+#define __NR_io_setup2 399
+__SYSCALL(__NR_io_setup2, sys_io_setup2)
+#define __NR_io_ring_enter 400
+__SYSCALL(__NR_io_ring_enter, sys_io_ring_enter)
+#define __NR_process_madvise 401
+__SYSCALL(__NR_process_madvise, compat_sys_process_madvise)
 
 /*
  * Please add new compat syscalls above this comment and update
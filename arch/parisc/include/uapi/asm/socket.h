@@ -107,4 +107,6 @@
 #define SO_TXTIME		0x4036
 #define SCM_TXTIME		SO_TXTIME
 
+#define SCM_ZEROCOPY_NOTIF	0x4037
+
 #endif /* _UAPI_ASM_SOCKET_H */
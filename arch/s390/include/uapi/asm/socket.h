@@ -114,4 +114,6 @@
 #define SO_TXTIME		61
 #define SCM_TXTIME		SO_TXTIME
 
+#define SCM_ZEROCOPY_NOTIF	62
+
 #endif /* _ASM_SOCKET_H */
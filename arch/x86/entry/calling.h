@@ -212,6 +212,9 @@ For 32-bit we have the following conventions - kernel is built with
 .macro SWITCH_TO_KERNEL_CR3 scratch_reg:req
 	ALTERNATIVE "jmp .Lend_\@", "", X86_FEATURE_PTI
 	mov	%cr3, \scratch_reg
+	/* Tasks without isolation enter on the kernel page tables */
+	bt	$PTI_USER_PGTABLE_BIT, \scratch_reg
+	jnc	.Lend_\@
 	ADJUST_KERNEL_CR3 \scratch_reg
 	mov	\scratch_reg, %cr3
 .Lend_\@:
@@ -220,8 +223,14 @@ For 32-bit we have the following conventions - kernel is built with
 #define THIS_CPU_user_pcid_flush_mask   \
 	PER_CPU_VAR(cpu_tlbstate) + TLB_STATE_user_pcid_flush_mask
 
+#define THIS_CPU_user_pti_disabled   \
+	PER_CPU_VAR(cpu_tlbstate) + TLB_STATE_user_pti_disabled
+
 .macro SWITCH_TO_USER_CR3_NOSTACK scratch_reg:req scratch_reg2:req
 	ALTERNATIVE "jmp .Lend_\@", "", X86_FEATURE_PTI
+	/* The mm opted out of isolation, stay on the kernel page tables */
+	cmpb	$0, THIS_CPU_user_pti_disabled
+	jne	.Lend_\@
 	mov	%cr3, \scratch_reg
 
 	ALTERNATIVE "jmp .Lwrcr3_\@", "", X86_FEATURE_PCID
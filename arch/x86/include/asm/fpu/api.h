@@ -20,12 +20,18 @@
  *
  * All other cases use kernel_fpu_begin/end() which disable preemption
  * during kernel FPU usage.
+ *
+ * The user FPU registers are saved by the first kernel_fpu_begin() after
+ * entering the kernel and are only loaded back on the way out to user
+ * space (TIF_NEED_FPU_LOAD), so back to back kernel FPU sections only pay
+ * for one save and one restore.
  */
 extern void __kernel_fpu_begin(void);
 extern void __kernel_fpu_end(void);
 extern void kernel_fpu_begin(void);
 extern void kernel_fpu_end(void);
 extern bool irq_fpu_usable(void);
+extern void switch_fpu_return(void);
 
 /*
  * Query the presence of one or more xfeatures. Works on any legacy CPU as well.
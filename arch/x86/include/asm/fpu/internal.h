@@ -11,6 +11,7 @@
 #ifndef _ASM_X86_FPU_INTERNAL_H
 #define _ASM_X86_FPU_INTERNAL_H
 
+#include <linux/bottom_half.h>
 #include <linux/compat.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
@@ -514,6 +515,37 @@ static inline void fpregs_activate(struct fpu *fpu)
 	trace_x86_fpu_regs_activated(fpu);
 }
 
+/*
+ * The current task's registers have just been loaded: they are live
+ * and there is nothing left to load on the way out to user space.
+ */
+static inline void fpregs_mark_activate(void)
+{
+	struct fpu *fpu = &current->thread.fpu;
+
+	fpregs_activate(fpu);
+	fpu->last_cpu = smp_processor_id();
+	clear_thread_flag(TIF_NEED_FPU_LOAD);
+}
+
+/*
+ * Use fpregs_lock() while relying on the current task's registers being
+ * live. A context switch will, and a softirq might, save them to
+ * fpu->state and set TIF_NEED_FPU_LOAD, leaving the registers in a
+ * random state.
+ */
+static inline void fpregs_lock(void)
+{
+	preempt_disable();
+	local_bh_disable();
+}
+
+static inline void fpregs_unlock(void)
+{
+	local_bh_enable();
+	preempt_enable();
+}
+
 /*
  * FPU state switching for scheduling.
  *
@@ -529,7 +561,9 @@ static inline void
 switch_fpu_prepare(struct fpu *old_fpu, int cpu)
 {
 	if (static_cpu_has(X86_FEATURE_FPU) && old_fpu->initialized) {
-		if (!copy_fpregs_to_fpstate(old_fpu))
+		/* With TIF_NEED_FPU_LOAD set, fpu->state is already current */
+		if (test_thread_flag(TIF_NEED_FPU_LOAD) ||
+		    !copy_fpregs_to_fpstate(old_fpu))
 			old_fpu->last_cpu = -1;
 		else
 			old_fpu->last_cpu = cpu;
@@ -554,9 +588,13 @@ static inline void switch_fpu_finish(struct fpu *new_fpu, int cpu)
 		       new_fpu->initialized;
 
 	if (preload) {
+		struct task_struct *next = container_of(new_fpu,
+						struct task_struct, thread.fpu);
+
 		if (!fpregs_state_valid(new_fpu, cpu))
 			copy_kernel_to_fpregs(&new_fpu->state);
 		fpregs_activate(new_fpu);
+		clear_tsk_thread_flag(next, TIF_NEED_FPU_LOAD);
 	}
 }
 
@@ -574,6 +612,7 @@ static inline void user_fpu_begin(void)
 
 	preempt_disable();
 	fpregs_activate(fpu);
+	clear_thread_flag(TIF_NEED_FPU_LOAD);
 	preempt_enable();
 }
 
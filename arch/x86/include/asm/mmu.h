@@ -42,6 +42,15 @@ typedef struct {
 	const struct vdso_image *vdso_image;	/* vdso image in use */
 
 	atomic_t perf_rdpmc_allowed;	/* nonzero if rdpmc is allowed */
+#ifdef CONFIG_PAGE_TABLE_ISOLATION
+	/*
+	 * Set by ARCH_SET_NOPTI: user mode runs on the kernel page tables,
+	 * where the user mappings are not made NX. Never cleared, inherited
+	 * by fork, reset by exec.
+	 */
+	bool pti_user_exec;
+	bool pti_disabled;
+#endif
 #ifdef CONFIG_X86_INTEL_MEMORY_PROTECTION_KEYS
 	/*
 	 * One bit per protection key says whether userspace can
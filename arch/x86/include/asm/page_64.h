@@ -54,6 +54,9 @@ static inline void clear_page(void *page)
 			   : "cc", "memory", "rax", "rcx");
 }
 
+#define __HAVE_ARCH_CLEAR_PAGE_NOCACHE
+void clear_page_nocache(void *page);
+
 void copy_page(void *to, void *from);
 
 #endif	/* !__ASSEMBLY__ */
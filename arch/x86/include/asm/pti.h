@@ -3,12 +3,18 @@
 #define _ASM_X86_PTI_H
 #ifndef __ASSEMBLY__
 
+struct mm_struct;
+
 #ifdef CONFIG_PAGE_TABLE_ISOLATION
 extern void pti_init(void);
 extern void pti_check_boottime_disable(void);
 extern void pti_finalize(void);
+extern long pti_get_mm_disabled(struct mm_struct *mm);
+extern long pti_disable_mm(struct mm_struct *mm);
 #else
 static inline void pti_check_boottime_disable(void) { }
+static inline long pti_get_mm_disabled(struct mm_struct *mm) { return 1; }
+static inline long pti_disable_mm(struct mm_struct *mm) { return 0; }
 #endif
 
 #endif /* __ASSEMBLY__ */
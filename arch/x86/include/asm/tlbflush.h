@@ -27,14 +27,15 @@
  * We end up with different spaces for different things. To avoid confusion we
  * use different names for each of them:
  *
- * ASID  - [0, TLB_NR_DYN_ASIDS-1]
- *         the canonical identifier for an mm
+ * ASID  - [0, tlb_nr_dyn_asids-1], at most TLB_NR_DYN_ASIDS_MAX-1
+ *         the canonical identifier for an mm; tlb_nr_dyn_asids defaults
+ *         to TLB_NR_DYN_ASIDS and is set with tlb_asids=
  *
- * kPCID - [1, TLB_NR_DYN_ASIDS]
+ * kPCID - [1, tlb_nr_dyn_asids]
  *         the value we write into the PCID part of CR3; corresponds to the
  *         ASID+1, because PCID 0 is special.
  *
- * uPCID - [2048 + 1, 2048 + TLB_NR_DYN_ASIDS]
+ * uPCID - [2048 + 1, 2048 + tlb_nr_dyn_asids]
  *         for KPTI each mm has two address spaces and thus needs two
  *         PCID values, but we can still do with a single ASID denomination
  *         for each mm. Corresponds to kPCID + 2048.
@@ -64,10 +65,14 @@
 #define MAX_ASID_AVAILABLE ((1 << CR3_AVAIL_PCID_BITS) - 2)
 
 /*
- * 6 because 6 should be plenty and struct tlb_state will fit in two cache
- * lines.
+ * 6 ASIDs per cpu by default, which should be plenty.  Hosts switching
+ * between many more processes per cpu can keep up to TLB_NR_DYN_ASIDS_MAX
+ * with the tlb_asids= boot option.  ctxs[] in struct tlb_state is sized
+ * for the maximum, 512 bytes, so the state spans about ten cache lines
+ * whatever the option; only the slots in use are touched on a switch.
  */
 #define TLB_NR_DYN_ASIDS	6
+#define TLB_NR_DYN_ASIDS_MAX	32
 
 /*
  * Given @asid, compute kPCID
@@ -81,7 +86,7 @@ static inline u16 kern_pcid(u16 asid)
 	 * Make sure that the dynamic ASID space does not confict with the
 	 * bit we are using to switch between user and kernel ASIDs.
 	 */
-	BUILD_BUG_ON(TLB_NR_DYN_ASIDS >= (1 << X86_CR3_PTI_PCID_USER_BIT));
+	BUILD_BUG_ON(TLB_NR_DYN_ASIDS_MAX >= (1 << X86_CR3_PTI_PCID_USER_BIT));
 
 	/*
 	 * The ASID being passed in here should have respected the
@@ -207,11 +212,18 @@ struct tlb_state {
 	bool invalidate_other;
 
 	/*
-	 * Mask that contains TLB_NR_DYN_ASIDS+1 bits to indicate
+	 * Mask that contains TLB_NR_DYN_ASIDS_MAX+1 bits to indicate
 	 * the corresponding user PCID needs a flush next time we
 	 * switch to it; see SWITCH_TO_USER_CR3.
 	 */
-	unsigned short user_pcid_flush_mask;
+	unsigned long user_pcid_flush_mask;
+
+	/*
+	 * The loaded mm opted out of page table isolation, the entry code
+	 * leaves the kernel page tables in place when returning to user
+	 * mode; see SWITCH_TO_USER_CR3.
+	 */
+	bool user_pti_disabled;
 
 	/*
 	 * Access to this CR4 shadow and to H/W CR4 is protected by
@@ -221,8 +233,9 @@ struct tlb_state {
 
 	/*
 	 * This is a list of all contexts that might exist in the TLB.
-	 * There is one per ASID that we use, and the ASID (what the
-	 * CPU calls PCID) is the index into ctxts.
+	 * There is one slot per possible ASID, of which only the first
+	 * tlb_nr_dyn_asids are used, and the ASID (what the CPU calls
+	 * PCID) is the index into ctxts.
 	 *
 	 * For each context, ctx_id indicates which mm the TLB's user
 	 * entries came from.  As an invariant, the TLB will never
@@ -238,7 +251,7 @@ struct tlb_state {
 	 * isn't aware of PCID will end up harmlessly flushing
 	 * context 0.
 	 */
-	struct tlb_context ctxs[TLB_NR_DYN_ASIDS];
+	struct tlb_context ctxs[TLB_NR_DYN_ASIDS_MAX];
 };
 DECLARE_PER_CPU_SHARED_ALIGNED(struct tlb_state, cpu_tlbstate);
 
@@ -375,7 +388,7 @@ static inline void invalidate_user_asid(u16 asid)
 		return;
 
 	__set_bit(kern_pcid(asid),
-		  (unsigned long *)this_cpu_ptr(&cpu_tlbstate.user_pcid_flush_mask));
+		  this_cpu_ptr(&cpu_tlbstate.user_pcid_flush_mask));
 }
 
 /*
@@ -60,4 +60,11 @@ __copy_from_user_inatomic_nocache(void *to, const void __user *from,
        return __copy_from_user_ll_nocache_nozero(to, from, n);
 }
 
+static __always_inline unsigned long
+__copy_to_user_inatomic_nocache(void __user *to, const void *from,
+				unsigned long n)
+{
+	return __copy_user_ll((__force void *)to, from, n);
+}
+
 #endif /* _ASM_X86_UACCESS_32_H */
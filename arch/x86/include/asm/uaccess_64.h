@@ -200,6 +200,19 @@ __copy_from_user_inatomic_nocache(void *dst, const void __user *src,
 	return __copy_user_nocache(dst, src, size, 0);
 }
 
+/*
+ * __copy_user_nocache() takes faults on either side, so it serves
+ * copies to user space as well.
+ */
+static inline int
+__copy_to_user_inatomic_nocache(void __user *dst, const void *src,
+				unsigned size)
+{
+	kasan_check_read(src, size);
+	return __copy_user_nocache((__force void *)dst,
+				   (__force const void __user *)src, size, 0);
+}
+
 static inline int
 __copy_from_user_flushcache(void *dst, const void __user *src, unsigned size)
 {
@@ -83,13 +83,18 @@ static bool interrupted_user_mode(void)
  * whole "kernel_fpu_begin/end()" sequence?
  *
  * It's always ok in process context (ie "not interrupt")
- * but it is sometimes ok even from an irq.
+ * and in softirq context, which cannot hit a fpregs_lock()
+ * section. A hard interrupt must not have hit one either,
+ * which is the case when softirqs were enabled. NMIs may
+ * return to user space without loading the registers back,
+ * so they never get to use the FPU.
  */
 bool irq_fpu_usable(void)
 {
-	return !in_interrupt() ||
-		interrupted_user_mode() ||
-		interrupted_kernel_fpu_idle();
+	if (in_nmi() || !interrupted_kernel_fpu_idle())
+		return false;
+
+	return !in_irq() || interrupted_user_mode() || !softirq_count();
 }
 EXPORT_SYMBOL(irq_fpu_usable);
 
@@ -101,25 +106,24 @@ void __kernel_fpu_begin(void)
 
 	kernel_fpu_disable();
 
-	if (fpu->initialized) {
+	/*
+	 * Only the first section since entering the kernel saves the user
+	 * registers, they are loaded back by switch_fpu_return().
+	 */
+	if (fpu->initialized && !test_thread_flag(TIF_NEED_FPU_LOAD)) {
+		set_thread_flag(TIF_NEED_FPU_LOAD);
 		/*
 		 * Ignore return value -- we don't care if reg state
 		 * is clobbered.
 		 */
 		copy_fpregs_to_fpstate(fpu);
-	} else {
-		__cpu_invalidate_fpregs_state();
 	}
+	__cpu_invalidate_fpregs_state();
 }
 EXPORT_SYMBOL(__kernel_fpu_begin);
 
 void __kernel_fpu_end(void)
 {
-	struct fpu *fpu = &current->thread.fpu;
-
-	if (fpu->initialized)
-		copy_kernel_to_fpregs(&fpu->state);
-
 	kernel_fpu_enable();
 }
 EXPORT_SYMBOL(__kernel_fpu_end);
@@ -147,18 +151,33 @@ void fpu__save(struct fpu *fpu)
 {
 	WARN_ON_FPU(fpu != &current->thread.fpu);
 
-	preempt_disable();
+	fpregs_lock();
 	trace_x86_fpu_before_save(fpu);
-	if (fpu->initialized) {
+	if (fpu->initialized && !test_thread_flag(TIF_NEED_FPU_LOAD)) {
 		if (!copy_fpregs_to_fpstate(fpu)) {
 			copy_kernel_to_fpregs(&fpu->state);
 		}
 	}
 	trace_x86_fpu_after_save(fpu);
-	preempt_enable();
+	fpregs_unlock();
 }
 EXPORT_SYMBOL_GPL(fpu__save);
 
+/*
+ * Load the current task's registers back from fpu->state after kernel
+ * FPU sections took them over. Called with interrupts or preemption and
+ * softirqs disabled on the way out to user space or into a guest.
+ */
+void switch_fpu_return(void)
+{
+	struct fpu *fpu = &current->thread.fpu;
+
+	if (!fpregs_state_valid(fpu, smp_processor_id()))
+		copy_kernel_to_fpregs(&fpu->state);
+	fpregs_mark_activate();
+}
+EXPORT_SYMBOL_GPL(switch_fpu_return);
+
 /*
  * Legacy x87 fpstate state init:
  */
@@ -209,11 +228,18 @@ int fpu__copy(struct fpu *dst_fpu, struct fpu *src_fpu)
 	 *
 	 * ( The function 'fails' in the FNSAVE case, which destroys
 	 *   register contents so we have to copy them back. )
+	 *
+	 * If kernel FPU use took the registers over, the saved state is
+	 * the current one.
 	 */
-	if (!copy_fpregs_to_fpstate(dst_fpu)) {
+	fpregs_lock();
+	if (test_thread_flag(TIF_NEED_FPU_LOAD))
+		memcpy(&dst_fpu->state, &src_fpu->state, fpu_kernel_xstate_size);
+	else if (!copy_fpregs_to_fpstate(dst_fpu)) {
 		memcpy(&src_fpu->state, &dst_fpu->state, fpu_kernel_xstate_size);
 		copy_kernel_to_fpregs(&src_fpu->state);
 	}
+	fpregs_unlock();
 
 	trace_x86_fpu_copy_src(src_fpu);
 	trace_x86_fpu_copy_dst(dst_fpu);
@@ -322,8 +348,8 @@ void fpu__restore(struct fpu *fpu)
 	/* Avoid __kernel_fpu_begin() right after fpregs_activate() */
 	kernel_fpu_disable();
 	trace_x86_fpu_before_restore(fpu);
-	fpregs_activate(fpu);
 	copy_kernel_to_fpregs(&fpu->state);
+	fpregs_mark_activate();
 	trace_x86_fpu_after_restore(fpu);
 	kernel_fpu_enable();
 }
@@ -340,7 +366,7 @@ EXPORT_SYMBOL_GPL(fpu__restore);
  */
 void fpu__drop(struct fpu *fpu)
 {
-	preempt_disable();
+	fpregs_lock();
 
 	if (fpu == &current->thread.fpu) {
 		if (fpu->initialized) {
@@ -350,13 +376,14 @@ void fpu__drop(struct fpu *fpu)
 				     _ASM_EXTABLE(1b, 2b));
 			fpregs_deactivate(fpu);
 		}
+		clear_thread_flag(TIF_NEED_FPU_LOAD);
 	}
 
 	fpu->initialized = 0;
 
 	trace_x86_fpu_dropped(fpu);
 
-	preempt_enable();
+	fpregs_unlock();
 }
 
 /*
@@ -392,11 +419,11 @@ void fpu__clear(struct fpu *fpu)
 	 * Make sure fpstate is cleared and initialized.
 	 */
 	if (static_cpu_has(X86_FEATURE_FPU)) {
-		preempt_disable();
+		fpregs_lock();
 		fpu__initialize(fpu);
 		user_fpu_begin();
 		copy_init_fpstate_to_fpregs();
-		preempt_enable();
+		fpregs_unlock();
 	}
 }
 
@@ -5,6 +5,7 @@
 
 #include <linux/compat.h>
 #include <linux/cpu.h>
+#include <linux/pagemap.h>
 
 #include <asm/fpu/internal.h>
 #include <asm/fpu/signal.h>
@@ -173,12 +174,30 @@ int copy_fpstate_to_sigframe(void __user *buf, void __user *buf_fx, int size)
 			(struct _fpstate_32 __user *) buf) ? -1 : 1;
 
 	if (fpu->initialized || using_compacted_format()) {
-		/* Save the live register state to the user directly. */
-		if (copy_fpregs_to_sigframe(buf_fx))
-			return -1;
+		int ret;
+retry:
+		/*
+		 * Save the live register state to the user directly, loading
+		 * it back first if kernel FPU use took the registers over.
+		 * Faults cannot be taken with the registers held, so fault
+		 * the frame in and try again.
+		 */
+		fpregs_lock();
+		if (test_thread_flag(TIF_NEED_FPU_LOAD))
+			switch_fpu_return();
+		pagefault_disable();
+		ret = copy_fpregs_to_sigframe(buf_fx);
+		pagefault_enable();
 		/* Update the thread's fxstate to save the fsave header. */
-		if (ia32_fxstate)
+		if (!ret && ia32_fxstate)
 			copy_fxregs_to_kernel(fpu);
+		fpregs_unlock();
+
+		if (ret) {
+			if (!fault_in_pages_writeable(buf_fx, fpu_user_xstate_size))
+				goto retry;
+			return -1;
+		}
 	} else {
 		/*
 		 * It is a *bug* if kernel uses compacted-format for xsave
@@ -355,8 +374,26 @@ static int __fpu__restore_sig(void __user *buf, void __user *buf_fx, int size)
 		 * For 64-bit frames and 32-bit fsave frames, restore the user
 		 * state to the registers directly (with exceptions handled).
 		 */
-		user_fpu_begin();
-		if (copy_user_to_fpregs_zeroing(buf_fx, xfeatures, fx_only)) {
+		bool faulted_in = false;
+		int ret;
+retry:
+		fpregs_lock();
+		pagefault_disable();
+		ret = copy_user_to_fpregs_zeroing(buf_fx, xfeatures, fx_only);
+		pagefault_enable();
+		if (!ret)
+			fpregs_mark_activate();
+		fpregs_unlock();
+
+		if (ret) {
+			/*
+			 * Fault the frame in and try once more, a second
+			 * failure means the frame itself is bad.
+			 */
+			if (!faulted_in && !fault_in_pages_readable(buf_fx, size)) {
+				faulted_in = true;
+				goto retry;
+			}
 			fpu__clear(fpu);
 			return -1;
 		}
@@ -39,6 +39,7 @@
 #include <asm/desc.h>
 #include <asm/prctl.h>
 #include <asm/spec-ctrl.h>
+#include <asm/pti.h>
 
 #include "process.h"
 
@@ -845,13 +846,19 @@ unsigned long get_wchan(struct task_struct *p)
 }
 
 long do_arch_prctl_common(struct task_struct *task, int option,
-			  unsigned long cpuid_enabled)
+			  unsigned long arg2)
 {
 	switch (option) {
 	case ARCH_GET_CPUID:
 		return get_cpuid_mode();
 	case ARCH_SET_CPUID:
-		return set_cpuid_mode(task, cpuid_enabled);
+		return set_cpuid_mode(task, arg2);
+	case ARCH_GET_NOPTI:
+		return pti_get_mm_disabled(task->mm);
+	case ARCH_SET_NOPTI:
+		if (task != current || !arg2)
+			return -EINVAL;
+		return pti_disable_mm(task->mm);
 	}
 
 	return -EINVAL;
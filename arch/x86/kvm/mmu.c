@@ -5646,6 +5646,19 @@ void kvm_mmu_slot_remove_write_access(struct kvm *kvm,
 		kvm_flush_remote_tlbs(kvm);
 }
 
+/*
+ * Whether the host maps @pfn with a huge page, either THP or hugetlbfs,
+ * so that a fault on it can install a large spte again.  Unlike
+ * host_mapping_level() this does not need mmap_sem, so it can be used
+ * under mmu_lock.
+ */
+static bool kvm_is_huge_host_pfn(kvm_pfn_t pfn)
+{
+	struct page *page = pfn_to_page(pfn);
+
+	return PageTransCompoundMap(page) || PageHuge(page);
+}
+
 static bool kvm_mmu_zap_collapsible_spte(struct kvm *kvm,
 					 struct kvm_rmap_head *rmap_head)
 {
@@ -5669,7 +5682,7 @@ static bool kvm_mmu_zap_collapsible_spte(struct kvm *kvm,
 		 */
 		if (sp->role.direct &&
 			!kvm_is_reserved_pfn(pfn) &&
-			PageTransCompoundMap(pfn_to_page(pfn))) {
+			kvm_is_huge_host_pfn(pfn)) {
 			pte_list_remove(rmap_head, sptep);
 			need_tlb_flush = 1;
 			goto restart;
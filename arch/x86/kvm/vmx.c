@@ -1034,6 +1034,7 @@ struct vcpu_vmx {
 	bool emulation_required;
 
 	u32 exit_reason;
+	enum exit_fastpath_completion exit_fastpath;
 
 	/* Posted interrupt descriptor */
 	struct pi_desc pi_desc;
@@ -8005,6 +8006,7 @@ static __init int hardware_setup(void)
 		kvm_x86_ops->slot_disable_log_dirty = NULL;
 		kvm_x86_ops->flush_log_dirty = NULL;
 		kvm_x86_ops->enable_log_dirty_pt_masked = NULL;
+		kvm_x86_ops->cpu_dirty_log_size = 0;
 	}
 
 	if (!cpu_has_vmx_preemption_timer())
@@ -10627,6 +10629,10 @@ static int vmx_handle_exit(struct kvm_vcpu *vcpu)
 		}
 	}
 
+	/* Already handled by handle_fastpath_set_msr_irqoff(). */
+	if (vmx->exit_fastpath == EXIT_FASTPATH_SKIP_EMUL_INS)
+		return kvm_skip_emulated_instruction(vcpu);
+
 	if (exit_reason < kvm_vmx_max_exit_handlers
 	    && kvm_vmx_exit_handlers[exit_reason])
 		return kvm_vmx_exit_handlers[exit_reason](vcpu);
@@ -10957,6 +10963,11 @@ static void vmx_handle_external_intr(struct kvm_vcpu *vcpu)
 			[cs]"i"(__KERNEL_CS)
 			);
 	}
+
+	to_vmx(vcpu)->exit_fastpath = EXIT_FASTPATH_NONE;
+	if (to_vmx(vcpu)->exit_reason == EXIT_REASON_MSR_WRITE &&
+	    !is_guest_mode(vcpu))
+		to_vmx(vcpu)->exit_fastpath = handle_fastpath_set_msr_irqoff(vcpu);
 }
 STACK_FRAME_NON_STANDARD(vmx_handle_external_intr);
 
@@ -15114,6 +15125,7 @@ static struct kvm_x86_ops vmx_x86_ops __ro_after_init = {
 	.flush_log_dirty = vmx_flush_log_dirty,
 	.enable_log_dirty_pt_masked = vmx_enable_log_dirty_pt_masked,
 	.write_log_dirty = vmx_write_pml_buffer,
+	.cpu_dirty_log_size = PML_ENTITY_NUM,
 
 	.pre_block = vmx_pre_block,
 	.post_block = vmx_post_block,
@@ -8,6 +8,8 @@
 #include <linux/export.h>
 #include <linux/uaccess.h>
 #include <linux/highmem.h>
+#include <linux/init.h>
+#include <linux/uio.h>
 
 /*
  * Zero Userspace
@@ -227,3 +229,27 @@ void memcpy_page_flushcache(char *to, struct page *page, size_t offset,
 	kunmap_atomic(from);
 }
 #endif
+
+/*
+ * With "nocache_reads" on the command line, page cache reads larger than
+ * the last level cache are streamed to user space with non-temporal
+ * stores, see copy_page_to_iter().  Off by default: whether the reader
+ * gains from the cache it keeps more than it loses on the data it has to
+ * fetch back depends on the workload.
+ */
+static bool nocache_reads __initdata;
+
+static int __init nocache_reads_setup(char *str)
+{
+	nocache_reads = true;
+	return 1;
+}
+__setup("nocache_reads", nocache_reads_setup);
+
+static int __init iov_iter_nocache_init(void)
+{
+	if (nocache_reads && boot_cpu_data.x86_cache_size)
+		iov_iter_nocache_threshold = boot_cpu_data.x86_cache_size * 1024UL;
+	return 0;
+}
+late_initcall(iov_iter_nocache_init);
@@ -35,6 +35,7 @@
 #include <linux/spinlock.h>
 #include <linux/mm.h>
 #include <linux/uaccess.h>
+#include <linux/capability.h>
 
 #include <asm/cpufeature.h>
 #include <asm/hypervisor.h>
@@ -128,6 +129,21 @@ void __init pti_check_boottime_disable(void)
 	setup_force_cpu_cap(X86_FEATURE_PTI);
 }
 
+/*
+ * An mm without isolation runs user code on its kernel page tables, its
+ * user memory can't be NX there.
+ */
+static bool pti_pgd_user_exec(pgd_t *pgdp)
+{
+	struct mm_struct *mm;
+
+	if (!IS_ENABLED(CONFIG_X86_64))
+		return false;
+
+	mm = pgd_page_get_mm(virt_to_page(pgdp));
+	return mm && READ_ONCE(mm->context.pti_user_exec);
+}
+
 pgd_t __pti_set_user_pgtbl(pgd_t *pgdp, pgd_t pgd)
 {
 	/*
@@ -162,13 +178,63 @@ pgd_t __pti_set_user_pgtbl(pgd_t *pgdp, pgd_t pgd)
 	 *  - we're clearing the PGD (i.e. the new pgd is not present).
 	 */
 	if ((pgd.pgd & (_PAGE_USER|_PAGE_PRESENT)) == (_PAGE_USER|_PAGE_PRESENT) &&
-	    (__supported_pte_mask & _PAGE_NX))
+	    (__supported_pte_mask & _PAGE_NX) && !pti_pgd_user_exec(pgdp))
 		pgd.pgd |= _PAGE_NX;
 
 	/* return the copy of the PGD we want the kernel to use: */
 	return pgd;
 }
 
+long pti_get_mm_disabled(struct mm_struct *mm)
+{
+	return !boot_cpu_has(X86_FEATURE_PTI) ||
+	       READ_ONCE(mm->context.pti_disabled);
+}
+
+/*
+ * Let a trusted process run without isolation: it saves the CR3 writes on
+ * kernel entry and exit and gives up its protection against Meltdown.
+ * There is no way back, threads may already run on the kernel page tables.
+ */
+long pti_disable_mm(struct mm_struct *mm)
+{
+	pgd_t *pgd = mm->pgd;
+	int i;
+
+	if (!boot_cpu_has(X86_FEATURE_PTI))
+		return 0;
+	if (!IS_ENABLED(CONFIG_X86_64))
+		return -EOPNOTSUPP;
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+	if (READ_ONCE(mm->context.pti_disabled))
+		return 0;
+
+	/*
+	 * Drop the NX the kernel copy of the user PGDs got. page_table_lock
+	 * serializes against new top level entries, which see pti_user_exec
+	 * in __pti_set_user_pgtbl().
+	 */
+	spin_lock(&mm->page_table_lock);
+	WRITE_ONCE(mm->context.pti_user_exec, true);
+	for (i = 0; i < PGD_KERNEL_START; i++) {
+		pgdval_t val = pgd_val(pgd[i]);
+
+		if ((val & (_PAGE_USER|_PAGE_PRESENT)) == (_PAGE_USER|_PAGE_PRESENT))
+			WRITE_ONCE(pgd[i], __pgd(val & ~_PAGE_NX));
+	}
+	spin_unlock(&mm->page_table_lock);
+
+	/* no cpu may keep the NX cached once user code runs on these tables */
+	flush_tlb_mm(mm);
+
+	/* the other cpus pick it up on their next switch_mm() */
+	WRITE_ONCE(mm->context.pti_disabled, true);
+	if (current->mm == mm)
+		this_cpu_write(cpu_tlbstate.user_pti_disabled, true);
+	return 0;
+}
+
 /*
  * Walk the user copy of the page tables (optionally) trying to allocate
  * page table pages on the way down.
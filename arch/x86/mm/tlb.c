@@ -35,6 +35,21 @@
  */
 #define LAST_USER_MM_IBPB	0x1UL
 
+/* ASIDs each cpu keeps, see TLB_NR_DYN_ASIDS */
+static u16 tlb_nr_dyn_asids __read_mostly = TLB_NR_DYN_ASIDS;
+
+static int __init tlb_asids_setup(char *str)
+{
+	unsigned int nr;
+
+	if (kstrtouint(str, 0, &nr) || !nr)
+		return -EINVAL;
+
+	tlb_nr_dyn_asids = min_t(unsigned int, nr, TLB_NR_DYN_ASIDS_MAX);
+	return 0;
+}
+early_param("tlb_asids", tlb_asids_setup);
+
 /*
  * We get here when we do something requiring a TLB invalidation
  * but could not go invalidate all of the contexts.  We do the
@@ -54,7 +69,7 @@ static void clear_asid_other(void)
 		return;
 	}
 
-	for (asid = 0; asid < TLB_NR_DYN_ASIDS; asid++) {
+	for (asid = 0; asid < tlb_nr_dyn_asids; asid++) {
 		/* Do not need to flush the current asid */
 		if (asid == this_cpu_read(cpu_tlbstate.loaded_mm_asid))
 			continue;
@@ -84,7 +99,7 @@ static void choose_new_asid(struct mm_struct *next, u64 next_tlb_gen,
 	if (this_cpu_read(cpu_tlbstate.invalidate_other))
 		clear_asid_other();
 
-	for (asid = 0; asid < TLB_NR_DYN_ASIDS; asid++) {
+	for (asid = 0; asid < tlb_nr_dyn_asids; asid++) {
 		if (this_cpu_read(cpu_tlbstate.ctxs[asid].ctx_id) !=
 		    next->context.ctx_id)
 			continue;
@@ -100,7 +115,7 @@ static void choose_new_asid(struct mm_struct *next, u64 next_tlb_gen,
 	 * Allocate a slot.
 	 */
 	*new_asid = this_cpu_add_return(cpu_tlbstate.next_asid, 1) - 1;
-	if (*new_asid >= TLB_NR_DYN_ASIDS) {
+	if (*new_asid >= tlb_nr_dyn_asids) {
 		*new_asid = 0;
 		this_cpu_write(cpu_tlbstate.next_asid, 1);
 	}
@@ -320,6 +335,10 @@ void switch_mm_irqs_off(struct mm_struct *prev, struct mm_struct *next,
 	}
 #endif
 	this_cpu_write(cpu_tlbstate.is_lazy, false);
+#ifdef CONFIG_PAGE_TABLE_ISOLATION
+	this_cpu_write(cpu_tlbstate.user_pti_disabled,
+		       READ_ONCE(next->context.pti_disabled));
+#endif
 
 	/*
 	 * The membarrier system call requires a full memory barrier and
@@ -504,7 +523,7 @@ void initialize_tlbstate_and_flush(void)
 	this_cpu_write(cpu_tlbstate.ctxs[0].ctx_id, mm->context.ctx_id);
 	this_cpu_write(cpu_tlbstate.ctxs[0].tlb_gen, tlb_gen);
 
-	for (i = 1; i < TLB_NR_DYN_ASIDS; i++)
+	for (i = 1; i < TLB_NR_DYN_ASIDS_MAX; i++)
 		this_cpu_write(cpu_tlbstate.ctxs[i].ctx_id, 0);
 }
 
@@ -654,7 +673,11 @@ static void flush_tlb_func_remote(void *info)
 
 static bool tlb_is_not_lazy(int cpu, void *data)
 {
-	return !per_cpu(cpu_tlbstate.is_lazy, cpu);
+	if (per_cpu(cpu_tlbstate.is_lazy, cpu)) {
+		count_vm_tlb_event(NR_TLB_REMOTE_FLUSH_SKIPPED_LAZY);
+		return false;
+	}
+	return true;
 }
 
 void native_flush_tlb_others(const struct cpumask *cpumask,
@@ -13,6 +13,7 @@
 #include <linux/filter.h>
 #include <linux/if_vlan.h>
 #include <linux/bpf.h>
+#include <linux/sort.h>
 
 #include <asm/set_memory.h>
 #include <asm/nospec-branch.h>
@@ -1052,6 +1053,295 @@ xadd:			if (is_imm8(insn->off))
 	return proglen;
 }
 
+/* size of the __fentry__ call the trampoline is reached from */
+#define X86_PATCH_SIZE		5
+
+/* x86-64 registers the first six function arguments are passed in:
+ * rdi, rsi, rdx, rcx, r8, r9
+ */
+static const int tramp_arg_regs[BPF_MAX_TRAMP_ARGS] = { 7, 6, 2, 1, 8, 9 };
+
+/* mov qword ptr [rbp + off], reg  (store) or  mov reg, qword ptr [rbp + off] */
+static void emit_rbp_slot(u8 **pprog, u8 opcode, int reg, int off)
+{
+	u8 *prog = *pprog;
+	int cnt = 0;
+
+	EMIT4(reg >= 8 ? 0x4C : 0x48, opcode, 0x45 | ((reg & 7) << 3), off);
+	*pprog = prog;
+}
+
+/* call rel32 to @func, computed from the final address of the insn */
+static int emit_call(u8 **pprog, void *func)
+{
+	u8 *prog = *pprog;
+	s64 offset = (u8 *)func - (prog + X86_PATCH_SIZE);
+	int cnt = 0;
+
+	if (!is_simm32(offset)) {
+		pr_err("Target call %p is out of range\n", func);
+		return -E2BIG;
+	}
+	EMIT1_off32(0xE8, offset);
+	*pprog = prog;
+	return 0;
+}
+
+static int invoke_bpf(u8 **pprog, struct bpf_prog **progs, int prog_cnt,
+		      int stack_size, bool save_ret, int ret_off)
+{
+	u8 *prog = *pprog;
+	int cnt = 0, i;
+
+	for (i = 0; i < prog_cnt; i++) {
+		if (emit_call(&prog, __bpf_prog_enter))
+			return -EINVAL;
+		/* a program that recursed into the trampoline is skipped:
+		 * test eax, eax; jz over the call sequence below. With
+		 * save_ret the jump lands on the store of rax, so a skipped
+		 * program returns the 0 __bpf_prog_enter() left there.
+		 */
+		EMIT2(0x85, 0xC0);
+		EMIT2(0x74, 19);
+		/* lea rdi, [rbp - stack_size]: the u64 args array */
+		EMIT4(0x48, 0x8D, 0x7D, -stack_size);
+		/* movabs rsi, progs[i]->insnsi for the interpreter */
+		EMIT2(0x48, 0xBE);
+		EMIT((u32)(long)progs[i]->insnsi, 4);
+		EMIT((u32)((long)progs[i]->insnsi >> 32), 4);
+		/* call progs[i]->bpf_func */
+		if (emit_call(&prog, progs[i]->bpf_func))
+			return -EINVAL;
+		if (save_ret)
+			emit_rbp_slot(&prog, 0x89, 0, ret_off);
+		if (emit_call(&prog, __bpf_prog_exit))
+			return -EINVAL;
+	}
+	*pprog = prog;
+	return 0;
+}
+
+/*
+ * Generate the trampoline called from the ftrace site of @orig_call.
+ *
+ * The arguments of the traced function are spilled into a u64 array on
+ * the trampoline's stack, and each program gets a pointer to it as its
+ * context. With BPF_TRAMP_F_CALL_ORIG the trampoline then calls the body
+ * of the traced function itself, stores the return value in the slot
+ * after the arguments and runs the fexit programs:
+ *
+ *	push rbp
+ *	mov rbp, rsp
+ *	sub rsp, stack_size
+ *	mov [rbp - stack_size + 8 * i], <arg i>
+ *	<fentry programs>
+ *	call __bpf_tramp_enter(orig_ref)
+ *	mov <arg i>, [rbp - stack_size + 8 * i]
+ *	call orig_call + X86_PATCH_SIZE
+ *	mov [rbp - stack_size + 8 * nr_args], rax
+ *	call __bpf_tramp_exit(orig_ref)
+ *	<fexit programs>
+ *	mov rax, [rbp - stack_size + 8 * nr_args]
+ *	leave
+ *	add rsp, 8	(return to the parent of the traced function)
+ *	ret
+ *
+ * With BPF_TRAMP_F_RET_FENTRY_RET the trampoline is called as a function
+ * of its own, and returns the value the fentry program left in the slot
+ * after the arguments.
+ *
+ * @orig_ref is held across the call of the traced function, so that the
+ * image is not reused while a task sleeping there has yet to return.
+ *
+ * Returns the size of the image, or a negative errno.
+ */
+int arch_prepare_bpf_trampoline(void *image, void *image_end, u32 nr_args,
+				u32 flags, struct bpf_prog **fentry_progs,
+				int fentry_cnt, struct bpf_prog **fexit_progs,
+				int fexit_cnt, void *orig_call,
+				struct percpu_ref *orig_ref)
+{
+	bool fentry_ret = flags & BPF_TRAMP_F_RET_FENTRY_RET;
+	u8 *prog = image;
+	int stack_size, ret_off;
+	int cnt = 0, i;
+
+	/* keep rsp 16 byte aligned at the calls below: from an ftrace site
+	 * the trampoline is entered with the return address into the traced
+	 * function pushed on top of the usual one
+	 */
+	if (fentry_ret)
+		stack_size = round_up((nr_args + 1) * 8, 16);
+	else
+		stack_size = round_up((nr_args + 1) * 8 + 8, 16) - 8;
+	ret_off = -stack_size + nr_args * 8;
+
+	if (nr_args > BPF_MAX_TRAMP_ARGS)
+		return -ENOTSUPP;
+	if ((flags & BPF_TRAMP_F_RESTORE_REGS) &&
+	    (flags & (BPF_TRAMP_F_CALL_ORIG | BPF_TRAMP_F_SKIP_FRAME)))
+		/* the two ways of leaving the trampoline are exclusive */
+		return -EINVAL;
+	if (fentry_ret && (flags != BPF_TRAMP_F_RET_FENTRY_RET ||
+			   fentry_cnt != 1 || fexit_cnt))
+		return -EINVAL;
+	if ((flags & BPF_TRAMP_F_CALL_ORIG) && !orig_ref)
+		return -EINVAL;
+	/* worst case: every program and the original call emitted */
+	if ((fentry_cnt + fexit_cnt) * 34 + 160 > (u8 *)image_end - (u8 *)image)
+		return -E2BIG;
+
+	EMIT1(0x55);		 /* push rbp */
+	EMIT3(0x48, 0x89, 0xE5); /* mov rbp, rsp */
+	EMIT4(0x48, 0x83, 0xEC, stack_size); /* sub rsp, stack_size */
+
+	for (i = 0; i < nr_args; i++)
+		emit_rbp_slot(&prog, 0x89, tramp_arg_regs[i],
+			      -stack_size + i * 8);
+
+	if (invoke_bpf(&prog, fentry_progs, fentry_cnt, stack_size,
+		       fentry_ret, ret_off))
+		return -EINVAL;
+
+	if (flags & BPF_TRAMP_F_CALL_ORIG) {
+		/* movabs rdi, orig_ref */
+		EMIT2(0x48, 0xBF);
+		EMIT((u32)(long)orig_ref, 4);
+		EMIT((u32)((long)orig_ref >> 32), 4);
+		if (emit_call(&prog, __bpf_tramp_enter))
+			return -EINVAL;
+	}
+
+	if (flags & (BPF_TRAMP_F_RESTORE_REGS | BPF_TRAMP_F_CALL_ORIG))
+		for (i = 0; i < nr_args; i++)
+			emit_rbp_slot(&prog, 0x8B, tramp_arg_regs[i],
+				      -stack_size + i * 8);
+
+	if (flags & BPF_TRAMP_F_CALL_ORIG) {
+		if (emit_call(&prog, (u8 *)orig_call + X86_PATCH_SIZE))
+			return -EINVAL;
+		/* remember return value in a stack for bpf prog to access */
+		emit_rbp_slot(&prog, 0x89, 0, ret_off);
+
+		EMIT2(0x48, 0xBF);
+		EMIT((u32)(long)orig_ref, 4);
+		EMIT((u32)((long)orig_ref >> 32), 4);
+		if (emit_call(&prog, __bpf_tramp_exit))
+			return -EINVAL;
+
+		if (invoke_bpf(&prog, fexit_progs, fexit_cnt, stack_size,
+			       false, 0))
+			return -EINVAL;
+
+		/* restore original return value back into RAX */
+		emit_rbp_slot(&prog, 0x8B, 0, ret_off);
+	}
+
+	if (fentry_ret)
+		emit_rbp_slot(&prog, 0x8B, 0, ret_off);
+
+	EMIT1(0xC9); /* leave */
+	if (flags & BPF_TRAMP_F_SKIP_FRAME)
+		/* skip our return address and return to parent */
+		EMIT4(0x48, 0x83, 0xC4, 8); /* add rsp, 8 */
+	EMIT1(0xC3); /* ret */
+
+	return prog - (u8 *)image;
+}
+
+/* jmp rel32 or jcc rel32 to @func */
+static int emit_near_jump(u8 **pprog, void *func, u8 jmp_cond)
+{
+	u8 *prog = *pprog;
+	int insn_len = jmp_cond ? 6 : 5;
+	s64 offset = (u8 *)func - (prog + insn_len);
+	int cnt = 0;
+
+	if (!is_simm32(offset)) {
+		pr_err("Target jump %p is out of range\n", func);
+		return -EINVAL;
+	}
+	if (jmp_cond)
+		EMIT2_off32(0x0F, jmp_cond + 0x10, offset);
+	else
+		EMIT1_off32(0xE9, offset);
+	*pprog = prog;
+	return 0;
+}
+
+/*
+ * Binary search over the sorted program addresses in progs[a..b], comparing
+ * against the bpf_func argument in rdx. The dispatcher is reached through
+ * a call from the ftrace site of the dispatcher function, so on a match
+ * that return address is dropped and the program is jumped to, returning
+ * straight to the dispatcher's caller. With no match, returning runs the
+ * dispatcher function's own indirect call.
+ */
+static int emit_bpf_dispatcher(u8 **pprog, int a, int b, s64 *progs)
+{
+	u8 *jg_reloc, *prog = *pprog;
+	int pivot, err, cnt = 0;
+	s64 jg_offset;
+
+	if (!is_simm32(progs[a + (b - a) / 2]))
+		return -EINVAL;
+
+	if (a == b) {
+		/* Leaf node of recursion, i.e. not a range of indices anymore */
+		EMIT3_off32(0x48, 0x81, 0xFA, progs[a]); /* cmp rdx, func */
+		EMIT2(X86_JNE, 9);			 /* jne 1f */
+		EMIT4(0x48, 0x83, 0xC4, 8);		 /* add rsp, 8 */
+		err = emit_near_jump(&prog, (void *)progs[a], 0); /* jmp func */
+		if (err)
+			return err;
+		EMIT1(0xC3);				 /* 1: ret */
+		*pprog = prog;
+		return 0;
+	}
+
+	/* Not a leaf node, so we pivot, and recursively descend into
+	 * the lower and upper ranges.
+	 */
+	pivot = (b - a) / 2;
+	EMIT3_off32(0x48, 0x81, 0xFA, progs[a + pivot]); /* cmp rdx, func */
+	EMIT2_off32(0x0F, X86_JG + 0x10, 0);		  /* jg upper_part */
+	jg_reloc = prog;
+
+	err = emit_bpf_dispatcher(&prog, a, a + pivot, progs);
+	if (err)
+		return err;
+
+	jg_offset = prog - jg_reloc;
+	emit_code(jg_reloc - 4, jg_offset, 4);
+
+	err = emit_bpf_dispatcher(&prog, a + pivot + 1, b, progs);
+	if (err)
+		return err;
+
+	*pprog = prog;
+	return 0;
+}
+
+static int cmp_ips(const void *a, const void *b)
+{
+	const s64 *ipa = a;
+	const s64 *ipb = b;
+
+	if (*ipa > *ipb)
+		return 1;
+	if (*ipa < *ipb)
+		return -1;
+	return 0;
+}
+
+int arch_prepare_bpf_dispatcher(void *image, s64 *funcs, int num_funcs)
+{
+	u8 *prog = image;
+
+	sort(funcs, num_funcs, sizeof(funcs[0]), cmp_ips, NULL);
+	return emit_bpf_dispatcher(&prog, 0, num_funcs - 1, funcs);
+}
+
 struct x64_jit_data {
 	struct bpf_binary_header *header;
 	int *addrs;
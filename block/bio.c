@@ -747,6 +747,37 @@ int bio_add_pc_page(struct request_queue *q, struct bio *bio, struct page
 }
 EXPORT_SYMBOL(bio_add_pc_page);
 
+/**
+ *	bio_add_zone_append_page - attempt to add page to zone append bio
+ *	@bio: destination bio
+ *	@page: page to add
+ *	@len: vec entry length
+ *	@offset: vec entry offset
+ *
+ *	Attempt to add a page to the bio_vec maplist of a REQ_OP_ZONE_APPEND
+ *	bio. The block layer can't split zone append bios, so this fails as
+ *	soon as the bio would no longer fit in a single command. Returns the
+ *	number of bytes added.
+ */
+int bio_add_zone_append_page(struct bio *bio, struct page *page,
+			     unsigned int len, unsigned int offset)
+{
+	struct request_queue *q = bio->bi_disk->queue;
+
+	if (WARN_ON_ONCE(bio_op(bio) != REQ_OP_ZONE_APPEND))
+		return 0;
+
+	if (WARN_ON_ONCE(!blk_queue_is_zoned(q)))
+		return 0;
+
+	if (((bio->bi_iter.bi_size + len) >> 9) >
+	    queue_max_zone_append_sectors(q))
+		return 0;
+
+	return bio_add_pc_page(q, bio, page, len, offset);
+}
+EXPORT_SYMBOL_GPL(bio_add_zone_append_page);
+
 /**
  * __bio_try_merge_page - try appending data to an existing bvec.
  * @bio: destination bio
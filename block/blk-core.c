@@ -273,6 +273,18 @@ static void req_bio_endio(struct request *rq, struct bio *bio,
 
 	bio_advance(bio, nbytes);
 
+	if (req_op(rq) == REQ_OP_ZONE_APPEND && !error) {
+		/*
+		 * The driver left the sector the data landed on in the
+		 * request. A partial completion can't be reported, the rest
+		 * of the bio would not have been written right behind it.
+		 */
+		if (bio->bi_iter.bi_size)
+			bio->bi_status = BLK_STS_IOERR;
+		else
+			bio->bi_iter.bi_sector = rq->__sector;
+	}
+
 	/* don't actually finish bio if it's part of flush sequence */
 	if (bio->bi_iter.bi_size == 0 && !(rq->rq_flags & RQF_FLUSH_SEQ))
 		bio_endio(bio);
@@ -2306,6 +2318,15 @@ generic_make_request_checks(struct bio *bio)
 		if (!blk_queue_is_zoned(q))
 			goto not_supported;
 		break;
+	case REQ_OP_ZONE_APPEND:
+		if (!blk_queue_is_zoned(q) || !q->limits.max_zone_append_sectors)
+			goto not_supported;
+		/* must name the start of a zone and fit in it in one piece */
+		if ((bio->bi_iter.bi_sector & (blk_queue_zone_sectors(q) - 1)) ||
+		    nr_sectors > queue_max_zone_append_sectors(q) ||
+		    nr_sectors > blk_queue_zone_sectors(q))
+			goto end_io;
+		break;
 	case REQ_OP_WRITE_ZEROES:
 		if (!q->limits.max_write_zeroes_sectors)
 			goto not_supported;
@@ -2637,7 +2658,7 @@ blk_status_t blk_insert_cloned_request(struct request_queue *q, struct request *
 		 * bypass a potential scheduler on the bottom device for
 		 * insert.
 		 */
-		return blk_mq_request_issue_directly(rq);
+		return blk_mq_request_issue_directly(rq, true);
 	}
 
 	spin_lock_irqsave(q->queue_lock, flags);
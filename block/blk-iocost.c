@@ -0,0 +1,970 @@
+/*
+ * Block rq-qos based proportional IO cost controller
+ *
+ * This splits a device between cgroups according to their weights, like the
+ * cpu controller does for cpu time.  What is shared isn't bytes or IOs but
+ * device time, which is estimated for every bio with a linear cost model
+ *
+ *	cost = base[dir][seq or rand] + nr_pages * page[dir]
+ *
+ * The coefficients are derived from the bytes per second and the sequential
+ * and random IOs per second the device sustains in each direction, which can
+ * be set through io.cost.model on the root cgroup.  Until they are, one of
+ * two built-in models, for rotational and for non-rotational devices, is
+ * used.
+ *
+ * The device has a virtual clock (vtime) which runs at vrate times the wall
+ * clock; vrate is 100% unless changed through io.cost.qos.  Every group has
+ * its own vtime, which is advanced by cost / hweight for each bio it issues.
+ * hweight is the group's share of the device, i.e. the product of its
+ * weight's fraction of the active weights at each level of the hierarchy.
+ * A group may issue while its vtime isn't ahead of the device's; otherwise
+ * the issuer sleeps until it no longer is.  Over time this caps every group
+ * at hweight of the device's capacity as estimated by the model.
+ *
+ * A group that hasn't issued anything for a whole period is deactivated and
+ * its weight stops counting against its siblings, so idle capacity goes to
+ * whoever is busy.  When it becomes active again it can spend at most one
+ * period's worth of budget saved up while idle.
+ *
+ * Completion latencies aren't fed back into the model or vrate.  Keeping the
+ * model close to what the device can actually do is the administrator's job,
+ * vrate can be used to either leave headroom or to push harder.
+ *
+ * The controller is only set up on a queue when io.cost.qos or
+ * io.cost.model is first written for it, other queues don't see it at all.
+ * Once set up, the overhead while disabled is a single check in the
+ * throttle hook, and when enabled it is a few atomic operations per bio
+ * unless the group has to wait.
+ */
+#include <linux/kernel.h>
+#include <linux/blk_types.h>
+#include <linux/backing-dev.h>
+#include <linux/module.h>
+#include <linux/timer.h>
+#include <linux/hrtimer.h>
+#include <linux/seqlock.h>
+#include <linux/sched/signal.h>
+#include <linux/genhd.h>
+#include <linux/blk-mq.h>
+#include "blk-rq-qos.h"
+
+/* period of the device timer, groups idle for a whole period deactivate */
+#define IOC_PERIOD		(50 * NSEC_PER_MSEC)
+
+/* the model's unit of transfer */
+#define IOC_PAGE_SIZE		4096
+#define IOC_SECT_TO_PAGE_SHIFT	(ilog2(IOC_PAGE_SIZE) - SECTOR_SHIFT)
+
+/* bios starting this close to where the last one ended are sequential */
+#define IOC_SEQ_WINDOW		((16 << 20) >> SECTOR_SHIFT)
+
+/* fixed point 1.0 for hweight */
+#define HWEIGHT_WHOLE		(1 << 16)
+
+#define VRATE_DFL_PCT		100
+#define VRATE_MIN_PCT		1
+#define VRATE_MAX_PCT		10000
+
+enum ioc_model_param {
+	I_RBPS,
+	I_RSEQIOPS,
+	I_RRANDIOPS,
+	I_WBPS,
+	I_WSEQIOPS,
+	I_WRANDIOPS,
+	NR_I_PARAMS,
+};
+
+static const char * const ioc_model_param_names[NR_I_PARAMS] = {
+	[I_RBPS]	= "rbps",
+	[I_RSEQIOPS]	= "rseqiops",
+	[I_RRANDIOPS]	= "rrandiops",
+	[I_WBPS]	= "wbps",
+	[I_WSEQIOPS]	= "wseqiops",
+	[I_WRANDIOPS]	= "wrandiops",
+};
+
+static const u64 ioc_model_hdd[NR_I_PARAMS] = {
+	[I_RBPS]	= 175000000,
+	[I_RSEQIOPS]	= 40000,
+	[I_RRANDIOPS]	= 370,
+	[I_WBPS]	= 175000000,
+	[I_WSEQIOPS]	= 40000,
+	[I_WRANDIOPS]	= 380,
+};
+
+static const u64 ioc_model_ssd[NR_I_PARAMS] = {
+	[I_RBPS]	= 2000000000,
+	[I_RSEQIOPS]	= 250000,
+	[I_RRANDIOPS]	= 200000,
+	[I_WBPS]	= 1500000000,
+	[I_WSEQIOPS]	= 200000,
+	[I_WRANDIOPS]	= 150000,
+};
+
+/* vtime cost of each part of an IO, indexed by READ/WRITE */
+struct ioc_coefs {
+	u64 page[2];
+	u64 seqio[2];
+	u64 randio[2];
+};
+
+static struct blkcg_policy blkcg_policy_iocost;
+
+struct ioc {
+	struct rq_qos rqos;
+	/* protects everything below bar the lockless reads noted */
+	spinlock_t lock;
+	struct timer_list timer;
+	bool enabled;
+	bool user_model;
+	u64 params[NR_I_PARAMS];
+
+	/* read locklessly under @seq */
+	seqcount_t seq;
+	struct ioc_coefs coefs;
+	u32 vrate_pct;
+	u64 period_at;		/* wall clock at the start of the period */
+	u64 period_at_vtime;	/* device vtime at the start of the period */
+
+	struct list_head active_iocgs;
+	/* bumped whenever an active weight changes, see iocg_hweight() */
+	atomic_t hweight_gen;
+};
+
+struct iocg {
+	struct blkg_policy_data pd;
+	struct ioc *ioc;
+
+	/* protected by ioc->lock */
+	u32 weight;
+	bool active;
+	struct list_head active_list;
+	u32 child_active_sum;
+	u64 last_vtime;
+
+	/* cached hierarchical weight, valid while hweight_gen matches */
+	int hweight_gen;
+	u32 hweight;
+
+	atomic64_t vtime;
+	sector_t cursor;
+	wait_queue_head_t waitq;
+	struct hrtimer waitq_timer;
+
+	/* statistics, in ns */
+	atomic64_t abs_vusage;
+	atomic64_t wait_ns;
+};
+
+struct ioc_cgrp {
+	struct blkcg_policy_data cpd;
+	unsigned int dfl_weight;
+};
+
+static inline struct ioc *rqos_to_ioc(struct rq_qos *rqos)
+{
+	return container_of(rqos, struct ioc, rqos);
+}
+
+static inline struct iocg *pd_to_iocg(struct blkg_policy_data *pd)
+{
+	return pd ? container_of(pd, struct iocg, pd) : NULL;
+}
+
+static inline struct iocg *blkg_to_iocg(struct blkcg_gq *blkg)
+{
+	return pd_to_iocg(blkg_to_pd(blkg, &blkcg_policy_iocost));
+}
+
+static inline struct blkcg_gq *iocg_to_blkg(struct iocg *iocg)
+{
+	return pd_to_blkg(&iocg->pd);
+}
+
+static inline struct ioc_cgrp *blkcg_to_iocc(struct blkcg *blkcg)
+{
+	struct blkcg_policy_data *cpd;
+
+	cpd = blkcg_to_cpd(blkcg, &blkcg_policy_iocost);
+	return cpd ? container_of(cpd, struct ioc_cgrp, cpd) : NULL;
+}
+
+static void ioc_calc_coefs(const u64 *params, struct ioc_coefs *coefs)
+{
+	static const int idx[2][3] = {
+		[READ]	= { I_RBPS, I_RSEQIOPS, I_RRANDIOPS },
+		[WRITE]	= { I_WBPS, I_WSEQIOPS, I_WRANDIOPS },
+	};
+	int rw;
+
+	for (rw = READ; rw <= WRITE; rw++) {
+		u64 page, seqio, randio;
+
+		page = div64_u64((u64)NSEC_PER_SEC * IOC_PAGE_SIZE,
+				 params[idx[rw][0]]);
+		page = max_t(u64, page, 1);
+		seqio = div64_u64(NSEC_PER_SEC, params[idx[rw][1]]);
+		randio = div64_u64(NSEC_PER_SEC, params[idx[rw][2]]);
+
+		/* a single page IO costs exactly 1 / iops */
+		coefs->page[rw] = page;
+		coefs->seqio[rw] = seqio > page ? seqio - page : 0;
+		coefs->randio[rw] = randio > page ? randio - page : 0;
+	}
+}
+
+/* ioc->lock must be held */
+static void ioc_set_params(struct ioc *ioc, const u64 *params)
+{
+	memcpy(ioc->params, params, sizeof(ioc->params));
+	write_seqcount_begin(&ioc->seq);
+	ioc_calc_coefs(params, &ioc->coefs);
+	write_seqcount_end(&ioc->seq);
+}
+
+/* ioc->lock must be held */
+static void ioc_set_default_params(struct ioc *ioc)
+{
+	if (blk_queue_nonrot(ioc->rqos.q))
+		ioc_set_params(ioc, ioc_model_ssd);
+	else
+		ioc_set_params(ioc, ioc_model_hdd);
+}
+
+static u64 ioc_vnow(struct ioc *ioc, u64 now)
+{
+	unsigned int seq;
+	u64 vnow;
+
+	do {
+		seq = read_seqcount_begin(&ioc->seq);
+		vnow = ioc->period_at_vtime;
+		if (now > ioc->period_at)
+			vnow += div_u64((now - ioc->period_at) *
+					ioc->vrate_pct, 100);
+	} while (read_seqcount_retry(&ioc->seq, seq));
+
+	return vnow;
+}
+
+/* budget a group may save up while idle */
+static u64 ioc_margin(struct ioc *ioc)
+{
+	return div_u64(IOC_PERIOD * READ_ONCE(ioc->vrate_pct), 100);
+}
+
+/* ioc->lock must be held, starts a new period at @now */
+static void ioc_start_period(struct ioc *ioc, u64 now)
+{
+	u64 vnow = ioc_vnow(ioc, now);
+
+	write_seqcount_begin(&ioc->seq);
+	ioc->period_at_vtime = vnow;
+	ioc->period_at = now;
+	write_seqcount_end(&ioc->seq);
+}
+
+static u64 ioc_bio_cost(struct ioc *ioc, struct iocg *iocg, struct bio *bio)
+{
+	int rw = bio_data_dir(bio);
+	sector_t sector = bio->bi_iter.bi_sector;
+	sector_t cursor = READ_ONCE(iocg->cursor);
+	u64 pages = max_t(u64, bio_sectors(bio) >> IOC_SECT_TO_PAGE_SHIFT, 1);
+	unsigned int seq;
+	bool is_seq;
+	u64 cost;
+
+	is_seq = sector >= cursor ? sector - cursor <= IOC_SEQ_WINDOW :
+				    cursor - sector <= IOC_SEQ_WINDOW;
+	WRITE_ONCE(iocg->cursor, bio_end_sector(bio));
+
+	do {
+		seq = read_seqcount_begin(&ioc->seq);
+		cost = is_seq ? ioc->coefs.seqio[rw] : ioc->coefs.randio[rw];
+		cost += pages * ioc->coefs.page[rw];
+	} while (read_seqcount_retry(&ioc->seq, seq));
+
+	return cost;
+}
+
+/*
+ * Our share of the device: the product of our weight's fraction of the
+ * active weights among our siblings, all the way up to the root.  Only
+ * recalculated when some active weight has changed since the last time.
+ */
+static u32 iocg_hweight(struct iocg *iocg)
+{
+	int gen = atomic_read(&iocg->ioc->hweight_gen);
+	struct blkcg_gq *blkg;
+	u64 hweight = HWEIGHT_WHOLE;
+
+	if (READ_ONCE(iocg->hweight_gen) == gen)
+		return READ_ONCE(iocg->hweight);
+
+	for (blkg = iocg_to_blkg(iocg); blkg->parent; blkg = blkg->parent) {
+		struct iocg *child = blkg_to_iocg(blkg);
+		struct iocg *parent = blkg_to_iocg(blkg->parent);
+		u32 weight, sum;
+
+		if (!parent)
+			break;
+		weight = READ_ONCE(child->weight);
+		sum = max(READ_ONCE(parent->child_active_sum), weight);
+		hweight = div_u64(hweight * weight, sum);
+	}
+	hweight = max_t(u64, hweight, 1);
+
+	WRITE_ONCE(iocg->hweight, hweight);
+	smp_wmb();
+	WRITE_ONCE(iocg->hweight_gen, gen);
+	return hweight;
+}
+
+/* ioc->lock must be held */
+static void iocg_deactivate(struct iocg *iocg)
+{
+	struct blkcg_gq *blkg = iocg_to_blkg(iocg);
+	struct iocg *parent = blkg->parent ? blkg_to_iocg(blkg->parent) : NULL;
+
+	if (!iocg->active)
+		return;
+
+	iocg->active = false;
+	list_del_init(&iocg->active_list);
+	if (parent)
+		parent->child_active_sum -= iocg->weight;
+	atomic_inc(&iocg->ioc->hweight_gen);
+}
+
+/* mark @iocg and its inactive ancestors active */
+static void iocg_activate(struct iocg *iocg, u64 now)
+{
+	struct ioc *ioc = iocg->ioc;
+	struct blkcg_gq *blkg;
+	unsigned long flags;
+	u64 vmin;
+
+	spin_lock_irqsave(&ioc->lock, flags);
+	vmin = ioc_vnow(ioc, now) - ioc_margin(ioc);
+
+	for (blkg = iocg_to_blkg(iocg); blkg->parent; blkg = blkg->parent) {
+		struct iocg *child = blkg_to_iocg(blkg);
+		struct iocg *parent = blkg_to_iocg(blkg->parent);
+
+		if (!parent || child->active)
+			break;
+
+		child->active = true;
+		list_add_tail(&child->active_list, &ioc->active_iocgs);
+		parent->child_active_sum += child->weight;
+
+		/* don't let the budget saved up while idle pile up */
+		if ((s64)(atomic64_read(&child->vtime) - vmin) < 0)
+			atomic64_set(&child->vtime, vmin);
+		child->last_vtime = atomic64_read(&child->vtime);
+	}
+	atomic_inc(&ioc->hweight_gen);
+
+	if (!timer_pending(&ioc->timer))
+		mod_timer(&ioc->timer,
+			  jiffies + nsecs_to_jiffies(IOC_PERIOD));
+	spin_unlock_irqrestore(&ioc->lock, flags);
+}
+
+static void ioc_timer_fn(struct timer_list *t)
+{
+	struct ioc *ioc = from_timer(ioc, t, timer);
+	struct iocg *iocg, *tiocg;
+	u64 now = ktime_get_ns();
+	u64 vmin;
+
+	spin_lock_irq(&ioc->lock);
+	vmin = ioc_vnow(ioc, now) - ioc_margin(ioc);
+
+	/*
+	 * Children are on the list ahead of the parents activated along with
+	 * them, so a subtree that went idle is torn down in a single pass.
+	 */
+	list_for_each_entry_safe(iocg, tiocg, &ioc->active_iocgs, active_list) {
+		u64 vtime = atomic64_read(&iocg->vtime);
+
+		if (vtime == iocg->last_vtime && !iocg->child_active_sum &&
+		    !waitqueue_active(&iocg->waitq)) {
+			iocg_deactivate(iocg);
+			continue;
+		}
+
+		if ((s64)(vtime - vmin) < 0 &&
+		    atomic64_cmpxchg(&iocg->vtime, vtime, vmin) == vtime)
+			vtime = vmin;
+		iocg->last_vtime = vtime;
+	}
+
+	ioc_start_period(ioc, now);
+
+	if (!list_empty(&ioc->active_iocgs))
+		mod_timer(&ioc->timer, jiffies + nsecs_to_jiffies(IOC_PERIOD));
+	spin_unlock_irq(&ioc->lock);
+}
+
+static enum hrtimer_restart iocg_waitq_timer_fn(struct hrtimer *timer)
+{
+	struct iocg *iocg = container_of(timer, struct iocg, waitq_timer);
+
+	wake_up_all(&iocg->waitq);
+	return HRTIMER_NORESTART;
+}
+
+/* arm the wait timer to fire within @delay ns */
+static void iocg_kick_waitq(struct iocg *iocg, u64 delay)
+{
+	ktime_t expires = ktime_add_ns(ktime_get(), delay);
+	unsigned long flags;
+
+	spin_lock_irqsave(&iocg->waitq.lock, flags);
+	if (!hrtimer_is_queued(&iocg->waitq_timer) ||
+	    ktime_before(expires, hrtimer_get_expires(&iocg->waitq_timer)))
+		hrtimer_start(&iocg->waitq_timer, expires, HRTIMER_MODE_ABS);
+	spin_unlock_irqrestore(&iocg->waitq.lock, flags);
+}
+
+/*
+ * We don't reserve the cost up front, a group can issue whenever its vtime
+ * hasn't run ahead of the device's.  That lets large bios through without
+ * starving them, while the overshoot is paid back by the bios after it.
+ */
+static bool iocg_try_charge(struct iocg *iocg, u64 cost, u64 vnow)
+{
+	if ((s64)(atomic64_read(&iocg->vtime) - vnow) > 0)
+		return false;
+	atomic64_add(cost, &iocg->vtime);
+	return true;
+}
+
+static struct blkcg_gq *ioc_bio_blkg(struct request_queue *q, struct bio *bio,
+				     spinlock_t *lock)
+{
+	struct blkcg *blkcg;
+	struct blkcg_gq *blkg;
+
+	if (bio->bi_blkg)
+		return bio->bi_blkg;
+
+	rcu_read_lock();
+	blkcg = bio_blkcg(bio);
+	bio_associate_blkcg(bio, &blkcg->css);
+	blkg = blkg_lookup(blkcg, q);
+	if (unlikely(!blkg)) {
+		if (!lock)
+			spin_lock_irq(q->queue_lock);
+		blkg = blkg_lookup_create(blkcg, q);
+		if (IS_ERR(blkg))
+			blkg = NULL;
+		if (!lock)
+			spin_unlock_irq(q->queue_lock);
+	}
+	if (blkg && bio_associate_blkg(bio, blkg))
+		blkg = NULL;
+	rcu_read_unlock();
+
+	return blkg;
+}
+
+static void ioc_rqos_throttle(struct rq_qos *rqos, struct bio *bio,
+			      spinlock_t *lock)
+	__releases(lock)
+	__acquires(lock)
+{
+	struct ioc *ioc = rqos_to_ioc(rqos);
+	struct blkcg_gq *blkg;
+	struct iocg *iocg;
+	u64 abs_cost, cost, now, vnow, start;
+	DEFINE_WAIT(wait);
+
+	if (!READ_ONCE(ioc->enabled) || !bio_sectors(bio) ||
+	    (bio_op(bio) != REQ_OP_READ && bio_op(bio) != REQ_OP_WRITE))
+		return;
+
+	blkg = ioc_bio_blkg(rqos->q, bio, lock);
+	if (!blkg || !blkg->parent)
+		return;
+	iocg = blkg_to_iocg(blkg);
+	if (!iocg)
+		return;
+
+	now = ktime_get_ns();
+	if (!READ_ONCE(iocg->active))
+		iocg_activate(iocg, now);
+
+	abs_cost = ioc_bio_cost(ioc, iocg, bio);
+	cost = div_u64(abs_cost * HWEIGHT_WHOLE, iocg_hweight(iocg));
+	atomic64_add(abs_cost, &iocg->abs_vusage);
+
+	/*
+	 * Like iolatency, don't hold up IO issued on behalf of the root or by
+	 * a dying task.  The cost is still charged and paid back later.
+	 */
+	if (bio_issue_as_root_blkg(bio) || fatal_signal_pending(current)) {
+		atomic64_add(cost, &iocg->vtime);
+		return;
+	}
+
+	vnow = ioc_vnow(ioc, now);
+	if (iocg_try_charge(iocg, cost, vnow))
+		return;
+
+	start = now;
+	do {
+		u64 delay;
+
+		prepare_to_wait(&iocg->waitq, &wait, TASK_UNINTERRUPTIBLE);
+
+		vnow = ioc_vnow(ioc, ktime_get_ns());
+		if (!READ_ONCE(ioc->enabled) ||
+		    iocg_try_charge(iocg, cost, vnow))
+			break;
+
+		delay = atomic64_read(&iocg->vtime) - vnow;
+		delay = div_u64(delay * 100, READ_ONCE(ioc->vrate_pct));
+		iocg_kick_waitq(iocg, delay);
+
+		if (lock) {
+			spin_unlock_irq(lock);
+			io_schedule();
+			spin_lock_irq(lock);
+		} else {
+			io_schedule();
+		}
+	} while (1);
+
+	finish_wait(&iocg->waitq, &wait);
+	atomic64_add(ktime_get_ns() - start, &iocg->wait_ns);
+}
+
+static void ioc_rqos_exit(struct rq_qos *rqos)
+{
+	struct ioc *ioc = rqos_to_ioc(rqos);
+
+	blkcg_deactivate_policy(rqos->q, &blkcg_policy_iocost);
+	del_timer_sync(&ioc->timer);
+	kfree(ioc);
+}
+
+static struct rq_qos_ops ioc_rqos_ops = {
+	.throttle = ioc_rqos_throttle,
+	.exit = ioc_rqos_exit,
+};
+
+static int blk_iocost_init(struct request_queue *q)
+{
+	struct ioc *ioc;
+	struct rq_qos *rqos;
+	int ret;
+
+	ioc = kzalloc(sizeof(*ioc), GFP_KERNEL);
+	if (!ioc)
+		return -ENOMEM;
+
+	spin_lock_init(&ioc->lock);
+	timer_setup(&ioc->timer, ioc_timer_fn, 0);
+	seqcount_init(&ioc->seq);
+	INIT_LIST_HEAD(&ioc->active_iocgs);
+	ioc->vrate_pct = VRATE_DFL_PCT;
+	ioc->period_at = ktime_get_ns();
+
+	rqos = &ioc->rqos;
+	rqos->id = RQ_QOS_COST;
+	rqos->ops = &ioc_rqos_ops;
+	rqos->q = q;
+
+	/* the queue may be live, don't let bios see a half set up rq_qos */
+	blk_mq_freeze_queue(q);
+	rq_qos_add(q, rqos);
+	blk_mq_unfreeze_queue(q);
+
+	ret = blkcg_activate_policy(q, &blkcg_policy_iocost);
+	if (ret) {
+		rq_qos_del(q, rqos);
+		kfree(ioc);
+		return ret;
+	}
+
+	return 0;
+}
+
+static DEFINE_MUTEX(ioc_init_mutex);
+
+/*
+ * Set the controller up on the whole disk @input starts with, unless that
+ * was done already.  The following blkg_conf_prep() does the parsing that
+ * matters, this only needs to find the queue.
+ */
+static int ioc_conf_init(const char *input)
+{
+	unsigned int major, minor;
+	struct gendisk *disk;
+	int part, ret = 0;
+
+	if (sscanf(input, "%u:%u", &major, &minor) != 2)
+		return -EINVAL;
+
+	disk = get_gendisk(MKDEV(major, minor), &part);
+	if (!disk)
+		return -ENODEV;
+
+	if (part) {
+		ret = -ENODEV;
+	} else {
+		mutex_lock(&ioc_init_mutex);
+		if (!ioc_rq_qos(disk->queue))
+			ret = blk_iocost_init(disk->queue);
+		mutex_unlock(&ioc_init_mutex);
+	}
+
+	put_disk_and_module(disk);
+	return ret;
+}
+
+static u64 ioc_qos_prfill(struct seq_file *sf, struct blkg_policy_data *pd,
+			  int off)
+{
+	const char *dname = blkg_dev_name(pd->blkg);
+	struct ioc *ioc = pd_to_iocg(pd)->ioc;
+
+	if (!dname)
+		return 0;
+	seq_printf(sf, "%s enable=%d rate=%u\n",
+		   dname, ioc->enabled, ioc->vrate_pct);
+	return 0;
+}
+
+static int ioc_qos_show(struct seq_file *sf, void *v)
+{
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)), ioc_qos_prfill,
+			  &blkcg_policy_iocost, seq_cft(sf)->private, false);
+	return 0;
+}
+
+static ssize_t ioc_qos_write(struct kernfs_open_file *of, char *buf,
+			     size_t nbytes, loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	struct blkg_conf_ctx ctx;
+	struct ioc *ioc;
+	unsigned int enable, vrate;
+	char *p, *tok;
+	int ret;
+
+	ret = ioc_conf_init(buf);
+	if (ret)
+		return ret;
+
+	ret = blkg_conf_prep(blkcg, &blkcg_policy_iocost, buf, &ctx);
+	if (ret)
+		return ret;
+
+	ioc = blkg_to_iocg(ctx.blkg)->ioc;
+	enable = ioc->enabled;
+	vrate = ioc->vrate_pct;
+	p = ctx.body;
+
+	ret = -EINVAL;
+	while ((tok = strsep(&p, " "))) {
+		char key[16];
+		char val[21];	/* 18446744073709551616 */
+
+		if (!*tok)
+			continue;
+		if (sscanf(tok, "%15[^=]=%20s", key, val) != 2)
+			goto out;
+
+		if (!strcmp(key, "enable")) {
+			if (kstrtouint(val, 10, &enable) || enable > 1)
+				goto out;
+		} else if (!strcmp(key, "rate")) {
+			if (kstrtouint(val, 10, &vrate) ||
+			    vrate < VRATE_MIN_PCT || vrate > VRATE_MAX_PCT)
+				goto out;
+		} else {
+			goto out;
+		}
+	}
+
+	spin_lock(&ioc->lock);
+	if (enable && !ioc->enabled && !ioc->user_model)
+		ioc_set_default_params(ioc);
+	ioc_start_period(ioc, ktime_get_ns());
+	write_seqcount_begin(&ioc->seq);
+	ioc->vrate_pct = vrate;
+	write_seqcount_end(&ioc->seq);
+	WRITE_ONCE(ioc->enabled, enable);
+	spin_unlock(&ioc->lock);
+
+	ret = 0;
+out:
+	blkg_conf_finish(&ctx);
+	return ret ?: nbytes;
+}
+
+static u64 ioc_model_prfill(struct seq_file *sf, struct blkg_policy_data *pd,
+			    int off)
+{
+	const char *dname = blkg_dev_name(pd->blkg);
+	struct ioc *ioc = pd_to_iocg(pd)->ioc;
+	int i;
+
+	if (!dname)
+		return 0;
+	seq_printf(sf, "%s ctrl=%s", dname, ioc->user_model ? "user" : "auto");
+	for (i = 0; i < NR_I_PARAMS; i++)
+		seq_printf(sf, " %s=%llu", ioc_model_param_names[i],
+			   ioc->params[i]);
+	seq_putc(sf, '\n');
+	return 0;
+}
+
+static int ioc_model_show(struct seq_file *sf, void *v)
+{
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)), ioc_model_prfill,
+			  &blkcg_policy_iocost, seq_cft(sf)->private, false);
+	return 0;
+}
+
+static ssize_t ioc_model_write(struct kernfs_open_file *of, char *buf,
+			       size_t nbytes, loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	struct blkg_conf_ctx ctx;
+	struct ioc *ioc;
+	u64 params[NR_I_PARAMS];
+	bool user = true;
+	char *p, *tok;
+	int i, ret;
+
+	ret = ioc_conf_init(buf);
+	if (ret)
+		return ret;
+
+	ret = blkg_conf_prep(blkcg, &blkcg_policy_iocost, buf, &ctx);
+	if (ret)
+		return ret;
+
+	ioc = blkg_to_iocg(ctx.blkg)->ioc;
+	spin_lock(&ioc->lock);
+	if (!ioc->user_model)
+		ioc_set_default_params(ioc);
+	memcpy(params, ioc->params, sizeof(params));
+	spin_unlock(&ioc->lock);
+	p = ctx.body;
+
+	ret = -EINVAL;
+	while ((tok = strsep(&p, " "))) {
+		char key[16];
+		char val[21];	/* 18446744073709551616 */
+
+		if (!*tok)
+			continue;
+		if (sscanf(tok, "%15[^=]=%20s", key, val) != 2)
+			goto out;
+
+		if (!strcmp(key, "ctrl")) {
+			if (!strcmp(val, "auto"))
+				user = false;
+			else if (!strcmp(val, "user"))
+				user = true;
+			else
+				goto out;
+			continue;
+		}
+
+		for (i = 0; i < NR_I_PARAMS; i++)
+			if (!strcmp(key, ioc_model_param_names[i]))
+				break;
+		if (i == NR_I_PARAMS ||
+		    kstrtoull(val, 10, &params[i]) || !params[i])
+			goto out;
+	}
+
+	spin_lock(&ioc->lock);
+	ioc->user_model = user;
+	if (user)
+		ioc_set_params(ioc, params);
+	else
+		ioc_set_default_params(ioc);
+	spin_unlock(&ioc->lock);
+
+	ret = 0;
+out:
+	blkg_conf_finish(&ctx);
+	return ret ?: nbytes;
+}
+
+static int ioc_weight_show(struct seq_file *sf, void *v)
+{
+	struct ioc_cgrp *iocc = blkcg_to_iocc(css_to_blkcg(seq_css(sf)));
+
+	seq_printf(sf, "%u\n", iocc ? iocc->dfl_weight : 0);
+	return 0;
+}
+
+static ssize_t ioc_weight_write(struct kernfs_open_file *of, char *buf,
+				size_t nbytes, loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	struct ioc_cgrp *iocc = blkcg_to_iocc(blkcg);
+	struct blkcg_gq *blkg;
+	unsigned int weight;
+	int ret;
+
+	ret = kstrtouint(strim(buf), 0, &weight);
+	if (ret)
+		return ret;
+	if (weight < CGROUP_WEIGHT_MIN || weight > CGROUP_WEIGHT_MAX)
+		return -ERANGE;
+
+	spin_lock_irq(&blkcg->lock);
+	iocc->dfl_weight = weight;
+	hlist_for_each_entry(blkg, &blkcg->blkg_list, blkcg_node) {
+		struct iocg *iocg = blkg_to_iocg(blkg);
+		struct ioc *ioc;
+
+		if (!iocg)
+			continue;
+		ioc = iocg->ioc;
+
+		spin_lock(&ioc->lock);
+		if (iocg->active && blkg->parent)
+			blkg_to_iocg(blkg->parent)->child_active_sum +=
+				weight - iocg->weight;
+		iocg->weight = weight;
+		atomic_inc(&ioc->hweight_gen);
+		spin_unlock(&ioc->lock);
+	}
+	spin_unlock_irq(&blkcg->lock);
+
+	return nbytes;
+}
+
+static size_t ioc_pd_stat(struct blkg_policy_data *pd, char *buf, size_t size)
+{
+	struct iocg *iocg = pd_to_iocg(pd);
+
+	return scnprintf(buf, size, " cost.usage=%llu cost.wait=%llu",
+			 div64_u64(atomic64_read(&iocg->abs_vusage),
+				   NSEC_PER_USEC),
+			 div64_u64(atomic64_read(&iocg->wait_ns),
+				   NSEC_PER_USEC));
+}
+
+static struct blkcg_policy_data *ioc_cpd_alloc(gfp_t gfp)
+{
+	struct ioc_cgrp *iocc;
+
+	iocc = kzalloc(sizeof(*iocc), gfp);
+	if (!iocc)
+		return NULL;
+	return &iocc->cpd;
+}
+
+static void ioc_cpd_init(struct blkcg_policy_data *cpd)
+{
+	container_of(cpd, struct ioc_cgrp, cpd)->dfl_weight = CGROUP_WEIGHT_DFL;
+}
+
+static void ioc_cpd_free(struct blkcg_policy_data *cpd)
+{
+	kfree(container_of(cpd, struct ioc_cgrp, cpd));
+}
+
+static struct blkg_policy_data *ioc_pd_alloc(gfp_t gfp, int node)
+{
+	struct iocg *iocg;
+
+	iocg = kzalloc_node(sizeof(*iocg), gfp, node);
+	if (!iocg)
+		return NULL;
+	return &iocg->pd;
+}
+
+static void ioc_pd_init(struct blkg_policy_data *pd)
+{
+	struct iocg *iocg = pd_to_iocg(pd);
+	struct blkcg_gq *blkg = iocg_to_blkg(iocg);
+	struct ioc *ioc = rqos_to_ioc(ioc_rq_qos(blkg->q));
+	struct ioc_cgrp *iocc = blkcg_to_iocc(blkg->blkcg);
+
+	iocg->ioc = ioc;
+	iocg->weight = iocc ? iocc->dfl_weight : CGROUP_WEIGHT_DFL;
+	INIT_LIST_HEAD(&iocg->active_list);
+	iocg->hweight_gen = atomic_read(&ioc->hweight_gen) - 1;
+	init_waitqueue_head(&iocg->waitq);
+	hrtimer_init(&iocg->waitq_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	iocg->waitq_timer.function = iocg_waitq_timer_fn;
+}
+
+static void ioc_pd_offline(struct blkg_policy_data *pd)
+{
+	struct iocg *iocg = pd_to_iocg(pd);
+	struct ioc *ioc = iocg->ioc;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ioc->lock, flags);
+	iocg_deactivate(iocg);
+	spin_unlock_irqrestore(&ioc->lock, flags);
+
+	hrtimer_cancel(&iocg->waitq_timer);
+}
+
+static void ioc_pd_free(struct blkg_policy_data *pd)
+{
+	kfree(pd_to_iocg(pd));
+}
+
+static struct cftype ioc_files[] = {
+	{
+		.name = "cost.weight",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = ioc_weight_show,
+		.write = ioc_weight_write,
+	},
+	{
+		.name = "cost.qos",
+		.flags = CFTYPE_ONLY_ON_ROOT,
+		.seq_show = ioc_qos_show,
+		.write = ioc_qos_write,
+	},
+	{
+		.name = "cost.model",
+		.flags = CFTYPE_ONLY_ON_ROOT,
+		.seq_show = ioc_model_show,
+		.write = ioc_model_write,
+	},
+	{}
+};
+
+static struct blkcg_policy blkcg_policy_iocost = {
+	.dfl_cftypes	= ioc_files,
+	.cpd_alloc_fn	= ioc_cpd_alloc,
+	.cpd_init_fn	= ioc_cpd_init,
+	.cpd_free_fn	= ioc_cpd_free,
+	.pd_alloc_fn	= ioc_pd_alloc,
+	.pd_init_fn	= ioc_pd_init,
+	.pd_offline_fn	= ioc_pd_offline,
+	.pd_free_fn	= ioc_pd_free,
+	.pd_stat_fn	= ioc_pd_stat,
+};
+
+static int __init ioc_init(void)
+{
+	return blkcg_policy_register(&blkcg_policy_iocost);
+}
+
+static void __exit ioc_exit(void)
+{
+	return blkcg_policy_unregister(&blkcg_policy_iocost);
+}
+
+module_init(ioc_init);
+module_exit(ioc_exit);
@@ -260,6 +260,8 @@ void blk_queue_split(struct request_queue *q, struct bio **bio)
 		break;
 	default:
 		split = blk_bio_segment_split(q, *bio, &q->bio_split, &nsegs);
+		/* bio_add_zone_append_page() builds bios that needn't split */
+		WARN_ON_ONCE(split && bio_op(*bio) == REQ_OP_ZONE_APPEND);
 		break;
 	}
 
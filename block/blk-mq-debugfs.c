@@ -140,6 +140,7 @@ static const char *const blk_queue_flag_name[] = {
 	QUEUE_FLAG_NAME(REGISTERED),
 	QUEUE_FLAG_NAME(SCSI_PASSTHROUGH),
 	QUEUE_FLAG_NAME(QUIESCED),
+	QUEUE_FLAG_NAME(STAGE_STATS),
 };
 #undef QUEUE_FLAG_NAME
 
@@ -190,6 +191,33 @@ static ssize_t queue_state_write(void *data, const char __user *buf,
 	return count;
 }
 
+static int queue_stage_stats_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+
+	seq_printf(m, "%d\n",
+		   test_bit(QUEUE_FLAG_STAGE_STATS, &q->queue_flags));
+	return 0;
+}
+
+static ssize_t queue_stage_stats_write(void *data, const char __user *buf,
+				       size_t count, loff_t *ppos)
+{
+	struct request_queue *q = data;
+	bool enable;
+	int ret;
+
+	ret = kstrtobool_from_user(buf, count, &enable);
+	if (ret)
+		return ret;
+
+	if (enable)
+		blk_queue_flag_set(QUEUE_FLAG_STAGE_STATS, q);
+	else
+		blk_queue_flag_clear(QUEUE_FLAG_STAGE_STATS, q);
+	return count;
+}
+
 static int queue_write_hint_show(void *data, struct seq_file *m)
 {
 	struct request_queue *q = data;
@@ -219,6 +247,7 @@ static const struct blk_mq_debugfs_attr blk_mq_debugfs_queue_attrs[] = {
 	{ "pm_only", 0600, queue_pm_only_show, NULL },
 	{ "state", 0600, queue_state_show, queue_state_write },
 	{ "write_hints", 0600, queue_write_hint_show, queue_write_hint_store },
+	{ "stage_stats", 0600, queue_stage_stats_show, queue_stage_stats_write },
 	{ "zone_wlock", 0400, queue_zone_wlock_show, NULL },
 	{ },
 };
@@ -337,6 +366,7 @@ static const char *const rqf_name[] = {
 	RQF_NAME(SPECIAL_PAYLOAD),
 	RQF_NAME(ZONE_WRITE_LOCKED),
 	RQF_NAME(MQ_POLL_SLEPT),
+	RQF_NAME(STAGE_STATS),
 };
 #undef RQF_NAME
 
@@ -586,6 +616,42 @@ static ssize_t hctx_dispatched_write(void *data, const char __user *buf,
 	return count;
 }
 
+static const char *const hctx_stage_name[] = {
+	[BLK_MQ_STAGE_PLUG]	= "plug",
+	[BLK_MQ_STAGE_SCHED]	= "sched",
+	[BLK_MQ_STAGE_DISPATCH]	= "dispatch",
+	[BLK_MQ_STAGE_DEVICE]	= "device",
+};
+
+/*
+ * One row per stage, one column per bucket: requests that spent less than
+ * 1, 2, 4, ... usecs in it, the last column being everything above.
+ */
+static int hctx_stage_time_show(void *data, struct seq_file *m)
+{
+	struct blk_mq_hw_ctx *hctx = data;
+	int i, j;
+
+	BUILD_BUG_ON(ARRAY_SIZE(hctx_stage_name) != BLK_MQ_STAGE_NR);
+
+	for (i = 0; i < BLK_MQ_STAGE_NR; i++) {
+		seq_printf(m, "%-8s", hctx_stage_name[i]);
+		for (j = 0; j < BLK_MQ_STAGE_BUCKETS; j++)
+			seq_printf(m, " %lu", hctx->stage_time[i][j]);
+		seq_puts(m, "\n");
+	}
+	return 0;
+}
+
+static ssize_t hctx_stage_time_write(void *data, const char __user *buf,
+				     size_t count, loff_t *ppos)
+{
+	struct blk_mq_hw_ctx *hctx = data;
+
+	memset(hctx->stage_time, 0, sizeof(hctx->stage_time));
+	return count;
+}
+
 static int hctx_queued_show(void *data, struct seq_file *m)
 {
 	struct blk_mq_hw_ctx *hctx = data;
@@ -796,6 +862,7 @@ static const struct blk_mq_debugfs_attr blk_mq_debugfs_hctx_attrs[] = {
 	{"dispatched", 0600, hctx_dispatched_show, hctx_dispatched_write},
 	{"queued", 0600, hctx_queued_show, hctx_queued_write},
 	{"run", 0600, hctx_run_show, hctx_run_write},
+	{"stage_time", 0600, hctx_stage_time_show, hctx_stage_time_write},
 	{"active", 0400, hctx_active_show},
 	{"dispatch_busy", 0400, hctx_dispatch_busy_show},
 	{},
@@ -211,6 +211,16 @@ void blk_mq_put_tag(struct blk_mq_hw_ctx *hctx, struct blk_mq_tags *tags,
 	}
 }
 
+/*
+ * Free @nr_tags non-reserved tags, given as offsets into bitmap_tags (that
+ * is, with nr_reserved_tags already subtracted).
+ */
+void blk_mq_put_tags(struct blk_mq_tags *tags, const int *tag_array,
+		     int nr_tags, unsigned int cpu)
+{
+	sbitmap_queue_clear_batch(&tags->bitmap_tags, tag_array, nr_tags, cpu);
+}
+
 struct bt_iter_data {
 	struct blk_mq_hw_ctx *hctx;
 	busy_iter_fn *fn;
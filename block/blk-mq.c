@@ -312,6 +312,11 @@ static struct request *blk_mq_rq_ctx_init(struct blk_mq_alloc_data *data,
 	rq->part = NULL;
 	rq->start_time_ns = ktime_get_ns();
 	rq->io_start_time_ns = 0;
+	if (test_bit(QUEUE_FLAG_STAGE_STATS, &data->q->queue_flags)) {
+		rq->rq_flags |= RQF_STAGE_STATS;
+		rq->insert_time_ns = rq->start_time_ns;
+		rq->dispatch_time_ns = 0;
+	}
 	rq->nr_phys_segments = 0;
 #if defined(CONFIG_BLK_DEV_INTEGRITY)
 	rq->nr_integrity_segments = 0;
@@ -485,7 +490,12 @@ static void __blk_mq_free_request(struct request *rq)
 	blk_queue_exit(q);
 }
 
-void blk_mq_free_request(struct request *rq)
+/*
+ * Everything blk_mq_free_request() does before dropping the request
+ * reference. Returns true if the caller now has to release the tags and
+ * the queue reference.
+ */
+static bool blk_mq_free_request_prep(struct request *rq)
 {
 	struct request_queue *q = rq->q;
 	struct elevator_queue *e = q->elevator;
@@ -514,11 +524,62 @@ void blk_mq_free_request(struct request *rq)
 		blk_put_rl(blk_rq_rl(rq));
 
 	WRITE_ONCE(rq->state, MQ_RQ_IDLE);
-	if (refcount_dec_and_test(&rq->ref))
+	return refcount_dec_and_test(&rq->ref);
+}
+
+void blk_mq_free_request(struct request *rq)
+{
+	if (blk_mq_free_request_prep(rq))
 		__blk_mq_free_request(rq);
 }
 EXPORT_SYMBOL_GPL(blk_mq_free_request);
 
+static unsigned int blk_mq_stage_bucket(u64 start, u64 end)
+{
+	u64 usecs;
+
+	if (!start || end <= start)
+		return 0;
+
+	usecs = div_u64(end - start, NSEC_PER_USEC);
+	if (!usecs)
+		return 0;
+
+	return min_t(unsigned int, ilog2(usecs) + 1, BLK_MQ_STAGE_BUCKETS - 1);
+}
+
+/*
+ * Account the time @rq spent in each stage to its hctx:
+ *
+ *   plug:     allocated until it left the plug list
+ *   sched:    until the first ->queue_rq() attempt, through the I/O
+ *             scheduler or the software queues
+ *   dispatch: until the driver started it, including requeues on busy
+ *   device:   until it completed
+ *
+ * Like the other hctx counters these are not atomic, and a hit may be lost
+ * when two CPUs complete requests of one hctx at the same time.
+ */
+static void blk_mq_account_stages(struct request *rq, u64 now)
+{
+	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(rq->q, rq->mq_ctx->cpu);
+
+	hctx->stage_time[BLK_MQ_STAGE_PLUG][blk_mq_stage_bucket(
+		rq->start_time_ns, rq->insert_time_ns)]++;
+	hctx->stage_time[BLK_MQ_STAGE_SCHED][blk_mq_stage_bucket(
+		rq->insert_time_ns, rq->dispatch_time_ns)]++;
+	hctx->stage_time[BLK_MQ_STAGE_DISPATCH][blk_mq_stage_bucket(
+		rq->dispatch_time_ns, rq->io_start_time_ns)]++;
+	hctx->stage_time[BLK_MQ_STAGE_DEVICE][blk_mq_stage_bucket(
+		rq->io_start_time_ns, now)]++;
+}
+
+static inline void blk_mq_stage_dispatch(struct request *rq)
+{
+	if ((rq->rq_flags & RQF_STAGE_STATS) && !rq->dispatch_time_ns)
+		rq->dispatch_time_ns = ktime_get_ns();
+}
+
 inline void __blk_mq_end_request(struct request *rq, blk_status_t error)
 {
 	u64 now = ktime_get_ns();
@@ -528,6 +589,9 @@ inline void __blk_mq_end_request(struct request *rq, blk_status_t error)
 		blk_stat_add(rq, now);
 	}
 
+	if (rq->rq_flags & RQF_STAGE_STATS)
+		blk_mq_account_stages(rq, now);
+
 	if (rq->internal_tag != -1)
 		blk_mq_sched_completed_request(rq, now);
 
@@ -552,6 +616,80 @@ void blk_mq_end_request(struct request *rq, blk_status_t error)
 }
 EXPORT_SYMBOL(blk_mq_end_request);
 
+#define BLK_MQ_TAG_BATCH	32
+
+static void blk_mq_flush_tag_batch(struct blk_mq_hw_ctx *hctx, int *tags,
+				   int nr_tags, unsigned int cpu)
+{
+	blk_mq_put_tags(hctx->tags, tags, nr_tags, cpu);
+	blk_mq_sched_restart(hctx);
+	percpu_ref_put_many(&hctx->queue->q_usage_counter, nr_tags);
+}
+
+/**
+ * blk_mq_end_request_batch - end a batch of successfully completed requests
+ * @rqs: requests to end
+ * @nr: number of requests in @rqs
+ *
+ * Same as calling blk_mq_end_request(rq, BLK_STS_OK) on each request, but
+ * the driver tags of consecutive requests from the same hardware queue are
+ * freed with one atomic operation per sbitmap word, and the queue usage
+ * counter is dropped once per batch. Meant for drivers that reap many
+ * completions per interrupt. Requests with an end_io callback, a scheduler
+ * tag or a reserved tag take the regular path.
+ */
+void blk_mq_end_request_batch(struct request **rqs, unsigned int nr)
+{
+	struct blk_mq_hw_ctx *cur_hctx = NULL;
+	int tags[BLK_MQ_TAG_BATCH];
+	unsigned int i, cpu = 0;
+	int nr_tags = 0;
+	u64 now = 0;
+
+	for (i = 0; i < nr; i++) {
+		struct request *rq = rqs[i];
+		struct blk_mq_hw_ctx *hctx;
+
+		if (blk_update_request(rq, BLK_STS_OK, blk_rq_bytes(rq)))
+			BUG();
+
+		hctx = blk_mq_map_queue(rq->q, rq->mq_ctx->cpu);
+		if (rq->end_io || blk_bidi_rq(rq) || rq->internal_tag != -1 ||
+		    rq->tag == -1 || blk_mq_tag_is_reserved(hctx->tags, rq->tag)) {
+			__blk_mq_end_request(rq, BLK_STS_OK);
+			continue;
+		}
+
+		if (!now)
+			now = ktime_get_ns();
+		if (rq->rq_flags & RQF_STATS) {
+			blk_mq_poll_stats_start(rq->q);
+			blk_stat_add(rq, now);
+		}
+		if (rq->rq_flags & RQF_STAGE_STATS)
+			blk_mq_account_stages(rq, now);
+		blk_account_io_done(rq, now);
+
+		if (!blk_mq_free_request_prep(rq))
+			continue;
+
+		blk_pm_mark_last_busy(rq);
+		if (hctx != cur_hctx || nr_tags == BLK_MQ_TAG_BATCH) {
+			if (nr_tags)
+				blk_mq_flush_tag_batch(cur_hctx, tags, nr_tags,
+						       cpu);
+			cur_hctx = hctx;
+			nr_tags = 0;
+		}
+		cpu = rq->mq_ctx->cpu;
+		tags[nr_tags++] = rq->tag - hctx->tags->nr_reserved_tags;
+	}
+
+	if (nr_tags)
+		blk_mq_flush_tag_batch(cur_hctx, tags, nr_tags, cpu);
+}
+EXPORT_SYMBOL(blk_mq_end_request_batch);
+
 static void __blk_mq_complete_request_remote(void *data)
 {
 	struct request *rq = data;
@@ -638,6 +776,37 @@ void blk_mq_complete_request(struct request *rq)
 }
 EXPORT_SYMBOL(blk_mq_complete_request);
 
+/**
+ * blk_mq_complete_request_batch - try to claim a request for batched ending
+ * @rq:		the request being processed
+ *
+ * Description:
+ *	For drivers that reap many completions in one go. If @rq may be ended
+ *	on the current CPU, it is marked complete and true is returned; the
+ *	caller must then end it, typically through blk_mq_end_request_batch().
+ *	Otherwise the request is passed on to blk_mq_complete_request() and
+ *	false is returned.
+ **/
+bool blk_mq_complete_request_batch(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	int cpu = raw_smp_processor_id();
+
+	if (q->nr_hw_queues == 1 ||
+	    (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags) &&
+	     cpu != rq->mq_ctx->cpu &&
+	     (test_bit(QUEUE_FLAG_SAME_FORCE, &q->queue_flags) ||
+	      !cpus_share_cache(cpu, rq->mq_ctx->cpu)))) {
+		blk_mq_complete_request(rq);
+		return false;
+	}
+
+	if (unlikely(blk_should_fake_timeout(q)))
+		return false;
+	return blk_mq_mark_complete(rq);
+}
+EXPORT_SYMBOL(blk_mq_complete_request_batch);
+
 int blk_mq_request_started(struct request *rq)
 {
 	return blk_mq_rq_state(rq) != MQ_RQ_IDLE;
@@ -659,6 +828,8 @@ void blk_mq_start_request(struct request *rq)
 #endif
 		rq->rq_flags |= RQF_STATS;
 		rq_qos_issue(q, rq);
+	} else if (rq->rq_flags & RQF_STAGE_STATS) {
+		rq->io_start_time_ns = ktime_get_ns();
 	}
 
 	WARN_ON_ONCE(blk_mq_rq_state(rq) != MQ_RQ_IDLE);
@@ -1189,6 +1360,7 @@ bool blk_mq_dispatch_rq_list(struct request_queue *q, struct list_head *list,
 			bd.last = !blk_mq_get_driver_tag(nxt);
 		}
 
+		blk_mq_stage_dispatch(rq);
 		ret = q->mq_ops->queue_rq(hctx, &bd);
 		if (ret == BLK_STS_RESOURCE || ret == BLK_STS_DEV_RESOURCE) {
 			/*
@@ -1216,6 +1388,14 @@ bool blk_mq_dispatch_rq_list(struct request_queue *q, struct list_head *list,
 
 	hctx->dispatched[queued_to_index(queued)]++;
 
+	/*
+	 * If we didn't flush the entire list, we could have told
+	 * the driver there was more coming, but that turned out to
+	 * be a lie.
+	 */
+	if ((!list_empty(list) || errors) && q->mq_ops->commit_rqs && queued)
+		q->mq_ops->commit_rqs(hctx);
+
 	/*
 	 * Any items that need requeuing? Stuff them into hctx->dispatch,
 	 * that is where we will continue on next queue run.
@@ -1622,6 +1802,18 @@ static int plug_ctx_cmp(void *priv, struct list_head *a, struct list_head *b)
 		  blk_rq_pos(rqa) < blk_rq_pos(rqb)));
 }
 
+/* True if all requests on @list were allocated from the same ctx */
+static bool plug_list_single_ctx(struct list_head *list)
+{
+	struct blk_mq_ctx *ctx = list_entry_rq(list->next)->mq_ctx;
+	struct request *rq;
+
+	list_for_each_entry(rq, list, queuelist)
+		if (rq->mq_ctx != ctx)
+			return false;
+	return true;
+}
+
 void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 {
 	struct blk_mq_ctx *this_ctx;
@@ -1630,10 +1822,17 @@ void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 	LIST_HEAD(list);
 	LIST_HEAD(ctx_list);
 	unsigned int depth;
+	u64 now = 0;
 
 	list_splice_init(&plug->mq_list, &list);
 
-	list_sort(NULL, &list, plug_ctx_cmp);
+	/*
+	 * The list only needs grouping by ctx, which it already is when a
+	 * single task plugged without migrating. Don't pay for a sort by
+	 * sector in that case, the I/O schedulers order requests themselves.
+	 */
+	if (!list_empty(&list) && !plug_list_single_ctx(&list))
+		list_sort(NULL, &list, plug_ctx_cmp);
 
 	this_q = NULL;
 	this_ctx = NULL;
@@ -1643,6 +1842,11 @@ void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 		rq = list_entry_rq(list.next);
 		list_del_init(&rq->queuelist);
 		BUG_ON(!rq->q);
+		if (rq->rq_flags & RQF_STAGE_STATS) {
+			if (!now)
+				now = ktime_get_ns();
+			rq->insert_time_ns = now;
+		}
 		if (rq->mq_ctx != this_ctx) {
 			if (this_ctx) {
 				trace_block_unplug(this_q, depth, !from_schedule);
@@ -1690,12 +1894,12 @@ static blk_qc_t request_to_qc_t(struct blk_mq_hw_ctx *hctx, struct request *rq)
 
 static blk_status_t __blk_mq_issue_directly(struct blk_mq_hw_ctx *hctx,
 					    struct request *rq,
-					    blk_qc_t *cookie)
+					    blk_qc_t *cookie, bool last)
 {
 	struct request_queue *q = rq->q;
 	struct blk_mq_queue_data bd = {
 		.rq = rq,
-		.last = true,
+		.last = last,
 	};
 	blk_qc_t new_cookie;
 	blk_status_t ret;
@@ -1707,6 +1911,7 @@ static blk_status_t __blk_mq_issue_directly(struct blk_mq_hw_ctx *hctx,
 	 * Any other error (busy), just add it to our list as we
 	 * previously would have done.
 	 */
+	blk_mq_stage_dispatch(rq);
 	ret = q->mq_ops->queue_rq(hctx, &bd);
 	switch (ret) {
 	case BLK_STS_OK:
@@ -1730,7 +1935,7 @@ static blk_status_t __blk_mq_issue_directly(struct blk_mq_hw_ctx *hctx,
 static blk_status_t __blk_mq_try_issue_directly(struct blk_mq_hw_ctx *hctx,
 						struct request *rq,
 						blk_qc_t *cookie,
-						bool bypass_insert)
+						bool bypass_insert, bool last)
 {
 	struct request_queue *q = rq->q;
 	bool run_queue = true;
@@ -1759,7 +1964,7 @@ static blk_status_t __blk_mq_try_issue_directly(struct blk_mq_hw_ctx *hctx,
 		goto insert;
 	}
 
-	return __blk_mq_issue_directly(hctx, rq, cookie);
+	return __blk_mq_issue_directly(hctx, rq, cookie, last);
 insert:
 	if (bypass_insert)
 		return BLK_STS_RESOURCE;
@@ -1778,7 +1983,7 @@ static void blk_mq_try_issue_directly(struct blk_mq_hw_ctx *hctx,
 
 	hctx_lock(hctx, &srcu_idx);
 
-	ret = __blk_mq_try_issue_directly(hctx, rq, cookie, false);
+	ret = __blk_mq_try_issue_directly(hctx, rq, cookie, false, true);
 	if (ret == BLK_STS_RESOURCE || ret == BLK_STS_DEV_RESOURCE)
 		blk_mq_request_bypass_insert(rq, true);
 	else if (ret != BLK_STS_OK)
@@ -1787,7 +1992,7 @@ static void blk_mq_try_issue_directly(struct blk_mq_hw_ctx *hctx,
 	hctx_unlock(hctx, srcu_idx);
 }
 
-blk_status_t blk_mq_request_issue_directly(struct request *rq)
+blk_status_t blk_mq_request_issue_directly(struct request *rq, bool last)
 {
 	blk_status_t ret;
 	int srcu_idx;
@@ -1796,7 +2001,7 @@ blk_status_t blk_mq_request_issue_directly(struct request *rq)
 	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(rq->q, ctx->cpu);
 
 	hctx_lock(hctx, &srcu_idx);
-	ret = __blk_mq_try_issue_directly(hctx, rq, &unused_cookie, true);
+	ret = __blk_mq_try_issue_directly(hctx, rq, &unused_cookie, true, last);
 	hctx_unlock(hctx, srcu_idx);
 
 	return ret;
@@ -1805,13 +2010,21 @@ blk_status_t blk_mq_request_issue_directly(struct request *rq)
 void blk_mq_try_issue_list_directly(struct blk_mq_hw_ctx *hctx,
 		struct list_head *list)
 {
+	bool has_commit = hctx->queue->mq_ops->commit_rqs;
+	blk_status_t ret = BLK_STS_OK;
+	int queued = 0;
+
 	while (!list_empty(list)) {
-		blk_status_t ret;
 		struct request *rq = list_first_entry(list, struct request,
 				queuelist);
 
 		list_del_init(&rq->queuelist);
-		ret = blk_mq_request_issue_directly(rq);
+		/*
+		 * Without ->commit_rqs a driver that waits for bd->last (e.g.
+		 * ataflop, skd) could never be told the list ended early.
+		 */
+		ret = blk_mq_request_issue_directly(rq,
+				list_empty(list) || !has_commit);
 		if (ret != BLK_STS_OK) {
 			if (ret == BLK_STS_RESOURCE ||
 					ret == BLK_STS_DEV_RESOURCE) {
@@ -1820,8 +2033,48 @@ void blk_mq_try_issue_list_directly(struct blk_mq_hw_ctx *hctx,
 				break;
 			}
 			blk_mq_end_request(rq, ret);
-		}
+		} else
+			queued++;
 	}
+
+	/*
+	 * If we didn't flush the entire list, we could have told
+	 * the driver there was more coming, but that turned out to
+	 * be a lie.
+	 */
+	if ((!list_empty(list) || ret != BLK_STS_OK) && has_commit && queued)
+		hctx->queue->mq_ops->commit_rqs(hctx);
+}
+
+/*
+ * Random I/O on fast devices almost never merges, while every attempt walks
+ * the plug list and takes the scheduler or ctx lock. When fewer than one in
+ * BLK_MQ_MERGE_MIN_RATIO of the last BLK_MQ_MERGE_WINDOW attempts from a ctx
+ * succeeded, skip merging for the next BLK_MQ_MERGE_SKIP bios from it. The
+ * counters are per cpu and only a heuristic, racing updates after a
+ * migration are harmless.
+ */
+#define BLK_MQ_MERGE_WINDOW	64
+#define BLK_MQ_MERGE_MIN_RATIO	32
+#define BLK_MQ_MERGE_SKIP	1024
+
+static bool blk_mq_merge_allowed(struct blk_mq_ctx *ctx)
+{
+	if (likely(!ctx->merge_skip))
+		return true;
+	ctx->merge_skip--;
+	return false;
+}
+
+static void blk_mq_merge_account(struct blk_mq_ctx *ctx, bool merged)
+{
+	ctx->merge_hits += merged;
+	if (++ctx->merge_tries < BLK_MQ_MERGE_WINDOW)
+		return;
+	if (ctx->merge_hits * BLK_MQ_MERGE_MIN_RATIO < ctx->merge_tries)
+		ctx->merge_skip = BLK_MQ_MERGE_SKIP;
+	ctx->merge_tries = 0;
+	ctx->merge_hits = 0;
 }
 
 static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
@@ -1833,6 +2086,8 @@ static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	unsigned int request_count = 0;
 	struct blk_plug *plug;
 	struct request *same_queue_rq = NULL;
+	struct blk_mq_ctx *merge_ctx;
+	bool skip_merge, nomerges;
 	blk_qc_t cookie;
 
 	blk_queue_bounce(q, &bio);
@@ -1842,12 +2097,24 @@ static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	if (!bio_integrity_prep(bio))
 		return BLK_QC_T_NONE;
 
-	if (!is_flush_fua && !blk_queue_nomerges(q) &&
-	    blk_attempt_plug_merge(q, bio, &request_count, &same_queue_rq))
-		return BLK_QC_T_NONE;
+	merge_ctx = __blk_mq_get_ctx(q, raw_smp_processor_id());
+	skip_merge = !blk_mq_merge_allowed(merge_ctx);
+	nomerges = skip_merge || blk_queue_nomerges(q);
 
-	if (blk_mq_sched_bio_merge(q, bio))
+	if (!is_flush_fua && !nomerges &&
+	    blk_attempt_plug_merge(q, bio, &request_count, &same_queue_rq)) {
+		blk_mq_merge_account(merge_ctx, true);
 		return BLK_QC_T_NONE;
+	}
+
+	if (!skip_merge) {
+		bool merged = blk_mq_sched_bio_merge(q, bio);
+
+		if (!is_flush_fua)
+			blk_mq_merge_account(merge_ctx, merged);
+		if (merged)
+			return BLK_QC_T_NONE;
+	}
 
 	rq_qos_throttle(q, bio, NULL);
 
@@ -1885,7 +2152,7 @@ static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 		 */
 		if (list_empty(&plug->mq_list))
 			request_count = 0;
-		else if (blk_queue_nomerges(q))
+		else if (nomerges)
 			request_count = blk_plug_queued_count(q);
 
 		if (!request_count)
@@ -1900,7 +2167,7 @@ static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 		}
 
 		list_add_tail(&rq->queuelist, &plug->mq_list);
-	} else if (plug && !blk_queue_nomerges(q)) {
+	} else if (plug && !nomerges) {
 		blk_mq_bio_to_request(rq, bio);
 
 		/*
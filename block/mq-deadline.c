@@ -32,11 +32,12 @@ static const int writes_starved = 2;    /* max times reads can starve a write */
 static const int fifo_batch = 16;       /* # of sequential requests treated as one
 				     by the above parameters. For throughput. */
 
-struct deadline_data {
-	/*
-	 * run time data
-	 */
-
+/*
+ * The sort and fifo lists along with the lock protecting them. mq-deadline
+ * has a single one shared by all hardware queues, mq-deadline-hctx has one
+ * per hardware queue so that fast multiqueue devices don't serialize on it.
+ */
+struct dd_queue {
 	/*
 	 * requests (deadline_rq s) are present on both sort_list and fifo_list
 	 */
@@ -50,6 +51,24 @@ struct deadline_data {
 	unsigned int batching;		/* number of sequential requests made */
 	unsigned int starved;		/* times reads have starved writes */
 
+	/*
+	 * expiry time of the oldest request on each fifo, 0 if empty. Read
+	 * without the lock by the other hardware queues, see dd_kick_expired().
+	 */
+	unsigned long fifo_head_time[2];
+
+	spinlock_t lock;
+	struct list_head dispatch;
+};
+
+struct deadline_data {
+	/*
+	 * run time data
+	 */
+	struct dd_queue shared;
+	bool per_hctx;
+	unsigned long last_expired_check;
+
 	/*
 	 * settings that change how the i/o scheduler behaves
 	 */
@@ -58,15 +77,29 @@ struct deadline_data {
 	int writes_starved;
 	int front_merges;
 
-	spinlock_t lock;
 	spinlock_t zone_lock;
-	struct list_head dispatch;
 };
 
+static struct elevator_type mq_deadline_hctx;
+
+static inline struct dd_queue *
+dd_hctx_queue(struct deadline_data *dd, struct blk_mq_hw_ctx *hctx)
+{
+	return dd->per_hctx ? hctx->sched_data : &dd->shared;
+}
+
+static inline struct dd_queue *
+dd_rq_queue(struct deadline_data *dd, struct request *rq)
+{
+	if (!dd->per_hctx)
+		return &dd->shared;
+	return blk_mq_map_queue(rq->q, rq->mq_ctx->cpu)->sched_data;
+}
+
 static inline struct rb_root *
-deadline_rb_root(struct deadline_data *dd, struct request *rq)
+deadline_rb_root(struct dd_queue *ddq, struct request *rq)
 {
-	return &dd->sort_list[rq_data_dir(rq)];
+	return &ddq->sort_list[rq_data_dir(rq)];
 }
 
 /*
@@ -84,30 +117,39 @@ deadline_latter_request(struct request *rq)
 }
 
 static void
-deadline_add_rq_rb(struct deadline_data *dd, struct request *rq)
+deadline_add_rq_rb(struct dd_queue *ddq, struct request *rq)
 {
-	struct rb_root *root = deadline_rb_root(dd, rq);
+	struct rb_root *root = deadline_rb_root(ddq, rq);
 
 	elv_rb_add(root, rq);
 }
 
 static inline void
-deadline_del_rq_rb(struct deadline_data *dd, struct request *rq)
+deadline_del_rq_rb(struct dd_queue *ddq, struct request *rq)
 {
 	const int data_dir = rq_data_dir(rq);
 
-	if (dd->next_rq[data_dir] == rq)
-		dd->next_rq[data_dir] = deadline_latter_request(rq);
+	if (ddq->next_rq[data_dir] == rq)
+		ddq->next_rq[data_dir] = deadline_latter_request(rq);
 
-	elv_rb_del(deadline_rb_root(dd, rq), rq);
+	elv_rb_del(deadline_rb_root(ddq, rq), rq);
+}
+
+static inline void deadline_update_fifo_head(struct dd_queue *ddq, int ddir)
+{
+	unsigned long t = 0;
+
+	if (!list_empty(&ddq->fifo_list[ddir]))
+		t = rq_entry_fifo(ddq->fifo_list[ddir].next)->fifo_time ?: 1;
+	WRITE_ONCE(ddq->fifo_head_time[ddir], t);
 }
 
 /*
  * remove rq from rbtree and fifo.
  */
-static void deadline_remove_request(struct request_queue *q, struct request *rq)
+static void deadline_remove_request(struct dd_queue *ddq, struct request *rq)
 {
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct request_queue *q = rq->q;
 
 	list_del_init(&rq->queuelist);
 
@@ -115,7 +157,7 @@ static void deadline_remove_request(struct request_queue *q, struct request *rq)
 	 * We might not be on the rbtree, if we are doing an insert merge
 	 */
 	if (!RB_EMPTY_NODE(&rq->rb_node))
-		deadline_del_rq_rb(dd, rq);
+		deadline_del_rq_rb(ddq, rq);
 
 	elv_rqhash_del(q, rq);
 	if (q->last_merge == rq)
@@ -126,19 +168,22 @@ static void dd_request_merged(struct request_queue *q, struct request *req,
 			      enum elv_merge type)
 {
 	struct deadline_data *dd = q->elevator->elevator_data;
+	struct dd_queue *ddq = dd_rq_queue(dd, req);
 
 	/*
 	 * if the merge was a front merge, we need to reposition request
 	 */
 	if (type == ELEVATOR_FRONT_MERGE) {
-		elv_rb_del(deadline_rb_root(dd, req), req);
-		deadline_add_rq_rb(dd, req);
+		elv_rb_del(deadline_rb_root(ddq, req), req);
+		deadline_add_rq_rb(ddq, req);
 	}
 }
 
 static void dd_merged_requests(struct request_queue *q, struct request *req,
 			       struct request *next)
 {
+	struct deadline_data *dd = q->elevator->elevator_data;
+
 	/*
 	 * if next expires before rq, assign its expire time to rq
 	 * and move into next position (next will be deleted) in fifo
@@ -154,34 +199,35 @@ static void dd_merged_requests(struct request_queue *q, struct request *req,
 	/*
 	 * kill knowledge of next, this one is a goner
 	 */
-	deadline_remove_request(q, next);
+	deadline_remove_request(dd_rq_queue(dd, next), next);
+	deadline_update_fifo_head(dd_rq_queue(dd, req), rq_data_dir(req));
 }
 
 /*
  * move an entry to dispatch queue
  */
 static void
-deadline_move_request(struct deadline_data *dd, struct request *rq)
+deadline_move_request(struct dd_queue *ddq, struct request *rq)
 {
 	const int data_dir = rq_data_dir(rq);
 
-	dd->next_rq[READ] = NULL;
-	dd->next_rq[WRITE] = NULL;
-	dd->next_rq[data_dir] = deadline_latter_request(rq);
+	ddq->next_rq[READ] = NULL;
+	ddq->next_rq[WRITE] = NULL;
+	ddq->next_rq[data_dir] = deadline_latter_request(rq);
 
 	/*
 	 * take it off the sort and fifo list
 	 */
-	deadline_remove_request(rq->q, rq);
+	deadline_remove_request(ddq, rq);
 }
 
 /*
  * deadline_check_fifo returns 0 if there are no expired requests on the fifo,
- * 1 otherwise. Requires !list_empty(&dd->fifo_list[data_dir])
+ * 1 otherwise. Requires !list_empty(&ddq->fifo_list[data_dir])
  */
-static inline int deadline_check_fifo(struct deadline_data *dd, int ddir)
+static inline int deadline_check_fifo(struct dd_queue *ddq, int ddir)
 {
-	struct request *rq = rq_entry_fifo(dd->fifo_list[ddir].next);
+	struct request *rq = rq_entry_fifo(ddq->fifo_list[ddir].next);
 
 	/*
 	 * rq is expired!
@@ -197,7 +243,8 @@ static inline int deadline_check_fifo(struct deadline_data *dd, int ddir)
  * dispatch using arrival ordered lists.
  */
 static struct request *
-deadline_fifo_request(struct deadline_data *dd, int data_dir)
+deadline_fifo_request(struct deadline_data *dd, struct dd_queue *ddq,
+		      int data_dir)
 {
 	struct request *rq;
 	unsigned long flags;
@@ -205,10 +252,10 @@ deadline_fifo_request(struct deadline_data *dd, int data_dir)
 	if (WARN_ON_ONCE(data_dir != READ && data_dir != WRITE))
 		return NULL;
 
-	if (list_empty(&dd->fifo_list[data_dir]))
+	if (list_empty(&ddq->fifo_list[data_dir]))
 		return NULL;
 
-	rq = rq_entry_fifo(dd->fifo_list[data_dir].next);
+	rq = rq_entry_fifo(ddq->fifo_list[data_dir].next);
 	if (data_dir == READ || !blk_queue_is_zoned(rq->q))
 		return rq;
 
@@ -217,7 +264,7 @@ deadline_fifo_request(struct deadline_data *dd, int data_dir)
 	 * an unlocked target zone.
 	 */
 	spin_lock_irqsave(&dd->zone_lock, flags);
-	list_for_each_entry(rq, &dd->fifo_list[WRITE], queuelist) {
+	list_for_each_entry(rq, &ddq->fifo_list[WRITE], queuelist) {
 		if (blk_req_can_dispatch_to_zone(rq))
 			goto out;
 	}
@@ -233,7 +280,8 @@ deadline_fifo_request(struct deadline_data *dd, int data_dir)
  * dispatch using sector position sorted lists.
  */
 static struct request *
-deadline_next_request(struct deadline_data *dd, int data_dir)
+deadline_next_request(struct deadline_data *dd, struct dd_queue *ddq,
+		      int data_dir)
 {
 	struct request *rq;
 	unsigned long flags;
@@ -241,7 +289,7 @@ deadline_next_request(struct deadline_data *dd, int data_dir)
 	if (WARN_ON_ONCE(data_dir != READ && data_dir != WRITE))
 		return NULL;
 
-	rq = dd->next_rq[data_dir];
+	rq = ddq->next_rq[data_dir];
 	if (!rq)
 		return NULL;
 
@@ -267,29 +315,30 @@ deadline_next_request(struct deadline_data *dd, int data_dir)
  * deadline_dispatch_requests selects the best request according to
  * read/write expire, fifo_batch, etc
  */
-static struct request *__dd_dispatch_request(struct deadline_data *dd)
+static struct request *__dd_dispatch_request(struct deadline_data *dd,
+					     struct dd_queue *ddq)
 {
 	struct request *rq, *next_rq;
 	bool reads, writes;
 	int data_dir;
 
-	if (!list_empty(&dd->dispatch)) {
-		rq = list_first_entry(&dd->dispatch, struct request, queuelist);
+	if (!list_empty(&ddq->dispatch)) {
+		rq = list_first_entry(&ddq->dispatch, struct request, queuelist);
 		list_del_init(&rq->queuelist);
 		goto done;
 	}
 
-	reads = !list_empty(&dd->fifo_list[READ]);
-	writes = !list_empty(&dd->fifo_list[WRITE]);
+	reads = !list_empty(&ddq->fifo_list[READ]);
+	writes = !list_empty(&ddq->fifo_list[WRITE]);
 
 	/*
 	 * batches are currently reads XOR writes
 	 */
-	rq = deadline_next_request(dd, WRITE);
+	rq = deadline_next_request(dd, ddq, WRITE);
 	if (!rq)
-		rq = deadline_next_request(dd, READ);
+		rq = deadline_next_request(dd, ddq, READ);
 
-	if (rq && dd->batching < dd->fifo_batch)
+	if (rq && ddq->batching < dd->fifo_batch)
 		/* we have a next request are still entitled to batch */
 		goto dispatch_request;
 
@@ -299,10 +348,10 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd)
 	 */
 
 	if (reads) {
-		BUG_ON(RB_EMPTY_ROOT(&dd->sort_list[READ]));
+		BUG_ON(RB_EMPTY_ROOT(&ddq->sort_list[READ]));
 
-		if (deadline_fifo_request(dd, WRITE) &&
-		    (dd->starved++ >= dd->writes_starved))
+		if (deadline_fifo_request(dd, ddq, WRITE) &&
+		    (ddq->starved++ >= dd->writes_starved))
 			goto dispatch_writes;
 
 		data_dir = READ;
@@ -316,9 +365,9 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd)
 
 	if (writes) {
 dispatch_writes:
-		BUG_ON(RB_EMPTY_ROOT(&dd->sort_list[WRITE]));
+		BUG_ON(RB_EMPTY_ROOT(&ddq->sort_list[WRITE]));
 
-		dd->starved = 0;
+		ddq->starved = 0;
 
 		data_dir = WRITE;
 
@@ -331,14 +380,14 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd)
 	/*
 	 * we are not running a batch, find best request for selected data_dir
 	 */
-	next_rq = deadline_next_request(dd, data_dir);
-	if (deadline_check_fifo(dd, data_dir) || !next_rq) {
+	next_rq = deadline_next_request(dd, ddq, data_dir);
+	if (deadline_check_fifo(ddq, data_dir) || !next_rq) {
 		/*
 		 * A deadline has expired, the last request was in the other
 		 * direction, or we have run out of higher-sectored requests.
 		 * Start again from the request with the earliest expiry time.
 		 */
-		rq = deadline_fifo_request(dd, data_dir);
+		rq = deadline_fifo_request(dd, ddq, data_dir);
 	} else {
 		/*
 		 * The last req was the same dir and we have a next request in
@@ -354,14 +403,15 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd)
 	if (!rq)
 		return NULL;
 
-	dd->batching = 0;
+	ddq->batching = 0;
 
 dispatch_request:
 	/*
 	 * rq is the selected appropriate request.
 	 */
-	dd->batching++;
-	deadline_move_request(dd, rq);
+	ddq->batching++;
+	deadline_move_request(ddq, rq);
+	deadline_update_fifo_head(ddq, rq_data_dir(rq));
 done:
 	/*
 	 * If the request needs its target zone locked, do it.
@@ -371,30 +421,80 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd)
 	return rq;
 }
 
+static bool dd_queue_expired(struct dd_queue *ddq, unsigned long now)
+{
+	unsigned long r = READ_ONCE(ddq->fifo_head_time[READ]);
+	unsigned long w = READ_ONCE(ddq->fifo_head_time[WRITE]);
+
+	return (r && time_after_eq(now, r)) || (w && time_after_eq(now, w));
+}
+
+/*
+ * The per-hctx lists only protect requests from starving behind others on
+ * the same hardware queue. A hardware queue that hasn't been run in a while,
+ * e.g. because the others kept the shared tags or host busy, can still hold
+ * expired requests. Once per jiffy, in whichever queue happens to dispatch
+ * first, look at everybody's oldest request without taking their locks and
+ * kick the queues that have run past a deadline.
+ */
+static void dd_kick_expired(struct deadline_data *dd,
+			    struct blk_mq_hw_ctx *hctx)
+{
+	unsigned long now = jiffies;
+	unsigned long last = READ_ONCE(dd->last_expired_check);
+	struct blk_mq_hw_ctx *h;
+	int i;
+
+	if (last == now || cmpxchg(&dd->last_expired_check, last, now) != last)
+		return;
+
+	queue_for_each_hw_ctx(hctx->queue, h, i) {
+		if (h == hctx || !h->sched_data || blk_mq_hctx_stopped(h))
+			continue;
+		if (dd_queue_expired(h->sched_data, now))
+			blk_mq_run_hw_queue(h, true);
+	}
+}
+
 /*
  * One confusing aspect here is that we get called for a specific
  * hardware queue, but we return a request that may not be for a
  * different hardware queue. This is because mq-deadline has shared
  * state for all hardware queues, in terms of sorting, FIFOs, etc.
+ * mq-deadline-hctx doesn't, it only ever returns requests for @hctx.
  */
 static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 {
 	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	struct dd_queue *ddq = dd_hctx_queue(dd, hctx);
 	struct request *rq;
 
-	spin_lock(&dd->lock);
-	rq = __dd_dispatch_request(dd);
-	spin_unlock(&dd->lock);
+	spin_lock(&ddq->lock);
+	rq = __dd_dispatch_request(dd, ddq);
+	spin_unlock(&ddq->lock);
+
+	if (dd->per_hctx && hctx->queue->nr_hw_queues > 1)
+		dd_kick_expired(dd, hctx);
 
 	return rq;
 }
 
+static void dd_init_dd_queue(struct dd_queue *ddq)
+{
+	INIT_LIST_HEAD(&ddq->fifo_list[READ]);
+	INIT_LIST_HEAD(&ddq->fifo_list[WRITE]);
+	ddq->sort_list[READ] = RB_ROOT;
+	ddq->sort_list[WRITE] = RB_ROOT;
+	spin_lock_init(&ddq->lock);
+	INIT_LIST_HEAD(&ddq->dispatch);
+}
+
 static void dd_exit_queue(struct elevator_queue *e)
 {
 	struct deadline_data *dd = e->elevator_data;
 
-	BUG_ON(!list_empty(&dd->fifo_list[READ]));
-	BUG_ON(!list_empty(&dd->fifo_list[WRITE]));
+	BUG_ON(!list_empty(&dd->shared.fifo_list[READ]));
+	BUG_ON(!list_empty(&dd->shared.fifo_list[WRITE]));
 
 	kfree(dd);
 }
@@ -418,23 +518,49 @@ static int dd_init_queue(struct request_queue *q, struct elevator_type *e)
 	}
 	eq->elevator_data = dd;
 
-	INIT_LIST_HEAD(&dd->fifo_list[READ]);
-	INIT_LIST_HEAD(&dd->fifo_list[WRITE]);
-	dd->sort_list[READ] = RB_ROOT;
-	dd->sort_list[WRITE] = RB_ROOT;
+	dd_init_dd_queue(&dd->shared);
+	dd->per_hctx = e == &mq_deadline_hctx;
 	dd->fifo_expire[READ] = read_expire;
 	dd->fifo_expire[WRITE] = write_expire;
 	dd->writes_starved = writes_starved;
 	dd->front_merges = 1;
 	dd->fifo_batch = fifo_batch;
-	spin_lock_init(&dd->lock);
 	spin_lock_init(&dd->zone_lock);
-	INIT_LIST_HEAD(&dd->dispatch);
 
 	q->elevator = eq;
 	return 0;
 }
 
+static int dd_init_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
+{
+	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	struct dd_queue *ddq;
+
+	if (!dd->per_hctx)
+		return 0;
+
+	ddq = kzalloc_node(sizeof(*ddq), GFP_KERNEL, hctx->numa_node);
+	if (!ddq)
+		return -ENOMEM;
+	dd_init_dd_queue(ddq);
+	hctx->sched_data = ddq;
+	return 0;
+}
+
+static void dd_exit_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
+{
+	struct dd_queue *ddq = hctx->sched_data;
+
+	if (!ddq)
+		return;
+
+	BUG_ON(!list_empty(&ddq->fifo_list[READ]));
+	BUG_ON(!list_empty(&ddq->fifo_list[WRITE]));
+
+	kfree(ddq);
+	hctx->sched_data = NULL;
+}
+
 static int dd_request_merge(struct request_queue *q, struct request **rq,
 			    struct bio *bio)
 {
@@ -445,7 +571,7 @@ static int dd_request_merge(struct request_queue *q, struct request **rq,
 	if (!dd->front_merges)
 		return ELEVATOR_NO_MERGE;
 
-	__rq = elv_rb_find(&dd->sort_list[bio_data_dir(bio)], sector);
+	__rq = elv_rb_find(&dd->shared.sort_list[bio_data_dir(bio)], sector);
 	if (__rq) {
 		BUG_ON(sector != blk_rq_pos(__rq));
 
@@ -458,16 +584,82 @@ static int dd_request_merge(struct request_queue *q, struct request **rq,
 	return ELEVATOR_NO_MERGE;
 }
 
+/*
+ * Find a request ending at @sector, mq-deadline-hctx's stand-in for the
+ * elevator hash which is shared by all hardware queues.
+ */
+static struct request *deadline_rb_find_end(struct rb_root *root,
+					    sector_t sector)
+{
+	struct rb_node *n = root->rb_node;
+	struct request *rq = NULL;
+
+	while (n) {
+		struct request *__rq = rb_entry_rq(n);
+
+		if (blk_rq_pos(__rq) < sector) {
+			rq = __rq;
+			n = n->rb_right;
+		} else {
+			n = n->rb_left;
+		}
+	}
+
+	if (rq && blk_rq_pos(rq) + blk_rq_sectors(rq) == sector)
+		return rq;
+	return NULL;
+}
+
+/*
+ * Merge @bio into a request on @ddq. The generic elevator merge code goes
+ * through q->last_merge and the elevator hash, which are protected by
+ * nothing but our lock in mq-deadline, so mq-deadline-hctx works off its
+ * own sort lists and doesn't merge requests with each other.
+ */
+static bool dd_hctx_bio_merge(struct deadline_data *dd, struct dd_queue *ddq,
+			      struct request_queue *q, struct bio *bio)
+{
+	struct rb_root *root = &ddq->sort_list[bio_data_dir(bio)];
+	struct request *rq;
+
+	if (blk_queue_nomerges(q) || !bio_mergeable(bio))
+		return false;
+
+	rq = deadline_rb_find_end(root, bio->bi_iter.bi_sector);
+	if (rq && elv_bio_merge_ok(rq, bio) &&
+	    blk_mq_sched_allow_merge(q, rq, bio) &&
+	    bio_attempt_back_merge(q, rq, bio))
+		return true;
+
+	if (!dd->front_merges || blk_queue_noxmerges(q))
+		return false;
+
+	rq = elv_rb_find(root, bio_end_sector(bio));
+	if (rq && elv_bio_merge_ok(rq, bio) &&
+	    blk_mq_sched_allow_merge(q, rq, bio) &&
+	    bio_attempt_front_merge(q, rq, bio)) {
+		elv_rb_del(root, rq);
+		deadline_add_rq_rb(ddq, rq);
+		return true;
+	}
+
+	return false;
+}
+
 static bool dd_bio_merge(struct blk_mq_hw_ctx *hctx, struct bio *bio)
 {
 	struct request_queue *q = hctx->queue;
 	struct deadline_data *dd = q->elevator->elevator_data;
+	struct dd_queue *ddq = dd_hctx_queue(dd, hctx);
 	struct request *free = NULL;
 	bool ret;
 
-	spin_lock(&dd->lock);
-	ret = blk_mq_sched_try_merge(q, bio, &free);
-	spin_unlock(&dd->lock);
+	spin_lock(&ddq->lock);
+	if (dd->per_hctx)
+		ret = dd_hctx_bio_merge(dd, ddq, q, bio);
+	else
+		ret = blk_mq_sched_try_merge(q, bio, &free);
+	spin_unlock(&ddq->lock);
 
 	if (free)
 		blk_mq_free_request(free);
@@ -483,6 +675,7 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 {
 	struct request_queue *q = hctx->queue;
 	struct deadline_data *dd = q->elevator->elevator_data;
+	struct dd_queue *ddq = dd_hctx_queue(dd, hctx);
 	const int data_dir = rq_data_dir(rq);
 
 	/*
@@ -491,20 +684,20 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 	 */
 	blk_req_zone_write_unlock(rq);
 
-	if (blk_mq_sched_try_insert_merge(q, rq))
+	if (!dd->per_hctx && blk_mq_sched_try_insert_merge(q, rq))
 		return;
 
 	blk_mq_sched_request_inserted(rq);
 
 	if (at_head || blk_rq_is_passthrough(rq)) {
 		if (at_head)
-			list_add(&rq->queuelist, &dd->dispatch);
+			list_add(&rq->queuelist, &ddq->dispatch);
 		else
-			list_add_tail(&rq->queuelist, &dd->dispatch);
+			list_add_tail(&rq->queuelist, &ddq->dispatch);
 	} else {
-		deadline_add_rq_rb(dd, rq);
+		deadline_add_rq_rb(ddq, rq);
 
-		if (rq_mergeable(rq)) {
+		if (!dd->per_hctx && rq_mergeable(rq)) {
 			elv_rqhash_add(q, rq);
 			if (!q->last_merge)
 				q->last_merge = rq;
@@ -514,7 +707,9 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 		 * set expire time and add to fifo list
 		 */
 		rq->fifo_time = jiffies + dd->fifo_expire[data_dir];
-		list_add_tail(&rq->queuelist, &dd->fifo_list[data_dir]);
+		list_add_tail(&rq->queuelist, &ddq->fifo_list[data_dir]);
+		if (!ddq->fifo_head_time[data_dir])
+			deadline_update_fifo_head(ddq, data_dir);
 	}
 }
 
@@ -523,8 +718,9 @@ static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
 {
 	struct request_queue *q = hctx->queue;
 	struct deadline_data *dd = q->elevator->elevator_data;
+	struct dd_queue *ddq = dd_hctx_queue(dd, hctx);
 
-	spin_lock(&dd->lock);
+	spin_lock(&ddq->lock);
 	while (!list_empty(list)) {
 		struct request *rq;
 
@@ -532,7 +728,7 @@ static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
 		list_del_init(&rq->queuelist);
 		dd_insert_request(hctx, rq, at_head);
 	}
-	spin_unlock(&dd->lock);
+	spin_unlock(&ddq->lock);
 }
 
 /*
@@ -567,10 +763,11 @@ static void dd_finish_request(struct request *rq)
 static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
 {
 	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	struct dd_queue *ddq = dd_hctx_queue(dd, hctx);
 
-	return !list_empty_careful(&dd->dispatch) ||
-		!list_empty_careful(&dd->fifo_list[0]) ||
-		!list_empty_careful(&dd->fifo_list[1]);
+	return !list_empty_careful(&ddq->dispatch) ||
+		!list_empty_careful(&ddq->fifo_list[0]) ||
+		!list_empty_careful(&ddq->fifo_list[1]);
 }
 
 /*
@@ -645,13 +842,13 @@ static struct elv_fs_entry deadline_attrs[] = {
 #define DEADLINE_DEBUGFS_DDIR_ATTRS(ddir, name)				\
 static void *deadline_##name##_fifo_start(struct seq_file *m,		\
 					  loff_t *pos)			\
-	__acquires(&dd->lock)						\
+	__acquires(&dd->shared.lock)					\
 {									\
 	struct request_queue *q = m->private;				\
 	struct deadline_data *dd = q->elevator->elevator_data;		\
 									\
-	spin_lock(&dd->lock);						\
-	return seq_list_start(&dd->fifo_list[ddir], *pos);		\
+	spin_lock(&dd->shared.lock);					\
+	return seq_list_start(&dd->shared.fifo_list[ddir], *pos);	\
 }									\
 									\
 static void *deadline_##name##_fifo_next(struct seq_file *m, void *v,	\
@@ -660,16 +857,16 @@ static void *deadline_##name##_fifo_next(struct seq_file *m, void *v,	\
 	struct request_queue *q = m->private;				\
 	struct deadline_data *dd = q->elevator->elevator_data;		\
 									\
-	return seq_list_next(v, &dd->fifo_list[ddir], pos);		\
+	return seq_list_next(v, &dd->shared.fifo_list[ddir], pos);	\
 }									\
 									\
 static void deadline_##name##_fifo_stop(struct seq_file *m, void *v)	\
-	__releases(&dd->lock)						\
+	__releases(&dd->shared.lock)					\
 {									\
 	struct request_queue *q = m->private;				\
 	struct deadline_data *dd = q->elevator->elevator_data;		\
 									\
-	spin_unlock(&dd->lock);						\
+	spin_unlock(&dd->shared.lock);					\
 }									\
 									\
 static const struct seq_operations deadline_##name##_fifo_seq_ops = {	\
@@ -684,7 +881,7 @@ static int deadline_##name##_next_rq_show(void *data,			\
 {									\
 	struct request_queue *q = data;					\
 	struct deadline_data *dd = q->elevator->elevator_data;		\
-	struct request *rq = dd->next_rq[ddir];				\
+	struct request *rq = dd->shared.next_rq[ddir];			\
 									\
 	if (rq)								\
 		__blk_mq_debugfs_rq_show(m, rq);			\
@@ -699,7 +896,7 @@ static int deadline_batching_show(void *data, struct seq_file *m)
 	struct request_queue *q = data;
 	struct deadline_data *dd = q->elevator->elevator_data;
 
-	seq_printf(m, "%u\n", dd->batching);
+	seq_printf(m, "%u\n", dd->shared.batching);
 	return 0;
 }
 
@@ -708,18 +905,18 @@ static int deadline_starved_show(void *data, struct seq_file *m)
 	struct request_queue *q = data;
 	struct deadline_data *dd = q->elevator->elevator_data;
 
-	seq_printf(m, "%u\n", dd->starved);
+	seq_printf(m, "%u\n", dd->shared.starved);
 	return 0;
 }
 
 static void *deadline_dispatch_start(struct seq_file *m, loff_t *pos)
-	__acquires(&dd->lock)
+	__acquires(&dd->shared.lock)
 {
 	struct request_queue *q = m->private;
 	struct deadline_data *dd = q->elevator->elevator_data;
 
-	spin_lock(&dd->lock);
-	return seq_list_start(&dd->dispatch, *pos);
+	spin_lock(&dd->shared.lock);
+	return seq_list_start(&dd->shared.dispatch, *pos);
 }
 
 static void *deadline_dispatch_next(struct seq_file *m, void *v, loff_t *pos)
@@ -727,16 +924,16 @@ static void *deadline_dispatch_next(struct seq_file *m, void *v, loff_t *pos)
 	struct request_queue *q = m->private;
 	struct deadline_data *dd = q->elevator->elevator_data;
 
-	return seq_list_next(v, &dd->dispatch, pos);
+	return seq_list_next(v, &dd->shared.dispatch, pos);
 }
 
 static void deadline_dispatch_stop(struct seq_file *m, void *v)
-	__releases(&dd->lock)
+	__releases(&dd->shared.lock)
 {
 	struct request_queue *q = m->private;
 	struct deadline_data *dd = q->elevator->elevator_data;
 
-	spin_unlock(&dd->lock);
+	spin_unlock(&dd->shared.lock);
 }
 
 static const struct seq_operations deadline_dispatch_seq_ops = {
@@ -788,13 +985,51 @@ static struct elevator_type mq_deadline = {
 };
 MODULE_ALIAS("mq-deadline-iosched");
 
+/*
+ * Same policy, but applied separately on every hardware queue with per-hctx
+ * locks, sort and fifo lists. Requests are only merged with bios, not with
+ * each other, and the debugfs attributes are not provided.
+ */
+static struct elevator_type mq_deadline_hctx = {
+	.ops.mq = {
+		.insert_requests	= dd_insert_requests,
+		.dispatch_request	= dd_dispatch_request,
+		.prepare_request	= dd_prepare_request,
+		.finish_request		= dd_finish_request,
+		.next_request		= elv_rb_latter_request,
+		.former_request		= elv_rb_former_request,
+		.bio_merge		= dd_bio_merge,
+		.has_work		= dd_has_work,
+		.init_sched		= dd_init_queue,
+		.exit_sched		= dd_exit_queue,
+		.init_hctx		= dd_init_hctx,
+		.exit_hctx		= dd_exit_hctx,
+	},
+
+	.uses_mq	= true,
+	.elevator_attrs = deadline_attrs,
+	.elevator_name = "mq-deadline-hctx",
+	.elevator_owner = THIS_MODULE,
+};
+MODULE_ALIAS("mq-deadline-hctx-iosched");
+
 static int __init deadline_init(void)
 {
-	return elv_register(&mq_deadline);
+	int ret;
+
+	ret = elv_register(&mq_deadline);
+	if (ret)
+		return ret;
+
+	ret = elv_register(&mq_deadline_hctx);
+	if (ret)
+		elv_unregister(&mq_deadline);
+	return ret;
 }
 
 static void __exit deadline_exit(void)
 {
+	elv_unregister(&mq_deadline_hctx);
 	elv_unregister(&mq_deadline);
 }
 
@@ -231,6 +231,84 @@ static void sha256_transform(u32 *state, const u8 *input)
 	memzero_explicit(W, 64 * sizeof(u32));
 }
 
+/*
+ * Two independent messages: the dependency chain of a SHA-256 round is
+ * long, interleaving the rounds of two blocks keeps more of the CPU busy
+ * than running the transform twice.
+ */
+static const u32 sha256_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define SHA256_ROUND_X2(a, b, c, d, e, f, g, h, i) do {			\
+	t1 = h##x + e1(e##x) + Ch(e##x, f##x, g##x) + sha256_K[i] + W0[i]; \
+	u1 = h##y + e1(e##y) + Ch(e##y, f##y, g##y) + sha256_K[i] + W1[i]; \
+	t2 = e0(a##x) + Maj(a##x, b##x, c##x);				\
+	u2 = e0(a##y) + Maj(a##y, b##y, c##y);				\
+	d##x += t1;    h##x = t1 + t2;					\
+	d##y += u1;    h##y = u1 + u2;					\
+} while (0)
+
+static void sha256_transform_x2(u32 *state0, u32 *state1,
+				const u8 *input0, const u8 *input1)
+{
+	u32 ax, bx, cx, dx, ex, fx, gx, hx, t1, t2;
+	u32 ay, by, cy, dy, ey, fy, gy, hy, u1, u2;
+	u32 W0[64], W1[64];
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		LOAD_OP(i, W0, input0);
+		LOAD_OP(i, W1, input1);
+	}
+	for (i = 16; i < 64; i++) {
+		BLEND_OP(i, W0);
+		BLEND_OP(i, W1);
+	}
+
+	ax = state0[0];  bx = state0[1];  cx = state0[2];  dx = state0[3];
+	ex = state0[4];  fx = state0[5];  gx = state0[6];  hx = state0[7];
+	ay = state1[0];  by = state1[1];  cy = state1[2];  dy = state1[3];
+	ey = state1[4];  fy = state1[5];  gy = state1[6];  hy = state1[7];
+
+	for (i = 0; i < 64; i += 8) {
+		SHA256_ROUND_X2(a, b, c, d, e, f, g, h, i);
+		SHA256_ROUND_X2(h, a, b, c, d, e, f, g, i + 1);
+		SHA256_ROUND_X2(g, h, a, b, c, d, e, f, i + 2);
+		SHA256_ROUND_X2(f, g, h, a, b, c, d, e, i + 3);
+		SHA256_ROUND_X2(e, f, g, h, a, b, c, d, i + 4);
+		SHA256_ROUND_X2(d, e, f, g, h, a, b, c, i + 5);
+		SHA256_ROUND_X2(c, d, e, f, g, h, a, b, i + 6);
+		SHA256_ROUND_X2(b, c, d, e, f, g, h, a, i + 7);
+	}
+
+	state0[0] += ax; state0[1] += bx; state0[2] += cx; state0[3] += dx;
+	state0[4] += ex; state0[5] += fx; state0[6] += gx; state0[7] += hx;
+	state1[0] += ay; state1[1] += by; state1[2] += cy; state1[3] += dy;
+	state1[4] += ey; state1[5] += fy; state1[6] += gy; state1[7] += hy;
+
+	/* clear any sensitive info... */
+	ax = bx = cx = dx = ex = fx = gx = hx = t1 = t2 = 0;
+	ay = by = cy = dy = ey = fy = gy = hy = u1 = u2 = 0;
+	memzero_explicit(W0, 64 * sizeof(u32));
+	memzero_explicit(W1, 64 * sizeof(u32));
+}
+
 static void sha256_generic_block_fn(struct sha256_state *sst, u8 const *src,
 				    int blocks)
 {
@@ -261,12 +339,89 @@ int crypto_sha256_finup(struct shash_desc *desc, const u8 *data,
 }
 EXPORT_SYMBOL(crypto_sha256_finup);
 
+/*
+ * Both messages have the same length and start from the same state, so
+ * their block boundaries and padding are the same: one pass feeds the
+ * blocks of both to sha256_transform_x2().
+ */
+static int sha256_finup_x2(struct shash_desc *desc, const u8 *data0,
+			   const u8 *data1, unsigned int len, u8 *out0,
+			   u8 *out1)
+{
+	const int bit_offset = SHA256_BLOCK_SIZE - sizeof(__be64);
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+	unsigned int partial = sctx->count % SHA256_BLOCK_SIZE;
+	struct sha256_state st[2] = { *sctx, *sctx };
+	int i;
+
+	if (partial + len >= SHA256_BLOCK_SIZE) {
+		if (partial) {
+			int p = SHA256_BLOCK_SIZE - partial;
+
+			memcpy(st[0].buf + partial, data0, p);
+			memcpy(st[1].buf + partial, data1, p);
+			sha256_transform_x2(st[0].state, st[1].state,
+					    st[0].buf, st[1].buf);
+			data0 += p;
+			data1 += p;
+			len -= p;
+			sctx->count += p;
+			partial = 0;
+		}
+		while (len >= SHA256_BLOCK_SIZE) {
+			sha256_transform_x2(st[0].state, st[1].state,
+					    data0, data1);
+			data0 += SHA256_BLOCK_SIZE;
+			data1 += SHA256_BLOCK_SIZE;
+			len -= SHA256_BLOCK_SIZE;
+			sctx->count += SHA256_BLOCK_SIZE;
+		}
+	}
+	memcpy(st[0].buf + partial, data0, len);
+	memcpy(st[1].buf + partial, data1, len);
+	partial += len;
+	sctx->count += len;
+
+	for (i = 0; i < 2; i++) {
+		st[i].buf[partial] = 0x80;
+		memset(st[i].buf + partial + 1, 0x0,
+		       SHA256_BLOCK_SIZE - partial - 1);
+	}
+	if (partial + 1 > bit_offset) {
+		sha256_transform_x2(st[0].state, st[1].state,
+				    st[0].buf, st[1].buf);
+		memset(st[0].buf, 0x0, bit_offset);
+		memset(st[1].buf, 0x0, bit_offset);
+	}
+	for (i = 0; i < 2; i++)
+		*(__be64 *)(st[i].buf + bit_offset) =
+			cpu_to_be64(sctx->count << 3);
+	sha256_transform_x2(st[0].state, st[1].state, st[0].buf, st[1].buf);
+
+	/* sha256_base_finish() wipes sctx, as a plain finup would */
+	memcpy(sctx->state, st[0].state, sizeof(sctx->state));
+	sha256_base_finish(desc, out0);
+	memcpy(sctx->state, st[1].state, sizeof(sctx->state));
+	sha256_base_finish(desc, out1);
+	memzero_explicit(st, sizeof(st));
+	return 0;
+}
+
+static int sha256_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			   unsigned int len, u8 * const outs[],
+			   unsigned int num_msgs)
+{
+	return sha256_finup_x2(desc, data[0], data[1], len, outs[0], outs[1]);
+}
+
 static struct shash_alg sha256_algs[2] = { {
 	.digestsize	=	SHA256_DIGEST_SIZE,
 	.init		=	sha256_base_init,
 	.update		=	crypto_sha256_update,
 	.final		=	sha256_final,
 	.finup		=	crypto_sha256_finup,
+	.finup_mb	=	sha256_finup_mb,
+	.mb_max_msgs	=	2,
 	.descsize	=	sizeof(struct sha256_state),
 	.base		=	{
 		.cra_name	=	"sha256",
@@ -281,6 +436,8 @@ static struct shash_alg sha256_algs[2] = { {
 	.update		=	crypto_sha256_update,
 	.final		=	sha256_final,
 	.finup		=	crypto_sha256_finup,
+	.finup_mb	=	sha256_finup_mb,
+	.mb_max_msgs	=	2,
 	.descsize	=	sizeof(struct sha256_state),
 	.base		=	{
 		.cra_name	=	"sha224",
@@ -1824,6 +1824,104 @@ static int alg_test_comp(const struct alg_test_desc *desc, const char *driver,
 	return err;
 }
 
+/*
+ * Check crypto_shash_finup_mb() of algorithms which hash several messages
+ * at once: hash a shared prefix of each vector, then finish one message
+ * per lane, each but the first with a byte flipped after the prefix, and
+ * compare with a plain digest of the same message.
+ */
+static int test_shash_finup_mb(const struct hash_testvec *template,
+			       unsigned int tcount, const char *driver,
+			       u32 type, u32 mask)
+{
+	const u8 *data[XBUFSIZE];
+	u8 *outs[XBUFSIZE];
+	char *xbuf[XBUFSIZE];
+	struct crypto_shash *tfm;
+	unsigned int lanes, ds, i, j;
+	u8 *digests;
+	int err = 0;
+
+	tfm = crypto_alloc_shash(driver, type, mask);
+	if (IS_ERR(tfm))
+		return 0;	/* ahash only, no finup_mb */
+
+	lanes = min_t(unsigned int, crypto_shash_mb_max_msgs(tfm), XBUFSIZE);
+	if (lanes < 2)
+		goto out_free_tfm;
+
+	ds = crypto_shash_digestsize(tfm);
+	err = -ENOMEM;
+	digests = kmalloc(2 * lanes * ds, GFP_KERNEL);
+	if (!digests)
+		goto out_free_tfm;
+	if (testmgr_alloc_buf(xbuf))
+		goto out_free_digests;
+
+	err = 0;
+	for (i = 0; i < tcount; i++) {
+		const struct hash_testvec *t = &template[i];
+		unsigned int prefix = t->psize / 2, rest = t->psize - prefix;
+		SHASH_DESC_ON_STACK(desc, tfm);
+
+		if (t->psize > PAGE_SIZE)
+			continue;
+
+		desc->tfm = tfm;
+		desc->flags = 0;
+		if (t->ksize) {
+			err = crypto_shash_setkey(tfm, (const u8 *)t->key,
+						  t->ksize);
+			if (err) {
+				pr_err("alg: hash: finup_mb setkey failed on test %u for %s: %d\n",
+				       i + 1, driver, err);
+				break;
+			}
+		}
+
+		for (j = 0; j < lanes; j++) {
+			u8 *buf = (u8 *)xbuf[j];
+
+			memcpy(buf, t->plaintext, t->psize);
+			if (j && rest)
+				buf[prefix + (j - 1) % rest] ^= 0xff;
+			data[j] = buf + prefix;
+			outs[j] = digests + j * ds;
+			err = crypto_shash_digest(desc, buf, t->psize,
+						  digests + (lanes + j) * ds);
+			if (err)
+				break;
+		}
+		if (!err)
+			err = crypto_shash_init(desc);
+		if (!err)
+			err = crypto_shash_update(desc, (u8 *)xbuf[0], prefix);
+		if (!err)
+			err = crypto_shash_finup_mb(desc, data, rest, outs,
+						    lanes);
+		if (err) {
+			pr_err("alg: hash: finup_mb failed on test %u for %s: %d\n",
+			       i + 1, driver, err);
+			break;
+		}
+
+		if (memcmp(outs[0], t->digest, ds) ||
+		    memcmp(digests, digests + lanes * ds, lanes * ds)) {
+			pr_err("alg: hash: finup_mb test %u failed for %s\n",
+			       i + 1, driver);
+			err = -EINVAL;
+			break;
+		}
+	}
+
+	testmgr_free_buf(xbuf);
+out_free_digests:
+	kfree(digests);
+out_free_tfm:
+	crypto_free_shash(tfm);
+	return err;
+}
+
 static int __alg_test_hash(const struct hash_testvec *template,
 			   unsigned int tcount, const char *driver,
 			   u32 type, u32 mask)
@@ -1844,6 +1942,8 @@ static int __alg_test_hash(const struct hash_testvec *template,
 	if (!err)
 		err = test_hash(tfm, template, tcount, HASH_TEST_FINUP);
 	crypto_free_ahash(tfm);
+	if (!err)
+		err = test_shash_finup_mb(template, tcount, driver, type, mask);
 	return err;
 }
 
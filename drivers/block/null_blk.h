@@ -47,6 +47,12 @@ struct nullb_device {
 
 	unsigned long size; /* device size in MB */
 	unsigned long completion_nsec; /* time in ns to complete a request */
+	unsigned long read_nsec; /* completion time of reads, if set */
+	unsigned long write_nsec; /* completion time of writes, if set */
+	unsigned long tail_nsec; /* completion time of the tail requests */
+	unsigned long gc_pause_nsec; /* writes stall this long every... */
+	unsigned int gc_interval_msec; /* ...gc_interval_msec */
+	unsigned int tail_permille; /* requests completing in tail_nsec */
 	unsigned long cache_size; /* disk cache size in MB */
 	unsigned long zone_size; /* zone size in MB if device is zoned */
 	unsigned int submit_queues; /* number of submission queues */
@@ -57,6 +63,7 @@ struct nullb_device {
 	unsigned int hw_queue_depth; /* queue depth */
 	unsigned int index; /* index of the disk, only valid with a disk */
 	unsigned int mbps; /* Bandwidth throttle cap (in MB/s) */
+	unsigned int iops; /* I/O rate throttle cap (in IO/s) */
 	bool blocking; /* blocking blk-mq device */
 	bool use_per_node_hctx; /* use per-node allocation for hardware context */
 	bool power; /* power on/off the device */
@@ -75,6 +82,7 @@ struct nullb {
 	struct blk_mq_tag_set __tag_set;
 	unsigned int queue_depth;
 	atomic_long_t cur_bytes;
+	atomic_long_t cur_ios;
 	struct hrtimer bw_timer;
 	unsigned long cache_flush_pos;
 	spinlock_t lock;
@@ -92,6 +100,7 @@ int null_zone_report(struct gendisk *disk, sector_t sector,
 		     gfp_t gfp_mask);
 void null_zone_write(struct nullb_cmd *cmd, sector_t sector,
 			unsigned int nr_sectors);
+void null_zone_append(struct nullb_cmd *cmd);
 void null_zone_reset(struct nullb_cmd *cmd, sector_t sector);
 #else
 static inline int null_zone_init(struct nullb_device *dev)
@@ -109,6 +118,7 @@ static inline void null_zone_write(struct nullb_cmd *cmd, sector_t sector,
 				   unsigned int nr_sectors)
 {
 }
+static inline void null_zone_append(struct nullb_cmd *cmd) {}
 static inline void null_zone_reset(struct nullb_cmd *cmd, sector_t sector) {}
 #endif /* CONFIG_BLK_DEV_ZONED */
 #endif /* __NULL_BLK_H */
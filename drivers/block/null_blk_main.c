@@ -8,6 +8,7 @@
 #include <linux/sched.h>
 #include <linux/fs.h>
 #include <linux/init.h>
+#include <linux/random.h>
 #include "null_blk.h"
 
 #define PAGE_SECTORS_SHIFT	(PAGE_SHIFT - SECTOR_SHIFT)
@@ -29,6 +30,11 @@ static inline u64 mb_per_tick(int mbps)
 	return (1 << 20) / TICKS_PER_SEC * ((u64) mbps);
 }
 
+static inline u64 ios_per_tick(unsigned int iops)
+{
+	return iops ? max_t(u64, iops / TICKS_PER_SEC, 1) : 0;
+}
+
 /*
  * Status flags for nullb_device.
  *
@@ -278,6 +284,12 @@ CONFIGFS_ATTR(nullb_device_, NAME);
 
 NULLB_DEVICE_ATTR(size, ulong);
 NULLB_DEVICE_ATTR(completion_nsec, ulong);
+NULLB_DEVICE_ATTR(read_nsec, ulong);
+NULLB_DEVICE_ATTR(write_nsec, ulong);
+NULLB_DEVICE_ATTR(tail_nsec, ulong);
+NULLB_DEVICE_ATTR(tail_permille, uint);
+NULLB_DEVICE_ATTR(gc_interval_msec, uint);
+NULLB_DEVICE_ATTR(gc_pause_nsec, ulong);
 NULLB_DEVICE_ATTR(submit_queues, uint);
 NULLB_DEVICE_ATTR(home_node, uint);
 NULLB_DEVICE_ATTR(queue_mode, uint);
@@ -290,6 +302,7 @@ NULLB_DEVICE_ATTR(use_per_node_hctx, bool);
 NULLB_DEVICE_ATTR(memory_backed, bool);
 NULLB_DEVICE_ATTR(discard, bool);
 NULLB_DEVICE_ATTR(mbps, uint);
+NULLB_DEVICE_ATTR(iops, uint);
 NULLB_DEVICE_ATTR(cache_size, ulong);
 NULLB_DEVICE_ATTR(zoned, bool);
 NULLB_DEVICE_ATTR(zone_size, ulong);
@@ -390,6 +403,12 @@ CONFIGFS_ATTR(nullb_device_, badblocks);
 static struct configfs_attribute *nullb_device_attrs[] = {
 	&nullb_device_attr_size,
 	&nullb_device_attr_completion_nsec,
+	&nullb_device_attr_read_nsec,
+	&nullb_device_attr_write_nsec,
+	&nullb_device_attr_tail_nsec,
+	&nullb_device_attr_tail_permille,
+	&nullb_device_attr_gc_interval_msec,
+	&nullb_device_attr_gc_pause_nsec,
 	&nullb_device_attr_submit_queues,
 	&nullb_device_attr_home_node,
 	&nullb_device_attr_queue_mode,
@@ -403,6 +422,7 @@ static struct configfs_attribute *nullb_device_attrs[] = {
 	&nullb_device_attr_memory_backed,
 	&nullb_device_attr_discard,
 	&nullb_device_attr_mbps,
+	&nullb_device_attr_iops,
 	&nullb_device_attr_cache_size,
 	&nullb_device_attr_badblocks,
 	&nullb_device_attr_zoned,
@@ -459,7 +479,7 @@ nullb_group_drop_item(struct config_group *group, struct config_item *item)
 
 static ssize_t memb_group_features_show(struct config_item *item, char *page)
 {
-	return snprintf(page, PAGE_SIZE, "memory_backed,discard,bandwidth,cache,badblocks,zoned,zone_size\n");
+	return snprintf(page, PAGE_SIZE, "memory_backed,discard,bandwidth,iops,cache,badblocks,zoned,zone_size,latency\n");
 }
 
 CONFIGFS_ATTR_RO(memb_group_, features);
@@ -628,9 +648,47 @@ static enum hrtimer_restart null_cmd_timer_expired(struct hrtimer *timer)
 	return HRTIMER_NORESTART;
 }
 
+/*
+ * Completion time of a command in timer mode.  Reads and writes can be
+ * given their own latency, a share of tail_permille of the commands takes
+ * tail_nsec instead, and writes arriving during the first gc_pause_nsec of
+ * every gc_interval_msec wait for the end of that pause, as behind the
+ * garbage collection of a flash device.
+ */
+static u64 null_cmd_latency(struct nullb_cmd *cmd)
+{
+	struct nullb_device *dev = cmd->nq->dev;
+	u64 nsec = dev->completion_nsec;
+	bool write;
+
+	if (dev->queue_mode == NULL_Q_BIO)
+		write = op_is_write(bio_op(cmd->bio));
+	else
+		write = op_is_write(req_op(cmd->rq));
+
+	if (write && dev->write_nsec)
+		nsec = dev->write_nsec;
+	else if (!write && dev->read_nsec)
+		nsec = dev->read_nsec;
+
+	if (dev->tail_permille && prandom_u32_max(1000) < dev->tail_permille)
+		nsec = max_t(u64, nsec, dev->tail_nsec);
+
+	if (write && dev->gc_interval_msec && dev->gc_pause_nsec) {
+		u64 phase;
+
+		div64_u64_rem(ktime_get_ns(),
+			      (u64)dev->gc_interval_msec * NSEC_PER_MSEC, &phase);
+		if (phase < dev->gc_pause_nsec)
+			nsec += dev->gc_pause_nsec - phase;
+	}
+
+	return nsec;
+}
+
 static void null_cmd_end_timer(struct nullb_cmd *cmd)
 {
-	ktime_t kt = cmd->nq->dev->completion_nsec;
+	ktime_t kt = null_cmd_latency(cmd);
 
 	hrtimer_start(&cmd->timer, kt, HRTIMER_MODE_REL);
 }
@@ -1141,11 +1199,13 @@ static blk_status_t null_handle_cmd(struct nullb_cmd *cmd)
 		if (!hrtimer_active(&nullb->bw_timer))
 			hrtimer_restart(&nullb->bw_timer);
 
-		if (atomic_long_sub_return(blk_rq_bytes(rq),
-				&nullb->cur_bytes) < 0) {
+		if ((dev->mbps && atomic_long_sub_return(blk_rq_bytes(rq),
+				&nullb->cur_bytes) < 0) ||
+		    (dev->iops && atomic_long_dec_return(&nullb->cur_ios) < 0)) {
 			null_stop_queue(nullb);
 			/* race with timer */
-			if (atomic_long_read(&nullb->cur_bytes) > 0)
+			if ((!dev->mbps || atomic_long_read(&nullb->cur_bytes) > 0) &&
+			    (!dev->iops || atomic_long_read(&nullb->cur_ios) > 0))
 				null_restart_queue_async(nullb);
 			/* requeue request */
 			return BLK_STS_DEV_RESOURCE;
@@ -1176,6 +1236,17 @@ static blk_status_t null_handle_cmd(struct nullb_cmd *cmd)
 		}
 	}
 
+	if (dev->zoned) {
+		int op = dev->queue_mode == NULL_Q_BIO ? bio_op(cmd->bio) :
+							 req_op(cmd->rq);
+
+		if (op == REQ_OP_ZONE_APPEND) {
+			null_zone_append(cmd);
+			if (cmd->error)
+				goto out;
+		}
+	}
+
 	if (dev->memory_backed) {
 		if (dev->queue_mode == NULL_Q_BIO) {
 			if (bio_op(cmd->bio) == REQ_OP_FLUSH)
@@ -1242,11 +1313,14 @@ static enum hrtimer_restart nullb_bwtimer_fn(struct hrtimer *timer)
 	struct nullb *nullb = container_of(timer, struct nullb, bw_timer);
 	ktime_t timer_interval = ktime_set(0, TIMER_INTERVAL);
 	unsigned int mbps = nullb->dev->mbps;
+	unsigned int iops = nullb->dev->iops;
 
-	if (atomic_long_read(&nullb->cur_bytes) == mb_per_tick(mbps))
+	if (atomic_long_read(&nullb->cur_bytes) == mb_per_tick(mbps) &&
+	    atomic_long_read(&nullb->cur_ios) == ios_per_tick(iops))
 		return HRTIMER_NORESTART;
 
 	atomic_long_set(&nullb->cur_bytes, mb_per_tick(mbps));
+	atomic_long_set(&nullb->cur_ios, ios_per_tick(iops));
 	null_restart_queue_async(nullb);
 
 	hrtimer_forward_now(&nullb->bw_timer, timer_interval);
@@ -1261,6 +1335,7 @@ static void nullb_setup_bwtimer(struct nullb *nullb)
 	hrtimer_init(&nullb->bw_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	nullb->bw_timer.function = nullb_bwtimer_fn;
 	atomic_long_set(&nullb->cur_bytes, mb_per_tick(nullb->dev->mbps));
+	atomic_long_set(&nullb->cur_ios, ios_per_tick(nullb->dev->iops));
 	hrtimer_start(&nullb->bw_timer, timer_interval, HRTIMER_MODE_REL);
 }
 
@@ -1383,6 +1458,7 @@ static void null_del_dev(struct nullb *nullb)
 	if (test_bit(NULLB_DEV_FL_THROTTLED, &nullb->dev->flags)) {
 		hrtimer_cancel(&nullb->bw_timer);
 		atomic_long_set(&nullb->cur_bytes, LONG_MAX);
+		atomic_long_set(&nullb->cur_ios, LONG_MAX);
 		null_restart_queue_async(nullb);
 	}
 
@@ -1583,9 +1659,12 @@ static void null_validate_conf(struct nullb_device *dev)
 	dev->cache_size = min_t(unsigned long, ULONG_MAX / 1024 / 1024,
 						dev->cache_size);
 	dev->mbps = min_t(unsigned int, 1024 * 40, dev->mbps);
+	dev->tail_permille = min_t(unsigned int, 1000, dev->tail_permille);
 	/* can not stop a queue */
-	if (dev->queue_mode == NULL_Q_BIO)
+	if (dev->queue_mode == NULL_Q_BIO) {
 		dev->mbps = 0;
+		dev->iops = 0;
+	}
 }
 
 #ifdef CONFIG_BLK_DEV_NULL_BLK_FAULT_INJECTION
@@ -1669,7 +1748,7 @@ static int null_add_dev(struct nullb_device *dev)
 			goto out_cleanup_blk_queue;
 	}
 
-	if (dev->mbps) {
+	if (dev->mbps || dev->iops) {
 		set_bit(NULLB_DEV_FL_THROTTLED, &dev->flags);
 		nullb_setup_bwtimer(nullb);
 	}
@@ -1687,6 +1766,8 @@ static int null_add_dev(struct nullb_device *dev)
 
 		blk_queue_chunk_sectors(nullb->q, dev->zone_size_sects);
 		nullb->q->limits.zoned = BLK_ZONED_HM;
+		blk_queue_max_zone_append_sectors(nullb->q,
+						  dev->zone_size_sects);
 	}
 
 	nullb->q->queuedata = nullb;
@@ -105,6 +105,45 @@ void null_zone_write(struct nullb_cmd *cmd, sector_t sector,
 	}
 }
 
+/*
+ * The command names the start of the zone, the data goes at the write
+ * pointer. Record where so that the data transfer and the completion see
+ * the real sector.
+ */
+void null_zone_append(struct nullb_cmd *cmd)
+{
+	struct nullb_device *dev = cmd->nq->dev;
+	bool bio_mode = dev->queue_mode == NULL_Q_BIO;
+	sector_t sector;
+	unsigned int nr_sectors;
+	struct blk_zone *zone;
+
+	if (bio_mode) {
+		sector = cmd->bio->bi_iter.bi_sector;
+		nr_sectors = bio_sectors(cmd->bio);
+	} else {
+		sector = blk_rq_pos(cmd->rq);
+		nr_sectors = blk_rq_sectors(cmd->rq);
+	}
+
+	zone = &dev->zones[null_zone_no(dev, sector)];
+	if (sector != zone->start ||
+	    zone->wp + nr_sectors > zone->start + zone->len) {
+		cmd->error = BLK_STS_IOERR;
+		return;
+	}
+
+	sector = zone->wp;
+	null_zone_write(cmd, sector, nr_sectors);
+	if (cmd->error)
+		return;
+
+	if (bio_mode)
+		cmd->bio->bi_iter.bi_sector = sector;
+	else
+		cmd->rq->__sector = sector;
+}
+
 void null_zone_reset(struct nullb_cmd *cmd, sector_t sector)
 {
 	struct nullb_device *dev = cmd->nq->dev;
@@ -652,6 +652,7 @@ static void zram_debugfs_destroy(void)
 
 static void zram_accessed(struct zram *zram, u32 index)
 {
+	zram_clear_flag(zram, index, ZRAM_IDLE);
 	zram->table[index].ac_time = ktime_get_boottime();
 }
 
@@ -739,7 +740,10 @@ static void zram_debugfs_unregister(struct zram *zram)
 #else
 static void zram_debugfs_create(void) {};
 static void zram_debugfs_destroy(void) {};
-static void zram_accessed(struct zram *zram, u32 index) {};
+static void zram_accessed(struct zram *zram, u32 index)
+{
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+};
 static void zram_reset_access(struct zram *zram, u32 index) {};
 static void zram_debugfs_register(struct zram *zram) {};
 static void zram_debugfs_unregister(struct zram *zram) {};
@@ -824,6 +828,412 @@ static ssize_t compact_store(struct device *dev,
 	return len;
 }
 
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->recomp_compressor, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[ARRAY_SIZE(zram->recomp_compressor)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
+
+	/* an empty name turns recompression off */
+	if (compressor[0] && !zcomp_available_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+
+	strcpy(zram->recomp_compressor, compressor);
+	up_write(&zram->init_lock);
+	return len;
+}
+
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages;
+	u32 index;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		zram_slot_lock(zram, index);
+		if (zram_allocated(zram, index))
+			zram_set_flag(zram, index, ZRAM_IDLE);
+		zram_slot_unlock(zram, index);
+		cond_resched();
+	}
+
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+/*
+ * Uncompress the object stored at @index into @page.  The caller holds
+ * the slot lock and has checked that the slot has an object.
+ */
+static int zram_read_obj(struct zram *zram, u32 index, struct page *page)
+{
+	unsigned long handle = zram_get_handle(zram, index);
+	unsigned int size = zram_get_obj_size(zram, index);
+	void *src, *dst;
+	int ret = 0;
+
+	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
+	dst = kmap_atomic(page);
+	if (size == PAGE_SIZE) {
+		memcpy(dst, src, PAGE_SIZE);
+	} else {
+		struct zcomp *comp = zram_test_flag(zram, index, ZRAM_RECOMP) ?
+					zram->recomp : zram->comp;
+		struct zcomp_strm *zstrm = zcomp_stream_get(comp);
+
+		ret = zcomp_decompress(zstrm, src, size, dst);
+		zcomp_stream_put(comp);
+	}
+	kunmap_atomic(dst);
+	zs_unmap_object(zram->mem_pool, handle);
+
+	return ret;
+}
+
+/*
+ * Recompress the page at @index with the secondary algorithm, keeping
+ * the old object unless the new one is smaller.  The caller holds the
+ * slot lock, @page is a scratch page for the uncompressed data.
+ */
+static int zram_recompress(struct zram *zram, u32 index, struct page *page)
+{
+	unsigned long new_handle, alloced_pages;
+	unsigned int size, comp_len;
+	struct zcomp_strm *zstrm;
+	void *src, *dst;
+	int ret;
+
+	size = zram_get_obj_size(zram, index);
+	ret = zram_read_obj(zram, index, page);
+	if (ret)
+		return ret;
+
+	zstrm = zcomp_stream_get(zram->recomp);
+	src = kmap_atomic(page);
+	ret = zcomp_compress(zstrm, src, &comp_len);
+	kunmap_atomic(src);
+
+	if (ret || comp_len >= size || comp_len >= huge_class_size) {
+		zcomp_stream_put(zram->recomp);
+		return ret;
+	}
+
+	/* the slot lock is held, so this cannot enter direct reclaim */
+	new_handle = zs_malloc(zram->mem_pool, comp_len,
+			__GFP_KSWAPD_RECLAIM |
+			__GFP_NOWARN |
+			__GFP_HIGHMEM |
+			__GFP_MOVABLE);
+	if (!new_handle) {
+		zcomp_stream_put(zram->recomp);
+		return -ENOMEM;
+	}
+
+	/* both objects exist until the old one is freed below */
+	alloced_pages = zs_get_total_pages(zram->mem_pool);
+	update_used_max(zram, alloced_pages);
+
+	if (zram->limit_pages && alloced_pages > zram->limit_pages) {
+		zcomp_stream_put(zram->recomp);
+		zs_free(zram->mem_pool, new_handle);
+		return -ENOMEM;
+	}
+
+	dst = zs_map_object(zram->mem_pool, new_handle, ZS_MM_WO);
+	memcpy(dst, zstrm->buffer, comp_len);
+	zs_unmap_object(zram->mem_pool, new_handle);
+	zcomp_stream_put(zram->recomp);
+
+	zram_free_page(zram, index);
+	zram_set_handle(zram, index, new_handle);
+	zram_set_obj_size(zram, index, comp_len);
+	zram_set_flag(zram, index, ZRAM_RECOMP);
+
+	atomic64_add(comp_len, &zram->stats.compr_data_size);
+	atomic64_inc(&zram->stats.pages_stored);
+	return 0;
+}
+
+static ssize_t recompress_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool idle = false, huge = false;
+	unsigned long nr_pages;
+	struct page *page;
+	ssize_t ret = len;
+	u32 index;
+
+	if (sysfs_streq(buf, "idle"))
+		idle = true;
+	else if (sysfs_streq(buf, "huge"))
+		huge = true;
+	else if (sysfs_streq(buf, "huge_idle"))
+		idle = huge = true;
+	else
+		return -EINVAL;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram->recomp) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		int err;
+
+		zram_slot_lock(zram, index);
+		if (zram_test_flag(zram, index, ZRAM_SAME) ||
+		    zram_test_flag(zram, index, ZRAM_WB) ||
+		    zram_test_flag(zram, index, ZRAM_RECOMP) ||
+		    !zram_get_handle(zram, index))
+			goto next;
+
+		if (idle && !zram_test_flag(zram, index, ZRAM_IDLE))
+			goto next;
+		if (huge && !zram_test_flag(zram, index, ZRAM_HUGE))
+			goto next;
+
+		err = zram_recompress(zram, index, page);
+		if (err) {
+			zram_slot_unlock(zram, index);
+			ret = err;
+			break;
+		}
+next:
+		zram_slot_unlock(zram, index);
+		cond_resched();
+	}
+out:
+	up_read(&zram->init_lock);
+	__free_page(page);
+
+	return ret;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* pages writeback_store() keeps in flight to the backing device */
+#define ZRAM_WB_BATCH	32
+
+struct zram_wb_batch {
+	atomic_t pending;
+	wait_queue_head_t wait;
+	struct zram_wb_req {
+		u32 index;
+		unsigned long entry;
+		struct page *page;
+		struct bio *bio;
+	} reqs[ZRAM_WB_BATCH];
+};
+
+static void zram_wb_end_io(struct bio *bio)
+{
+	struct zram_wb_batch *wb = bio->bi_private;
+
+	if (atomic_dec_and_test(&wb->pending))
+		wake_up(&wb->wait);
+}
+
+/*
+ * Wait for the @nr writes of @wb and move the slots whose data made it to
+ * the backing device over to it.  A slot that was freed or rewritten in
+ * the meantime lost ZRAM_UNDER_WB in zram_free_page(), its block is
+ * released again.
+ */
+static void zram_wb_complete(struct zram *zram, struct zram_wb_batch *wb,
+			     int nr)
+{
+	int i;
+
+	wait_event(wb->wait, !atomic_read(&wb->pending));
+
+	for (i = 0; i < nr; i++) {
+		struct zram_wb_req *req = &wb->reqs[i];
+		u32 index = req->index;
+
+		zram_slot_lock(zram, index);
+		if (!req->bio->bi_status &&
+		    zram_test_flag(zram, index, ZRAM_UNDER_WB)) {
+			zs_free(zram->mem_pool, zram_get_handle(zram, index));
+			atomic64_sub(zram_get_obj_size(zram, index),
+				     &zram->stats.compr_data_size);
+			zram_clear_flag(zram, index, ZRAM_RECOMP);
+			zram_set_obj_size(zram, index, 0);
+			zram_set_flag(zram, index, ZRAM_WB);
+			zram_set_element(zram, index, req->entry);
+		} else {
+			put_entry_bdev(zram, req->entry);
+		}
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_slot_unlock(zram, index);
+		bio_put(req->bio);
+	}
+}
+
+/*
+ * Write idle and/or huge pages out to the backing device, ZRAM_WB_BATCH
+ * of them at a time.  A slot stays readable from memory while its write
+ * is in flight and is only switched over once the write has completed.
+ */
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool idle = false, huge = false;
+	struct zram_wb_batch *wb;
+	struct blk_plug plug;
+	unsigned long nr_pages;
+	ssize_t ret = len;
+	int i, nr = 0;
+	u32 index;
+
+	if (sysfs_streq(buf, "idle"))
+		idle = true;
+	else if (sysfs_streq(buf, "huge"))
+		huge = true;
+	else if (sysfs_streq(buf, "huge_idle"))
+		idle = huge = true;
+	else
+		return -EINVAL;
+
+	wb = kzalloc(sizeof(*wb), GFP_KERNEL);
+	if (!wb)
+		return -ENOMEM;
+	init_waitqueue_head(&wb->wait);
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		wb->reqs[i].page = alloc_page(GFP_KERNEL);
+		if (!wb->reqs[i].page) {
+			ret = -ENOMEM;
+			goto free;
+		}
+	}
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram_wb_enabled(zram)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* one pass at a time, see zram_wb_complete() */
+	mutex_lock(&zram->wb_lock);
+	blk_start_plug(&plug);
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		struct zram_wb_req *req = &wb->reqs[nr];
+		struct bio *bio;
+		int err;
+
+		zram_slot_lock(zram, index);
+		if (zram_test_flag(zram, index, ZRAM_SAME) ||
+		    zram_test_flag(zram, index, ZRAM_WB) ||
+		    !zram_get_handle(zram, index))
+			goto next;
+
+		if (idle && !zram_test_flag(zram, index, ZRAM_IDLE))
+			goto next;
+		if (huge && !zram_test_flag(zram, index, ZRAM_HUGE))
+			goto next;
+
+		req->entry = get_entry_bdev(zram);
+		if (!req->entry) {
+			zram_slot_unlock(zram, index);
+			ret = -ENOSPC;
+			break;
+		}
+
+		err = zram_read_obj(zram, index, req->page);
+		if (err) {
+			zram_slot_unlock(zram, index);
+			put_entry_bdev(zram, req->entry);
+			ret = err;
+			break;
+		}
+		zram_set_flag(zram, index, ZRAM_UNDER_WB);
+		zram_slot_unlock(zram, index);
+
+		bio = bio_alloc(GFP_KERNEL, 1);
+		bio->bi_iter.bi_sector = req->entry * (PAGE_SIZE >> 9);
+		bio_set_dev(bio, zram->bdev);
+		bio_add_page(bio, req->page, PAGE_SIZE, 0);
+		bio->bi_opf = REQ_OP_WRITE;
+		bio->bi_end_io = zram_wb_end_io;
+		bio->bi_private = wb;
+		req->bio = bio;
+		req->index = index;
+
+		atomic_inc(&wb->pending);
+		submit_bio(bio);
+		if (++nr == ZRAM_WB_BATCH) {
+			blk_finish_plug(&plug);
+			zram_wb_complete(zram, wb, nr);
+			nr = 0;
+			blk_start_plug(&plug);
+		}
+		cond_resched();
+		continue;
+next:
+		zram_slot_unlock(zram, index);
+		cond_resched();
+	}
+	blk_finish_plug(&plug);
+	zram_wb_complete(zram, wb, nr);
+	mutex_unlock(&zram->wb_lock);
+out:
+	up_read(&zram->init_lock);
+free:
+	for (i = 0; i < ZRAM_WB_BATCH; i++)
+		if (wb->reqs[i].page)
+			__free_page(wb->reqs[i].page);
+	kfree(wb);
+
+	return ret;
+}
+#endif
+
 static ssize_t io_stat_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -942,6 +1352,10 @@ static void zram_free_page(struct zram *zram, size_t index)
 
 	zram_reset_access(zram, index);
 
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	zram_clear_flag(zram, index, ZRAM_RECOMP);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+
 	if (zram_test_flag(zram, index, ZRAM_HUGE)) {
 		zram_clear_flag(zram, index, ZRAM_HUGE);
 		atomic64_dec(&zram->stats.huge_pages);
@@ -1027,12 +1441,14 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		kunmap_atomic(dst);
 		ret = 0;
 	} else {
-		struct zcomp_strm *zstrm = zcomp_stream_get(zram->comp);
+		struct zcomp *comp = zram_test_flag(zram, index, ZRAM_RECOMP) ?
+					zram->recomp : zram->comp;
+		struct zcomp_strm *zstrm = zcomp_stream_get(comp);
 
 		dst = kmap_atomic(page);
 		ret = zcomp_decompress(zstrm, src, size, dst);
 		kunmap_atomic(dst);
-		zcomp_stream_put(zram->comp);
+		zcomp_stream_put(comp);
 	}
 	zs_unmap_object(zram->mem_pool, handle);
 	zram_slot_unlock(zram, index);
@@ -1459,7 +1875,7 @@ static int zram_rw_page(struct block_device *bdev, sector_t sector,
 
 static void zram_reset_device(struct zram *zram)
 {
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp;
 	u64 disksize;
 
 	down_write(&zram->init_lock);
@@ -1472,6 +1888,8 @@ static void zram_reset_device(struct zram *zram)
 	}
 
 	comp = zram->comp;
+	recomp = zram->recomp;
+	zram->recomp = NULL;
 	disksize = zram->disksize;
 	zram->disksize = 0;
 
@@ -1483,6 +1901,8 @@ static void zram_reset_device(struct zram *zram)
 	zram_meta_free(zram, disksize);
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	zcomp_destroy(comp);
+	if (recomp)
+		zcomp_destroy(recomp);
 	reset_bdev(zram);
 }
 
@@ -1519,6 +1939,18 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+	if (zram->recomp_compressor[0]) {
+		zram->recomp = zcomp_create(zram->recomp_compressor);
+		if (IS_ERR(zram->recomp)) {
+			pr_err("Cannot initialise %s compressing backend\n",
+					zram->recomp_compressor);
+			err = PTR_ERR(zram->recomp);
+			zram->recomp = NULL;
+			zcomp_destroy(comp);
+			goto out_free_meta;
+		}
+	}
+
 	zram->comp = comp;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
@@ -1610,8 +2042,12 @@ static DEVICE_ATTR_WO(mem_limit);
 static DEVICE_ATTR_WO(mem_used_max);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_WO(idle);
+static DEVICE_ATTR_WO(recompress);
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RW(backing_dev);
+static DEVICE_ATTR_WO(writeback);
 #endif
 
 static struct attribute *zram_disk_attrs[] = {
@@ -1623,8 +2059,12 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_mem_used_max.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_recompress.attr,
 #ifdef CONFIG_ZRAM_WRITEBACK
 	&dev_attr_backing_dev.attr,
+	&dev_attr_writeback.attr,
 #endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
@@ -1661,6 +2101,9 @@ static int zram_add(void)
 	device_id = ret;
 
 	init_rwsem(&zram->init_lock);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	mutex_init(&zram->wb_lock);
+#endif
 
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
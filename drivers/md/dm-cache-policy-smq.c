@@ -855,6 +855,12 @@ struct smq_policy {
 	struct background_tracker *bg_work;
 
 	bool migrations_allowed;
+
+	/*
+	 * The last idle hint passed in by the core, ie. whether there is
+	 * spare bandwidth for migrations.
+	 */
+	bool background_idle;
 };
 
 /*----------------------------------------------------------------*/
@@ -1063,6 +1069,14 @@ static void update_promote_levels(struct smq_policy *mq)
 		break;
 	}
 
+	/*
+	 * Once the cache is full every promotion also costs a demotion.
+	 * If the core has no spare migration bandwidth, promote less rather
+	 * than queueing work that will compete with the io.
+	 */
+	if (allocator_empty(&mq->cache_alloc) && !mq->background_idle)
+		threshold_level /= 2u;
+
 	mq->read_promote_level = NR_HOTSPOT_LEVELS - threshold_level;
 	mq->write_promote_level = (NR_HOTSPOT_LEVELS - threshold_level);
 }
@@ -1122,6 +1136,13 @@ static void end_cache_period(struct smq_policy *mq)
 #define CLEAN_TARGET 25u
 #define FREE_TARGET 25u
 
+/*
+ * Demotions and writebacks are queued in batches, so the core can issue
+ * several copies at once rather than finding them one at a time.
+ */
+#define DEMOTE_BATCH 16u
+#define WRITEBACK_BATCH 16u
+
 static unsigned percent_to_target(struct smq_policy *mq, unsigned p)
 {
 	return from_cblock(mq->cache_size) * p / 100u;
@@ -1171,43 +1192,51 @@ static void clear_pending(struct smq_policy *mq, struct entry *e)
 	e->pending_work = false;
 }
 
-static void queue_writeback(struct smq_policy *mq, bool idle)
+static bool queue_writeback(struct smq_policy *mq, bool idle)
 {
 	int r;
 	struct policy_work work;
 	struct entry *e;
 
 	e = q_peek(&mq->dirty, mq->dirty.nr_levels, idle);
-	if (e) {
-		mark_pending(mq, e);
-		q_del(&mq->dirty, e);
+	if (!e)
+		return false;
 
-		work.op = POLICY_WRITEBACK;
-		work.oblock = e->oblock;
-		work.cblock = infer_cblock(mq, e);
+	mark_pending(mq, e);
+	q_del(&mq->dirty, e);
 
-		r = btracker_queue(mq->bg_work, &work, NULL);
-		if (r) {
-			clear_pending(mq, e);
-			q_push_front(&mq->dirty, e);
-		}
+	work.op = POLICY_WRITEBACK;
+	work.oblock = e->oblock;
+	work.cblock = infer_cblock(mq, e);
+
+	r = btracker_queue(mq->bg_work, &work, NULL);
+	if (r) {
+		clear_pending(mq, e);
+		q_push_front(&mq->dirty, e);
+		return false;
 	}
+
+	return true;
 }
 
-static void queue_demotion(struct smq_policy *mq)
+/*
+ * Returns true if a demotion was queued.  If there's nothing clean to
+ * demote a writeback may be queued instead, but false is returned.
+ */
+static bool queue_demotion(struct smq_policy *mq)
 {
 	int r;
 	struct policy_work work;
 	struct entry *e;
 
 	if (WARN_ON_ONCE(!mq->migrations_allowed))
-		return;
+		return false;
 
 	e = q_peek(&mq->clean, mq->clean.nr_levels / 2, true);
 	if (!e) {
 		if (!clean_target_met(mq, true))
 			queue_writeback(mq, false);
-		return;
+		return false;
 	}
 
 	mark_pending(mq, e);
@@ -1220,13 +1249,17 @@ static void queue_demotion(struct smq_policy *mq)
 	if (r) {
 		clear_pending(mq, e);
 		q_push_front(&mq->clean, e);
+		return false;
 	}
+
+	return true;
 }
 
 static void queue_promotion(struct smq_policy *mq, dm_oblock_t oblock,
 			    struct policy_work **workp)
 {
 	int r;
+	unsigned i;
 	struct entry *e;
 	struct policy_work work;
 
@@ -1238,8 +1271,9 @@ static void queue_promotion(struct smq_policy *mq, dm_oblock_t oblock,
 		 * We always claim to be 'idle' to ensure some demotions happen
 		 * with continuous loads.
 		 */
-		if (!free_target_met(mq))
-			queue_demotion(mq);
+		for (i = 0; i < DEMOTE_BATCH && !free_target_met(mq); i++)
+			if (!queue_demotion(mq))
+				break;
 		return;
 	}
 
@@ -1397,6 +1431,11 @@ static int __lookup(struct smq_policy *mq, dm_oblock_t oblock, dm_cblock_t *cblo
 	}
 }
 
+/*
+ * Called once per bio from the target's map function, which has to know
+ * whether to remap to the fast or the origin device before it returns,
+ * so lookups can't be gathered up and done under a single lock hold.
+ */
 static int smq_lookup(struct dm_cache_policy *p, dm_oblock_t oblock, dm_cblock_t *cblock,
 		      int data_dir, bool fast_copy,
 		      bool *background_work)
@@ -1435,16 +1474,18 @@ static int smq_get_background_work(struct dm_cache_policy *p, bool idle,
 				   struct policy_work **result)
 {
 	int r;
+	unsigned i;
 	unsigned long flags;
 	struct smq_policy *mq = to_smq_policy(p);
 
 	spin_lock_irqsave(&mq->lock, flags);
+	mq->background_idle = idle;
 	r = btracker_issue(mq->bg_work, result);
 	if (r == -ENODATA) {
-		if (!clean_target_met(mq, idle)) {
-			queue_writeback(mq, idle);
-			r = btracker_issue(mq->bg_work, result);
-		}
+		for (i = 0; i < WRITEBACK_BATCH && !clean_target_met(mq, idle); i++)
+			if (!queue_writeback(mq, idle))
+				break;
+		r = btracker_issue(mq->bg_work, result);
 	}
 	spin_unlock_irqrestore(&mq->lock, flags);
 
@@ -1778,6 +1819,7 @@ static struct dm_cache_policy *__smq_create(dm_cblock_t cache_size,
 
 	mq->tick = 0;
 	spin_lock_init(&mq->lock);
+	mq->background_idle = true;
 
 	q_init(&mq->hotspot, &mq->es, NR_HOTSPOT_LEVELS);
 	mq->hotspot.nr_top_levels = 8;
@@ -15,6 +15,7 @@
 #include <linux/init.h>
 #include <linux/mempool.h>
 #include <linux/module.h>
+#include <linux/percpu_counter.h>
 #include <linux/rwsem.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
@@ -356,10 +357,11 @@ struct cache_features {
 };
 
 struct cache_stats {
-	atomic_t read_hit;
-	atomic_t read_miss;
-	atomic_t write_hit;
-	atomic_t write_miss;
+	/* bumped on every bio, so kept per cpu */
+	struct percpu_counter read_hit;
+	struct percpu_counter read_miss;
+	struct percpu_counter write_hit;
+	struct percpu_counter write_miss;
 	atomic_t demotion;
 	atomic_t promotion;
 	atomic_t writeback;
@@ -1043,10 +1045,10 @@ static void load_stats(struct cache *cache)
 	struct dm_cache_statistics stats;
 
 	dm_cache_metadata_get_stats(cache->cmd, &stats);
-	atomic_set(&cache->stats.read_hit, stats.read_hits);
-	atomic_set(&cache->stats.read_miss, stats.read_misses);
-	atomic_set(&cache->stats.write_hit, stats.write_hits);
-	atomic_set(&cache->stats.write_miss, stats.write_misses);
+	percpu_counter_set(&cache->stats.read_hit, stats.read_hits);
+	percpu_counter_set(&cache->stats.read_miss, stats.read_misses);
+	percpu_counter_set(&cache->stats.write_hit, stats.write_hits);
+	percpu_counter_set(&cache->stats.write_miss, stats.write_misses);
 }
 
 static void save_stats(struct cache *cache)
@@ -1056,10 +1058,10 @@ static void save_stats(struct cache *cache)
 	if (get_cache_mode(cache) >= CM_READ_ONLY)
 		return;
 
-	stats.read_hits = atomic_read(&cache->stats.read_hit);
-	stats.read_misses = atomic_read(&cache->stats.read_miss);
-	stats.write_hits = atomic_read(&cache->stats.write_hit);
-	stats.write_misses = atomic_read(&cache->stats.write_miss);
+	stats.read_hits = percpu_counter_sum(&cache->stats.read_hit);
+	stats.read_misses = percpu_counter_sum(&cache->stats.read_miss);
+	stats.write_hits = percpu_counter_sum(&cache->stats.write_hit);
+	stats.write_misses = percpu_counter_sum(&cache->stats.write_miss);
 
 	dm_cache_metadata_set_stats(cache->cmd, &stats);
 }
@@ -1703,14 +1705,14 @@ static enum busy spare_migration_bandwidth(struct cache *cache)
 
 static void inc_hit_counter(struct cache *cache, struct bio *bio)
 {
-	atomic_inc(bio_data_dir(bio) == READ ?
-		   &cache->stats.read_hit : &cache->stats.write_hit);
+	percpu_counter_inc(bio_data_dir(bio) == READ ?
+			   &cache->stats.read_hit : &cache->stats.write_hit);
 }
 
 static void inc_miss_counter(struct cache *cache, struct bio *bio)
 {
-	atomic_inc(bio_data_dir(bio) == READ ?
-		   &cache->stats.read_miss : &cache->stats.write_miss);
+	percpu_counter_inc(bio_data_dir(bio) == READ ?
+			   &cache->stats.read_miss : &cache->stats.write_miss);
 }
 
 /*----------------------------------------------------------------*/
@@ -2008,6 +2010,11 @@ static void destroy(struct cache *cache)
 
 	mempool_exit(&cache->migration_pool);
 
+	percpu_counter_destroy(&cache->stats.read_hit);
+	percpu_counter_destroy(&cache->stats.read_miss);
+	percpu_counter_destroy(&cache->stats.write_hit);
+	percpu_counter_destroy(&cache->stats.write_miss);
+
 	if (cache->prison)
 		dm_bio_prison_destroy_v2(cache->prison);
 
@@ -2649,6 +2656,15 @@ static int cache_create(struct cache_args *ca, struct cache **result)
 	cache->loaded_mappings = false;
 	cache->loaded_discards = false;
 
+	if (percpu_counter_init(&cache->stats.read_hit, 0, GFP_KERNEL) ||
+	    percpu_counter_init(&cache->stats.read_miss, 0, GFP_KERNEL) ||
+	    percpu_counter_init(&cache->stats.write_hit, 0, GFP_KERNEL) ||
+	    percpu_counter_init(&cache->stats.write_miss, 0, GFP_KERNEL)) {
+		*error = "Error allocating hit counters";
+		r = -ENOMEM;
+		goto bad;
+	}
+
 	load_stats(cache);
 
 	atomic_set(&cache->stats.demotion, 0);
@@ -3178,10 +3194,10 @@ static void cache_status(struct dm_target *ti, status_type_t type,
 		       (unsigned long long)cache->sectors_per_block,
 		       (unsigned long long) from_cblock(residency),
 		       (unsigned long long) from_cblock(cache->cache_size),
-		       (unsigned) atomic_read(&cache->stats.read_hit),
-		       (unsigned) atomic_read(&cache->stats.read_miss),
-		       (unsigned) atomic_read(&cache->stats.write_hit),
-		       (unsigned) atomic_read(&cache->stats.write_miss),
+		       (unsigned) percpu_counter_sum(&cache->stats.read_hit),
+		       (unsigned) percpu_counter_sum(&cache->stats.read_miss),
+		       (unsigned) percpu_counter_sum(&cache->stats.write_hit),
+		       (unsigned) percpu_counter_sum(&cache->stats.write_miss),
 		       (unsigned) atomic_read(&cache->stats.demotion),
 		       (unsigned) atomic_read(&cache->stats.promotion),
 		       (unsigned long) atomic_read(&cache->nr_dirty));
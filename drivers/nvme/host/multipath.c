@@ -174,17 +174,169 @@ static inline bool nvme_path_is_optimized(struct nvme_ns *ns)
 		ns->ana_state == NVME_ANA_OPTIMIZED;
 }
 
+static inline bool nvme_path_is_usable(struct nvme_ns *ns)
+{
+	return ns->ctrl->state == NVME_CTRL_LIVE &&
+		!test_bit(NVME_NS_ANA_PENDING, &ns->flags) &&
+		(ns->ana_state == NVME_ANA_OPTIMIZED ||
+		 ns->ana_state == NVME_ANA_NONOPTIMIZED);
+}
+
+static struct nvme_ns *nvme_next_ns(struct nvme_ns_head *head,
+		struct nvme_ns *ns)
+{
+	ns = list_next_or_null_rcu(&head->list, &ns->siblings, struct nvme_ns,
+			siblings);
+	if (ns)
+		return ns;
+	return list_first_or_null_rcu(&head->list, struct nvme_ns, siblings);
+}
+
+/*
+ * Hand out the optimized paths in turn, starting after the one we used last
+ * from this node.  Non-optimized paths are only used if no optimized path
+ * is left.
+ */
+static struct nvme_ns *nvme_round_robin_path(struct nvme_ns_head *head,
+		int node, struct nvme_ns *old)
+{
+	struct nvme_ns *ns, *found = NULL;
+
+	/* @old may already be off the list, in which case we'd never find it */
+	if (test_bit(NVME_NS_REMOVING, &old->flags))
+		return __nvme_find_path(head, node);
+
+	for (ns = nvme_next_ns(head, old);
+	     ns && ns != old;
+	     ns = nvme_next_ns(head, ns)) {
+		if (!nvme_path_is_usable(ns))
+			continue;
+		if (ns->ana_state == NVME_ANA_OPTIMIZED) {
+			found = ns;
+			break;
+		}
+		if (!found)
+			found = ns;
+	}
+
+	if (!found) {
+		if (!nvme_path_is_optimized(old))
+			return __nvme_find_path(head, node);
+		return old;
+	}
+	rcu_assign_pointer(head->current_path[node], found);
+	return found;
+}
+
+/*
+ * Estimated cost of queueing one more command on @ns: the number of commands
+ * outstanding on its controller for queue-depth, and that number times the
+ * average service time of the controller for service-time.
+ */
+static inline u64 nvme_path_cost(struct nvme_ns *ns, enum nvme_iopolicy policy)
+{
+	u64 depth = atomic_read(&ns->ctrl->nr_active) + 1;
+
+	if (policy == NVME_IOPOLICY_QD)
+		return depth;
+	return depth * max_t(u64, READ_ONCE(ns->ctrl->service_time), 1);
+}
+
+static struct nvme_ns *nvme_least_cost_path(struct nvme_ns_head *head,
+		int node, enum nvme_iopolicy policy)
+{
+	u64 found_cost = U64_MAX, fallback_cost = U64_MAX, cost;
+	struct nvme_ns *found = NULL, *fallback = NULL, *ns;
+
+	list_for_each_entry_rcu(ns, &head->list, siblings) {
+		if (!nvme_path_is_usable(ns))
+			continue;
+
+		cost = nvme_path_cost(ns, policy);
+		if (ns->ana_state == NVME_ANA_OPTIMIZED) {
+			if (cost < found_cost) {
+				found_cost = cost;
+				found = ns;
+			}
+		} else if (cost < fallback_cost) {
+			fallback_cost = cost;
+			fallback = ns;
+		}
+	}
+
+	if (!found)
+		found = fallback;
+	/* keep current_path up to date for nvme_ns_head_poll() */
+	if (found && found != rcu_access_pointer(head->current_path[node]))
+		rcu_assign_pointer(head->current_path[node], found);
+	return found;
+}
+
 inline struct nvme_ns *nvme_find_path(struct nvme_ns_head *head)
 {
+	enum nvme_iopolicy policy = READ_ONCE(head->subsys->iopolicy);
 	int node = numa_node_id();
 	struct nvme_ns *ns;
 
+	if (policy == NVME_IOPOLICY_QD || policy == NVME_IOPOLICY_ST)
+		return nvme_least_cost_path(head, node, policy);
+
 	ns = srcu_dereference(head->current_path[node], &head->srcu);
+	if (policy == NVME_IOPOLICY_RR && ns)
+		return nvme_round_robin_path(head, node, ns);
 	if (unlikely(!ns || !nvme_path_is_optimized(ns)))
 		ns = __nvme_find_path(head, node);
 	return ns;
 }
 
+static inline bool nvme_mpath_track_active(struct nvme_subsystem *subsys)
+{
+	enum nvme_iopolicy policy = READ_ONCE(subsys->iopolicy);
+
+	return policy == NVME_IOPOLICY_QD || policy == NVME_IOPOLICY_ST;
+}
+
+void nvme_mpath_start_request(struct request *rq)
+{
+	struct nvme_ns *ns = rq->q->queuedata;
+
+	if (!(rq->cmd_flags & REQ_NVME_MPATH) ||
+	    !nvme_mpath_track_active(ns->head->subsys))
+		return;
+
+	nvme_req(rq)->flags |= NVME_MPATH_IO_STATS;
+	nvme_req(rq)->start_time = ktime_get_ns();
+	atomic_inc(&ns->ctrl->nr_active);
+}
+
+/*
+ * Called from both the completion and the submission error paths, so it has
+ * to be idempotent.  The service time average is updated without any
+ * locking; losing the odd sample to a concurrent completion doesn't matter.
+ */
+void nvme_mpath_end_request(struct request *rq)
+{
+	struct nvme_ns *ns = rq->q->queuedata;
+	struct nvme_ctrl *ctrl;
+	u64 now, avg;
+
+	if (!(nvme_req(rq)->flags & NVME_MPATH_IO_STATS))
+		return;
+	nvme_req(rq)->flags &= ~NVME_MPATH_IO_STATS;
+
+	ctrl = ns->ctrl;
+	atomic_dec(&ctrl->nr_active);
+
+	now = ktime_get_ns();
+	if (now <= nvme_req(rq)->start_time)
+		return;
+	avg = READ_ONCE(ctrl->service_time);
+	if (avg)
+		avg -= avg >> 3;
+	avg += (now - nvme_req(rq)->start_time) >> 3;
+	WRITE_ONCE(ctrl->service_time, avg);
+}
+
 static blk_qc_t nvme_ns_head_make_request(struct request_queue *q,
 		struct bio *bio)
 {
@@ -479,6 +631,43 @@ static void nvme_anatt_timeout(struct timer_list *t)
 	nvme_reset_ctrl(ctrl);
 }
 
+static const char *nvme_iopolicy_names[] = {
+	[NVME_IOPOLICY_NUMA]	= "numa",
+	[NVME_IOPOLICY_RR]	= "round-robin",
+	[NVME_IOPOLICY_QD]	= "queue-depth",
+	[NVME_IOPOLICY_ST]	= "service-time",
+};
+
+static ssize_t nvme_subsys_iopolicy_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct nvme_subsystem *subsys =
+		container_of(dev, struct nvme_subsystem, dev);
+
+	return sprintf(buf, "%s\n",
+			nvme_iopolicy_names[READ_ONCE(subsys->iopolicy)]);
+}
+
+static ssize_t nvme_subsys_iopolicy_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct nvme_subsystem *subsys =
+		container_of(dev, struct nvme_subsystem, dev);
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(nvme_iopolicy_names); i++) {
+		if (sysfs_streq(buf, nvme_iopolicy_names[i])) {
+			WRITE_ONCE(subsys->iopolicy, i);
+			return count;
+		}
+	}
+
+	return -EINVAL;
+}
+struct device_attribute subsys_attr_iopolicy =
+	__ATTR(iopolicy, S_IRUGO | S_IWUSR, nvme_subsys_iopolicy_show,
+	       nvme_subsys_iopolicy_store);
+
 void nvme_mpath_stop(struct nvme_ctrl *ctrl)
 {
 	if (!nvme_ctrl_use_ana(ctrl))
@@ -17,6 +17,7 @@
 #include <linux/blkdev.h>
 #include <linux/blk-mq.h>
 #include <linux/blk-mq-pci.h>
+#include <linux/dim.h>
 #include <linux/dmi.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
@@ -64,6 +65,11 @@ MODULE_PARM_DESC(sgl_threshold,
 		"Use SGLs when average request segment size is larger or equal to "
 		"this size. Use 0 to disable SGLs.");
 
+static bool use_dim;
+module_param(use_dim, bool, 0444);
+MODULE_PARM_DESC(use_dim,
+	"adapt the controller's interrupt coalescing to the completion rate");
+
 static int io_queue_depth_set(const char *val, const struct kernel_param *kp);
 static const struct kernel_param_ops io_queue_depth_ops = {
 	.set = io_queue_depth_set,
@@ -121,6 +127,10 @@ struct nvme_dev {
 	dma_addr_t host_mem_descs_dma;
 	struct nvme_host_mem_buf_desc *host_mem_descs;
 	void **host_mem_desc_bufs;
+
+	/* interrupt coalescing profile in use, see nvme_dim_work() */
+	struct mutex dim_lock;
+	u8 dim_profile;
 };
 
 static int io_queue_depth_set(const char *val, const struct kernel_param *kp)
@@ -176,6 +186,7 @@ struct nvme_queue {
 	u32 *dbbuf_cq_db;
 	u32 *dbbuf_sq_ei;
 	u32 *dbbuf_cq_ei;
+	struct dim dim;
 };
 
 /*
@@ -873,7 +884,11 @@ static inline void nvme_ring_cq_doorbell(struct nvme_queue *nvmeq)
 		writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
 }
 
-static inline void nvme_handle_cqe(struct nvme_queue *nvmeq, u16 idx)
+/* Successful completions ended together from one pass over the CQ */
+#define NVME_COMPLETE_BATCH	32
+
+static inline void nvme_handle_cqe(struct nvme_queue *nvmeq, u16 idx,
+		struct request **batch, unsigned int *nr)
 {
 	volatile struct nvme_completion *cqe = &nvmeq->cqes[idx];
 	struct request *req;
@@ -899,16 +914,28 @@ static inline void nvme_handle_cqe(struct nvme_queue *nvmeq, u16 idx)
 	}
 
 	req = blk_mq_tag_to_rq(*nvmeq->tags, cqe->command_id);
-	nvme_end_request(req, cqe->status, cqe->result);
+	if (nvme_end_request_batch(req, cqe->status, cqe->result)) {
+		nvme_unmap_data(nvmeq->dev, req);
+		batch[(*nr)++] = req;
+	}
 }
 
 static void nvme_complete_cqes(struct nvme_queue *nvmeq, u16 start, u16 end)
 {
+	struct request *batch[NVME_COMPLETE_BATCH];
+	unsigned int nr = 0;
+
 	while (start != end) {
-		nvme_handle_cqe(nvmeq, start);
+		nvme_handle_cqe(nvmeq, start, batch, &nr);
+		if (nr == NVME_COMPLETE_BATCH) {
+			nvme_complete_batch(batch, nr);
+			nr = 0;
+		}
 		if (++start == nvmeq->q_depth)
 			start = 0;
 	}
+	if (nr)
+		nvme_complete_batch(batch, nr);
 }
 
 static inline void nvme_update_cq_head(struct nvme_queue *nvmeq)
@@ -919,15 +946,20 @@ static inline void nvme_update_cq_head(struct nvme_queue *nvmeq)
 	}
 }
 
-static inline bool nvme_process_cq(struct nvme_queue *nvmeq, u16 *start,
+/*
+ * Reap all pending completion queue entries instead of stopping at the one
+ * for @tag, so that a single poll harvests every completion that is ready.
+ * Returns the number of entries matching @tag, -1 matches all of them.
+ */
+static inline int nvme_process_cq(struct nvme_queue *nvmeq, u16 *start,
 		u16 *end, int tag)
 {
-	bool found = false;
+	int found = 0;
 
 	*start = nvmeq->cq_head;
-	while (!found && nvme_cqe_pending(nvmeq)) {
-		if (nvmeq->cqes[nvmeq->cq_head].command_id == tag)
-			found = true;
+	while (nvme_cqe_pending(nvmeq)) {
+		if (tag == -1 || nvmeq->cqes[nvmeq->cq_head].command_id == tag)
+			found++;
 		nvme_update_cq_head(nvmeq);
 	}
 	*end = nvmeq->cq_head;
@@ -937,19 +969,74 @@ static inline bool nvme_process_cq(struct nvme_queue *nvmeq, u16 *start,
 	return found;
 }
 
+/*
+ * Interrupt coalescing profiles, as aggregation time and threshold.  The
+ * controller takes the time in 100us units, profile 0 turns it off.
+ */
+static const struct dim_cq_moder
+nvme_dim_prof[RDMA_DIM_PARAMS_NUM_PROFILES] = {
+	{0,   0, 1,  0},
+	{100, 0, 2,  0},
+	{100, 0, 4,  0},
+	{100, 0, 8,  0},
+	{200, 0, 8,  0},
+	{200, 0, 16, 0},
+	{300, 0, 16, 0},
+	{300, 0, 32, 0},
+	{400, 0, 32, 0},
+};
+
+/*
+ * Interrupt coalescing (Set Features 08h) applies to every I/O vector of
+ * the controller, so each queue runs its own DIM and the controller gets
+ * the highest profile any of them asks for.
+ */
+static void nvme_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct nvme_queue *nvmeq = dim->priv;
+	struct nvme_dev *dev = nvmeq->dev;
+	const struct dim_cq_moder *prof;
+	u8 ix = 0;
+	int i;
+
+	mutex_lock(&dev->dim_lock);
+	for (i = 1; i < dev->ctrl.queue_count; i++)
+		ix = max(ix, dev->queues[i].dim.profile_ix);
+	dim->state = DIM_START_MEASURE;
+
+	if (ix != dev->dim_profile && dev->ctrl.state == NVME_CTRL_LIVE) {
+		prof = &nvme_dim_prof[ix];
+		if (!nvme_set_features(&dev->ctrl, NVME_FEAT_IRQ_COALESCE,
+				       (prof->usec / 100) << 8 |
+				       (prof->comps - 1), NULL, 0, NULL))
+			dev->dim_profile = ix;
+	}
+	mutex_unlock(&dev->dim_lock);
+}
+
 static irqreturn_t nvme_irq(int irq, void *data)
 {
 	struct nvme_queue *nvmeq = data;
 	irqreturn_t ret = IRQ_NONE;
 	u16 start, end;
+	int found;
 
 	spin_lock(&nvmeq->cq_lock);
 	if (nvmeq->cq_head != nvmeq->last_cq_head)
 		ret = IRQ_HANDLED;
-	nvme_process_cq(nvmeq, &start, &end, -1);
+	found = nvme_process_cq(nvmeq, &start, &end, -1);
 	nvmeq->last_cq_head = nvmeq->cq_head;
 	spin_unlock(&nvmeq->cq_lock);
 
+	/*
+	 * Despite its name, rdma_dim() is just the completion-count based
+	 * flavour of DIM: it needs no byte or packet counts, which a
+	 * completion queue doesn't have, unlike net_dim().
+	 */
+	if (use_dim && nvmeq->qid)
+		rdma_dim(&nvmeq->dim, found);
+
 	if (start != end) {
 		nvme_complete_cqes(nvmeq, start, end);
 		return IRQ_HANDLED;
@@ -966,10 +1053,10 @@ static irqreturn_t nvme_irq_check(int irq, void *data)
 	return IRQ_NONE;
 }
 
-static int __nvme_poll(struct nvme_queue *nvmeq, unsigned int tag)
+static int __nvme_poll(struct nvme_queue *nvmeq, int tag)
 {
 	u16 start, end;
-	bool found;
+	int found;
 
 	if (!nvme_cqe_pending(nvmeq))
 		return 0;
@@ -986,7 +1073,11 @@ static int nvme_poll(struct blk_mq_hw_ctx *hctx, unsigned int tag)
 {
 	struct nvme_queue *nvmeq = hctx->driver_data;
 
-	return __nvme_poll(nvmeq, tag);
+	/*
+	 * Count every completion, not just @tag: callers recheck their own
+	 * requests, and batched pollers want to know about all of them.
+	 */
+	return __nvme_poll(nvmeq, -1);
 }
 
 static void nvme_pci_submit_async_event(struct nvme_ctrl *ctrl)
@@ -1235,6 +1326,7 @@ static enum blk_eh_timer_return nvme_timeout(struct request *req, bool reserved)
 
 static void nvme_free_queue(struct nvme_queue *nvmeq)
 {
+	cancel_work_sync(&nvmeq->dim.work);
 	dma_free_coherent(nvmeq->q_dmadev, CQ_SIZE(nvmeq->q_depth),
 				(void *)nvmeq->cqes, nvmeq->cq_dma_addr);
 
@@ -1382,6 +1474,12 @@ static int nvme_alloc_queue(struct nvme_dev *dev, int qid, int depth)
 	nvmeq->q_depth = depth;
 	nvmeq->qid = qid;
 	nvmeq->cq_vector = -1;
+	memset(&nvmeq->dim, 0, sizeof(nvmeq->dim));
+	nvmeq->dim.state = DIM_START_MEASURE;
+	nvmeq->dim.tune_state = DIM_GOING_RIGHT;
+	nvmeq->dim.profile_ix = RDMA_DIM_START_PROFILE;
+	nvmeq->dim.priv = nvmeq;
+	INIT_WORK(&nvmeq->dim.work, nvme_dim_work);
 	dev->ctrl.queue_count++;
 
 	return 0;
@@ -2290,6 +2388,11 @@ static void nvme_reset_work(struct work_struct *work)
 	if (result)
 		goto out;
 
+	/* the reset put interrupt coalescing back to its default */
+	mutex_lock(&dev->dim_lock);
+	dev->dim_profile = 0;
+	mutex_unlock(&dev->dim_lock);
+
 	result = nvme_pci_configure_admin_queue(dev);
 	if (result)
 		goto out;
@@ -2506,6 +2609,7 @@ static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 	INIT_WORK(&dev->ctrl.reset_work, nvme_reset_work);
 	INIT_WORK(&dev->remove_work, nvme_remove_dead_ctrl_work);
 	mutex_init(&dev->shutdown_lock);
+	mutex_init(&dev->dim_lock);
 	init_completion(&dev->ioq_wait);
 
 	result = nvme_setup_prp_pools(dev);
@@ -32,6 +32,7 @@ static const struct nvmet_transport_name {
 	{ NVMF_TRTYPE_RDMA,	"rdma" },
 	{ NVMF_TRTYPE_FC,	"fc" },
 	{ NVMF_TRTYPE_LOOP,	"loop" },
+	{ NVMF_TRTYPE_TCP,	"tcp" },
 };
 
 /*
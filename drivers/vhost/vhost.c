@@ -31,6 +31,7 @@
 #include <linux/sched/signal.h>
 #include <linux/interval_tree_generic.h>
 #include <linux/nospec.h>
+#include <linux/idr.h>
 
 #include "vhost.h"
 
@@ -47,6 +48,10 @@ enum {
 	VHOST_MEMORY_F_LOG = 0x1,
 };
 
+/* all workers by id, for VHOST_ATTACH_VRING_WORKER */
+static DEFINE_IDR(vhost_workers);
+static DEFINE_MUTEX(vhost_workers_mutex);
+
 #define vhost_used_event(vq) ((__virtio16 __user *)&vq->avail->ring[vq->num])
 #define vhost_avail_event(vq) ((__virtio16 __user *)&vq->used->ring[vq->num])
 
@@ -187,12 +192,14 @@ EXPORT_SYMBOL_GPL(vhost_work_init);
 
 /* Init poll structure */
 void vhost_poll_init(struct vhost_poll *poll, vhost_work_fn_t fn,
-		     __poll_t mask, struct vhost_dev *dev)
+		     __poll_t mask, struct vhost_dev *dev,
+		     struct vhost_virtqueue *vq)
 {
 	init_waitqueue_func_entry(&poll->wait, vhost_poll_wakeup);
 	init_poll_funcptr(&poll->table, vhost_poll_func);
 	poll->mask = mask;
 	poll->dev = dev;
+	poll->vq = vq;
 	poll->wqh = NULL;
 
 	vhost_work_init(&poll->work, fn);
@@ -232,16 +239,54 @@ void vhost_poll_stop(struct vhost_poll *poll)
 }
 EXPORT_SYMBOL_GPL(vhost_poll_stop);
 
-void vhost_work_flush(struct vhost_dev *dev, struct vhost_work *work)
+static void vhost_worker_queue(struct vhost_worker *worker,
+			       struct vhost_work *work)
+{
+	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
+		/* We can only add the work to the list after we're
+		 * sure it was not in the list.
+		 * test_and_set_bit() implies a memory barrier.
+		 */
+		llist_add(&work->node, &worker->work_list);
+		wake_up_process(worker->task);
+	}
+}
+
+static void vhost_worker_flush(struct vhost_worker *worker)
 {
 	struct vhost_flush_struct flush;
 
-	if (dev->worker) {
-		init_completion(&flush.wait_event);
-		vhost_work_init(&flush.work, vhost_flush_work);
+	init_completion(&flush.wait_event);
+	vhost_work_init(&flush.work, vhost_flush_work);
 
-		vhost_work_queue(dev, &flush.work);
-		wait_for_completion(&flush.wait_event);
+	vhost_worker_queue(worker, &flush.work);
+	wait_for_completion(&flush.wait_event);
+}
+
+/* Must be called under rcu_read_lock() or vq->mutex */
+static struct vhost_worker *vhost_vq_worker(struct vhost_virtqueue *vq)
+{
+	struct vhost_worker *worker = rcu_dereference_check(vq->worker,
+					lockdep_is_held(&vq->mutex));
+
+	return worker ? worker : vq->dev->worker;
+}
+
+/* Flush the workers of the device and of all its virtqueues. Called with
+ * the device mutex held, so that no virtqueue moves to another worker. */
+void vhost_work_flush(struct vhost_dev *dev, struct vhost_work *work)
+{
+	struct vhost_worker *worker;
+	int i;
+
+	if (!dev->worker)
+		return;
+
+	vhost_worker_flush(dev->worker);
+	for (i = 0; i < dev->nvqs; ++i) {
+		worker = rcu_dereference_protected(dev->vqs[i]->worker, 1);
+		if (worker)
+			vhost_worker_flush(worker);
 	}
 }
 EXPORT_SYMBOL_GPL(vhost_work_flush);
@@ -250,7 +295,16 @@ EXPORT_SYMBOL_GPL(vhost_work_flush);
  * locks that are also used by the callback. */
 void vhost_poll_flush(struct vhost_poll *poll)
 {
-	vhost_work_flush(poll->dev, &poll->work);
+	struct vhost_worker *worker;
+
+	if (!poll->dev->worker)
+		return;
+
+	rcu_read_lock();
+	worker = poll->vq ? vhost_vq_worker(poll->vq) : poll->dev->worker;
+	rcu_read_unlock();
+	/* the device mutex keeps the worker from going away */
+	vhost_worker_flush(worker);
 }
 EXPORT_SYMBOL_GPL(vhost_poll_flush);
 
@@ -259,27 +313,48 @@ void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work)
 	if (!dev->worker)
 		return;
 
-	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
-		/* We can only add the work to the list after we're
-		 * sure it was not in the list.
-		 * test_and_set_bit() implies a memory barrier.
-		 */
-		llist_add(&work->node, &dev->work_list);
-		wake_up_process(dev->worker);
-	}
+	vhost_worker_queue(dev->worker, work);
 }
 EXPORT_SYMBOL_GPL(vhost_work_queue);
 
+void vhost_vq_work_queue(struct vhost_virtqueue *vq, struct vhost_work *work)
+{
+	if (!vq->dev->worker)
+		return;
+
+	rcu_read_lock();
+	vhost_worker_queue(vhost_vq_worker(vq), work);
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL_GPL(vhost_vq_work_queue);
+
 /* A lockless hint for busy polling code to exit the loop */
 bool vhost_has_work(struct vhost_dev *dev)
 {
-	return !llist_empty(&dev->work_list);
+	return dev->worker && !llist_empty(&dev->worker->work_list);
 }
 EXPORT_SYMBOL_GPL(vhost_has_work);
 
+bool vhost_vq_has_work(struct vhost_virtqueue *vq)
+{
+	bool ret;
+
+	if (!vq->dev->worker)
+		return false;
+
+	rcu_read_lock();
+	ret = !llist_empty(&vhost_vq_worker(vq)->work_list);
+	rcu_read_unlock();
+	return ret;
+}
+EXPORT_SYMBOL_GPL(vhost_vq_has_work);
+
 void vhost_poll_queue(struct vhost_poll *poll)
 {
-	vhost_work_queue(poll->dev, &poll->work);
+	if (poll->vq)
+		vhost_vq_work_queue(poll->vq, &poll->work);
+	else
+		vhost_work_queue(poll->dev, &poll->work);
 }
 EXPORT_SYMBOL_GPL(vhost_poll_queue);
 
@@ -314,6 +389,9 @@ static void vhost_vq_reset(struct vhost_dev *dev,
 	vq->last_used_idx = 0;
 	vq->signalled_used = 0;
 	vq->signalled_used_valid = false;
+	vq->avail_wrap_counter = true;
+	vq->used_wrap_counter = true;
+	vq->packed_fetch_idx = 0;
 	vq->used_flags = 0;
 	vq->log_used = false;
 	vq->log_addr = -1ull;
@@ -335,13 +413,13 @@ static void vhost_vq_reset(struct vhost_dev *dev,
 
 static int vhost_worker(void *data)
 {
-	struct vhost_dev *dev = data;
+	struct vhost_worker *worker = data;
 	struct vhost_work *work, *work_next;
 	struct llist_node *node;
 	mm_segment_t oldfs = get_fs();
 
 	set_fs(USER_DS);
-	use_mm(dev->mm);
+	use_mm(worker->mm);
 
 	for (;;) {
 		/* mb paired w/ kthread_stop */
@@ -352,7 +430,7 @@ static int vhost_worker(void *data)
 			break;
 		}
 
-		node = llist_del_all(&dev->work_list);
+		node = llist_del_all(&worker->work_list);
 		if (!node)
 			schedule();
 
@@ -367,7 +445,7 @@ static int vhost_worker(void *data)
 				schedule();
 		}
 	}
-	unuse_mm(dev->mm);
+	unuse_mm(worker->mm);
 	set_fs(oldfs);
 	return 0;
 }
@@ -380,6 +458,9 @@ static void vhost_vq_free_iovecs(struct vhost_virtqueue *vq)
 	vq->log = NULL;
 	kfree(vq->heads);
 	vq->heads = NULL;
+	kvfree(vq->packed_ndescs);
+	vq->packed_ndescs = NULL;
+	vq->packed_fetched = NULL;
 }
 
 /* Helper to allocate iovec buffers for all vqs. */
@@ -430,7 +511,8 @@ void vhost_dev_init(struct vhost_dev *dev,
 	dev->iotlb = NULL;
 	dev->mm = NULL;
 	dev->worker = NULL;
-	init_llist_head(&dev->work_list);
+	INIT_LIST_HEAD(&dev->workers);
+	dev->vq_workers = false;
 	init_waitqueue_head(&dev->wait);
 	INIT_LIST_HEAD(&dev->read_list);
 	INIT_LIST_HEAD(&dev->pending_list);
@@ -443,11 +525,12 @@ void vhost_dev_init(struct vhost_dev *dev,
 		vq->indirect = NULL;
 		vq->heads = NULL;
 		vq->dev = dev;
+		RCU_INIT_POINTER(vq->worker, NULL);
 		mutex_init(&vq->mutex);
 		vhost_vq_reset(dev, vq);
 		if (vq->handle_kick)
 			vhost_poll_init(&vq->poll, vq->handle_kick,
-					EPOLLIN, dev);
+					EPOLLIN, dev, vq);
 	}
 }
 EXPORT_SYMBOL_GPL(vhost_dev_init);
@@ -474,17 +557,234 @@ static void vhost_attach_cgroups_work(struct vhost_work *work)
 	s->ret = cgroup_attach_task_all(s->owner, current);
 }
 
-static int vhost_attach_cgroups(struct vhost_dev *dev)
+static int vhost_attach_cgroups(struct vhost_worker *worker)
 {
 	struct vhost_attach_cgroups_struct attach;
 
 	attach.owner = current;
 	vhost_work_init(&attach.work, vhost_attach_cgroups_work);
-	vhost_work_queue(dev, &attach.work);
-	vhost_work_flush(dev, &attach.work);
+	vhost_worker_queue(worker, &attach.work);
+	vhost_worker_flush(worker);
 	return attach.ret;
 }
 
+/* Start a worker in the mm and the cgroups of the owner of @dev */
+static struct vhost_worker *vhost_worker_create(struct vhost_dev *dev)
+{
+	struct vhost_worker *worker;
+	struct task_struct *task;
+	int id, ret;
+
+	worker = kzalloc(sizeof(*worker), GFP_KERNEL);
+	if (!worker)
+		return ERR_PTR(-ENOMEM);
+
+	init_llist_head(&worker->work_list);
+	refcount_set(&worker->refcount, 1);
+	INIT_LIST_HEAD(&worker->node);
+	mmget(dev->mm);
+	worker->mm = dev->mm;
+
+	/* not to be found before it is up and running */
+	mutex_lock(&vhost_workers_mutex);
+	id = idr_alloc(&vhost_workers, NULL, 0, 0, GFP_KERNEL);
+	mutex_unlock(&vhost_workers_mutex);
+	if (id < 0) {
+		ret = id;
+		goto err_id;
+	}
+	worker->id = id;
+
+	task = kthread_create(vhost_worker, worker, "vhost-%d", current->pid);
+	if (IS_ERR(task)) {
+		ret = PTR_ERR(task);
+		goto err_task;
+	}
+
+	worker->task = task;
+	wake_up_process(task);	/* avoid contributing to loadavg */
+
+	ret = vhost_attach_cgroups(worker);
+	if (ret)
+		goto err_cgroup;
+
+	mutex_lock(&vhost_workers_mutex);
+	idr_replace(&vhost_workers, worker, id);
+	mutex_unlock(&vhost_workers_mutex);
+	return worker;
+
+err_cgroup:
+	kthread_stop(task);
+err_task:
+	mutex_lock(&vhost_workers_mutex);
+	idr_remove(&vhost_workers, id);
+	mutex_unlock(&vhost_workers_mutex);
+err_id:
+	mmput(worker->mm);
+	kfree(worker);
+	return ERR_PTR(ret);
+}
+
+static void vhost_worker_put(struct vhost_worker *worker)
+{
+	if (!refcount_dec_and_test(&worker->refcount))
+		return;
+
+	mutex_lock(&vhost_workers_mutex);
+	idr_remove(&vhost_workers, worker->id);
+	mutex_unlock(&vhost_workers_mutex);
+
+	WARN_ON(!llist_empty(&worker->work_list));
+	kthread_stop(worker->task);
+	mmput(worker->mm);
+	kfree(worker);
+}
+
+/* Take a reference to worker @id, if it runs in the mm of @dev */
+static struct vhost_worker *vhost_worker_get(struct vhost_dev *dev, u32 id)
+{
+	struct vhost_worker *worker;
+
+	mutex_lock(&vhost_workers_mutex);
+	worker = idr_find(&vhost_workers, id);
+	if (worker && (worker->mm != dev->mm ||
+		       !refcount_inc_not_zero(&worker->refcount)))
+		worker = NULL;
+	mutex_unlock(&vhost_workers_mutex);
+	return worker;
+}
+
+static long vhost_new_worker(struct vhost_dev *dev, void __user *argp)
+{
+	struct vhost_worker_state state;
+	struct vhost_worker *worker;
+
+	worker = vhost_worker_create(dev);
+	if (IS_ERR(worker))
+		return PTR_ERR(worker);
+
+	state.worker_id = worker->id;
+	if (copy_to_user(argp, &state, sizeof(state))) {
+		vhost_worker_put(worker);
+		return -EFAULT;
+	}
+
+	list_add_tail(&worker->node, &dev->workers);
+	return 0;
+}
+
+static long vhost_free_worker(struct vhost_dev *dev, void __user *argp)
+{
+	struct vhost_worker_state state;
+	struct vhost_worker *worker;
+
+	if (copy_from_user(&state, argp, sizeof(state)))
+		return -EFAULT;
+
+	list_for_each_entry(worker, &dev->workers, node) {
+		if (worker->id != state.worker_id)
+			continue;
+		/* a vring of this or another device still runs on it */
+		if (refcount_read(&worker->refcount) > 1)
+			return -EBUSY;
+		list_del(&worker->node);
+		vhost_worker_put(worker);
+		return 0;
+	}
+	return -ENODEV;
+}
+
+static long vhost_attach_vring_worker(struct vhost_dev *dev,
+				      void __user *argp)
+{
+	struct vhost_worker *worker, *old;
+	struct vhost_vring_worker w;
+	struct vhost_virtqueue *vq;
+
+	/*
+	 * vhost-scsi completes commands from a device wide work item that
+	 * relies on running on the same thread as the vq handlers.
+	 */
+	if (!dev->vq_workers)
+		return -EOPNOTSUPP;
+
+	if (copy_from_user(&w, argp, sizeof(w)))
+		return -EFAULT;
+	if (w.index >= dev->nvqs)
+		return -ENOBUFS;
+	vq = dev->vqs[array_index_nospec(w.index, dev->nvqs)];
+
+	worker = vhost_worker_get(dev, w.worker_id);
+	if (!worker)
+		return -ENODEV;
+	/* the device worker is what a vq runs on by default */
+	if (worker == dev->worker) {
+		vhost_worker_put(worker);
+		worker = NULL;
+	}
+
+	mutex_lock(&vq->mutex);
+	old = rcu_dereference_protected(vq->worker,
+					lockdep_is_held(&vq->mutex));
+	rcu_assign_pointer(vq->worker, worker);
+	mutex_unlock(&vq->mutex);
+
+	/*
+	 * Wait for the wakeups that still saw the old worker, then for the
+	 * works they queued there.
+	 */
+	synchronize_rcu();
+	vhost_worker_flush(old ? old : dev->worker);
+	if (old)
+		vhost_worker_put(old);
+	return 0;
+}
+
+static long vhost_get_vring_worker(struct vhost_dev *dev, void __user *argp)
+{
+	struct vhost_vring_worker w;
+	struct vhost_virtqueue *vq;
+
+	if (copy_from_user(&w, argp, sizeof(w)))
+		return -EFAULT;
+	if (w.index >= dev->nvqs)
+		return -ENOBUFS;
+	vq = dev->vqs[array_index_nospec(w.index, dev->nvqs)];
+
+	mutex_lock(&vq->mutex);
+	w.worker_id = vhost_vq_worker(vq)->id;
+	mutex_unlock(&vq->mutex);
+
+	if (copy_to_user(argp, &w, sizeof(w)))
+		return -EFAULT;
+	return 0;
+}
+
+/* Drop the workers the vqs run on and the ones the device made */
+static void vhost_dev_free_workers(struct vhost_dev *dev)
+{
+	struct vhost_worker *worker, *tmp;
+	int i;
+
+	for (i = 0; i < dev->nvqs; ++i) {
+		worker = rcu_dereference_protected(dev->vqs[i]->worker, 1);
+		if (worker) {
+			RCU_INIT_POINTER(dev->vqs[i]->worker, NULL);
+			vhost_worker_put(worker);
+		}
+	}
+
+	list_for_each_entry_safe(worker, tmp, &dev->workers, node) {
+		list_del(&worker->node);
+		vhost_worker_put(worker);
+	}
+
+	if (dev->worker) {
+		vhost_worker_put(dev->worker);
+		dev->worker = NULL;
+	}
+}
+
 /* Caller should have device mutex */
 bool vhost_dev_has_owner(struct vhost_dev *dev)
 {
@@ -506,26 +806,21 @@ long vhost_dev_set_owner(struct vhost_dev *dev)
 
 	/* No owner, become one */
 	dev->mm = get_task_mm(current);
-	worker = kthread_create(vhost_worker, dev, "vhost-%d", current->pid);
+	worker = vhost_worker_create(dev);
 	if (IS_ERR(worker)) {
 		err = PTR_ERR(worker);
 		goto err_worker;
 	}
 
 	dev->worker = worker;
-	wake_up_process(worker);	/* avoid contributing to loadavg */
-
-	err = vhost_attach_cgroups(dev);
-	if (err)
-		goto err_cgroup;
 
 	err = vhost_dev_alloc_iovecs(dev);
 	if (err)
-		goto err_cgroup;
+		goto err_iovecs;
 
 	return 0;
-err_cgroup:
-	kthread_stop(worker);
+err_iovecs:
+	vhost_worker_put(worker);
 	dev->worker = NULL;
 err_worker:
 	if (dev->mm)
@@ -638,11 +933,7 @@ void vhost_dev_cleanup(struct vhost_dev *dev)
 	dev->iotlb = NULL;
 	vhost_clear_msg(dev);
 	wake_up_interruptible_poll(&dev->wait, EPOLLIN | EPOLLRDNORM);
-	WARN_ON(!llist_empty(&dev->work_list));
-	if (dev->worker) {
-		kthread_stop(dev->worker);
-		dev->worker = NULL;
-	}
+	vhost_dev_free_workers(dev);
 	if (dev->mm)
 		mmput(dev->mm);
 	dev->mm = NULL;
@@ -704,6 +995,11 @@ static inline void __user *vhost_vq_meta_fetch(struct vhost_virtqueue *vq,
 	if (!node)
 		return NULL;
 
+	/* A packed ring writes both the descriptors and the device event
+	 * area as VHOST_ADDR_USED, which may sit in different nodes. */
+	if (addr < node->start || addr + size - 1 > node->last)
+		return NULL;
+
 	return (void *)(uintptr_t)(node->userspace_addr + addr - node->start);
 }
 
@@ -895,6 +1191,9 @@ static inline void __user *__vhost_get_user(struct vhost_virtqueue *vq,
 #define vhost_get_used(vq, x, ptr) \
 	vhost_get_user(vq, x, ptr, VHOST_ADDR_USED)
 
+#define vhost_get_desc(vq, x, ptr) \
+	vhost_get_user(vq, x, ptr, VHOST_ADDR_DESC)
+
 static int vhost_new_umem_range(struct vhost_umem *umem,
 				u64 start, u64 size, u64 end,
 				u64 userspace_addr, int perm)
@@ -1172,6 +1471,14 @@ static bool vq_access_ok(struct vhost_virtqueue *vq, unsigned int num,
 {
 	size_t s = vhost_has_feature(vq, VIRTIO_RING_F_EVENT_IDX) ? 2 : 0;
 
+	if (vhost_vq_is_packed(vq))
+		return access_ok(VERIFY_WRITE, desc,
+				 num * sizeof(struct vring_packed_desc)) &&
+		       access_ok(VERIFY_READ, avail,
+				 sizeof(struct vring_packed_desc_event)) &&
+		       access_ok(VERIFY_WRITE, used,
+				 sizeof(struct vring_packed_desc_event));
+
 	return access_ok(VERIFY_READ, desc, num * sizeof *desc) &&
 	       access_ok(VERIFY_READ, avail,
 			 sizeof *avail + num * sizeof *avail->ring + s) &&
@@ -1234,6 +1541,26 @@ int vq_iotlb_prefetch(struct vhost_virtqueue *vq)
 	if (!vq->iotlb)
 		return 1;
 
+	/* Used descriptors are written last, so that the cached used
+	 * node is the descriptor ring's. */
+	if (vhost_vq_is_packed(vq))
+		return iotlb_access_ok(vq, VHOST_ACCESS_RO,
+				       (u64)(uintptr_t)vq->desc_packed,
+				       num * sizeof(*vq->desc_packed),
+				       VHOST_ADDR_DESC) &&
+		       iotlb_access_ok(vq, VHOST_ACCESS_RO,
+				       (u64)(uintptr_t)vq->driver_event,
+				       sizeof(*vq->driver_event),
+				       VHOST_ADDR_AVAIL) &&
+		       iotlb_access_ok(vq, VHOST_ACCESS_WO,
+				       (u64)(uintptr_t)vq->device_event,
+				       sizeof(*vq->device_event),
+				       VHOST_ADDR_USED) &&
+		       iotlb_access_ok(vq, VHOST_ACCESS_WO,
+				       (u64)(uintptr_t)vq->desc_packed,
+				       num * sizeof(*vq->desc_packed),
+				       VHOST_ADDR_USED);
+
 	return iotlb_access_ok(vq, VHOST_ACCESS_RO, (u64)(uintptr_t)vq->desc,
 			       num * sizeof(*vq->desc), VHOST_ADDR_DESC) &&
 	       iotlb_access_ok(vq, VHOST_ACCESS_RO, (u64)(uintptr_t)vq->avail,
@@ -1261,12 +1588,14 @@ static bool vq_log_access_ok(struct vhost_virtqueue *vq,
 			     void __user *log_base)
 {
 	size_t s = vhost_has_feature(vq, VIRTIO_RING_F_EVENT_IDX) ? 2 : 0;
+	size_t sz = sizeof *vq->used + vq->num * sizeof *vq->used->ring + s;
+
+	if (vhost_vq_is_packed(vq))
+		sz = vq->num * sizeof(*vq->desc_packed);
 
 	return vq_memory_access_ok(log_base, vq->umem,
 				   vhost_has_feature(vq, VHOST_F_LOG_ALL)) &&
-		(!vq->log_used || log_access_ok(log_base, vq->log_addr,
-					sizeof *vq->used +
-					vq->num * sizeof *vq->used->ring + s));
+		(!vq->log_used || log_access_ok(log_base, vq->log_addr, sz));
 }
 
 /* Can we start vq? */
@@ -1419,6 +1748,13 @@ long vhost_vring_ioctl(struct vhost_dev *d, unsigned int ioctl, void __user *arg
 			r = -EFAULT;
 			break;
 		}
+		if (vhost_vq_is_packed(vq)) {
+			vq->last_avail_idx = s.num & 0x7fff;
+			vq->avail_wrap_counter = !!(s.num & 0x8000);
+			vq->last_used_idx = (s.num >> 16) & 0x7fff;
+			vq->used_wrap_counter = !!(s.num & 0x80000000);
+			break;
+		}
 		if (s.num > 0xffff) {
 			r = -EINVAL;
 			break;
@@ -1429,7 +1765,13 @@ long vhost_vring_ioctl(struct vhost_dev *d, unsigned int ioctl, void __user *arg
 		break;
 	case VHOST_GET_VRING_BASE:
 		s.index = idx;
-		s.num = vq->last_avail_idx;
+		if (vhost_vq_is_packed(vq))
+			s.num = vq->last_avail_idx |
+				vq->avail_wrap_counter << 15 |
+				vq->last_used_idx << 16 |
+				(u32)vq->used_wrap_counter << 31;
+		else
+			s.num = vq->last_avail_idx;
 		if (copy_to_user(argp, &s, sizeof s))
 			r = -EFAULT;
 		break;
@@ -1476,6 +1818,8 @@ long vhost_vring_ioctl(struct vhost_dev *d, unsigned int ioctl, void __user *arg
 			/* Also validate log access for used ring if enabled. */
 			if ((a.flags & (0x1 << VHOST_VRING_F_LOG)) &&
 			    !log_access_ok(vq->log_base, a.log_guest_addr,
+					   vhost_vq_is_packed(vq) ?
+					   vq->num * sizeof(*vq->desc_packed) :
 					   sizeof *vq->used +
 					   vq->num * sizeof *vq->used->ring)) {
 				r = -EINVAL;
@@ -1661,6 +2005,18 @@ long vhost_dev_ioctl(struct vhost_dev *d, unsigned int ioctl, void __user *argp)
 		if (ctx)
 			eventfd_ctx_put(ctx);
 		break;
+	case VHOST_NEW_WORKER:
+		r = vhost_new_worker(d, argp);
+		break;
+	case VHOST_FREE_WORKER:
+		r = vhost_free_worker(d, argp);
+		break;
+	case VHOST_ATTACH_VRING_WORKER:
+		r = vhost_attach_vring_worker(d, argp);
+		break;
+	case VHOST_GET_VRING_WORKER:
+		r = vhost_get_vring_worker(d, argp);
+		break;
 	default:
 		r = -ENOIOCTLCMD;
 		break;
@@ -1785,6 +2141,51 @@ static int vhost_update_avail_event(struct vhost_virtqueue *vq, u16 avail_event)
 	return 0;
 }
 
+/* The device event area is not logged: vhost_vq_init_access() writes it
+ * again when a ring starts. */
+static int vhost_update_device_event(struct vhost_virtqueue *vq)
+{
+	u16 flags = VRING_PACKED_EVENT_FLAG_ENABLE;
+
+	if (vq->used_flags & VRING_USED_F_NO_NOTIFY) {
+		flags = VRING_PACKED_EVENT_FLAG_DISABLE;
+	} else if (vhost_has_feature(vq, VIRTIO_RING_F_EVENT_IDX)) {
+		u16 off_wrap = vq->last_avail_idx |
+			       vq->avail_wrap_counter << VRING_PACKED_EVENT_F_WRAP_CTR;
+
+		if (vhost_put_user(vq, cpu_to_le16(off_wrap),
+				   &vq->device_event->off_wrap))
+			return -EFAULT;
+		/* Make sure the offset is seen before the flags. */
+		smp_wmb();
+		flags = VRING_PACKED_EVENT_FLAG_DESC;
+	}
+	if (vhost_put_user(vq, cpu_to_le16(flags), &vq->device_event->flags))
+		return -EFAULT;
+	return 0;
+}
+
+static int vhost_vq_init_packed(struct vhost_virtqueue *vq)
+{
+	u16 *ndescs;
+
+	/* Positions and wrap counters share 16 bits in the event areas. */
+	if (vq->num > 0x8000 || vq->last_avail_idx >= vq->num ||
+	    vq->last_used_idx >= vq->num)
+		return -EINVAL;
+
+	ndescs = kvmalloc_array(2 * vq->num, sizeof(*ndescs), GFP_KERNEL);
+	if (!ndescs)
+		return -ENOMEM;
+	kvfree(vq->packed_ndescs);
+	vq->packed_ndescs = ndescs;
+	vq->packed_fetched = ndescs + vq->num;
+	vq->packed_fetch_idx = 0;
+	vq->signalled_used_valid = false;
+
+	return vhost_update_device_event(vq);
+}
+
 int vhost_vq_init_access(struct vhost_virtqueue *vq)
 {
 	__virtio16 last_used_idx;
@@ -1796,6 +2197,13 @@ int vhost_vq_init_access(struct vhost_virtqueue *vq)
 
 	vhost_init_is_le(vq);
 
+	if (vhost_vq_is_packed(vq)) {
+		r = vhost_vq_init_packed(vq);
+		if (r)
+			goto err;
+		return 0;
+	}
+
 	r = vhost_update_used_flags(vq);
 	if (r)
 		goto err;
@@ -1980,6 +2388,204 @@ static int get_indirect(struct vhost_virtqueue *vq,
 	return 0;
 }
 
+static bool vhost_packed_desc_avail(__le16 flags, bool wrap)
+{
+	u16 f = le16_to_cpu(flags);
+	bool avail = f & (1 << VRING_PACKED_DESC_F_AVAIL);
+	bool used = f & (1 << VRING_PACKED_DESC_F_USED);
+
+	return avail == wrap && used != wrap;
+}
+
+static int translate_packed_desc(struct vhost_virtqueue *vq,
+				 struct vring_packed_desc *desc,
+				 struct iovec iov[], unsigned int iov_size,
+				 unsigned int *out_num, unsigned int *in_num,
+				 struct vhost_log *log, unsigned int *log_num)
+{
+	unsigned int iov_count = *in_num + *out_num;
+	u64 addr = le64_to_cpu(desc->addr);
+	u32 len = le32_to_cpu(desc->len);
+	int ret, access;
+
+	if (desc->flags & cpu_to_le16(VRING_DESC_F_WRITE))
+		access = VHOST_ACCESS_WO;
+	else
+		access = VHOST_ACCESS_RO;
+	ret = translate_desc(vq, addr, len, iov + iov_count,
+			     iov_size - iov_count, access);
+	if (unlikely(ret < 0)) {
+		if (ret != -EAGAIN)
+			vq_err(vq, "Translation failure %d in packed descriptor\n",
+			       ret);
+		return ret;
+	}
+	if (access == VHOST_ACCESS_WO) {
+		/* If this is an input descriptor,
+		 * increment that count. */
+		*in_num += ret;
+		if (unlikely(log)) {
+			log[*log_num].addr = addr;
+			log[*log_num].len = len;
+			++*log_num;
+		}
+	} else {
+		/* If it's an output descriptor, they're all supposed
+		 * to come before any input descriptors. */
+		if (unlikely(*in_num)) {
+			vq_err(vq, "Packed descriptor has out after in\n");
+			return -EINVAL;
+		}
+		*out_num += ret;
+	}
+	return 0;
+}
+
+static int get_indirect_packed(struct vhost_virtqueue *vq,
+			       struct iovec iov[], unsigned int iov_size,
+			       unsigned int *out_num, unsigned int *in_num,
+			       struct vhost_log *log, unsigned int *log_num,
+			       struct vring_packed_desc *indirect)
+{
+	struct vring_packed_desc desc;
+	u32 len = le32_to_cpu(indirect->len);
+	unsigned int i, count;
+	struct iov_iter from;
+	int ret;
+
+	/* Sanity check */
+	if (unlikely(len % sizeof desc)) {
+		vq_err(vq, "Invalid length in indirect descriptor: "
+		       "len 0x%llx not multiple of 0x%zx\n",
+		       (unsigned long long)len,
+		       sizeof desc);
+		return -EINVAL;
+	}
+
+	ret = translate_desc(vq, le64_to_cpu(indirect->addr), len,
+			     vq->indirect, UIO_MAXIOV, VHOST_ACCESS_RO);
+	if (unlikely(ret < 0)) {
+		if (ret != -EAGAIN)
+			vq_err(vq, "Translation failure %d in indirect.\n", ret);
+		return ret;
+	}
+	iov_iter_init(&from, READ, vq->indirect, ret, len);
+
+	/* We will use the result as an address to read from, so most
+	 * architectures only need a compiler barrier here. */
+	read_barrier_depends();
+
+	/* The table is walked in order, there is no next field. */
+	count = len / sizeof desc;
+	for (i = 0; i < count; i++) {
+		if (unlikely(!copy_from_iter_full(&desc, sizeof(desc), &from))) {
+			vq_err(vq, "Failed indirect descriptor: idx %d, %zx\n",
+			       i, (size_t)le64_to_cpu(indirect->addr) + i * sizeof desc);
+			return -EINVAL;
+		}
+		if (unlikely(desc.flags & cpu_to_le16(VRING_DESC_F_INDIRECT))) {
+			vq_err(vq, "Nested indirect descriptor: idx %d, %zx\n",
+			       i, (size_t)le64_to_cpu(indirect->addr) + i * sizeof desc);
+			return -EINVAL;
+		}
+		ret = translate_packed_desc(vq, &desc, iov, iov_size,
+					    out_num, in_num, log, log_num);
+		if (unlikely(ret < 0))
+			return ret;
+	}
+	return 0;
+}
+
+/* A packed ring buffer is a run of descriptors starting at last_avail_idx,
+ * and its id comes from the last of them. The number of descriptors is
+ * remembered for vhost_add_used_n() to skip the right number of slots. */
+static int vhost_get_vq_desc_packed(struct vhost_virtqueue *vq,
+				    struct iovec iov[], unsigned int iov_size,
+				    unsigned int *out_num, unsigned int *in_num,
+				    struct vhost_log *log, unsigned int *log_num)
+{
+	struct vring_packed_desc desc;
+	u16 i = vq->last_avail_idx, id;
+	bool wrap = vq->avail_wrap_counter;
+	unsigned int found = 0;
+	__le16 flags;
+	int ret;
+
+	if (unlikely(vhost_get_desc(vq, flags, &vq->desc_packed[i].flags))) {
+		vq_err(vq, "Failed to get descriptor flags: idx %d addr %p\n",
+		       i, vq->desc_packed + i);
+		return -EFAULT;
+	}
+	if (!vhost_packed_desc_avail(flags, wrap))
+		return vq->num;
+
+	/* Only get the descriptors after the head has been exposed by
+	 * guest. */
+	smp_rmb();
+
+	/* When we start there are none of either input nor output. */
+	*out_num = *in_num = 0;
+	if (unlikely(log))
+		*log_num = 0;
+
+	do {
+		if (unlikely(++found > vq->num)) {
+			vq_err(vq, "Loop detected: last one at %u "
+			       "vq size %u\n", i, vq->num);
+			return -EINVAL;
+		}
+		ret = vhost_copy_from_user(vq, &desc, vq->desc_packed + i,
+					   sizeof desc);
+		if (unlikely(ret)) {
+			vq_err(vq, "Failed to get descriptor: idx %d addr %p\n",
+			       i, vq->desc_packed + i);
+			return -EFAULT;
+		}
+		if (desc.flags & cpu_to_le16(VRING_DESC_F_INDIRECT)) {
+			if (unlikely(desc.flags & cpu_to_le16(VRING_DESC_F_NEXT))) {
+				vq_err(vq, "Chained indirect descriptor: idx %d\n",
+				       i);
+				return -EINVAL;
+			}
+			ret = get_indirect_packed(vq, iov, iov_size,
+						  out_num, in_num,
+						  log, log_num, &desc);
+		} else {
+			ret = translate_packed_desc(vq, &desc, iov, iov_size,
+						    out_num, in_num,
+						    log, log_num);
+		}
+		if (unlikely(ret < 0)) {
+			if (ret != -EAGAIN)
+				vq_err(vq, "Failure detected "
+				       "in packed descriptor at idx %d\n", i);
+			return ret;
+		}
+		if (++i == vq->num) {
+			i = 0;
+			wrap = !wrap;
+		}
+	} while (desc.flags & cpu_to_le16(VRING_DESC_F_NEXT));
+
+	id = le16_to_cpu(desc.id);
+	if (unlikely(id >= vq->num)) {
+		vq_err(vq, "Guest says buffer id %u > %u is available",
+		       id, vq->num);
+		return -EINVAL;
+	}
+	vq->packed_ndescs[id] = found;
+	vq->packed_fetched[vq->packed_fetch_idx++ & (vq->num - 1)] = found;
+
+	/* On success, move past the buffer. */
+	vq->last_avail_idx = i;
+	vq->avail_wrap_counter = wrap;
+
+	/* Assume notifications from guest are disabled at this point,
+	 * if they aren't we would need to update the device event. */
+	BUG_ON(!(vq->used_flags & VRING_USED_F_NO_NOTIFY));
+	return id;
+}
+
 /* This looks in the virtqueue and for the first available buffer, and converts
  * it to an iovec for convenient access.  Since descriptors consist of some
  * number of output then some number of input descriptors, it's actually two
@@ -2000,6 +2606,10 @@ int vhost_get_vq_desc(struct vhost_virtqueue *vq,
 	__virtio16 ring_head;
 	int ret, access;
 
+	if (vhost_vq_is_packed(vq))
+		return vhost_get_vq_desc_packed(vq, iov, iov_size, out_num,
+						in_num, log, log_num);
+
 	/* Check it isn't doing very strange things with descriptor numbers. */
 	last_avail_idx = vq->last_avail_idx;
 
@@ -2134,7 +2744,21 @@ EXPORT_SYMBOL_GPL(vhost_get_vq_desc);
 /* Reverse the effect of vhost_get_vq_desc. Useful for error handling. */
 void vhost_discard_vq_desc(struct vhost_virtqueue *vq, int n)
 {
-	vq->last_avail_idx -= n;
+	if (!vhost_vq_is_packed(vq)) {
+		vq->last_avail_idx -= n;
+		return;
+	}
+
+	while (n--) {
+		u16 ndescs = vq->packed_fetched[--vq->packed_fetch_idx &
+						(vq->num - 1)];
+
+		if (vq->last_avail_idx < ndescs) {
+			vq->last_avail_idx += vq->num;
+			vq->avail_wrap_counter = !vq->avail_wrap_counter;
+		}
+		vq->last_avail_idx -= ndescs;
+	}
 }
 EXPORT_SYMBOL_GPL(vhost_discard_vq_desc);
 
@@ -2194,6 +2818,114 @@ static int __vhost_add_used_n(struct vhost_virtqueue *vq,
 	return 0;
 }
 
+/* With VIRTIO_F_IN_ORDER the used entry of a buffer also returns all the
+ * buffers made available before it, so a batch takes a single entry when
+ * only its last buffer has a length to report. */
+static bool vhost_used_in_order(struct vhost_virtqueue *vq,
+				struct vring_used_elem *heads, unsigned count)
+{
+	unsigned int i;
+
+	if (count < 2 || !vhost_has_feature(vq, VIRTIO_F_IN_ORDER))
+		return false;
+
+	for (i = 0; i < count - 1; i++)
+		if (heads[i].len)
+			return false;
+	return true;
+}
+
+static int vhost_put_used_packed(struct vhost_virtqueue *vq,
+				 struct vring_used_elem *used, u16 idx)
+{
+	struct vring_packed_desc __user *desc = vq->desc_packed + idx;
+
+	if (vhost_put_user(vq, cpu_to_le16(vhost32_to_cpu(vq, used->id)),
+			   &desc->id)) {
+		vq_err(vq, "Failed to write used id");
+		return -EFAULT;
+	}
+	if (vhost_put_user(vq, cpu_to_le32(vhost32_to_cpu(vq, used->len)),
+			   &desc->len)) {
+		vq_err(vq, "Failed to write used len");
+		return -EFAULT;
+	}
+	return 0;
+}
+
+/* Flags go last: they hand the descriptor over to the driver. */
+static int vhost_put_used_flags_packed(struct vhost_virtqueue *vq, u16 idx,
+				       bool wrap)
+{
+	u16 flags = wrap ? 1 << VRING_PACKED_DESC_F_AVAIL |
+			   1 << VRING_PACKED_DESC_F_USED : 0;
+
+	if (vhost_put_user(vq, cpu_to_le16(flags),
+			   &vq->desc_packed[idx].flags)) {
+		vq_err(vq, "Failed to write used flags");
+		return -EFAULT;
+	}
+	if (unlikely(vq->log_used)) {
+		/* Make sure data is seen before log. */
+		smp_wmb();
+		/* Log used descriptor write. */
+		log_write(vq->log_base,
+			  vq->log_addr + idx * sizeof(*vq->desc_packed),
+			  sizeof(*vq->desc_packed));
+	}
+	return 0;
+}
+
+static int vhost_add_used_n_packed(struct vhost_virtqueue *vq,
+				   struct vring_used_elem *heads,
+				   unsigned count)
+{
+	bool in_order = vhost_used_in_order(vq, heads, count);
+	u16 head = vq->last_used_idx, idx = head;
+	bool wrap = vq->used_wrap_counter;
+	unsigned int i;
+	int r;
+
+	for (i = 0; i < count; i++) {
+		u32 id = vhost32_to_cpu(vq, heads[i].id);
+
+		if (unlikely(id >= vq->num)) {
+			vq_err(vq, "Used buffer id %u > %u", id, vq->num);
+			return -EINVAL;
+		}
+		if (!in_order) {
+			r = vhost_put_used_packed(vq, &heads[i], idx);
+			if (!r && i)
+				r = vhost_put_used_flags_packed(vq, idx, wrap);
+			if (r)
+				return r;
+		}
+		/* A buffer gives back all of its descriptors. */
+		idx += vq->packed_ndescs[id];
+		if (idx >= vq->num) {
+			idx -= vq->num;
+			wrap = !wrap;
+		}
+	}
+	if (in_order) {
+		r = vhost_put_used_packed(vq, &heads[count - 1], head);
+		if (r)
+			return r;
+	}
+
+	/* Make sure the batch is written before the driver sees its head. */
+	smp_wmb();
+	r = vhost_put_used_flags_packed(vq, head, vq->used_wrap_counter);
+	if (r)
+		return r;
+
+	vq->last_used_idx = idx;
+	vq->used_wrap_counter = wrap;
+	if (unlikely(vq->log_used) && vq->log_ctx)
+		eventfd_signal(vq->log_ctx, 1);
+	return 0;
+}
+
 /* After we've used one of their buffers, we tell them about it.  We'll then
  * want to notify the guest, using eventfd. */
 int vhost_add_used_n(struct vhost_virtqueue *vq, struct vring_used_elem *heads,
@@ -2201,16 +2933,35 @@ int vhost_add_used_n(struct vhost_virtqueue *vq, struct vring_used_elem *heads,
 {
 	int start, n, r;
 
-	start = vq->last_used_idx & (vq->num - 1);
-	n = vq->num - start;
-	if (n < count) {
-		r = __vhost_add_used_n(vq, heads, n);
+	if (vhost_vq_is_packed(vq))
+		return vhost_add_used_n_packed(vq, heads, count);
+
+	if (vhost_used_in_order(vq, heads, count)) {
+		u16 skip = count - 1;
+
+		/* The driver reads the entry from the slot of the first
+		 * buffer of the batch, the slots after it are skipped. */
+		r = __vhost_add_used_n(vq, heads + skip, 1);
 		if (r < 0)
 			return r;
-		heads += n;
-		count -= n;
+		/* The signalled index check of __vhost_add_used_n(),
+		 * for the entries we skip. */
+		if (unlikely((u16)(vq->last_used_idx + skip -
+				   vq->signalled_used) < skip))
+			vq->signalled_used_valid = false;
+		vq->last_used_idx += skip;
+	} else {
+		start = vq->last_used_idx & (vq->num - 1);
+		n = vq->num - start;
+		if (n < count) {
+			r = __vhost_add_used_n(vq, heads, n);
+			if (r < 0)
+				return r;
+			heads += n;
+			count -= n;
+		}
+		r = __vhost_add_used_n(vq, heads, count);
 	}
-	r = __vhost_add_used_n(vq, heads, count);
 
 	/* Make sure buffer is written before we update index. */
 	smp_wmb();
@@ -2231,6 +2982,48 @@ int vhost_add_used_n(struct vhost_virtqueue *vq, struct vring_used_elem *heads,
 }
 EXPORT_SYMBOL_GPL(vhost_add_used_n);
 
+static bool vhost_notify_packed(struct vhost_virtqueue *vq)
+{
+	__le16 flags, off_wrap;
+	u16 old, new, off;
+	bool v;
+
+	old = vq->signalled_used;
+	v = vq->signalled_used_valid;
+	new = vq->signalled_used = vq->last_used_idx;
+	vq->signalled_used_valid = true;
+
+	if (vhost_get_avail(vq, flags, &vq->driver_event->flags)) {
+		vq_err(vq, "Failed to get driver event flags");
+		return true;
+	}
+	if (flags == cpu_to_le16(VRING_PACKED_EVENT_FLAG_DISABLE))
+		return false;
+	if (flags != cpu_to_le16(VRING_PACKED_EVENT_FLAG_DESC) ||
+	    !vhost_has_feature(vq, VIRTIO_RING_F_EVENT_IDX))
+		return true;
+
+	if (unlikely(!v))
+		return true;
+
+	/* The driver writes the offset before the flags. */
+	smp_rmb();
+	if (vhost_get_avail(vq, off_wrap, &vq->driver_event->off_wrap)) {
+		vq_err(vq, "Failed to get driver event offset");
+		return true;
+	}
+
+	/* Positions are in [0, num): move those from the previous lap
+	 * below zero so that vring_need_event() sees a plain range. */
+	off = le16_to_cpu(off_wrap) & ~(1 << VRING_PACKED_EVENT_F_WRAP_CTR);
+	if (new <= old)
+		old -= vq->num;
+	if (!!(le16_to_cpu(off_wrap) >> VRING_PACKED_EVENT_F_WRAP_CTR) !=
+	    vq->used_wrap_counter)
+		off -= vq->num;
+	return vring_need_event(off, new, old);
+}
+
 static bool vhost_notify(struct vhost_dev *dev, struct vhost_virtqueue *vq)
 {
 	__u16 old, new;
@@ -2241,6 +3034,9 @@ static bool vhost_notify(struct vhost_dev *dev, struct vhost_virtqueue *vq)
 	 * interrupts. */
 	smp_mb();
 
+	if (vhost_vq_is_packed(vq))
+		return vhost_notify_packed(vq);
+
 	if (vhost_has_feature(vq, VIRTIO_F_NOTIFY_ON_EMPTY) &&
 	    unlikely(vq->avail_idx == vq->last_avail_idx))
 		return true;
@@ -2297,12 +3093,26 @@ void vhost_add_used_and_signal_n(struct vhost_dev *dev,
 }
 EXPORT_SYMBOL_GPL(vhost_add_used_and_signal_n);
 
+static bool vhost_vq_avail_empty_packed(struct vhost_virtqueue *vq)
+{
+	__le16 flags;
+
+	if (unlikely(vhost_get_desc(vq, flags,
+				    &vq->desc_packed[vq->last_avail_idx].flags)))
+		return false;
+
+	return !vhost_packed_desc_avail(flags, vq->avail_wrap_counter);
+}
+
 /* return true if we're sure that avaiable ring is empty */
 bool vhost_vq_avail_empty(struct vhost_dev *dev, struct vhost_virtqueue *vq)
 {
 	__virtio16 avail_idx;
 	int r;
 
+	if (vhost_vq_is_packed(vq))
+		return vhost_vq_avail_empty_packed(vq);
+
 	if (vq->avail_idx != vq->last_avail_idx)
 		return false;
 
@@ -2324,6 +3134,18 @@ bool vhost_enable_notify(struct vhost_dev *dev, struct vhost_virtqueue *vq)
 	if (!(vq->used_flags & VRING_USED_F_NO_NOTIFY))
 		return false;
 	vq->used_flags &= ~VRING_USED_F_NO_NOTIFY;
+	if (vhost_vq_is_packed(vq)) {
+		r = vhost_update_device_event(vq);
+		if (r) {
+			vq_err(vq, "Failed to update device event at %p: %d\n",
+			       vq->device_event, r);
+			return false;
+		}
+		/* They could have slipped one in as we were doing that:
+		 * make sure it's written, then check again. */
+		smp_mb();
+		return !vhost_vq_avail_empty_packed(vq);
+	}
 	if (!vhost_has_feature(vq, VIRTIO_RING_F_EVENT_IDX)) {
 		r = vhost_update_used_flags(vq);
 		if (r) {
@@ -2361,6 +3183,17 @@ void vhost_disable_notify(struct vhost_dev *dev, struct vhost_virtqueue *vq)
 	if (vq->used_flags & VRING_USED_F_NO_NOTIFY)
 		return;
 	vq->used_flags |= VRING_USED_F_NO_NOTIFY;
+	if (vhost_vq_is_packed(vq)) {
+		/* As with the split ring, a stale event offset is good
+		 * enough to hold the driver off. */
+		if (!vhost_has_feature(vq, VIRTIO_RING_F_EVENT_IDX)) {
+			r = vhost_update_device_event(vq);
+			if (r)
+				vq_err(vq, "Failed to disable notification at %p: %d\n",
+				       vq->device_event, r);
+		}
+		return;
+	}
 	if (!vhost_has_feature(vq, VIRTIO_RING_F_EVENT_IDX)) {
 		r = vhost_update_used_flags(vq);
 		if (r)
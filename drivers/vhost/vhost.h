@@ -12,6 +12,7 @@
 #include <linux/virtio_config.h>
 #include <linux/virtio_ring.h>
 #include <linux/atomic.h>
+#include <linux/refcount.h>
 
 struct vhost_work;
 typedef void (*vhost_work_fn_t)(struct vhost_work *work);
@@ -23,6 +24,17 @@ struct vhost_work {
 	unsigned long		  flags;
 };
 
+/* A kthread running vhost works in the mm of the owner of its devices */
+struct vhost_worker {
+	struct task_struct	  *task;
+	struct llist_head	  work_list;
+	struct mm_struct	  *mm;
+	refcount_t		  refcount;
+	u32			  id;
+	/* on the workers list of the device that created it */
+	struct list_head	  node;
+};
+
 /* Poll a file (eventfd or socket) */
 /* Note: there's nothing vhost specific about this structure. */
 struct vhost_poll {
@@ -32,14 +44,19 @@ struct vhost_poll {
 	struct vhost_work	  work;
 	__poll_t		  mask;
 	struct vhost_dev	 *dev;
+	/* runs on the worker of vq, if set, else on that of dev */
+	struct vhost_virtqueue	 *vq;
 };
 
 void vhost_work_init(struct vhost_work *work, vhost_work_fn_t fn);
 void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work);
+void vhost_vq_work_queue(struct vhost_virtqueue *vq, struct vhost_work *work);
 bool vhost_has_work(struct vhost_dev *dev);
+bool vhost_vq_has_work(struct vhost_virtqueue *vq);
 
 void vhost_poll_init(struct vhost_poll *poll, vhost_work_fn_t fn,
-		     __poll_t mask, struct vhost_dev *dev);
+		     __poll_t mask, struct vhost_dev *dev,
+		     struct vhost_virtqueue *vq);
 int vhost_poll_start(struct vhost_poll *poll, struct file *file);
 void vhost_poll_stop(struct vhost_poll *poll);
 void vhost_poll_flush(struct vhost_poll *poll);
@@ -83,13 +100,26 @@ enum vhost_uaddr_type {
 /* The virtqueue structure describes a queue attached to a device. */
 struct vhost_virtqueue {
 	struct vhost_dev *dev;
+	/* set by VHOST_ATTACH_VRING_WORKER, else dev->worker runs the vq */
+	struct vhost_worker __rcu *worker;
 
 	/* The actual ring of buffers. */
 	struct mutex mutex;
 	unsigned int num;
-	struct vring_desc __user *desc;
-	struct vring_avail __user *avail;
-	struct vring_used __user *used;
+	union {
+		struct vring_desc __user *desc;
+		struct vring_packed_desc __user *desc_packed;
+	};
+	/* A packed ring has event suppression areas in place of the avail
+	 * and used rings. */
+	union {
+		struct vring_avail __user *avail;
+		struct vring_packed_desc_event __user *driver_event;
+	};
+	union {
+		struct vring_used __user *used;
+		struct vring_packed_desc_event __user *device_event;
+	};
 	const struct vhost_umem_node *meta_iotlb[VHOST_NUM_ADDRS];
 	struct file *kick;
 	struct eventfd_ctx *call_ctx;
@@ -119,6 +149,18 @@ struct vhost_virtqueue {
 	/* Last used index value we have signalled on */
 	bool signalled_used_valid;
 
+	/* Packed ring: wrap counters of last_avail_idx and last_used_idx,
+	 * which are descriptor positions in the ring. */
+	bool avail_wrap_counter;
+	bool used_wrap_counter;
+
+	/* Packed ring: number of descriptors of each buffer, by buffer id,
+	 * and the same numbers in the order the buffers were fetched, to
+	 * rewind on discard. */
+	u16 *packed_ndescs;
+	u16 *packed_fetched;
+	u16 packed_fetch_idx;
+
 	/* Log writes to used structure. */
 	bool log_used;
 	u64 log_addr;
@@ -162,8 +204,14 @@ struct vhost_dev {
 	struct vhost_virtqueue **vqs;
 	int nvqs;
 	struct eventfd_ctx *log_ctx;
-	struct llist_head work_list;
-	struct task_struct *worker;
+	struct vhost_worker *worker;
+	/* made by VHOST_NEW_WORKER */
+	struct list_head workers;
+	/*
+	 * Set by drivers whose vq handlers only touch a vq under its mutex,
+	 * so that its vqs may be moved with VHOST_ATTACH_VRING_WORKER.
+	 */
+	bool vq_workers;
 	struct vhost_umem *umem;
 	struct vhost_umem *iotlb;
 	spinlock_t iotlb_lock;
@@ -242,6 +290,11 @@ static inline bool vhost_has_feature(struct vhost_virtqueue *vq, int bit)
 	return vq->acked_features & (1ULL << bit);
 }
 
+static inline bool vhost_vq_is_packed(struct vhost_virtqueue *vq)
+{
+	return vhost_has_feature(vq, VIRTIO_F_RING_PACKED);
+}
+
 static inline bool vhost_backend_has_feature(struct vhost_virtqueue *vq, int bit)
 {
 	return vq->acked_backend_features & (1ULL << bit);
@@ -42,6 +42,11 @@
 #include <linux/ramfs.h>
 #include <linux/percpu-refcount.h>
 #include <linux/mount.h>
+#include <linux/kthread.h>
+#include <linux/fdtable.h>
+#include <linux/cred.h>
+#include <linux/sched/mm.h>
+#include <linux/sizes.h>
 
 #include <asm/kmap_types.h>
 #include <linux/uaccess.h>
@@ -72,6 +77,18 @@ struct aio_ring {
 
 #define AIO_RING_PAGES	8
 
+#define AIO_SQ_MAX_ENTRIES	4096
+#define AIO_SQ_BATCH		8
+#define AIO_MAX_FIXED_FILES	1024
+
+/* A user buffer pinned by IOCTX_FLAG_FIXEDBUFS */
+struct aio_mapped_buf {
+	unsigned long		ubuf;
+	size_t			len;
+	struct bio_vec		*bvec;
+	unsigned int		nr_bvecs;
+};
+
 struct kioctx_table {
 	struct rcu_head		rcu;
 	unsigned		nr;
@@ -155,9 +172,49 @@ struct kioctx {
 		spinlock_t	completion_lock;
 	} ____cacheline_aligned_in_smp;
 
+	/*
+	 * IOCTX_FLAG_IOPOLL requests in flight, in submission order.  They
+	 * are only posted to the completion ring and freed when reaped, with
+	 * poll_mutex held, which keeps them alive while they are polled.
+	 */
+	struct {
+		spinlock_t	poll_lock;
+		struct list_head poll_list;
+		struct mutex	poll_mutex;
+	} ____cacheline_aligned_in_smp;
+
+	/*
+	 * Submission ring (IOCTX_FLAG_SQRING).  Its pages follow the
+	 * completion ring pages in ring_pages[] and in the mmap'ed area.
+	 * sq_lock serializes consumers of the ring and keeps page migration
+	 * away from the SQ pages while they are being read.
+	 */
+	struct {
+		struct mutex	sq_lock;
+		unsigned	sq_head;	/* trusted copy */
+		unsigned	sq_entries;
+		unsigned	sq_page;	/* first SQ page in ring_pages[] */
+		bool		sq_compat;
+
+		struct task_struct	*sq_thread;
+		unsigned long		sq_thread_idle;	/* in jiffies */
+		wait_queue_head_t	sq_wait;
+		struct mm_struct	*sq_mm;
+		struct files_struct	*sq_files;
+		const struct cred	*sq_creds;
+	} ____cacheline_aligned_in_smp;
+
 	struct page		*internal_pages[AIO_RING_PAGES];
 	struct file		*aio_ring_file;
 
+	/* Buffers and files registered at io_setup2() time */
+	struct aio_mapped_buf	*user_bufs;
+	unsigned		nr_user_bufs;
+	struct file		**user_files;
+	unsigned		nr_user_files;
+	struct user_struct	*user;	/* charged for the pinned pages */
+
+	unsigned		flags;	/* IOCTX_FLAG_* */
 	unsigned		id;
 };
 
@@ -194,6 +251,15 @@ struct aio_kiocb {
 						 * for cancellation */
 	refcount_t		ki_refcnt;
 
+	/* the file is owned by ki_ctx->user_files, don't fput() it */
+	bool			ki_fixed_file;
+
+	/* IOCTX_FLAG_IOPOLL: ki_ctx->poll_list entry and deferred result */
+	bool			ki_poll_done;
+	struct list_head	ki_poll_list;
+	long			ki_res;
+	long			ki_res2;
+
 	/*
 	 * If the aio_resfd field of the userspace iocb is not zero,
 	 * this is the underlying eventfd context to deliver events to.
@@ -215,6 +281,12 @@ static struct vfsmount *aio_mnt;
 static const struct file_operations aio_ring_fops;
 static const struct address_space_operations aio_ctx_aops;
 
+static void aio_sq_thread_stop(struct kioctx *ctx);
+static void aio_iopoll_reap_all(struct kioctx *ctx);
+static inline void aio_file_put(struct aio_kiocb *req, struct file *file);
+static void aio_unregister_bufs(struct kioctx *ctx);
+static void aio_unregister_files(struct kioctx *ctx);
+
 static struct file *aio_private_file(struct kioctx *ctx, loff_t nr_pages)
 {
 	struct file *file;
@@ -364,6 +436,7 @@ static int aio_migratepage(struct address_space *mapping, struct page *new,
 {
 	struct kioctx *ctx;
 	unsigned long flags;
+	bool sq_locked = false;
 	pgoff_t idx;
 	int rc;
 
@@ -405,6 +478,13 @@ static int aio_migratepage(struct address_space *mapping, struct page *new,
 	if (rc != 0)
 		goto out_unlock;
 
+	/* SQ pages are read by submitters under ctx->sq_lock instead. */
+	sq_locked = ctx->sq_entries && idx >= ctx->sq_page;
+	if (sq_locked && !mutex_trylock(&ctx->sq_lock)) {
+		rc = -EAGAIN;
+		goto out_unlock;
+	}
+
 	/* Writeback must be complete */
 	BUG_ON(PageWriteback(old));
 	get_page(new);
@@ -429,6 +509,8 @@ static int aio_migratepage(struct address_space *mapping, struct page *new,
 	put_page(old);
 
 out_unlock:
+	if (sq_locked)
+		mutex_unlock(&ctx->sq_lock);
 	mutex_unlock(&ctx->ring_lock);
 out:
 	spin_unlock(&mapping->private_lock);
@@ -443,12 +525,13 @@ static const struct address_space_operations aio_ctx_aops = {
 #endif
 };
 
-static int aio_setup_ring(struct kioctx *ctx, unsigned int nr_events)
+static int aio_setup_ring(struct kioctx *ctx, unsigned int nr_events,
+			  unsigned int sq_entries)
 {
 	struct aio_ring *ring;
 	struct mm_struct *mm = current->mm;
 	unsigned long size, unused;
-	int nr_pages;
+	int nr_pages, cq_pages;
 	int i;
 	struct file *file;
 
@@ -458,10 +541,16 @@ static int aio_setup_ring(struct kioctx *ctx, unsigned int nr_events)
 	size = sizeof(struct aio_ring);
 	size += sizeof(struct io_event) * nr_events;
 
-	nr_pages = PFN_UP(size);
+	nr_pages = cq_pages = PFN_UP(size);
 	if (nr_pages < 0)
 		return -EINVAL;
 
+	if (sq_entries) {
+		size = sizeof(struct aio_sq_ring);
+		size += sizeof(struct iocb) * sq_entries;
+		nr_pages += PFN_UP(size);
+	}
+
 	file = aio_private_file(ctx, nr_pages);
 	if (IS_ERR(file)) {
 		ctx->aio_ring_file = NULL;
@@ -469,7 +558,7 @@ static int aio_setup_ring(struct kioctx *ctx, unsigned int nr_events)
 	}
 
 	ctx->aio_ring_file = file;
-	nr_events = (PAGE_SIZE * nr_pages - sizeof(struct aio_ring))
+	nr_events = (PAGE_SIZE * cq_pages - sizeof(struct aio_ring))
 			/ sizeof(struct io_event);
 
 	ctx->ring_pages = ctx->internal_pages;
@@ -537,6 +626,19 @@ static int aio_setup_ring(struct kioctx *ctx, unsigned int nr_events)
 	kunmap_atomic(ring);
 	flush_dcache_page(ctx->ring_pages[0]);
 
+	if (sq_entries) {
+		struct aio_sq_ring *sq_ring;
+
+		ctx->sq_page = cq_pages;
+		ctx->sq_entries = sq_entries;
+
+		sq_ring = kmap_atomic(ctx->ring_pages[ctx->sq_page]);
+		sq_ring->nr_entries = sq_entries;
+		sq_ring->ring_mask = sq_entries - 1;
+		kunmap_atomic(sq_ring);
+		flush_dcache_page(ctx->ring_pages[ctx->sq_page]);
+	}
+
 	return 0;
 }
 
@@ -571,6 +673,8 @@ static void free_ioctx(struct work_struct *work)
 					  free_rwork);
 	pr_debug("freeing %p\n", ctx);
 
+	aio_unregister_files(ctx);
+	aio_unregister_bufs(ctx);
 	aio_free_ring(ctx);
 	free_percpu(ctx->cpu);
 	percpu_ref_exit(&ctx->reqs);
@@ -683,8 +787,10 @@ static void aio_nr_sub(unsigned nr)
 
 /* ioctx_alloc
  *	Allocates and initializes an ioctx.  Returns an ERR_PTR if it failed.
+ *	A non-zero sq_entries also sets up a submission ring of that size.
  */
-static struct kioctx *ioctx_alloc(unsigned nr_events)
+static struct kioctx *ioctx_alloc(unsigned nr_events, unsigned flags,
+				  unsigned sq_entries)
 {
 	struct mm_struct *mm = current->mm;
 	struct kioctx *ctx;
@@ -722,10 +828,16 @@ static struct kioctx *ioctx_alloc(unsigned nr_events)
 		return ERR_PTR(-ENOMEM);
 
 	ctx->max_reqs = max_reqs;
+	ctx->flags = flags;
 
 	spin_lock_init(&ctx->ctx_lock);
 	spin_lock_init(&ctx->completion_lock);
 	mutex_init(&ctx->ring_lock);
+	mutex_init(&ctx->sq_lock);
+	init_waitqueue_head(&ctx->sq_wait);
+	spin_lock_init(&ctx->poll_lock);
+	INIT_LIST_HEAD(&ctx->poll_list);
+	mutex_init(&ctx->poll_mutex);
 	/* Protect against page migration throughout kiotx setup by keeping
 	 * the ring_lock mutex held until setup is complete. */
 	mutex_lock(&ctx->ring_lock);
@@ -743,7 +855,7 @@ static struct kioctx *ioctx_alloc(unsigned nr_events)
 	if (!ctx->cpu)
 		goto err;
 
-	err = aio_setup_ring(ctx, nr_events);
+	err = aio_setup_ring(ctx, nr_events, sq_entries);
 	if (err < 0)
 		goto err;
 
@@ -818,6 +930,13 @@ static int kill_ioctx(struct mm_struct *mm, struct kioctx *ctx,
 	/* free_ioctx_reqs() will do the necessary RCU synchronization */
 	wake_up_all(&ctx->wait);
 
+	if (ctx->sq_thread)
+		aio_sq_thread_stop(ctx);
+
+	/* Polled requests only go away once somebody reaps them */
+	if (ctx->flags & IOCTX_FLAG_IOPOLL)
+		aio_iopoll_reap_all(ctx);
+
 	/*
 	 * It'd be more correct to do this in free_ioctx(), after all
 	 * the outstanding kiocbs have finished - but by then io_destroy
@@ -1059,26 +1178,16 @@ static inline void iocb_put(struct aio_kiocb *iocb)
 	}
 }
 
-/* aio_complete
- *	Called when the io request on the given iocb is complete.
+/* aio_fill_event
+ *	Write the completion event of iocb at position tail of the ring and
+ *	return the next tail.  Must be called holding ctx->completion_lock,
+ *	the event only becomes visible with aio_commit_events().
  */
-static void aio_complete(struct aio_kiocb *iocb, long res, long res2)
+static unsigned aio_fill_event(struct kioctx *ctx, unsigned tail,
+			       struct aio_kiocb *iocb, long res, long res2)
 {
-	struct kioctx	*ctx = iocb->ki_ctx;
-	struct aio_ring	*ring;
 	struct io_event	*ev_page, *event;
-	unsigned tail, pos, head;
-	unsigned long	flags;
-
-	/*
-	 * Add a completion event to the ring buffer. Must be done holding
-	 * ctx->completion_lock to prevent other code from messing with the tail
-	 * pointer since we might be called from irq context.
-	 */
-	spin_lock_irqsave(&ctx->completion_lock, flags);
-
-	tail = ctx->tail;
-	pos = tail + AIO_EVENTS_OFFSET;
+	unsigned pos = tail + AIO_EVENTS_OFFSET;
 
 	if (++tail >= ctx->nr_events)
 		tail = 0;
@@ -1097,6 +1206,17 @@ static void aio_complete(struct aio_kiocb *iocb, long res, long res2)
 	pr_debug("%p[%u]: %p: %p %Lx %lx %lx\n",
 		 ctx, tail, iocb, iocb->ki_user_iocb, iocb->ki_user_data,
 		 res, res2);
+	return tail;
+}
+
+/* aio_commit_events
+ *	Publish the nr events filled in up to tail.  Must be called holding
+ *	ctx->completion_lock.
+ */
+static void aio_commit_events(struct kioctx *ctx, unsigned tail, unsigned nr)
+{
+	struct aio_ring	*ring;
+	unsigned head;
 
 	/* after flagging the request as done, we
 	 * must never even look at it again
@@ -1111,13 +1231,13 @@ static void aio_complete(struct aio_kiocb *iocb, long res, long res2)
 	kunmap_atomic(ring);
 	flush_dcache_page(ctx->ring_pages[0]);
 
-	ctx->completed_events++;
+	ctx->completed_events += nr;
 	if (ctx->completed_events > 1)
 		refill_reqs_available(ctx, head, tail);
-	spin_unlock_irqrestore(&ctx->completion_lock, flags);
-
-	pr_debug("added to ring %p at [%u]\n", iocb, tail);
+}
 
+static inline void aio_signal_eventfd(struct aio_kiocb *iocb)
+{
 	/*
 	 * Check if the user asked us to deliver the result through an
 	 * eventfd. The eventfd_signal() function is safe to be called
@@ -1127,7 +1247,10 @@ static void aio_complete(struct aio_kiocb *iocb, long res, long res2)
 		eventfd_signal(iocb->ki_eventfd, 1);
 		eventfd_ctx_put(iocb->ki_eventfd);
 	}
+}
 
+static inline void aio_wake_waiters(struct kioctx *ctx)
+{
 	/*
 	 * We have to order our ring_info tail store above and test
 	 * of the wait list below outside the wait lock.  This is
@@ -1138,9 +1261,62 @@ static void aio_complete(struct aio_kiocb *iocb, long res, long res2)
 
 	if (waitqueue_active(&ctx->wait))
 		wake_up(&ctx->wait);
+}
+
+/* aio_complete
+ *	Called when the io request on the given iocb is complete.
+ */
+static void aio_complete(struct aio_kiocb *iocb, long res, long res2)
+{
+	struct kioctx	*ctx = iocb->ki_ctx;
+	unsigned tail;
+	unsigned long	flags;
+
+	/*
+	 * Add a completion event to the ring buffer. Must be done holding
+	 * ctx->completion_lock to prevent other code from messing with the tail
+	 * pointer since we might be called from irq context.
+	 */
+	spin_lock_irqsave(&ctx->completion_lock, flags);
+	tail = aio_fill_event(ctx, ctx->tail, iocb, res, res2);
+	aio_commit_events(ctx, tail, 1);
+	spin_unlock_irqrestore(&ctx->completion_lock, flags);
+
+	pr_debug("added to ring %p at [%u]\n", iocb, tail);
+
+	aio_signal_eventfd(iocb);
+	aio_wake_waiters(ctx);
 	iocb_put(iocb);
 }
 
+/* aio_complete_batch
+ *	Post the events of a list of reaped IOCTX_FLAG_IOPOLL requests with a
+ *	single update of the completion ring, then free the requests.
+ */
+static void aio_complete_batch(struct kioctx *ctx, struct list_head *done)
+{
+	struct aio_kiocb *iocb, *n;
+	unsigned tail, nr = 0;
+
+	spin_lock_irq(&ctx->completion_lock);
+	tail = ctx->tail;
+	list_for_each_entry(iocb, done, ki_poll_list) {
+		tail = aio_fill_event(ctx, tail, iocb, iocb->ki_res,
+				      iocb->ki_res2);
+		nr++;
+	}
+	aio_commit_events(ctx, tail, nr);
+	spin_unlock_irq(&ctx->completion_lock);
+
+	list_for_each_entry_safe(iocb, n, done, ki_poll_list) {
+		aio_file_put(iocb, iocb->rw.ki_filp);
+		aio_signal_eventfd(iocb);
+		iocb_put(iocb);
+	}
+
+	aio_wake_waiters(ctx);
+}
+
 /* aio_read_events_ring
  *	Pull an event off of the ioctx's event ring.  Returns the number of
  *	events fetched
@@ -1242,12 +1418,170 @@ static bool aio_read_events(struct kioctx *ctx, long min_nr, long nr,
 	return ret < 0 || *i >= min_nr;
 }
 
+static bool aio_iopoll_inflight(struct kioctx *ctx)
+{
+	bool inflight;
+
+	spin_lock(&ctx->poll_lock);
+	inflight = !list_empty(&ctx->poll_list);
+	spin_unlock(&ctx->poll_lock);
+
+	return inflight;
+}
+
+/* aio_iopoll_reap
+ *	Move all completed requests off ctx->poll_list and post their events.
+ *	Must be called holding ctx->poll_mutex.
+ */
+static long aio_iopoll_reap(struct kioctx *ctx)
+{
+	struct aio_kiocb *iocb, *n;
+	LIST_HEAD(done);
+	long nr = 0;
+
+	spin_lock(&ctx->poll_lock);
+	list_for_each_entry_safe(iocb, n, &ctx->poll_list, ki_poll_list) {
+		if (!smp_load_acquire(&iocb->ki_poll_done))
+			continue;
+		list_move_tail(&iocb->ki_poll_list, &done);
+		nr++;
+	}
+	spin_unlock(&ctx->poll_lock);
+
+	if (nr)
+		aio_complete_batch(ctx, &done);
+	return nr;
+}
+
+/* aio_iopoll
+ *	Reap completed IOCTX_FLAG_IOPOLL requests.  If none had completed
+ *	and spin is set, first poll the device for the oldest request still
+ *	in flight: drivers harvest every completion ready on the hardware
+ *	queue in one go, so this reaps the requests sharing it as well.
+ *	Must be called holding ctx->poll_mutex.  Returns the number of events
+ *	posted, or a negative error if the device could not be polled.
+ */
+static long aio_iopoll(struct kioctx *ctx, bool spin)
+{
+	struct aio_kiocb *iocb = NULL, *pos;
+	long nr;
+
+	nr = aio_iopoll_reap(ctx);
+	if (nr || !spin)
+		return nr;
+
+	spin_lock(&ctx->poll_lock);
+	list_for_each_entry(pos, &ctx->poll_list, ki_poll_list) {
+		if (!smp_load_acquire(&pos->ki_poll_done)) {
+			iocb = pos;
+			break;
+		}
+	}
+	spin_unlock(&ctx->poll_lock);
+
+	if (iocb) {
+		int ret = iocb->rw.ki_filp->f_op->iopoll(&iocb->rw);
+
+		if (ret < 0)
+			return ret;
+	}
+
+	return aio_iopoll_reap(ctx);
+}
+
+/* aio_iopoll_reap_all
+ *	Reap every polled request of a dying context.  The device is busy
+ *	polled for at most AIO_IOPOLL_SPIN_JIFFIES, then only once per tick:
+ *	a request that never completes, or a device that fails to poll,
+ *	must not keep the CPU spinning until the block layer times it out.
+ */
+#define AIO_IOPOLL_SPIN_JIFFIES	(HZ / 10)
+
+static void aio_iopoll_reap_all(struct kioctx *ctx)
+{
+	unsigned long spin_until = jiffies + AIO_IOPOLL_SPIN_JIFFIES;
+
+	while (aio_iopoll_inflight(ctx)) {
+		mutex_lock(&ctx->poll_mutex);
+		aio_iopoll(ctx, true);
+		mutex_unlock(&ctx->poll_mutex);
+
+		if (time_before(jiffies, spin_until))
+			cond_resched();
+		else
+			schedule_timeout_uninterruptible(1);
+	}
+}
+
+static void aio_iopoll_add(struct kioctx *ctx, struct aio_kiocb *iocb)
+{
+	spin_lock(&ctx->poll_lock);
+	list_add_tail(&iocb->ki_poll_list, &ctx->poll_list);
+	spin_unlock(&ctx->poll_lock);
+
+	/*
+	 * Either kill_ioctx() sees the request on the list, or we see the
+	 * context dead and have to reap it ourselves.
+	 */
+	smp_mb();
+	if (unlikely(atomic_read(&ctx->dead)))
+		aio_iopoll_reap_all(ctx);
+}
+
+/*
+ * Polled requests complete without interrupts, so instead of sleeping we
+ * keep polling until enough events were reaped, the timeout expires or
+ * nothing is in flight anymore.
+ */
+static long aio_iopoll_read_events(struct kioctx *ctx, long min_nr, long nr,
+				   struct io_event __user *event,
+				   ktime_t until)
+{
+	ktime_t deadline = KTIME_MAX;
+	long ret = 0;
+
+	if (until != KTIME_MAX)
+		deadline = ktime_add(ktime_get(), until);
+
+	for (;;) {
+		long reaped;
+
+		mutex_lock(&ctx->poll_mutex);
+		reaped = aio_iopoll(ctx, until != 0);
+		mutex_unlock(&ctx->poll_mutex);
+
+		if (unlikely(reaped < 0)) {
+			if (!ret)
+				ret = reaped;
+			break;
+		}
+
+		if (aio_read_events(ctx, min_nr, nr, event, &ret))
+			break;
+		if (!until || !aio_iopoll_inflight(ctx))
+			break;
+		if (signal_pending(current)) {
+			if (!ret)
+				ret = -EINTR;
+			break;
+		}
+		if (ktime_after(ktime_get(), deadline))
+			break;
+		cond_resched();
+	}
+
+	return ret;
+}
+
 static long read_events(struct kioctx *ctx, long min_nr, long nr,
 			struct io_event __user *event,
 			ktime_t until)
 {
 	long ret = 0;
 
+	if (ctx->flags & IOCTX_FLAG_IOPOLL)
+		return aio_iopoll_read_events(ctx, min_nr, nr, event, until);
+
 	/*
 	 * Note that aio_read_events() is being called as the conditional - i.e.
 	 * we're calling it after prepare_to_wait() has set task state to
@@ -1301,7 +1635,7 @@ SYSCALL_DEFINE2(io_setup, unsigned, nr_events, aio_context_t __user *, ctxp)
 		goto out;
 	}
 
-	ioctx = ioctx_alloc(nr_events);
+	ioctx = ioctx_alloc(nr_events, 0, 0);
 	ret = PTR_ERR(ioctx);
 	if (!IS_ERR(ioctx)) {
 		ret = put_user(ioctx->user_id, ctxp);
@@ -1332,7 +1666,7 @@ COMPAT_SYSCALL_DEFINE2(io_setup, unsigned, nr_events, u32 __user *, ctx32p)
 		goto out;
 	}
 
-	ioctx = ioctx_alloc(nr_events);
+	ioctx = ioctx_alloc(nr_events, 0, 0);
 	ret = PTR_ERR(ioctx);
 	if (!IS_ERR(ioctx)) {
 		/* truncating is ok because it's a user address */
@@ -1393,7 +1727,33 @@ static void aio_remove_iocb(struct aio_kiocb *iocb)
 	spin_unlock_irqrestore(&ctx->ctx_lock, flags);
 }
 
-static void aio_complete_rw(struct kiocb *kiocb, long res, long res2)
+/* aio_file_get
+ *	Look up the file an iocb refers to: a file descriptor, or with
+ *	IOCB_FLAG_FIXED_FILE an index into the files registered with the
+ *	context, which are referenced for the lifetime of the context and
+ *	need no per-request reference.
+ */
+static struct file *aio_file_get(struct aio_kiocb *req, struct iocb *iocb)
+{
+	struct kioctx *ctx = req->ki_ctx;
+	unsigned idx = iocb->aio_fildes;
+
+	if (!(iocb->aio_flags & IOCB_FLAG_FIXED_FILE))
+		return fget(iocb->aio_fildes);
+
+	if (unlikely(idx >= ctx->nr_user_files))
+		return NULL;
+	req->ki_fixed_file = true;
+	return ctx->user_files[array_index_nospec(idx, ctx->nr_user_files)];
+}
+
+static inline void aio_file_put(struct aio_kiocb *req, struct file *file)
+{
+	if (!req->ki_fixed_file)
+		fput(file);
+}
+
+static void aio_rw_end(struct kiocb *kiocb)
 {
 	struct aio_kiocb *iocb = container_of(kiocb, struct aio_kiocb, rw);
 
@@ -1411,16 +1771,41 @@ static void aio_complete_rw(struct kiocb *kiocb, long res, long res2)
 			__sb_writers_acquired(inode->i_sb, SB_FREEZE_WRITE);
 		file_end_write(kiocb->ki_filp);
 	}
+}
 
-	fput(kiocb->ki_filp);
+static void aio_complete_rw(struct kiocb *kiocb, long res, long res2)
+{
+	struct aio_kiocb *iocb = container_of(kiocb, struct aio_kiocb, rw);
+
+	aio_rw_end(kiocb);
+	aio_file_put(iocb, kiocb->ki_filp);
 	aio_complete(iocb, res, res2);
 }
 
+/*
+ * IOCTX_FLAG_IOPOLL requests only record their result here, possibly from
+ * interrupt context.  The event is posted and the file reference dropped
+ * when aio_iopoll_reap() finds them, as the poller may still be using the
+ * file.
+ */
+static void aio_complete_rw_poll(struct kiocb *kiocb, long res, long res2)
+{
+	struct aio_kiocb *iocb = container_of(kiocb, struct aio_kiocb, rw);
+
+	aio_rw_end(kiocb);
+	iocb->ki_res = res;
+	iocb->ki_res2 = res2;
+	/* pairs with smp_load_acquire() in aio_iopoll_reap() */
+	smp_store_release(&iocb->ki_poll_done, true);
+}
+
 static int aio_prep_rw(struct kiocb *req, struct iocb *iocb)
 {
+	struct aio_kiocb *aiocb = container_of(req, struct aio_kiocb, rw);
+	struct kioctx *ctx = aiocb->ki_ctx;
 	int ret;
 
-	req->ki_filp = fget(iocb->aio_fildes);
+	req->ki_filp = aio_file_get(aiocb, iocb);
 	if (unlikely(!req->ki_filp))
 		return -EBADF;
 	req->ki_complete = aio_complete_rw;
@@ -1438,7 +1823,7 @@ static int aio_prep_rw(struct kiocb *req, struct iocb *iocb)
 		ret = ioprio_check_cap(iocb->aio_reqprio);
 		if (ret) {
 			pr_debug("aio ioprio check cap error: %d\n", ret);
-			fput(req->ki_filp);
+			aio_file_put(aiocb, req->ki_filp);
 			return ret;
 		}
 
@@ -1448,16 +1833,70 @@ static int aio_prep_rw(struct kiocb *req, struct iocb *iocb)
 
 	ret = kiocb_set_rw_flags(req, iocb->aio_rw_flags);
 	if (unlikely(ret))
-		fput(req->ki_filp);
+		goto out_fput;
+
+	if (ctx->flags & IOCTX_FLAG_IOPOLL) {
+		ret = -EOPNOTSUPP;
+		if (!(req->ki_flags & IOCB_DIRECT) ||
+		    !req->ki_filp->f_op->iopoll)
+			goto out_fput;
+
+		req->ki_flags |= IOCB_HIPRI;
+		req->ki_complete = aio_complete_rw_poll;
+	} else {
+		/* no one is going to poll for this I/O */
+		req->ki_flags &= ~IOCB_HIPRI;
+	}
+	return 0;
+
+out_fput:
+	aio_file_put(aiocb, req->ki_filp);
 	return ret;
 }
 
-static int aio_setup_rw(int rw, struct iocb *iocb, struct iovec **iovec,
-		bool vectored, bool compat, struct iov_iter *iter)
+/* aio_import_fixed
+ *	Set up iter for an IOCB_FLAG_FIXED_BUF iocb from the pages pinned at
+ *	registration time, so O_DIRECT needs no get_user_pages() per request.
+ */
+static int aio_import_fixed(int rw, struct kioctx *ctx, struct iocb *iocb,
+			    struct iov_iter *iter)
+{
+	unsigned long buf_addr = iocb->aio_buf;
+	size_t len = iocb->aio_nbytes;
+	struct aio_mapped_buf *buf;
+	u64 idx = iocb->aio_reserved2;
+
+	if (unlikely(idx >= ctx->nr_user_bufs))
+		return -EFAULT;
+	buf = &ctx->user_bufs[array_index_nospec(idx, ctx->nr_user_bufs)];
+
+	/* the range must be entirely inside the registered buffer */
+	if (unlikely(buf_addr < buf->ubuf || buf_addr + len < buf_addr ||
+		     buf_addr + len > buf->ubuf + buf->len))
+		return -EFAULT;
+
+	iov_iter_bvec(iter, rw, buf->bvec, buf->nr_bvecs,
+		      buf_addr - buf->ubuf + len);
+	iov_iter_advance(iter, buf_addr - buf->ubuf);
+	return 0;
+}
+
+static int aio_setup_rw(int rw, struct kiocb *req, struct iocb *iocb,
+		struct iovec **iovec, bool vectored, bool compat,
+		struct iov_iter *iter)
 {
 	void __user *buf = (void __user *)(uintptr_t)iocb->aio_buf;
 	size_t len = iocb->aio_nbytes;
 
+	if (iocb->aio_flags & IOCB_FLAG_FIXED_BUF) {
+		struct aio_kiocb *aiocb = container_of(req, struct aio_kiocb, rw);
+
+		*iovec = NULL;
+		if (vectored)
+			return -EINVAL;
+		return aio_import_fixed(rw, aiocb->ki_ctx, iocb, iter);
+	}
+
 	if (!vectored) {
 		ssize_t ret = import_single_range(rw, buf, len, *iovec, iter);
 		*iovec = NULL;
@@ -1487,7 +1926,7 @@ static inline void aio_rw_done(struct kiocb *req, ssize_t ret)
 		ret = -EINTR;
 		/*FALLTHRU*/
 	default:
-		aio_complete_rw(req, ret, 0);
+		req->ki_complete(req, ret, 0);
 	}
 }
 
@@ -1511,7 +1950,7 @@ static ssize_t aio_read(struct kiocb *req, struct iocb *iocb, bool vectored,
 	if (unlikely(!file->f_op->read_iter))
 		goto out_fput;
 
-	ret = aio_setup_rw(READ, iocb, &iovec, vectored, compat, &iter);
+	ret = aio_setup_rw(READ, req, iocb, &iovec, vectored, compat, &iter);
 	if (ret)
 		goto out_fput;
 	ret = rw_verify_area(READ, file, &req->ki_pos, iov_iter_count(&iter));
@@ -1520,7 +1959,7 @@ static ssize_t aio_read(struct kiocb *req, struct iocb *iocb, bool vectored,
 	kfree(iovec);
 out_fput:
 	if (unlikely(ret))
-		fput(file);
+		aio_file_put(container_of(req, struct aio_kiocb, rw), file);
 	return ret;
 }
 
@@ -1544,7 +1983,7 @@ static ssize_t aio_write(struct kiocb *req, struct iocb *iocb, bool vectored,
 	if (unlikely(!file->f_op->write_iter))
 		goto out_fput;
 
-	ret = aio_setup_rw(WRITE, iocb, &iovec, vectored, compat, &iter);
+	ret = aio_setup_rw(WRITE, req, iocb, &iovec, vectored, compat, &iter);
 	if (ret)
 		goto out_fput;
 	ret = rw_verify_area(WRITE, file, &req->ki_pos, iov_iter_count(&iter));
@@ -1566,31 +2005,34 @@ static ssize_t aio_write(struct kiocb *req, struct iocb *iocb, bool vectored,
 	kfree(iovec);
 out_fput:
 	if (unlikely(ret))
-		fput(file);
+		aio_file_put(container_of(req, struct aio_kiocb, rw), file);
 	return ret;
 }
 
 static void aio_fsync_work(struct work_struct *work)
 {
 	struct fsync_iocb *req = container_of(work, struct fsync_iocb, work);
+	struct aio_kiocb *iocb = container_of(req, struct aio_kiocb, fsync);
 	int ret;
 
 	ret = vfs_fsync(req->file, req->datasync);
-	fput(req->file);
-	aio_complete(container_of(req, struct aio_kiocb, fsync), ret, 0);
+	aio_file_put(iocb, req->file);
+	aio_complete(iocb, ret, 0);
 }
 
 static int aio_fsync(struct fsync_iocb *req, struct iocb *iocb, bool datasync)
 {
+	struct aio_kiocb *aiocb = container_of(req, struct aio_kiocb, fsync);
+
 	if (unlikely(iocb->aio_buf || iocb->aio_offset || iocb->aio_nbytes ||
 			iocb->aio_rw_flags))
 		return -EINVAL;
 
-	req->file = fget(iocb->aio_fildes);
+	req->file = aio_file_get(aiocb, iocb);
 	if (unlikely(!req->file))
 		return -EBADF;
 	if (unlikely(!req->file->f_op->fsync)) {
-		fput(req->file);
+		aio_file_put(aiocb, req->file);
 		return -EINVAL;
 	}
 
@@ -1603,9 +2045,11 @@ static int aio_fsync(struct fsync_iocb *req, struct iocb *iocb, bool datasync)
 static inline void aio_poll_complete(struct aio_kiocb *iocb, __poll_t mask)
 {
 	struct file *file = iocb->poll.file;
+	bool fixed_file = iocb->ki_fixed_file;
 
 	aio_complete(iocb, mangle_poll(mask), 0);
-	fput(file);
+	if (!fixed_file)
+		fput(file);
 }
 
 static void aio_poll_complete_work(struct work_struct *work)
@@ -1724,7 +2168,7 @@ static ssize_t aio_poll(struct aio_kiocb *aiocb, struct iocb *iocb)
 
 	INIT_WORK(&req->work, aio_poll_complete_work);
 	req->events = demangle_poll(iocb->aio_buf) | EPOLLERR | EPOLLHUP;
-	req->file = fget(iocb->aio_fildes);
+	req->file = aio_file_get(aiocb, iocb);
 	if (unlikely(!req->file))
 		return -EBADF;
 
@@ -1766,7 +2210,7 @@ static ssize_t aio_poll(struct aio_kiocb *aiocb, struct iocb *iocb)
 
 out:
 	if (unlikely(apt.error)) {
-		fput(req->file);
+		aio_file_put(aiocb, req->file);
 		return apt.error;
 	}
 
@@ -1776,44 +2220,53 @@ static ssize_t aio_poll(struct aio_kiocb *aiocb, struct iocb *iocb)
 	return 0;
 }
 
-static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
-			 bool compat)
+static int __io_submit_one(struct kioctx *ctx, struct iocb *iocb,
+			   struct iocb __user *user_iocb, bool compat)
 {
 	struct aio_kiocb *req;
-	struct iocb iocb;
 	ssize_t ret;
 
-	if (unlikely(copy_from_user(&iocb, user_iocb, sizeof(iocb))))
-		return -EFAULT;
-
 	/* enforce forwards compatibility on users */
-	if (unlikely(iocb.aio_reserved2)) {
+	if (unlikely(iocb->aio_reserved2 &&
+		     !(iocb->aio_flags & IOCB_FLAG_FIXED_BUF))) {
 		pr_debug("EINVAL: reserve field set\n");
 		return -EINVAL;
 	}
 
 	/* prevent overflows */
 	if (unlikely(
-	    (iocb.aio_buf != (unsigned long)iocb.aio_buf) ||
-	    (iocb.aio_nbytes != (size_t)iocb.aio_nbytes) ||
-	    ((ssize_t)iocb.aio_nbytes < 0)
+	    (iocb->aio_buf != (unsigned long)iocb->aio_buf) ||
+	    (iocb->aio_nbytes != (size_t)iocb->aio_nbytes) ||
+	    ((ssize_t)iocb->aio_nbytes < 0)
 	   )) {
 		pr_debug("EINVAL: overflow check\n");
 		return -EINVAL;
 	}
 
+	if (ctx->flags & IOCTX_FLAG_IOPOLL) {
+		switch (iocb->aio_lio_opcode) {
+		case IOCB_CMD_PREAD:
+		case IOCB_CMD_PWRITE:
+		case IOCB_CMD_PREADV:
+		case IOCB_CMD_PWRITEV:
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
 	req = aio_get_req(ctx);
 	if (unlikely(!req))
 		return -EAGAIN;
 
-	if (iocb.aio_flags & IOCB_FLAG_RESFD) {
+	if (iocb->aio_flags & IOCB_FLAG_RESFD) {
 		/*
 		 * If the IOCB_FLAG_RESFD flag of aio_flags is set, get an
 		 * instance of the file* now. The file descriptor must be
 		 * an eventfd() fd, and will be signaled for each completed
 		 * event using the eventfd_signal() function.
 		 */
-		req->ki_eventfd = eventfd_ctx_fdget((int) iocb.aio_resfd);
+		req->ki_eventfd = eventfd_ctx_fdget((int) iocb->aio_resfd);
 		if (IS_ERR(req->ki_eventfd)) {
 			ret = PTR_ERR(req->ki_eventfd);
 			req->ki_eventfd = NULL;
@@ -1821,39 +2274,33 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 		}
 	}
 
-	ret = put_user(KIOCB_KEY, &user_iocb->aio_key);
-	if (unlikely(ret)) {
-		pr_debug("EFAULT: aio_key\n");
-		goto out_put_req;
-	}
-
 	req->ki_user_iocb = user_iocb;
-	req->ki_user_data = iocb.aio_data;
+	req->ki_user_data = iocb->aio_data;
 
-	switch (iocb.aio_lio_opcode) {
+	switch (iocb->aio_lio_opcode) {
 	case IOCB_CMD_PREAD:
-		ret = aio_read(&req->rw, &iocb, false, compat);
+		ret = aio_read(&req->rw, iocb, false, compat);
 		break;
 	case IOCB_CMD_PWRITE:
-		ret = aio_write(&req->rw, &iocb, false, compat);
+		ret = aio_write(&req->rw, iocb, false, compat);
 		break;
 	case IOCB_CMD_PREADV:
-		ret = aio_read(&req->rw, &iocb, true, compat);
+		ret = aio_read(&req->rw, iocb, true, compat);
 		break;
 	case IOCB_CMD_PWRITEV:
-		ret = aio_write(&req->rw, &iocb, true, compat);
+		ret = aio_write(&req->rw, iocb, true, compat);
 		break;
 	case IOCB_CMD_FSYNC:
-		ret = aio_fsync(&req->fsync, &iocb, false);
+		ret = aio_fsync(&req->fsync, iocb, false);
 		break;
 	case IOCB_CMD_FDSYNC:
-		ret = aio_fsync(&req->fsync, &iocb, true);
+		ret = aio_fsync(&req->fsync, iocb, true);
 		break;
 	case IOCB_CMD_POLL:
-		ret = aio_poll(req, &iocb);
+		ret = aio_poll(req, iocb);
 		break;
 	default:
-		pr_debug("invalid aio operation %d\n", iocb.aio_lio_opcode);
+		pr_debug("invalid aio operation %d\n", iocb->aio_lio_opcode);
 		ret = -EINVAL;
 		break;
 	}
@@ -1865,6 +2312,9 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 	 */
 	if (ret)
 		goto out_put_req;
+
+	if (ctx->flags & IOCTX_FLAG_IOPOLL)
+		aio_iopoll_add(ctx, req);
 	return 0;
 out_put_req:
 	put_reqs_available(ctx, 1);
@@ -1875,6 +2325,22 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 	return ret;
 }
 
+static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
+			 bool compat)
+{
+	struct iocb iocb;
+
+	if (unlikely(copy_from_user(&iocb, user_iocb, sizeof(iocb))))
+		return -EFAULT;
+
+	if (unlikely(put_user(KIOCB_KEY, &user_iocb->aio_key))) {
+		pr_debug("EFAULT: aio_key\n");
+		return -EFAULT;
+	}
+
+	return __io_submit_one(ctx, &iocb, user_iocb, compat);
+}
+
 /* sys_io_submit:
  *	Queue the nr iocbs pointed to by iocbpp for processing.  Returns
  *	the number of iocbs queued.  May return -EINVAL if the aio_context
@@ -1967,6 +2433,709 @@ COMPAT_SYSCALL_DEFINE3(io_submit, compat_aio_context_t, ctx_id,
 }
 #endif
 
+static inline struct iocb __user *aio_sq_user_iocb(struct kioctx *ctx,
+						   unsigned idx)
+{
+	struct aio_sq_ring __user *ring = (void __user *)(ctx->mmap_base +
+				((unsigned long)ctx->sq_page << PAGE_SHIFT));
+
+	return &ring->iocbs[idx & (ctx->sq_entries - 1)];
+}
+
+/* aio_sq_pending
+ *	Returns the number of iocbs userspace queued in the submission ring
+ *	that the kernel has not consumed yet.  Must be called holding
+ *	ctx->sq_lock, or from the SQ thread: it is the only one consuming the
+ *	ring then, so sq_head cannot move under it.
+ */
+static unsigned aio_sq_pending(struct kioctx *ctx)
+{
+	struct aio_sq_ring *ring;
+	unsigned tail;
+
+	ring = kmap_atomic(ctx->ring_pages[ctx->sq_page]);
+	/* Pairs with the store of the iocbs before userspace moved tail */
+	tail = smp_load_acquire(&ring->tail);
+	kunmap_atomic(ring);
+
+	/* Userspace can write anything to tail, never trust it */
+	return min(tail - ctx->sq_head, ctx->sq_entries);
+}
+
+/* aio_sq_fetch
+ *	Copy up to nr iocbs from the submission ring into iocbs, without
+ *	consuming them, and set their aio_key as io_submit() does so that
+ *	io_cancel() accepts them.  Must be called holding ctx->sq_lock.
+ */
+static unsigned aio_sq_fetch(struct kioctx *ctx, struct iocb *iocbs,
+			     unsigned nr)
+{
+	unsigned i;
+
+	nr = min(nr, aio_sq_pending(ctx));
+	for (i = 0; i < nr; i++) {
+		unsigned idx = (ctx->sq_head + i) & (ctx->sq_entries - 1);
+		size_t pos = sizeof(struct aio_sq_ring) +
+			     idx * sizeof(struct iocb);
+		struct page *page;
+		struct iocb *iocb;
+		void *p;
+
+		/* iocbs are 64 bytes and never straddle a page */
+		page = ctx->ring_pages[ctx->sq_page + (pos >> PAGE_SHIFT)];
+		p = kmap_atomic(page);
+		iocb = p + offset_in_page(pos);
+		WRITE_ONCE(iocb->aio_key, KIOCB_KEY);
+		memcpy(&iocbs[i], iocb, sizeof(struct iocb));
+		kunmap_atomic(p);
+		flush_dcache_page(page);
+	}
+
+	return nr;
+}
+
+/* aio_sq_commit
+ *	Consume nr iocbs from the submission ring, dropped of which were
+ *	rejected.  Must be called holding ctx->sq_lock.
+ */
+static void aio_sq_commit(struct kioctx *ctx, unsigned nr, unsigned dropped)
+{
+	struct aio_sq_ring *ring;
+
+	ctx->sq_head += nr;
+
+	ring = kmap_atomic(ctx->ring_pages[ctx->sq_page]);
+	if (dropped)
+		ring->dropped += dropped;
+	/* Let userspace reuse the slots only once we are done reading them */
+	smp_store_release(&ring->head, ctx->sq_head);
+	kunmap_atomic(ring);
+	flush_dcache_page(ctx->ring_pages[ctx->sq_page]);
+}
+
+/* aio_sq_set_flags
+ *	Update the flags of the submission ring.  Only the SQ thread writes
+ *	them, so no lock is needed and this may be called between
+ *	prepare_to_wait() and schedule().
+ */
+static void aio_sq_set_flags(struct kioctx *ctx, unsigned set, unsigned clear)
+{
+	struct aio_sq_ring *ring;
+
+	ring = kmap_atomic(ctx->ring_pages[ctx->sq_page]);
+	WRITE_ONCE(ring->flags, (READ_ONCE(ring->flags) & ~clear) | set);
+	kunmap_atomic(ring);
+	flush_dcache_page(ctx->ring_pages[ctx->sq_page]);
+}
+
+/* aio_sq_fail
+ *	Post the completion of an iocb from the submission ring that failed
+ *	to submit, carrying the error in res.  Returns false if there is no
+ *	completion slot for it, in which case it must stay in the ring.
+ */
+static bool aio_sq_fail(struct kioctx *ctx, struct iocb *iocb,
+			struct iocb __user *user_iocb, long res)
+{
+	struct aio_kiocb *req;
+
+	req = aio_get_req(ctx);
+	if (unlikely(!req))
+		return false;
+
+	req->ki_user_iocb = user_iocb;
+	req->ki_user_data = iocb->aio_data;
+	aio_complete(req, res, 0);
+	return true;
+}
+
+/* aio_sq_submit
+ *	Submit up to to_submit iocbs from the submission ring.  Returns the
+ *	number of iocbs consumed, or an error if none could be.  Submission
+ *	stops at the first iocb we're out of completion slots for; any other
+ *	failing iocb is consumed, completes with the error in its io_event,
+ *	and is accounted in aio_sq_ring->dropped.
+ */
+static int aio_sq_submit(struct kioctx *ctx, unsigned to_submit, bool compat)
+{
+	struct iocb iocbs[AIO_SQ_BATCH];
+	struct blk_plug plug;
+	int consumed = 0, ret = 0;
+
+	BUILD_BUG_ON(sizeof(struct aio_sq_ring) % sizeof(struct iocb));
+
+	mutex_lock(&ctx->sq_lock);
+	blk_start_plug(&plug);
+	while (consumed < to_submit) {
+		unsigned i, nr, dropped = 0;
+
+		nr = aio_sq_fetch(ctx, iocbs, min_t(unsigned,
+					to_submit - consumed, AIO_SQ_BATCH));
+		if (!nr)
+			break;
+
+		for (i = 0; i < nr; i++) {
+			struct iocb __user *user_iocb;
+
+			user_iocb = aio_sq_user_iocb(ctx, ctx->sq_head + i);
+			ret = __io_submit_one(ctx, &iocbs[i], user_iocb, compat);
+			if (ret == -EAGAIN)
+				break;
+			if (ret) {
+				if (!aio_sq_fail(ctx, &iocbs[i], user_iocb, ret)) {
+					ret = -EAGAIN;
+					break;
+				}
+				dropped++;
+			}
+		}
+
+		aio_sq_commit(ctx, i, dropped);
+		consumed += i;
+		if (i < nr)
+			break;
+	}
+	blk_finish_plug(&plug);
+	mutex_unlock(&ctx->sq_lock);
+
+	return consumed ? consumed : ret;
+}
+
+/* aio_sq_has_work
+ *	Called from the SQ thread only, possibly after prepare_to_wait(), so
+ *	it must not sleep: the submission ring is read without sq_lock.
+ */
+static bool aio_sq_has_work(struct kioctx *ctx)
+{
+	if ((ctx->flags & IOCTX_FLAG_IOPOLL) && aio_iopoll_inflight(ctx))
+		return true;
+
+	return aio_sq_pending(ctx) != 0;
+}
+
+/* aio_sq_thread
+ *	Kernel side submission for IOCTX_FLAG_SQPOLL.  Runs on behalf of the
+ *	task that created the context, with its mm, files and credentials,
+ *	polling the submission ring for sq_thread_idle before going to sleep
+ *	and flagging AIO_SQ_NEED_WAKEUP.
+ */
+static int aio_sq_thread(void *data)
+{
+	struct kioctx *ctx = data;
+	struct files_struct *old_files;
+	const struct cred *old_cred;
+	unsigned long timeout;
+	mm_segment_t old_fs;
+	DEFINE_WAIT(wait);
+
+	old_cred = override_creds(ctx->sq_creds);
+	task_lock(current);
+	old_files = current->files;
+	current->files = ctx->sq_files;
+	task_unlock(current);
+	old_fs = get_fs();
+	set_fs(USER_DS);
+
+	timeout = jiffies + ctx->sq_thread_idle;
+	while (!kthread_should_stop()) {
+		if (!aio_sq_has_work(ctx)) {
+			if (time_before(jiffies, timeout)) {
+				cond_resched();
+				continue;
+			}
+
+			prepare_to_wait(&ctx->sq_wait, &wait, TASK_INTERRUPTIBLE);
+			aio_sq_set_flags(ctx, AIO_SQ_NEED_WAKEUP, 0);
+			/*
+			 * Order the flag store against re-reading the tail,
+			 * pairs with the barrier between the tail store and
+			 * the flags load in userspace.
+			 */
+			smp_mb();
+			if (!aio_sq_has_work(ctx) && !kthread_should_stop())
+				schedule();
+			finish_wait(&ctx->sq_wait, &wait);
+			aio_sq_set_flags(ctx, 0, AIO_SQ_NEED_WAKEUP);
+			timeout = jiffies + ctx->sq_thread_idle;
+			continue;
+		}
+
+		/* The mm is going away, exit_aio() will stop us shortly */
+		if (!mmget_not_zero(ctx->sq_mm))
+			break;
+
+		use_mm(ctx->sq_mm);
+		if (aio_sq_submit(ctx, ctx->sq_entries, ctx->sq_compat) > 0)
+			timeout = jiffies + ctx->sq_thread_idle;
+		unuse_mm(ctx->sq_mm);
+
+		/* Reap polled completions too, so the application needn't */
+		if (ctx->flags & IOCTX_FLAG_IOPOLL) {
+			mutex_lock(&ctx->poll_mutex);
+			if (aio_iopoll(ctx, true) > 0)
+				timeout = jiffies + ctx->sq_thread_idle;
+			mutex_unlock(&ctx->poll_mutex);
+		}
+		/* Dropping the last user must not run exit_aio() from here */
+		mmput_async(ctx->sq_mm);
+		cond_resched();
+	}
+
+	set_fs(old_fs);
+	task_lock(current);
+	current->files = old_files;
+	task_unlock(current);
+	revert_creds(old_cred);
+	return 0;
+}
+
+static int aio_sq_thread_start(struct kioctx *ctx,
+			       struct aio_setup2_params *p)
+{
+	struct task_struct *tsk;
+
+	if (ctx->flags & IOCTX_FLAG_SQ_AFF) {
+		if (p->sq_thread_cpu >= nr_cpu_ids ||
+		    !cpu_online(p->sq_thread_cpu))
+			return -EINVAL;
+	}
+
+	ctx->sq_thread_idle = msecs_to_jiffies(p->sq_thread_idle);
+	if (!ctx->sq_thread_idle)
+		ctx->sq_thread_idle = HZ;
+	ctx->sq_compat = in_compat_syscall();
+
+	tsk = kthread_create(aio_sq_thread, ctx, "aio_sq/%d",
+			     task_pid_nr(current));
+	if (IS_ERR(tsk))
+		return PTR_ERR(tsk);
+
+	if (ctx->flags & IOCTX_FLAG_SQ_AFF)
+		kthread_bind(tsk, p->sq_thread_cpu);
+
+	mmgrab(current->mm);
+	ctx->sq_mm = current->mm;
+	ctx->sq_files = get_files_struct(current);
+	ctx->sq_creds = get_current_cred();
+
+	get_task_struct(tsk);
+	ctx->sq_thread = tsk;
+	wake_up_process(tsk);
+	return 0;
+}
+
+static void aio_sq_thread_stop(struct kioctx *ctx)
+{
+	kthread_stop(ctx->sq_thread);
+	put_task_struct(ctx->sq_thread);
+	ctx->sq_thread = NULL;
+
+	put_files_struct(ctx->sq_files);
+	put_cred(ctx->sq_creds);
+	mmdrop(ctx->sq_mm);
+}
+
+static int aio_account_mem(struct kioctx *ctx, unsigned long nr_pages)
+{
+	unsigned long page_limit, cur_pages, new_pages;
+
+	if (!ctx->user)
+		return 0;
+
+	page_limit = rlimit(RLIMIT_MEMLOCK) >> PAGE_SHIFT;
+	do {
+		cur_pages = atomic_long_read(&ctx->user->locked_vm);
+		new_pages = cur_pages + nr_pages;
+		if (new_pages > page_limit)
+			return -ENOMEM;
+	} while (atomic_long_cmpxchg(&ctx->user->locked_vm,
+				     cur_pages, new_pages) != cur_pages);
+
+	return 0;
+}
+
+static void aio_unaccount_mem(struct kioctx *ctx, unsigned long nr_pages)
+{
+	if (ctx->user)
+		atomic_long_sub(nr_pages, &ctx->user->locked_vm);
+}
+
+static void aio_unregister_bufs(struct kioctx *ctx)
+{
+	int i, j;
+
+	for (i = 0; i < ctx->nr_user_bufs; i++) {
+		struct aio_mapped_buf *buf = &ctx->user_bufs[i];
+
+		for (j = 0; j < buf->nr_bvecs; j++)
+			put_page(buf->bvec[j].bv_page);
+		aio_unaccount_mem(ctx, buf->nr_bvecs);
+		kvfree(buf->bvec);
+	}
+
+	kfree(ctx->user_bufs);
+	ctx->user_bufs = NULL;
+	ctx->nr_user_bufs = 0;
+	if (ctx->user) {
+		free_uid(ctx->user);
+		ctx->user = NULL;
+	}
+}
+
+static int aio_copy_iov(struct iovec *iov, void __user *arg, unsigned idx)
+{
+#ifdef CONFIG_COMPAT
+	if (in_compat_syscall()) {
+		struct compat_iovec __user *ciov = arg;
+		struct compat_iovec c;
+
+		if (copy_from_user(&c, &ciov[idx], sizeof(c)))
+			return -EFAULT;
+		iov->iov_base = compat_ptr(c.iov_base);
+		iov->iov_len = c.iov_len;
+		return 0;
+	}
+#endif
+	if (copy_from_user(iov, &((struct iovec __user *)arg)[idx],
+			   sizeof(*iov)))
+		return -EFAULT;
+	return 0;
+}
+
+/* aio_register_bufs
+ *	Pin the nr user buffers described by the iovec array at arg, and
+ *	charge them to RLIMIT_MEMLOCK unless the caller has CAP_IPC_LOCK.
+ */
+static int aio_register_bufs(struct kioctx *ctx, void __user *arg,
+			     unsigned nr)
+{
+	struct page **pages = NULL;
+	int i, j, got_pages = 0;
+	int ret = -EINVAL;
+
+	if (!nr || nr > UIO_MAXIOV)
+		return -EINVAL;
+
+	ctx->user_bufs = kcalloc(nr, sizeof(struct aio_mapped_buf),
+				 GFP_KERNEL);
+	if (!ctx->user_bufs)
+		return -ENOMEM;
+
+	if (!capable(CAP_IPC_LOCK))
+		ctx->user = get_uid(current_user());
+
+	for (i = 0; i < nr; i++) {
+		struct aio_mapped_buf *buf = &ctx->user_bufs[i];
+		unsigned long off, start, end, ubuf;
+		struct iovec iov;
+		int pret, nr_pages;
+		size_t size;
+
+		ret = aio_copy_iov(&iov, arg, i);
+		if (ret)
+			goto err;
+
+		/* Don't allow huge buffers, we'd need a huge bvec array */
+		ret = -EFAULT;
+		if (!iov.iov_base || !iov.iov_len || iov.iov_len > SZ_1G)
+			goto err;
+
+		ubuf = (unsigned long) iov.iov_base;
+		end = (ubuf + iov.iov_len + PAGE_SIZE - 1) >> PAGE_SHIFT;
+		start = ubuf >> PAGE_SHIFT;
+		nr_pages = end - start;
+
+		ret = aio_account_mem(ctx, nr_pages);
+		if (ret)
+			goto err;
+
+		ret = -ENOMEM;
+		if (!pages || nr_pages > got_pages) {
+			kvfree(pages);
+			pages = kvmalloc_array(nr_pages, sizeof(struct page *),
+					       GFP_KERNEL);
+			if (!pages) {
+				aio_unaccount_mem(ctx, nr_pages);
+				goto err;
+			}
+			got_pages = nr_pages;
+		}
+
+		buf->bvec = kvmalloc_array(nr_pages, sizeof(struct bio_vec),
+					   GFP_KERNEL);
+		if (!buf->bvec) {
+			aio_unaccount_mem(ctx, nr_pages);
+			goto err;
+		}
+
+		down_read(&current->mm->mmap_sem);
+		pret = get_user_pages_longterm(ubuf, nr_pages, FOLL_WRITE,
+					       pages, NULL);
+		up_read(&current->mm->mmap_sem);
+
+		if (pret != nr_pages) {
+			for (j = 0; j < pret; j++)
+				put_page(pages[j]);
+			aio_unaccount_mem(ctx, nr_pages);
+			kvfree(buf->bvec);
+			buf->bvec = NULL;
+			ret = pret < 0 ? pret : -EFAULT;
+			goto err;
+		}
+
+		off = ubuf & ~PAGE_MASK;
+		size = iov.iov_len;
+		for (j = 0; j < nr_pages; j++) {
+			size_t vec_len = min_t(size_t, size, PAGE_SIZE - off);
+
+			buf->bvec[j].bv_page = pages[j];
+			buf->bvec[j].bv_len = vec_len;
+			buf->bvec[j].bv_offset = off;
+			off = 0;
+			size -= vec_len;
+		}
+
+		buf->ubuf = ubuf;
+		buf->len = iov.iov_len;
+		buf->nr_bvecs = nr_pages;
+		ctx->nr_user_bufs++;
+	}
+
+	kvfree(pages);
+	return 0;
+err:
+	kvfree(pages);
+	aio_unregister_bufs(ctx);
+	return ret;
+}
+
+static void aio_unregister_files(struct kioctx *ctx)
+{
+	int i;
+
+	for (i = 0; i < ctx->nr_user_files; i++)
+		fput(ctx->user_files[i]);
+
+	kfree(ctx->user_files);
+	ctx->user_files = NULL;
+	ctx->nr_user_files = 0;
+}
+
+/* aio_register_files
+ *	Take a reference to each of the nr file descriptors at arg, for the
+ *	lifetime of the context.
+ */
+static int aio_register_files(struct kioctx *ctx, __s32 __user *fds,
+			      unsigned nr)
+{
+	int i, ret;
+
+	if (!nr || nr > AIO_MAX_FIXED_FILES)
+		return -EINVAL;
+
+	ctx->user_files = kcalloc(nr, sizeof(struct file *), GFP_KERNEL);
+	if (!ctx->user_files)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		s32 fd;
+
+		ret = -EFAULT;
+		if (get_user(fd, &fds[i]))
+			goto err;
+
+		ret = -EBADF;
+		ctx->user_files[i] = fget(fd);
+		if (!ctx->user_files[i])
+			goto err;
+		ctx->nr_user_files++;
+	}
+
+	return 0;
+err:
+	aio_unregister_files(ctx);
+	return ret;
+}
+
+/* sys_io_setup2:
+ *	Like io_setup(), but takes IOCTX_FLAG_* flags and returns the new
+ *	aio_context in params->ctx_id.  With IOCTX_FLAG_SQRING a submission
+ *	ring of params->sq_entries iocbs is mapped right after the completion
+ *	ring, and its address returned in params->sq_ring.  IOCTX_FLAG_SQPOLL
+ *	starts a kernel thread submitting from that ring, which requires
+ *	CAP_SYS_ADMIN.  IOCTX_FLAG_FIXEDBUFS and IOCTX_FLAG_FIXEDFILES register
+ *	buffers and files that iocbs can then refer to by index.
+ *	IOCTX_FLAG_IOPOLL makes O_DIRECT reads and writes complete by polling
+ *	the device instead of through interrupts.
+ *	aio_setup2_params has the same layout for compat tasks, and the iovec
+ *	arrays and ring iocbs it points to are converted on in_compat_syscall(),
+ *	so compat tasks use this entry point and io_ring_enter() directly.
+ */
+SYSCALL_DEFINE3(io_setup2, u32, nr_events, u32, flags,
+		struct aio_setup2_params __user *, params)
+{
+	struct aio_setup2_params p;
+	struct kioctx *ioctx;
+	unsigned sq_entries = 0;
+	long ret;
+
+	if (copy_from_user(&p, params, sizeof(p)))
+		return -EFAULT;
+
+	if (unlikely(!nr_events || p.ctx_id || p.sq_ring || p.resv1 ||
+		     p.resv2))
+		return -EINVAL;
+	if (flags & ~(IOCTX_FLAG_SQRING | IOCTX_FLAG_SQPOLL |
+		      IOCTX_FLAG_SQ_AFF | IOCTX_FLAG_FIXEDBUFS |
+		      IOCTX_FLAG_FIXEDFILES | IOCTX_FLAG_IOPOLL))
+		return -EINVAL;
+	if (!(flags & IOCTX_FLAG_FIXEDBUFS) && (p.bufs || p.nr_bufs))
+		return -EINVAL;
+	if (!(flags & IOCTX_FLAG_FIXEDFILES) && (p.files || p.nr_files))
+		return -EINVAL;
+	if ((flags & IOCTX_FLAG_SQPOLL) && !(flags & IOCTX_FLAG_SQRING))
+		return -EINVAL;
+	if ((flags & IOCTX_FLAG_SQ_AFF) && !(flags & IOCTX_FLAG_SQPOLL))
+		return -EINVAL;
+	if ((flags & IOCTX_FLAG_SQPOLL) && !capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (flags & IOCTX_FLAG_SQRING) {
+		if (!p.sq_entries || p.sq_entries > AIO_SQ_MAX_ENTRIES)
+			return -EINVAL;
+		sq_entries = roundup_pow_of_two(p.sq_entries);
+	}
+
+	ioctx = ioctx_alloc(nr_events, flags, sq_entries);
+	if (IS_ERR(ioctx))
+		return PTR_ERR(ioctx);
+
+	ret = 0;
+	if (flags & IOCTX_FLAG_FIXEDBUFS)
+		ret = aio_register_bufs(ioctx, u64_to_user_ptr(p.bufs),
+					p.nr_bufs);
+	if (!ret && (flags & IOCTX_FLAG_FIXEDFILES))
+		ret = aio_register_files(ioctx, u64_to_user_ptr(p.files),
+					 p.nr_files);
+	if (!ret && (flags & IOCTX_FLAG_SQPOLL))
+		ret = aio_sq_thread_start(ioctx, &p);
+
+	if (!ret) {
+		p.ctx_id = ioctx->user_id;
+		p.sq_entries = ioctx->sq_entries;
+		if (sq_entries)
+			p.sq_ring = ioctx->mmap_base +
+				((unsigned long)ioctx->sq_page << PAGE_SHIFT);
+		if (copy_to_user(params, &p, sizeof(p)))
+			ret = -EFAULT;
+	}
+
+	if (ret)
+		kill_ioctx(current->mm, ioctx, NULL);
+	percpu_ref_put(&ioctx->users);
+	return ret;
+}
+
+static unsigned aio_ring_events(struct kioctx *ctx)
+{
+	struct aio_ring *ring;
+	unsigned head, tail;
+
+	spin_lock_irq(&ctx->completion_lock);
+	ring = kmap_atomic(ctx->ring_pages[0]);
+	head = ring->head % ctx->nr_events;
+	kunmap_atomic(ring);
+	tail = ctx->tail;
+	spin_unlock_irq(&ctx->completion_lock);
+
+	return head <= tail ? tail - head : ctx->nr_events - (head - tail);
+}
+
+/* aio_iopoll_wait
+ *	Poll until at least min_nr events sit in the completion ring, or no
+ *	polled request is left in flight.
+ */
+static int aio_iopoll_wait(struct kioctx *ctx, unsigned min_nr)
+{
+	while (aio_ring_events(ctx) < min_nr && aio_iopoll_inflight(ctx)) {
+		long ret;
+
+		mutex_lock(&ctx->poll_mutex);
+		ret = aio_iopoll(ctx, true);
+		mutex_unlock(&ctx->poll_mutex);
+
+		if (ret < 0)
+			return ret;
+		if (signal_pending(current))
+			return -EINTR;
+		cond_resched();
+	}
+
+	return 0;
+}
+
+/* sys_io_ring_enter:
+ *	Submit up to to_submit iocbs from the submission ring of a context
+ *	created with IOCTX_FLAG_SQRING, then with AIO_ENTER_GETEVENTS wait
+ *	until at least min_complete events sit in the completion ring.  The
+ *	events are not copied out, userspace reaps them from the ring.  For
+ *	IOCTX_FLAG_SQPOLL contexts submission is left to the poll thread,
+ *	which AIO_ENTER_SQ_WAKEUP wakes up.  Returns the number of iocbs
+ *	consumed, including those that completed with an error at once; with a
+ *	poll thread, how many of the last to_submit queued it has consumed.
+ */
+SYSCALL_DEFINE4(io_ring_enter, aio_context_t, ctx_id, u32, to_submit,
+		u32, min_complete, u32, flags)
+{
+	struct kioctx *ctx;
+	long ret;
+
+	if (flags & ~(AIO_ENTER_GETEVENTS | AIO_ENTER_SQ_WAKEUP))
+		return -EINVAL;
+
+	ctx = lookup_ioctx(ctx_id);
+	if (unlikely(!ctx)) {
+		pr_debug("EINVAL: invalid context id\n");
+		return -EINVAL;
+	}
+
+	ret = -EINVAL;
+	if (unlikely(!(ctx->flags & IOCTX_FLAG_SQRING)))
+		goto out;
+
+	ret = 0;
+	if (ctx->sq_thread) {
+		unsigned pending;
+
+		if (flags & AIO_ENTER_SQ_WAKEUP)
+			wake_up(&ctx->sq_wait);
+		mutex_lock(&ctx->sq_lock);
+		pending = aio_sq_pending(ctx);
+		mutex_unlock(&ctx->sq_lock);
+		ret = to_submit - min(to_submit, pending);
+	} else if (to_submit) {
+		ret = aio_sq_submit(ctx, to_submit, in_compat_syscall());
+		if (ret < 0)
+			goto out;
+	}
+
+	if (flags & AIO_ENTER_GETEVENTS) {
+		int err;
+
+		min_complete = min(min_complete, ctx->nr_events - 1);
+		if (ctx->flags & IOCTX_FLAG_IOPOLL)
+			err = aio_iopoll_wait(ctx, min_complete);
+		else
+			err = wait_event_interruptible(ctx->wait,
+					aio_ring_events(ctx) >= min_complete ||
+					atomic_read(&ctx->dead));
+		if (err && !ret)
+			ret = err;
+	}
+out:
+	percpu_ref_put(&ctx->users);
+	return ret;
+}
+
 /* lookup_kiocb
  *	Finds a given iocb for cancellation.
  */
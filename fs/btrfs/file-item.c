@@ -147,6 +147,29 @@ static void btrfs_io_bio_endio_readpage(struct btrfs_io_bio *bio, int err)
 	kfree(bio->csum_allocated);
 }
 
+/*
+ * Checksum items for contiguous disk ranges usually sit next to each other
+ * in the same leaf.  If the slot after the current one holds the checksums
+ * starting at @bytenr, step to it instead of searching the tree again.
+ */
+static bool csum_item_next_slot(struct btrfs_path *path, u64 bytenr)
+{
+	struct extent_buffer *leaf = path->nodes[0];
+	struct btrfs_key key;
+	int slot = path->slots[0] + 1;
+
+	if (slot >= btrfs_header_nritems(leaf))
+		return false;
+
+	btrfs_item_key_to_cpu(leaf, &key, slot);
+	if (key.objectid != BTRFS_EXTENT_CSUM_OBJECTID ||
+	    key.type != BTRFS_EXTENT_CSUM_KEY || key.offset != bytenr)
+		return false;
+
+	path->slots[0] = slot;
+	return true;
+}
+
 static blk_status_t __btrfs_lookup_bio_sums(struct inode *inode, struct bio *bio,
 				   u64 logical_offset, u32 *dst, int dio)
 {
@@ -226,6 +249,10 @@ static blk_status_t __btrfs_lookup_bio_sums(struct inode *inode, struct bio *bio
 			struct btrfs_key found_key;
 			u32 item_size;
 
+			if (item && disk_bytenr == item_last_offset &&
+			    csum_item_next_slot(path, disk_bytenr))
+				goto next_item;
+
 			if (item)
 				btrfs_release_path(path);
 			item = btrfs_lookup_csum(NULL, fs_info->csum_root,
@@ -247,6 +274,7 @@ static blk_status_t __btrfs_lookup_bio_sums(struct inode *inode, struct bio *bio
 				btrfs_release_path(path);
 				goto found;
 			}
+next_item:
 			btrfs_item_key_to_cpu(path->nodes[0], &found_key,
 					      path->slots[0]);
 
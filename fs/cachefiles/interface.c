@@ -305,6 +305,10 @@ static void cachefiles_drop_object(struct fscache_object *_object)
 		}
 
 		/* close the filesystem stuff attached to the object */
+		if (object->backing_file) {
+			fput(object->backing_file);
+			object->backing_file = NULL;
+		}
 		if (object->backer != object->dentry)
 			dput(object->backer);
 		object->backer = NULL;
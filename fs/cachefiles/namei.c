@@ -692,14 +692,36 @@ int cachefiles_walk_to_object(struct cachefiles_object *parent,
 	if (object->type != FSCACHE_COOKIE_TYPE_INDEX) {
 		if (d_is_reg(object->dentry)) {
 			const struct address_space_operations *aops;
+			struct super_block *sb = object->dentry->d_sb;
 
+			/* we find out which pages are cached by asking the
+			 * backing fs where the holes are if it tracks them
+			 * and by bmap() otherwise */
 			ret = -EPERM;
 			aops = d_backing_inode(object->dentry)->i_mapping->a_ops;
-			if (!aops->bmap)
+			if (!(sb->s_type->fs_flags & FS_SEEK_HOLE) && !aops->bmap)
 				goto check_error;
-			if (object->dentry->d_sb->s_blocksize > PAGE_SIZE)
+			if (sb->s_blocksize > PAGE_SIZE)
 				goto check_error;
 
+			/* keep the backer open for the life of the object so
+			 * that reads don't have to open it for every probe */
+			if (sb->s_type->fs_flags & FS_SEEK_HOLE) {
+				struct path path = {
+					.mnt	= cache->mnt,
+					.dentry	= object->dentry,
+				};
+				struct file *file;
+
+				file = dentry_open(&path, O_RDONLY | O_LARGEFILE,
+						   cache->cache_cred);
+				if (IS_ERR(file)) {
+					ret = PTR_ERR(file);
+					goto check_error;
+				}
+				object->backing_file = file;
+			}
+
 			object->backer = object->dentry;
 		} else {
 			BUG(); // TODO: open file in data-class subdir
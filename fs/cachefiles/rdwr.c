@@ -379,6 +379,62 @@ static int cachefiles_read_backing_file_one(struct cachefiles_object *object,
 	return -ENOMEM;
 }
 
+/*
+ * determine whether the backing file holds data for the page at the given
+ * index
+ * - where the backing fs tracks holes, ask it for its extents with
+ *   SEEK_DATA/SEEK_HOLE on the file kept open for the object; the data
+ *   extent last found is cached in *start and *end so that a run of pages
+ *   doesn't have to query the backing fs for every page
+ * - the file position set by the probes is never used, so concurrent
+ *   probes of one object don't need to serialise
+ * - otherwise fall back to bmap() on the first block of the page, which
+ *   can't report errors
+ * - returns 1 if data is present, 0 if not and a negative error otherwise
+ */
+static int cachefiles_has_data(struct cachefiles_object *object, pgoff_t index,
+			       loff_t *start, loff_t *end)
+{
+	struct file *file = object->backing_file;
+	loff_t pos = (loff_t)index << PAGE_SHIFT;
+	loff_t data, hole;
+
+	if (!file) {
+		struct inode *inode = d_backing_inode(object->backer);
+		sector_t block0;
+
+		/* we assume the absence or presence of the first block is a
+		 * good enough indication for the page as a whole */
+		block0 = index;
+		block0 <<= PAGE_SHIFT - inode->i_sb->s_blocksize_bits;
+		return inode->i_mapping->a_ops->bmap(inode->i_mapping, block0) != 0;
+	}
+
+	if (pos >= *start && pos < *end)
+		return 1;
+
+	data = vfs_llseek(file, pos, SEEK_DATA);
+	if (data == -ENXIO)
+		return 0;
+	if (data < 0)
+		return data;
+
+	/* we assume the presence of data anywhere in the page is a good
+	 * enough indication for the page as a whole as we only ever write
+	 * whole pages to the cache */
+	if (data >= pos + PAGE_SIZE)
+		return 0;
+
+	hole = vfs_llseek(file, data, SEEK_HOLE);
+	if (hole < 0)
+		return hole;
+
+	_debug("data %llx-%llx", data, hole);
+	*start = data;
+	*end = hole;
+	return 1;
+}
+
 /*
  * read a page from the cache or allocate a block in which to store it
  * - cache withdrawal is prevented by the caller
@@ -400,8 +456,7 @@ int cachefiles_read_or_alloc_page(struct fscache_retrieval *op,
 	struct cachefiles_object *object;
 	struct cachefiles_cache *cache;
 	struct inode *inode;
-	sector_t block0, block;
-	unsigned shift;
+	loff_t start = 0, end = 0;
 	int ret;
 
 	object = container_of(op->op.object,
@@ -416,31 +471,18 @@ int cachefiles_read_or_alloc_page(struct fscache_retrieval *op,
 
 	inode = d_backing_inode(object->backer);
 	ASSERT(S_ISREG(inode->i_mode));
-	ASSERT(inode->i_mapping->a_ops->bmap);
 	ASSERT(inode->i_mapping->a_ops->readpages);
 
-	/* calculate the shift required to use bmap */
-	shift = PAGE_SHIFT - inode->i_sb->s_blocksize_bits;
-
 	op->op.flags &= FSCACHE_OP_KEEP_FLAGS;
 	op->op.flags |= FSCACHE_OP_ASYNC;
 	op->op.processor = cachefiles_read_copier;
 
-	/* we assume the absence or presence of the first block is a good
-	 * enough indication for the page as a whole
-	 * - TODO: don't use bmap() for this as it is _not_ actually good
-	 *   enough for this as it doesn't indicate errors, but it's all we've
-	 *   got for the moment
-	 */
-	block0 = page->index;
-	block0 <<= shift;
+	ret = cachefiles_has_data(object, page->index, &start, &end);
+	_debug("%lx -> %d", page->index, ret);
 
-	block = inode->i_mapping->a_ops->bmap(inode->i_mapping, block0);
-	_debug("%llx -> %llx",
-	       (unsigned long long) block0,
-	       (unsigned long long) block);
-
-	if (block) {
+	if (ret < 0) {
+		goto enobufs;
+	} else if (ret > 0) {
 		/* submit the apparently valid page to the backing fs to be
 		 * read from disk */
 		ret = cachefiles_read_backing_file_one(object, op, page);
@@ -694,7 +736,8 @@ int cachefiles_read_or_alloc_pages(struct fscache_retrieval *op,
 	struct pagevec pagevec;
 	struct inode *inode;
 	struct page *page, *_n;
-	unsigned shift, nrbackpages;
+	loff_t start = 0, end = 0;
+	unsigned nrbackpages;
 	int ret, ret2, space;
 
 	object = container_of(op->op.object,
@@ -715,12 +758,8 @@ int cachefiles_read_or_alloc_pages(struct fscache_retrieval *op,
 
 	inode = d_backing_inode(object->backer);
 	ASSERT(S_ISREG(inode->i_mode));
-	ASSERT(inode->i_mapping->a_ops->bmap);
 	ASSERT(inode->i_mapping->a_ops->readpages);
 
-	/* calculate the shift required to use bmap */
-	shift = PAGE_SHIFT - inode->i_sb->s_blocksize_bits;
-
 	pagevec_init(&pagevec);
 
 	op->op.flags &= FSCACHE_OP_KEEP_FLAGS;
@@ -732,30 +771,19 @@ int cachefiles_read_or_alloc_pages(struct fscache_retrieval *op,
 
 	ret = space ? -ENODATA : -ENOBUFS;
 	list_for_each_entry_safe(page, _n, pages, lru) {
-		sector_t block0, block;
+		int present;
 
-		/* we assume the absence or presence of the first block is a
-		 * good enough indication for the page as a whole
-		 * - TODO: don't use bmap() for this as it is _not_ actually
-		 *   good enough for this as it doesn't indicate errors, but
-		 *   it's all we've got for the moment
-		 */
-		block0 = page->index;
-		block0 <<= shift;
-
-		block = inode->i_mapping->a_ops->bmap(inode->i_mapping,
-						      block0);
-		_debug("%llx -> %llx",
-		       (unsigned long long) block0,
-		       (unsigned long long) block);
-
-		if (block) {
+		present = cachefiles_has_data(object, page->index, &start, &end);
+		_debug("%lx -> %d", page->index, present);
+
+		if (present > 0) {
 			/* we have data - add it to the list to give to the
 			 * backing fs */
 			list_move(&page->lru, &backpages);
 			(*nr_pages)--;
 			nrbackpages++;
-		} else if (space && pagevec_add(&pagevec, page) == 0) {
+		} else if (present == 0 && space &&
+			   pagevec_add(&pagevec, page) == 0) {
 			fscache_mark_pages_cached(op, &pagevec);
 			fscache_retrieval_complete(op, 1);
 			ret = -ENODATA;
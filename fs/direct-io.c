@@ -620,9 +620,15 @@ static inline int dio_bio_reap(struct dio *dio, struct dio_submit *sdio)
 int sb_init_dio_done_wq(struct super_block *sb)
 {
 	struct workqueue_struct *old;
-	struct workqueue_struct *wq = alloc_workqueue("dio/%s",
-						      WQ_MEM_RECLAIM, 0,
-						      sb->s_id);
+	struct workqueue_struct *wq;
+
+	/*
+	 * Completions are queued from the end_io of the bio, mostly on the
+	 * CPU taking the device interrupt: let them spread out to idle CPUs
+	 * sharing its cache.
+	 */
+	wq = alloc_workqueue("dio/%s", WQ_MEM_RECLAIM | WQ_AFFN_CACHE, 0,
+			     sb->s_id);
 	if (!wq)
 		return -ENOMEM;
 	/*
@@ -99,6 +99,37 @@ int __ext4_check_dir_entry(const char *function, unsigned int line,
 	return 1;
 }
 
+/*
+ * Start reading the inode table block holding @ino, so that the stat()
+ * calls which usually follow readdir() find it in the buffer cache rather
+ * than each waiting for its own read.  @last is the block issued for the
+ * previous entry; runs of entries sharing an inode table block are only
+ * looked up once.  Setting inode_readahead_blks to 0 turns this off along
+ * with the inode table readahead in __ext4_get_inode_loc().
+ */
+void ext4_readdir_ra_inode(struct super_block *sb, unsigned long ino,
+			   ext4_fsblk_t *last)
+{
+	struct ext4_group_desc *gdp;
+	unsigned long offset;
+	ext4_fsblk_t block;
+
+	if (!EXT4_SB(sb)->s_inode_readahead_blks || !ext4_valid_inum(sb, ino))
+		return;
+
+	gdp = ext4_get_group_desc(sb, (ino - 1) / EXT4_INODES_PER_GROUP(sb),
+				  NULL);
+	if (!gdp)
+		return;
+	offset = (ino - 1) % EXT4_INODES_PER_GROUP(sb);
+	block = ext4_inode_table(sb, gdp) +
+		offset / EXT4_SB(sb)->s_inodes_per_block;
+	if (block == *last)
+		return;
+	*last = block;
+	sb_breadahead(sb, block);
+}
+
 static int ext4_readdir(struct file *file, struct dir_context *ctx)
 {
 	unsigned int offset;
@@ -110,6 +141,7 @@ static int ext4_readdir(struct file *file, struct dir_context *ctx)
 	struct buffer_head *bh = NULL;
 	int dir_has_error = 0;
 	struct fscrypt_str fstr = FSTR_INIT(NULL, 0);
+	ext4_fsblk_t ra_last = 0;
 
 	if (ext4_encrypted_inode(inode)) {
 		err = fscrypt_get_encryption_info(inode);
@@ -245,6 +277,9 @@ static int ext4_readdir(struct file *file, struct dir_context *ctx)
 			offset += ext4_rec_len_from_disk(de->rec_len,
 					sb->s_blocksize);
 			if (le32_to_cpu(de->inode)) {
+				ext4_readdir_ra_inode(sb,
+						      le32_to_cpu(de->inode),
+						      &ra_last);
 				if (!ext4_encrypted_inode(inode)) {
 					if (!dir_emit(ctx, de->name,
 					    de->name_len,
@@ -77,6 +77,21 @@ do {									\
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * Number of buddy orders, including order 0 (the bitmap itself)
+ */
+#define MB_NUM_ORDERS(sb)		((sb)->s_blocksize_bits + 2)
+
+/*
+ * Where the last stream allocation on a cpu ended up. Keeping this per
+ * cpu lets concurrent streaming writers start from different groups
+ * instead of all piling onto the same group lock.
+ */
+struct ext4_mb_stream_goal {
+	ext4_group_t	group;
+	ext4_grpblk_t	start;
+};
+
 
 struct ext4_free_data {
 	/* this links the free block information from sb_info */
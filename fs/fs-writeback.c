@@ -1476,14 +1476,119 @@ static long writeback_chunk_size(struct bdi_writeback *wb,
 	return pages;
 }
 
+/*
+ * Up to this many inodes of a WB_SYNC_NONE pass over b_io are written back
+ * at the same time, the flusher doing one of them and wb_inode_wq workers
+ * the others, so that page cache writeback is not bound to a single cpu.
+ */
+#define WB_MAX_PARALLEL_INODES	8
+
+struct wb_inode_writeback {
+	struct work_struct work;
+	struct inode *inode;
+	struct writeback_control wbc;
+	long write_chunk;
+};
+
+static void wb_inode_writeback_fn(struct work_struct *work)
+{
+	struct wb_inode_writeback *iwb =
+		container_of(work, struct wb_inode_writeback, work);
+	struct blk_plug plug;
+
+	blk_start_plug(&plug);
+	__writeback_single_inode(iwb->inode, &iwb->wbc);
+	blk_finish_plug(&plug);
+}
+
+static int wb_parallel_inodes(struct wb_writeback_work *work)
+{
+	/*
+	 * WB_SYNC_ALL writeback waits on each inode in turn, and a rescuer
+	 * must not depend on further workers to make progress.
+	 */
+	if (!wb_inode_wq || work->sync_mode != WB_SYNC_NONE ||
+	    current_is_workqueue_rescuer())
+		return 1;
+
+	return min_t(int, WB_MAX_PARALLEL_INODES, num_online_cpus());
+}
+
+/*
+ * Account the writeback of @inode done with @wbc and requeue the inode.
+ * Called without any lock held, returns with wb->list_lock held.
+ */
+static long writeback_sb_inode_done(struct bdi_writeback *wb,
+				    struct wb_writeback_work *work,
+				    struct inode *inode,
+				    struct writeback_control *wbc,
+				    long write_chunk)
+{
+	struct bdi_writeback *tmp_wb;
+	long wrote;
+
+	wbc_detach_inode(wbc);
+	work->nr_pages -= write_chunk - wbc->nr_to_write;
+	wrote = write_chunk - wbc->nr_to_write;
+
+	/*
+	 * Requeue @inode if still dirty.  Be careful as @inode may
+	 * have been switched to another wb in the meantime.
+	 */
+	tmp_wb = inode_to_wb_and_lock_list(inode);
+	spin_lock(&inode->i_lock);
+	if (!(inode->i_state & I_DIRTY_ALL))
+		wrote++;
+	requeue_inode(inode, tmp_wb, wbc);
+	inode_sync_complete(inode);
+	spin_unlock(&inode->i_lock);
+
+	if (unlikely(tmp_wb != wb)) {
+		spin_unlock(&tmp_wb->list_lock);
+		spin_lock(&wb->list_lock);
+	}
+	return wrote;
+}
+
+/*
+ * Write back the @nr inodes of @batch in parallel. Called with
+ * wb->list_lock held, which is dropped while the IO is issued.
+ */
+static long writeback_sb_inode_batch(struct bdi_writeback *wb,
+				     struct wb_writeback_work *work,
+				     struct wb_inode_writeback *batch, int nr)
+{
+	long wrote = 0;
+	int i;
+
+	spin_unlock(&wb->list_lock);
+
+	for (i = 1; i < nr; i++) {
+		INIT_WORK(&batch[i].work, wb_inode_writeback_fn);
+		queue_work(wb_inode_wq, &batch[i].work);
+	}
+	__writeback_single_inode(batch[0].inode, &batch[0].wbc);
+	for (i = 1; i < nr; i++)
+		flush_work(&batch[i].work);
+
+	for (i = 0; i < nr; i++) {
+		if (i)
+			spin_unlock(&wb->list_lock);
+		wrote += writeback_sb_inode_done(wb, work, batch[i].inode,
+						 &batch[i].wbc,
+						 batch[i].write_chunk);
+	}
+	return wrote;
+}
+
 /*
  * Write a portion of b_io inodes which belong to @sb.
  *
  * Return the number of pages and/or inodes written.
  *
  * NOTE! This is called with wb->list_lock held, and will
- * unlock and relock that for each inode it ends up doing
- * IO for.
+ * unlock and relock that for each inode (or batch of inodes
+ * written back in parallel) it ends up doing IO for.
  */
 static long writeback_sb_inodes(struct super_block *sb,
 				struct bdi_writeback *wb,
@@ -1499,13 +1604,20 @@ static long writeback_sb_inodes(struct super_block *sb,
 		.range_start		= 0,
 		.range_end		= LLONG_MAX,
 	};
+	struct wb_inode_writeback *batch = NULL;
 	unsigned long start_time = jiffies;
+	int max_batch, nr = 0;
+	long batch_pages = 0;
 	long write_chunk;
 	long wrote = 0;  /* count both pages and inodes */
 
+	max_batch = wb_parallel_inodes(work);
+	if (max_batch > 1)
+		batch = kmalloc_array(max_batch, sizeof(*batch),
+				      GFP_NOWAIT | __GFP_NOWARN);
+
 	while (!list_empty(&wb->b_io)) {
 		struct inode *inode = wb_inode(wb->b_io.prev);
-		struct bdi_writeback *tmp_wb;
 
 		if (inode->i_sb != sb) {
 			if (work->sb) {
@@ -1538,6 +1650,21 @@ static long writeback_sb_inodes(struct super_block *sb,
 			continue;
 		}
 		if ((inode->i_state & I_SYNC) && wbc.sync_mode != WB_SYNC_ALL) {
+			/*
+			 * The inodes of a pending batch are parked at the
+			 * head of b_io with I_SYNC set, so seeing one of them
+			 * here means the whole list was scanned: write the
+			 * batch back before looking any further.
+			 */
+			if (nr) {
+				spin_unlock(&inode->i_lock);
+				wrote += writeback_sb_inode_batch(wb, work,
+								  batch, nr);
+				nr = 0;
+				batch_pages = 0;
+				goto check_bail;
+			}
+
 			/*
 			 * If this inode is locked for writeback and we are not
 			 * doing writeback-for-data-integrity, move it to
@@ -1552,6 +1679,34 @@ static long writeback_sb_inodes(struct super_block *sb,
 			trace_writeback_sb_inodes_requeue(inode);
 			continue;
 		}
+
+		if (batch) {
+			struct wb_inode_writeback *iwb = &batch[nr++];
+
+			/*
+			 * We use I_SYNC to pin the inode in memory, see
+			 * below. Park it at the head of b_io until the batch
+			 * is written back.
+			 */
+			inode->i_state |= I_SYNC;
+			iwb->inode = inode;
+			iwb->wbc = wbc;
+			wbc_attach_and_unlock_inode(&iwb->wbc, inode);
+			iwb->write_chunk = writeback_chunk_size(wb, work);
+			iwb->wbc.nr_to_write = iwb->write_chunk;
+			iwb->wbc.pages_skipped = 0;
+			list_move(&inode->i_io_list, &wb->b_io);
+
+			if (!work->tagged_writepages)
+				batch_pages += iwb->write_chunk;
+			if (nr < max_batch && batch_pages < work->nr_pages)
+				continue;
+
+			wrote += writeback_sb_inode_batch(wb, work, batch, nr);
+			nr = 0;
+			batch_pages = 0;
+			goto check_bail;
+		}
 		spin_unlock(&wb->list_lock);
 
 		/*
@@ -1579,10 +1734,6 @@ static long writeback_sb_inodes(struct super_block *sb,
 		 */
 		__writeback_single_inode(inode, &wbc);
 
-		wbc_detach_inode(&wbc);
-		work->nr_pages -= write_chunk - wbc.nr_to_write;
-		wrote += write_chunk - wbc.nr_to_write;
-
 		if (need_resched()) {
 			/*
 			 * We're trying to balance between building up a nice
@@ -1596,23 +1747,9 @@ static long writeback_sb_inodes(struct super_block *sb,
 			cond_resched();
 		}
 
-		/*
-		 * Requeue @inode if still dirty.  Be careful as @inode may
-		 * have been switched to another wb in the meantime.
-		 */
-		tmp_wb = inode_to_wb_and_lock_list(inode);
-		spin_lock(&inode->i_lock);
-		if (!(inode->i_state & I_DIRTY_ALL))
-			wrote++;
-		requeue_inode(inode, tmp_wb, &wbc);
-		inode_sync_complete(inode);
-		spin_unlock(&inode->i_lock);
-
-		if (unlikely(tmp_wb != wb)) {
-			spin_unlock(&tmp_wb->list_lock);
-			spin_lock(&wb->list_lock);
-		}
-
+		wrote += writeback_sb_inode_done(wb, work, inode, &wbc,
+						 write_chunk);
+check_bail:
 		/*
 		 * bail out to wb_writeback() often enough to check
 		 * background threshold and other termination conditions.
@@ -1624,6 +1761,10 @@ static long writeback_sb_inodes(struct super_block *sb,
 				break;
 		}
 	}
+
+	if (nr)
+		wrote += writeback_sb_inode_batch(wb, work, batch, nr);
+	kfree(batch);
 	return wrote;
 }
 
@@ -36,6 +36,9 @@
  * inode_hash_lock protects:
  *   inode_hashtable, inode->i_hash
  *
+ * Hash chains are RCU-protected, so find_inode_fast() may walk them
+ * without inode_hash_lock; inodes are freed through RCU.
+ *
  * Lock ordering:
  *
  * inode->i_sb->s_inode_list_lock
@@ -479,7 +482,7 @@ void __insert_inode_hash(struct inode *inode, unsigned long hashval)
 
 	spin_lock(&inode_hash_lock);
 	spin_lock(&inode->i_lock);
-	hlist_add_head(&inode->i_hash, b);
+	hlist_add_head_rcu(&inode->i_hash, b);
 	spin_unlock(&inode->i_lock);
 	spin_unlock(&inode_hash_lock);
 }
@@ -495,7 +498,7 @@ void __remove_inode_hash(struct inode *inode)
 {
 	spin_lock(&inode_hash_lock);
 	spin_lock(&inode->i_lock);
-	hlist_del_init(&inode->i_hash);
+	hlist_del_init_rcu(&inode->i_hash);
 	spin_unlock(&inode->i_lock);
 	spin_unlock(&inode_hash_lock);
 }
@@ -796,6 +799,7 @@ static struct inode *find_inode(struct super_block *sb,
 {
 	struct inode *inode = NULL;
 
+	rcu_read_lock();
 repeat:
 	hlist_for_each_entry(inode, head, i_hash) {
 		if (inode->i_sb != sb)
@@ -809,43 +813,68 @@ static struct inode *find_inode(struct super_block *sb,
 		}
 		if (unlikely(inode->i_state & I_CREATING)) {
 			spin_unlock(&inode->i_lock);
+			rcu_read_unlock();
 			return ERR_PTR(-ESTALE);
 		}
 		__iget(inode);
 		spin_unlock(&inode->i_lock);
+		rcu_read_unlock();
 		return inode;
 	}
+	rcu_read_unlock();
 	return NULL;
 }
 
 /*
  * find_inode_fast is the fast path version of find_inode, see the comment at
  * iget_locked for details.
+ *
+ * With @hash_locked false the chain is walked under RCU only.  That can miss
+ * an inode that is being added or moved concurrently, so callers that go on
+ * to insert a new inode must repeat the search under inode_hash_lock.
+ * It also must not sleep on an inode that is being freed: evict() may
+ * already have unhashed it and done the wakeup.  An unhashed one is
+ * skipped; for one still hashed -EAGAIN is returned and the caller
+ * repeats the search under inode_hash_lock, where it is safe to wait.
  */
 static struct inode *find_inode_fast(struct super_block *sb,
-				struct hlist_head *head, unsigned long ino)
+				struct hlist_head *head, unsigned long ino,
+				bool hash_locked)
 {
 	struct inode *inode = NULL;
 
+	rcu_read_lock();
 repeat:
-	hlist_for_each_entry(inode, head, i_hash) {
+	hlist_for_each_entry_rcu(inode, head, i_hash) {
 		if (inode->i_ino != ino)
 			continue;
 		if (inode->i_sb != sb)
 			continue;
 		spin_lock(&inode->i_lock);
 		if (inode->i_state & (I_FREEING|I_WILL_FREE)) {
+			if (!hash_locked) {
+				bool unhashed = inode_unhashed(inode);
+
+				spin_unlock(&inode->i_lock);
+				if (unhashed)
+					continue;
+				rcu_read_unlock();
+				return ERR_PTR(-EAGAIN);
+			}
 			__wait_on_freeing_inode(inode);
 			goto repeat;
 		}
 		if (unlikely(inode->i_state & I_CREATING)) {
 			spin_unlock(&inode->i_lock);
+			rcu_read_unlock();
 			return ERR_PTR(-ESTALE);
 		}
 		__iget(inode);
 		spin_unlock(&inode->i_lock);
+		rcu_read_unlock();
 		return inode;
 	}
+	rcu_read_unlock();
 	return NULL;
 }
 
@@ -1085,7 +1114,7 @@ struct inode *inode_insert5(struct inode *inode, unsigned long hashval,
 	 */
 	spin_lock(&inode->i_lock);
 	inode->i_state |= I_NEW;
-	hlist_add_head(&inode->i_hash, head);
+	hlist_add_head_rcu(&inode->i_hash, head);
 	spin_unlock(&inode->i_lock);
 	if (!creating)
 		inode_sb_list_add(inode);
@@ -1154,9 +1183,10 @@ struct inode *iget_locked(struct super_block *sb, unsigned long ino)
 	struct hlist_head *head = inode_hashtable + hash(sb, ino);
 	struct inode *inode;
 again:
-	spin_lock(&inode_hash_lock);
-	inode = find_inode_fast(sb, head, ino);
-	spin_unlock(&inode_hash_lock);
+	inode = find_inode_fast(sb, head, ino, false);
+	/* Being freed: wait for it in the locked search below. */
+	if (inode == ERR_PTR(-EAGAIN))
+		inode = NULL;
 	if (inode) {
 		if (IS_ERR(inode))
 			return NULL;
@@ -1174,12 +1204,12 @@ struct inode *iget_locked(struct super_block *sb, unsigned long ino)
 
 		spin_lock(&inode_hash_lock);
 		/* We released the lock, so.. */
-		old = find_inode_fast(sb, head, ino);
+		old = find_inode_fast(sb, head, ino, true);
 		if (!old) {
 			inode->i_ino = ino;
 			spin_lock(&inode->i_lock);
 			inode->i_state = I_NEW;
-			hlist_add_head(&inode->i_hash, head);
+			hlist_add_head_rcu(&inode->i_hash, head);
 			spin_unlock(&inode->i_lock);
 			inode_sb_list_add(inode);
 			spin_unlock(&inode_hash_lock);
@@ -1367,9 +1397,12 @@ struct inode *ilookup(struct super_block *sb, unsigned long ino)
 	struct hlist_head *head = inode_hashtable + hash(sb, ino);
 	struct inode *inode;
 again:
-	spin_lock(&inode_hash_lock);
-	inode = find_inode_fast(sb, head, ino);
-	spin_unlock(&inode_hash_lock);
+	inode = find_inode_fast(sb, head, ino, false);
+	if (inode == ERR_PTR(-EAGAIN)) {
+		spin_lock(&inode_hash_lock);
+		inode = find_inode_fast(sb, head, ino, true);
+		spin_unlock(&inode_hash_lock);
+	}
 
 	if (inode) {
 		if (IS_ERR(inode))
@@ -1458,7 +1491,7 @@ int insert_inode_locked(struct inode *inode)
 		if (likely(!old)) {
 			spin_lock(&inode->i_lock);
 			inode->i_state |= I_NEW | I_CREATING;
-			hlist_add_head(&inode->i_hash, head);
+			hlist_add_head_rcu(&inode->i_hash, head);
 			spin_unlock(&inode->i_lock);
 			spin_unlock(&inode_hash_lock);
 			return 0;
@@ -1904,6 +1937,9 @@ EXPORT_SYMBOL(inode_needs_sync);
  * It doesn't matter if I_NEW is not set initially, a call to
  * wake_up_bit(&inode->i_state, __I_NEW) after removing from the hash list
  * will DTRT.
+ *
+ * Called under rcu_read_lock() and inode_hash_lock; both are dropped
+ * across the sleep and retaken before returning.
  */
 static void __wait_on_freeing_inode(struct inode *inode)
 {
@@ -1912,10 +1948,12 @@ static void __wait_on_freeing_inode(struct inode *inode)
 	wq = bit_waitqueue(&inode->i_state, __I_NEW);
 	prepare_to_wait(wq, &wait.wq_entry, TASK_UNINTERRUPTIBLE);
 	spin_unlock(&inode->i_lock);
+	rcu_read_unlock();
 	spin_unlock(&inode_hash_lock);
 	schedule();
 	finish_wait(wq, &wait.wq_entry);
 	spin_lock(&inode_hash_lock);
+	rcu_read_lock();
 }
 
 static __initdata unsigned long ihash_entries;
@@ -1903,6 +1903,16 @@ iomap_dio_rw(struct kiocb *iocb, struct iov_iter *iter,
 	if (dio->flags & IOMAP_DIO_WRITE_FUA)
 		dio->flags &= ~IOMAP_DIO_NEED_SYNC;
 
+	/*
+	 * Tell ->iopoll where to poll.  This has to be done before dropping
+	 * our reference, the dio may be freed as soon as we do, but a polled
+	 * iocb is only completed once reaped by the poller.
+	 */
+	if (!dio->wait_for_completion && (iocb->ki_flags & IOCB_HIPRI)) {
+		WRITE_ONCE(iocb->ki_cookie, dio->submit.cookie);
+		WRITE_ONCE(iocb->private, dio->submit.last_queue);
+	}
+
 	if (!atomic_dec_and_test(&dio->ref)) {
 		if (!dio->wait_for_completion)
 			return -EIOCBQUEUED;
@@ -1931,6 +1941,17 @@ iomap_dio_rw(struct kiocb *iocb, struct iov_iter *iter,
 }
 EXPORT_SYMBOL_GPL(iomap_dio_rw);
 
+/* ->iopoll for files doing async polled direct I/O through iomap_dio_rw() */
+int iomap_dio_iopoll(struct kiocb *kiocb)
+{
+	struct request_queue *q = READ_ONCE(kiocb->private);
+
+	if (!q)
+		return 0;
+	return blk_poll(q, READ_ONCE(kiocb->ki_cookie));
+}
+EXPORT_SYMBOL_GPL(iomap_dio_iopoll);
+
 /* Swapfile activation */
 
 #ifdef CONFIG_SWAP
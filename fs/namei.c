@@ -296,16 +296,23 @@ static int acl_permission_check(struct inode *inode, int mask)
 {
 	unsigned int mode = inode->i_mode;
 
-	if (likely(uid_eq(current_fsuid(), inode->i_uid)))
+	if (likely(uid_eq(current_fsuid(), inode->i_uid))) {
 		mode >>= 6;
-	else {
+	} else {
 		if (IS_POSIXACL(inode) && (mode & S_IRWXG)) {
 			int error = check_acl(inode, mask);
 			if (error != -EAGAIN)
 				return error;
 		}
 
-		if (in_group_p(inode->i_gid))
+		/*
+		 * Only look at the group membership if the group bits we
+		 * care about differ from the other bits.  For the common
+		 * 0755 directory this skips in_group_p() on every path
+		 * component.
+		 */
+		if ((mask & (MAY_READ | MAY_WRITE | MAY_EXEC) &
+		     (mode ^ (mode >> 3))) && in_group_p(inode->i_gid))
 			mode >>= 3;
 	}
 
@@ -65,6 +65,11 @@ struct nfs_clone_mount {
 #define NFS_UNSPEC_RETRANS	(UINT_MAX)
 #define NFS_UNSPEC_TIMEO	(UINT_MAX)
 
+/*
+ * Maximum number of transport connections nconnect= may ask for.
+ */
+#define NFS_MAX_CONNECTIONS	16
+
 /*
  * Maximum number of pages that readdir can use for creating
  * a vmapped array of pages.
@@ -81,6 +86,7 @@ struct nfs_client_initdata {
 	struct nfs_subversion *nfs_mod;
 	int proto;
 	u32 minorversion;
+	unsigned int nconnect;
 	struct net *net;
 	const struct rpc_timeout *timeparms;
 };
@@ -102,6 +108,7 @@ struct nfs_parsed_mount_data {
 	char			*client_address;
 	unsigned int		version;
 	unsigned int		minorversion;
+	unsigned int		nconnect;
 	char			*fscache_uniq;
 	bool			need_mount;
 
@@ -15,6 +15,7 @@
 #include <linux/highmem.h>
 #include <linux/log2.h>
 #include <linux/hash.h>
+#include <linux/percpu_counter.h>
 #include <net/checksum.h>
 
 #include "nfsd.h"
@@ -46,18 +47,20 @@ static unsigned int		maskbits;
 static unsigned int		drc_hashsize;
 
 /*
- * Stats and other tracking of on the duplicate reply cache. All of these and
- * the "rc" fields in nfsdstats are protected by the cache_lock
+ * Stats and other tracking of on the duplicate reply cache.  These are
+ * updated under the per-bucket cache_lock of whichever bucket is being
+ * worked on, so the ones touched on every request are per-cpu to keep
+ * the buckets from sharing a hot cacheline.
  */
 
 /* total number of entries */
 static atomic_t			num_drc_entries;
 
 /* cache misses due only to checksum comparison failures */
-static unsigned int		payload_misses;
+static struct percpu_counter	payload_misses;
 
 /* amount of memory (in bytes) currently consumed by the DRC */
-static unsigned int		drc_mem_usage;
+static struct percpu_counter	drc_mem_usage;
 
 /* longest hash chain seen */
 static unsigned int		longest_chain;
@@ -150,14 +153,14 @@ static void
 nfsd_reply_cache_free_locked(struct nfsd_drc_bucket *b, struct svc_cacherep *rp)
 {
 	if (rp->c_type == RC_REPLBUFF && rp->c_replvec.iov_base) {
-		drc_mem_usage -= rp->c_replvec.iov_len;
+		percpu_counter_sub(&drc_mem_usage, rp->c_replvec.iov_len);
 		kfree(rp->c_replvec.iov_base);
 	}
 	if (rp->c_state != RC_UNUSED) {
 		rb_erase(&rp->c_node, &b->rb_head);
 		list_del(&rp->c_lru);
 		atomic_dec(&num_drc_entries);
-		drc_mem_usage -= sizeof(*rp);
+		percpu_counter_sub(&drc_mem_usage, sizeof(*rp));
 	}
 	kmem_cache_free(drc_slab, rp);
 }
@@ -181,9 +184,16 @@ int nfsd_reply_cache_init(void)
 	hashsize = nfsd_hashsize(max_drc_entries);
 	maskbits = ilog2(hashsize);
 
-	status = register_shrinker(&nfsd_reply_cache_shrinker);
+	status = percpu_counter_init(&payload_misses, 0, GFP_KERNEL);
 	if (status)
 		return status;
+	status = percpu_counter_init(&drc_mem_usage, 0, GFP_KERNEL);
+	if (status)
+		goto out_free_misses;
+
+	status = register_shrinker(&nfsd_reply_cache_shrinker);
+	if (status)
+		goto out_free_usage;
 
 	drc_slab = kmem_cache_create("nfsd_drc", sizeof(struct svc_cacherep),
 					0, 0, NULL);
@@ -209,6 +219,11 @@ int nfsd_reply_cache_init(void)
 	printk(KERN_ERR "nfsd: failed to allocate reply cache\n");
 	nfsd_reply_cache_shutdown();
 	return -ENOMEM;
+out_free_usage:
+	percpu_counter_destroy(&drc_mem_usage);
+out_free_misses:
+	percpu_counter_destroy(&payload_misses);
+	return status;
 }
 
 void nfsd_reply_cache_shutdown(void)
@@ -232,6 +247,9 @@ void nfsd_reply_cache_shutdown(void)
 
 	kmem_cache_destroy(drc_slab);
 	drc_slab = NULL;
+
+	percpu_counter_destroy(&drc_mem_usage);
+	percpu_counter_destroy(&payload_misses);
 }
 
 /*
@@ -338,7 +356,7 @@ nfsd_cache_key_cmp(const struct svc_cacherep *key, const struct svc_cacherep *rp
 {
 	if (key->c_key.k_xid == rp->c_key.k_xid &&
 	    key->c_key.k_csum != rp->c_key.k_csum)
-		++payload_misses;
+		percpu_counter_inc(&payload_misses);
 
 	return memcmp(&key->c_key, &rp->c_key, sizeof(key->c_key));
 }
@@ -375,15 +393,19 @@ nfsd_cache_insert(struct nfsd_drc_bucket *b, struct svc_cacherep *key)
 	rb_link_node(&key->c_node, parent, p);
 	rb_insert_color(&key->c_node, &b->rb_head);
 out:
-	/* tally hash chain length stats */
-	if (entries > longest_chain) {
+	/*
+	 * Tally hash chain length stats.  Only write the globals when they
+	 * actually change; every bucket checks them on every lookup.
+	 */
+	if (entries > READ_ONCE(longest_chain)) {
 		longest_chain = entries;
 		longest_chain_cachesize = atomic_read(&num_drc_entries);
-	} else if (entries == longest_chain) {
+	} else if (entries == READ_ONCE(longest_chain)) {
 		/* prefer to keep the smallest cachesize possible here */
-		longest_chain_cachesize = min_t(unsigned int,
-				longest_chain_cachesize,
-				atomic_read(&num_drc_entries));
+		unsigned int size = atomic_read(&num_drc_entries);
+
+		if (size < READ_ONCE(longest_chain_cachesize))
+			longest_chain_cachesize = size;
 	}
 
 	lru_put_end(b, ret);
@@ -439,7 +461,7 @@ nfsd_cache_lookup(struct svc_rqst *rqstp)
 	rp->c_state = RC_INPROG;
 
 	atomic_inc(&num_drc_entries);
-	drc_mem_usage += sizeof(*rp);
+	percpu_counter_add(&drc_mem_usage, sizeof(*rp));
 
 	/* go ahead and prune the cache */
 	prune_bucket(b);
@@ -546,7 +568,7 @@ nfsd_cache_update(struct svc_rqst *rqstp, int cachetype, __be32 *statp)
 		return;
 	}
 	spin_lock(&b->cache_lock);
-	drc_mem_usage += bufsize;
+	percpu_counter_add(&drc_mem_usage, bufsize);
 	lru_put_end(b, rp);
 	rp->c_secure = test_bit(RQ_SECURE, &rqstp->rq_flags);
 	rp->c_type = cachetype;
@@ -586,11 +608,13 @@ static int nfsd_reply_cache_stats_show(struct seq_file *m, void *v)
 	seq_printf(m, "num entries:           %u\n",
 			atomic_read(&num_drc_entries));
 	seq_printf(m, "hash buckets:          %u\n", 1 << maskbits);
-	seq_printf(m, "mem usage:             %u\n", drc_mem_usage);
+	seq_printf(m, "mem usage:             %lld\n",
+			percpu_counter_sum_positive(&drc_mem_usage));
 	seq_printf(m, "cache hits:            %u\n", nfsdstats.rchits);
 	seq_printf(m, "cache misses:          %u\n", nfsdstats.rcmisses);
 	seq_printf(m, "not cached:            %u\n", nfsdstats.rcnocache);
-	seq_printf(m, "payload misses:        %u\n", payload_misses);
+	seq_printf(m, "payload misses:        %lld\n",
+			percpu_counter_sum_positive(&payload_misses));
 	seq_printf(m, "longest chain len:     %u\n", longest_chain);
 	seq_printf(m, "cachesize at longest:  %u\n", longest_chain_cachesize);
 	return 0;
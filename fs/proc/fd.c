@@ -57,6 +57,11 @@ static int seq_show(struct seq_file *m, void *v)
 		   (long long)file->f_pos, f_flags,
 		   real_mount(file->f_path.mnt)->mnt_id);
 
+	if (S_ISREG(file_inode(file)->i_mode))
+		seq_printf(m, "ra_submitted:\t%lu\nra_hits:\t%lu\nra_misses:\t%lu\n",
+			   file->f_ra.nr_submitted, file->f_ra.nr_hits,
+			   file->f_ra.nr_misses);
+
 	show_fd_locks(m, file, files);
 	if (seq_has_overflowed(m))
 		goto out;
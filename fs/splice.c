@@ -1206,9 +1206,18 @@ static int iter_to_pipe(struct iov_iter *from,
 		struct page *pages[16];
 		ssize_t copied;
 		size_t start;
-		int n;
+		int n, room;
 
-		copied = iov_iter_get_pages(from, pages, ~0UL, 16, &start);
+		/*
+		 * Don't pin more user pages than the pipe has free slots
+		 * for; the excess would only be released again below.
+		 */
+		room = min_t(int, ARRAY_SIZE(pages),
+			     pipe->buffers - pipe->nrbufs);
+		if (room <= 0)
+			break;
+
+		copied = iov_iter_get_pages(from, pages, ~0UL, room, &start);
 		if (copied <= 0) {
 			ret = copied;
 			break;
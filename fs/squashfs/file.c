@@ -47,6 +47,8 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/mm_inline.h>
+#include <linux/workqueue.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -507,7 +509,125 @@ static int squashfs_readpage(struct file *file, struct page *page)
 	return 0;
 }
 
+#if defined(CONFIG_SQUASHFS_FILE_DIRECT) && !defined(CONFIG_SQUASHFS_DECOMP_SINGLE)
+/*
+ * Readahead.  squashfs_readpage() of a page in a datablock decompresses
+ * the whole block straight into the page cache, grabbing the other pages
+ * of the block itself.  So only the first readahead page of each block
+ * is added to the page cache here, and it is read by a work item rather
+ * than in line, which lets the blocks of a readahead window decompress
+ * in parallel on as many cpus as there are decompressors.
+ */
+struct squashfs_readahead_work {
+	struct work_struct	work;
+	struct page		*page;
+};
+
+static struct workqueue_struct *squashfs_read_wq;
+
+static void squashfs_readahead_fn(struct work_struct *work)
+{
+	struct squashfs_readahead_work *rw = container_of(work,
+		struct squashfs_readahead_work, work);
+
+	squashfs_readpage(NULL, rw->page);
+	put_page(rw->page);
+	kfree(rw);
+}
+
+static void squashfs_queue_readpage(struct page *page)
+{
+	struct squashfs_readahead_work *rw = kmalloc(sizeof(*rw), GFP_NOFS);
+
+	if (rw == NULL) {
+		squashfs_readpage(NULL, page);
+		put_page(page);
+		return;
+	}
+
+	INIT_WORK(&rw->work, squashfs_readahead_fn);
+	rw->page = page;
+	queue_work(squashfs_read_wq, &rw->work);
+}
+
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned int nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_SHIFT;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	bool fragment = squashfs_i(inode)->fragment_block !=
+					SQUASHFS_INVALID_BLK;
+	gfp_t gfp = readahead_gfp_mask(mapping);
+	struct page *pending = NULL;
+	pgoff_t block = 0;
+
+	while (!list_empty(pages)) {
+		struct page *page = lru_to_page(pages);
+		pgoff_t index = page->index >> shift;
+
+		list_del(&page->lru);
+
+		/*
+		 * The other pages of a datablock are filled when the
+		 * pending page is read, the tail end fragment is copied
+		 * page by page.
+		 */
+		if (pending && index == block &&
+				(index < file_end || !fragment)) {
+			if (PageReadahead(page))
+				SetPageReadahead(pending);
+			put_page(page);
+			continue;
+		}
+
+		if (pending)
+			squashfs_queue_readpage(pending);
+		pending = NULL;
+
+		if (add_to_page_cache_lru(page, mapping, page->index, gfp)) {
+			put_page(page);
+			continue;
+		}
+
+		pending = page;
+		block = index;
+	}
+
+	if (pending)
+		squashfs_queue_readpage(pending);
+
+	return 0;
+}
+
+int __init squashfs_readahead_init(void)
+{
+	squashfs_read_wq = alloc_workqueue("squashfs_read",
+					   WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+
+	return squashfs_read_wq ? 0 : -ENOMEM;
+}
+
+void squashfs_readahead_exit(void)
+{
+	destroy_workqueue(squashfs_read_wq);
+}
+#else
+int __init squashfs_readahead_init(void)
+{
+	return 0;
+}
+
+void squashfs_readahead_exit(void)
+{
+}
+#endif
+
 
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+#if defined(CONFIG_SQUASHFS_FILE_DIRECT) && !defined(CONFIG_SQUASHFS_DECOMP_SINGLE)
+	.readpages = squashfs_readpages,
+#endif
 };
@@ -27,6 +27,9 @@
 #include <linux/freezer.h>
 #include <linux/iversion.h>
 
+/* unlinked inodes an AG may have waiting before unlinkers are throttled */
+#define XFS_INACTIVE_MAX	256
+
 /*
  * Allocate and initialise an xfs_inode.
  */
@@ -233,6 +236,8 @@ xfs_inode_set_reclaim_tag(
 	radix_tree_tag_set(&pag->pag_ici_root, XFS_INO_TO_AGINO(mp, ip->i_ino),
 			   XFS_ICI_RECLAIM_TAG);
 	xfs_perag_set_reclaim_tag(pag);
+	/* background inactivation, if any, is complete at this point */
+	ip->i_flags &= ~XFS_NEED_INACTIVE;
 	__xfs_iflags_set(ip, XFS_IRECLAIMABLE);
 
 	spin_unlock(&ip->i_flags_lock);
@@ -240,6 +245,91 @@ xfs_inode_set_reclaim_tag(
 	xfs_perag_put(pag);
 }
 
+/*
+ * Freeing an unlinked inode in xfs_inactive() takes several transactions,
+ * and doing that in the evict path makes mass unlinks wait for every one
+ * of them.  Instead, once the filesystem is fully mounted, unlinked
+ * inodes are queued on their AG and inactivated by a per-AG worker, so
+ * different AGs are processed in parallel while each worker stays on the
+ * same AGI.  Until the worker is done the inode is marked
+ * XFS_NEED_INACTIVE, which keeps lookups and the ag walkers away from it;
+ * it is not tagged for reclaim before then either.
+ *
+ * Returns true if the inode has been queued.
+ */
+bool
+xfs_inode_defer_inactive(
+	struct xfs_inode	*ip)
+{
+	struct xfs_mount	*mp = ip->i_mount;
+	struct xfs_perag	*pag;
+
+	if (!(mp->m_flags & XFS_MOUNT_INACTIVE_DEFER))
+		return false;
+	if (VFS_I(ip)->i_nlink || VFS_I(ip)->i_mode == 0)
+		return false;
+	if (XFS_FORCED_SHUTDOWN(mp) || (mp->m_flags & XFS_MOUNT_RDONLY))
+		return false;
+	if (xfs_iflags_test(ip, XFS_IRECOVERY))
+		return false;
+
+	xfs_iflags_set(ip, XFS_NEED_INACTIVE);
+
+	pag = xfs_perag_get(mp, XFS_INO_TO_AGNO(mp, ip->i_ino));
+	if (llist_add(&ip->i_inactive_node, &pag->pag_inactive_list))
+		queue_work(mp->m_inactive_workqueue, &pag->pag_inactive_work);
+	/*
+	 * Don't let unlinkers run arbitrarily far ahead of the worker: past
+	 * the limit, wait for the AG's backlog as the synchronous path would.
+	 */
+	if (atomic_inc_return(&pag->pag_inactive_count) > XFS_INACTIVE_MAX)
+		flush_work(&pag->pag_inactive_work);
+	xfs_perag_put(pag);
+
+	return true;
+}
+
+void
+xfs_inactive_worker(
+	struct work_struct	*work)
+{
+	struct xfs_perag	*pag = container_of(work, struct xfs_perag,
+						    pag_inactive_work);
+	struct llist_node	*node;
+	struct xfs_inode	*ip, *n;
+
+	/* process inodes in the order they were unlinked */
+	node = llist_reverse_order(llist_del_all(&pag->pag_inactive_list));
+	llist_for_each_entry_safe(ip, n, node, i_inactive_node) {
+		xfs_inactive(ip);
+		xfs_inode_inactivated(ip);
+		atomic_dec(&pag->pag_inactive_count);
+	}
+}
+
+/*
+ * Wait for all queued background inactivation to finish.  Returns true
+ * if any inodes were queued.
+ */
+bool
+xfs_inactive_flush(
+	struct xfs_mount	*mp)
+{
+	struct xfs_perag	*pag;
+	xfs_agnumber_t		agno;
+	bool			queued = false;
+
+	for (agno = 0; agno < mp->m_sb.sb_agcount; agno++) {
+		pag = xfs_perag_get(mp, agno);
+		if (atomic_read(&pag->pag_inactive_count))
+			queued = true;
+		xfs_perag_put(pag);
+	}
+	if (queued)
+		flush_workqueue(mp->m_inactive_workqueue);
+	return queued;
+}
+
 STATIC void
 xfs_inode_clear_reclaim_tag(
 	struct xfs_perag	*pag,
@@ -378,7 +468,7 @@ xfs_iget_cache_hit(
 	 *	     wait_on_inode to wait for these flags to be cleared
 	 *	     instead of polling for it.
 	 */
-	if (ip->i_flags & (XFS_INEW|XFS_IRECLAIM)) {
+	if (ip->i_flags & (XFS_INEW|XFS_IRECLAIM|XFS_NEED_INACTIVE)) {
 		trace_xfs_iget_skip(ip);
 		XFS_STATS_INC(mp, xs_ig_frecycle);
 		error = -EAGAIN;
@@ -753,7 +843,8 @@ xfs_inode_ag_walk_grab(
 
 	/* avoid new or reclaimable inodes. Leave for reclaim code to flush */
 	if ((!newinos && __xfs_iflags_test(ip, XFS_INEW)) ||
-	    __xfs_iflags_test(ip, XFS_IRECLAIMABLE | XFS_IRECLAIM))
+	    __xfs_iflags_test(ip, XFS_IRECLAIMABLE | XFS_IRECLAIM |
+				  XFS_NEED_INACTIVE))
 		goto out_unlock_noent;
 	spin_unlock(&ip->i_flags_lock);
 
@@ -48,6 +48,7 @@ typedef struct xfs_inode {
 	spinlock_t		i_flags_lock;	/* inode i_flags lock */
 	/* Miscellaneous state. */
 	unsigned long		i_flags;	/* see defined flags below */
+	struct llist_node	i_inactive_node; /* per-AG inactivation list */
 	unsigned int		i_delayed_blks;	/* count of delay alloc blks */
 
 	struct xfs_icdinode	i_d;		/* most of ondisk inode */
@@ -229,6 +230,7 @@ static inline bool xfs_inode_has_cow_data(struct xfs_inode *ip)
  */
 #define XFS_IRECOVERY		(1 << 11)
 #define XFS_ICOWBLOCKS		(1 << 12)/* has the cowblocks tag set */
+#define XFS_NEED_INACTIVE	(1 << 13)/* queued for background inactivation */
 
 /*
  * Per-lifetime flags need to be reset when re-using a reclaimable inode during
@@ -204,6 +204,9 @@ xfs_initialize_perag(
 		spin_lock_init(&pag->pag_ici_lock);
 		mutex_init(&pag->pag_ici_reclaim_lock);
 		INIT_RADIX_TREE(&pag->pag_ici_root, GFP_ATOMIC);
+		init_llist_head(&pag->pag_inactive_list);
+		INIT_WORK(&pag->pag_inactive_work, xfs_inactive_worker);
+		atomic_set(&pag->pag_inactive_count, 0);
 		if (xfs_buf_hash_init(pag))
 			goto out_free_pag;
 		init_waitqueue_head(&pag->pagb_wait);
@@ -1034,6 +1037,12 @@ xfs_mountfs(
 			goto out_agresv;
 	}
 
+	/*
+	 * Log recovery processes unlinked inodes synchronously; from now on
+	 * they can be inactivated in the background.
+	 */
+	mp->m_flags |= XFS_MOUNT_INACTIVE_DEFER;
+
 	return 0;
 
  out_agresv:
@@ -1095,6 +1104,14 @@ xfs_unmountfs(
 	uint64_t		resblks;
 	int			error;
 
+	/*
+	 * Finish off unlinked inodes queued for background inactivation
+	 * before tearing anything down; any inodes released from here on
+	 * are inactivated directly.
+	 */
+	mp->m_flags &= ~XFS_MOUNT_INACTIVE_DEFER;
+	flush_workqueue(mp->m_inactive_workqueue);
+
 	xfs_icache_disable_reclaim(mp);
 	xfs_fs_unreserve_ag_blocks(mp);
 	xfs_qm_unmount_quotas(mp);
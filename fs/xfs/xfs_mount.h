@@ -171,6 +171,7 @@ typedef struct xfs_mount {
 	struct workqueue_struct	*m_log_workqueue;
 	struct workqueue_struct *m_eofblocks_workqueue;
 	struct workqueue_struct	*m_sync_workqueue;
+	struct workqueue_struct	*m_inactive_workqueue;
 
 	/*
 	 * Generation of the filesysyem layout.  This is incremented by each
@@ -227,6 +228,8 @@ typedef struct xfs_mount {
 #define XFS_MOUNT_FILESTREAMS	(1ULL << 24)	/* enable the filestreams
 						   allocator */
 #define XFS_MOUNT_NOATTR2	(1ULL << 25)	/* disable use of attr2 format */
+#define XFS_MOUNT_INACTIVE_DEFER (1ULL << 26)	/* inactivate unlinked inodes
+						 * in the background */
 
 #define XFS_MOUNT_DAX		(1ULL << 62)	/* TEST ONLY! */
 
@@ -370,6 +373,11 @@ typedef struct xfs_perag {
 	struct mutex	pag_ici_reclaim_lock;	/* serialisation point */
 	unsigned long	pag_ici_reclaim_cursor;	/* reclaim restart point */
 
+	/* unlinked inodes waiting for background inactivation */
+	struct llist_head	pag_inactive_list;
+	struct work_struct	pag_inactive_work;
+	atomic_t		pag_inactive_count;
+
 	/* buffer cache index */
 	spinlock_t	pag_buf_lock;	/* lock for pag_buf_hash */
 	struct rhashtable pag_buf_hash;
@@ -873,8 +873,15 @@ xfs_init_mount_workqueues(
 	if (!mp->m_sync_workqueue)
 		goto out_destroy_eofb;
 
+	mp->m_inactive_workqueue = alloc_workqueue("xfs-inactive/%s",
+			WQ_MEM_RECLAIM|WQ_FREEZABLE, 0, mp->m_fsname);
+	if (!mp->m_inactive_workqueue)
+		goto out_destroy_sync;
+
 	return 0;
 
+out_destroy_sync:
+	destroy_workqueue(mp->m_sync_workqueue);
 out_destroy_eofb:
 	destroy_workqueue(mp->m_eofblocks_workqueue);
 out_destroy_log:
@@ -897,6 +904,7 @@ STATIC void
 xfs_destroy_mount_workqueues(
 	struct xfs_mount	*mp)
 {
+	destroy_workqueue(mp->m_inactive_workqueue);
 	destroy_workqueue(mp->m_sync_workqueue);
 	destroy_workqueue(mp->m_eofblocks_workqueue);
 	destroy_workqueue(mp->m_log_workqueue);
@@ -912,6 +920,9 @@ xfs_destroy_mount_workqueues(
  * or a page lock. We use sync_inodes_sb() here to ensure we block while waiting
  * for IO to complete so that we effectively throttle multiple callers to the
  * rate at which IO is completing.
+ *
+ * Unlinked inodes still queued for background inactivation pin their
+ * blocks too, so let those be freed as well.
  */
 void
 xfs_flush_inodes(
@@ -923,6 +934,9 @@ xfs_flush_inodes(
 		sync_inodes_sb(sb);
 		up_read(&sb->s_umount);
 	}
+
+	if (sb->s_writers.frozen < SB_FREEZE_FS)
+		xfs_inactive_flush(mp);
 }
 
 /* Catch misguided souls that try to use this interface on XFS */
@@ -976,8 +990,22 @@ xfs_fs_destroy_inode(
 	XFS_STATS_INC(ip->i_mount, vn_rele);
 	XFS_STATS_INC(ip->i_mount, vn_remove);
 
+	/* Unlinked inodes are freed and queued for reclaim in the background */
+	if (xfs_inode_defer_inactive(ip))
+		return;
+
 	xfs_inactive(ip);
+	xfs_inode_inactivated(ip);
+}
 
+/*
+ * Hand an inode that xfs_inactive() is done with over to reclaim, from
+ * the evict path or from background inactivation.
+ */
+void
+xfs_inode_inactivated(
+	struct xfs_inode	*ip)
+{
 	if (!XFS_FORCED_SHUTDOWN(ip->i_mount) && ip->i_delayed_blks) {
 		xfs_check_delalloc(ip, XFS_DATA_FORK);
 		xfs_check_delalloc(ip, XFS_COW_FORK);
@@ -1101,6 +1129,13 @@ xfs_fs_sync_fs(
 	if (!wait)
 		return 0;
 
+	/*
+	 * Let queued inactivations finish so the freed space is visible,
+	 * unless the filesystem is frozen and they cannot make progress.
+	 */
+	if (sb->s_writers.frozen < SB_FREEZE_FS)
+		xfs_inactive_flush(mp);
+
 	xfs_log_force(mp, XFS_LOG_SYNC);
 	if (laptop_mode) {
 		/*
@@ -1859,7 +1894,7 @@ static struct file_system_type xfs_fs_type = {
 	.name			= "xfs",
 	.mount			= xfs_fs_mount,
 	.kill_sb		= kill_block_super,
-	.fs_flags		= FS_REQUIRES_DEV,
+	.fs_flags		= FS_REQUIRES_DEV | FS_SEEK_HOLE,
 };
 MODULE_ALIAS_FS("xfs");
 
@@ -175,6 +175,14 @@ struct shash_desc {
  * @descsize: Size of the operational state for the message digest. This state
  * 	      size is the memory size that needs to be allocated for
  *	      shash_desc.__ctx
+ * @finup_mb: **[optional]** Multi-buffer hashing support. Finish calculating
+ *	      the digests of multiple messages of the same length @len, each as
+ *	      if it had been passed to @finup with its own copy of the state in
+ *	      @desc. Interleaving the messages, e.g. one per SIMD lane, lets the
+ *	      implementation hash them faster than one after the other.
+ *	      @num_msgs is between 2 and @mb_max_msgs.
+ * @mb_max_msgs: If @finup_mb is set, the number of messages it can hash at
+ *		 once. Otherwise 1.
  * @base: internally used
  */
 struct shash_alg {
@@ -190,8 +198,12 @@ struct shash_alg {
 	int (*import)(struct shash_desc *desc, const void *in);
 	int (*setkey)(struct crypto_shash *tfm, const u8 *key,
 		      unsigned int keylen);
+	int (*finup_mb)(struct shash_desc *desc, const u8 * const data[],
+			unsigned int len, u8 * const outs[],
+			unsigned int num_msgs);
 
 	unsigned int descsize;
+	unsigned int mb_max_msgs;
 
 	/* These fields must match hash_alg_common. */
 	unsigned int digestsize
@@ -791,6 +803,18 @@ static inline unsigned int crypto_shash_statesize(struct crypto_shash *tfm)
 	return crypto_shash_alg(tfm)->statesize;
 }
 
+/**
+ * crypto_shash_mb_max_msgs() - obtain the multi-buffer batch size
+ * @tfm: cipher handle
+ *
+ * Return: how many messages crypto_shash_finup_mb() hashes together; 1 if the
+ *	   algorithm has no multi-buffer support
+ */
+static inline unsigned int crypto_shash_mb_max_msgs(struct crypto_shash *tfm)
+{
+	return crypto_shash_alg(tfm)->mb_max_msgs;
+}
+
 static inline u32 crypto_shash_get_flags(struct crypto_shash *tfm)
 {
 	return crypto_tfm_get_flags(crypto_shash_tfm(tfm));
@@ -967,6 +991,27 @@ int crypto_shash_final(struct shash_desc *desc, u8 *out);
 int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 		       unsigned int len, u8 *out);
 
+/**
+ * crypto_shash_finup_mb() - finish hashing several messages from one state
+ * @desc: operational state handle, on return it holds the state of the
+ *	  last message
+ * @data: the messages
+ * @len: length of each message in bytes
+ * @outs: output buffers for the message digests
+ * @num_msgs: number of messages
+ *
+ * Like calling crypto_shash_finup() on a copy of @desc for each message, e.g.
+ * to hash data blocks that share a salted prefix. Algorithms which can hash
+ * messages in parallel do so for up to crypto_shash_mb_max_msgs() of them;
+ * callers which have independent messages at hand should batch that many.
+ *
+ * Return: 0 if the message digest creation was successful; < 0 if an error
+ *	   occurred
+ */
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs);
+
 static inline void shash_desc_zero(struct shash_desc *desc)
 {
 	memzero_explicit(desc,
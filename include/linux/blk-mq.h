@@ -9,6 +9,18 @@
 struct blk_mq_tags;
 struct blk_flush_queue;
 
+/* blk-mq stages of a request, see blk_mq_account_stages() */
+enum {
+	BLK_MQ_STAGE_PLUG,
+	BLK_MQ_STAGE_SCHED,
+	BLK_MQ_STAGE_DISPATCH,
+	BLK_MQ_STAGE_DEVICE,
+	BLK_MQ_STAGE_NR,
+};
+
+/* log2 microsecond buckets, the last one holds everything above */
+#define BLK_MQ_STAGE_BUCKETS	20
+
 /**
  * struct blk_mq_hw_ctx - State for a hardware queue facing the hardware block device
  */
@@ -65,6 +77,8 @@ struct blk_mq_hw_ctx {
 	unsigned long		poll_invoked;
 	unsigned long		poll_success;
 
+	unsigned long		stage_time[BLK_MQ_STAGE_NR][BLK_MQ_STAGE_BUCKETS];
+
 #ifdef CONFIG_BLK_DEBUG_FS
 	struct dentry		*debugfs_dir;
 	struct dentry		*sched_debugfs_dir;
@@ -99,6 +113,7 @@ struct blk_mq_queue_data {
 
 typedef blk_status_t (queue_rq_fn)(struct blk_mq_hw_ctx *,
 		const struct blk_mq_queue_data *);
+typedef void (commit_rqs_fn)(struct blk_mq_hw_ctx *);
 typedef bool (get_budget_fn)(struct blk_mq_hw_ctx *);
 typedef void (put_budget_fn)(struct blk_mq_hw_ctx *);
 typedef enum blk_eh_timer_return (timeout_fn)(struct request *, bool);
@@ -122,6 +137,15 @@ struct blk_mq_ops {
 	 */
 	queue_rq_fn		*queue_rq;
 
+	/*
+	 * If a driver uses bd->last to judge when to submit requests to
+	 * hardware, it must define this function. In case of errors that
+	 * make us stop issuing further requests, this hook serves the
+	 * purpose of kicking the hardware (which the last request otherwise
+	 * would have done).
+	 */
+	commit_rqs_fn		*commit_rqs;
+
 	/*
 	 * Reserve budget before queue request, once .queue_rq is
 	 * run, it is driver's responsibility to release the
@@ -137,7 +161,10 @@ struct blk_mq_ops {
 	timeout_fn		*timeout;
 
 	/*
-	 * Called to poll for completion of a specific tag.
+	 * Called to poll for completion of a specific tag.  Returns the
+	 * number of requests completed, which may include other tags than
+	 * the one asked for, or a negative value if polling is not
+	 * possible.
 	 */
 	poll_fn			*poll;
 
@@ -258,6 +285,7 @@ int blk_mq_request_started(struct request *rq);
 void blk_mq_start_request(struct request *rq);
 void blk_mq_end_request(struct request *rq, blk_status_t error);
 void __blk_mq_end_request(struct request *rq, blk_status_t error);
+void blk_mq_end_request_batch(struct request **rqs, unsigned int nr);
 
 void blk_mq_requeue_request(struct request *rq, bool kick_requeue_list);
 void blk_mq_add_to_requeue_list(struct request *rq, bool at_head,
@@ -265,6 +293,7 @@ void blk_mq_add_to_requeue_list(struct request *rq, bool at_head,
 void blk_mq_kick_requeue_list(struct request_queue *q);
 void blk_mq_delay_kick_requeue_list(struct request_queue *q, unsigned long msecs);
 void blk_mq_complete_request(struct request *rq);
+bool blk_mq_complete_request_batch(struct request *rq);
 bool blk_mq_bio_list_merge(struct request_queue *q, struct list_head *list,
 			   struct bio *bio);
 bool blk_mq_queue_stopped(struct request_queue *q);
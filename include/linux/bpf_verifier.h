@@ -52,6 +52,9 @@ struct bpf_reg_state {
 		 */
 		struct bpf_map *map_ptr;
 
+		/* valid when type == PTR_TO_MEM | PTR_TO_MEM_OR_NULL */
+		u32 mem_size;
+
 		/* Max size from any of the above. */
 		unsigned long raw;
 	};
@@ -61,8 +64,9 @@ struct bpf_reg_state {
 	 * offset, so they can share range knowledge.
 	 * For PTR_TO_MAP_VALUE_OR_NULL this is used to share which map value we
 	 * came from, when one is tested for != NULL.
-	 * For PTR_TO_SOCKET this is used to share which pointers retain the
-	 * same reference to the socket, to determine proper reference freeing.
+	 * For PTR_TO_SOCKET and PTR_TO_MEM this is used to share which
+	 * pointers retain the same reference to the socket or memory, to
+	 * determine proper reference freeing.
 	 */
 	u32 id;
 	/* For scalar types (SCALAR_VALUE), this represents our knowledge of
@@ -146,6 +150,15 @@ struct bpf_func_state {
 struct bpf_verifier_state {
 	/* call stack tracking */
 	struct bpf_func_state *frame[MAX_CALL_FRAMES];
+	/* nearest explored state this one descends from */
+	struct bpf_verifier_state *parent;
+	/* number of paths descending from this explored state that are
+	 * still being verified; zero once all of them reached bpf_exit
+	 * or were pruned. Only a state with zero branches can be used
+	 * to prune others, and only one with non-zero branches can be
+	 * the head of a loop.
+	 */
+	u32 branches;
 	u32 curframe;
 };
 
@@ -164,6 +177,7 @@ struct bpf_verifier_state {
 struct bpf_verifier_state_list {
 	struct bpf_verifier_state state;
 	struct bpf_verifier_state_list *next;
+	u32 miss_cnt, hit_cnt;
 };
 
 struct bpf_insn_aux_data {
@@ -217,6 +231,7 @@ struct bpf_verifier_env {
 	bool strict_alignment;		/* perform strict pointer alignment checks */
 	struct bpf_verifier_state *cur_state; /* current verifier state */
 	struct bpf_verifier_state_list **explored_states; /* search pruning optimization */
+	struct bpf_verifier_state_list *free_list; /* evicted, may still be parents */
 	struct bpf_map *used_maps[MAX_USED_MAPS]; /* array of map's used by eBPF program */
 	u32 used_map_cnt;		/* number of used maps */
 	u32 id_gen;			/* used to generate unique reg IDs */
@@ -226,6 +241,9 @@ struct bpf_verifier_env {
 	struct bpf_verifier_log log;
 	struct bpf_subprog_info subprog_info[BPF_MAX_SUBPROGS + 1];
 	u32 subprog_cnt;
+	u32 insn_processed;		/* insns walked by do_check() */
+	u32 jmps_processed;		/* jmps walked by do_check() */
+	u32 prev_insn_processed, prev_jmps_processed; /* at last new state */
 };
 
 __printf(2, 0) void bpf_verifier_vlog(struct bpf_verifier_log *log,
@@ -888,6 +888,9 @@ asmlinkage long compat_sys_clock_adjtime(clockid_t which_clock,
 					 struct compat_timex __user *tp);
 asmlinkage long compat_sys_sendmmsg(int fd, struct compat_mmsghdr __user *mmsg,
 				    unsigned vlen, unsigned int flags);
+asmlinkage long compat_sys_process_madvise(int pidfd,
+		const struct compat_iovec __user *vec, compat_ulong_t vlen,
+		int behavior, unsigned int flags);
 asmlinkage ssize_t compat_sys_process_vm_readv(compat_pid_t pid,
 		const struct compat_iovec __user *lvec,
 		compat_ulong_t liovcnt, const struct compat_iovec __user *rvec,
@@ -64,7 +64,8 @@ struct dentry_stat_t {
 	long nr_unused;
 	long age_limit;          /* age in seconds */
 	long want_pages;         /* pages requested by system */
-	long dummy[2];
+	long nr_negative;        /* # of unused negative dentries */
+	long dummy;              /* Reserved for future use */
 };
 extern struct dentry_stat_t dentry_stat;
 
@@ -20,6 +20,7 @@
 #include <linux/set_memory.h>
 #include <linux/kallsyms.h>
 #include <linux/if_vlan.h>
+#include <linux/bpf.h>
 
 #include <net/sch_generic.h>
 
@@ -626,6 +627,8 @@ static inline u32 bpf_prog_run_clear_cb(const struct bpf_prog *prog,
 	return BPF_PROG_RUN(prog, skb);
 }
 
+DECLARE_BPF_DISPATCHER(xdp)
+
 static __always_inline u32 bpf_prog_run_xdp(const struct bpf_prog *prog,
 					    struct xdp_buff *xdp)
 {
@@ -635,9 +638,15 @@ static __always_inline u32 bpf_prog_run_xdp(const struct bpf_prog *prog,
 	 * already takes rcu_read_lock() when fetching the program, so
 	 * it's not necessary here anymore.
 	 */
+#ifdef CONFIG_DYNAMIC_FTRACE_WITH_DIRECT_CALLS
+	return BPF_DISPATCHER_FUNC(xdp)(xdp, prog->insnsi, prog->bpf_func);
+#else
 	return BPF_PROG_RUN(prog, xdp);
+#endif
 }
 
+void bpf_prog_change_xdp(struct bpf_prog *prev_prog, struct bpf_prog *prog);
+
 static inline u32 bpf_prog_insn_size(const struct bpf_prog *prog)
 {
 	return prog->len * sizeof(struct bpf_insn);
@@ -843,6 +852,8 @@ void xdp_do_flush_map(void);
 
 void bpf_warn_invalid_xdp_action(u32 act);
 
+const struct bpf_func_proto *bpf_base_func_proto(enum bpf_func_id func_id);
+
 #ifdef CONFIG_INET
 struct sock *bpf_run_sk_reuseport(struct sock_reuseport *reuse, struct sock *sk,
 				  struct bpf_prog *prog, struct sk_buff *skb,
@@ -857,6 +868,59 @@ bpf_run_sk_reuseport(struct sock_reuseport *reuse, struct sock *sk,
 }
 #endif
 
+struct bpf_sk_lookup_kern {
+	struct net	*net;
+	u16		family;
+	u16		protocol;
+	__be16		sport;
+	u16		dport;
+	struct {
+		__be32 saddr;
+		__be32 daddr;
+	} v4;
+	struct {
+		struct in6_addr saddr;
+		struct in6_addr daddr;
+	} v6;
+	struct sock	*selected_sk;
+};
+
+#ifdef CONFIG_INET
+extern struct static_key_false bpf_sk_lookup_enabled;
+
+struct sock *bpf_run_sk_lookup(struct bpf_sk_lookup_kern *ctx);
+int sk_lookup_bpf_prog_attach(const union bpf_attr *attr,
+			      struct bpf_prog *prog);
+int sk_lookup_bpf_prog_detach(const union bpf_attr *attr);
+#else
+static inline int sk_lookup_bpf_prog_attach(const union bpf_attr *attr,
+					    struct bpf_prog *prog)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline int sk_lookup_bpf_prog_detach(const union bpf_attr *attr)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
+#ifdef CONFIG_RPS
+int rps_bpf_prog_attach(const union bpf_attr *attr, struct bpf_prog *prog);
+int rps_bpf_prog_detach(const union bpf_attr *attr);
+#else
+static inline int rps_bpf_prog_attach(const union bpf_attr *attr,
+				      struct bpf_prog *prog)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline int rps_bpf_prog_detach(const union bpf_attr *attr)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
 #ifdef CONFIG_BPF_JIT
 extern int bpf_jit_enable;
 extern int bpf_jit_harden;
@@ -16,6 +16,12 @@ struct frontswap_ops {
 	struct frontswap_ops *next; /* private pointer to next ops */
 };
 
+/*
+ * Returned by ->store() when the page was accepted but is stored later:
+ * the backend has put the page under writeback and ends it once done.
+ */
+#define FRONTSWAP_STORE_ASYNC	1
+
 extern void frontswap_register_ops(struct frontswap_ops *ops);
 extern void frontswap_shrink(unsigned long);
 extern unsigned long frontswap_curr_pages(void);
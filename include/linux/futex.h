@@ -53,6 +53,11 @@ union futex_key {
 #ifdef CONFIG_FUTEX
 extern void exit_robust_list(struct task_struct *curr);
 
+extern int sysctl_futex_private_hash;
+extern void futex_mm_init(struct mm_struct *mm);
+extern void futex_hash_alloc(struct mm_struct *mm);
+extern void futex_hash_free(struct mm_struct *mm);
+
 long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 	      u32 __user *uaddr2, u32 val2, u32 val3);
 #ifdef CONFIG_HAVE_FUTEX_CMPXCHG
@@ -65,6 +70,18 @@ static inline void exit_robust_list(struct task_struct *curr)
 {
 }
 
+static inline void futex_mm_init(struct mm_struct *mm)
+{
+}
+
+static inline void futex_hash_alloc(struct mm_struct *mm)
+{
+}
+
+static inline void futex_hash_free(struct mm_struct *mm)
+{
+}
+
 static inline long do_futex(u32 __user *uaddr, int op, u32 val,
 			    ktime_t *timeout, u32 __user *uaddr2,
 			    u32 val2, u32 val3)
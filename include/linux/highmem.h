@@ -191,6 +191,18 @@ static inline void clear_highpage(struct page *page)
 	kunmap_atomic(kaddr);
 }
 
+/* Clear a page without pulling it into the cache, where supported */
+static inline void clear_highpage_nocache(struct page *page)
+{
+#ifdef __HAVE_ARCH_CLEAR_PAGE_NOCACHE
+	void *kaddr = kmap_atomic(page);
+	clear_page_nocache(kaddr);
+	kunmap_atomic(kaddr);
+#else
+	clear_highpage(page);
+#endif
+}
+
 static inline void zero_user_segments(struct page *page,
 	unsigned start1, unsigned end1,
 	unsigned start2, unsigned end2)
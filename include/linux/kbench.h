@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_KBENCH_H
+#define _LINUX_KBENCH_H
+
+#include <linux/list.h>
+
+struct dentry;
+
+/**
+ * struct kbench_case - a registered microbenchmark
+ * @name:	name of the case, also its file in debugfs kbench/
+ * @setup:	optional, called once before a run on the benchmark CPU
+ * @run:	the measured body, has to do @iters operations
+ * @teardown:	optional, called once after a run
+ * @priv:	for use by the case
+ *
+ * A run is @warmup samples that are thrown away followed by @samples
+ * timed calls of @run, which may sleep.  Results are per operation.
+ */
+struct kbench_case {
+	const char *name;
+	int (*setup)(struct kbench_case *kc);
+	void (*run)(struct kbench_case *kc, unsigned long iters);
+	void (*teardown)(struct kbench_case *kc);
+	void *priv;
+
+	/* private: */
+	struct list_head list;
+	struct dentry *dentry;
+};
+
+#ifdef CONFIG_KBENCH
+int kbench_register(struct kbench_case *kc);
+void kbench_unregister(struct kbench_case *kc);
+#else
+static inline int kbench_register(struct kbench_case *kc)
+{
+	return 0;
+}
+
+static inline void kbench_unregister(struct kbench_case *kc)
+{
+}
+#endif
+
+#endif /* _LINUX_KBENCH_H */
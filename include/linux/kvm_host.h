@@ -34,6 +34,7 @@
 #include <linux/kvm_para.h>
 
 #include <linux/kvm_types.h>
+#include <linux/kvm_dirty_ring.h>
 
 #include <asm/kvm_host.h>
 
@@ -215,6 +216,13 @@ struct kvm_mmio_fragment {
 	unsigned len;
 };
 
+/*
+ * Bucket i of the halt histogram counts blocks shorter than
+ * KVM_HALT_HIST_BOUND(i) (2us, 4us, ...); the last one takes the rest.
+ */
+#define KVM_HALT_HIST_BUCKETS	16
+#define KVM_HALT_HIST_BOUND(i)	(2048ULL << (i))
+
 struct kvm_vcpu {
 	struct kvm *kvm;
 #ifdef CONFIG_PREEMPT_NOTIFIERS
@@ -241,6 +249,14 @@ struct kvm_vcpu {
 	struct kvm_vcpu_stat stat;
 	unsigned int halt_poll_ns;
 	bool valid_wakeup;
+	/* index of the memslot found last, vcpus do not share slots->lru_slot */
+	atomic_t last_used_slot;
+	/* recent block times, see kvm_vcpu_update_halt_poll() */
+	struct {
+		u16 count[KVM_HALT_HIST_BUCKETS];
+		u8 samples;
+		u8 contended;
+	} halt_hist;
 
 #ifdef CONFIG_HAS_IOMEM
 	int mmio_needed;
@@ -275,6 +291,7 @@ struct kvm_vcpu {
 	bool preempted;
 	struct kvm_vcpu_arch arch;
 	struct dentry *debugfs_dentry;
+	struct kvm_dirty_ring dirty_ring;
 };
 
 static inline int kvm_vcpu_exiting_guest_mode(struct kvm_vcpu *vcpu)
@@ -302,6 +319,7 @@ struct kvm_memory_slot {
 	unsigned long userspace_addr;
 	u32 flags;
 	short id;
+	u16 as_id;
 };
 
 static inline unsigned long kvm_dirty_bitmap_bytes(struct kvm_memory_slot *memslot)
@@ -399,6 +417,12 @@ struct kvm {
 	struct mutex slots_lock;
 	struct mm_struct *mm; /* userspace tied to this vm */
 	struct kvm_memslots __rcu *memslots[KVM_ADDRESS_SPACE_NUM];
+	/*
+	 * The copy of memslots[] not in use, kept up to date so that an
+	 * update only has to be applied to it rather than to a fresh copy
+	 * of the whole array.  Protected by slots_lock.
+	 */
+	struct kvm_memslots *memslots_spare[KVM_ADDRESS_SPACE_NUM];
 	struct kvm_vcpu *vcpus[KVM_MAX_VCPUS];
 
 	/*
@@ -454,8 +478,24 @@ struct kvm {
 	struct srcu_struct srcu;
 	struct srcu_struct irq_srcu;
 	pid_t userspace_pid;
+	/* bytes of each vcpu dirty ring, zero when the bitmap is in use */
+	u32 dirty_ring_size;
+	/* set through KVM_CAP_HALT_POLL, in place of halt_poll_ns */
+	bool override_halt_poll_ns;
+	unsigned int max_halt_poll_ns;
 };
 
+static inline bool kvm_page_in_dirty_ring(struct kvm *kvm, unsigned long pgoff)
+{
+#ifdef CONFIG_HAVE_KVM_DIRTY_RING
+	return (pgoff >= KVM_DIRTY_LOG_PAGE_OFFSET) &&
+	       (pgoff < KVM_DIRTY_LOG_PAGE_OFFSET +
+		kvm->dirty_ring_size / PAGE_SIZE);
+#else
+	return false;
+#endif
+}
+
 #define kvm_err(fmt, ...) \
 	pr_err("kvm [%i]: " fmt, task_pid_nr(current), ## __VA_ARGS__)
 #define kvm_info(fmt, ...) \
@@ -942,10 +982,10 @@ void kvm_free_irq_source_id(struct kvm *kvm, int irq_source_id);
  * bloat other code too much.
  */
 static inline struct kvm_memory_slot *
-search_memslots(struct kvm_memslots *slots, gfn_t gfn)
+__search_memslots(struct kvm_memslots *slots, gfn_t gfn, atomic_t *lru_slot)
 {
 	int start = 0, end = slots->used_slots;
-	int slot = atomic_read(&slots->lru_slot);
+	int slot = atomic_read(lru_slot);
 	struct kvm_memory_slot *memslots = slots->memslots;
 
 	if (gfn >= memslots[slot].base_gfn &&
@@ -963,13 +1003,21 @@ search_memslots(struct kvm_memslots *slots, gfn_t gfn)
 
 	if (gfn >= memslots[start].base_gfn &&
 	    gfn < memslots[start].base_gfn + memslots[start].npages) {
-		atomic_set(&slots->lru_slot, start);
+		/* the hint is shared, do not dirty its cache line for nothing */
+		if (atomic_read(lru_slot) != start)
+			atomic_set(lru_slot, start);
 		return &memslots[start];
 	}
 
 	return NULL;
 }
 
+static inline struct kvm_memory_slot *
+search_memslots(struct kvm_memslots *slots, gfn_t gfn)
+{
+	return __search_memslots(slots, gfn, &slots->lru_slot);
+}
+
 static inline struct kvm_memory_slot *
 __gfn_to_memslot(struct kvm_memslots *slots, gfn_t gfn)
 {
@@ -1175,6 +1223,7 @@ extern bool kvm_rebooting;
 extern unsigned int halt_poll_ns;
 extern unsigned int halt_poll_ns_grow;
 extern unsigned int halt_poll_ns_shrink;
+extern unsigned int halt_poll_ns_cover;
 
 struct kvm_device {
 	struct kvm_device_ops *ops;
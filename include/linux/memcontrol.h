@@ -30,6 +30,7 @@
 #include <linux/vmstat.h>
 #include <linux/writeback.h>
 #include <linux/page-flags.h>
+#include <linux/percpu-refcount.h>
 
 struct mem_cgroup;
 struct page;
@@ -188,6 +189,22 @@ struct memcg_padding {
 #define MEMCG_PADDING(name)
 #endif
 
+/*
+ * Slab objects are charged through an obj_cgroup rather than directly to
+ * the memcg. When the memcg goes offline, its obj_cgroup is switched over
+ * to the parent, so objects outliving the cgroup do not pin it.
+ */
+struct obj_cgroup {
+	struct percpu_ref refcnt;
+	struct mem_cgroup *memcg;
+	/* sub-page remainder of the charges */
+	atomic_t nr_charged_bytes;
+	/* sub-page remainder of the slab vmstats */
+	atomic_t nr_slab_bytes[2];
+	struct list_head list;
+	struct rcu_head rcu;
+};
+
 /*
  * The memory controller data structure. The memory controller controls both
  * page cache and RSS per cgroup. We would eventually like to provide
@@ -215,6 +232,11 @@ struct mem_cgroup {
 	/* Range enforcement for interrupt charges */
 	struct work_struct high_work;
 
+	/* Background reclaim down to high_async_ratio percent of high */
+	unsigned int high_async_ratio;
+	unsigned long high_async;
+	struct work_struct high_async_work;
+
 	unsigned long soft_limit;
 
 	/* vmpressure notifications */
@@ -278,8 +300,15 @@ struct mem_cgroup {
 
 	MEMCG_PADDING(_pad2_);
 
+	/*
+	 * Per-cpu batches are folded into the local counters and into the
+	 * hierarchical ones of every ancestor, so reads never have to walk
+	 * the subtree.
+	 */
 	atomic_long_t		stat[MEMCG_NR_STAT];
+	atomic_long_t		stat_local[MEMCG_NR_STAT];
 	atomic_long_t		events[NR_VM_EVENT_ITEMS];
+	atomic_long_t		events_local[NR_VM_EVENT_ITEMS];
 	atomic_long_t memory_events[MEMCG_NR_MEMORY_EVENTS];
 
 	unsigned long		socket_pressure;
@@ -293,6 +322,9 @@ struct mem_cgroup {
 	int kmemcg_id;
 	enum memcg_kmem_state kmem_state;
 	struct list_head kmem_caches;
+	struct obj_cgroup __rcu *objcg;
+	/* reparented obj_cgroups now charging this memcg */
+	struct list_head objcg_list;
 #endif
 
 	int last_scanned_node;
@@ -559,7 +591,10 @@ struct mem_cgroup *lock_page_memcg(struct page *page);
 void __unlock_page_memcg(struct mem_cgroup *memcg);
 void unlock_page_memcg(struct page *page);
 
-/* idx can be of type enum memcg_stat_item or node_stat_item */
+/*
+ * idx can be of type enum memcg_stat_item or node_stat_item.
+ * Includes the descendants of @memcg.
+ */
 static inline unsigned long memcg_page_state(struct mem_cgroup *memcg,
 					     int idx)
 {
@@ -571,6 +606,44 @@ static inline unsigned long memcg_page_state(struct mem_cgroup *memcg,
 	return x;
 }
 
+/*
+ * idx can be of type enum memcg_stat_item or node_stat_item.
+ * Only counts pages of @memcg itself.
+ */
+static inline unsigned long memcg_page_state_local(struct mem_cgroup *memcg,
+						   int idx)
+{
+	long x = atomic_long_read(&memcg->stat_local[idx]);
+#ifdef CONFIG_SMP
+	if (x < 0)
+		x = 0;
+#endif
+	return x;
+}
+
+/*
+ * Hierarchical counters go up the accounting parents.  In legacy
+ * no-hierarchy mode that chain ends below the root, whose counters still
+ * cover the whole tree, so the root is added at the end of it.
+ */
+static inline struct mem_cgroup *memcg_stat_parent(struct mem_cgroup *memcg)
+{
+	struct mem_cgroup *parent = parent_mem_cgroup(memcg);
+
+	if (!parent && !mem_cgroup_is_root(memcg))
+		parent = root_mem_cgroup;
+	return parent;
+}
+
+static inline void __memcg_flush_state(struct mem_cgroup *memcg,
+				       int idx, long x)
+{
+	atomic_long_add(x, &memcg->stat_local[idx]);
+	do {
+		atomic_long_add(x, &memcg->stat[idx]);
+	} while ((memcg = memcg_stat_parent(memcg)));
+}
+
 /* idx can be of type enum memcg_stat_item or node_stat_item */
 static inline void __mod_memcg_state(struct mem_cgroup *memcg,
 				     int idx, int val)
@@ -582,7 +655,7 @@ static inline void __mod_memcg_state(struct mem_cgroup *memcg,
 
 	x = val + __this_cpu_read(memcg->stat_cpu->count[idx]);
 	if (unlikely(abs(x) > MEMCG_CHARGE_BATCH)) {
-		atomic_long_add(x, &memcg->stat[idx]);
+		__memcg_flush_state(memcg, idx, x);
 		x = 0;
 	}
 	__this_cpu_write(memcg->stat_cpu->count[idx], x);
@@ -714,6 +787,16 @@ unsigned long mem_cgroup_soft_limit_reclaim(pg_data_t *pgdat, int order,
 						gfp_t gfp_mask,
 						unsigned long *total_scanned);
 
+static inline void __memcg_flush_events(struct mem_cgroup *memcg,
+					enum vm_event_item idx,
+					unsigned long x)
+{
+	atomic_long_add(x, &memcg->events_local[idx]);
+	do {
+		atomic_long_add(x, &memcg->events[idx]);
+	} while ((memcg = memcg_stat_parent(memcg)));
+}
+
 static inline void __count_memcg_events(struct mem_cgroup *memcg,
 					enum vm_event_item idx,
 					unsigned long count)
@@ -725,7 +808,7 @@ static inline void __count_memcg_events(struct mem_cgroup *memcg,
 
 	x = count + __this_cpu_read(memcg->stat_cpu->events[idx]);
 	if (unlikely(x > MEMCG_CHARGE_BATCH)) {
-		atomic_long_add(x, &memcg->events[idx]);
+		__memcg_flush_events(memcg, idx, x);
 		x = 0;
 	}
 	__this_cpu_write(memcg->stat_cpu->events[idx], x);
@@ -1025,6 +1108,12 @@ static inline unsigned long memcg_page_state(struct mem_cgroup *memcg,
 	return 0;
 }
 
+static inline unsigned long memcg_page_state_local(struct mem_cgroup *memcg,
+						   int idx)
+{
+	return 0;
+}
+
 static inline void __mod_memcg_state(struct mem_cgroup *memcg,
 				     int idx,
 				     int nr)
@@ -1272,6 +1361,44 @@ int memcg_kmem_charge_memcg(struct page *page, gfp_t gfp, int order,
 #ifdef CONFIG_MEMCG_KMEM
 int memcg_kmem_charge(struct page *page, gfp_t gfp, int order);
 void memcg_kmem_uncharge(struct page *page, int order);
+struct obj_cgroup *get_obj_cgroup_from_current(void);
+int memcg_kmem_charge_obj(struct obj_cgroup *objcg, gfp_t gfp, size_t size);
+void memcg_kmem_uncharge_obj(struct obj_cgroup *objcg, size_t size);
+void mod_objcg_slab_state(struct obj_cgroup *objcg, enum node_stat_item idx,
+			  int nr_bytes);
+struct mem_cgroup *mem_cgroup_from_obj(void *p);
+
+static inline void obj_cgroup_get(struct obj_cgroup *objcg)
+{
+	percpu_ref_get(&objcg->refcnt);
+}
+
+static inline void obj_cgroup_put(struct obj_cgroup *objcg)
+{
+	percpu_ref_put(&objcg->refcnt);
+}
+
+/* Must be called under rcu_read_lock(), the memcg changes on reparenting */
+static inline struct mem_cgroup *obj_cgroup_memcg(struct obj_cgroup *objcg)
+{
+	return READ_ONCE(objcg->memcg);
+}
+
+/*
+ * SLUB charges accounted objects one by one rather than by the page. A
+ * slab page holding such objects has page->mem_cgroup pointing at a vector
+ * with the obj_cgroup of each object, tagged with MEMCG_OBJ_VEC.
+ */
+#define MEMCG_OBJ_VEC	0x1UL
+
+static inline struct obj_cgroup **page_objcg_vec(struct page *page)
+{
+	unsigned long memcg = (unsigned long)READ_ONCE(page->mem_cgroup);
+
+	if (!(memcg & MEMCG_OBJ_VEC))
+		return NULL;
+	return (struct obj_cgroup **)(memcg & ~MEMCG_OBJ_VEC);
+}
 
 extern struct static_key_false memcg_kmem_enabled_key;
 extern struct workqueue_struct *memcg_kmem_cache_wq;
@@ -1318,6 +1445,16 @@ static inline void memcg_kmem_uncharge(struct page *page, int order)
 {
 }
 
+static inline struct mem_cgroup *mem_cgroup_from_obj(void *p)
+{
+	return NULL;
+}
+
+static inline struct obj_cgroup **page_objcg_vec(struct page *page)
+{
+	return NULL;
+}
+
 #define for_each_memcg_cache_index(_idx)	\
 	for (; NULL; )
 
@@ -1478,10 +1478,14 @@ long get_user_pages_locked(unsigned long start, unsigned long nr_pages,
 		    unsigned int gup_flags, struct page **pages, int *locked);
 long get_user_pages_unlocked(unsigned long start, unsigned long nr_pages,
 		    struct page **pages, unsigned int gup_flags);
+int get_user_pages_fast(unsigned long start, int nr_pages, int write,
+			struct page **pages);
 #ifdef CONFIG_FS_DAX
 long get_user_pages_longterm(unsigned long start, unsigned long nr_pages,
 			    unsigned int gup_flags, struct page **pages,
 			    struct vm_area_struct **vmas);
+long get_user_pages_fast_longterm(unsigned long start, unsigned long nr_pages,
+			    unsigned int gup_flags, struct page **pages);
 #else
 static inline long get_user_pages_longterm(unsigned long start,
 		unsigned long nr_pages, unsigned int gup_flags,
@@ -1489,10 +1493,15 @@ static inline long get_user_pages_longterm(unsigned long start,
 {
 	return get_user_pages(start, nr_pages, gup_flags, pages, vmas);
 }
-#endif /* CONFIG_FS_DAX */
 
-int get_user_pages_fast(unsigned long start, int nr_pages, int write,
-			struct page **pages);
+static inline long get_user_pages_fast_longterm(unsigned long start,
+		unsigned long nr_pages, unsigned int gup_flags,
+		struct page **pages)
+{
+	return get_user_pages_fast(start, nr_pages, gup_flags & FOLL_WRITE,
+				   pages);
+}
+#endif /* CONFIG_FS_DAX */
 
 /* Container for pinned pfns / pages */
 struct frame_vector {
@@ -1588,9 +1597,17 @@ extern unsigned long move_page_tables(struct vm_area_struct *vma,
 		unsigned long old_addr, struct vm_area_struct *new_vma,
 		unsigned long new_addr, unsigned long len,
 		bool need_rmap_locks);
+
+/* Flags for change_protection() */
+#define MM_CP_DIRTY_ACCT	(1UL << 0) /* write dirty writenotify ptes */
+#define MM_CP_PROT_NUMA		(1UL << 1) /* arm NUMA hinting faults */
+#define MM_CP_UFFD_WP		(1UL << 2) /* userfaultfd write protect */
+#define MM_CP_UFFD_WP_RESOLVE	(1UL << 3) /* userfaultfd unprotect */
+#define MM_CP_UFFD_WP_ALL	(MM_CP_UFFD_WP | MM_CP_UFFD_WP_RESOLVE)
+
 extern unsigned long change_protection(struct vm_area_struct *vma, unsigned long start,
 			      unsigned long end, pgprot_t newprot,
-			      int dirty_accountable, int prot_numa);
+			      unsigned long cp_flags);
 extern int mprotect_fixup(struct vm_area_struct *vma,
 			  struct vm_area_struct **pprev, unsigned long start,
 			  unsigned long end, unsigned long newflags);
@@ -2741,6 +2758,8 @@ enum mf_action_page_type {
 extern void clear_huge_page(struct page *page,
 			    unsigned long addr_hint,
 			    unsigned int pages_per_huge_page);
+extern void clear_huge_page_nocache(struct page *page,
+				    unsigned int pages_per_huge_page);
 extern void copy_user_huge_page(struct page *dst, struct page *src,
 				unsigned long addr_hint,
 				struct vm_area_struct *vma,
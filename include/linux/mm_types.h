@@ -95,6 +95,15 @@ struct page {
 			 */
 			unsigned long private;
 		};
+		struct {	/* page_pool used by netstack */
+			/**
+			 * @pp_magic: magic value to avoid recycling non
+			 * page_pool allocated pages.
+			 */
+			unsigned long pp_magic;
+			/* DMA address is kept in page->private */
+			struct page_pool *pp;
+		};
 		struct {	/* slab, slob and slub */
 			union {
 				struct list_head slab_list;	/* uses lru */
@@ -432,6 +441,11 @@ struct mm_struct {
 		unsigned long flags; /* Must use atomic bitops to access */
 
 		struct core_state *core_state; /* coredumping support */
+#ifdef CONFIG_FUTEX
+		/* private futex hash, NULL means use the global one */
+		struct futex_hash_bucket	*futex_queues;
+		unsigned long			futex_hashsize;
+#endif
 #ifdef CONFIG_MEMBARRIER
 		atomic_t membarrier_state;
 #endif
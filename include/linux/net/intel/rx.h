@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2018 Intel Corporation. */
+
+#ifndef _LINUX_NET_INTEL_RX_H
+#define _LINUX_NET_INTEL_RX_H
+
+#include <linux/mm.h>
+#include <linux/page_ref.h>
+#include <linux/prefetch.h>
+#include <linux/skbuff.h>
+
+/*
+ * Rx buffer helpers shared by the Intel Ethernet drivers, which all use
+ * the same scheme: a page (or two halves of it) is handed to the stack
+ * and flipped back to the hardware once the stack is done with it, and
+ * a bias of page references is kept by the driver so that handing out
+ * a buffer does not need an atomic operation.
+ */
+
+/* largest buffer that fits in the rest of a page, for PAGE_SIZE >= 8192 */
+#define INTEL_RX_LAST_OFFSET	(SKB_WITH_OVERHEAD(PAGE_SIZE) - 2048)
+
+/**
+ * intel_rx_page_is_reusable - check if any reuse is possible
+ * @page: page struct to check
+ *
+ * A page is not reusable if it was allocated under low memory
+ * conditions, or it's not in the same NUMA node as this CPU.
+ */
+static inline bool intel_rx_page_is_reusable(struct page *page)
+{
+	return (page_to_nid(page) == numa_mem_id()) &&
+		!page_is_pfmemalloc(page);
+}
+
+/**
+ * intel_rx_page_init_bias - charge the driver's references on a new page
+ * @page: freshly allocated page
+ * @pagecnt_bias: the Rx buffer's bias
+ *
+ * The references are taken up front, with a single atomic operation,
+ * and given out one buffer at a time by decrementing @pagecnt_bias.
+ */
+static inline void intel_rx_page_init_bias(struct page *page, u16 *pagecnt_bias)
+{
+	page_ref_add(page, USHRT_MAX - 1);
+	*pagecnt_bias = USHRT_MAX;
+}
+
+/**
+ * intel_rx_can_reuse_page - Determine if a page can be reused by the
+ * adapter for another receive
+ * @page: the Rx buffer's page
+ * @pagecnt_bias: the Rx buffer's bias
+ * @page_offset: offset of the next buffer in @page
+ *
+ * For small pages we alternate between the low and high halves of the
+ * page.  The page can be reused if the stack has released the half it
+ * got with the previous packet, i.e. if we hold all other references.
+ *
+ * For larger pages we advance through the page by the space actually
+ * consumed, as long as there is room for another buffer.
+ *
+ * If the page is reusable and the bias has run down, the bias and the
+ * page's references are topped up again.
+ */
+static inline bool intel_rx_can_reuse_page(struct page *page,
+					   u16 *pagecnt_bias,
+					   unsigned int page_offset)
+{
+	unsigned int bias = *pagecnt_bias;
+
+	/* Is any reuse possible? */
+	if (unlikely(!intel_rx_page_is_reusable(page)))
+		return false;
+
+#if (PAGE_SIZE < 8192)
+	/* if we are only owner of page we can reuse it */
+	if (unlikely((page_ref_count(page) - bias) > 1))
+		return false;
+#else
+	if (page_offset > INTEL_RX_LAST_OFFSET)
+		return false;
+#endif
+
+	/* If we have drained the page fragment pool we need to update
+	 * the pagecnt_bias and page count so that we fully restock the
+	 * number of references the driver holds.
+	 */
+	if (unlikely(bias == 1))
+		intel_rx_page_init_bias(page, pagecnt_bias);
+
+	return true;
+}
+
+/**
+ * intel_rx_prefetch - prefetch the packet headers of a receive buffer
+ * @va: start of the headers
+ *
+ * Headers of up to 128 bytes are fetched, which takes two cache lines on
+ * most platforms.
+ */
+static inline void intel_rx_prefetch(void *va)
+{
+	prefetch(va);
+#if L1_CACHE_BYTES < 128
+	prefetch(va + L1_CACHE_BYTES);
+#endif
+}
+
+#endif /* _LINUX_NET_INTEL_RX_H */
@@ -27,6 +27,7 @@
 #include <linux/timer.h>
 #include <linux/notifier.h>
 #include <linux/kobject.h>
+#include <linux/init.h>
 
 #define PADATA_CPU_SERIAL   0x01
 #define PADATA_CPU_PARALLEL 0x02
@@ -168,6 +169,37 @@ struct padata_instance {
 #define	PADATA_INVALID	4
 };
 
+/**
+ * struct padata_mt_job - one job split across several threads
+ *
+ * @thread_fn: called on each chunk [start, end) of the job.
+ * @fn_arg: argument of @thread_fn.
+ * @start: start of the job, in units of the job.
+ * @size: size of the job, in units of the job.
+ * @align: chunks start on this boundary, except possibly the first one.
+ * @min_chunk: smallest amount of work worth giving to a thread.
+ * @max_threads: upper bound on the number of threads, the caller included.
+ * @nid: node whose CPUs run the helper threads, or NUMA_NO_NODE for any.
+ */
+struct padata_mt_job {
+	void (*thread_fn)(unsigned long start, unsigned long end, void *arg);
+	void			*fn_arg;
+	unsigned long		start;
+	unsigned long		size;
+	unsigned long		align;
+	unsigned long		min_chunk;
+	int			max_threads;
+	int			nid;
+};
+
+#ifdef CONFIG_PADATA
+extern void padata_do_multithreaded(struct padata_mt_job *job);
+#else
+static inline void padata_do_multithreaded(struct padata_mt_job *job)
+{
+	job->thread_fn(job->start, job->start + job->size, job->fn_arg);
+}
+#endif
 extern struct padata_instance *padata_alloc_possible(
 					struct workqueue_struct *wq);
 extern void padata_free(struct padata_instance *pinst);
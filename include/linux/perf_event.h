@@ -786,6 +786,14 @@ struct perf_cpu_context {
 	struct list_head		cgrp_cpuctx_entry;
 #endif
 
+	/*
+	 * Iterators for visit_groups_merge(): one for the events without a
+	 * cgroup and one per level of the deepest cgroup with an event.
+	 */
+	int				heap_size;
+	struct perf_event		**heap;
+	struct perf_event		*heap_default[2];
+
 	struct list_head		sched_cb_entry;
 	int				sched_cb_usage;
 
@@ -13,6 +13,7 @@
 #define SCHED_PROFILING	2
 #define SLEEP_PROFILING	3
 #define KVM_PROFILING	4
+#define STACK_PROFILING	5
 
 struct proc_dir_entry;
 struct pt_regs;
@@ -3,6 +3,8 @@
 
 #include <linux/seqlock.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
 
 #ifdef CONFIG_PSI
 
@@ -44,6 +46,23 @@ enum psi_states {
 	NR_PSI_STATES,
 };
 
+/* Consumers of the per-cpu time buckets, each with its own snapshot */
+enum psi_aggregators {
+	PSI_AVGS = 0,
+	PSI_POLL,
+	NR_PSI_AGGREGATORS,
+};
+
+/* Scheduling latency histograms */
+enum psi_lat {
+	PSI_LAT_RUNQ,		/* time runnable before getting the CPU */
+	PSI_LAT_WAKEUP,		/* the same, for arrivals after a wakeup */
+	NR_PSI_LAT,
+};
+
+/* Log2 buckets in usecs: <1, [1,2), [2,4), ... [8192,16384), >=16384 */
+#define NR_PSI_LAT_BUCKETS	16
+
 struct psi_group_cpu {
 	/* 1st cacheline updated by the scheduler */
 
@@ -59,10 +78,58 @@ struct psi_group_cpu {
 	/* Time of last task change in this group (rq_clock) */
 	u64 state_start;
 
-	/* 2nd cacheline updated by the aggregator */
+	/* Latency histograms, also bumped by the scheduler on arrival */
+	unsigned long lat[NR_PSI_LAT][NR_PSI_LAT_BUCKETS];
+
+	/* 2nd cacheline updated by the aggregators */
 
 	/* Delta detection against the sampling buckets */
-	u32 times_prev[NR_PSI_STATES] ____cacheline_aligned_in_smp;
+	u32 times_prev[NR_PSI_AGGREGATORS][NR_PSI_STATES]
+			____cacheline_aligned_in_smp;
+};
+
+/* PSI growth tracking window */
+struct psi_window {
+	/* Window size in ns */
+	u64 size;
+
+	/* Start time of the current window in ns */
+	u64 start_time;
+
+	/* Value at the start of the window */
+	u64 start_value;
+
+	/* Value growth in the previous window */
+	u64 prev_growth;
+};
+
+struct psi_trigger {
+	/* PSI state being monitored by the trigger */
+	enum psi_states state;
+
+	/* User-specified threshold in ns */
+	u64 threshold;
+
+	/* List node inside triggers list */
+	struct list_head node;
+
+	/* Backpointer needed during trigger destruction */
+	struct psi_group *group;
+
+	/* Wait queue for polling */
+	wait_queue_head_t event_wait;
+
+	/* Pending event flag */
+	int event;
+
+	/* Tracking window */
+	struct psi_window win;
+
+	/*
+	 * Time last event was generated. Used for rate-limiting
+	 * events to one per window
+	 */
+	u64 last_event_time;
 };
 
 struct psi_group {
@@ -79,8 +146,22 @@ struct psi_group {
 	struct delayed_work clock_work;
 
 	/* Total stall times and sampled pressure averages */
-	u64 total[NR_PSI_STATES - 1];
+	u64 total[NR_PSI_AGGREGATORS][NR_PSI_STATES - 1];
 	unsigned long avg[NR_PSI_STATES - 1][3];
+
+	/* Trigger polling, only active while triggers are armed */
+	struct mutex trigger_lock;
+	struct list_head triggers;
+	u32 nr_triggers[NR_PSI_STATES - 1];
+	u32 poll_states;
+	u64 poll_min_period;
+	atomic_t poll_scheduled;
+	struct delayed_work poll_work;
+
+	/* Total stall times at the start of monitor activation */
+	u64 polling_total[NR_PSI_STATES - 1];
+	u64 polling_next_update;
+	u64 polling_until;
 };
 
 #else /* CONFIG_PSI */
@@ -24,12 +24,22 @@
 #include <linux/list_nulls.h>
 #include <linux/workqueue.h>
 #include <linux/rculist.h>
+#include <linux/bit_spinlock.h>
+#include <linux/bottom_half.h>
+#include <linux/prefetch.h>
 
 #include <linux/rhashtable-types.h>
 /*
  * The end of the chain is marked with a special nulls marks which has
  * the least significant bit set.
+ *
+ * Each bucket head doubles as the lock for its chain: bit 1 of the head
+ * pointer is a bit spinlock.  Chain entries are pointer aligned and the
+ * nulls marker only uses bit 0, so the bit is always free.  Readers mask
+ * it off with rht_ptr() and never see it; writers holding the lock must
+ * store a new head with rht_assign_locked() so that the bit stays set.
  */
+#define RHT_LOCK_BIT	1
 
 /* Maximum chain length before rehash
  *
@@ -52,8 +62,6 @@
  * @nest: Number of bits of first-level nested table.
  * @rehash: Current bucket being rehashed
  * @hash_rnd: Random seed to fold into hash
- * @locks_mask: Mask to apply before accessing locks[]
- * @locks: Array of spinlocks protecting individual buckets
  * @walkers: List of active walkers
  * @rcu: RCU structure for freeing the table
  * @future_tbl: Table under construction during rehashing
@@ -65,13 +73,13 @@ struct bucket_table {
 	unsigned int		nest;
 	unsigned int		rehash;
 	u32			hash_rnd;
-	unsigned int		locks_mask;
-	spinlock_t		*locks;
 	struct list_head	walkers;
 	struct rcu_head		rcu;
 
 	struct bucket_table __rcu *future_tbl;
 
+	struct lockdep_map	dep_map;
+
 	struct rhash_head __rcu *buckets[] ____cacheline_aligned_in_smp;
 };
 
@@ -196,23 +204,62 @@ static inline bool rht_grow_above_max(const struct rhashtable *ht,
 	return atomic_read(&ht->nelems) >= ht->max_elems;
 }
 
-/* The bucket lock is selected based on the hash and protects mutations
- * on a group of hash buckets.
- *
- * A maximum of tbl->size/2 bucket locks is allocated. This ensures that
- * a single lock always covers both buckets which may both contains
- * entries which link to the same bucket of the old table during resizing.
- * This allows to simplify the locking as locking the bucket in both
- * tables during resize always guarantee protection.
+/* The bucket lock lives in bit RHT_LOCK_BIT of the bucket head and
+ * protects mutations on that one chain.  Taking it costs no cache miss
+ * beyond the bucket itself, which a writer touches anyway.
  *
  * IMPORTANT: When holding the bucket lock of both the old and new table
  * during expansions and shrinking, the old bucket lock must always be
- * acquired first.
+ * acquired first, and the new one with rht_lock_nested().
+ *
+ * Bit spinlocks are invisible to lockdep, so all the bucket locks of a
+ * table are tracked as one lock through the dep_map of the table.
  */
-static inline spinlock_t *rht_bucket_lock(const struct bucket_table *tbl,
-					  unsigned int hash)
+static inline struct rhash_head *rht_ptr(const struct rhash_head *p)
+{
+	return (struct rhash_head *)((unsigned long)p & ~BIT(RHT_LOCK_BIT));
+}
+
+static inline void rht_lock(struct bucket_table *tbl,
+			    struct rhash_head __rcu **bkt)
+{
+	local_bh_disable();
+	bit_spin_lock(RHT_LOCK_BIT, (unsigned long *)bkt);
+	lock_map_acquire(&tbl->dep_map);
+}
+
+static inline void rht_lock_nested(struct bucket_table *tbl,
+				   struct rhash_head __rcu **bkt,
+				   unsigned int subclass)
 {
-	return &tbl->locks[hash & tbl->locks_mask];
+	bit_spin_lock(RHT_LOCK_BIT, (unsigned long *)bkt);
+	lock_acquire_exclusive(&tbl->dep_map, subclass, 0, NULL, _THIS_IP_);
+}
+
+static inline void rht_unlock_nested(struct bucket_table *tbl,
+				     struct rhash_head __rcu **bkt)
+{
+	lock_map_release(&tbl->dep_map);
+	bit_spin_unlock(RHT_LOCK_BIT, (unsigned long *)bkt);
+}
+
+static inline void rht_unlock(struct bucket_table *tbl,
+			      struct rhash_head __rcu **bkt)
+{
+	lock_map_release(&tbl->dep_map);
+	bit_spin_unlock(RHT_LOCK_BIT, (unsigned long *)bkt);
+	local_bh_enable();
+}
+
+/* Store @obj at @pprev in the chain of the locked bucket @bkt. */
+static inline void rht_assign_locked(struct rhash_head __rcu **bkt,
+				     struct rhash_head __rcu **pprev,
+				     struct rhash_head *obj)
+{
+	if (pprev == bkt)
+		obj = (struct rhash_head *)((unsigned long)obj |
+					    BIT(RHT_LOCK_BIT));
+	rcu_assign_pointer(*pprev, obj);
 }
 
 #ifdef CONFIG_PROVE_LOCKING
@@ -255,6 +302,8 @@ void rhashtable_destroy(struct rhashtable *ht);
 
 struct rhash_head __rcu **rht_bucket_nested(const struct bucket_table *tbl,
 					    unsigned int hash);
+struct rhash_head __rcu **__rht_bucket_nested(const struct bucket_table *tbl,
+					      unsigned int hash);
 struct rhash_head __rcu **rht_bucket_nested_insert(struct rhashtable *ht,
 						   struct bucket_table *tbl,
 						   unsigned int hash);
@@ -281,10 +330,11 @@ static inline struct rhash_head __rcu *const *rht_bucket(
 				     &tbl->buckets[hash];
 }
 
+/* Returns NULL for a bucket of a nested table that was never populated. */
 static inline struct rhash_head __rcu **rht_bucket_var(
 	struct bucket_table *tbl, unsigned int hash)
 {
-	return unlikely(tbl->nest) ? rht_bucket_nested(tbl, hash) :
+	return unlikely(tbl->nest) ? __rht_bucket_nested(tbl, hash) :
 				     &tbl->buckets[hash];
 }
 
@@ -303,7 +353,7 @@ static inline struct rhash_head __rcu **rht_bucket_insert(
  * @hash:	the hash value / bucket index
  */
 #define rht_for_each_continue(pos, head, tbl, hash) \
-	for (pos = rht_dereference_bucket(head, tbl, hash); \
+	for (pos = rht_ptr(rht_dereference_bucket(head, tbl, hash)); \
 	     !rht_is_a_nulls(pos); \
 	     pos = rht_dereference_bucket((pos)->next, tbl, hash))
 
@@ -326,7 +376,7 @@ static inline struct rhash_head __rcu **rht_bucket_insert(
  * @member:	name of the &struct rhash_head within the hashable struct.
  */
 #define rht_for_each_entry_continue(tpos, pos, head, tbl, hash, member)	\
-	for (pos = rht_dereference_bucket(head, tbl, hash);		\
+	for (pos = rht_ptr(rht_dereference_bucket(head, tbl, hash));	\
 	     (!rht_is_a_nulls(pos)) && rht_entry(tpos, pos, member);	\
 	     pos = rht_dereference_bucket((pos)->next, tbl, hash))
 
@@ -355,7 +405,8 @@ static inline struct rhash_head __rcu **rht_bucket_insert(
  * remove the loop cursor from the list.
  */
 #define rht_for_each_entry_safe(tpos, pos, next, tbl, hash, member)	      \
-	for (pos = rht_dereference_bucket(*rht_bucket(tbl, hash), tbl, hash), \
+	for (pos = rht_ptr(rht_dereference_bucket(*rht_bucket(tbl, hash),    \
+						  tbl, hash)),		      \
 	     next = !rht_is_a_nulls(pos) ?				      \
 		       rht_dereference_bucket(pos->next, tbl, hash) : NULL;   \
 	     (!rht_is_a_nulls(pos)) && rht_entry(tpos, pos, member);	      \
@@ -376,7 +427,7 @@ static inline struct rhash_head __rcu **rht_bucket_insert(
  */
 #define rht_for_each_rcu_continue(pos, head, tbl, hash)			\
 	for (({barrier(); }),						\
-	     pos = rht_dereference_bucket_rcu(head, tbl, hash);		\
+	     pos = rht_ptr(rht_dereference_bucket_rcu(head, tbl, hash));	\
 	     !rht_is_a_nulls(pos);					\
 	     pos = rcu_dereference_raw(pos->next))
 
@@ -408,7 +459,7 @@ static inline struct rhash_head __rcu **rht_bucket_insert(
  */
 #define rht_for_each_entry_rcu_continue(tpos, pos, head, tbl, hash, member) \
 	for (({barrier(); }),						    \
-	     pos = rht_dereference_bucket_rcu(head, tbl, hash);		    \
+	     pos = rht_ptr(rht_dereference_bucket_rcu(head, tbl, hash));	    \
 	     (!rht_is_a_nulls(pos)) && rht_entry(tpos, pos, member);	    \
 	     pos = rht_dereference_bucket_rcu(pos->next, tbl, hash))
 
@@ -545,6 +596,49 @@ static inline void *rhashtable_lookup_fast(
 	return obj;
 }
 
+/* Number of buckets a bulk operation prefetches ahead of the one it works on */
+#define RHT_BULK_PREFETCH	8
+
+/**
+ * rhashtable_lookup_bulk - search hash table for several keys
+ * @ht:		hash table
+ * @keys:	array of @n pointers to keys
+ * @objs:	array of @n results, NULL where a key was not found
+ * @n:		number of keys
+ * @params:	hash table parameters
+ *
+ * Like rhashtable_lookup() for each key, but the buckets are prefetched
+ * a few keys ahead so that the misses on them overlap instead of being
+ * taken one after the other.
+ *
+ * This must only be called under the RCU read lock.
+ *
+ * Returns the number of keys that were found.
+ */
+static inline unsigned int rhashtable_lookup_bulk(
+	struct rhashtable *ht, const void * const *keys, void **objs,
+	unsigned int n, const struct rhashtable_params params)
+{
+	struct bucket_table *tbl = rht_dereference_rcu(ht->tbl, ht);
+	unsigned int i, found = 0;
+
+	for (i = 0; i < n; i++) {
+		unsigned int j = i ? i + RHT_BULK_PREFETCH - 1 : 0;
+		unsigned int end = min_t(unsigned int, n,
+					 i + RHT_BULK_PREFETCH);
+
+		for (; !tbl->nest && j < end; j++)
+			prefetch(&tbl->buckets[rht_key_hashfn(ht, tbl, keys[j],
+							      params)]);
+
+		objs[i] = rhashtable_lookup(ht, keys[i], params);
+		if (objs[i])
+			found++;
+	}
+
+	return found;
+}
+
 /**
  * rhltable_lookup - search hash list table
  * @hlt:	hash table
@@ -580,10 +674,9 @@ static inline void *__rhashtable_insert_fast(
 		.ht = ht,
 		.key = key,
 	};
-	struct rhash_head __rcu **pprev;
+	struct rhash_head __rcu **pprev, **bkt;
 	struct bucket_table *tbl;
 	struct rhash_head *head;
-	spinlock_t *lock;
 	unsigned int hash;
 	int elasticity;
 	void *data;
@@ -592,22 +685,21 @@ static inline void *__rhashtable_insert_fast(
 
 	tbl = rht_dereference_rcu(ht->tbl, ht);
 	hash = rht_head_hashfn(ht, tbl, obj, params);
-	lock = rht_bucket_lock(tbl, hash);
-	spin_lock_bh(lock);
+	elasticity = RHT_ELASTICITY;
+	bkt = rht_bucket_insert(ht, tbl, hash);
+	data = ERR_PTR(-ENOMEM);
+	if (!bkt)
+		goto out;
+	pprev = bkt;
+	rht_lock(tbl, bkt);
 
 	if (unlikely(rcu_access_pointer(tbl->future_tbl))) {
 slow_path:
-		spin_unlock_bh(lock);
+		rht_unlock(tbl, bkt);
 		rcu_read_unlock();
 		return rhashtable_insert_slow(ht, key, obj);
 	}
 
-	elasticity = RHT_ELASTICITY;
-	pprev = rht_bucket_insert(ht, tbl, hash);
-	data = ERR_PTR(-ENOMEM);
-	if (!pprev)
-		goto out;
-
 	rht_for_each_continue(head, *pprev, tbl, hash) {
 		struct rhlist_head *plist;
 		struct rhlist_head *list;
@@ -624,7 +716,7 @@ static inline void *__rhashtable_insert_fast(
 		data = rht_obj(ht, head);
 
 		if (!rhlist)
-			goto out;
+			goto out_unlock;
 
 
 		list = container_of(obj, struct rhlist_head, rhead);
@@ -633,7 +725,7 @@ static inline void *__rhashtable_insert_fast(
 		RCU_INIT_POINTER(list->next, plist);
 		head = rht_dereference_bucket(head->next, tbl, hash);
 		RCU_INIT_POINTER(list->rhead.next, head);
-		rcu_assign_pointer(*pprev, obj);
+		rht_assign_locked(bkt, pprev, obj);
 
 		goto good;
 	}
@@ -643,12 +735,12 @@ static inline void *__rhashtable_insert_fast(
 
 	data = ERR_PTR(-E2BIG);
 	if (unlikely(rht_grow_above_max(ht, tbl)))
-		goto out;
+		goto out_unlock;
 
 	if (unlikely(rht_grow_above_100(ht, tbl)))
 		goto slow_path;
 
-	head = rht_dereference_bucket(*pprev, tbl, hash);
+	head = rht_ptr(rht_dereference_bucket(*pprev, tbl, hash));
 
 	RCU_INIT_POINTER(obj->next, head);
 	if (rhlist) {
@@ -658,7 +750,7 @@ static inline void *__rhashtable_insert_fast(
 		RCU_INIT_POINTER(list->next, NULL);
 	}
 
-	rcu_assign_pointer(*pprev, obj);
+	rht_assign_locked(bkt, pprev, obj);
 
 	atomic_inc(&ht->nelems);
 	if (rht_grow_above_75(ht, tbl))
@@ -667,8 +759,9 @@ static inline void *__rhashtable_insert_fast(
 good:
 	data = NULL;
 
+out_unlock:
+	rht_unlock(tbl, bkt);
 out:
-	spin_unlock_bh(lock);
 	rcu_read_unlock();
 
 	return data;
@@ -867,24 +960,69 @@ static inline void *rhashtable_lookup_get_insert_key(
 	return __rhashtable_insert_fast(ht, key, obj, params, false);
 }
 
+/**
+ * rhashtable_insert_fast_bulk - insert several objects into hash table
+ * @ht:		hash table
+ * @objs:	array of @n pointers to hash heads inside objects
+ * @n:		number of objects
+ * @params:	hash table parameters
+ *
+ * Inserts the objects in order with rhashtable_insert_fast().  The bucket
+ * of each object is prefetched for writing a few objects ahead, so that
+ * the insertion takes its bucket lock on a line that is already there.
+ *
+ * It is safe to call this function from atomic context.
+ *
+ * Returns the number of objects inserted.  Insertion stops at the first
+ * object that fails; inserting it with rhashtable_insert_fast() returns
+ * the reason.
+ */
+static inline unsigned int rhashtable_insert_fast_bulk(
+	struct rhashtable *ht, struct rhash_head **objs, unsigned int n,
+	const struct rhashtable_params params)
+{
+	struct bucket_table *tbl;
+	unsigned int i;
+
+	rcu_read_lock();
+	tbl = rht_dereference_rcu(ht->tbl, ht);
+
+	for (i = 0; i < n; i++) {
+		unsigned int j = i ? i + RHT_BULK_PREFETCH - 1 : 0;
+		unsigned int end = min_t(unsigned int, n,
+					 i + RHT_BULK_PREFETCH);
+
+		for (; !tbl->nest && j < end; j++)
+			prefetchw(&tbl->buckets[rht_head_hashfn(ht, tbl,
+					objs[j], params)]);
+
+		if (rhashtable_insert_fast(ht, objs[i], params))
+			break;
+	}
+
+	rcu_read_unlock();
+
+	return i;
+}
+
 /* Internal function, please use rhashtable_remove_fast() instead */
 static inline int __rhashtable_remove_fast_one(
 	struct rhashtable *ht, struct bucket_table *tbl,
 	struct rhash_head *obj, const struct rhashtable_params params,
 	bool rhlist)
 {
-	struct rhash_head __rcu **pprev;
+	struct rhash_head __rcu **pprev, **bkt;
 	struct rhash_head *he;
-	spinlock_t * lock;
 	unsigned int hash;
 	int err = -ENOENT;
 
 	hash = rht_head_hashfn(ht, tbl, obj, params);
-	lock = rht_bucket_lock(tbl, hash);
+	bkt = rht_bucket_var(tbl, hash);
+	if (!bkt)
+		return -ENOENT;
+	pprev = bkt;
+	rht_lock(tbl, bkt);
 
-	spin_lock_bh(lock);
-
-	pprev = rht_bucket_var(tbl, hash);
 	rht_for_each_continue(he, *pprev, tbl, hash) {
 		struct rhlist_head *list;
 
@@ -925,11 +1063,11 @@ static inline int __rhashtable_remove_fast_one(
 			}
 		}
 
-		rcu_assign_pointer(*pprev, obj);
+		rht_assign_locked(bkt, pprev, obj);
 		break;
 	}
 
-	spin_unlock_bh(lock);
+	rht_unlock(tbl, bkt);
 
 	if (err > 0) {
 		atomic_dec(&ht->nelems);
@@ -1019,9 +1157,8 @@ static inline int __rhashtable_replace_fast(
 	struct rhash_head *obj_old, struct rhash_head *obj_new,
 	const struct rhashtable_params params)
 {
-	struct rhash_head __rcu **pprev;
+	struct rhash_head __rcu **pprev, **bkt;
 	struct rhash_head *he;
-	spinlock_t *lock;
 	unsigned int hash;
 	int err = -ENOENT;
 
@@ -1032,11 +1169,12 @@ static inline int __rhashtable_replace_fast(
 	if (hash != rht_head_hashfn(ht, tbl, obj_new, params))
 		return -EINVAL;
 
-	lock = rht_bucket_lock(tbl, hash);
-
-	spin_lock_bh(lock);
+	bkt = rht_bucket_var(tbl, hash);
+	if (!bkt)
+		return -ENOENT;
+	pprev = bkt;
+	rht_lock(tbl, bkt);
 
-	pprev = rht_bucket_var(tbl, hash);
 	rht_for_each_continue(he, *pprev, tbl, hash) {
 		if (he != obj_old) {
 			pprev = &he->next;
@@ -1044,12 +1182,12 @@ static inline int __rhashtable_replace_fast(
 		}
 
 		rcu_assign_pointer(obj_new->next, obj_old->next);
-		rcu_assign_pointer(*pprev, obj_new);
+		rht_assign_locked(bkt, pprev, obj_new);
 		err = 0;
 		break;
 	}
 
-	spin_unlock_bh(lock);
+	rht_unlock(tbl, bkt);
 
 	return err;
 }
@@ -479,6 +479,20 @@ void sbitmap_queue_min_shallow_depth(struct sbitmap_queue *sbq,
 void sbitmap_queue_clear(struct sbitmap_queue *sbq, unsigned int nr,
 			 unsigned int cpu);
 
+/**
+ * sbitmap_queue_clear_batch() - Free several allocated bits and wake up
+ * waiters on a &struct sbitmap_queue.
+ * @sbq: Bitmap to free from.
+ * @bits: Bit numbers to free, ideally sorted so that bits sharing a word
+ *        are adjacent.
+ * @nr_bits: Number of entries in @bits, must be at least one.
+ * @cpu: CPU whose allocation hint is updated.
+ *
+ * Bits from the same word are cleared with a single atomic operation.
+ */
+void sbitmap_queue_clear_batch(struct sbitmap_queue *sbq, const int *bits,
+			       int nr_bits, unsigned int cpu);
+
 static inline int sbq_index_inc(int index)
 {
 	return (index + 1) & (SBQ_WAIT_QUEUES - 1);
@@ -637,6 +637,7 @@ struct task_struct {
 	int				static_prio;
 	int				normal_prio;
 	unsigned int			rt_priority;
+	int				latency_nice;
 
 	const struct sched_class	*sched_class;
 	struct sched_entity		se;
@@ -709,6 +710,7 @@ struct task_struct {
 	unsigned			sched_remote_wakeup:1;
 #ifdef CONFIG_PSI
 	unsigned			sched_psi_wake_requeue:1;
+	unsigned			sched_psi_woken:1;
 #endif
 
 	/* Force alignment to the next boundary: */
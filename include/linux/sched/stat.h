@@ -25,6 +25,9 @@ static inline int sched_info_on(void)
 {
 #ifdef CONFIG_SCHEDSTATS
 	return 1;
+#elif defined(CONFIG_PSI)
+	/* psi's latency histograms are fed from sched_info_arrive() */
+	return 1;
 #elif defined(CONFIG_TASK_DELAY_ACCT)
 	extern int delayacct_on;
 	return delayacct_on;
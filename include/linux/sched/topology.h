@@ -72,8 +72,18 @@ struct sched_domain_shared {
 	atomic_t	ref;
 	atomic_t	nr_busy_cpus;
 	int		has_idle_cores;
+	/*
+	 * CPUs of the LLC that are currently running their idle task, updated
+	 * on idle entry and exit. Variable length like sched_domain::span.
+	 */
+	unsigned long	idle_cpus_span[0];
 };
 
+static inline struct cpumask *sds_idle_cpus(struct sched_domain_shared *sds)
+{
+	return to_cpumask(sds->idle_cpus_span);
+}
+
 struct sched_domain {
 	/* These fields must be setup */
 	struct sched_domain *parent;	/* top domain must be null terminated */
@@ -90,6 +100,7 @@ struct sched_domain {
 	unsigned int wake_idx;
 	unsigned int forkexec_idx;
 	unsigned int smt_gain;
+	unsigned int migration_cost_factor; /* task_hot() scale, LOCAL_DISTANCE = 1x */
 
 	int nohz_idle;			/* NOHZ IDLE status */
 	int flags;			/* See SD_* */
@@ -17,6 +17,7 @@ struct shmem_inode_info {
 	unsigned long		flags;
 	unsigned long		alloced;	/* data pages alloced to file */
 	unsigned long		swapped;	/* subtotal assigned to swap */
+	unsigned char		huge;		/* per-file hugepage policy */
 	struct list_head        shrinklist;     /* shrinkable hpage inodes */
 	struct list_head	swaplist;	/* chain of maybes on swap */
 	struct shared_policy	policy;		/* NUMA memory alloc policy */
@@ -112,11 +113,16 @@ extern void shmem_uncharge(struct inode *inode, long pages);
 
 #ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
 extern bool shmem_huge_enabled(struct vm_area_struct *vma);
+extern int shmem_file_set_huge(struct file *file);
 #else
 static inline bool shmem_huge_enabled(struct vm_area_struct *vma)
 {
 	return false;
 }
+static inline int shmem_file_set_huge(struct file *file)
+{
+	return -EINVAL;
+}
 #endif
 
 #ifdef CONFIG_SHMEM
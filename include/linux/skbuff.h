@@ -40,6 +40,9 @@
 #include <linux/in6.h>
 #include <linux/if_packet.h>
 #include <net/flow.h>
+#if IS_ENABLED(CONFIG_PAGE_POOL)
+#include <net/page_pool.h>
+#endif
 
 /* The interface for checksum offload between the stack and networking drivers
  * is as follows...
@@ -244,6 +247,7 @@ struct pipe_inode_info;
 struct iov_iter;
 struct napi_struct;
 struct bpf_prog;
+struct zerocopy_notif_buf;
 union bpf_attr;
 
 #if defined(CONFIG_NF_CONNTRACK) || defined(CONFIG_NF_CONNTRACK_MODULE)
@@ -484,6 +488,7 @@ void sock_zerocopy_put(struct ubuf_info *uarg);
 void sock_zerocopy_put_abort(struct ubuf_info *uarg);
 
 void sock_zerocopy_callback(struct ubuf_info *uarg, bool success);
+int sock_zerocopy_reap(struct sock *sk, struct zerocopy_notif_buf __user *ubuf);
 
 int skb_zerocopy_iter_stream(struct sock *sk, struct sk_buff *skb,
 			     struct msghdr *msg, int len,
@@ -801,6 +806,9 @@ struct sk_buff {
 #ifdef CONFIG_TLS_DEVICE
 	__u8			decrypted:1;
 #endif
+#ifdef CONFIG_PAGE_POOL
+	__u8			pp_recycle:1; /* page_pool recycle indicator */
+#endif
 
 #ifdef CONFIG_NET_SCHED
 	__u16			tc_index;	/* traffic control index */
@@ -991,6 +999,8 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t priority, int flags,
 			    int node);
 struct sk_buff *__build_skb(void *data, unsigned int frag_size);
 struct sk_buff *build_skb(void *data, unsigned int frag_size);
+struct sk_buff *build_skb_around(struct sk_buff *skb,
+				 void *data, unsigned int frag_size);
 static inline struct sk_buff *alloc_skb(unsigned int size,
 					gfp_t priority)
 {
@@ -2826,11 +2836,19 @@ static inline void __skb_frag_unref(skb_frag_t *frag)
  * @skb: the buffer
  * @f: the fragment offset
  *
- * Releases a reference on the @f'th paged fragment of @skb.
+ * Releases a reference on the @f'th paged fragment of @skb.  If @skb
+ * is marked for recycling, a page_pool page goes back to its pool.
  */
 static inline void skb_frag_unref(struct sk_buff *skb, int f)
 {
-	__skb_frag_unref(&skb_shinfo(skb)->frags[f]);
+	skb_frag_t *frag = &skb_shinfo(skb)->frags[f];
+
+#ifdef CONFIG_PAGE_POOL
+	if (skb->pp_recycle &&
+	    page_pool_return_skb_page(skb_frag_page(frag)))
+		return;
+#endif
+	__skb_frag_unref(frag);
 }
 
 /**
@@ -4199,6 +4217,41 @@ static inline bool skb_head_is_locked(const struct sk_buff *skb)
 	return !skb->head_frag || skb_cloned(skb);
 }
 
+/**
+ * skb_mark_for_recycle - recycle page_pool pages when @skb is freed
+ * @skb: skb built from page_pool pages
+ *
+ * Drivers building skbs (head frag and/or paged frags) from page_pool
+ * pages call this so that the pages are returned to their page_pool
+ * instead of the page allocator, with their DMA mapping kept, when the
+ * skb releases them.  Pages not from a page_pool are released as usual.
+ */
+static inline void skb_mark_for_recycle(struct sk_buff *skb)
+{
+#ifdef CONFIG_PAGE_POOL
+	skb->pp_recycle = 1;
+#endif
+}
+
+static inline bool skb_pp_recycle_mismatch(const struct sk_buff *a,
+					   const struct sk_buff *b)
+{
+#ifdef CONFIG_PAGE_POOL
+	return a->pp_recycle != b->pp_recycle;
+#else
+	return false;
+#endif
+}
+
+static inline bool skb_pp_recycle(struct sk_buff *skb, void *data)
+{
+#ifdef CONFIG_PAGE_POOL
+	if (skb->pp_recycle)
+		return page_pool_return_skb_page(virt_to_page(data));
+#endif
+	return false;
+}
+
 /* Local Checksum Offload.
  * Compute outer checksum based on the assumption that the
  * inner checksum will be offloaded later.
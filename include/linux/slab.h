@@ -109,6 +109,9 @@
 #define SLAB_KASAN		0
 #endif
 
+/* Cache free objects in per-cpu arrays, refilled and flushed in batches */
+#define SLAB_CPU_ARRAY		((slab_flags_t __force)0x10000000U)
+
 /* The following flags affect the page allocator grouping pages by mobility */
 /* Objects are reclaimable */
 #define SLAB_RECLAIM_ACCOUNT	((slab_flags_t __force)0x00020000U)
@@ -36,6 +36,10 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	CPU_ARRAY_ALLOC,	/* Allocation from the cpu array */
+	CPU_ARRAY_FREE,		/* Free to the cpu array */
+	CPU_ARRAY_REFILL,	/* Refill of the cpu array from the slabs */
+	CPU_ARRAY_FLUSH,	/* Flush of a batch from the cpu array */
 	NR_SLUB_STAT_ITEMS };
 
 struct kmem_cache_cpu {
@@ -50,6 +54,20 @@ struct kmem_cache_cpu {
 #endif
 };
 
+/*
+ * Array of free objects kept per cpu for SLAB_CPU_ARRAY caches. It is
+ * refilled from and flushed to the slabs SLUB_CPU_ARRAY_BATCH objects at a
+ * time, so that most allocations and frees touch neither the slab freelists
+ * nor the node list_lock.
+ */
+#define SLUB_CPU_ARRAY_SIZE	64
+#define SLUB_CPU_ARRAY_BATCH	(SLUB_CPU_ARRAY_SIZE / 2)
+
+struct kmem_cache_array {
+	unsigned int count;
+	void *objects[SLUB_CPU_ARRAY_SIZE];
+};
+
 #ifdef CONFIG_SLUB_CPU_PARTIAL
 #define slub_percpu_partial(c)		((c)->partial)
 
@@ -81,6 +99,7 @@ struct kmem_cache_order_objects {
  */
 struct kmem_cache {
 	struct kmem_cache_cpu __percpu *cpu_slab;
+	struct kmem_cache_array __percpu *cpu_array;	/* SLAB_CPU_ARRAY only */
 	/* Used for retriving partial slabs etc */
 	slab_flags_t flags;
 	unsigned long min_partial;
@@ -182,4 +201,11 @@ static inline void *nearest_obj(struct kmem_cache *cache, struct page *page,
 	return result;
 }
 
+/* Determine object index from a given position */
+static inline unsigned int obj_to_index(const struct kmem_cache *cache,
+					struct page *page, void *obj)
+{
+	return (obj - page_address(page)) / cache->size;
+}
+
 #endif /* _LINUX_SLUB_DEF_H */
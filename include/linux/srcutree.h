@@ -140,6 +140,10 @@ struct srcu_struct {
 
 void synchronize_srcu_expedited(struct srcu_struct *sp);
 void srcu_barrier(struct srcu_struct *sp);
+unsigned long get_state_synchronize_srcu(struct srcu_struct *sp);
+unsigned long start_poll_synchronize_srcu(struct srcu_struct *sp);
+unsigned long start_poll_synchronize_srcu_expedited(struct srcu_struct *sp);
+bool poll_state_synchronize_srcu(struct srcu_struct *sp, unsigned long cookie);
 void srcu_torture_stats_print(struct srcu_struct *sp, char *tt, char *tf);
 
 #endif
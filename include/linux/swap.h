@@ -28,7 +28,13 @@ struct bio;
 #define SWAP_FLAGS_VALID	(SWAP_FLAG_PRIO_MASK | SWAP_FLAG_PREFER | \
 				 SWAP_FLAG_DISCARD | SWAP_FLAG_DISCARD_ONCE | \
 				 SWAP_FLAG_DISCARD_PAGES)
-#define SWAP_BATCH 64
+/*
+ * Number of swap slots taken from, or given back to, a swap device per
+ * si->lock round trip by the per-cpu swap slot caches.  On SSDs a refill
+ * takes its slots from the CPU's own per-cpu cluster, so a larger batch
+ * does not leave more clusters partially used.
+ */
+#define SWAP_BATCH 256
 
 static inline int current_is_kswapd(void)
 {
@@ -330,6 +336,7 @@ extern void lru_add_drain_cpu(int cpu);
 extern void lru_add_drain_all(void);
 extern void rotate_reclaimable_page(struct page *page);
 extern void deactivate_file_page(struct page *page);
+extern void deactivate_page(struct page *page);
 extern void mark_page_lazyfree(struct page *page);
 extern void swap_setup(void);
 
@@ -356,11 +363,13 @@ extern unsigned long vm_total_pages;
 
 #ifdef CONFIG_NUMA
 extern int node_reclaim_mode;
+extern int sysctl_numa_demotion;
 extern int sysctl_min_unmapped_ratio;
 extern int sysctl_min_slab_ratio;
 extern int node_reclaim(struct pglist_data *, gfp_t, unsigned int);
 #else
 #define node_reclaim_mode 0
+#define sysctl_numa_demotion 0
 static inline int node_reclaim(struct pglist_data *pgdat, gfp_t mask,
 				unsigned int order)
 {
@@ -303,6 +303,10 @@ asmlinkage long sys_io_pgetevents(aio_context_t ctx_id,
 				struct io_event __user *events,
 				struct timespec __user *timeout,
 				const struct __aio_sigset *sig);
+asmlinkage long sys_io_setup2(u32 nr_events, u32 flags,
+			      struct aio_setup2_params __user *params);
+asmlinkage long sys_io_ring_enter(aio_context_t ctx_id, u32 to_submit,
+				  u32 min_complete, u32 flags);
 
 /* fs/xattr.c */
 asmlinkage long sys_setxattr(const char __user *path, const char __user *name,
@@ -799,6 +803,9 @@ asmlinkage long sys_munlockall(void);
 asmlinkage long sys_mincore(unsigned long start, size_t len,
 				unsigned char __user * vec);
 asmlinkage long sys_madvise(unsigned long start, size_t len, int behavior);
+asmlinkage long sys_process_madvise(int pidfd, const struct iovec __user *vec,
+				    unsigned long vlen, int behavior,
+				    unsigned int flags);
 asmlinkage long sys_remap_file_pages(unsigned long start, unsigned long size,
 			unsigned long prot, unsigned long pgoff,
 			unsigned long flags);
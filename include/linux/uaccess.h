@@ -228,6 +228,12 @@ static inline unsigned long __copy_from_user_inatomic_nocache(void *to,
 	return __copy_from_user_inatomic(to, from, n);
 }
 
+static inline unsigned long __copy_to_user_inatomic_nocache(void __user *to,
+				const void *from, unsigned long n)
+{
+	return __copy_to_user_inatomic(to, from, n);
+}
+
 #endif		/* ARCH_HAS_NOCACHE_UACCESS */
 
 /*
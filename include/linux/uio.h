@@ -117,6 +117,13 @@ static inline struct iovec iov_iter_iovec(const struct iov_iter *iter)
 	     ((iov = iov_iter_iovec(&(iter))), 1);		\
 	     iov_iter_advance(&(iter), (iov).iov_len))
 
+/*
+ * Once this much is left to read, copy_page_to_iter() copies to user
+ * space with non-temporal stores. Never by default; x86-64 sets it to
+ * the size of the last level cache when booted with "nocache_reads".
+ */
+extern size_t iov_iter_nocache_threshold;
+
 size_t iov_iter_copy_from_user_atomic(struct page *page,
 		struct iov_iter *i, unsigned long offset, size_t bytes);
 void iov_iter_advance(struct iov_iter *i, size_t bytes);
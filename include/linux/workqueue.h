@@ -340,6 +340,16 @@ enum {
 	 */
 	WQ_POWER_EFFICIENT	= 1 << 7,
 
+	/*
+	 * Work items queued on a per-cpu workqueue without an explicit
+	 * CPU run on the queueing CPU.  With WQ_AFFN_CACHE, if the local
+	 * pool is already busy, the work item goes to an idle CPU which
+	 * shares the last level cache with the queueing one instead, or
+	 * the same NUMA node if workqueue.affinity_numa is set.  Marked
+	 * workqueues must not rely on running on the queueing CPU.
+	 */
+	WQ_AFFN_CACHE		= 1 << 8,
+
 	__WQ_DRAINING		= 1 << 16, /* internal: workqueue is draining */
 	__WQ_ORDERED		= 1 << 17, /* internal: workqueue is ordered */
 	__WQ_LEGACY		= 1 << 18, /* internal: create*_workqueue() */
@@ -28,6 +28,7 @@
 #include <linux/sched/clock.h>
 #include <linux/sched/signal.h>
 #include <net/ip.h>
+#include <net/xdp.h>
 
 /*		0 - Reserved to indicate value not set
  *     1..NR_CPUS - Reserved for sender_cpu
@@ -149,4 +150,14 @@ static inline void sk_mark_napi_id_once(struct sock *sk,
 #endif
 }
 
+/* variant used for XDP sockets, fed without an skb */
+static inline void sk_mark_napi_id_once_xdp(struct sock *sk,
+					    const struct xdp_buff *xdp)
+{
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	if (!sk->sk_napi_id)
+		sk->sk_napi_id = xdp->rxq->napi_id;
+#endif
+}
+
 #endif /* _LINUX_NET_BUSY_POLL_H */
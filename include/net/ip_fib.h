@@ -246,6 +246,18 @@ struct fib_table *fib_trie_unmerge(struct fib_table *main_tb);
 void fib_table_flush_external(struct fib_table *table);
 void fib_free_table(struct fib_table *tb);
 
+extern int sysctl_fib_lookup_cache;
+extern atomic_t fib_lookup_cache_genid;
+
+/* Invalidate every fib_table_lookup() result cache, ordered after the
+ * fib change that made them stale.
+ */
+static inline void fib_lookup_cache_flush(void)
+{
+	smp_mb__before_atomic();
+	atomic_inc(&fib_lookup_cache_genid);
+}
+
 #ifndef CONFIG_IP_MULTIPLE_TABLES
 
 #define TABLE_LOCAL_INDEX	(RT_TABLE_LOCAL & (FIB_TABLE_HASHSZ - 1))
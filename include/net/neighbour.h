@@ -156,6 +156,7 @@ struct neighbour {
 	const struct neigh_ops	*ops;
 	struct rcu_head		rcu;
 	struct net_device	*dev;
+	struct list_head	gc_list;
 	u8			primary_key[0];
 } __randomize_layout;
 
@@ -213,6 +214,8 @@ struct neigh_table {
 	struct delayed_work	gc_work;
 	struct timer_list 	proxy_timer;
 	struct sk_buff_head	proxy_queue;
+	atomic_t		gc_entries;
+	struct list_head	gc_list;
 	atomic_t		entries;
 	rwlock_t		lock;
 	unsigned long		last_rand;
@@ -24,12 +24,20 @@
  * If no DMA mapping is done, then it can act as shim-layer that
  * fall-through to alloc_page.  As no state is kept on the page, the
  * regular put_page() call is sufficient.
+ *
+ * Pages handed to the network stack in an skb can be recycled back
+ * into their page_pool when the skb is freed, instead of going back to
+ * the page allocator, by marking the skb with skb_mark_for_recycle().
+ * Each page records its pool in page->pp, and every page that has left
+ * the pool's caches holds a reference on the pool, so a pool outlives
+ * page_pool_destroy() until all its pages have come back.
  */
 #ifndef _NET_PAGE_POOL_H
 #define _NET_PAGE_POOL_H
 
 #include <linux/mm.h> /* Needed by ptr_ring */
 #include <linux/ptr_ring.h>
+#include <linux/refcount.h>
 #include <linux/dma-direction.h>
 
 #define PP_FLAG_DMA_MAP 1 /* Should page_pool do the DMA map/unmap */
@@ -93,9 +101,13 @@ struct page_pool {
 	 * Use ptr_ring, as it separates consumer and producer
 	 * effeciently, it a way that doesn't bounce cache-lines.
 	 *
-	 * TODO: Implement bulk return pages into this structure.
+	 * Pages can be returned in bulk, see page_pool_put_page_bulk().
 	 */
 	struct ptr_ring ring;
+
+	/* One reference for the owner, plus one per page handed out */
+	refcount_t users;
+	bool destroyed;
 };
 
 struct page *page_pool_alloc_pages(struct page_pool *pool, gfp_t gfp);
@@ -125,6 +137,17 @@ static inline void page_pool_put_page(struct page_pool *pool,
 	__page_pool_put_page(pool, page, allow_direct);
 #endif
 }
+
+#ifdef CONFIG_PAGE_POOL
+void page_pool_put_page_bulk(struct page_pool *pool, void **data,
+			     int count);
+#else
+static inline void page_pool_put_page_bulk(struct page_pool *pool,
+					   void **data, int count)
+{
+}
+#endif
+
 /* Very limited use-cases allow recycle direct */
 static inline void page_pool_recycle_direct(struct page_pool *pool,
 					    struct page *page)
@@ -132,6 +155,15 @@ static inline void page_pool_recycle_direct(struct page_pool *pool,
 	__page_pool_put_page(pool, page, true);
 }
 
+#ifdef CONFIG_PAGE_POOL
+bool page_pool_return_skb_page(struct page *page);
+#else
+static inline bool page_pool_return_skb_page(struct page *page)
+{
+	return false;
+}
+#endif
+
 static inline bool is_page_pool_compiled_in(void)
 {
 #ifdef CONFIG_PAGE_POOL
@@ -42,6 +42,8 @@ struct net_protocol {
 	int			(*early_demux)(struct sk_buff *skb);
 	int			(*early_demux_handler)(struct sk_buff *skb);
 	int			(*handler)(struct sk_buff *skb);
+	/* optional, for lists of skbs sharing a dst; never resubmits */
+	void			(*list_handler)(struct list_head *head);
 	void			(*err_handler)(struct sk_buff *skb, u32 info);
 	unsigned int		no_policy:1,
 				netns_ok:1,
@@ -319,6 +319,7 @@ void tcp_shutdown(struct sock *sk, int how);
 
 int tcp_v4_early_demux(struct sk_buff *skb);
 int tcp_v4_rcv(struct sk_buff *skb);
+void tcp_v4_list_rcv(struct list_head *head);
 
 int tcp_v4_tw_remember_stamp(struct inet_timewait_sock *tw);
 int tcp_sendmsg(struct sock *sk, struct msghdr *msg, size_t size);
@@ -331,6 +332,7 @@ ssize_t do_tcp_sendpages(struct sock *sk, struct page *page, int offset,
 		 size_t size, int flags);
 void tcp_release_cb(struct sock *sk);
 void tcp_wfree(struct sk_buff *skb);
+bool tcp_defer_xmit(struct sock *sk);
 void tcp_write_timer_handler(struct sock *sk);
 void tcp_delack_timer_handler(struct sock *sk);
 int tcp_ioctl(struct sock *sk, int cmd, unsigned long arg);
@@ -979,6 +981,8 @@ enum tcp_ca_ack_event_flags {
 #define TCP_CONG_NON_RESTRICTED 0x1
 /* Requires ECN/ECT set on all packets */
 #define TCP_CONG_NEEDS_ECN	0x2
+/* Implemented by BPF programs, see net/ipv4/bpf_tcp_ca.c */
+#define TCP_CONG_BPF		0x4
 
 union tcp_cc_info;
 
@@ -1055,6 +1059,22 @@ struct tcp_congestion_ops {
 int tcp_register_congestion_control(struct tcp_congestion_ops *type);
 void tcp_unregister_congestion_control(struct tcp_congestion_ops *type);
 
+#if defined(CONFIG_BPF_JIT) && defined(CONFIG_BPF_SYSCALL)
+bool bpf_tcp_ca_get(const struct tcp_congestion_ops *ca);
+void bpf_tcp_ca_put(const struct tcp_congestion_ops *ca);
+#else
+static inline bool bpf_tcp_ca_get(const struct tcp_congestion_ops *ca)
+{
+	return false;
+}
+
+static inline void bpf_tcp_ca_put(const struct tcp_congestion_ops *ca)
+{
+}
+#endif
+bool tcp_ca_get(const struct tcp_congestion_ops *ca);
+void tcp_ca_put(const struct tcp_congestion_ops *ca);
+
 void tcp_assign_congestion_control(struct sock *sk);
 void tcp_init_congestion_control(struct sock *sk);
 void tcp_cleanup_congestion_control(struct sock *sk);
@@ -198,6 +198,7 @@ struct cipher_context {
 union tls_crypto_context {
 	struct tls_crypto_info info;
 	struct tls12_crypto_info_aes_gcm_128 aes_gcm_128;
+	struct tls12_crypto_info_aes_gcm_256 aes_gcm_256;
 };
 
 struct tls_context {
@@ -240,10 +241,31 @@ struct tls_context {
 	void (*unhash)(struct sock *sk);
 };
 
+enum tls_offload_sync_type {
+	/* device asks for the record found at a TCP sequence number */
+	TLS_OFFLOAD_SYNC_TYPE_DRIVER_REQ = 0,
+	/* core tells the device where the next record starts */
+	TLS_OFFLOAD_SYNC_TYPE_CORE_NEXT_HINT = 1,
+};
+
+#define TLS_DEVICE_RESYNC_NH_START_IVAL		2
+#define TLS_DEVICE_RESYNC_NH_MAX_IVAL		128
+
 struct tls_offload_context_rx {
 	/* sw must be the first member of tls_offload_context_rx */
 	struct tls_sw_context_rx sw;
+	enum tls_offload_sync_type resync_type;
+	/* set regardless of resync_type, to avoid branches */
+	u8 resync_nh_reset:1;
+	/* CORE_NEXT_HINT only: hint once the parser sees the next header */
+	u8 resync_nh_do_now:1;
+	/* TLS_OFFLOAD_SYNC_TYPE_DRIVER_REQ */
 	atomic64_t resync_req;
+	/* TLS_OFFLOAD_SYNC_TYPE_CORE_NEXT_HINT */
+	struct {
+		u32 decrypted_failed;
+		u32 decrypted_tgt;
+	} resync_nh;
 	u8 driver_state[];
 	/* The TLS layer reserves room for driver specific state
 	 * Currently the belief is that there is not enough
@@ -469,6 +491,17 @@ static inline void tls_offload_rx_resync_request(struct sock *sk, __be32 seq)
 	atomic64_set(&rx_ctx->resync_req, ((((uint64_t)seq) << 32) | 1));
 }
 
+/* Called by the driver from tls_dev_add() for RX, before any data is
+ * received, to select how the record stream is re-synchronised.
+ */
+static inline void
+tls_offload_rx_resync_set_type(struct sock *sk, enum tls_offload_sync_type type)
+{
+	struct tls_context *tls_ctx = tls_get_ctx(sk);
+
+	tls_offload_ctx_rx(tls_ctx)->resync_type = type;
+}
+
 
 int tls_proccess_cmsg(struct sock *sk, struct msghdr *msg,
 		      unsigned char *record_type);
@@ -489,6 +522,6 @@ int tls_sw_fallback_init(struct sock *sk,
 int tls_set_device_offload_rx(struct sock *sk, struct tls_context *ctx);
 
 void tls_device_offload_cleanup_rx(struct sock *sk);
-void handle_device_resync(struct sock *sk, u32 seq, u64 rcd_sn);
+void handle_device_resync(struct sock *sk, u32 seq, u32 rcd_len);
 
 #endif /* _TLS_OFFLOAD_H */
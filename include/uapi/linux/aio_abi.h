@@ -50,9 +50,15 @@ enum {
  *
  * IOCB_FLAG_RESFD - Set if the "aio_resfd" member of the "struct iocb"
  *                   is valid.
+ * IOCB_FLAG_FIXED_BUF - "aio_buf" points into the buffer registered at
+ *                   io_setup2() time whose index is in "aio_reserved2".
+ * IOCB_FLAG_FIXED_FILE - "aio_fildes" is an index into the files
+ *                   registered at io_setup2() time.
  */
 #define IOCB_FLAG_RESFD		(1 << 0)
 #define IOCB_FLAG_IOPRIO	(1 << 1)
+#define IOCB_FLAG_FIXED_BUF	(1 << 2)
+#define IOCB_FLAG_FIXED_FILE	(1 << 3)
 
 /* read() from /dev/aio returns these structures. */
 struct io_event {
@@ -92,7 +98,8 @@ struct iocb {
 	__s64	aio_offset;
 
 	/* extra parameters */
-	__u64	aio_reserved2;	/* TODO: use this for a (struct sigevent *) */
+	__u64	aio_reserved2;	/* registered buffer index for
+				 * IOCB_FLAG_FIXED_BUF, must be 0 otherwise */
 
 	/* flags for the "struct iocb" */
 	__u32	aio_flags;
@@ -104,6 +111,71 @@ struct iocb {
 	__u32	aio_resfd;
 }; /* 64 bytes */
 
+/*
+ * Flags for io_setup2()
+ *
+ * IOCTX_FLAG_SQRING - Map a submission ring next to the completion ring.
+ *                     iocbs placed in it are submitted by io_ring_enter()
+ *                     without being copied in from user memory one by one.
+ * IOCTX_FLAG_SQPOLL - Start a kernel thread that polls the submission ring,
+ *                     so no system call is needed to submit I/O.
+ * IOCTX_FLAG_SQ_AFF - Bind the polling thread to sq_thread_cpu.
+ * IOCTX_FLAG_FIXEDBUFS - Pin the nr_bufs struct iovec buffers at "bufs"
+ *                     for the lifetime of the context, see
+ *                     IOCB_FLAG_FIXED_BUF.
+ * IOCTX_FLAG_FIXEDFILES - Take a reference to the nr_files file
+ *                     descriptors in the __s32 array at "files" for the
+ *                     lifetime of the context, see IOCB_FLAG_FIXED_FILE.
+ * IOCTX_FLAG_IOPOLL - Complete O_DIRECT reads and writes by polling the
+ *                     device from io_getevents() and io_ring_enter()
+ *                     instead of waiting for interrupts.  Only these
+ *                     operations are allowed, on files supporting it.
+ */
+#define IOCTX_FLAG_SQRING	(1 << 0)
+#define IOCTX_FLAG_SQPOLL	(1 << 1)
+#define IOCTX_FLAG_SQ_AFF	(1 << 2)
+#define IOCTX_FLAG_FIXEDBUFS	(1 << 3)
+#define IOCTX_FLAG_FIXEDFILES	(1 << 4)
+#define IOCTX_FLAG_IOPOLL	(1 << 5)
+
+/*
+ * Submission ring, mmap'ed at aio_setup2_params.sq_ring.  The application
+ * fills iocbs[tail & ring_mask] and then advances tail, the kernel consumes
+ * entries and advances head.
+ */
+struct aio_sq_ring {
+	__u32	head;		/* written by the kernel */
+	__u32	tail;		/* written by the application */
+	__u32	ring_mask;	/* nr_entries - 1 */
+	__u32	nr_entries;
+	__u32	flags;		/* AIO_SQ_* flags, written by the kernel */
+	__u32	dropped;	/* iocbs consumed but rejected at submission */
+	__u32	resv[10];
+
+	struct iocb	iocbs[0];
+}; /* 64 bytes + ring size */
+
+/* aio_sq_ring->flags */
+#define AIO_SQ_NEED_WAKEUP	(1 << 0)	/* poll thread went to sleep */
+
+struct aio_setup2_params {
+	__u32	sq_entries;	/* in: requested SQ size, out: actual size */
+	__u32	sq_thread_cpu;	/* IOCTX_FLAG_SQ_AFF: CPU of the poll thread */
+	__u32	sq_thread_idle;	/* ms the poll thread spins before sleeping */
+	__u32	resv1;
+	__u64	ctx_id;		/* out: aio_context_t of the new context */
+	__u64	sq_ring;	/* out: user address of struct aio_sq_ring */
+	__u64	bufs;		/* IOCTX_FLAG_FIXEDBUFS: struct iovec array */
+	__u64	files;		/* IOCTX_FLAG_FIXEDFILES: __s32 fd array */
+	__u32	nr_bufs;
+	__u32	nr_files;
+	__u64	resv2;
+};
+
+/* Flags for io_ring_enter() */
+#define AIO_ENTER_GETEVENTS	(1 << 0)	/* wait for min_complete events */
+#define AIO_ENTER_SQ_WAKEUP	(1 << 1)	/* wake up the SQ poll thread */
+
 #undef IFBIG
 #undef IFLITTLE
 
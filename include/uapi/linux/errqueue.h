@@ -27,6 +27,29 @@ struct sock_extended_err {
 
 #define SO_EE_CODE_ZEROCOPY_COPIED	1
 
+/* One MSG_ZEROCOPY completion, as reported by recvmsg(MSG_ERRQUEUE) */
+struct zerocopy_notif {
+	__u32	lo;
+	__u32	hi;
+	__u32	code;		/* SO_EE_CODE_ZEROCOPY_* */
+	__u32	reserved;
+};
+
+/**
+ *	struct zerocopy_notif_buf - MSG_ZEROCOPY completions reaped by sendmsg
+ *
+ *	A sendmsg() call carrying a SCM_ZEROCOPY_NOTIF cmsg, whose payload is
+ *	the (__u64) address of this structure, moves up to @nr pending
+ *	zerocopy notifications from the error queue into @notif and stores
+ *	the number of entries filled in @count. This saves the separate
+ *	recvmsg(MSG_ERRQUEUE) call otherwise needed to reap them.
+ */
+struct zerocopy_notif_buf {
+	__u32	nr;		/* in: number of entries in notif[] */
+	__u32	count;		/* out: number of entries filled */
+	struct zerocopy_notif notif[0];
+};
+
 #define SO_EE_CODE_TXTIME_INVALID_PARAM	1
 #define SO_EE_CODE_TXTIME_MISSED	2
 
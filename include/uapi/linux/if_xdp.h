@@ -16,6 +16,16 @@
 #define XDP_SHARED_UMEM	(1 << 0)
 #define XDP_COPY	(1 << 1) /* Force copy-mode */
 #define XDP_ZEROCOPY	(1 << 2) /* Force zero-copy mode */
+#define XDP_SG		(1 << 3) /* Packets may span several chunks */
+/* If this option is set, the driver might go sleep and in that case
+ * the XDP_RING_NEED_WAKEUP flag in the fill and/or Tx rings will be
+ * set. If it is set, the application need to explicitly wake up the
+ * driver with a poll() (Rx and Tx) or sendto() (Tx only). If you are
+ * running the driver and the application on the same core, you should
+ * use this option so that the kernel will yield to the user space
+ * application.
+ */
+#define XDP_USE_NEED_WAKEUP (1 << 4)
 
 struct sockaddr_xdp {
 	__u16 sxdp_family;
@@ -29,6 +39,7 @@ struct xdp_ring_offset {
 	__u64 producer;
 	__u64 consumer;
 	__u64 desc;
+	__u64 flags;
 };
 
 struct xdp_mmap_offsets {
@@ -38,6 +49,9 @@ struct xdp_mmap_offsets {
 	struct xdp_ring_offset cr; /* Completion */
 };
 
+/* Flags for the flags field of the rings */
+#define XDP_RING_NEED_WAKEUP (1 << 0)
+
 /* XDP socket options */
 #define XDP_MMAP_OFFSETS		1
 #define XDP_RX_RING			2
@@ -73,6 +87,13 @@ struct xdp_desc {
 	__u32 options;
 };
 
+/* Options for the options field of struct xdp_desc.
+ *
+ * XDP_PKT_CONTD is set on every descriptor of a packet but the last one,
+ * on sockets bound with XDP_SG.
+ */
+#define XDP_PKT_CONTD	(1 << 0)
+
 /* UMEM descriptor is __u64 */
 
 #endif /* _LINUX_IF_XDP_H */
@@ -8,6 +8,7 @@
 #define MFD_CLOEXEC		0x0001U
 #define MFD_ALLOW_SEALING	0x0002U
 #define MFD_HUGETLB		0x0004U
+#define MFD_HUGEPAGE		0x0008U	/* transparent huge pages, !MFD_HUGETLB */
 
 /*
  * Huge page size encoding when MFD_HUGETLB is specified, and a huge page
@@ -864,6 +864,10 @@ enum {
 
 	TCA_FQ_LOW_RATE_THRESHOLD, /* per packet delay under this rate */
 
+	TCA_FQ_TIMER_SLACK,	/* timer slack in ns */
+
+	TCA_FQ_WHEEL_LOG,	/* log2(timing wheel slots), 0 : rb-tree only */
+
 	__TCA_FQ_MAX
 };
 
@@ -9,6 +9,7 @@ struct sched_param {
 };
 
 #define SCHED_ATTR_SIZE_VER0	48	/* sizeof first published struct */
+#define SCHED_ATTR_SIZE_VER1	56	/* add: latency_nice */
 
 /*
  * Extended scheduling parameters data structure.
@@ -46,6 +47,10 @@ struct sched_param {
  *  @sched_runtime	representative of the task's runtime
  *  @sched_period	representative of the task's period
  *
+ * The @sched_latency_nice field, honoured when SCHED_FLAG_LATENCY_NICE is
+ * set, is a [-20, 19] hint of how much a SCHED_NORMAL/BATCH task cares
+ * about wakeup latency, independent of its nice value (i.e. CPU share).
+ *
  * Given this task model, there are a multiplicity of scheduling algorithms
  * and policies, that can be used to ensure all the tasks will make their
  * timing constraints.
@@ -70,6 +75,9 @@ struct sched_attr {
 	__u64 sched_runtime;
 	__u64 sched_deadline;
 	__u64 sched_period;
+
+	/* SCHED_NORMAL, SCHED_BATCH latency hint */
+	__s32 sched_latency_nice;
 };
 
 #endif /* _UAPI_LINUX_SCHED_TYPES_H */
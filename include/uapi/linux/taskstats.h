@@ -34,7 +34,7 @@
  */
 
 
-#define TASKSTATS_VERSION	9
+#define TASKSTATS_VERSION	10
 #define TS_COMM_LEN		32	/* should be >= TASK_COMM_LEN
 					 * in linux/sched.h */
 
@@ -168,6 +168,13 @@ struct taskstats {
 	/* Delay waiting for thrashing page */
 	__u64	thrashing_count;
 	__u64	thrashing_delay_total;
+
+	/* v10: current memory usage in KB, from the mm counters */
+	__u64	rss_anon;		/* resident anonymous memory */
+	__u64	rss_file;		/* resident file mappings */
+	__u64	rss_shmem;		/* resident shared memory */
+	__u64	swap_usage;		/* anonymous memory swapped out */
+	__u64	total_vm;		/* mapped virtual memory */
 };
 
 
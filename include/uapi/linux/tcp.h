@@ -294,9 +294,17 @@ struct tcp_diag_md5sig {
 
 /* setsockopt(fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, ...) */
 
+/* The mapping is known to be empty: no need to zap it (and flush the TLB) */
+#define TCP_RECEIVE_ZEROCOPY_FLAG_TLB_CLEAN_HINT 0x1
+
 struct tcp_zerocopy_receive {
 	__u64 address;		/* in: address of mapping */
 	__u32 length;		/* in/out: number of bytes to map/mapped */
 	__u32 recv_skip_hint;	/* out: amount of bytes to skip */
+	__u64 copybuf_address;	/* in: buffer for data that can't be mapped */
+	__s32 copybuf_len;	/* in/out: copybuf bytes avail/used */
+	__u32 copybuf_head;	/* out: copybuf bytes preceding the mapping */
+	__u32 flags;		/* in: TCP_RECEIVE_ZEROCOPY_FLAG_* */
+	__u32 reserved;		/* must be zero */
 };
 #endif /* _UAPI_LINUX_TCP_H */
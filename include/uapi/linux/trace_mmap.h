@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_TRACE_MMAP_H_
+#define _UAPI_TRACE_MMAP_H_
+
+#include <linux/types.h>
+
+/**
+ * struct trace_buffer_meta - first page of a mapped per CPU trace buffer
+ * @meta_page_size:	Size of this meta page.
+ * @meta_struct_len:	Size of this structure.
+ * @subbuf_size:	Size of each page of the buffer, header included.
+ * @nr_subbufs:		Number of pages in the buffer, the reader page included.
+ * @reader.lost_events:	Events overwritten before the reader page was taken.
+ * @reader.time_stamp:	Time stamp the event at @reader.read is relative to.
+ * @reader.id:		Page owned by the reader, mapped @reader.id + 1 pages in.
+ * @reader.read:	Offset in the page data of the first event handed out.
+ * @reader.commit:	Offset in the page data past the last event handed out.
+ * @entries:		Events in the buffer.
+ * @overrun:		Events lost to the writer wrapping around.
+ * @read:		Events consumed.
+ *
+ * The pages of the buffer follow this one in the mapping, ordered by id.
+ * They have the layout of the pages read from trace_pipe_raw, see
+ * events/header_page. Writers never touch the events of the reader page
+ * handed out: each TRACE_MMAP_IOCTL_GET_READER consumes the ones between
+ * @reader.read and @reader.commit, which user space then reads in place,
+ * and swaps a new reader page in from the buffer once the old one is done.
+ */
+struct trace_buffer_meta {
+	__u32	meta_page_size;
+	__u32	meta_struct_len;
+
+	__u32	subbuf_size;
+	__u32	nr_subbufs;
+
+	struct {
+		__u64	lost_events;
+		__u64	time_stamp;
+		__u32	id;
+		__u32	read;
+		__u32	commit;
+		__u32	__reserved;
+	} reader;
+
+	__u64	entries;
+	__u64	overrun;
+	__u64	read;
+};
+
+#define TRACE_MMAP_IOCTL_GET_READER	_IO('R', 0x20)
+
+#endif /* _UAPI_TRACE_MMAP_H_ */
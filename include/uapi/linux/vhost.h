@@ -44,7 +44,9 @@ struct vhost_vring_addr {
 	__u64 avail_user_addr;
 	/* Logging support. */
 	/* Log writes to used structure, at offset calculated from specified
-	 * address. Address must be 32 bit aligned. */
+	 * address. Address must be 32 bit aligned. With a packed ring the
+	 * device writes used descriptors into the descriptor ring, and this
+	 * is the guest address of the descriptor ring. */
 	__u64 log_guest_addr;
 };
 
@@ -91,6 +93,19 @@ struct vhost_memory_region {
 	__u64 flags_padding; /* No flags are currently specified. */
 };
 
+/* Worker ids are global, so that devices of one owner can share a worker. */
+struct vhost_worker_state {
+	/* Returned by VHOST_NEW_WORKER, passed in to VHOST_FREE_WORKER. */
+	unsigned int worker_id;
+};
+
+struct vhost_vring_worker {
+	/* vring index */
+	unsigned int index;
+	/* the worker the vring is to run on, as from VHOST_NEW_WORKER */
+	unsigned int worker_id;
+};
+
 /* All region addresses and sizes must be 4K aligned. */
 #define VHOST_PAGE_SIZE 0x1000
 
@@ -129,13 +144,25 @@ struct vhost_memory {
 /* Specify an eventfd file descriptor to signal on log write. */
 #define VHOST_SET_LOG_FD _IOW(VHOST_VIRTIO, 0x07, int)
 
+/* Workers. */
+/* Each device has a worker thread of its own, created by VHOST_SET_OWNER,
+ * which runs its vrings by default.  Create an extra worker, owned by this
+ * device until VHOST_FREE_WORKER or until the device is reset or closed. */
+#define VHOST_NEW_WORKER _IOR(VHOST_VIRTIO, 0x08, struct vhost_worker_state)
+/* Free a worker created by this device.  Fails with EBUSY while a vring
+ * still runs on it. */
+#define VHOST_FREE_WORKER _IOW(VHOST_VIRTIO, 0x09, struct vhost_worker_state)
+
 /* Ring setup. */
 /* Set number of descriptors in ring. This parameter can not
  * be modified while ring is running (bound to a device). */
 #define VHOST_SET_VRING_NUM _IOW(VHOST_VIRTIO, 0x10, struct vhost_vring_state)
 /* Set addresses for the ring. */
 #define VHOST_SET_VRING_ADDR _IOW(VHOST_VIRTIO, 0x11, struct vhost_vring_addr)
-/* Base value where queue looks for available descriptors */
+/* Base value where queue looks for available descriptors. With a packed
+ * ring, bits 0-14 of num are the next available descriptor and bit 15 its
+ * wrap counter, bits 16-30 the next used descriptor and bit 31 its wrap
+ * counter. */
 #define VHOST_SET_VRING_BASE _IOW(VHOST_VIRTIO, 0x12, struct vhost_vring_state)
 /* Get accessor: reads index, writes value in num */
 #define VHOST_GET_VRING_BASE _IOWR(VHOST_VIRTIO, 0x12, struct vhost_vring_state)
@@ -153,6 +180,14 @@ struct vhost_memory {
 #define VHOST_VRING_BIG_ENDIAN 1
 #define VHOST_SET_VRING_ENDIAN _IOW(VHOST_VIRTIO, 0x13, struct vhost_vring_state)
 #define VHOST_GET_VRING_ENDIAN _IOW(VHOST_VIRTIO, 0x14, struct vhost_vring_state)
+/* Run a vring on a worker made by VHOST_NEW_WORKER, on this device or on
+ * another device with the same owner, or on the device worker again.
+ * Only supported by vhost-net for now. */
+#define VHOST_ATTACH_VRING_WORKER _IOW(VHOST_VIRTIO, 0x15,		\
+				       struct vhost_vring_worker)
+/* Get the id of the worker a vring runs on. */
+#define VHOST_GET_VRING_WORKER _IOWR(VHOST_VIRTIO, 0x16,		\
+				     struct vhost_vring_worker)
 
 /* The following ioctls use eventfd file descriptors to signal and poll
  * for events. */
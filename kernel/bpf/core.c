@@ -1861,6 +1861,11 @@ const struct bpf_func_proto bpf_map_delete_elem_proto __weak;
 const struct bpf_func_proto bpf_map_push_elem_proto __weak;
 const struct bpf_func_proto bpf_map_pop_elem_proto __weak;
 const struct bpf_func_proto bpf_map_peek_elem_proto __weak;
+const struct bpf_func_proto bpf_ringbuf_output_proto __weak;
+const struct bpf_func_proto bpf_ringbuf_reserve_proto __weak;
+const struct bpf_func_proto bpf_ringbuf_submit_proto __weak;
+const struct bpf_func_proto bpf_ringbuf_discard_proto __weak;
+const struct bpf_func_proto bpf_ringbuf_query_proto __weak;
 
 const struct bpf_func_proto bpf_get_prandom_u32_proto __weak;
 const struct bpf_func_proto bpf_get_smp_processor_id_proto __weak;
@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * dispatcher.c: direct jumps to BPF programs in place of the indirect
+ * call through bpf_func
+ */
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <linux/ftrace.h>
+#include <linux/moduleloader.h>
+
+/*
+ * An indirect call is expensive when retpolines are enabled. A dispatch
+ * client such as XDP registers the programs it runs, and the dispatcher
+ * generates an image comparing the called bpf_func against each of them
+ * and jumping straight to the match. The client calls its programs
+ * through a dispatcher function, see DEFINE_BPF_DISPATCHER():
+ *
+ * unsigned int func(const void *ctx, const struct bpf_insn *insnsi,
+ *		     unsigned int (*bpf_func)(const void *,
+ *					      const struct bpf_insn *));
+ *
+ * The ftrace site of that function is turned into a direct call to the
+ * image with register_ftrace_direct(). If that fails, or with more than
+ * BPF_DISPATCHER_MAX programs, the function keeps doing the indirect call.
+ * Without direct call support in ftrace the dispatcher is not built at
+ * all and the clients call bpf_func themselves.
+ */
+
+static struct bpf_dispatcher_prog *bpf_dispatcher_find_prog(
+	struct bpf_dispatcher *d, struct bpf_prog *prog)
+{
+	int i;
+
+	for (i = 0; i < BPF_DISPATCHER_MAX; i++) {
+		if (prog == d->progs[i].prog)
+			return &d->progs[i];
+	}
+	return NULL;
+}
+
+static struct bpf_dispatcher_prog *bpf_dispatcher_find_free(
+	struct bpf_dispatcher *d)
+{
+	return bpf_dispatcher_find_prog(d, NULL);
+}
+
+static bool bpf_dispatcher_add_prog(struct bpf_dispatcher *d,
+				    struct bpf_prog *prog)
+{
+	struct bpf_dispatcher_prog *entry;
+
+	if (!prog)
+		return false;
+
+	entry = bpf_dispatcher_find_prog(d, prog);
+	if (entry) {
+		refcount_inc(&entry->users);
+		return false;
+	}
+
+	entry = bpf_dispatcher_find_free(d);
+	if (!entry)
+		return false;
+
+	if (IS_ERR(bpf_prog_inc(prog)))
+		return false;
+	entry->prog = prog;
+	refcount_set(&entry->users, 1);
+	d->num_progs++;
+	return true;
+}
+
+static bool bpf_dispatcher_remove_prog(struct bpf_dispatcher *d,
+				       struct bpf_prog *prog)
+{
+	struct bpf_dispatcher_prog *entry;
+
+	if (!prog)
+		return false;
+
+	entry = bpf_dispatcher_find_prog(d, prog);
+	if (!entry)
+		return false;
+
+	if (refcount_dec_and_test(&entry->users)) {
+		entry->prog = NULL;
+		bpf_prog_put(prog);
+		d->num_progs--;
+		return true;
+	}
+	return false;
+}
+
+int __weak arch_prepare_bpf_dispatcher(void *image, s64 *funcs, int num_funcs)
+{
+	return -ENOTSUPP;
+}
+
+static int bpf_dispatcher_prepare(struct bpf_dispatcher *d, void *image)
+{
+	s64 ips[BPF_DISPATCHER_MAX] = {}, *ipsp = &ips[0];
+	int i;
+
+	for (i = 0; i < BPF_DISPATCHER_MAX; i++) {
+		if (d->progs[i].prog)
+			*ipsp++ = (s64)(uintptr_t)d->progs[i].prog->bpf_func;
+	}
+	return arch_prepare_bpf_dispatcher(image, &ips[0], d->num_progs);
+}
+
+static void bpf_dispatcher_update(struct bpf_dispatcher *d)
+{
+	unsigned long func = (unsigned long)d->func;
+	void *old = d->live_image, *new = NULL;
+	int err;
+
+	if (d->num_progs) {
+		/* Write the half not in use. All callers run the dispatcher
+		 * under rcu_read_lock(), so after a grace period nobody is
+		 * left in it from the time it was live.
+		 */
+		new = old == d->image ? d->image + PAGE_SIZE / 2 : d->image;
+		synchronize_rcu();
+		if (bpf_dispatcher_prepare(d, new))
+			return;
+	}
+
+	if (!old && !new)
+		return;
+	if (!old)
+		err = register_ftrace_direct(func, (unsigned long)new);
+	else if (new)
+		err = modify_ftrace_direct(func, (unsigned long)old,
+					   (unsigned long)new);
+	else
+		err = unregister_ftrace_direct(func, (unsigned long)old);
+
+	/* if the site cannot take a direct call, the function stays indirect */
+	if (err) {
+		WARN_ON_ONCE(err != -ENOTSUPP);
+		return;
+	}
+	d->live_image = new;
+}
+
+void bpf_dispatcher_change_prog(struct bpf_dispatcher *d, struct bpf_prog *from,
+				struct bpf_prog *to)
+{
+	bool changed = false;
+
+	if (from == to)
+		return;
+
+	mutex_lock(&d->mutex);
+	if (!d->image) {
+		d->image = module_alloc(PAGE_SIZE);
+		if (!d->image)
+			goto out;
+		set_memory_x((unsigned long)d->image, 1);
+	}
+
+	changed |= bpf_dispatcher_remove_prog(d, from);
+	changed |= bpf_dispatcher_add_prog(d, to);
+
+	if (!changed)
+		goto out;
+
+	bpf_dispatcher_update(d);
+out:
+	mutex_unlock(&d->mutex);
+}
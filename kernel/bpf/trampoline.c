@@ -0,0 +1,317 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * trampoline.c: per kernel function trampolines running fentry and fexit
+ * BPF programs, called straight from the function's ftrace site
+ */
+#include <linux/hash.h>
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <linux/ftrace.h>
+#include <linux/moduleloader.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+
+#define TRAMPOLINE_HASH_BITS 10
+#define TRAMPOLINE_TABLE_SIZE (1 << TRAMPOLINE_HASH_BITS)
+
+static struct hlist_head trampoline_table[TRAMPOLINE_TABLE_SIZE];
+
+/* serializes access to trampoline_table */
+static DEFINE_MUTEX(trampoline_mutex);
+
+static void bpf_tramp_orig_release(struct percpu_ref *ref)
+{
+	struct bpf_tramp_orig *orig;
+
+	orig = container_of(ref, struct bpf_tramp_orig, ref);
+	complete(&orig->done);
+}
+
+/* Wait for the tasks still inside the traced function called from image
+ * half @i. Returns false if that half never called it.
+ */
+static bool bpf_trampoline_drain_orig(struct bpf_trampoline *tr, int i)
+{
+	struct bpf_tramp_orig *orig = &tr->orig[i];
+
+	if (!orig->used)
+		return false;
+	orig->used = false;
+	percpu_ref_kill(&orig->ref);
+	wait_for_completion(&orig->done);
+	reinit_completion(&orig->done);
+	percpu_ref_reinit(&orig->ref);
+	return true;
+}
+
+static struct bpf_trampoline *bpf_trampoline_lookup(unsigned long ip)
+{
+	struct bpf_trampoline *tr;
+	struct hlist_head *head;
+	void *image;
+	int i;
+
+	mutex_lock(&trampoline_mutex);
+	head = &trampoline_table[hash_long(ip, TRAMPOLINE_HASH_BITS)];
+	hlist_for_each_entry(tr, head, hlist) {
+		if (tr->ip == ip) {
+			refcount_inc(&tr->refcnt);
+			goto out;
+		}
+	}
+	tr = kzalloc(sizeof(*tr), GFP_KERNEL);
+	if (!tr)
+		goto out;
+
+	/* One page, used as two halves: see bpf_trampoline_update() */
+	image = module_alloc(PAGE_SIZE);
+	if (!image) {
+		kfree(tr);
+		tr = NULL;
+		goto out;
+	}
+	set_memory_x((unsigned long)image, 1);
+
+	for (i = 0; i < ARRAY_SIZE(tr->orig); i++) {
+		init_completion(&tr->orig[i].done);
+		if (percpu_ref_init(&tr->orig[i].ref, bpf_tramp_orig_release,
+				    0, GFP_KERNEL)) {
+			while (i--)
+				percpu_ref_exit(&tr->orig[i].ref);
+			set_memory_nx((unsigned long)image, 1);
+			module_memfree(image);
+			kfree(tr);
+			tr = NULL;
+			goto out;
+		}
+	}
+
+	tr->ip = ip;
+	tr->image = image;
+	INIT_HLIST_NODE(&tr->hlist);
+	hlist_add_head(&tr->hlist, head);
+	refcount_set(&tr->refcnt, 1);
+	mutex_init(&tr->mutex);
+	for (i = 0; i < BPF_TRAMP_MAX; i++)
+		INIT_HLIST_HEAD(&tr->progs_hlist[i]);
+out:
+	mutex_unlock(&trampoline_mutex);
+	return tr;
+}
+
+static void bpf_trampoline_put(struct bpf_trampoline *tr)
+{
+	bool drained;
+
+	mutex_lock(&trampoline_mutex);
+	if (!refcount_dec_and_test(&tr->refcnt))
+		goto out;
+	WARN_ON_ONCE(mutex_is_locked(&tr->mutex));
+	if (WARN_ON_ONCE(!hlist_empty(&tr->progs_hlist[BPF_TRAMP_FENTRY])))
+		goto out;
+	if (WARN_ON_ONCE(!hlist_empty(&tr->progs_hlist[BPF_TRAMP_FEXIT])))
+		goto out;
+	/* the ftrace site is gone, wait for tasks still inside the image,
+	 * then for those that were asleep in the traced function to return
+	 * through it
+	 */
+	synchronize_rcu_tasks();
+	drained = bpf_trampoline_drain_orig(tr, 0);
+	drained |= bpf_trampoline_drain_orig(tr, 1);
+	if (drained)
+		synchronize_rcu_tasks();
+	percpu_ref_exit(&tr->orig[0].ref);
+	percpu_ref_exit(&tr->orig[1].ref);
+	hlist_del(&tr->hlist);
+	set_memory_nx((unsigned long)tr->image, 1);
+	module_memfree(tr->image);
+	kfree(tr);
+out:
+	mutex_unlock(&trampoline_mutex);
+}
+
+/* Regenerate the image of @tr from its program lists, and point the ftrace
+ * site of the traced function at it. Called with tr->mutex held.
+ */
+static int bpf_trampoline_update(struct bpf_trampoline *tr)
+{
+	void *old_image = tr->image + ((tr->selector + 1) & 1) * PAGE_SIZE / 2;
+	void *new_image = tr->image + (tr->selector & 1) * PAGE_SIZE / 2;
+	struct bpf_prog *progs_to_run[BPF_MAX_TRAMP_PROGS];
+	int fentry_cnt = tr->progs_cnt[BPF_TRAMP_FENTRY];
+	int fexit_cnt = tr->progs_cnt[BPF_TRAMP_FEXIT];
+	struct bpf_prog **progs, **fentry, **fexit;
+	u32 flags = BPF_TRAMP_F_RESTORE_REGS;
+	struct bpf_prog_aux *aux;
+	int err;
+
+	if (fentry_cnt + fexit_cnt == 0) {
+		err = unregister_ftrace_direct(tr->ip, (unsigned long)old_image);
+		tr->selector = 0;
+		return err;
+	}
+
+	/* populate fentry progs */
+	fentry = progs = progs_to_run;
+	hlist_for_each_entry(aux, &tr->progs_hlist[BPF_TRAMP_FENTRY], tramp_hlist)
+		*progs++ = aux->prog;
+
+	/* populate fexit progs */
+	fexit = progs;
+	hlist_for_each_entry(aux, &tr->progs_hlist[BPF_TRAMP_FEXIT], tramp_hlist)
+		*progs++ = aux->prog;
+
+	if (fexit_cnt)
+		flags = BPF_TRAMP_F_CALL_ORIG | BPF_TRAMP_F_SKIP_FRAME;
+
+	/*
+	 * The half about to be rewritten was the live image two updates
+	 * ago. A task preempted inside it could still be running there, so
+	 * wait until every task has scheduled voluntarily. A task sleeping
+	 * in the traced function called from there has done so too, but
+	 * still returns into the half: wait for it, and for it to get out
+	 * of the code following the call.
+	 */
+	synchronize_rcu_tasks();
+	if (bpf_trampoline_drain_orig(tr, tr->selector & 1))
+		synchronize_rcu_tasks();
+
+	err = arch_prepare_bpf_trampoline(new_image, new_image + PAGE_SIZE / 2,
+					  tr->nr_args, flags,
+					  fentry, fentry_cnt,
+					  fexit, fexit_cnt,
+					  (void *)tr->ip,
+					  &tr->orig[tr->selector & 1].ref);
+	if (err < 0)
+		return err;
+	tr->orig[tr->selector & 1].used = !!fexit_cnt;
+
+	if (tr->selector)
+		/* progs already running at this address */
+		err = modify_ftrace_direct(tr->ip, (unsigned long)old_image,
+					   (unsigned long)new_image);
+	else
+		/* first time registering */
+		err = register_ftrace_direct(tr->ip, (unsigned long)new_image);
+	if (err)
+		return err;
+
+	tr->selector++;
+	return 0;
+}
+
+static enum bpf_tramp_prog_type bpf_attach_type_to_tramp(enum bpf_attach_type t)
+{
+	switch (t) {
+	case BPF_TRACE_FENTRY:
+		return BPF_TRAMP_FENTRY;
+	default:
+		return BPF_TRAMP_FEXIT;
+	}
+}
+
+int bpf_trampoline_link_prog(struct bpf_prog *prog)
+{
+	enum bpf_tramp_prog_type kind;
+	struct bpf_prog_aux *aux = prog->aux;
+	struct bpf_trampoline *tr;
+	int err = 0;
+
+	if (aux->trampoline)
+		return -EBUSY;
+
+	tr = bpf_trampoline_lookup(aux->attach_func_addr);
+	if (!tr)
+		return -ENOMEM;
+
+	kind = bpf_attach_type_to_tramp(prog->expected_attach_type);
+	mutex_lock(&tr->mutex);
+	if (tr->progs_cnt[BPF_TRAMP_FENTRY] + tr->progs_cnt[BPF_TRAMP_FEXIT]
+	    >= BPF_MAX_TRAMP_PROGS) {
+		err = -E2BIG;
+		goto out;
+	}
+	/* all programs of a trampoline share one context layout */
+	if (tr->progs_cnt[BPF_TRAMP_FENTRY] + tr->progs_cnt[BPF_TRAMP_FEXIT]) {
+		if (tr->nr_args != aux->attach_func_nr_args) {
+			err = -EINVAL;
+			goto out;
+		}
+	} else {
+		tr->nr_args = aux->attach_func_nr_args;
+	}
+	hlist_add_head(&aux->tramp_hlist, &tr->progs_hlist[kind]);
+	tr->progs_cnt[kind]++;
+	err = bpf_trampoline_update(tr);
+	if (err) {
+		hlist_del_init(&aux->tramp_hlist);
+		tr->progs_cnt[kind]--;
+	}
+out:
+	mutex_unlock(&tr->mutex);
+	if (err)
+		bpf_trampoline_put(tr);
+	else
+		aux->trampoline = tr;
+	return err;
+}
+
+int bpf_trampoline_unlink_prog(struct bpf_prog *prog)
+{
+	enum bpf_tramp_prog_type kind;
+	struct bpf_prog_aux *aux = prog->aux;
+	struct bpf_trampoline *tr = aux->trampoline;
+	int err;
+
+	if (!tr)
+		return -ENOENT;
+
+	kind = bpf_attach_type_to_tramp(prog->expected_attach_type);
+	mutex_lock(&tr->mutex);
+	hlist_del_init(&aux->tramp_hlist);
+	tr->progs_cnt[kind]--;
+	err = bpf_trampoline_update(tr);
+	mutex_unlock(&tr->mutex);
+
+	aux->trampoline = NULL;
+	bpf_trampoline_put(tr);
+	return err;
+}
+
+/* The logic is similar to trace_call_bpf(): a program that ends up calling
+ * a traced function again does not recurse into BPF.
+ */
+u32 notrace __bpf_prog_enter(void)
+{
+	preempt_disable();
+	rcu_read_lock();
+	return __this_cpu_inc_return(bpf_prog_active) == 1;
+}
+
+void notrace __bpf_prog_exit(void)
+{
+	__this_cpu_dec(bpf_prog_active);
+	rcu_read_unlock();
+	preempt_enable();
+}
+
+/* Bracket the call of the traced function, see bpf_trampoline_update() */
+void notrace __bpf_tramp_enter(struct percpu_ref *orig_ref)
+{
+	percpu_ref_get(orig_ref);
+}
+
+void notrace __bpf_tramp_exit(struct percpu_ref *orig_ref)
+{
+	percpu_ref_put(orig_ref);
+}
+
+int __weak
+arch_prepare_bpf_trampoline(void *image, void *image_end, u32 nr_args,
+			    u32 flags, struct bpf_prog **fentry_progs,
+			    int fentry_cnt, struct bpf_prog **fexit_progs,
+			    int fexit_cnt, void *orig_call,
+			    struct percpu_ref *orig_ref)
+{
+	return -ENOTSUPP;
+}
@@ -926,6 +926,49 @@ static inline int perf_cgroup_connect(int fd, struct perf_event *event,
 	return ret;
 }
 
+/*
+ * Make room in the cpu contexts of @pmu to merge the groups of every level
+ * of the cgroup hierarchy down to @event's, see visit_groups_merge().
+ */
+static int perf_cgroup_ensure_storage(struct perf_event *event,
+				      struct pmu *pmu)
+{
+	struct cgroup_subsys_state *css = &event->cgrp->css;
+	struct perf_cpu_context *cpuctx;
+	struct perf_event **storage;
+	int cpu, heap_size, ret = 0;
+
+	/* one iterator per cgroup level plus one for the non-cgroup events */
+	for (heap_size = 1; css; css = css->parent)
+		heap_size++;
+
+	for_each_possible_cpu(cpu) {
+		cpuctx = per_cpu_ptr(pmu->pmu_cpu_context, cpu);
+		if (heap_size <= cpuctx->heap_size)
+			continue;
+
+		storage = kmalloc_array_node(heap_size, sizeof(*storage),
+					     GFP_KERNEL, cpu_to_node(cpu));
+		if (!storage) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		raw_spin_lock_irq(&cpuctx->ctx.lock);
+		if (cpuctx->heap_size < heap_size) {
+			swap(cpuctx->heap, storage);
+			if (storage == cpuctx->heap_default)
+				storage = NULL;
+			cpuctx->heap_size = heap_size;
+		}
+		raw_spin_unlock_irq(&cpuctx->ctx.lock);
+
+		kfree(storage);
+	}
+
+	return ret;
+}
+
 static inline void
 perf_cgroup_set_shadow_time(struct perf_event *event, u64 now)
 {
@@ -1024,6 +1067,12 @@ static inline int perf_cgroup_connect(pid_t pid, struct perf_event *event,
 	return -EINVAL;
 }
 
+static inline int perf_cgroup_ensure_storage(struct perf_event *event,
+					     struct pmu *pmu)
+{
+	return 0;
+}
+
 static inline void
 perf_cgroup_set_timestamp(struct task_struct *task,
 			  struct perf_event_context *ctx)
@@ -1514,20 +1563,57 @@ static void perf_event_groups_init(struct perf_event_groups *groups)
 	groups->index = 0;
 }
 
+static inline struct cgroup *event_cgroup(const struct perf_event *event)
+{
+	struct cgroup *cgroup = NULL;
+
+#ifdef CONFIG_CGROUP_PERF
+	if (event->cgrp)
+		cgroup = event->cgrp->css.cgroup;
+#endif
+
+	return cgroup;
+}
+
+/*
+ * Order cgroups by id, with the NULL cgroup (events that are not cgroup
+ * events) first.
+ */
+static inline int perf_event_groups_cmp_cgroup(struct cgroup *left,
+					       struct cgroup *right)
+{
+	if (left == right)
+		return 0;
+	if (!left)
+		return -1;
+	if (!right)
+		return 1;
+
+	return left->kn->id.id < right->kn->id.id ? -1 : 1;
+}
+
 /*
  * Compare function for event groups;
  *
- * Implements complex key that first sorts by CPU and then by virtual index
- * which provides ordering when rotating groups for the same CPU.
+ * Implements complex key that first sorts by CPU, then by cgroup and then by
+ * virtual index which provides ordering when rotating groups for the same
+ * CPU and cgroup. Scheduling in a cgroup only needs its own subtree.
  */
 static bool
 perf_event_groups_less(struct perf_event *left, struct perf_event *right)
 {
+	int cmp;
+
 	if (left->cpu < right->cpu)
 		return true;
 	if (left->cpu > right->cpu)
 		return false;
 
+	cmp = perf_event_groups_cmp_cgroup(event_cgroup(left),
+					   event_cgroup(right));
+	if (cmp)
+		return cmp < 0;
+
 	if (left->group_index < right->group_index)
 		return true;
 	if (left->group_index > right->group_index)
@@ -1537,9 +1623,9 @@ perf_event_groups_less(struct perf_event *left, struct perf_event *right)
 }
 
 /*
- * Insert @event into @groups' tree; using {@event->cpu, ++@groups->index} for
- * key (see perf_event_groups_less). This places it last inside the CPU
- * subtree.
+ * Insert @event into @groups' tree; using {@event->cpu, @event's cgroup,
+ * ++@groups->index} for key (see perf_event_groups_less). This places it last
+ * inside the CPU and cgroup subtree.
  */
 static void
 perf_event_groups_insert(struct perf_event_groups *groups,
@@ -1607,20 +1693,33 @@ del_event_from_groups(struct perf_event *event, struct perf_event_context *ctx)
 }
 
 /*
- * Get the leftmost event in the @cpu subtree.
+ * Get the leftmost event in the @cpu, @cgroup subtree.
  */
 static struct perf_event *
-perf_event_groups_first(struct perf_event_groups *groups, int cpu)
+perf_event_groups_first(struct perf_event_groups *groups, int cpu,
+			struct cgroup *cgroup)
 {
 	struct perf_event *node_event = NULL, *match = NULL;
 	struct rb_node *node = groups->tree.rb_node;
+	int cmp;
 
 	while (node) {
 		node_event = container_of(node, struct perf_event, group_node);
 
 		if (cpu < node_event->cpu) {
 			node = node->rb_left;
-		} else if (cpu > node_event->cpu) {
+			continue;
+		}
+		if (cpu > node_event->cpu) {
+			node = node->rb_right;
+			continue;
+		}
+
+		cmp = perf_event_groups_cmp_cgroup(cgroup,
+						   event_cgroup(node_event));
+		if (cmp < 0) {
+			node = node->rb_left;
+		} else if (cmp > 0) {
 			node = node->rb_right;
 		} else {
 			match = node_event;
@@ -1632,7 +1731,7 @@ perf_event_groups_first(struct perf_event_groups *groups, int cpu)
 }
 
 /*
- * Like rb_entry_next_safe() for the @cpu subtree.
+ * Like rb_entry_next_safe() for the @cpu, @cgroup subtree.
  */
 static struct perf_event *
 perf_event_groups_next(struct perf_event *event)
@@ -1640,7 +1739,8 @@ perf_event_groups_next(struct perf_event *event)
 	struct perf_event *next;
 
 	next = rb_entry_safe(rb_next(&event->group_node), typeof(*event), group_node);
-	if (next && next->cpu == event->cpu)
+	if (next && next->cpu == event->cpu &&
+	    event_cgroup(next) == event_cgroup(event))
 		return next;
 
 	return NULL;
@@ -3233,32 +3333,67 @@ static void cpu_ctx_sched_out(struct perf_cpu_context *cpuctx,
 	ctx_sched_out(&cpuctx->ctx, cpuctx, event_type);
 }
 
-static int visit_groups_merge(struct perf_event_groups *groups, int cpu,
+/*
+ * Visit the groups that can run on @cpu in group_index order: the ones of
+ * any CPU for a task context, else the ones without a cgroup together with
+ * the subtrees of the current cgroup of @cpuctx and its ancestors. Groups of
+ * other cgroups are not looked at.
+ */
+static int visit_groups_merge(struct perf_cpu_context *cpuctx,
+			      struct perf_event_groups *groups, int cpu,
 			      int (*func)(struct perf_event *, void *), void *data)
 {
-	struct perf_event **evt, *evt1, *evt2;
-	int ret;
+#ifdef CONFIG_CGROUP_PERF
+	struct cgroup_subsys_state *css = NULL;
+#endif
+	struct perf_event *itrs[2], **evts, *evt;
+	int nr = 0, max, i, min, ret;
 
-	evt1 = perf_event_groups_first(groups, -1);
-	evt2 = perf_event_groups_first(groups, cpu);
-
-	while (evt1 || evt2) {
-		if (evt1 && evt2) {
-			if (evt1->group_index < evt2->group_index)
-				evt = &evt1;
-			else
-				evt = &evt2;
-		} else if (evt1) {
-			evt = &evt1;
-		} else {
-			evt = &evt2;
+	if (cpuctx) {
+		lockdep_assert_held(&cpuctx->ctx.lock);
+		evts = cpuctx->heap;
+		max = cpuctx->heap_size;
+#ifdef CONFIG_CGROUP_PERF
+		if (cpuctx->cgrp)
+			css = &cpuctx->cgrp->css;
+#endif
+	} else {
+		evts = itrs;
+		max = ARRAY_SIZE(itrs);
+		/* Events not within a CPU context may be on any CPU. */
+		evt = perf_event_groups_first(groups, -1, NULL);
+		if (evt)
+			evts[nr++] = evt;
+	}
+
+	evt = perf_event_groups_first(groups, cpu, NULL);
+	if (evt)
+		evts[nr++] = evt;
+
+#ifdef CONFIG_CGROUP_PERF
+	for (; css; css = css->parent) {
+		evt = perf_event_groups_first(groups, cpu, css->cgroup);
+		if (!evt)
+			continue;
+		if (WARN_ON_ONCE(nr == max))
+			break;
+		evts[nr++] = evt;
+	}
+#endif
+
+	while (nr) {
+		for (min = 0, i = 1; i < nr; i++) {
+			if (evts[i]->group_index < evts[min]->group_index)
+				min = i;
 		}
 
-		ret = func(*evt, data);
+		ret = func(evts[min], data);
 		if (ret)
 			return ret;
 
-		*evt = perf_event_groups_next(*evt);
+		evts[min] = perf_event_groups_next(evts[min]);
+		if (!evts[min])
+			evts[min] = evts[--nr];
 	}
 
 	return 0;
@@ -3325,7 +3460,8 @@ ctx_pinned_sched_in(struct perf_event_context *ctx,
 		.can_add_hw = 1,
 	};
 
-	visit_groups_merge(&ctx->pinned_groups,
+	visit_groups_merge(ctx == &cpuctx->ctx ? cpuctx : NULL,
+			   &ctx->pinned_groups,
 			   smp_processor_id(),
 			   pinned_sched_in, &sid);
 }
@@ -3340,7 +3476,8 @@ ctx_flexible_sched_in(struct perf_event_context *ctx,
 		.can_add_hw = 1,
 	};
 
-	visit_groups_merge(&ctx->flexible_groups,
+	visit_groups_merge(ctx == &cpuctx->ctx ? cpuctx : NULL,
+			   &ctx->flexible_groups,
 			   smp_processor_id(),
 			   flexible_sched_in, &sid);
 }
@@ -9454,6 +9591,8 @@ static struct perf_cpu_context __percpu *find_pmu_context(int ctxn)
 
 static void free_pmu_context(struct pmu *pmu)
 {
+	int cpu;
+
 	/*
 	 * Static contexts such as perf_sw_context have a global lifetime
 	 * and may be shared between different PMUs. Avoid freeing them
@@ -9462,6 +9601,13 @@ static void free_pmu_context(struct pmu *pmu)
 	if (pmu->task_ctx_nr > perf_invalid_context)
 		return;
 
+	for_each_possible_cpu(cpu) {
+		struct perf_cpu_context *cpuctx;
+
+		cpuctx = per_cpu_ptr(pmu->pmu_cpu_context, cpu);
+		if (cpuctx->heap != cpuctx->heap_default)
+			kfree(cpuctx->heap);
+	}
 	free_percpu(pmu->pmu_cpu_context);
 }
 
@@ -9666,6 +9812,9 @@ int perf_pmu_register(struct pmu *pmu, const char *name, int type)
 		cpuctx->online = cpumask_test_cpu(cpu, perf_online_mask);
 
 		__perf_mux_hrtimer_init(cpuctx, cpu);
+
+		cpuctx->heap_size = ARRAY_SIZE(cpuctx->heap_default);
+		cpuctx->heap = cpuctx->heap_default;
 	}
 
 got_cpu_context:
@@ -10590,6 +10739,12 @@ SYSCALL_DEFINE5(perf_event_open,
 		goto err_alloc;
 	}
 
+	if (is_cgroup_event(event)) {
+		err = perf_cgroup_ensure_storage(event, ctx->pmu);
+		if (err)
+			goto err_context;
+	}
+
 	if ((pmu->capabilities & PERF_PMU_CAP_EXCLUSIVE) && group_leader) {
 		err = -EBUSY;
 		goto err_context;
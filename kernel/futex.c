@@ -277,6 +277,12 @@ static struct {
 #define futex_queues   (__futex_data.queues)
 #define futex_hashsize (__futex_data.hashsize)
 
+/*
+ * Number of buckets in the per-process hash of a multi-threaded process,
+ * 0 keeps all private futexes in the global hash.
+ */
+int sysctl_futex_private_hash __read_mostly;
+
 
 /*
  * Fault injections for futexes.
@@ -388,16 +394,79 @@ static inline int hb_waiters_pending(struct futex_hash_bucket *hb)
  * @key:	Pointer to the futex key for which the hash is calculated
  *
  * We hash on the keys returned from get_futex_key (see below) and return the
- * corresponding hash bucket in the global hash.
+ * corresponding hash bucket in the global hash, or in the private hash of
+ * the mm for process private futexes when it has one.
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
+
+	if (!(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED))) {
+		struct mm_struct *mm = key->private.mm;
+
+		if (mm->futex_queues)
+			return &mm->futex_queues[hash & (mm->futex_hashsize - 1)];
+	}
 	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
+static void futex_hash_init(struct futex_hash_bucket *fhb, unsigned long size)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i++) {
+		atomic_set(&fhb[i].waiters, 0);
+		plist_head_init(&fhb[i].chain);
+		spin_lock_init(&fhb[i].lock);
+	}
+}
+
+void futex_mm_init(struct mm_struct *mm)
+{
+	mm->futex_queues = NULL;
+	mm->futex_hashsize = 0;
+}
+
+/**
+ * futex_hash_alloc - Give a process that is going multi-threaded its own hash
+ * @mm:		The mm about to be shared by a CLONE_VM child
+ *
+ * Private futexes of unrelated processes then no longer contend on the
+ * buckets of the global hash, and the buckets are allocated on the node
+ * the process starts out on.
+ *
+ * The hash is only installed while the caller is the sole user of @mm: no
+ * other task can be queued on, or about to hash, a private futex of @mm,
+ * so waiters and wakers can never end up looking at different tables.
+ */
+void futex_hash_alloc(struct mm_struct *mm)
+{
+	struct futex_hash_bucket *fhb;
+	unsigned long size;
+
+	if (!sysctl_futex_private_hash || mm->futex_queues ||
+	    atomic_read(&mm->mm_users) != 1)
+		return;
+
+	size = roundup_pow_of_two(sysctl_futex_private_hash);
+	fhb = kvmalloc_node(size * sizeof(*fhb), GFP_KERNEL_ACCOUNT,
+			    numa_node_id());
+	if (!fhb)
+		return;
+
+	futex_hash_init(fhb, size);
+	mm->futex_hashsize = size;
+	mm->futex_queues = fhb;
+}
+
+void futex_hash_free(struct mm_struct *mm)
+{
+	kvfree(mm->futex_queues);
+	mm->futex_queues = NULL;
+}
+
 
 /**
  * match_futex - Check whether two futex keys are equal
@@ -2698,6 +2767,208 @@ static long futex_wait_restart(struct restart_block *restart)
 				restart->futex.val, tp, restart->futex.bitset);
 }
 
+/**
+ * unqueue_multiple() - Remove several futex_qs from their hash buckets
+ * @qs:		the futex_qs to unqueue
+ * @count:	the number of futex_qs in @qs
+ *
+ * Like unqueue_me(), this drops the key references of all @qs.
+ *
+ * Return:
+ *  - >=0 - the lowest index of a futex_q that had already been woken;
+ *  - -1  - if all the futex_qs were still queued
+ */
+static int unqueue_multiple(struct futex_q *qs, int count)
+{
+	int ret = -1;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (!unqueue_me(&qs[i]) && ret < 0)
+			ret = i;
+	}
+	return ret;
+}
+
+static void put_futex_keys(struct futex_q *qs, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		put_futex_key(&qs[i].key);
+}
+
+/**
+ * futex_wait_multiple_setup() - Prepare to wait on several futexes
+ * @qs:		the futex_qs to queue, one per entry of @wb
+ * @wb:		the futexes and their expected values
+ * @count:	the number of entries in @wb
+ * @flags:	futex flags (FLAGS_SHARED, etc.)
+ * @woken:	index of an already woken futex when returning 1
+ *
+ * This is futex_wait_setup() for every entry of @wb, except that each
+ * futex_q is queued as soon as its value has been checked. The task state
+ * is set before the first one is queued, so a wakeup on any of them from
+ * then on is not lost while we go on with the others.
+ *
+ * Return:
+ *  -  0 - all the futex_qs are queued, the task is TASK_INTERRUPTIBLE;
+ *  -  1 - a futex had to be skipped but an earlier one was woken meanwhile,
+ *	   its index is in @woken and everything is unqueued;
+ *  - <0 - -EFAULT or -EWOULDBLOCK, everything is unqueued
+ */
+static int futex_wait_multiple_setup(struct futex_q *qs,
+				     struct futex_wait_block *wb, int count,
+				     unsigned int flags, int *woken)
+{
+	struct futex_hash_bucket *hb;
+	u32 __user *uaddr;
+	u32 uval;
+	int ret, i;
+
+retry:
+	for (i = 0; i < count; i++) {
+		qs[i] = futex_q_init;
+		qs[i].bitset = wb[i].bitset;
+		ret = get_futex_key(u64_to_user_ptr(wb[i].uaddr),
+				    flags & FLAGS_SHARED, &qs[i].key,
+				    VERIFY_READ);
+		if (unlikely(ret)) {
+			put_futex_keys(qs, i);
+			return ret;
+		}
+	}
+
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	for (i = 0; i < count; i++) {
+		uaddr = u64_to_user_ptr(wb[i].uaddr);
+		hb = queue_lock(&qs[i]);
+
+		ret = get_futex_value_locked(&uval, uaddr);
+		if (!ret && uval == wb[i].val) {
+			queue_me(&qs[i], hb);
+			continue;
+		}
+
+		/*
+		 * Undo everything before handling the fault or bailing
+		 * out: the futexes already queued must not sit there while
+		 * we sleep on the page, or absorb a wakeup we then ignore.
+		 */
+		queue_unlock(hb);
+		__set_current_state(TASK_RUNNING);
+		*woken = unqueue_multiple(qs, i);
+		put_futex_keys(qs + i, count - i);
+
+		if (!ret) {
+			if (*woken >= 0)
+				return 1;
+			return -EWOULDBLOCK;
+		}
+
+		ret = get_user(uval, uaddr);
+		if (ret)
+			return ret;
+		if (*woken >= 0)
+			return 1;
+		goto retry;
+	}
+	return 0;
+}
+
+static int futex_wait_multiple(struct futex_wait_block __user *uwb,
+			       unsigned int flags, u32 count,
+			       ktime_t *abs_time)
+{
+	struct hrtimer_sleeper timeout, *to = NULL;
+	struct futex_wait_block *wb;
+	struct futex_q *qs;
+	int ret, woken, i;
+
+	if (!count || count > FUTEX_WAIT_MULTIPLE_MAX)
+		return -EINVAL;
+
+	wb = memdup_user(uwb, count * sizeof(*wb));
+	if (IS_ERR(wb))
+		return PTR_ERR(wb);
+
+	for (i = 0; i < count; i++) {
+		if (!wb[i].bitset) {
+			ret = -EINVAL;
+			goto out_free_wb;
+		}
+	}
+
+	qs = kcalloc(count, sizeof(*qs), GFP_KERNEL);
+	if (!qs) {
+		ret = -ENOMEM;
+		goto out_free_wb;
+	}
+
+	if (abs_time) {
+		to = &timeout;
+
+		hrtimer_init_on_stack(&to->timer, (flags & FLAGS_CLOCKRT) ?
+				      CLOCK_REALTIME : CLOCK_MONOTONIC,
+				      HRTIMER_MODE_ABS);
+		hrtimer_init_sleeper(to, current);
+		hrtimer_set_expires_range_ns(&to->timer, *abs_time,
+					     current->timer_slack_ns);
+	}
+
+retry:
+	ret = futex_wait_multiple_setup(qs, wb, count, flags, &woken);
+	if (ret) {
+		if (ret > 0)
+			ret = woken;
+		goto out;
+	}
+
+	if (to)
+		hrtimer_start_expires(&to->timer, HRTIMER_MODE_ABS);
+
+	/*
+	 * Skip schedule() if any of the futexes was woken, or the timer
+	 * expired, while we were queueing up.
+	 */
+	for (i = 0; i < count; i++) {
+		if (plist_node_empty(&qs[i].list))
+			break;
+	}
+	if (i == count && (!to || to->task))
+		freezable_schedule();
+	__set_current_state(TASK_RUNNING);
+
+	/* unqueue_multiple() drops the key refs */
+	ret = unqueue_multiple(qs, count);
+	if (ret >= 0)
+		goto out;
+	ret = -ETIMEDOUT;
+	if (to && !to->task)
+		goto out;
+
+	/*
+	 * We expect signal_pending(current), but we might be the
+	 * victim of a spurious wakeup as well.
+	 */
+	if (!signal_pending(current))
+		goto retry;
+
+	/* The timeout is absolute, so the syscall can simply be redone. */
+	ret = -ERESTARTSYS;
+
+out:
+	if (to) {
+		hrtimer_cancel(&to->timer);
+		destroy_hrtimer_on_stack(&to->timer);
+	}
+	kfree(qs);
+out_free_wb:
+	kfree(wb);
+	return ret;
+}
+
 
 /*
  * Userspace tried a 0 -> TID atomic transition of the futex value
@@ -3506,7 +3777,7 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 	if (op & FUTEX_CLOCK_REALTIME) {
 		flags |= FLAGS_CLOCKRT;
 		if (cmd != FUTEX_WAIT && cmd != FUTEX_WAIT_BITSET && \
-		    cmd != FUTEX_WAIT_REQUEUE_PI)
+		    cmd != FUTEX_WAIT_REQUEUE_PI && cmd != FUTEX_WAIT_MULTIPLE)
 			return -ENOSYS;
 	}
 
@@ -3526,6 +3797,9 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 		/* fall through */
 	case FUTEX_WAIT_BITSET:
 		return futex_wait(uaddr, flags, val, timeout, val3);
+	case FUTEX_WAIT_MULTIPLE:
+		return futex_wait_multiple((void __user *)uaddr, flags, val,
+					   timeout);
 	case FUTEX_WAKE:
 		val3 = FUTEX_BITSET_MATCH_ANY;
 		/* fall through */
@@ -3565,7 +3839,8 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 	if (utime && (cmd == FUTEX_WAIT || cmd == FUTEX_LOCK_PI ||
 		      cmd == FUTEX_WAIT_BITSET ||
-		      cmd == FUTEX_WAIT_REQUEUE_PI)) {
+		      cmd == FUTEX_WAIT_REQUEUE_PI ||
+		      cmd == FUTEX_WAIT_MULTIPLE)) {
 		if (unlikely(should_fail_futex(!(op & FUTEX_PRIVATE_FLAG))))
 			return -EFAULT;
 		if (copy_from_user(&ts, utime, sizeof(ts)) != 0)
@@ -3612,7 +3887,6 @@ static void __init futex_detect_cmpxchg(void)
 static int __init futex_init(void)
 {
 	unsigned int futex_shift;
-	unsigned long i;
 
 #if CONFIG_BASE_SMALL
 	futex_hashsize = 16;
@@ -3628,12 +3902,7 @@ static int __init futex_init(void)
 	futex_hashsize = 1UL << futex_shift;
 
 	futex_detect_cmpxchg();
-
-	for (i = 0; i < futex_hashsize; i++) {
-		atomic_set(&futex_queues[i].waiters, 0);
-		plist_head_init(&futex_queues[i].chain);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	futex_hash_init(futex_queues, futex_hashsize);
 
 	return 0;
 }
@@ -45,6 +45,15 @@ do {									\
 	smp_store_release((l), 1)
 #endif
 
+#ifndef arch_mcs_pass_lock
+/*
+ * Same as arch_mcs_spin_unlock_contended(), but with a value other than 1
+ * for lock variants that hand state to the next lock holder.
+ */
+#define arch_mcs_pass_lock(l, val)					\
+	smp_store_release((l), (val))
+#endif
+
 /*
  * Note: the smp_load_acquire/smp_store_release pair is not
  * sufficient to form a full memory barrier across
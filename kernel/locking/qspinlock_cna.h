@@ -0,0 +1,233 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _GEN_CNA_LOCK_SLOWPATH
+#error "do not include this file"
+#endif
+
+#include <linux/topology.h>
+
+/*
+ * Implement a NUMA-aware version of MCS (aka CNA, or compact NUMA-aware lock).
+ *
+ * In CNA, spinning threads are organized in two queues, a main queue for
+ * threads running on the same NUMA node as the current lock holder, and a
+ * secondary queue for threads running on other nodes. At the unlock time,
+ * the lock holder scans the main queue looking for a thread running on
+ * the same node. If found (call it thread T), all threads in the main queue
+ * between the current lock holder and T are moved to the end of the
+ * secondary queue, and the lock is passed to T. If such T is not found, the
+ * lock is passed to the first node in the secondary queue. Finally, if the
+ * secondary queue is empty, the lock is passed to the next thread in the
+ * main queue.
+ *
+ * To keep the lock word 32 bits, the secondary queue is a circular list
+ * whose tail is the predecessor of its head, and it is handed along with
+ * the MCS lock: the encoded tail of its last node is the value the lock
+ * holder passes in @locked of its successor (1 means it is empty).
+ *
+ * For fairness, the lock goes to the secondary queue anyway after
+ * INTRA_NODE_HANDOFF_THRESHOLD consecutive hand-offs within one node.
+ *
+ * CNA is only enabled on bare metal machines with more than one node, see
+ * cna_configure_spin_lock_slowpath().
+ */
+
+struct cna_node {
+	struct mcs_spinlock	mcs;
+	int			numa_node;
+	u32			encoded_tail;	/* self */
+	u32			intra_count;	/* local hand-offs before us */
+};
+
+#define INTRA_NODE_HANDOFF_THRESHOLD	(1 << 16)
+
+static void __init cna_init_nodes_per_cpu(unsigned int cpu)
+{
+	struct mcs_spinlock *base = per_cpu_ptr(&qnodes[0].mcs, cpu);
+	int numa_node = cpu_to_node(cpu);
+	int i;
+
+	for (i = 0; i < MAX_NODES; i++) {
+		struct cna_node *cn = (struct cna_node *)grab_mcs_node(base, i);
+
+		cn->numa_node = numa_node;
+		cn->encoded_tail = encode_tail(cpu, i);
+		/*
+		 * @encoded_tail has to be larger than 1, so we do not confuse
+		 * it with the other valid values for @locked (0 or 1)
+		 */
+		WARN_ON(cn->encoded_tail <= 1);
+	}
+}
+
+static void __init cna_init_nodes(void)
+{
+	unsigned int cpu;
+
+	/*
+	 * this will break on 32bit architectures, so we restrict
+	 * the use of CNA to 64bit only (see kernel/Kconfig.locks)
+	 */
+	BUILD_BUG_ON(sizeof(struct cna_node) > sizeof(struct qnode));
+	/* we store an encoded tail word in the node's @locked field */
+	BUILD_BUG_ON(sizeof(u32) > sizeof(int));
+
+	for_each_possible_cpu(cpu)
+		cna_init_nodes_per_cpu(cpu);
+}
+
+static __always_inline void cna_init_node(struct mcs_spinlock *node)
+{
+	((struct cna_node *)node)->intra_count = 0;
+}
+
+/*
+ * cna_try_clear_tail - the queue head is also its tail, so MCS would
+ * clear the tail and be done. If the secondary queue is not empty, make
+ * its last node the tail instead and pass the MCS lock to its first node;
+ * this moves the whole secondary queue back into the main one.
+ */
+static inline bool cna_try_clear_tail(struct qspinlock *lock, u32 val,
+				      struct mcs_spinlock *node)
+{
+	struct mcs_spinlock *head_2nd, *tail_2nd;
+	u32 new;
+
+	/* If the secondary queue is empty, do what MCS does. */
+	if (node->locked <= 1)
+		return __try_clear_tail(lock, val, node);
+
+	tail_2nd = decode_tail(node->locked);
+	head_2nd = tail_2nd->next;
+	new = ((struct cna_node *)tail_2nd)->encoded_tail + _Q_LOCKED_VAL;
+
+	if (atomic_try_cmpxchg_relaxed(&lock->val, &val, new)) {
+		/*
+		 * Try to reset @next in tail_2nd to NULL, but no need to check
+		 * the result - if failed, a new successor has updated it.
+		 */
+		cmpxchg_relaxed(&tail_2nd->next, head_2nd, NULL);
+		arch_mcs_pass_lock(&head_2nd->locked, 1);
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * cna_scan_main_queue - look for a waiter on our node in the main queue,
+ * starting at @next. If there is one, move the waiters in front of it to
+ * the tail of the secondary queue and make it our successor.
+ *
+ * Return true if a local waiter was found.
+ */
+static bool cna_scan_main_queue(struct mcs_spinlock *node,
+				struct mcs_spinlock *next)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+	struct cna_node *cur = (struct cna_node *)next;
+	struct cna_node *last = NULL;
+	struct mcs_spinlock *tail_2nd;
+
+	while (cur->numa_node != cn->numa_node) {
+		last = cur;
+		cur = (struct cna_node *)READ_ONCE(cur->mcs.next);
+		/* the end of the queue, or a waiter still linking in */
+		if (!cur)
+			return false;
+	}
+
+	if (!last)
+		return true;
+
+	/*
+	 * @last isn't the tail of the main queue as @cur follows it, so
+	 * nobody else is going to write its @next.
+	 */
+	if (node->locked > 1) {
+		tail_2nd = decode_tail(node->locked);
+		last->mcs.next = tail_2nd->next;
+		tail_2nd->next = next;
+	} else {
+		last->mcs.next = next;
+	}
+	node->locked = last->encoded_tail;
+	node->next = &cur->mcs;
+
+	return true;
+}
+
+/*
+ * cna_pass_lock - pass the MCS lock to a waiter on our node if there is
+ * one and we are under the fairness threshold, else to the head of the
+ * secondary queue, else to @next.
+ */
+static inline void cna_pass_lock(struct mcs_spinlock *node,
+				 struct mcs_spinlock *next)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+	struct mcs_spinlock *next_holder = next, *tail_2nd;
+	u32 intra_count = 0;
+	u32 val = 1;
+
+	if (cn->intra_count < INTRA_NODE_HANDOFF_THRESHOLD &&
+	    cna_scan_main_queue(node, next)) {
+		next_holder = node->next;
+		/* hand the secondary queue, if any, along */
+		if (node->locked > 1)
+			val = node->locked;
+		intra_count = cn->intra_count + 1;
+	} else if (node->locked > 1) {
+		/* splice the secondary queue onto the head of the main queue */
+		tail_2nd = decode_tail(node->locked);
+		next_holder = tail_2nd->next;
+		tail_2nd->next = next;
+	}
+
+	((struct cna_node *)next_holder)->intra_count = intra_count;
+	arch_mcs_pass_lock(&next_holder->locked, val);
+}
+
+/*
+ * Constant (boot-param configurable) flag selecting the NUMA-aware variant
+ * of spinlock.  Possible values: -1 (off) / 0 (auto, default) / 1 (on).
+ */
+static int numa_spinlock_flag;
+
+static int __init numa_spinlock_setup(char *str)
+{
+	if (!strcmp(str, "auto")) {
+		numa_spinlock_flag = 0;
+		return 1;
+	} else if (!strcmp(str, "on")) {
+		numa_spinlock_flag = 1;
+		return 1;
+	} else if (!strcmp(str, "off")) {
+		numa_spinlock_flag = -1;
+		return 1;
+	}
+
+	return 0;
+}
+__setup("numa_spinlock=", numa_spinlock_setup);
+
+/*
+ * Switch to the NUMA-friendly slow path for spinlocks when we have
+ * multiple NUMA nodes in native environment, unless the user has
+ * overridden this default behavior by setting the numa_spinlock flag.
+ * A paravirt slow path, if one was installed, always takes precedence.
+ */
+void __init cna_configure_spin_lock_slowpath(void)
+{
+	if (pv_ops.lock.queued_spin_lock_slowpath !=
+			native_queued_spin_lock_slowpath)
+		return;
+
+	if (numa_spinlock_flag < 0 ||
+	    (numa_spinlock_flag == 0 && nr_node_ids < 2))
+		return;
+
+	cna_init_nodes();
+	pv_ops.lock.queued_spin_lock_slowpath = __cna_queued_spin_lock_slowpath;
+
+	pr_info("Enabling CNA spinlock\n");
+}
@@ -18,6 +18,7 @@
 #include <linux/sched/wake_q.h>
 #include <linux/sched/debug.h>
 #include <linux/osq_lock.h>
+#include <trace/events/lock.h>
 
 #include "rwsem.h"
 
@@ -219,6 +220,8 @@ static void __rwsem_mark_wake(struct rw_semaphore *sem,
 		atomic_long_add(adjustment, &sem->count);
 }
 
+static bool rwsem_optimistic_spin_read(struct rw_semaphore *sem);
+
 /*
  * Wait for the read lock to be granted
  */
@@ -229,6 +232,14 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 	struct rwsem_waiter waiter;
 	DEFINE_WAKE_Q(wake_q);
 
+	trace_contention_begin(sem, LCB_F_READ);
+
+	/* spin on a running writer as long as nobody is queued */
+	if (rwsem_optimistic_spin_read(sem)) {
+		trace_contention_end(sem, 0);
+		return sem;
+	}
+
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_READ;
 
@@ -242,6 +253,7 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 		 */
 		if (atomic_long_read(&sem->count) >= 0) {
 			raw_spin_unlock_irq(&sem->wait_lock);
+			trace_contention_end(sem, 0);
 			return sem;
 		}
 		adjustment += RWSEM_WAITING_BIAS;
@@ -281,6 +293,7 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 	}
 
 	__set_current_state(TASK_RUNNING);
+	trace_contention_end(sem, 0);
 	return sem;
 out_nolock:
 	list_del(&waiter.list);
@@ -288,6 +301,7 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 		atomic_long_add(-RWSEM_WAITING_BIAS, &sem->count);
 	raw_spin_unlock_irq(&sem->wait_lock);
 	__set_current_state(TASK_RUNNING);
+	trace_contention_end(sem, -EINTR);
 	return ERR_PTR(-EINTR);
 }
 
@@ -479,6 +493,60 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 	return taken;
 }
 
+/*
+ * A reader comes into the slowpath with its RWSEM_ACTIVE_READ_BIAS still
+ * in the count, so once the writer holding the lock releases it (and no
+ * waiter put a RWSEM_WAITING_BIAS in meanwhile) the count goes non-negative
+ * and the read lock is already ours. Rather than queueing and sleeping,
+ * spin for that while the writer is running.
+ *
+ * Spinning stops as soon as anybody is queued: new readers then see a
+ * negative count and queue up behind the waiters, which the wakeup order
+ * of the wait list then hands the lock to, so readers cannot starve a
+ * waiting writer.
+ *
+ * Readers don't take the osq: a writer spinning in it cannot acquire the
+ * lock while our bias is in the count, and would hold us off until it
+ * gives up.
+ */
+static bool rwsem_optimistic_spin_read(struct rw_semaphore *sem)
+{
+	bool taken = false;
+	long count;
+
+	preempt_disable();
+
+	if (!rwsem_can_spin_on_owner(sem))
+		goto done;
+
+	while (true) {
+		count = atomic_long_read(&sem->count);
+		if (count >= 0) {
+			/* pairs with the release in __up_write() */
+			smp_acquire__after_ctrl_dep();
+			rwsem_set_reader_owned(sem);
+			taken = true;
+			break;
+		}
+
+		/* somebody is queued, get in line */
+		if (count < RWSEM_WAITING_BIAS || !list_empty(&sem->wait_list))
+			break;
+
+		if (!rwsem_spin_on_owner(sem))
+			break;
+
+		/* same RT live-lock concern as in rwsem_optimistic_spin() */
+		if (!sem->owner && (need_resched() || rt_task(current)))
+			break;
+
+		cpu_relax();
+	}
+done:
+	preempt_enable();
+	return taken;
+}
+
 /*
  * Return true if the rwsem has active spinner
  */
@@ -493,6 +561,11 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 	return false;
 }
 
+static bool rwsem_optimistic_spin_read(struct rw_semaphore *sem)
+{
+	return false;
+}
+
 static inline bool rwsem_has_spinner(struct rw_semaphore *sem)
 {
 	return false;
@@ -514,9 +587,13 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	/* undo write bias from down_write operation, stop active locking */
 	count = atomic_long_sub_return(RWSEM_ACTIVE_WRITE_BIAS, &sem->count);
 
+	trace_contention_begin(sem, LCB_F_WRITE);
+
 	/* do optimistic spinning and steal lock if possible */
-	if (rwsem_optimistic_spin(sem))
+	if (rwsem_optimistic_spin(sem)) {
+		trace_contention_end(sem, 0);
 		return sem;
+	}
 
 	/*
 	 * Optimistic spinning failed, proceed to the slowpath
@@ -583,6 +660,7 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	__set_current_state(TASK_RUNNING);
 	list_del(&waiter.list);
 	raw_spin_unlock_irq(&sem->wait_lock);
+	trace_contention_end(sem, 0);
 
 	return ret;
 
@@ -596,6 +674,7 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 		__rwsem_mark_wake(sem, RWSEM_WAKE_ANY, &wake_q);
 	raw_spin_unlock_irq(&sem->wait_lock);
 	wake_up_q(&wake_q);
+	trace_contention_end(sem, -EINTR);
 
 	return ERR_PTR(-EINTR);
 }
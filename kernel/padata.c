@@ -21,6 +21,7 @@
  * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <linux/completion.h>
 #include <linux/export.h>
 #include <linux/cpumask.h>
 #include <linux/err.h>
@@ -1088,6 +1089,121 @@ void padata_free(struct padata_instance *pinst)
 }
 EXPORT_SYMBOL(padata_free);
 
+struct padata_mt_job_state {
+	spinlock_t		lock;
+	struct completion	completion;
+	struct padata_mt_job	*job;
+	int			nworks;
+	int			nworks_fini;
+	unsigned long		chunk_size;
+};
+
+struct padata_mt_work {
+	struct work_struct		work;
+	struct padata_mt_job_state	*ps;
+};
+
+static void padata_mt_helper(struct work_struct *w)
+{
+	struct padata_mt_work *pw = container_of(w, struct padata_mt_work, work);
+	struct padata_mt_job_state *ps = pw->ps;
+	struct padata_mt_job *job = ps->job;
+	bool done;
+
+	spin_lock(&ps->lock);
+
+	while (job->size > 0) {
+		unsigned long start, size, end;
+
+		/* end on a chunk boundary if enough work is left */
+		start = job->start;
+		size = roundup(start + 1, ps->chunk_size) - start;
+		size = min(size, job->size);
+		end = start + size;
+
+		job->start = end;
+		job->size -= size;
+
+		spin_unlock(&ps->lock);
+		job->thread_fn(start, end, job->fn_arg);
+		cond_resched();
+		spin_lock(&ps->lock);
+	}
+
+	done = ++ps->nworks_fini == ps->nworks;
+	spin_unlock(&ps->lock);
+
+	if (done)
+		complete(&ps->completion);
+}
+
+/**
+ * padata_do_multithreaded - run a job on several threads
+ * @job: description of the job
+ *
+ * The job is cut in chunks that the calling thread and up to
+ * @job->max_threads - 1 unbound workers take in turn, the workers running
+ * on @job->nid unless it is NUMA_NO_NODE. Returns once the whole job is
+ * done. The caller must be able to sleep.
+ */
+void padata_do_multithreaded(struct padata_mt_job *job)
+{
+	/* more chunks than threads, in case threads finish unevenly */
+	static const unsigned long load_balance_factor = 4;
+	struct padata_mt_work my_work, *works;
+	struct padata_mt_job_state ps;
+	unsigned long nworks;
+	int i, cpu = WORK_CPU_UNBOUND;
+
+	if (!job->size)
+		return;
+
+	nworks = max(job->size / job->min_chunk, 1ul);
+	nworks = min_t(unsigned long, nworks, job->max_threads);
+
+	works = NULL;
+	if (nworks > 1)
+		works = kcalloc(nworks - 1, sizeof(*works), GFP_KERNEL);
+	if (!works) {
+		job->thread_fn(job->start, job->start + job->size, job->fn_arg);
+		return;
+	}
+
+	spin_lock_init(&ps.lock);
+	init_completion(&ps.completion);
+	ps.job = job;
+	ps.nworks = nworks;
+	ps.nworks_fini = 0;
+
+	ps.chunk_size = job->size / (nworks * load_balance_factor);
+	ps.chunk_size = max(ps.chunk_size, job->min_chunk);
+	ps.chunk_size = roundup(ps.chunk_size, job->align);
+
+	/* an unbound work runs in the pool of the node of the cpu it names */
+	if (job->nid != NUMA_NO_NODE) {
+		cpu = cpumask_any_and(cpumask_of_node(job->nid),
+				      cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = WORK_CPU_UNBOUND;
+	}
+
+	for (i = 0; i < nworks - 1; i++) {
+		INIT_WORK(&works[i].work, padata_mt_helper);
+		works[i].ps = &ps;
+		queue_work_on(cpu, system_unbound_wq, &works[i].work);
+	}
+
+	/* the caller does its share instead of waiting idle */
+	INIT_WORK_ONSTACK(&my_work.work, padata_mt_helper);
+	my_work.ps = &ps;
+	padata_mt_helper(&my_work.work);
+
+	wait_for_completion(&ps.completion);
+
+	destroy_work_on_stack(&my_work.work);
+	kfree(works);
+}
+
 #ifdef CONFIG_HOTPLUG_CPU
 
 static __init int padata_driver_init(void)
@@ -47,6 +47,8 @@
 #include <linux/sched/clock.h>
 #include <linux/sched/debug.h>
 #include <linux/sched/task_stack.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 
 #include <linux/uaccess.h>
 #include <asm/sections.h>
@@ -1881,6 +1883,91 @@ int vprintk_store(int facility, int level,
 			  dict, dictlen, text, text_len);
 }
 
+/*
+ * Once the printk kthread runs, printk() only stores the message and the
+ * kthread prints it to the consoles, so that a slow (serial) console
+ * does not stall whoever happens to call printk() or to hold console_sem.
+ * Messages are still printed synchronously when the kthread may not get
+ * to run any more: oops and panic, reboot or power off, and when the
+ * consoles have made no progress for PRINTK_OFFLOAD_STALL, as happens
+ * when the system is hanging without an oops.
+ */
+static bool printk_offload = true;
+module_param_named(offload, printk_offload, bool, 0644);
+MODULE_PARM_DESC(offload, "print to the consoles from the printk kthread");
+
+static struct task_struct *printk_kthread __read_mostly;
+static DECLARE_WAIT_QUEUE_HEAD(printk_kthread_wait);
+
+#define PRINTK_OFFLOAD_STALL	HZ
+
+/*
+ * jiffies when a record was last printed, or when output became pending
+ * after the consoles had caught up. Written under logbuf_lock.
+ */
+static unsigned long printk_console_progress;
+
+static bool printk_offload_console(void)
+{
+	return READ_ONCE(printk_offload) && printk_kthread &&
+		!oops_in_progress && system_state == SYSTEM_RUNNING &&
+		time_before(jiffies, READ_ONCE(printk_console_progress) +
+				     PRINTK_OFFLOAD_STALL);
+}
+
+/*
+ * Suspended consoles leave console_seq alone, so there is nothing to do
+ * for the kthread until resume_console() prints the backlog itself.
+ */
+static bool printk_pending_output(void)
+{
+	unsigned long flags;
+	bool ret;
+
+	logbuf_lock_irqsave(flags);
+	ret = console_seq != log_next_seq && !READ_ONCE(console_suspended);
+	logbuf_unlock_irqrestore(flags);
+
+	return ret;
+}
+
+static int printk_kthread_func(void *data)
+{
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		u64 seq;
+
+		wait_event_freezable(printk_kthread_wait,
+				     kthread_should_stop() ||
+				     printk_pending_output());
+
+		/* console_unlock() reschedules between the records */
+		console_lock();
+		seq = console_seq;
+		console_unlock();
+
+		/* a pass that printed nothing must not turn into a busy loop */
+		if (seq == READ_ONCE(console_seq))
+			schedule_timeout_idle(HZ / 10);
+	}
+	return 0;
+}
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(task)) {
+		pr_err("printk: unable to create printing thread\n");
+		return PTR_ERR(task);
+	}
+	printk_kthread = task;
+	return 0;
+}
+early_initcall(printk_kthread_init);
+
 asmlinkage int vprintk_emit(int facility, int level,
 			    const char *dict, size_t dictlen,
 			    const char *fmt, va_list args)
@@ -1903,10 +1990,18 @@ asmlinkage int vprintk_emit(int facility, int level,
 	curr_log_seq = log_next_seq;
 	printed_len = vprintk_store(facility, level, dict, dictlen, fmt, args);
 	pending_output = (curr_log_seq != log_next_seq);
+	if (pending_output && console_seq == curr_log_seq)
+		WRITE_ONCE(printk_console_progress, jiffies);
 	logbuf_unlock_irqrestore(flags);
 
-	/* If called from the scheduler, we can not call up(). */
-	if (!in_sched && pending_output) {
+	/*
+	 * The printk kthread is woken from irq_work, printk() may be called
+	 * with scheduler locks held. If called from the scheduler, we can
+	 * not call up() either.
+	 */
+	if (pending_output && printk_offload_console()) {
+		defer_console_output();
+	} else if (!in_sched && pending_output) {
 		/*
 		 * Disable preemption to avoid being preempted while holding
 		 * console_sem which would prevent anyone from printing to
@@ -2014,6 +2109,7 @@ static u64 exclusive_console_stop_seq;
 static u64 log_first_seq;
 static u32 log_first_idx;
 static u64 log_next_seq;
+static unsigned long printk_console_progress;
 static char *log_text(const struct printk_log *msg) { return NULL; }
 static char *log_dict(const struct printk_log *msg) { return NULL; }
 static struct printk_log *log_from_idx(u32 idx) { return NULL; }
@@ -2400,6 +2496,7 @@ void console_unlock(void)
 		}
 		console_idx = log_next(console_idx);
 		console_seq++;
+		WRITE_ONCE(printk_console_progress, jiffies);
 		raw_spin_unlock(&logbuf_lock);
 
 		/*
@@ -2881,9 +2978,16 @@ static void wake_up_klogd_work_func(struct irq_work *irq_work)
 	int pending = __this_cpu_xchg(printk_pending, 0);
 
 	if (pending & PRINTK_PENDING_OUTPUT) {
-		/* If trylock fails, someone else is doing the printing */
-		if (console_trylock())
-			console_unlock();
+		if (printk_offload_console()) {
+			wake_up_interruptible(&printk_kthread_wait);
+		} else {
+			/*
+			 * If trylock fails, someone else is doing the
+			 * printing
+			 */
+			if (console_trylock())
+				console_unlock();
+		}
 	}
 
 	if (pending & PRINTK_PENDING_WAKEUP)
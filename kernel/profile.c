@@ -12,6 +12,8 @@
  *  Amortized hit count accounting via per-cpu open-addressed hashtables
  *	to resolve timer interrupt livelocks, Nadia Yvette Chambers,
  *	Oracle, 2004
+ *  Stack profiling, counting the distinct kernel+user stacks hit by the
+ *	profiling tick in place of single PCs.
  */
 
 #include <linux/export.h>
@@ -26,6 +28,8 @@
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/sched/stat.h>
+#include <linux/stacktrace.h>
+#include <linux/jhash.h>
 
 #include <asm/sections.h>
 #include <asm/irq_regs.h>
@@ -45,6 +49,30 @@ static unsigned long prof_len, prof_shift;
 int prof_on __read_mostly;
 EXPORT_SYMBOL_GPL(prof_on);
 
+#ifdef CONFIG_STACKTRACE
+#define PROFILE_STACK_DEPTH	32
+#define PROFILE_STACK_PROBES	4
+#define PROFILE_STACK_SHIFT	10	/* default: 1024 distinct stacks */
+#define PROFILE_STACK_MAX_SHIFT	16
+
+/*
+ * One distinct stack, kernel frames first. The slot index is its id; @hash
+ * is 0 while the slot is free and @ready is set once it has been filled in.
+ */
+struct profile_stack {
+	u32		hash;
+	u32		ready;
+	u32		nr_kernel;
+	u32		nr_user;
+	atomic_t	hits;
+	unsigned long	ips[2 * PROFILE_STACK_DEPTH];
+};
+
+static struct profile_stack *prof_stacks;
+static atomic_t prof_stacks_dropped;
+static DEFINE_PER_CPU(struct profile_stack, prof_stack_scratch);
+#endif /* CONFIG_STACKTRACE */
+
 static cpumask_var_t prof_cpu_mask;
 #if defined(CONFIG_SMP) && defined(CONFIG_PROC_FS)
 static DEFINE_PER_CPU(struct profile_hit *[2], cpu_profile_hits);
@@ -57,6 +85,7 @@ int profile_setup(char *str)
 	static const char schedstr[] = "schedule";
 	static const char sleepstr[] = "sleep";
 	static const char kvmstr[] = "kvm";
+	static const char stackstr[] = "stack";
 	int par;
 
 	if (!strncmp(str, sleepstr, strlen(sleepstr))) {
@@ -88,6 +117,19 @@ int profile_setup(char *str)
 			prof_shift = par;
 		pr_info("kernel KVM profiling enabled (shift: %ld)\n",
 			prof_shift);
+	} else if (!strncmp(str, stackstr, strlen(stackstr))) {
+#ifdef CONFIG_STACKTRACE
+		prof_on = STACK_PROFILING;
+		prof_shift = PROFILE_STACK_SHIFT;
+		if (str[strlen(stackstr)] == ',')
+			str += strlen(stackstr) + 1;
+		if (get_option(&str, &par))
+			prof_shift = min(par, PROFILE_STACK_MAX_SHIFT);
+		pr_info("kernel stack profiling enabled (shift: %ld)\n",
+			prof_shift);
+#else
+		pr_warn("kernel stack profiling requires CONFIG_STACKTRACE\n");
+#endif /* CONFIG_STACKTRACE */
 	} else if (get_option(&str, &par)) {
 		prof_shift = par;
 		prof_on = CPU_PROFILING;
@@ -105,15 +147,29 @@ int __ref profile_init(void)
 	if (!prof_on)
 		return 0;
 
-	/* only text is profiled */
-	prof_len = (_etext - _stext) >> prof_shift;
-	buffer_bytes = prof_len*sizeof(atomic_t);
-
 	if (!alloc_cpumask_var(&prof_cpu_mask, GFP_KERNEL))
 		return -ENOMEM;
 
 	cpumask_copy(prof_cpu_mask, cpu_possible_mask);
 
+#ifdef CONFIG_STACKTRACE
+	if (prof_on == STACK_PROFILING) {
+		/* stack ids index a power of two table of distinct stacks */
+		prof_len = 1UL << prof_shift;
+		prof_stacks = vzalloc(array_size(prof_len,
+						 sizeof(*prof_stacks)));
+		if (prof_stacks)
+			return 0;
+
+		free_cpumask_var(prof_cpu_mask);
+		return -ENOMEM;
+	}
+#endif
+
+	/* only text is profiled */
+	prof_len = (_etext - _stext) >> prof_shift;
+	buffer_bytes = prof_len*sizeof(atomic_t);
+
 	prof_buffer = kzalloc(buffer_bytes, GFP_KERNEL|__GFP_NOWARN);
 	if (prof_buffer)
 		return 0;
@@ -398,12 +454,116 @@ void profile_hits(int type, void *__pc, unsigned int nr_hits)
 }
 EXPORT_SYMBOL_GPL(profile_hits);
 
+#ifdef CONFIG_STACKTRACE
+static unsigned int profile_stack_trim(struct stack_trace *trace)
+{
+	unsigned int nr = trace->nr_entries;
+
+	/* drop the ULONG_MAX end marker some architectures append */
+	while (nr && trace->entries[nr - 1] == ULONG_MAX)
+		nr--;
+
+	return nr;
+}
+
+static bool profile_stack_equal(struct profile_stack *s,
+				struct profile_stack *new)
+{
+	return s->nr_kernel == new->nr_kernel &&
+	       s->nr_user == new->nr_user &&
+	       !memcmp(s->ips, new->ips,
+		       (new->nr_kernel + new->nr_user) * sizeof(long));
+}
+
+/*
+ * Account a tick to the kernel+user stack it interrupted. Like stackmap,
+ * the stack is looked up by hash; a new one takes a free slot among its
+ * PROFILE_STACK_PROBES candidates, and when they are all taken by other
+ * stacks the hit is only counted as dropped. Runs from the tick with
+ * interrupts off, so the per-cpu scratch entry cannot be reused under us.
+ */
+static void profile_stack_hit(struct pt_regs *regs)
+{
+	struct profile_stack *new = this_cpu_ptr(&prof_stack_scratch);
+	struct stack_trace trace = {
+		.entries	= new->ips,
+		.max_entries	= PROFILE_STACK_DEPTH,
+	};
+	struct profile_stack *s;
+	unsigned int nr;
+	u32 hash;
+	int i;
+
+	if (!prof_stacks)
+		return;
+
+	if (!user_mode(regs))
+		save_stack_trace_regs(regs, &trace);
+	new->nr_kernel = profile_stack_trim(&trace);
+
+	new->nr_user = 0;
+	if (current->mm) {
+		trace.entries = new->ips + new->nr_kernel;
+		trace.nr_entries = 0;
+		save_stack_trace_user(&trace);
+		new->nr_user = profile_stack_trim(&trace);
+	}
+
+	nr = new->nr_kernel + new->nr_user;
+	if (!nr)
+		return;
+
+	hash = jhash2((u32 *)new->ips, nr * sizeof(long) / sizeof(u32),
+		      new->nr_kernel);
+	if (!hash)
+		hash = 1;
+
+	for (i = 0; i < PROFILE_STACK_PROBES; i++) {
+		s = &prof_stacks[(hash + i) & (prof_len - 1)];
+
+		if (!READ_ONCE(s->hash)) {
+			if (cmpxchg(&s->hash, 0, hash))
+				continue;
+			s->nr_kernel = new->nr_kernel;
+			s->nr_user = new->nr_user;
+			memcpy(s->ips, new->ips, nr * sizeof(long));
+			atomic_set(&s->hits, 1);
+			smp_store_release(&s->ready, 1);
+			return;
+		}
+
+		if (READ_ONCE(s->hash) == hash) {
+			/*
+			 * Another cpu is filling in this slot, possibly with
+			 * the same stack: don't claim a second one for it.
+			 */
+			if (!smp_load_acquire(&s->ready))
+				break;
+			if (profile_stack_equal(s, new)) {
+				atomic_inc(&s->hits);
+				return;
+			}
+		}
+	}
+
+	atomic_inc(&prof_stacks_dropped);
+}
+
+#else
+static inline void profile_stack_hit(struct pt_regs *regs) { }
+#endif /* CONFIG_STACKTRACE */
+
 void profile_tick(int type)
 {
 	struct pt_regs *regs = get_irq_regs();
 
-	if (!user_mode(regs) && prof_cpu_mask != NULL &&
-	    cpumask_test_cpu(smp_processor_id(), prof_cpu_mask))
+	if (prof_cpu_mask == NULL ||
+	    !cpumask_test_cpu(smp_processor_id(), prof_cpu_mask))
+		return;
+
+	if (prof_on == STACK_PROFILING && type == CPU_PROFILING)
+		profile_stack_hit(regs);
+	else if (!user_mode(regs))
 		profile_hit(type, (void *)profile_pc(regs));
 }
 
@@ -522,6 +682,103 @@ static const struct file_operations proc_profile_operations = {
 	.llseek		= default_llseek,
 };
 
+#ifdef CONFIG_STACKTRACE
+/*
+ * /proc/profile_stacks lists the stacks hit since the last reset, one per
+ * line: "<id> <hits> <kernel frames> <user frames>", frames separated by ';'
+ * and '-' for none. The counts are shared by all cpus, so every read is a
+ * merged dump and an agent only has to read it periodically. Writing to it
+ * resets the counters.
+ */
+static void profile_stacks_show_frames(struct seq_file *m, unsigned long *ips,
+				       unsigned int nr, bool user)
+{
+	unsigned int i;
+
+	seq_putc(m, ' ');
+	if (!nr)
+		seq_putc(m, '-');
+	for (i = 0; i < nr; i++) {
+		if (i)
+			seq_putc(m, ';');
+		if (user)
+			seq_printf(m, "%lx", ips[i]);
+		else
+			seq_printf(m, "%pB", (void *)ips[i]);
+	}
+}
+
+static int profile_stacks_show(struct seq_file *m, void *v)
+{
+	struct profile_stack *s;
+	unsigned long i;
+	int hits;
+
+	seq_printf(m, "# dropped %d\n", atomic_read(&prof_stacks_dropped));
+	for (i = 0; i < prof_len; i++) {
+		s = &prof_stacks[i];
+		if (!smp_load_acquire(&s->ready))
+			continue;
+		hits = atomic_read(&s->hits);
+		if (!hits)
+			continue;
+
+		seq_printf(m, "%lu %d", i, hits);
+		profile_stacks_show_frames(m, s->ips, s->nr_kernel, false);
+		profile_stacks_show_frames(m, s->ips + s->nr_kernel,
+					   s->nr_user, true);
+		seq_putc(m, '\n');
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static int profile_stacks_open(struct inode *inode, struct file *file)
+{
+	return single_open_size(file, profile_stacks_show, NULL,
+				prof_len * 64);
+}
+
+/*
+ * Like write_profile(), this does not stop the ticks: a tick racing with
+ * the reset may lose its hit, but a slot is never shown half filled in.
+ * Only slots that are ready are freed, each by whoever clears @ready, so
+ * a slot still being filled in is left to its owner and cannot be claimed
+ * a second time.
+ */
+static void profile_stacks_reset(void)
+{
+	struct profile_stack *s;
+	unsigned long i;
+
+	for (i = 0; i < prof_len; i++) {
+		s = &prof_stacks[i];
+		if (cmpxchg(&s->ready, 1, 0) != 1)
+			continue;
+		atomic_set(&s->hits, 0);
+		smp_store_release(&s->hash, 0);
+	}
+	atomic_set(&prof_stacks_dropped, 0);
+}
+
+static ssize_t profile_stacks_write(struct file *file,
+				    const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	profile_stacks_reset();
+	return count;
+}
+
+static const struct file_operations proc_profile_stacks_operations = {
+	.open		= profile_stacks_open,
+	.read		= seq_read,
+	.write		= profile_stacks_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif /* CONFIG_STACKTRACE */
+
 int __ref create_proc_profile(void)
 {
 	struct proc_dir_entry *entry;
@@ -533,6 +790,14 @@ int __ref create_proc_profile(void)
 
 	if (!prof_on)
 		return 0;
+#ifdef CONFIG_STACKTRACE
+	if (prof_on == STACK_PROFILING) {
+		/* no per-cpu hit buffers needed, the stacks are shared */
+		entry = proc_create("profile_stacks", S_IWUSR | S_IRUSR,
+				    NULL, &proc_profile_stacks_operations);
+		return entry ? 0 : -ENOMEM;
+	}
+#endif
 #ifdef CONFIG_SMP
 	err = cpuhp_setup_state(CPUHP_PROFILE_PREPARE, "PROFILE_PREPARE",
 				profile_prepare_cpu, profile_dead_cpu);
@@ -218,6 +218,21 @@ static inline void debug_rcu_head_unqueue(struct rcu_head *head)
 
 void kfree(const void *);
 
+#ifdef CONFIG_TINY_RCU
+static inline bool rcu_cb_is_lazy(rcu_callback_t f)
+{
+	return false;
+}
+#else
+void kfree_rcu_gp_done(struct rcu_head *rhp);
+
+/* The kfree_rcu() batch callback only frees memory, so it is lazy too. */
+static inline bool rcu_cb_is_lazy(rcu_callback_t f)
+{
+	return f == kfree_rcu_gp_done;
+}
+#endif
+
 /*
  * Reclaim the specified callback, either by invoking it (non-lazy case)
  * or freeing it directly (lazy case).  Return true if lazy, false otherwise.
@@ -239,7 +254,7 @@ static inline bool __rcu_reclaim(const char *rn, struct rcu_head *head)
 		WRITE_ONCE(head->func, (rcu_callback_t)0L);
 		f(head);
 		rcu_lock_release(&rcu_callback_map);
-		return false;
+		return rcu_cb_is_lazy(f);
 	}
 }
 
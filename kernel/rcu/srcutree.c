@@ -819,6 +819,46 @@ static bool srcu_might_be_idle(struct srcu_struct *sp)
 	return true; /* With reasonable probability, idle! */
 }
 
+/*
+ * Start an SRCU grace period covering all prior read-side critical
+ * sections, unless one is already pending, and enqueue @rhp, if non-NULL,
+ * on the current CPU's srcu_data to be invoked at its end.  Returns the
+ * grace-period sequence number that marks the end of that grace period.
+ */
+static unsigned long srcu_gp_start_if_needed(struct srcu_struct *sp,
+					     struct rcu_head *rhp, bool do_norm)
+{
+	unsigned long flags;
+	bool needexp = false;
+	bool needgp = false;
+	unsigned long s;
+	struct srcu_data *sdp;
+
+	local_irq_save(flags);
+	sdp = this_cpu_ptr(sp->sda);
+	spin_lock_rcu_node(sdp);
+	if (rhp)
+		rcu_segcblist_enqueue(&sdp->srcu_cblist, rhp, false);
+	rcu_segcblist_advance(&sdp->srcu_cblist,
+			      rcu_seq_current(&sp->srcu_gp_seq));
+	s = rcu_seq_snap(&sp->srcu_gp_seq);
+	(void)rcu_segcblist_accelerate(&sdp->srcu_cblist, s);
+	if (ULONG_CMP_LT(sdp->srcu_gp_seq_needed, s)) {
+		sdp->srcu_gp_seq_needed = s;
+		needgp = true;
+	}
+	if (!do_norm && ULONG_CMP_LT(sdp->srcu_gp_seq_needed_exp, s)) {
+		sdp->srcu_gp_seq_needed_exp = s;
+		needexp = true;
+	}
+	spin_unlock_irqrestore_rcu_node(sdp, flags);
+	if (needgp)
+		srcu_funnel_gp_start(sp, sdp, s, do_norm);
+	else if (needexp)
+		srcu_funnel_exp_start(sp, sdp->mynode, s);
+	return s;
+}
+
 /*
  * SRCU callback function to leak a callback.
  */
@@ -857,12 +897,6 @@ static void srcu_leak_callback(struct rcu_head *rhp)
 void __call_srcu(struct srcu_struct *sp, struct rcu_head *rhp,
 		 rcu_callback_t func, bool do_norm)
 {
-	unsigned long flags;
-	bool needexp = false;
-	bool needgp = false;
-	unsigned long s;
-	struct srcu_data *sdp;
-
 	check_init_srcu_struct(sp);
 	if (debug_rcu_head_queue(rhp)) {
 		/* Probable double call_srcu(), so leak the callback. */
@@ -871,27 +905,7 @@ void __call_srcu(struct srcu_struct *sp, struct rcu_head *rhp,
 		return;
 	}
 	rhp->func = func;
-	local_irq_save(flags);
-	sdp = this_cpu_ptr(sp->sda);
-	spin_lock_rcu_node(sdp);
-	rcu_segcblist_enqueue(&sdp->srcu_cblist, rhp, false);
-	rcu_segcblist_advance(&sdp->srcu_cblist,
-			      rcu_seq_current(&sp->srcu_gp_seq));
-	s = rcu_seq_snap(&sp->srcu_gp_seq);
-	(void)rcu_segcblist_accelerate(&sdp->srcu_cblist, s);
-	if (ULONG_CMP_LT(sdp->srcu_gp_seq_needed, s)) {
-		sdp->srcu_gp_seq_needed = s;
-		needgp = true;
-	}
-	if (!do_norm && ULONG_CMP_LT(sdp->srcu_gp_seq_needed_exp, s)) {
-		sdp->srcu_gp_seq_needed_exp = s;
-		needexp = true;
-	}
-	spin_unlock_irqrestore_rcu_node(sdp, flags);
-	if (needgp)
-		srcu_funnel_gp_start(sp, sdp, s, do_norm);
-	else if (needexp)
-		srcu_funnel_exp_start(sp, sdp->mynode, s);
+	(void)srcu_gp_start_if_needed(sp, rhp, do_norm);
 }
 
 /**
@@ -1102,6 +1116,76 @@ unsigned long srcu_batches_completed(struct srcu_struct *sp)
 }
 EXPORT_SYMBOL_GPL(srcu_batches_completed);
 
+/**
+ * get_state_synchronize_srcu - Provide an end-of-grace-period cookie
+ * @sp: srcu_struct to provide cookie for.
+ *
+ * This function returns a cookie that can be passed to
+ * poll_state_synchronize_srcu(), which will return true if a full grace
+ * period has elapsed in the meantime.  It is the caller's responsibility
+ * to make sure that grace period happens, for example, by invoking
+ * call_srcu() after return from get_state_synchronize_srcu().
+ */
+unsigned long get_state_synchronize_srcu(struct srcu_struct *sp)
+{
+	smp_mb(); /* Order prior updates before the ->srcu_gp_seq load. */
+	return rcu_seq_snap(&sp->srcu_gp_seq);
+}
+EXPORT_SYMBOL_GPL(get_state_synchronize_srcu);
+
+/**
+ * start_poll_synchronize_srcu - Provide cookie and start grace period
+ * @sp: srcu_struct to provide cookie for.
+ *
+ * This function returns a cookie that can be passed to
+ * poll_state_synchronize_srcu(), which will return true if a full grace
+ * period has elapsed in the meantime.  Unlike get_state_synchronize_srcu(),
+ * this function also ensures that any needed SRCU grace period will be
+ * started, without the caller having to queue a callback or block.
+ */
+unsigned long start_poll_synchronize_srcu(struct srcu_struct *sp)
+{
+	check_init_srcu_struct(sp);
+	return srcu_gp_start_if_needed(sp, NULL, true);
+}
+EXPORT_SYMBOL_GPL(start_poll_synchronize_srcu);
+
+/**
+ * start_poll_synchronize_srcu_expedited - Same, but expedite the grace period
+ * @sp: srcu_struct to provide cookie for.
+ *
+ * Like start_poll_synchronize_srcu(), but the grace period is driven the
+ * way synchronize_srcu_expedited() drives it.
+ */
+unsigned long start_poll_synchronize_srcu_expedited(struct srcu_struct *sp)
+{
+	check_init_srcu_struct(sp);
+	return srcu_gp_start_if_needed(sp, NULL, false);
+}
+EXPORT_SYMBOL_GPL(start_poll_synchronize_srcu_expedited);
+
+/**
+ * poll_state_synchronize_srcu - Has cookie's grace period ended?
+ * @sp: srcu_struct to provide cookie for.
+ * @cookie: Return value from get_state_synchronize_srcu() or
+ *	start_poll_synchronize_srcu().
+ *
+ * This function takes the cookie that was returned from either
+ * get_state_synchronize_srcu() or start_poll_synchronize_srcu(), and
+ * returns true if an SRCU grace period elapsed since the time that the
+ * cookie was created.  If it returns true, it also provides the same
+ * memory ordering as a return from synchronize_srcu().
+ */
+bool poll_state_synchronize_srcu(struct srcu_struct *sp, unsigned long cookie)
+{
+	if (!rcu_seq_done(&sp->srcu_gp_seq, cookie))
+		return false;
+	/* Order the caller's later accesses after the grace period. */
+	smp_mb();
+	return true;
+}
+EXPORT_SYMBOL_GPL(poll_state_synchronize_srcu);
+
 /*
  * Core SRCU state machine.  Push state bits of ->srcu_gp_seq
  * to SRCU_STATE_SCAN2, and invoke srcu_gp_end() when scan has
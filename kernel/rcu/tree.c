@@ -62,6 +62,8 @@
 #include <linux/suspend.h>
 #include <linux/ftrace.h>
 #include <linux/tick.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include "tree.h"
 #include "rcu.h"
@@ -2892,18 +2894,310 @@ void call_rcu(struct rcu_head *head, rcu_callback_t func)
 EXPORT_SYMBOL_GPL(call_rcu);
 
 /*
- * Queue an RCU callback for lazy invocation after a grace period.
- * This will likely be later named something like "call_rcu_lazy()",
- * but this change will require some way of tagging the lazy RCU
- * callbacks in the list of pending callbacks. Until then, this
- * function may only be called from __kfree_rcu().
+ * kfree_rcu() batching.  Rather than queueing one RCU callback per
+ * object, kfree_call_rcu() stores the object pointers in per-CPU arrays
+ * of a page each.  Every KFREE_DRAIN_JIFFIES the pending arrays are
+ * handed over to RCU as one batch, with a single callback, and once the
+ * grace period has elapsed a work item frees them with kfree_bulk().
+ *
+ * Objects for which no array page could be allocated are chained
+ * through their rcu_head instead, and freed one by one.
+ */
+#define KFREE_DRAIN_JIFFIES	(HZ / 50)
+#define KFREE_N_BATCHES		2
+
+struct kfree_rcu_bulk_data {
+	unsigned long nr_records;
+	struct kfree_rcu_bulk_data *next;
+	void *records[];
+};
+
+#define KFREE_BULK_MAX_ENTR \
+	((PAGE_SIZE - sizeof(struct kfree_rcu_bulk_data)) / sizeof(void *))
+
+/* One batch waiting for its grace period, then for its bulk free. */
+struct kfree_rcu_cpu_work {
+	struct rcu_head rcu;
+	struct work_struct work;
+	struct kfree_rcu_bulk_data *bhead_free;
+	struct rcu_head *head_free;
+	struct kfree_rcu_cpu *krcp;
+};
+
+struct kfree_rcu_cpu {
+	raw_spinlock_t lock;
+	struct kfree_rcu_bulk_data *bhead;	/* Arrays being filled. */
+	struct kfree_rcu_bulk_data *bcached;	/* One spare array page. */
+	struct rcu_head *head;			/* Objects not in an array. */
+	struct kfree_rcu_cpu_work krw_arr[KFREE_N_BATCHES];
+	struct delayed_work monitor_work;
+	bool monitor_todo;
+	bool initialized;
+};
+
+static DEFINE_PER_CPU(struct kfree_rcu_cpu, krc);
+
+static void kfree_rcu_free_batch(struct kfree_rcu_cpu *krcp,
+				 struct kfree_rcu_bulk_data *bhead,
+				 struct rcu_head *head)
+{
+	struct kfree_rcu_bulk_data *bnext;
+	struct rcu_head *next;
+
+	for (; bhead; bhead = bnext) {
+		bnext = bhead->next;
+		rcu_lock_acquire(&rcu_callback_map);
+		kfree_bulk(bhead->nr_records, bhead->records);
+		rcu_lock_release(&rcu_callback_map);
+		if (!krcp || cmpxchg(&krcp->bcached, NULL, bhead))
+			free_page((unsigned long)bhead);
+		cond_resched_tasks_rcu_qs();
+	}
+
+	for (; head; head = next) {
+		next = head->next;
+		debug_rcu_head_unqueue(head);
+		__rcu_reclaim(rcu_state.name, head);
+		cond_resched_tasks_rcu_qs();
+	}
+}
+
+/* The grace period of a batch has elapsed, free it. */
+static void kfree_rcu_work(struct work_struct *work)
+{
+	struct kfree_rcu_cpu_work *krwp;
+	struct kfree_rcu_bulk_data *bhead;
+	struct rcu_head *head;
+	unsigned long flags;
+
+	krwp = container_of(work, struct kfree_rcu_cpu_work, work);
+
+	raw_spin_lock_irqsave(&krwp->krcp->lock, flags);
+	bhead = krwp->bhead_free;
+	krwp->bhead_free = NULL;
+	head = krwp->head_free;
+	krwp->head_free = NULL;
+	raw_spin_unlock_irqrestore(&krwp->krcp->lock, flags);
+
+	kfree_rcu_free_batch(krwp->krcp, bhead, head);
+}
+
+/*
+ * Softirq context is no place for a big batch, punt to a worker.  This is
+ * queued as a lazy callback, see rcu_cb_is_lazy().
+ */
+void kfree_rcu_gp_done(struct rcu_head *rhp)
+{
+	struct kfree_rcu_cpu_work *krwp;
+
+	krwp = container_of(rhp, struct kfree_rcu_cpu_work, rcu);
+	queue_work(system_wq, &krwp->work);
+}
+
+/*
+ * Hand the pending objects of @krcp over to RCU in a free batch slot.
+ * Returns false if all slots are still busy.  Caller holds ->lock.
+ *
+ * A slot is only known to be busy by its non-empty lists, so an empty
+ * batch must never be queued: the slot would look free while its
+ * rcu_head is still in flight.
+ */
+static bool queue_kfree_rcu_work(struct kfree_rcu_cpu *krcp)
+{
+	struct kfree_rcu_cpu_work *krwp;
+	int i;
+
+	lockdep_assert_held(&krcp->lock);
+	if (!krcp->bhead && !krcp->head)
+		return true;
+
+	for (i = 0; i < KFREE_N_BATCHES; i++) {
+		krwp = &krcp->krw_arr[i];
+		if (krwp->bhead_free || krwp->head_free)
+			continue;
+
+		krwp->bhead_free = krcp->bhead;
+		krcp->bhead = NULL;
+		krwp->head_free = krcp->head;
+		krcp->head = NULL;
+		/* lazy, so that the nocb batching applies to it */
+		__call_rcu(&krwp->rcu, kfree_rcu_gp_done, -1, 1);
+		return true;
+	}
+	return false;
+}
+
+static void kfree_rcu_monitor(struct work_struct *work)
+{
+	struct kfree_rcu_cpu *krcp;
+	unsigned long flags;
+
+	krcp = container_of(work, struct kfree_rcu_cpu, monitor_work.work);
+
+	raw_spin_lock_irqsave(&krcp->lock, flags);
+	if (krcp->monitor_todo) {
+		if (queue_kfree_rcu_work(krcp))
+			krcp->monitor_todo = false;
+		else	/* Previous batches still in flight, retry later. */
+			schedule_delayed_work(&krcp->monitor_work,
+					      KFREE_DRAIN_JIFFIES);
+	}
+	raw_spin_unlock_irqrestore(&krcp->lock, flags);
+}
+
+static bool kfree_call_rcu_add_ptr_to_bulk(struct kfree_rcu_cpu *krcp,
+					   struct rcu_head *head,
+					   rcu_callback_t func)
+{
+	struct kfree_rcu_bulk_data *bnode;
+
+	if (!krcp->bhead || krcp->bhead->nr_records == KFREE_BULK_MAX_ENTR) {
+		bnode = xchg(&krcp->bcached, NULL);
+		if (!bnode)
+			bnode = (struct kfree_rcu_bulk_data *)
+				__get_free_page(GFP_NOWAIT | __GFP_NOWARN);
+		if (!bnode)
+			return false;
+
+		bnode->nr_records = 0;
+		bnode->next = krcp->bhead;
+		krcp->bhead = bnode;
+	}
+
+	krcp->bhead->records[krcp->bhead->nr_records++] =
+		(void *)head - (unsigned long)func;
+	return true;
+}
+
+/*
+ * Queue an object for kfree() after a grace period, see the kfree_rcu()
+ * batching comment above.  For kfree_rcu(), @func is the offset of
+ * @head in the object rather than a callback function.  This function
+ * may only be called from __kfree_rcu().
  */
 void kfree_call_rcu(struct rcu_head *head, rcu_callback_t func)
 {
-	__call_rcu(head, func, -1, 1);
+	struct kfree_rcu_cpu *krcp;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	krcp = this_cpu_ptr(&krc);
+
+	/* Too early in boot for the batching, go the plain callback way. */
+	if (unlikely(!krcp->initialized)) {
+		local_irq_restore(flags);
+		__call_rcu(head, func, -1, 1);
+		return;
+	}
+
+	raw_spin_lock(&krcp->lock);
+	if (debug_rcu_head_queue(head)) {
+		/* Probable double kfree_rcu(), just leak. */
+		WARN_ONCE(1, "%s(): Double-freed call. rcu_head %p\n",
+			  __func__, head);
+		goto unlock_return;
+	}
+
+	if (!kfree_call_rcu_add_ptr_to_bulk(krcp, head, func)) {
+		head->func = func;
+		head->next = krcp->head;
+		krcp->head = head;
+	} else {
+		debug_rcu_head_unqueue(head);
+	}
+
+	if (!krcp->monitor_todo) {
+		krcp->monitor_todo = true;
+		schedule_delayed_work(&krcp->monitor_work, KFREE_DRAIN_JIFFIES);
+	}
+
+unlock_return:
+	raw_spin_unlock_irqrestore(&krcp->lock, flags);
 }
 EXPORT_SYMBOL_GPL(kfree_call_rcu);
 
+/*
+ * Make rcu_barrier() cover the objects still pending in kfree_rcu()
+ * batches: hand them to RCU now, or if all batch slots of a CPU are busy,
+ * wait for a grace period and free them here.
+ */
+static void kfree_rcu_barrier(void)
+{
+	struct kfree_rcu_bulk_data *bhead = NULL, *btail;
+	struct rcu_head *head = NULL, *tail;
+	struct kfree_rcu_cpu *krcp;
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		krcp = per_cpu_ptr(&krc, cpu);
+		if (!krcp->initialized)
+			continue;
+
+		raw_spin_lock_irqsave(&krcp->lock, flags);
+		krcp->monitor_todo = false;
+		if (!queue_kfree_rcu_work(krcp)) {
+			for (btail = krcp->bhead; btail && btail->next;)
+				btail = btail->next;
+			if (btail) {
+				btail->next = bhead;
+				bhead = krcp->bhead;
+				krcp->bhead = NULL;
+			}
+			for (tail = krcp->head; tail && tail->next;)
+				tail = tail->next;
+			if (tail) {
+				tail->next = head;
+				head = krcp->head;
+				krcp->head = NULL;
+			}
+		}
+		raw_spin_unlock_irqrestore(&krcp->lock, flags);
+	}
+
+	if (bhead || head) {
+		synchronize_rcu();
+		kfree_rcu_free_batch(NULL, bhead, head);
+	}
+}
+
+/* Wait for the bulk frees of the batches rcu_barrier() has waited for. */
+static void kfree_rcu_barrier_flush(void)
+{
+	struct kfree_rcu_cpu *krcp;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		krcp = per_cpu_ptr(&krc, cpu);
+		if (!krcp->initialized)
+			continue;
+		for (i = 0; i < KFREE_N_BATCHES; i++)
+			flush_work(&krcp->krw_arr[i].work);
+	}
+}
+
+static int __init kfree_rcu_batch_init(void)
+{
+	struct kfree_rcu_cpu *krcp;
+	unsigned long flags;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		krcp = per_cpu_ptr(&krc, cpu);
+		raw_spin_lock_init(&krcp->lock);
+		for (i = 0; i < KFREE_N_BATCHES; i++) {
+			INIT_WORK(&krcp->krw_arr[i].work, kfree_rcu_work);
+			krcp->krw_arr[i].krcp = krcp;
+		}
+		INIT_DELAYED_WORK(&krcp->monitor_work, kfree_rcu_monitor);
+		raw_spin_lock_irqsave(&krcp->lock, flags);
+		krcp->initialized = true;
+		raw_spin_unlock_irqrestore(&krcp->lock, flags);
+	}
+	return 0;
+}
+early_initcall(kfree_rcu_batch_init);
+
 /**
  * get_state_synchronize_rcu - Snapshot current RCU state
  *
@@ -3073,6 +3367,9 @@ void rcu_barrier(void)
 
 	rcu_barrier_trace(TPS("Begin"), -1, s);
 
+	/* Queue up what kfree_rcu() has batched but not yet handed to RCU. */
+	kfree_rcu_barrier();
+
 	/* Take mutex to serialize concurrent rcu_barrier() requests. */
 	mutex_lock(&rcu_state.barrier_mutex);
 
@@ -3140,6 +3437,7 @@ void rcu_barrier(void)
 
 	/* Wait for all rcu_barrier_callback() callbacks to be invoked. */
 	wait_for_completion(&rcu_state.barrier_completion);
+	kfree_rcu_barrier_flush();
 
 	/* Mark the end of the barrier operation. */
 	rcu_barrier_trace(TPS("Inc2"), -1, rcu_state.barrier_sequence);
@@ -61,6 +61,9 @@ DEFINE_PER_CPU(char, rcu_cpu_has_work);
 #ifdef CONFIG_RCU_NOCB_CPU
 static cpumask_var_t rcu_nocb_mask; /* CPUs to have callbacks offloaded. */
 static bool __read_mostly rcu_nocb_poll;    /* Offload kthread are to poll. */
+/* How long a queue of only lazy callbacks may wait for its rcuo kthread. */
+static ulong rcu_nocb_lazy_jiffies = HZ;
+module_param(rcu_nocb_lazy_jiffies, ulong, 0644);
 #endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 
 /*
@@ -1935,6 +1938,8 @@ static void __wake_nocb_leader(struct rcu_data *rdp, bool force,
 	if (rdp_leader->nocb_leader_sleep || force) {
 		/* Prior smp_mb__after_atomic() orders against prior enqueue. */
 		WRITE_ONCE(rdp_leader->nocb_leader_sleep, false);
+		/* This wakeup satisfies any deferred one, lazy included. */
+		WRITE_ONCE(rdp->nocb_defer_wakeup, RCU_NOCB_WAKE_NOT);
 		del_timer(&rdp->nocb_timer);
 		raw_spin_unlock_irqrestore(&rdp->nocb_lock, flags);
 		smp_mb(); /* ->nocb_leader_sleep before swake_up_one(). */
@@ -1958,7 +1963,9 @@ static void wake_nocb_leader(struct rcu_data *rdp, bool force)
 
 /*
  * Arrange to wake the leader kthread for this NOCB group at some
- * future time when it is safe to do so.
+ * future time when it is safe to do so.  RCU_NOCB_WAKE_LAZY wakeups
+ * are left to ->nocb_timer alone, rcu_nocb_lazy_jiffies from now,
+ * so that lazy callbacks can batch up.
  */
 static void wake_nocb_leader_defer(struct rcu_data *rdp, int waketype,
 				   const char *reason)
@@ -1966,9 +1973,15 @@ static void wake_nocb_leader_defer(struct rcu_data *rdp, int waketype,
 	unsigned long flags;
 
 	raw_spin_lock_irqsave(&rdp->nocb_lock, flags);
-	if (rdp->nocb_defer_wakeup == RCU_NOCB_WAKE_NOT)
+	if (waketype == RCU_NOCB_WAKE_LAZY) {
+		if (rdp->nocb_defer_wakeup == RCU_NOCB_WAKE_NOT)
+			mod_timer(&rdp->nocb_timer,
+				  jiffies + rcu_nocb_lazy_jiffies);
+	} else if (rdp->nocb_defer_wakeup <= RCU_NOCB_WAKE_LAZY) {
 		mod_timer(&rdp->nocb_timer, jiffies + 1);
-	WRITE_ONCE(rdp->nocb_defer_wakeup, waketype);
+	}
+	if (rdp->nocb_defer_wakeup < waketype)
+		WRITE_ONCE(rdp->nocb_defer_wakeup, waketype);
 	trace_rcu_nocb_wake(rcu_state.name, rdp->cpu, reason);
 	raw_spin_unlock_irqrestore(&rdp->nocb_lock, flags);
 }
@@ -2053,9 +2066,17 @@ static void __call_rcu_nocb_enqueue(struct rcu_data *rdp,
 		return;
 	}
 	len = atomic_long_read(&rdp->nocb_q_count);
-	if (old_rhpp == &rdp->nocb_head) {
+	if (old_rhpp == &rdp->nocb_head && rhcount == rhcount_lazy &&
+	    rcu_nocb_lazy_jiffies) {
+		/* ... not if the queue holds only lazy callbacks ... */
+		wake_nocb_leader_defer(rdp, RCU_NOCB_WAKE_LAZY,
+				       TPS("WakeEmptyIsLazy"));
+		rdp->qlen_last_fqs_check = 0;
+	} else if (old_rhpp == &rdp->nocb_head ||
+		   (rhcount > rhcount_lazy &&
+		    READ_ONCE(rdp->nocb_defer_wakeup) == RCU_NOCB_WAKE_LAZY)) {
 		if (!irqs_disabled_flags(flags)) {
-			/* ... if queue was empty ... */
+			/* ... if queue was empty or only lazy ... */
 			wake_nocb_leader(rdp, false);
 			trace_rcu_nocb_wake(rcu_state.name, rdp->cpu,
 					    TPS("WakeEmpty"));
@@ -2358,10 +2379,13 @@ static int rcu_nocb_kthread(void *arg)
 	return 0;
 }
 
-/* Is a deferred wakeup of rcu_nocb_kthread() required? */
+/*
+ * Is a deferred wakeup of rcu_nocb_kthread() required?  Lazy ones are
+ * left for ->nocb_timer.
+ */
 static int rcu_nocb_need_deferred_wakeup(struct rcu_data *rdp)
 {
-	return READ_ONCE(rdp->nocb_defer_wakeup);
+	return READ_ONCE(rdp->nocb_defer_wakeup) > RCU_NOCB_WAKE_LAZY;
 }
 
 /* Do a deferred wakeup of rcu_nocb_kthread(). */
@@ -2371,7 +2395,7 @@ static void do_nocb_deferred_wakeup_common(struct rcu_data *rdp)
 	int ndw;
 
 	raw_spin_lock_irqsave(&rdp->nocb_lock, flags);
-	if (!rcu_nocb_need_deferred_wakeup(rdp)) {
+	if (READ_ONCE(rdp->nocb_defer_wakeup) == RCU_NOCB_WAKE_NOT) {
 		raw_spin_unlock_irqrestore(&rdp->nocb_lock, flags);
 		return;
 	}
@@ -2492,10 +2516,12 @@ static void rcu_spawn_one_nocb_kthread(int cpu)
 		rdp_spawn->nocb_next_follower = rdp_old_leader;
 	}
 
-	/* Spawn the kthread for this CPU. */
-	t = kthread_run(rcu_nocb_kthread, rdp_spawn,
-			"rcuo%c/%d", rcu_state.abbr, cpu);
+	/* Spawn the kthread for this CPU, with its stack on the CPU's node. */
+	t = kthread_create_on_node(rcu_nocb_kthread, rdp_spawn,
+				   cpu_to_node(cpu), "rcuo%c/%d",
+				   rcu_state.abbr, cpu);
 	BUG_ON(IS_ERR(t));
+	wake_up_process(t);
 	WRITE_ONCE(rdp_spawn->nocb_kthread, t);
 }
 
@@ -2528,7 +2554,9 @@ static int rcu_nocb_leader_stride = -1;
 module_param(rcu_nocb_leader_stride, int, 0444);
 
 /*
- * Initialize leader-follower relationships for all no-CBs CPU.
+ * Initialize leader-follower relationships for all no-CBs CPU.  A group
+ * never spans NUMA nodes, so that a leader only ever touches the
+ * callback lists and rcuo kthreads of its own node.
  */
 static void __init rcu_organize_nocb_kthreads(void)
 {
@@ -2553,7 +2581,8 @@ static void __init rcu_organize_nocb_kthreads(void)
 	 */
 	for_each_cpu(cpu, rcu_nocb_mask) {
 		rdp = per_cpu_ptr(&rcu_data, cpu);
-		if (rdp->cpu >= nl) {
+		if (rdp->cpu >= nl ||
+		    cpu_to_node(cpu) != cpu_to_node(rdp_leader->cpu)) {
 			/* New leader, set up for followers & next leader. */
 			nl = DIV_ROUND_UP(rdp->cpu + 1, ls) * ls;
 			rdp->nocb_leader = rdp;
@@ -3795,6 +3795,15 @@ place_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int initial)
 		if (sched_feat(GENTLE_FAIR_SLEEPERS))
 			thresh >>= 1;
 
+		/*
+		 * Tasks that declared themselves latency tolerant get less
+		 * sleeper credit; the latency sensitive ones get no more than
+		 * before, so that the hint never buys extra CPU share.
+		 */
+		if (entity_is_task(se) && task_of(se)->latency_nice > 0)
+			thresh -= thresh * task_of(se)->latency_nice /
+				  (LATENCY_NICE_WIDTH / 2);
+
 		vruntime -= thresh;
 	}
 
@@ -4264,7 +4273,13 @@ void __refill_cfs_bandwidth_runtime(struct cfs_bandwidth *cfs_b)
 		return;
 
 	now = sched_clock_cpu(smp_processor_id());
-	cfs_b->runtime = cfs_b->quota;
+	/*
+	 * Quota left unused in a period carries over, up to burst on top of
+	 * one period's worth, so that bursty groups that stay within their
+	 * average don't get throttled.
+	 */
+	cfs_b->runtime += cfs_b->quota;
+	cfs_b->runtime = min(cfs_b->runtime, cfs_b->quota + cfs_b->burst);
 	cfs_b->runtime_expires = now + ktime_to_ns(cfs_b->period);
 	cfs_b->expires_seq++;
 }
@@ -4601,6 +4616,9 @@ static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
 	throttled = !list_empty(&cfs_b->throttled_cfs_rq);
 	cfs_b->nr_periods += overrun;
 
+	/* Refill extra burst quota even if cfs_b->idle */
+	__refill_cfs_bandwidth_runtime(cfs_b);
+
 	/*
 	 * idle depends on !throttled (for the case of a large deficit), and if
 	 * we're going inactive then everything else can be deferred
@@ -4608,8 +4626,6 @@ static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
 	if (cfs_b->idle && !throttled)
 		goto out_deactivate;
 
-	__refill_cfs_bandwidth_runtime(cfs_b);
-
 	if (!throttled) {
 		/* mark as potentially idle for the upcoming period */
 		cfs_b->idle = 1;
@@ -4878,6 +4894,7 @@ void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
 	cfs_b->runtime = 0;
 	cfs_b->quota = RUNTIME_INF;
 	cfs_b->period = ns_to_ktime(default_cfs_period());
+	cfs_b->burst = 0;
 
 	INIT_LIST_HEAD(&cfs_b->throttled_cfs_rq);
 	hrtimer_init(&cfs_b->period_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_PINNED);
@@ -6058,13 +6075,42 @@ static inline int select_idle_smt(struct task_struct *p, struct sched_domain *sd
 
 #endif /* CONFIG_SCHED_SMT */
 
+/*
+ * Record in sd_llc_shared whether this CPU is running its idle task, so that
+ * select_idle_cpu() only has to look at CPUs that are likely to be idle
+ * rather than walking the whole LLC. Only our own bit is written, and only
+ * when it changes, to keep the shared cacheline quiet.
+ */
+void update_idle_cpumask(struct rq *rq, bool idle)
+{
+	struct sched_domain_shared *sds;
+	int cpu = cpu_of(rq);
+
+	if (!sched_feat(SIS_IDLE_MASK))
+		return;
+
+	rcu_read_lock();
+	sds = rcu_dereference(per_cpu(sd_llc_shared, cpu));
+	if (sds && cpumask_test_cpu(cpu, sds_idle_cpus(sds)) != idle) {
+		if (idle)
+			cpumask_set_cpu(cpu, sds_idle_cpus(sds));
+		else
+			cpumask_clear_cpu(cpu, sds_idle_cpus(sds));
+	}
+	rcu_read_unlock();
+}
+
 /*
  * Scan the LLC domain for idle CPUs; this is dynamically regulated by
  * comparing the average scan cost (tracked in sd->avg_scan_cost) against the
  * average idle time for this rq (as found in rq->avg_idle).
+ *
+ * With SIS_IDLE_MASK only the CPUs last seen entering idle are visited; the
+ * mask is a hint and each candidate is still checked with available_idle_cpu().
  */
 static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int target)
 {
+	struct cpumask *cpus = this_cpu_cpumask_var_ptr(select_idle_mask);
 	struct sched_domain *this_sd;
 	u64 avg_cost, avg_idle;
 	u64 time, cost;
@@ -6095,11 +6141,13 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int t
 
 	time = local_clock();
 
-	for_each_cpu_wrap(cpu, sched_domain_span(sd), target) {
+	cpumask_and(cpus, sched_domain_span(sd), &p->cpus_allowed);
+	if (sched_feat(SIS_IDLE_MASK) && sd->shared)
+		cpumask_and(cpus, cpus, sds_idle_cpus(sd->shared));
+
+	for_each_cpu_wrap(cpu, cpus, target) {
 		if (!--nr)
 			return -1;
-		if (!cpumask_test_cpu(cpu, &p->cpus_allowed))
-			continue;
 		if (available_idle_cpu(cpu))
 			break;
 	}
@@ -6489,6 +6537,20 @@ static unsigned long wakeup_gran(struct sched_entity *se)
 	return calc_delta_fair(gran, se);
 }
 
+/*
+ * Wakeup preemption bias from the tasks' latency_nice hints, scaled so that
+ * the full range spans one sched_latency period. Group entities carry no
+ * hint.
+ */
+static s64 wakeup_latency_offset(struct sched_entity *se)
+{
+	if (!entity_is_task(se))
+		return 0;
+
+	return div_s64((s64)task_of(se)->latency_nice * sysctl_sched_latency,
+		       LATENCY_NICE_WIDTH);
+}
+
 /*
  * Should 'se' preempt 'curr'.
  *
@@ -6508,6 +6570,12 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 {
 	s64 gran, vdiff = curr->vruntime - se->vruntime;
 
+	/*
+	 * A latency sensitive waker, or a curr that doesn't mind, makes
+	 * preemption easier without changing either task's share.
+	 */
+	vdiff += wakeup_latency_offset(curr) - wakeup_latency_offset(se);
+
 	if (vdiff <= 0)
 		return -1;
 
@@ -7005,6 +7073,7 @@ struct lb_env {
  */
 static int task_hot(struct task_struct *p, struct lb_env *env)
 {
+	u64 cost;
 	s64 delta;
 
 	lockdep_assert_held(&env->src_rq->lock);
@@ -7030,7 +7099,14 @@ static int task_hot(struct task_struct *p, struct lb_env *env)
 
 	delta = rq_clock_task(env->src_rq) - p->se.exec_start;
 
-	return delta < (s64)sysctl_sched_migration_cost;
+	/*
+	 * The cost of losing cache (and, across nodes, memory) locality grows
+	 * with the distance spanned by the domain being balanced.
+	 */
+	cost = div_u64((u64)sysctl_sched_migration_cost *
+		       env->sd->migration_cost_factor, LOCAL_DISTANCE);
+
+	return delta < (s64)cost;
 }
 
 #ifdef CONFIG_NUMA_BALANCING
@@ -7387,6 +7463,23 @@ static inline bool others_have_blocked(struct rq *rq)
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 
+/*
+ * The list is ordered bottom-up, so a child of @cfs_rq that is still on the
+ * list sits right before it.
+ */
+static inline bool child_cfs_rq_on_list(struct cfs_rq *cfs_rq)
+{
+	struct list_head *prev = cfs_rq->leaf_cfs_rq_list.prev;
+	struct cfs_rq *prev_cfs_rq;
+
+	if (prev == &rq_of(cfs_rq)->leaf_cfs_rq_list)
+		return false;
+
+	prev_cfs_rq = container_of(prev, struct cfs_rq, leaf_cfs_rq_list);
+
+	return prev_cfs_rq->tg->parent == cfs_rq->tg;
+}
+
 static inline bool cfs_rq_is_decayed(struct cfs_rq *cfs_rq)
 {
 	if (cfs_rq->load.weight)
@@ -7401,10 +7494,17 @@ static inline bool cfs_rq_is_decayed(struct cfs_rq *cfs_rq)
 	if (cfs_rq->avg.runnable_load_sum)
 		return false;
 
+	/*
+	 * Removing a parent ahead of its children would break the bottom-up
+	 * order that list_add_leaf_cfs_rq() relies on when they re-enqueue.
+	 */
+	if (child_cfs_rq_on_list(cfs_rq))
+		return false;
+
 	return true;
 }
 
-static void update_blocked_averages(int cpu)
+static void __update_blocked_averages(int cpu)
 {
 	struct rq *rq = cpu_rq(cpu);
 	struct cfs_rq *cfs_rq, *pos;
@@ -7454,8 +7554,8 @@ static void update_blocked_averages(int cpu)
 	if (others_have_blocked(rq))
 		done = false;
 
+	WRITE_ONCE(rq->last_blocked_load_update_tick, jiffies);
 #ifdef CONFIG_NO_HZ_COMMON
-	rq->last_blocked_load_update_tick = jiffies;
 	if (done)
 		rq->has_blocked_load = 0;
 #endif
@@ -7509,7 +7609,7 @@ static unsigned long task_h_load(struct task_struct *p)
 			cfs_rq_load_avg(cfs_rq) + 1);
 }
 #else
-static inline void update_blocked_averages(int cpu)
+static inline void __update_blocked_averages(int cpu)
 {
 	struct rq *rq = cpu_rq(cpu);
 	struct cfs_rq *cfs_rq = &rq->cfs;
@@ -7524,8 +7624,8 @@ static inline void update_blocked_averages(int cpu)
 	update_rt_rq_load_avg(rq_clock_task(rq), rq, curr_class == &rt_sched_class);
 	update_dl_rq_load_avg(rq_clock_task(rq), rq, curr_class == &dl_sched_class);
 	update_irq_load_avg(rq, 0);
+	WRITE_ONCE(rq->last_blocked_load_update_tick, jiffies);
 #ifdef CONFIG_NO_HZ_COMMON
-	rq->last_blocked_load_update_tick = jiffies;
 	if (!cfs_rq_has_blocked(cfs_rq) && !others_have_blocked(rq))
 		rq->has_blocked_load = 0;
 #endif
@@ -7538,6 +7638,23 @@ static unsigned long task_h_load(struct task_struct *p)
 }
 #endif
 
+/*
+ * Idle balance, nohz balance and the periodic balance can all ask for an
+ * update within the same tick. Blocked load barely changes within a PELT
+ * period, so walking every cfs_rq again is pure overhead when there are
+ * thousands of cgroups. Callers that need the update regardless use
+ * __update_blocked_averages().
+ */
+static void update_blocked_averages(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+
+	if (!time_after(jiffies, READ_ONCE(rq->last_blocked_load_update_tick)))
+		return;
+
+	__update_blocked_averages(cpu);
+}
+
 /********** Helpers for find_busiest_group ************************/
 
 /*
@@ -7884,7 +8001,7 @@ static bool update_nohz_stats(struct rq *rq, bool force)
 	if (!force && !time_after(jiffies, rq->last_blocked_load_update_tick))
 		return true;
 
-	update_blocked_averages(cpu);
+	__update_blocked_averages(cpu);
 
 	return rq->has_blocked_load;
 #else
@@ -9487,7 +9604,7 @@ static bool _nohz_idle_balance(struct rq *this_rq, unsigned int flags,
 
 	/* Newly idle CPU doesn't need an update */
 	if (idle != CPU_NEWLY_IDLE) {
-		update_blocked_averages(this_cpu);
+		__update_blocked_averages(this_cpu);
 		has_blocked_load |= this_rq->has_blocked_load;
 	}
 
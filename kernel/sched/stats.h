@@ -69,6 +69,9 @@ static inline void psi_enqueue(struct task_struct *p, bool wakeup)
 	if (static_branch_likely(&psi_disabled))
 		return;
 
+	if (wakeup)
+		p->sched_psi_woken = 1;
+
 	if (!wakeup || p->sched_psi_wake_requeue) {
 		if (p->flags & PF_MEMSTALL)
 			set |= TSK_MEMSTALL;
@@ -126,6 +129,19 @@ static inline void psi_ttwu_dequeue(struct task_struct *p)
 	}
 }
 
+static inline void psi_sched_arrive(struct task_struct *p, u64 delay)
+{
+	bool woken;
+
+	if (static_branch_likely(&psi_disabled))
+		return;
+
+	woken = p->sched_psi_woken;
+	p->sched_psi_woken = 0;
+
+	psi_sched_delay(p, delay, woken);
+}
+
 static inline void psi_task_tick(struct rq *rq)
 {
 	if (static_branch_likely(&psi_disabled))
@@ -138,6 +154,7 @@ static inline void psi_task_tick(struct rq *rq)
 static inline void psi_enqueue(struct task_struct *p, bool wakeup) {}
 static inline void psi_dequeue(struct task_struct *p, bool sleep) {}
 static inline void psi_ttwu_dequeue(struct task_struct *p) {}
+static inline void psi_sched_arrive(struct task_struct *p, u64 delay) {}
 static inline void psi_task_tick(struct rq *rq) {}
 #endif /* CONFIG_PSI */
 
@@ -183,6 +200,7 @@ static void sched_info_arrive(struct rq *rq, struct task_struct *t)
 	t->sched_info.pcount++;
 
 	rq_sched_info_arrive(rq, delta);
+	psi_sched_arrive(t, delta);
 }
 
 /*
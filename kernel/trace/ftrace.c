@@ -1044,6 +1044,7 @@ static bool update_all_ops;
 struct ftrace_func_entry {
 	struct hlist_node hlist;
 	unsigned long ip;
+	unsigned long direct; /* for direct lookup only */
 };
 
 struct ftrace_func_probe {
@@ -1755,6 +1756,10 @@ static bool __ftrace_hash_rec_update(struct ftrace_ops *ops,
 			 */
 			if (ops->flags & FTRACE_OPS_FL_SAVE_REGS)
 				rec->flags |= FTRACE_FL_REGS;
+
+			/* Only the internal direct_ops sets DIRECT. */
+			if (ops->flags & FTRACE_OPS_FL_DIRECT)
+				rec->flags |= FTRACE_FL_DIRECT;
 		} else {
 			if (FTRACE_WARN_ON(ftrace_rec_count(rec) == 0))
 				return false;
@@ -1784,6 +1789,13 @@ static bool __ftrace_hash_rec_update(struct ftrace_ops *ops,
 			 */
 			rec->flags &= ~FTRACE_FL_TRAMP;
 
+			/*
+			 * Only the internal direct_ops has the DIRECT flag,
+			 * so a function it stops tracing is no longer direct.
+			 */
+			if (ops->flags & FTRACE_OPS_FL_DIRECT)
+				rec->flags &= ~FTRACE_FL_DIRECT;
+
 			/*
 			 * flags will be cleared in ftrace_check_record()
 			 * if rec count is zero.
@@ -1977,6 +1989,32 @@ static void print_ip_ins(const char *fmt, const unsigned char *p)
 
 static struct ftrace_ops *
 ftrace_find_tramp_ops_any(struct dyn_ftrace *rec);
+
+#ifdef CONFIG_DYNAMIC_FTRACE_WITH_DIRECT_CALLS
+/* Protected by rcu_tasks for reading, and direct_mutex for writing */
+static struct ftrace_hash *direct_functions = EMPTY_HASH;
+static DEFINE_MUTEX(direct_mutex);
+
+/*
+ * Search the direct_functions hash to see if the given instruction pointer
+ * has a direct caller attached to it.
+ */
+static unsigned long ftrace_find_rec_direct(unsigned long ip)
+{
+	struct ftrace_func_entry *entry;
+
+	entry = ftrace_lookup_ip(direct_functions, ip);
+	if (!entry)
+		return 0;
+
+	return entry->direct;
+}
+#else
+static inline unsigned long ftrace_find_rec_direct(unsigned long ip)
+{
+	return 0;
+}
+#endif /* CONFIG_DYNAMIC_FTRACE_WITH_DIRECT_CALLS */
 static struct ftrace_ops *
 ftrace_find_tramp_ops_next(struct dyn_ftrace *rec, struct ftrace_ops *ops);
 
@@ -2107,6 +2145,19 @@ static int ftrace_check_record(struct dyn_ftrace *rec, int enable, int update)
 		if (!(rec->flags & FTRACE_FL_TRAMP) != 
 		    !(rec->flags & FTRACE_FL_TRAMP_EN))
 			flag |= FTRACE_FL_TRAMP;
+
+		/*
+		 * The site can only call the direct function itself while
+		 * direct_ops is its only user.
+		 */
+		if (ftrace_rec_count(rec) == 1) {
+			if (!(rec->flags & FTRACE_FL_DIRECT) !=
+			    !(rec->flags & FTRACE_FL_DIRECT_EN))
+				flag |= FTRACE_FL_DIRECT;
+		} else {
+			if (rec->flags & FTRACE_FL_DIRECT_EN)
+				flag |= FTRACE_FL_DIRECT;
+		}
 	}
 
 	/* If the state of this record hasn't changed, then do nothing */
@@ -2131,6 +2182,13 @@ static int ftrace_check_record(struct dyn_ftrace *rec, int enable, int update)
 				else
 					rec->flags &= ~FTRACE_FL_TRAMP_EN;
 			}
+			if (flag & FTRACE_FL_DIRECT) {
+				if (ftrace_rec_count(rec) == 1 &&
+				    rec->flags & FTRACE_FL_DIRECT)
+					rec->flags |= FTRACE_FL_DIRECT_EN;
+				else
+					rec->flags &= ~FTRACE_FL_DIRECT_EN;
+			}
 		}
 
 		/*
@@ -2160,7 +2218,7 @@ static int ftrace_check_record(struct dyn_ftrace *rec, int enable, int update)
 			 * and REGS states. The _EN flags must be disabled though.
 			 */
 			rec->flags &= ~(FTRACE_FL_ENABLED | FTRACE_FL_TRAMP_EN |
-					FTRACE_FL_REGS_EN);
+					FTRACE_FL_REGS_EN | FTRACE_FL_DIRECT_EN);
 	}
 
 	ftrace_bug_type = FTRACE_BUG_NOP;
@@ -2328,6 +2386,15 @@ ftrace_find_tramp_ops_new(struct dyn_ftrace *rec)
 unsigned long ftrace_get_addr_new(struct dyn_ftrace *rec)
 {
 	struct ftrace_ops *ops;
+	unsigned long addr;
+
+	/* A lone direct function is called without any ftrace trampoline */
+	if ((rec->flags & FTRACE_FL_DIRECT) && ftrace_rec_count(rec) == 1) {
+		addr = ftrace_find_rec_direct(rec->ip);
+		if (addr)
+			return addr;
+		WARN_ON_ONCE(1);
+	}
 
 	/* Trampolines take precedence over regs */
 	if (rec->flags & FTRACE_FL_TRAMP) {
@@ -2360,6 +2427,15 @@ unsigned long ftrace_get_addr_new(struct dyn_ftrace *rec)
 unsigned long ftrace_get_addr_curr(struct dyn_ftrace *rec)
 {
 	struct ftrace_ops *ops;
+	unsigned long addr;
+
+	/* Direct calls take precedence over trampolines */
+	if (rec->flags & FTRACE_FL_DIRECT_EN) {
+		addr = ftrace_find_rec_direct(rec->ip);
+		if (addr)
+			return addr;
+		WARN_ON_ONCE(1);
+	}
 
 	/* Trampolines take precedence over regs */
 	if (rec->flags & FTRACE_FL_TRAMP_EN) {
@@ -4759,6 +4835,192 @@ int ftrace_set_filter_ip(struct ftrace_ops *ops, unsigned long ip,
 }
 EXPORT_SYMBOL_GPL(ftrace_set_filter_ip);
 
+#ifdef CONFIG_DYNAMIC_FTRACE_WITH_DIRECT_CALLS
+/*
+ * Used when the site of a direct function is shared with other ftrace
+ * users and goes through ftrace_regs_caller: it returns into the direct
+ * function instead of the traced one.
+ */
+static void call_direct_funcs(unsigned long ip, unsigned long pip,
+			      struct ftrace_ops *ops, struct pt_regs *regs)
+{
+	unsigned long addr;
+
+	addr = ftrace_find_rec_direct(ip);
+	if (!addr)
+		return;
+
+	arch_ftrace_set_direct_caller(regs, addr);
+}
+
+static struct ftrace_ops direct_ops = {
+	.func		= call_direct_funcs,
+	.flags		= FTRACE_OPS_FL_IPMODIFY | FTRACE_OPS_FL_DIRECT |
+			  FTRACE_OPS_FL_SAVE_REGS,
+};
+
+static void ftrace_stub_direct(unsigned long ip, unsigned long pip,
+			       struct ftrace_ops *ops, struct pt_regs *regs)
+{
+}
+
+/* Parks a direct site in ftrace_regs_caller while its address changes */
+static struct ftrace_ops stub_ops = {
+	.func		= ftrace_stub_direct,
+	.flags		= FTRACE_OPS_FL_RECURSION_SAFE,
+};
+
+/**
+ * register_ftrace_direct - Call a custom trampoline directly
+ * @ip: The address of the mcount/fentry site of the function to trace
+ * @addr: The address of the trampoline to call at @ip
+ *
+ * Unlike an ftrace_ops callback, @addr is called in place of the ftrace
+ * trampoline and must save and restore the registers the traced function
+ * expects itself.  While @addr is the only user of @ip, the call site
+ * calls it with a plain call instruction.
+ *
+ * Returns:
+ *  0 on success
+ *  -EBUSY - Another direct function is already attached to @ip
+ *  -ENODEV - @ip does not point to a ftrace nop location
+ *  -ENOMEM - There was an allocation failure
+ */
+int register_ftrace_direct(unsigned long ip, unsigned long addr)
+{
+	struct ftrace_func_entry *entry;
+	struct ftrace_hash *hash;
+	unsigned long key;
+	int ret = -EBUSY;
+
+	mutex_lock(&direct_mutex);
+
+	if (ftrace_find_rec_direct(ip))
+		goto out_unlock;
+
+	ret = -ENODEV;
+	if (ftrace_location(ip) != ip)
+		goto out_unlock;
+
+	ret = -ENOMEM;
+	if (direct_functions == EMPTY_HASH) {
+		hash = alloc_ftrace_hash(FTRACE_HASH_DEFAULT_BITS);
+		if (!hash)
+			goto out_unlock;
+		rcu_assign_pointer(direct_functions, hash);
+	}
+
+	entry = kmalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		goto out_unlock;
+
+	entry->ip = ip;
+	entry->direct = addr;
+	key = ftrace_hash_key(direct_functions, ip);
+	hlist_add_head_rcu(&entry->hlist, &direct_functions->buckets[key]);
+	direct_functions->count++;
+
+	ret = ftrace_set_filter_ip(&direct_ops, ip, 0, 0);
+	if (!ret && !(direct_ops.flags & FTRACE_OPS_FL_ENABLED)) {
+		ret = register_ftrace_function(&direct_ops);
+		if (ret)
+			ftrace_set_filter_ip(&direct_ops, ip, 1, 0);
+	}
+
+	if (ret) {
+		remove_hash_entry(direct_functions, entry);
+		synchronize_rcu_tasks();
+		kfree(entry);
+	}
+ out_unlock:
+	mutex_unlock(&direct_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(register_ftrace_direct);
+
+/**
+ * unregister_ftrace_direct - Remove the direct function attached to @ip
+ * @ip: The address the direct function was registered at
+ * @addr: The direct function itself
+ */
+int unregister_ftrace_direct(unsigned long ip, unsigned long addr)
+{
+	struct ftrace_func_entry *entry;
+	int ret = -ENODEV;
+
+	mutex_lock(&direct_mutex);
+
+	entry = ftrace_lookup_ip(direct_functions, ip);
+	if (!entry || entry->direct != addr)
+		goto out_unlock;
+
+	/*
+	 * Dropping the last filter entry of a registered ops would make it
+	 * trace every function, so unregister it first.
+	 */
+	if (direct_functions->count == 1)
+		unregister_ftrace_function(&direct_ops);
+
+	ret = ftrace_set_filter_ip(&direct_ops, ip, 1, 0);
+	WARN_ON(ret);
+
+	remove_hash_entry(direct_functions, entry);
+	/* ftrace_regs_caller on another CPU may still be looking at it */
+	synchronize_rcu_tasks();
+	kfree(entry);
+ out_unlock:
+	mutex_unlock(&direct_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(unregister_ftrace_direct);
+
+/**
+ * modify_ftrace_direct - Switch the direct function attached to @ip
+ * @ip: The address the direct function was registered at
+ * @old_addr: The direct function currently attached
+ * @new_addr: The direct function to call from now on
+ *
+ * While the address changes, a stub ops shares the site so the site goes
+ * through ftrace_regs_caller and call_direct_funcs(). That way the call
+ * site is never rewritten from one direct address to another, and any
+ * CPU sees either @old_addr or @new_addr.
+ */
+int modify_ftrace_direct(unsigned long ip, unsigned long old_addr,
+			 unsigned long new_addr)
+{
+	struct ftrace_func_entry *entry;
+	int ret = -ENODEV;
+
+	mutex_lock(&direct_mutex);
+
+	entry = ftrace_lookup_ip(direct_functions, ip);
+	if (!entry || entry->direct != old_addr)
+		goto out_unlock;
+
+	ret = ftrace_set_filter_ip(&stub_ops, ip, 0, 1);
+	if (ret)
+		goto out_unlock;
+
+	ret = register_ftrace_function(&stub_ops);
+	if (ret) {
+		ftrace_set_filter_ip(&stub_ops, ip, 1, 0);
+		goto out_unlock;
+	}
+
+	WRITE_ONCE(entry->direct, new_addr);
+
+	unregister_ftrace_function(&stub_ops);
+	ftrace_set_filter_ip(&stub_ops, ip, 1, 0);
+ out_unlock:
+	mutex_unlock(&direct_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(modify_ftrace_direct);
+#endif /* CONFIG_DYNAMIC_FTRACE_WITH_DIRECT_CALLS */
+
 /**
  * ftrace_ops_set_global_filter - setup ops to use global filters
  * @ops - the ops which will use the global filters
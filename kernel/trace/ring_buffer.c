@@ -13,6 +13,7 @@
 #include <linux/irq_work.h>
 #include <linux/uaccess.h>
 #include <linux/hardirq.h>
+#include <linux/highmem.h>
 #include <linux/kthread.h>	/* for self test */
 #include <linux/module.h>
 #include <linux/percpu.h>
@@ -330,6 +331,7 @@ struct buffer_page {
 	unsigned	 read;		/* index for next read */
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
+	unsigned	 id;		/* page index in a user mapping */
 	struct buffer_data_page *page;	/* Actual data page */
 };
 
@@ -472,6 +474,8 @@ struct ring_buffer_per_cpu {
 	struct buffer_data_page		*free_page;
 	unsigned long			nr_pages;
 	unsigned int			current_context;
+	/* absolute time stamp of the event reserved in each context */
+	u64				event_stamp[RB_CTX_MAX * 2];
 	struct list_head		*pages;
 	struct buffer_page		*head_page;	/* read from head */
 	struct buffer_page		*tail_page;	/* write to tail */
@@ -498,6 +502,12 @@ struct ring_buffer_per_cpu {
 	struct completion		update_done;
 
 	struct rb_irq_work		irq_work;
+
+	/* user space mappings, see ring_buffer_map() */
+	struct mutex			mapping_lock;
+	unsigned int			mapped;
+	unsigned long			*subbuf_ids;	/* page address by id */
+	struct trace_buffer_meta	*meta_page;
 };
 
 struct ring_buffer {
@@ -1280,6 +1290,7 @@ rb_allocate_cpu_buffer(struct ring_buffer *buffer, long nr_pages, int cpu)
 	init_irq_work(&cpu_buffer->irq_work.work, rb_wake_up_waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.full_waiters);
+	mutex_init(&cpu_buffer->mapping_lock);
 
 	bpage = kzalloc_node(ALIGN(sizeof(*bpage), cache_line_size()),
 			    GFP_KERNEL, cpu_to_node(cpu));
@@ -1454,7 +1465,43 @@ bool ring_buffer_time_stamp_abs(struct ring_buffer *buffer)
 	return buffer->time_stamp_abs;
 }
 
+/* Index of the innermost context that holds the recursion lock */
+static __always_inline int rb_event_ctx(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	unsigned int val = cpu_buffer->current_context >> cpu_buffer->nest;
+
+	return val ? __ffs(val) + cpu_buffer->nest : -1;
+}
+
+/**
+ * ring_buffer_event_abs_time_stamp - return the absolute time of an event
+ * @buffer: The buffer the event was reserved on
+ * @event: The event, between its reserve and its commit
+ *
+ * With absolute time stamps set, an event only carries a TIME_STAMP
+ * when its delta does not fit in the event header. For the others, the
+ * time stamp taken when the event was reserved is returned instead, so
+ * this may only be called by the writer of @event before it commits.
+ */
+u64 ring_buffer_event_abs_time_stamp(struct ring_buffer *buffer,
+				     struct ring_buffer_event *event)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	int ctx;
+
+	if (event->type_len == RINGBUF_TYPE_TIME_STAMP)
+		return ring_buffer_event_time_stamp(event);
+
+	cpu_buffer = buffer->buffers[raw_smp_processor_id()];
+	ctx = rb_event_ctx(cpu_buffer);
+	if (unlikely(ctx < 0))
+		return rb_time_stamp(buffer);
+
+	return cpu_buffer->event_stamp[ctx];
+}
+
 static void rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer);
+static void rb_reset_meta_page(struct ring_buffer_per_cpu *cpu_buffer);
 
 static inline unsigned long rb_page_entries(struct buffer_page *bpage)
 {
@@ -1724,6 +1771,12 @@ int ring_buffer_resize(struct ring_buffer *buffer, unsigned long size,
 	/* prevent another thread from changing buffer sizes */
 	mutex_lock(&buffer->mutex);
 
+	/* A user space mapping may have come in, see ring_buffer_map() */
+	if (atomic_read(&buffer->resize_disabled)) {
+		err = -EBUSY;
+		goto out_err;
+	}
+
 	if (cpu_id == RING_BUFFER_ALL_CPUS) {
 		/* calculate the pages to update */
 		for_each_buffer_cpu(buffer, cpu) {
@@ -2800,7 +2853,8 @@ __rb_reserve_next(struct ring_buffer_per_cpu *cpu_buffer,
 	 * If this is the first commit on the page, then it has the same
 	 * timestamp as the page itself.
 	 */
-	if (!tail && !ring_buffer_time_stamp_abs(cpu_buffer->buffer))
+	if (!tail && !(info->add_timestamp &&
+		       ring_buffer_time_stamp_abs(cpu_buffer->buffer)))
 		info->delta = 0;
 
 	/* See if we shot pass the end of this buffer page */
@@ -2877,16 +2931,25 @@ rb_reserve_next_event(struct ring_buffer *buffer,
 	/* make sure this diff is calculated here */
 	barrier();
 
-	if (ring_buffer_time_stamp_abs(buffer)) {
-		info.delta = info.ts;
-		rb_handle_timestamp(cpu_buffer, &info);
-	} else /* Did the write stamp get updated already? */
-		if (likely(info.ts >= cpu_buffer->write_stamp)) {
+	/* Did the write stamp get updated already? */
+	if (likely(info.ts >= cpu_buffer->write_stamp)) {
 		info.delta = diff;
 		if (unlikely(test_time_stamp(info.delta)))
 			rb_handle_timestamp(cpu_buffer, &info);
 	}
 
+	/*
+	 * Absolute time stamps are only written when the delta does not
+	 * fit, like time extends. Readers track the time of the other
+	 * events from the deltas, and the writer gets it from
+	 * ring_buffer_event_abs_time_stamp().
+	 */
+	if (ring_buffer_time_stamp_abs(buffer)) {
+		cpu_buffer->event_stamp[rb_event_ctx(cpu_buffer)] = info.ts;
+		if (info.add_timestamp)
+			info.delta = info.ts;
+	}
+
 	event = __rb_reserve_next(cpu_buffer, &info);
 
 	if (unlikely(PTR_ERR(event) == -EAGAIN)) {
@@ -4376,6 +4439,9 @@ void ring_buffer_reset_cpu(struct ring_buffer *buffer, int cpu)
 
 	arch_spin_unlock(&cpu_buffer->lock);
 
+	if (cpu_buffer->mapped)
+		rb_reset_meta_page(cpu_buffer);
+
  out:
 	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
 
@@ -4495,6 +4561,11 @@ int ring_buffer_swap_cpu(struct ring_buffer *buffer_a,
 	if (atomic_read(&cpu_buffer_b->record_disabled))
 		goto out;
 
+	/* user space would keep reading the pages of the other buffer */
+	ret = -EBUSY;
+	if (cpu_buffer_a->mapped || cpu_buffer_b->mapped)
+		goto out;
+
 	/*
 	 * We can't do a synchronize_sched here because this
 	 * function can be called in atomic context.
@@ -4700,12 +4771,14 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 	/*
 	 * If this page has been partially read or
 	 * if len is not big enough to read the rest of the page or
-	 * a writer is still on the page, then
+	 * a writer is still on the page, or
+	 * the pages are mapped to user space, then
 	 * we must copy the data from the page to the buffer.
 	 * Otherwise, we can simply swap the page with the one passed in.
 	 */
 	if (read || (len < (commit - read)) ||
-	    cpu_buffer->reader_page == cpu_buffer->commit_page) {
+	    cpu_buffer->reader_page == cpu_buffer->commit_page ||
+	    cpu_buffer->mapped) {
 		struct buffer_data_page *rpage = cpu_buffer->reader_page->page;
 		unsigned int rpos = read;
 		unsigned int pos = 0;
@@ -4814,6 +4887,321 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+/*
+ * A per CPU buffer mapped to user space is read in place: the meta page
+ * comes first in the mapping, then every page of the buffer ordered by
+ * the id given to it at mapping time. The pages stay the same while
+ * mapped, the buffer can not be resized or swapped and
+ * ring_buffer_read_page() copies out instead of swapping pages.
+ */
+static void rb_update_meta_page(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+
+	meta->entries = local_read(&cpu_buffer->entries);
+	meta->overrun = local_read(&cpu_buffer->overrun);
+	meta->read = cpu_buffer->read;
+
+	/* Some archs do not have data cache coherency with user space */
+	flush_dcache_page(virt_to_page(meta));
+}
+
+static void rb_reset_meta_page(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+
+	meta->reader.lost_events = 0;
+	meta->reader.time_stamp = 0;
+	meta->reader.id = cpu_buffer->reader_page->id;
+	meta->reader.read = cpu_buffer->reader_page->read;
+	meta->reader.commit = cpu_buffer->reader_page->read;
+
+	rb_update_meta_page(cpu_buffer);
+}
+
+static int rb_setup_ids_meta_page(struct ring_buffer_per_cpu *cpu_buffer,
+				  unsigned long *subbuf_ids)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+	unsigned int nr_subbufs = cpu_buffer->nr_pages + 1;
+	struct buffer_page *first, *bpage;
+	unsigned int id = 0;
+
+	subbuf_ids[id] = (unsigned long)cpu_buffer->reader_page->page;
+	cpu_buffer->reader_page->id = id++;
+
+	first = bpage = rb_set_head_page(cpu_buffer);
+	if (!first)
+		return -ENODEV;
+	do {
+		if (RB_WARN_ON(cpu_buffer, id >= nr_subbufs))
+			return -ENODEV;
+		subbuf_ids[id] = (unsigned long)bpage->page;
+		bpage->id = id++;
+		rb_inc_page(cpu_buffer, &bpage);
+	} while (bpage != first);
+
+	cpu_buffer->subbuf_ids = subbuf_ids;
+
+	meta->meta_page_size = PAGE_SIZE;
+	meta->meta_struct_len = sizeof(*meta);
+	meta->subbuf_size = PAGE_SIZE;
+	meta->nr_subbufs = nr_subbufs;
+	rb_reset_meta_page(cpu_buffer);
+
+	return 0;
+}
+
+static int __rb_map_vma(struct ring_buffer_per_cpu *cpu_buffer,
+			struct vm_area_struct *vma)
+{
+	unsigned long nr_subbufs = cpu_buffer->nr_pages + 1;
+	unsigned long nr_pages = vma_pages(vma);
+	unsigned long pgoff = vma->vm_pgoff;
+	unsigned long i;
+	int err;
+
+	/* the pages are written by the kernel only */
+	if (vma->vm_flags & (VM_WRITE | VM_EXEC))
+		return -EPERM;
+	vma->vm_flags |= VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP;
+	vma->vm_flags &= ~(VM_MAYWRITE | VM_MAYEXEC);
+
+	/* the meta page, then the pages of the buffer */
+	if (!nr_pages || pgoff > nr_subbufs || nr_pages > nr_subbufs + 1 - pgoff)
+		return -EINVAL;
+
+	for (i = 0; i < nr_pages; i++, pgoff++) {
+		void *page;
+
+		if (pgoff)
+			page = (void *)cpu_buffer->subbuf_ids[pgoff - 1];
+		else
+			page = cpu_buffer->meta_page;
+
+		err = vm_insert_page(vma, vma->vm_start + i * PAGE_SIZE,
+				     virt_to_page(page));
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/**
+ * ring_buffer_map - map a per CPU buffer to user space
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the CPU buffer to map
+ * @vma: the area to map it in, from the mmap() file operation
+ *
+ * The first mapping of @cpu allocates its meta page, see
+ * struct trace_buffer_meta, and disables resizing @buffer. Further
+ * mappings share them. Each successful call must be paired with
+ * ring_buffer_unmap(), usually from the vm_operations close() callback.
+ *
+ * Returns 0 on success, or a negative error.
+ */
+int ring_buffer_map(struct ring_buffer *buffer, int cpu,
+		    struct vm_area_struct *vma)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long *subbuf_ids;
+	unsigned long flags;
+	void *meta;
+	int err;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+
+	if (cpu_buffer->mapped) {
+		err = __rb_map_vma(cpu_buffer, vma);
+		if (!err)
+			cpu_buffer->mapped++;
+		goto unlock;
+	}
+
+	meta = (void *)get_zeroed_page(GFP_KERNEL);
+	subbuf_ids = kcalloc(cpu_buffer->nr_pages + 1, sizeof(*subbuf_ids),
+			     GFP_KERNEL);
+	if (!meta || !subbuf_ids) {
+		err = -ENOMEM;
+		goto free;
+	}
+
+	/* Wait for a resize in progress, and keep new ones out */
+	mutex_lock(&buffer->mutex);
+	atomic_inc(&buffer->resize_disabled);
+	mutex_unlock(&buffer->mutex);
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->meta_page = meta;
+	err = rb_setup_ids_meta_page(cpu_buffer, subbuf_ids);
+	if (!err)
+		cpu_buffer->mapped = 1;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	if (!err)
+		err = __rb_map_vma(cpu_buffer, vma);
+	if (!err)
+		goto unlock;
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->mapped = 0;
+	cpu_buffer->subbuf_ids = NULL;
+	cpu_buffer->meta_page = NULL;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+	atomic_dec(&buffer->resize_disabled);
+ free:
+	kfree(subbuf_ids);
+	free_page((unsigned long)meta);
+ unlock:
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map);
+
+/**
+ * ring_buffer_map_dup - account a copy of a mapping of a per CPU buffer
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the mapped CPU buffer
+ *
+ * For the vm_operations open() callback, when an area set up by
+ * ring_buffer_map() is duplicated. Also paired with ring_buffer_unmap().
+ */
+int ring_buffer_map_dup(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+	if (cpu_buffer->mapped)
+		cpu_buffer->mapped++;
+	else
+		err = -ENODEV;
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_dup);
+
+/**
+ * ring_buffer_unmap - drop a user space mapping of a per CPU buffer
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the mapped CPU buffer
+ *
+ * The last one frees the meta page and allows resizing @buffer again.
+ */
+int ring_buffer_unmap(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long *subbuf_ids;
+	unsigned long flags;
+	void *meta;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+
+	if (!cpu_buffer->mapped) {
+		err = -ENODEV;
+		goto unlock;
+	}
+	if (--cpu_buffer->mapped)
+		goto unlock;
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	subbuf_ids = cpu_buffer->subbuf_ids;
+	meta = cpu_buffer->meta_page;
+	cpu_buffer->subbuf_ids = NULL;
+	cpu_buffer->meta_page = NULL;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	atomic_dec(&buffer->resize_disabled);
+
+	kfree(subbuf_ids);
+	free_page((unsigned long)meta);
+ unlock:
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_unmap);
+
+/**
+ * ring_buffer_map_get_reader - hand out the next events of a mapped buffer
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the mapped CPU buffer
+ *
+ * Consume the events committed to the reader page since the previous
+ * call, swapping a new reader page in first if that one was done. The
+ * reader fields of the meta page tell user space where they are.
+ *
+ * Returns 0 on success, or a negative error.
+ */
+int ring_buffer_map_get_reader(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta;
+	struct buffer_page *reader;
+	unsigned long flags;
+	unsigned int size;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	if (!cpu_buffer->mapped) {
+		err = -ENODEV;
+		goto out;
+	}
+	meta = cpu_buffer->meta_page;
+
+	reader = rb_get_reader_page(cpu_buffer);
+	if (reader) {
+		meta->reader.lost_events = cpu_buffer->lost_events;
+		cpu_buffer->lost_events = 0;
+		meta->reader.time_stamp = cpu_buffer->read_stamp;
+		meta->reader.read = reader->read;
+
+		size = rb_page_size(reader);
+		while (reader->read < size)
+			rb_advance_reader(cpu_buffer);
+	} else {
+		/* nothing new, hand out an empty range */
+		reader = cpu_buffer->reader_page;
+		meta->reader.lost_events = 0;
+		meta->reader.read = reader->read;
+	}
+	meta->reader.id = reader->id;
+	meta->reader.commit = reader->read;
+
+	flush_dcache_page(virt_to_page(reader->page));
+	rb_update_meta_page(cpu_buffer);
+ out:
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_get_reader);
+
 /*
  * We only allocate new buffers, never free them if the CPU goes down.
  * If we were to free the buffer, then the user would lose any trace that was in
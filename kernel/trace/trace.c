@@ -920,7 +920,10 @@ void tracing_snapshot_instance(struct trace_array *tr)
 	}
 
 	local_irq_save(flags);
-	update_max_tr(tr, current, smp_processor_id());
+	if (update_max_tr(tr, current, smp_processor_id()) == -EBUSY) {
+		internal_trace_puts("*** BUFFER IS MEMORY MAPPED ***\n");
+		internal_trace_puts("*** Can not use snapshot (sorry) ***\n");
+	}
 	local_irq_restore(flags);
 }
 
@@ -1357,23 +1360,32 @@ __update_max_tr(struct trace_array *tr, struct task_struct *tsk, int cpu)
  *
  * Flip the buffers between the @tr and the max_tr and record information
  * about which task was the cause of this latency.
+ *
+ * Returns -EBUSY if the buffer of @tr is memory mapped and cannot be
+ * swapped, 0 otherwise.
  */
-void
+int
 update_max_tr(struct trace_array *tr, struct task_struct *tsk, int cpu)
 {
 	if (tr->stop_count)
-		return;
+		return 0;
 
 	WARN_ON_ONCE(!irqs_disabled());
 
 	if (!tr->allocated_snapshot) {
 		/* Only the nop tracer should hit this when disabling */
 		WARN_ON_ONCE(tr->current_trace != &nop_trace);
-		return;
+		return 0;
 	}
 
 	arch_spin_lock(&tr->max_lock);
 
+	/* The mapped pages would end up in the max_buffer */
+	if (tr->mapped) {
+		arch_spin_unlock(&tr->max_lock);
+		return -EBUSY;
+	}
+
 	/* Inherit the recordable setting from trace_buffer */
 	if (ring_buffer_record_is_set_on(tr->trace_buffer.buffer))
 		ring_buffer_record_on(tr->max_buffer.buffer);
@@ -1384,6 +1396,8 @@ update_max_tr(struct trace_array *tr, struct task_struct *tsk, int cpu)
 
 	__update_max_tr(tr, tsk, cpu);
 	arch_spin_unlock(&tr->max_lock);
+
+	return 0;
 }
 
 /**
@@ -1393,24 +1407,33 @@ update_max_tr(struct trace_array *tr, struct task_struct *tsk, int cpu)
  * @cpu - the cpu of the buffer to copy.
  *
  * Flip the trace of a single CPU buffer between the @tr and the max_tr.
+ *
+ * Returns -EBUSY if the buffer of @tr is memory mapped and cannot be
+ * swapped, 0 otherwise.
  */
-void
+int
 update_max_tr_single(struct trace_array *tr, struct task_struct *tsk, int cpu)
 {
 	int ret;
 
 	if (tr->stop_count)
-		return;
+		return 0;
 
 	WARN_ON_ONCE(!irqs_disabled());
 	if (!tr->allocated_snapshot) {
 		/* Only the nop tracer should hit this when disabling */
 		WARN_ON_ONCE(tr->current_trace != &nop_trace);
-		return;
+		return 0;
 	}
 
 	arch_spin_lock(&tr->max_lock);
 
+	/* The mapped pages would end up in the max_buffer */
+	if (tr->mapped) {
+		arch_spin_unlock(&tr->max_lock);
+		return -EBUSY;
+	}
+
 	ret = ring_buffer_swap_cpu(tr->max_buffer.buffer, tr->trace_buffer.buffer, cpu);
 
 	if (ret == -EBUSY) {
@@ -1428,6 +1451,8 @@ update_max_tr_single(struct trace_array *tr, struct task_struct *tsk, int cpu)
 
 	__update_max_tr(tr, tsk, cpu);
 	arch_spin_unlock(&tr->max_lock);
+
+	return 0;
 }
 #endif /* CONFIG_TRACER_MAX_TRACE */
 
@@ -4588,6 +4613,8 @@ static const char readme_msg[] =
 	"  set_graph_function\t- Trace the nested calls of a function (function_graph)\n"
 	"  set_graph_notrace\t- Do not trace the nested calls of a function (function_graph)\n"
 	"  max_graph_depth\t- Trace a limited depth of nested calls (0 is unlimited)\n"
+	"  graph_sample_rate\t- Only trace every Nth top level call tree (function_graph)\n"
+	"\t\t\t  Combine with tracing_thresh to drop the short calls\n"
 #endif
 #ifdef CONFIG_TRACER_SNAPSHOT
 	"\n  snapshot\t\t- Like 'trace' but shows the content of the static\n"
@@ -4684,7 +4711,7 @@ static const char readme_msg[] =
 	"\t            [:values=<field1[,field2,...]>]\n"
 	"\t            [:sort=<field1[,field2,...]>]\n"
 	"\t            [:size=#entries]\n"
-	"\t            [:pause][:continue][:clear]\n"
+	"\t            [:pause][:continue][:clear][:percpu]\n"
 	"\t            [:name=histname1]\n"
 	"\t            [if <filter>]\n\n"
 	"\t    When a matching event is hit, an entry is added to a hash\n"
@@ -4701,7 +4728,10 @@ static const char readme_msg[] =
 	"\t    or fewer than the default 2048 entries for the hashtable size.\n"
 	"\t    If a hist trigger is given a name using the 'name' parameter,\n"
 	"\t    its histogram data will be shared with other triggers of the\n"
-	"\t    same name, and trigger hits will update this common data.\n\n"
+	"\t    same name, and trigger hits will update this common data.\n"
+	"\t    The 'percpu' parameter keeps the values summed per CPU and adds\n"
+	"\t    them up on read, which scales to high event rates from many\n"
+	"\t    CPUs at the cost of one copy of the values per CPU.\n\n"
 	"\t    Reading the 'hist' file for the event will dump the hash\n"
 	"\t    table in its entirety to stdout.  If there are multiple hist\n"
 	"\t    triggers attached to an event, there will be a table for each\n"
@@ -4716,6 +4746,7 @@ static const char readme_msg[] =
 	"\t            .execname   display a common_pid as a program name\n"
 	"\t            .syscall    display a syscall id as a syscall name\n"
 	"\t            .log2       display log2 value rather than raw number\n"
+	"\t            .buckets=size  display values in groups of size rather than raw number\n"
 	"\t            .usecs      display a common_timestamp in microseconds\n\n"
 	"\t    The 'pause' parameter can be used to pause an existing hist\n"
 	"\t    trigger or to start a hist trigger but not log any events\n"
@@ -6479,9 +6510,9 @@ tracing_snapshot_write(struct file *filp, const char __user *ubuf, size_t cnt,
 		local_irq_disable();
 		/* Now, we're going to swap */
 		if (iter->cpu_file == RING_BUFFER_ALL_CPUS)
-			update_max_tr(tr, current, smp_processor_id());
+			ret = update_max_tr(tr, current, smp_processor_id());
 		else
-			update_max_tr_single(tr, current, iter->cpu_file);
+			ret = update_max_tr_single(tr, current, iter->cpu_file);
 		local_irq_enable();
 		break;
 	default:
@@ -6962,12 +6993,102 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 	return ret;
 }
 
+static long tracing_buffers_ioctl(struct file *file, unsigned int cmd,
+				  unsigned long arg)
+{
+	struct ftrace_buffer_info *info = file->private_data;
+	struct trace_iterator *iter = &info->iter;
+	int ret;
+
+	if (cmd != TRACE_MMAP_IOCTL_GET_READER)
+		return -ENOTTY;
+
+	if (trace_empty(iter) && !(file->f_flags & O_NONBLOCK)) {
+		ret = wait_on_pipe(iter, false);
+		if (ret)
+			return ret;
+	}
+
+	trace_access_lock(iter->cpu_file);
+	ret = ring_buffer_map_get_reader(iter->trace_buffer->buffer,
+					 iter->cpu_file);
+	trace_access_unlock(iter->cpu_file);
+
+	return ret;
+}
+
+#ifdef CONFIG_TRACER_MAX_TRACE
+static void tracing_buffers_mapped_add(struct trace_array *tr, int val)
+{
+	local_irq_disable();
+	arch_spin_lock(&tr->max_lock);
+	tr->mapped += val;
+	arch_spin_unlock(&tr->max_lock);
+	local_irq_enable();
+}
+#else
+static inline void tracing_buffers_mapped_add(struct trace_array *tr, int val)
+{
+}
+#endif
+
+static void tracing_buffers_mmap_open(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	WARN_ON(ring_buffer_map_dup(iter->trace_buffer->buffer,
+				    iter->cpu_file));
+	tracing_buffers_mapped_add(iter->tr, 1);
+}
+
+static void tracing_buffers_mmap_close(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	WARN_ON(ring_buffer_unmap(iter->trace_buffer->buffer, iter->cpu_file));
+	tracing_buffers_mapped_add(iter->tr, -1);
+}
+
+static const struct vm_operations_struct tracing_buffers_vmops = {
+	.open		= tracing_buffers_mmap_open,
+	.close		= tracing_buffers_mmap_close,
+};
+
+/*
+ * Map the meta page and the pages of the CPU buffer, for user space to
+ * read the events in place. See struct trace_buffer_meta.
+ */
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	struct trace_iterator *iter = &info->iter;
+	int ret;
+
+	/* Keep snapshots from swapping the buffer away first */
+	tracing_buffers_mapped_add(iter->tr, 1);
+
+	ret = ring_buffer_map(iter->trace_buffer->buffer, iter->cpu_file, vma);
+	if (ret) {
+		tracing_buffers_mapped_add(iter->tr, -1);
+		return ret;
+	}
+
+	vma->vm_ops = &tracing_buffers_vmops;
+
+	return 0;
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
 	.poll		= tracing_buffers_poll,
 	.release	= tracing_buffers_release,
 	.splice_read	= tracing_buffers_splice_read,
+	.unlocked_ioctl	= tracing_buffers_ioctl,
+	.compat_ioctl	= tracing_buffers_ioctl,
+	.mmap		= tracing_buffers_mmap,
 	.llseek		= no_llseek,
 };
 
@@ -217,6 +217,12 @@ struct trace_array {
 	 */
 	struct trace_buffer	max_buffer;
 	bool			allocated_snapshot;
+	/*
+	 * Mappings of trace_pipe_raw files, which keep reading the pages
+	 * of trace_buffer in place. Swapping with the max_buffer is not
+	 * possible while there are any. Protected by max_lock.
+	 */
+	unsigned int		mapped;
 #endif
 #if defined(CONFIG_TRACER_MAX_TRACE) || defined(CONFIG_HWLAT_TRACER)
 	unsigned long		max_latency;
@@ -719,9 +725,9 @@ int trace_pid_write(struct trace_pid_list *filtered_pids,
 		    const char __user *ubuf, size_t cnt);
 
 #ifdef CONFIG_TRACER_MAX_TRACE
-void update_max_tr(struct trace_array *tr, struct task_struct *tsk, int cpu);
-void update_max_tr_single(struct trace_array *tr,
-			  struct task_struct *tsk, int cpu);
+int update_max_tr(struct trace_array *tr, struct task_struct *tsk, int cpu);
+int update_max_tr_single(struct trace_array *tr,
+			 struct task_struct *tsk, int cpu);
 #endif /* CONFIG_TRACER_MAX_TRACE */
 
 #ifdef CONFIG_STACKTRACE
@@ -68,6 +68,10 @@ struct fgraph_data {
 
 unsigned int fgraph_max_depth;
 
+/* Only trace one in fgraph_sample_rate top level calls (0 or 1 is all) */
+static unsigned int fgraph_sample_rate;
+static DEFINE_PER_CPU(unsigned int, fgraph_sample_count);
+
 static struct tracer_opt trace_opts[] = {
 	/* Display overruns? (for self-debug purpose) */
 	{ TRACER_OPT(funcgraph-overrun, TRACE_GRAPH_PRINT_OVERRUN) },
@@ -399,6 +403,16 @@ static inline int ftrace_graph_ignore_irqs(void)
 	return in_irq();
 }
 
+static inline bool trace_graph_sampled(void)
+{
+	unsigned int rate = READ_ONCE(fgraph_sample_rate);
+
+	if (rate <= 1)
+		return true;
+
+	return !(this_cpu_inc_return(fgraph_sample_count) % rate);
+}
+
 int trace_graph_entry(struct ftrace_graph_ent *trace)
 {
 	struct trace_array *tr = graph_array;
@@ -428,6 +442,16 @@ int trace_graph_entry(struct ftrace_graph_ent *trace)
 	if (ftrace_graph_notrace_addr(trace->func))
 		return 1;
 
+	/*
+	 * When sampling, skip the whole call tree below a top level call
+	 * that is not sampled, the same way set_graph_notrace does. The
+	 * nested functions then do not even get their return hooked.
+	 */
+	if (!trace->depth && !trace_graph_sampled()) {
+		current->curr_ret_stack -= FTRACE_NOTRACE_DEPTH;
+		return 1;
+	}
+
 	/*
 	 * Stop here if tracing_threshold is set. We only write function return
 	 * events to the ring buffer.
@@ -511,6 +535,10 @@ void trace_graph_return(struct ftrace_graph_ret *trace)
 
 	ftrace_graph_addr_finish(trace);
 
+	/* returning from a notrace'd or not sampled call */
+	if (current->curr_ret_stack < 0)
+		return;
+
 	local_irq_save(flags);
 	cpu = raw_smp_processor_id();
 	data = per_cpu_ptr(tr->trace_buffer.data, cpu);
@@ -1561,6 +1589,43 @@ static const struct file_operations graph_depth_fops = {
 	.llseek		= generic_file_llseek,
 };
 
+static ssize_t
+graph_sample_write(struct file *filp, const char __user *ubuf, size_t cnt,
+		   loff_t *ppos)
+{
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint_from_user(ubuf, cnt, 10, &val);
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(fgraph_sample_rate, val);
+
+	*ppos += cnt;
+
+	return cnt;
+}
+
+static ssize_t
+graph_sample_read(struct file *filp, char __user *ubuf, size_t cnt,
+		  loff_t *ppos)
+{
+	char buf[15]; /* More than enough to hold UINT_MAX + "\n"*/
+	int n;
+
+	n = sprintf(buf, "%u\n", fgraph_sample_rate);
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, n);
+}
+
+static const struct file_operations graph_sample_fops = {
+	.open		= tracing_open_generic,
+	.write		= graph_sample_write,
+	.read		= graph_sample_read,
+	.llseek		= generic_file_llseek,
+};
+
 static __init int init_graph_tracefs(void)
 {
 	struct dentry *d_tracer;
@@ -1571,6 +1636,8 @@ static __init int init_graph_tracefs(void)
 
 	trace_create_file("max_graph_depth", 0644, d_tracer,
 			  NULL, &graph_depth_fops);
+	trace_create_file("graph_sample_rate", 0644, d_tracer,
+			  NULL, &graph_sample_fops);
 
 	return 0;
 }
@@ -12,10 +12,13 @@
  */
 
 #include <linux/vmalloc.h>
+#include <linux/percpu.h>
 #include <linux/jhash.h>
 #include <linux/slab.h>
 #include <linux/sort.h>
 
+#include <asm/local64.h>
+
 #include "tracing_map.h"
 #include "trace.h"
 
@@ -34,10 +37,16 @@
  * Add n to sum i associated with the specified tracing_map_elt
  * instance.  The index i is the index returned by the call to
  * tracing_map_add_sum_field() when the tracing map was set up.
+ *
+ * For a map set up with tracing_map_set_percpu(), this must be called
+ * with preemption disabled, as it is from a trace event.
  */
 void tracing_map_update_sum(struct tracing_map_elt *elt, unsigned int i, u64 n)
 {
-	atomic64_add(n, &elt->fields[i].sum);
+	if (elt->sums)
+		local64_add(n, this_cpu_ptr(elt->sums) + i);
+	else
+		atomic64_add(n, &elt->fields[i].sum);
 }
 
 /**
@@ -54,7 +63,16 @@ void tracing_map_update_sum(struct tracing_map_elt *elt, unsigned int i, u64 n)
  */
 u64 tracing_map_read_sum(struct tracing_map_elt *elt, unsigned int i)
 {
-	return (u64)atomic64_read(&elt->fields[i].sum);
+	u64 sum = 0;
+	int cpu;
+
+	if (!elt->sums)
+		return (u64)atomic64_read(&elt->fields[i].sum);
+
+	for_each_possible_cpu(cpu)
+		sum += local64_read(per_cpu_ptr(elt->sums, cpu) + i);
+
+	return sum;
 }
 
 /**
@@ -228,6 +246,39 @@ int tracing_map_add_sum_field(struct tracing_map *map)
 	return tracing_map_add_field(map, tracing_map_cmp_atomic64);
 }
 
+/**
+ * tracing_map_set_percpu - Keep the sums of a tracing_map per CPU
+ * @map: The tracing_map
+ *
+ * Have each tracing_map_elt keep its sums per CPU, so that events
+ * hitting the same key on different CPUs don't write the same cache
+ * lines.  tracing_map_read_sum() returns the total over all CPUs.  This
+ * costs one copy of the sums per possible CPU in every element, and
+ * must be called before tracing_map_init().
+ */
+void tracing_map_set_percpu(struct tracing_map *map)
+{
+	map->percpu = true;
+}
+
+/**
+ * tracing_map_read_hits - Return the number of hits of a tracing_map
+ * @map: The tracing_map
+ *
+ * Return: The number of successful insertions and retrievals done by
+ * tracing_map_insert(), over all CPUs.
+ */
+u64 tracing_map_read_hits(struct tracing_map *map)
+{
+	u64 hits = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		hits += local64_read(per_cpu_ptr(map->hits, cpu));
+
+	return hits;
+}
+
 /**
  * tracing_map_add_var - Add a field describing a tracing_map var
  * @map: The tracing_map
@@ -355,11 +406,18 @@ struct tracing_map_array *tracing_map_array_alloc(unsigned int n_elts,
 static void tracing_map_elt_clear(struct tracing_map_elt *elt)
 {
 	unsigned i;
+	int cpu;
 
 	for (i = 0; i < elt->map->n_fields; i++)
 		if (elt->fields[i].cmp_fn == tracing_map_cmp_atomic64)
 			atomic64_set(&elt->fields[i].sum, 0);
 
+	if (elt->sums) {
+		for_each_possible_cpu(cpu)
+			for (i = 0; i < elt->map->n_fields; i++)
+				local64_set(per_cpu_ptr(elt->sums, cpu) + i, 0);
+	}
+
 	for (i = 0; i < elt->map->n_vars; i++) {
 		atomic64_set(&elt->vars[i], 0);
 		elt->var_set[i] = false;
@@ -391,6 +449,7 @@ static void tracing_map_elt_free(struct tracing_map_elt *elt)
 	if (elt->map->ops && elt->map->ops->elt_free)
 		elt->map->ops->elt_free(elt);
 	kfree(elt->fields);
+	free_percpu(elt->sums);
 	kfree(elt->vars);
 	kfree(elt->var_set);
 	kfree(elt->key);
@@ -420,6 +479,15 @@ static struct tracing_map_elt *tracing_map_elt_alloc(struct tracing_map *map)
 		goto free;
 	}
 
+	if (map->percpu) {
+		elt->sums = __alloc_percpu(map->n_fields * sizeof(*elt->sums),
+					   __alignof__(*elt->sums));
+		if (!elt->sums) {
+			err = -ENOMEM;
+			goto free;
+		}
+	}
+
 	elt->vars = kcalloc(map->n_vars, sizeof(*elt->vars), GFP_KERNEL);
 	if (!elt->vars) {
 		err = -ENOMEM;
@@ -532,7 +600,7 @@ __tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
 			if (val &&
 			    keys_match(key, val->key, map->key_size)) {
 				if (!lookup_only)
-					atomic64_inc(&map->hits);
+					local64_inc(this_cpu_ptr(map->hits));
 				return val;
 			} else if (unlikely(!val)) {
 				/*
@@ -572,7 +640,7 @@ __tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
 
 				memcpy(elt->key, key, map->key_size);
 				entry->val = elt;
-				atomic64_inc(&map->hits);
+				local64_inc(this_cpu_ptr(map->hits));
 
 				return entry->val;
 			} else {
@@ -673,6 +741,7 @@ void tracing_map_destroy(struct tracing_map *map)
 	tracing_map_free_elts(map);
 
 	tracing_map_array_free(map->map);
+	free_percpu(map->hits);
 	kfree(map);
 }
 
@@ -690,9 +759,11 @@ void tracing_map_destroy(struct tracing_map *map)
 void tracing_map_clear(struct tracing_map *map)
 {
 	unsigned int i;
+	int cpu;
 
 	atomic_set(&map->next_elt, -1);
-	atomic64_set(&map->hits, 0);
+	for_each_possible_cpu(cpu)
+		local64_set(per_cpu_ptr(map->hits, cpu), 0);
 	atomic64_set(&map->drops, 0);
 
 	tracing_map_array_clear(map->map);
@@ -782,6 +853,10 @@ struct tracing_map *tracing_map_create(unsigned int map_bits,
 
 	map->private_data = private_data;
 
+	map->hits = alloc_percpu(local64_t);
+	if (!map->hits)
+		goto free;
+
 	map->map = tracing_map_array_alloc(map->map_size,
 					   sizeof(struct tracing_map_entry));
 	if (!map->map)
@@ -834,6 +909,23 @@ int tracing_map_init(struct tracing_map *map)
 	return err;
 }
 
+/*
+ * The sort functions compare the sums stored in the fields, bring them
+ * up to date for a map with per CPU sums.
+ */
+static void tracing_map_elt_fold_sums(struct tracing_map_elt *elt)
+{
+	unsigned int i;
+
+	if (!elt->sums)
+		return;
+
+	for (i = 0; i < elt->map->n_fields; i++)
+		if (elt->fields[i].cmp_fn == tracing_map_cmp_atomic64)
+			atomic64_set(&elt->fields[i].sum,
+				     tracing_map_read_sum(elt, i));
+}
+
 static int cmp_entries_dup(const struct tracing_map_sort_entry **a,
 			   const struct tracing_map_sort_entry **b)
 {
@@ -1078,6 +1170,8 @@ int tracing_map_sort_entries(struct tracing_map *map,
 		if (!entry->key || !entry->val)
 			continue;
 
+		tracing_map_elt_fold_sums(entry->val);
+
 		entries[n_entries] = create_sort_entry(entry->val->key,
 						       entry->val);
 		if (!entries[n_entries++]) {
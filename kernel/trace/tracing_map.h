@@ -78,6 +78,13 @@ typedef int (*tracing_map_cmp_fn_t) (void *val_a, void *val_b);
  * The tracing_map_entry array is allocated as a single block by
  * tracing_map_create().
  *
+ * Once a key is in the map, an event only reads the tracing_map_entry
+ * array, but it still writes the sums of its tracing_map_elt.  With
+ * many CPUs hitting the same keys, those cache lines bounce between
+ * them.  A map set up with tracing_map_set_percpu() keeps one copy of
+ * the sums per CPU instead, and tracing_map_read_sum() adds them up.
+ * The map-wide 'hits' counter is always per CPU.
+ *
  * Because the tracing_map_elts are much larger objects and can't
  * generally be allocated together as a single large array without
  * failure, they're allocated individually, by tracing_map_init().
@@ -138,6 +145,7 @@ struct tracing_map_field {
 struct tracing_map_elt {
 	struct tracing_map		*map;
 	struct tracing_map_field	*fields;
+	local64_t __percpu		*sums;
 	atomic64_t			*vars;
 	bool				*var_set;
 	void				*key;
@@ -196,7 +204,8 @@ struct tracing_map {
 	unsigned int			n_keys;
 	struct tracing_map_sort_key	sort_key;
 	unsigned int			n_vars;
-	atomic64_t			hits;
+	bool				percpu;
+	local64_t __percpu		*hits;
 	atomic64_t			drops;
 };
 
@@ -244,6 +253,7 @@ tracing_map_create(unsigned int map_bits,
 		   void *private_data);
 extern int tracing_map_init(struct tracing_map *map);
 
+extern void tracing_map_set_percpu(struct tracing_map *map);
 extern int tracing_map_add_sum_field(struct tracing_map *map);
 extern int tracing_map_add_var(struct tracing_map *map);
 extern int tracing_map_add_key_field(struct tracing_map *map,
@@ -271,6 +281,7 @@ extern bool tracing_map_var_set(struct tracing_map_elt *elt, unsigned int i);
 extern u64 tracing_map_read_sum(struct tracing_map_elt *elt, unsigned int i);
 extern u64 tracing_map_read_var(struct tracing_map_elt *elt, unsigned int i);
 extern u64 tracing_map_read_var_once(struct tracing_map_elt *elt, unsigned int i);
+extern u64 tracing_map_read_hits(struct tracing_map *map);
 
 extern void tracing_map_set_field_descr(struct tracing_map *map,
 					unsigned int i,
@@ -288,6 +288,10 @@ module_param_named(disable_numa, wq_disable_numa, bool, 0444);
 static bool wq_power_efficient = IS_ENABLED(CONFIG_WQ_POWER_EFFICIENT_DEFAULT);
 module_param_named(power_efficient, wq_power_efficient, bool, 0444);
 
+/* see the comment above the definition of WQ_AFFN_CACHE */
+static bool wq_affn_numa;
+module_param_named(affinity_numa, wq_affn_numa, bool, 0644);
+
 static bool wq_online;			/* can kworkers be created yet? */
 
 static bool wq_numa_enabled;		/* unbound NUMA affinity enabled */
@@ -1360,6 +1364,43 @@ static int wq_select_unbound_cpu(int cpu)
 	return new_cpu;
 }
 
+static bool wq_cpu_pool_busy(struct workqueue_struct *wq, int cpu)
+{
+	struct worker_pool *pool = per_cpu_ptr(wq->cpu_pwqs, cpu)->pool;
+
+	return atomic_read(&pool->nr_running) ||
+		!list_empty(&pool->worklist);
+}
+
+/*
+ * For WQ_AFFN_CACHE workqueues, move work queued from a busy CPU to an
+ * idle one in the same cache domain.  Workers of nearby CPUs are tried
+ * in turn starting after @cpu so that a burst is spread out.  The checks
+ * are racy, the worst outcome is that the work item runs on a CPU which
+ * became busy meanwhile.
+ */
+static int wq_select_affn_cpu(struct workqueue_struct *wq, int cpu)
+{
+	const struct cpumask *scope = cpumask_of_node(cpu_to_node(cpu));
+	int new_cpu;
+
+	if (!in_serving_softirq() && !wq_cpu_pool_busy(wq, cpu))
+		return cpu;
+
+	for_each_cpu_wrap(new_cpu, scope, cpu) {
+		if (new_cpu == cpu)
+			continue;
+		if (!wq_affn_numa && !cpus_share_cache(cpu, new_cpu))
+			continue;
+		if (!cpu_online(new_cpu) ||
+		    !cpumask_test_cpu(new_cpu, wq_unbound_cpumask))
+			continue;
+		if (idle_cpu(new_cpu) && !wq_cpu_pool_busy(wq, new_cpu))
+			return new_cpu;
+	}
+	return cpu;
+}
+
 static void __queue_work(int cpu, struct workqueue_struct *wq,
 			 struct work_struct *work)
 {
@@ -1384,8 +1425,11 @@ static void __queue_work(int cpu, struct workqueue_struct *wq,
 	    WARN_ON_ONCE(!is_chained_work(wq)))
 		return;
 retry:
-	if (req_cpu == WORK_CPU_UNBOUND)
+	if (req_cpu == WORK_CPU_UNBOUND) {
 		cpu = wq_select_unbound_cpu(raw_smp_processor_id());
+		if (wq->flags & WQ_AFFN_CACHE)
+			cpu = wq_select_affn_cpu(wq, cpu);
+	}
 
 	/* pwq which will be used unless @work is executing elsewhere */
 	if (!(wq->flags & WQ_UNBOUND))
@@ -4069,6 +4113,10 @@ struct workqueue_struct *__alloc_workqueue_key(const char *fmt,
 	if ((flags & WQ_POWER_EFFICIENT) && wq_power_efficient)
 		flags |= WQ_UNBOUND;
 
+	/* unbound pools already pick their CPU per node */
+	if (flags & (WQ_UNBOUND | __WQ_ORDERED))
+		flags &= ~WQ_AFFN_CACHE;
+
 	/* allocate wq and format name */
 	if (flags & WQ_UNBOUND)
 		tbl_size = nr_node_ids * sizeof(wq->numa_pwq_tbl[0]);
@@ -142,6 +142,26 @@ static int copyout(void __user *to, const void *from, size_t n)
 	return n;
 }
 
+size_t iov_iter_nocache_threshold __read_mostly = SIZE_MAX;
+
+/*
+ * A read that does not fit in the cache would only push the hot data
+ * out of it, have it bypass the cache on the way to user space.  The
+ * tail of the read is copied as usual, it is the data the reader will
+ * look at first.
+ */
+static int copyout_stream(void __user *to, const void *from, size_t n,
+			  bool nocache)
+{
+	if (!nocache)
+		return copyout(to, from, n);
+
+	/* __copy_to_user_inatomic_nocache() does the kasan check */
+	if (access_ok(VERIFY_WRITE, to, n))
+		n = __copy_to_user_inatomic_nocache(to, from, n);
+	return n;
+}
+
 static int copyin(void *to, const void __user *from, size_t n)
 {
 	if (access_ok(VERIFY_READ, from, n)) {
@@ -154,6 +174,7 @@ static int copyin(void *to, const void __user *from, size_t n)
 static size_t copy_page_to_iter_iovec(struct page *page, size_t offset, size_t bytes,
 			 struct iov_iter *i)
 {
+	bool nocache = i->count >= iov_iter_nocache_threshold;
 	size_t skip, copy, left, wanted;
 	const struct iovec *iov;
 	char __user *buf;
@@ -177,7 +198,7 @@ static size_t copy_page_to_iter_iovec(struct page *page, size_t offset, size_t b
 		from = kaddr + offset;
 
 		/* first chunk, usually the only one */
-		left = copyout(buf, from, copy);
+		left = copyout_stream(buf, from, copy, nocache);
 		copy -= left;
 		skip += copy;
 		from += copy;
@@ -187,7 +208,7 @@ static size_t copy_page_to_iter_iovec(struct page *page, size_t offset, size_t b
 			iov++;
 			buf = iov->iov_base;
 			copy = min(bytes, iov->iov_len);
-			left = copyout(buf, from, copy);
+			left = copyout_stream(buf, from, copy, nocache);
 			copy -= left;
 			skip = copy;
 			from += copy;
@@ -206,7 +227,7 @@ static size_t copy_page_to_iter_iovec(struct page *page, size_t offset, size_t b
 
 	kaddr = kmap(page);
 	from = kaddr + offset;
-	left = copyout(buf, from, copy);
+	left = copyout_stream(buf, from, copy, nocache);
 	copy -= left;
 	skip += copy;
 	from += copy;
@@ -215,7 +236,7 @@ static size_t copy_page_to_iter_iovec(struct page *page, size_t offset, size_t b
 		iov++;
 		buf = iov->iov_base;
 		copy = min(bytes, iov->iov_len);
-		left = copyout(buf, from, copy);
+		left = copyout_stream(buf, from, copy, nocache);
 		copy -= left;
 		skip = copy;
 		from += copy;
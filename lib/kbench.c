@@ -0,0 +1,307 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * kbench: a common harness for in-kernel microbenchmarks.
+ *
+ * Cases register a struct kbench_case and show up as a file in debugfs
+ * kbench/.  Reading the file runs the case, pinned to the CPU given by the
+ * "cpu" parameter, and returns one line of key=value pairs:
+ *
+ *   name=spin_lock cpu=2 iterations=1000 samples=100 min=... mean=...
+ *   p50=... p90=... p99=... max=...
+ *
+ * All times are nanoseconds per operation, with three decimals.  The run
+ * parameters live in /sys/module/kbench/parameters.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/debugfs.h>
+#include <linux/gfp.h>
+#include <linux/init.h>
+#include <linux/jhash.h>
+#include <linux/kbench.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+#define KBENCH_MAX_SAMPLES	100000U
+
+static unsigned int iterations = 1000;
+module_param(iterations, uint, 0644);
+MODULE_PARM_DESC(iterations, "Operations per sample");
+
+static unsigned int samples = 100;
+module_param(samples, uint, 0644);
+MODULE_PARM_DESC(samples, "Timed samples per run");
+
+static unsigned int warmup = 10;
+module_param(warmup, uint, 0644);
+MODULE_PARM_DESC(warmup, "Untimed samples before the timed ones");
+
+static int cpu = -1;
+module_param(cpu, int, 0644);
+MODULE_PARM_DESC(cpu, "CPU to run on, -1 for the reading task's");
+
+static DEFINE_MUTEX(kbench_mutex);
+static LIST_HEAD(kbench_cases);
+static struct dentry *kbench_dir;
+
+struct kbench_run {
+	struct kbench_case *kc;
+	unsigned long iters;
+	unsigned int nr_warmup, nr_samples;
+	u64 *ps;		/* picoseconds per operation, per sample */
+	int cpu;
+};
+
+static long kbench_run_fn(void *arg)
+{
+	struct kbench_run *r = arg;
+	struct kbench_case *kc = r->kc;
+	unsigned int i;
+	int ret = 0;
+
+	r->cpu = raw_smp_processor_id();
+
+	if (kc->setup) {
+		ret = kc->setup(kc);
+		if (ret)
+			return ret;
+	}
+
+	for (i = 0; i < r->nr_warmup + r->nr_samples; i++) {
+		u64 start, delta;
+
+		start = ktime_get_ns();
+		kc->run(kc, r->iters);
+		delta = ktime_get_ns() - start;
+
+		if (i >= r->nr_warmup)
+			r->ps[i - r->nr_warmup] = div64_ul(delta * 1000,
+							   r->iters);
+		cond_resched();
+	}
+
+	if (kc->teardown)
+		kc->teardown(kc);
+	return 0;
+}
+
+static int kbench_cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void kbench_show_ps(struct seq_file *m, const char *key, u64 ps)
+{
+	u32 rem;
+	u64 ns = div_u64_rem(ps, 1000, &rem);
+
+	seq_printf(m, " %s=%llu.%03u", key, ns, rem);
+}
+
+static u64 kbench_percentile(struct kbench_run *r, unsigned int pct)
+{
+	return r->ps[(r->nr_samples - 1) * pct / 100];
+}
+
+static int kbench_show(struct seq_file *m, void *v)
+{
+	struct kbench_run r = { .kc = m->private };
+	int target = READ_ONCE(cpu);
+	u64 sum = 0;
+	unsigned int i;
+	long ret;
+
+	r.iters = max(READ_ONCE(iterations), 1U);
+	r.nr_warmup = READ_ONCE(warmup);
+	r.nr_samples = clamp(READ_ONCE(samples), 1U, KBENCH_MAX_SAMPLES);
+
+	r.ps = kvmalloc_array(r.nr_samples, sizeof(*r.ps), GFP_KERNEL);
+	if (!r.ps)
+		return -ENOMEM;
+
+	mutex_lock(&kbench_mutex);
+	if (target < 0) {
+		ret = kbench_run_fn(&r);
+	} else if (target >= nr_cpu_ids || !cpu_online(target)) {
+		ret = -EINVAL;
+	} else {
+		ret = work_on_cpu(target, kbench_run_fn, &r);
+	}
+	mutex_unlock(&kbench_mutex);
+	if (ret)
+		goto out;
+
+	sort(r.ps, r.nr_samples, sizeof(*r.ps), kbench_cmp_u64, NULL);
+	for (i = 0; i < r.nr_samples; i++)
+		sum += r.ps[i];
+
+	seq_printf(m, "name=%s cpu=%d iterations=%lu samples=%u",
+		   r.kc->name, r.cpu, r.iters, r.nr_samples);
+	kbench_show_ps(m, "min", r.ps[0]);
+	kbench_show_ps(m, "mean", div_u64(sum, r.nr_samples));
+	kbench_show_ps(m, "p50", kbench_percentile(&r, 50));
+	kbench_show_ps(m, "p90", kbench_percentile(&r, 90));
+	kbench_show_ps(m, "p99", kbench_percentile(&r, 99));
+	kbench_show_ps(m, "max", r.ps[r.nr_samples - 1]);
+	seq_putc(m, '\n');
+out:
+	kvfree(r.ps);
+	return ret;
+}
+
+static int kbench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, kbench_show, inode->i_private);
+}
+
+static const struct file_operations kbench_fops = {
+	.owner		= THIS_MODULE,
+	.open		= kbench_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void kbench_create_file(struct kbench_case *kc)
+{
+	kc->dentry = debugfs_create_file(kc->name, 0400, kbench_dir, kc,
+					 &kbench_fops);
+}
+
+/**
+ * kbench_register - make a benchmark case available in debugfs
+ * @kc: the case, which has to stay around until kbench_unregister()
+ *
+ * May be called before the harness is initialized, the file is created
+ * once it is.
+ */
+int kbench_register(struct kbench_case *kc)
+{
+	struct kbench_case *iter;
+	int ret = 0;
+
+	if (!kc->name || !kc->run)
+		return -EINVAL;
+
+	mutex_lock(&kbench_mutex);
+	list_for_each_entry(iter, &kbench_cases, list) {
+		if (!strcmp(iter->name, kc->name)) {
+			ret = -EEXIST;
+			goto out;
+		}
+	}
+	list_add_tail(&kc->list, &kbench_cases);
+	if (kbench_dir)
+		kbench_create_file(kc);
+out:
+	mutex_unlock(&kbench_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(kbench_register);
+
+void kbench_unregister(struct kbench_case *kc)
+{
+	/* waits for readers, which take kbench_mutex: do it first */
+	debugfs_remove(kc->dentry);
+
+	mutex_lock(&kbench_mutex);
+	list_del(&kc->list);
+	mutex_unlock(&kbench_mutex);
+}
+EXPORT_SYMBOL_GPL(kbench_unregister);
+
+/*
+ * Built-in cases for the primitives on most hot paths.
+ */
+
+static unsigned long kbench_sink;
+
+static void kbench_kmalloc_run(struct kbench_case *kc, unsigned long iters)
+{
+	while (iters--)
+		kfree(kmalloc(64, GFP_KERNEL));
+}
+
+static void kbench_page_alloc_run(struct kbench_case *kc,
+				  unsigned long iters)
+{
+	struct page *page;
+
+	while (iters--) {
+		page = alloc_page(GFP_KERNEL);
+		if (page)
+			__free_page(page);
+	}
+}
+
+static DEFINE_SPINLOCK(kbench_lock);
+
+static void kbench_spin_lock_run(struct kbench_case *kc, unsigned long iters)
+{
+	while (iters--) {
+		spin_lock(&kbench_lock);
+		spin_unlock(&kbench_lock);
+	}
+}
+
+static void kbench_rcu_read_lock_run(struct kbench_case *kc,
+				     unsigned long iters)
+{
+	while (iters--) {
+		rcu_read_lock();
+		barrier();
+		rcu_read_unlock();
+	}
+}
+
+static void kbench_jhash_run(struct kbench_case *kc, unsigned long iters)
+{
+	static const u8 buf[64];
+	u32 hash = 0;
+
+	while (iters--)
+		hash = jhash(buf, sizeof(buf), hash);
+	WRITE_ONCE(kbench_sink, hash);
+}
+
+static struct kbench_case kbench_builtin_cases[] = {
+	{ .name = "kmalloc_64",		.run = kbench_kmalloc_run },
+	{ .name = "page_alloc",		.run = kbench_page_alloc_run },
+	{ .name = "spin_lock",		.run = kbench_spin_lock_run },
+	{ .name = "rcu_read_lock",	.run = kbench_rcu_read_lock_run },
+	{ .name = "jhash_64",		.run = kbench_jhash_run },
+};
+
+static int __init kbench_init(void)
+{
+	struct kbench_case *kc;
+	int i;
+
+	kbench_dir = debugfs_create_dir("kbench", NULL);
+	if (!kbench_dir) {
+		pr_warn("failed to create debugfs directory\n");
+		return -ENOMEM;
+	}
+
+	mutex_lock(&kbench_mutex);
+	list_for_each_entry(kc, &kbench_cases, list)
+		kbench_create_file(kc);
+	mutex_unlock(&kbench_mutex);
+
+	for (i = 0; i < ARRAY_SIZE(kbench_builtin_cases); i++)
+		kbench_register(&kbench_builtin_cases[i]);
+
+	return 0;
+}
+late_initcall(kbench_init);
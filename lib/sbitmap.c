@@ -524,6 +524,38 @@ void sbitmap_queue_clear(struct sbitmap_queue *sbq, unsigned int nr,
 }
 EXPORT_SYMBOL_GPL(sbitmap_queue_clear);
 
+void sbitmap_queue_clear_batch(struct sbitmap_queue *sbq, const int *bits,
+			       int nr_bits, unsigned int cpu)
+{
+	struct sbitmap *sb = &sbq->sb;
+	unsigned long *addr = NULL;
+	unsigned long mask = 0;
+	int i;
+
+	/* Release semantics of clear_bit_unlock() for every bit */
+	smp_mb__before_atomic();
+	for (i = 0; i < nr_bits; i++) {
+		unsigned long *this_addr = __sbitmap_word(sb, bits[i]);
+
+		if (addr && addr != this_addr) {
+			atomic_long_andnot(mask, (atomic_long_t *)addr);
+			mask = 0;
+		}
+		addr = this_addr;
+		mask |= 1UL << SB_NR_TO_BIT(sb, bits[i]);
+	}
+	atomic_long_andnot(mask, (atomic_long_t *)addr);
+
+	/* See sbitmap_queue_clear() */
+	smp_mb__after_atomic();
+	for (i = 0; i < nr_bits; i++)
+		sbitmap_queue_wake_up(sbq);
+
+	if (likely(!sbq->round_robin && bits[nr_bits - 1] < sb->depth))
+		*per_cpu_ptr(sbq->alloc_hint, cpu) = bits[nr_bits - 1];
+}
+EXPORT_SYMBOL_GPL(sbitmap_queue_clear_batch);
+
 void sbitmap_queue_wake_all(struct sbitmap_queue *sbq)
 {
 	int i, wake_index;
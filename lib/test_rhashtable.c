@@ -490,6 +490,74 @@ static int __init test_rhashtable_max(struct test_obj *array,
 	return err;
 }
 
+#define BULK_BATCH	16
+
+static int __init test_rhashtable_bulk(struct test_obj *array,
+				       unsigned int entries)
+{
+	struct rhash_head *heads[BULK_BATCH];
+	struct test_obj_val keys[BULK_BATCH];
+	const void *keyp[BULK_BATCH];
+	void *found[BULK_BATCH];
+	unsigned int i, j, n, nr;
+	int err;
+
+	test_rht_params.max_size = roundup_pow_of_two(entries);
+	err = rhashtable_init(&ht, &test_rht_params);
+	if (err)
+		return err;
+
+	for (i = 0; i < entries; i += n) {
+		n = min_t(unsigned int, BULK_BATCH, entries - i);
+		for (j = 0; j < n; j++) {
+			array[i + j].value.id = (i + j) * 2;
+			heads[j] = &array[i + j].node;
+		}
+		nr = rhashtable_insert_fast_bulk(&ht, heads, n,
+						 test_rht_params);
+		if (nr != n) {
+			pr_warn("bulk insert of %u..%u stopped at %u\n",
+				i, i + n - 1, i + nr);
+			err = -EINVAL;
+			goto out;
+		}
+	}
+
+	/* even keys were inserted, odd ones must not be found */
+	for (i = 0; i < 2 * entries; i += n) {
+		n = min_t(unsigned int, BULK_BATCH, 2 * entries - i);
+		for (j = 0; j < n; j++) {
+			keys[j].id = i + j;
+			keys[j].tid = 0;
+			keyp[j] = &keys[j];
+		}
+		rcu_read_lock();
+		nr = rhashtable_lookup_bulk(&ht, keyp, found, n,
+					    test_rht_params);
+		for (j = 0; j < n; j++) {
+			struct test_obj *obj = found[j];
+
+			if ((i + j) & 1 ? obj != NULL :
+			    !obj || obj->value.id != i + j) {
+				pr_warn("bulk lookup of key %u failed\n",
+					i + j);
+				err = -EINVAL;
+			}
+		}
+		rcu_read_unlock();
+		if (!err && nr != (n + 1) / 2) {
+			pr_warn("bulk lookup of %u..%u found %u keys\n",
+				i, i + n - 1, nr);
+			err = -EINVAL;
+		}
+		if (err)
+			goto out;
+	}
+out:
+	rhashtable_destroy(&ht);
+	return err;
+}
+
 static unsigned int __init print_ht(struct rhltable *rhlt)
 {
 	struct rhashtable *ht;
@@ -505,7 +573,7 @@ static unsigned int __init print_ht(struct rhltable *rhlt)
 		struct rhash_head *pos, *next;
 		struct test_obj_rhl *p;
 
-		pos = rht_dereference(tbl->buckets[i], ht);
+		pos = rht_ptr(rht_dereference(tbl->buckets[i], ht));
 		next = !rht_is_a_nulls(pos) ? rht_dereference(pos->next, ht) : NULL;
 
 		if (!rht_is_a_nulls(pos)) {
@@ -743,6 +811,9 @@ static int __init test_rht_init(void)
 	pr_info("test if its possible to exceed max_size %d: %s\n",
 			test_rht_params.max_size, test_rhashtable_max(objs, entries) == 0 ?
 			"no, ok" : "YES, failed");
+	memset(objs, 0, entries * sizeof(struct test_obj));
+	pr_info("bulk insert and lookup of %u entries: %s\n", entries,
+		test_rhashtable_bulk(objs, entries) ? "failed" : "ok");
 	vfree(objs);
 
 	do_div(total_time, runs);
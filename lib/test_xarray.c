@@ -504,6 +504,32 @@ static noinline void check_multi_store_3(struct xarray *xa, unsigned long index,
 }
 #endif
 
+static noinline void check_multi_get_order(struct xarray *xa)
+{
+#ifdef CONFIG_XARRAY_MULTI
+	unsigned int order, max_order = 20;
+	unsigned long i, j;
+
+	XA_BUG_ON(xa, xa_get_order(xa, 0) != 0);
+	xa_store_index(xa, 0, GFP_KERNEL);
+	XA_BUG_ON(xa, xa_get_order(xa, 0) != 0);
+	xa_erase_index(xa, 0);
+
+	for (order = 0; order < max_order; order++) {
+		i = 1UL << order;
+		xa_store_order(xa, i, order, xa_mk_index(i), GFP_KERNEL);
+		for (j = i; j < 2 * i; j += 1UL << (order / 2))
+			XA_BUG_ON(xa, xa_get_order(xa, j) != order);
+		XA_BUG_ON(xa, xa_get_order(xa, 2 * i - 1) != order);
+		XA_BUG_ON(xa, xa_get_order(xa, i - 1) != 0);
+		XA_BUG_ON(xa, xa_get_order(xa, 2 * i) != 0);
+		xa_erase_index(xa, i);
+		XA_BUG_ON(xa, xa_get_order(xa, i) != 0);
+		XA_BUG_ON(xa, !xa_empty(xa));
+	}
+#endif
+}
+
 static noinline void check_multi_store(struct xarray *xa)
 {
 #ifdef CONFIG_XARRAY_MULTI
@@ -854,6 +880,48 @@ static noinline void check_find_3(struct xarray *xa)
 	xa_destroy(xa);
 }
 
+static noinline void __check_find_batch(struct xarray *xa, unsigned long max,
+		unsigned int n)
+{
+	XA_STATE(xas, xa, 0);
+	void *dst[8];
+	unsigned long next = 0;
+	unsigned int i, got;
+
+	rcu_read_lock();
+	while ((got = xas_find_batch(&xas, dst, max, n)) > 0) {
+		XA_BUG_ON(xa, got > n);
+		for (i = 0; i < got; i++) {
+			XA_BUG_ON(xa, dst[i] != xa_mk_index(next));
+			next += 3;
+		}
+	}
+	rcu_read_unlock();
+	XA_BUG_ON(xa, next != (min(max, 297UL) / 3 + 1) * 3);
+}
+
+static noinline void check_find_batch(struct xarray *xa)
+{
+	unsigned long i;
+	unsigned int n;
+
+	for (i = 0; i < 300; i += 3)
+		XA_BUG_ON(xa, xa_store_index(xa, i, GFP_KERNEL) != NULL);
+#ifdef CONFIG_XARRAY_MULTI
+	/* A multi-index entry ends a batch and is returned only once */
+	xa_erase_index(xa, 66);
+	xa_store_order(xa, 64, 2, xa_mk_index(66), GFP_KERNEL);
+#endif
+
+	for (n = 1; n <= 8; n++) {
+		__check_find_batch(xa, ULONG_MAX, n);
+		__check_find_batch(xa, 150, n);
+		__check_find_batch(xa, 151, n);
+	}
+
+	xa_destroy(xa);
+}
+
 static noinline void check_find(struct xarray *xa)
 {
 	check_find_1(xa);
@@ -861,6 +929,7 @@ static noinline void check_find(struct xarray *xa)
 	check_find_3(xa);
 	check_multi_find(xa);
 	check_multi_find_2(xa);
+	check_find_batch(xa);
 }
 
 /* See find_swap_entry() in mm/shmem.c */
@@ -1323,6 +1392,7 @@ static int xarray_checks(void)
 	check_cmpxchg(&array);
 	check_reserve(&array);
 	check_multi_store(&array);
+	check_multi_get_order(&array);
 	check_xa_alloc();
 	check_find(&array);
 	check_find_entry(&array);
@@ -1093,6 +1093,64 @@ void *xas_find(struct xa_state *xas, unsigned long max)
 }
 EXPORT_SYMBOL_GPL(xas_find);
 
+/**
+ * xas_find_batch() - Find the next present entries in the XArray.
+ * @xas: XArray operation state.
+ * @dst: The buffer to copy entries into.
+ * @max: Highest index to return.
+ * @n: The maximum number of entries to copy.
+ *
+ * Finds the next present entry like xas_find() does, then copies it and
+ * the present entries which follow it in the same node into @dst.  The
+ * entries after the first one are read straight from the node's slots
+ * instead of walking the tree again for each of them.  Copying stops at
+ * the end of the node, at @max, after @n entries, or before an internal
+ * entry such as a sibling or retry entry, which the next call handles.
+ *
+ * Afterwards @xas refers to the last slot that was looked at, so calling
+ * xas_find_batch() again continues with the entries after it.
+ *
+ * Context: Any context.  The caller should hold the xa_lock or the RCU lock.
+ * Return: The number of entries copied, 0 if there are none left.
+ */
+unsigned int xas_find_batch(struct xa_state *xas, void **dst,
+		unsigned long max, unsigned int n)
+{
+	struct xa_node *node;
+	unsigned int i = 0;
+	void *entry;
+
+	if (!n)
+		return 0;
+
+	do {
+		entry = xas_find(xas, max);
+		if (!entry)
+			return 0;
+	} while (xas_retry(xas, entry));
+
+	dst[i++] = entry;
+
+	node = xas->xa_node;
+	if (xas_not_node(node) || node->shift ||
+			xas->xa_offset != (xas->xa_index & XA_CHUNK_MASK))
+		return i;
+
+	while (i < n && xas->xa_index < max &&
+			xas->xa_offset < XA_CHUNK_MASK) {
+		entry = xa_entry(xas->xa, node, xas->xa_offset + 1);
+		if (xa_is_internal(entry))
+			break;
+		xas->xa_offset++;
+		xas->xa_index++;
+		if (entry)
+			dst[i++] = entry;
+	}
+
+	return i;
+}
+EXPORT_SYMBOL_GPL(xas_find_batch);
+
 /**
  * xas_find_marked() - Find the next marked entry in the XArray.
  * @xas: XArray operation state.
@@ -1585,6 +1643,45 @@ void *xa_store_range(struct xarray *xa, unsigned long first,
 	return xas_result(&xas, NULL);
 }
 EXPORT_SYMBOL(xa_store_range);
+
+/**
+ * xa_get_order() - Get the order of an entry.
+ * @xa: XArray.
+ * @index: Index of the entry.
+ *
+ * Context: Any context.  Takes and releases the RCU lock.
+ * Return: A number between 0 and 63 indicating the order of the entry,
+ * which occupies 2^order indices.  0 if there is no entry at @index.
+ */
+int xa_get_order(struct xarray *xa, unsigned long index)
+{
+	XA_STATE(xas, xa, index);
+	void *entry;
+	int order = 0;
+
+	rcu_read_lock();
+	entry = xas_load(&xas);
+
+	if (!entry || !xas.xa_node)
+		goto unlock;
+
+	for (;;) {
+		unsigned int slot = xas.xa_offset + (1 << order);
+
+		if (slot >= XA_CHUNK_SIZE)
+			break;
+		if (!xa_is_sibling(xa_entry(xa, xas.xa_node, slot)))
+			break;
+		order++;
+	}
+
+	order += xas.xa_node->shift;
+unlock:
+	rcu_read_unlock();
+
+	return order;
+}
+EXPORT_SYMBOL(xa_get_order);
 #endif /* CONFIG_XARRAY_MULTI */
 
 /**
@@ -1829,16 +1926,14 @@ EXPORT_SYMBOL(xa_find_after);
 static unsigned int xas_extract_present(struct xa_state *xas, void **dst,
 			unsigned long max, unsigned int n)
 {
-	void *entry;
-	unsigned int i = 0;
+	unsigned int got, i = 0;
 
 	rcu_read_lock();
-	xas_for_each(xas, entry, max) {
-		if (xas_retry(xas, entry))
-			continue;
-		dst[i++] = entry;
-		if (i == n)
+	while (i < n) {
+		got = xas_find_batch(xas, dst + i, max, n - i);
+		if (!got)
 			break;
+		i += got;
 	}
 	rcu_read_unlock();
 
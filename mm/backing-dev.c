@@ -29,6 +29,8 @@ LIST_HEAD(bdi_list);
 
 /* bdi_wq serves all asynchronous writeback tasks */
 struct workqueue_struct *bdi_wq;
+/* wb_inode_wq helps the flushers write back several inodes at once */
+struct workqueue_struct *wb_inode_wq;
 
 #ifdef CONFIG_DEBUG_FS
 #include <linux/debugfs.h>
@@ -254,6 +256,13 @@ static int __init default_bdi_init(void)
 	if (!bdi_wq)
 		return -ENOMEM;
 
+	/*
+	 * Not freezable: the flushers wait for these works, and must be able
+	 * to finish while the freezer waits for bdi_wq to go idle.
+	 */
+	wb_inode_wq = alloc_workqueue("writeback_inode",
+				      WQ_MEM_RECLAIM | WQ_UNBOUND, 0);
+
 	err = bdi_init(&noop_backing_dev_info);
 
 	return err;
@@ -271,16 +271,17 @@ int __frontswap_store(struct page *page)
 	/* Try to store in each implementation, until one succeeds. */
 	for_each_frontswap_ops(ops) {
 		ret = ops->store(type, offset, page);
-		if (!ret) /* successful store */
+		if (ret >= 0) /* successful store */
 			break;
 	}
-	if (ret == 0) {
+	if (ret >= 0) {
 		__frontswap_set(sis, offset);
 		inc_frontswap_succ_stores();
 	} else {
 		inc_frontswap_failed_stores();
 	}
-	if (frontswap_writethrough_enabled)
+	/* an asynchronous store already owns the page writeback */
+	if (frontswap_writethrough_enabled && ret != FRONTSWAP_STORE_ASYNC)
 		/* report failure so swap also writes to swap device */
 		ret = -1;
 	return ret;
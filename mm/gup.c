@@ -1188,6 +1188,46 @@ long get_user_pages_longterm(unsigned long start, unsigned long nr_pages,
 	return rc;
 }
 EXPORT_SYMBOL(get_user_pages_longterm);
+
+/*
+ * get_user_pages_fast_longterm() is the get_user_pages_fast() flavour of
+ * get_user_pages_longterm(): it pins what it can without mmap_sem and
+ * only takes it for the rest.  The lockless walk has no vma to look at,
+ * so fsdax pages, which are ZONE_DEVICE, are handed to the slow path to
+ * be refused there.
+ */
+long get_user_pages_fast_longterm(unsigned long start, unsigned long nr_pages,
+		unsigned int gup_flags, struct page **pages)
+{
+	long nr, i, rc;
+
+	start &= PAGE_MASK;
+	nr = __get_user_pages_fast(start, nr_pages, gup_flags & FOLL_WRITE,
+				   pages);
+
+	for (i = 0; i < nr; i++) {
+		if (is_zone_device_page(pages[i]))
+			break;
+	}
+	rc = i;
+	for (; i < nr; i++)
+		put_page(pages[i]);
+	nr = rc;
+
+	if (nr == nr_pages)
+		return nr;
+
+	down_read(&current->mm->mmap_sem);
+	rc = get_user_pages_longterm(start + (nr << PAGE_SHIFT), nr_pages - nr,
+				     gup_flags, pages + nr, NULL);
+	up_read(&current->mm->mmap_sem);
+
+	/* Have to be a bit careful with return values */
+	if (rc < 0)
+		return nr ? nr : rc;
+	return nr + rc;
+}
+EXPORT_SYMBOL(get_user_pages_fast_longterm);
 #endif /* CONFIG_FS_DAX */
 
 /**
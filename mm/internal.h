@@ -204,6 +204,7 @@ struct compact_control {
 	bool whole_zone;		/* Whole zone should/has been scanned */
 	bool contended;			/* Signal lock or sched contention */
 	bool finishing_block;		/* Finishing current pageblock */
+	bool proactive_compaction;	/* kcompactd proactive compaction */
 };
 
 unsigned long
@@ -460,6 +461,7 @@ extern unsigned long  __must_check vm_mmap_pgoff(struct file *, unsigned long,
 extern void set_pageblock_order(void);
 unsigned long reclaim_clean_pages_from_list(struct zone *zone,
 					    struct list_head *page_list);
+unsigned long reclaim_pages(struct list_head *page_list);
 /* The ALLOC_WMARK bits are used as an index to zone->watermark */
 #define ALLOC_WMARK_MIN		WMARK_MIN
 #define ALLOC_WMARK_LOW		WMARK_LOW
@@ -527,4 +529,27 @@ static inline bool is_migrate_highatomic_page(struct page *page)
 
 void setup_zone_pageset(struct zone *zone);
 extern struct page *alloc_new_node_page(struct page *page, unsigned long node);
+
+#ifdef CONFIG_PAGE_PREZERO
+DECLARE_STATIC_KEY_FALSE(prezero_enabled);
+struct page *prezero_alloc_page(int nid);
+
+static inline bool prezero_wants(gfp_t gfp_mask, unsigned int order)
+{
+	if (!static_branch_unlikely(&prezero_enabled) || order)
+		return false;
+	return (gfp_mask & (__GFP_ZERO | __GFP_MOVABLE | __GFP_HIGHMEM)) ==
+		(__GFP_ZERO | __GFP_MOVABLE | __GFP_HIGHMEM);
+}
+#else
+static inline bool prezero_wants(gfp_t gfp_mask, unsigned int order)
+{
+	return false;
+}
+
+static inline struct page *prezero_alloc_page(int nid)
+{
+	return NULL;
+}
+#endif
 #endif	/* __MM_INTERNAL_H */
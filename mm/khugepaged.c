@@ -29,6 +29,7 @@ enum scan_result {
 	SCAN_PMD_NULL,
 	SCAN_EXCEED_NONE_PTE,
 	SCAN_PTE_NON_PRESENT,
+	SCAN_PTE_UFFD_WP,
 	SCAN_PAGE_RO,
 	SCAN_LACK_REFERENCED_PAGE,
 	SCAN_PAGE_NULL,
@@ -350,7 +351,11 @@ int __init khugepaged_init(void)
 	if (!mm_slot_cache)
 		return -ENOMEM;
 
-	khugepaged_pages_to_scan = HPAGE_PMD_NR * 8;
+	/*
+	 * Scan eight huge pages worth of ptes per wakeup for each node, so
+	 * that a pass over all mms does not take longer on bigger hosts.
+	 */
+	khugepaged_pages_to_scan = HPAGE_PMD_NR * 8 * num_online_nodes();
 	khugepaged_max_ptes_none = HPAGE_PMD_NR - 1;
 	khugepaged_max_ptes_swap = HPAGE_PMD_NR / 8;
 
@@ -404,6 +409,9 @@ static bool hugepage_vma_check(struct vm_area_struct *vma,
 	    (vm_flags & VM_NOHUGEPAGE) ||
 	    test_bit(MMF_DISABLE_THP, &vma->vm_mm->flags))
 		return false;
+	/* write protection is tracked per pte, a huge pmd cannot hold it */
+	if (vm_flags & VM_UFFD_WP)
+		return false;
 	if (shmem_file(vma->vm_file)) {
 		if (!IS_ENABLED(CONFIG_TRANSPARENT_HUGE_PAGECACHE))
 			return false;
@@ -1124,6 +1132,14 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 	     _pte++, _address += PAGE_SIZE) {
 		pte_t pteval = *_pte;
 		if (is_swap_pte(pteval)) {
+			/*
+			 * The write protect bit lives in the ptes, a huge
+			 * pmd would lose it.
+			 */
+			if (pte_swp_uffd_wp(pteval)) {
+				result = SCAN_PTE_UFFD_WP;
+				goto out_unmap;
+			}
 			if (++unmapped <= khugepaged_max_ptes_swap) {
 				continue;
 			} else {
@@ -1144,6 +1160,10 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 			result = SCAN_PTE_NON_PRESENT;
 			goto out_unmap;
 		}
+		if (pte_uffd_wp(pteval)) {
+			result = SCAN_PTE_UFFD_WP;
+			goto out_unmap;
+		}
 		if (pte_write(pteval))
 			writable = true;
 
@@ -1642,6 +1662,46 @@ static void khugepaged_scan_shmem(struct mm_struct *mm,
 }
 #endif
 
+/*
+ * How many mms ahead of the scan cursor are considered when picking the
+ * next one to scan.
+ */
+#define KHUGEPAGED_SCAN_LOOKAHEAD	8
+
+/*
+ * Pick the mm to scan after @pos: among the next KHUGEPAGED_SCAN_LOOKAHEAD
+ * mms, the one with the most anonymous and shmem memory, which is where
+ * collapsing saves the most TLB misses. It is moved right after @pos, so
+ * that every mm is still scanned once per pass over the list.
+ */
+static struct mm_slot *khugepaged_next_mm_slot(struct list_head *pos)
+{
+	struct list_head *p = pos->next;
+	struct mm_slot *best = NULL;
+	unsigned long best_rss = 0;
+	int i;
+
+	lockdep_assert_held(&khugepaged_mm_lock);
+
+	for (i = 0; i < KHUGEPAGED_SCAN_LOOKAHEAD &&
+		    p != &khugepaged_scan.mm_head; i++, p = p->next) {
+		struct mm_slot *mm_slot = list_entry(p, struct mm_slot,
+						     mm_node);
+		unsigned long rss;
+
+		rss = get_mm_counter(mm_slot->mm, MM_ANONPAGES) +
+		      get_mm_counter(mm_slot->mm, MM_SHMEMPAGES);
+		if (!best || rss > best_rss) {
+			best = mm_slot;
+			best_rss = rss;
+		}
+	}
+
+	if (best)
+		list_move(&best->mm_node, pos);
+	return best;
+}
+
 static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 					    struct page **hpage)
 	__releases(&khugepaged_mm_lock)
@@ -1658,8 +1718,7 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 	if (khugepaged_scan.mm_slot)
 		mm_slot = khugepaged_scan.mm_slot;
 	else {
-		mm_slot = list_entry(khugepaged_scan.mm_head.next,
-				     struct mm_slot, mm_node);
+		mm_slot = khugepaged_next_mm_slot(&khugepaged_scan.mm_head);
 		khugepaged_scan.address = 0;
 		khugepaged_scan.mm_slot = mm_slot;
 	}
@@ -1753,9 +1812,8 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 		 * mm_slot not pointing to the exiting mm.
 		 */
 		if (mm_slot->mm_node.next != &khugepaged_scan.mm_head) {
-			khugepaged_scan.mm_slot = list_entry(
-				mm_slot->mm_node.next,
-				struct mm_slot, mm_node);
+			khugepaged_scan.mm_slot =
+				khugepaged_next_mm_slot(&mm_slot->mm_node);
 			khugepaged_scan.address = 0;
 		} else {
 			khugepaged_scan.mm_slot = NULL;
@@ -25,7 +25,7 @@
 #include <linux/pagemap.h>
 #include <linux/rmap.h>
 #include <linux/spinlock.h>
-#include <linux/jhash.h>
+#include <linux/xxhash.h>
 #include <linux/delay.h>
 #include <linux/kthread.h>
 #include <linux/wait.h>
@@ -279,6 +279,9 @@ static unsigned int zero_checksum __read_mostly;
 /* Whether to merge empty (zeroed) pages with actual zero pages */
 static bool ksm_use_zero_pages __read_mostly;
 
+/* Whether to merge the page cache pages mapped by private file mappings */
+static bool ksm_merge_file_pages __read_mostly;
+
 #ifdef CONFIG_NUMA
 /* Zeroed when merging across nodes is not allowed */
 static unsigned int ksm_merge_across_nodes = 1;
@@ -549,6 +552,24 @@ static void break_cow(struct rmap_item *rmap_item)
 	up_read(&mm->mmap_sem);
 }
 
+/*
+ * With merge_file_pages set, the page cache pages mapped by a mergeable
+ * private file mapping are merged too.  The ksm page replaces the page in
+ * that mapping only: like a COW copy it no longer sees writes to the file.
+ * A page cache page never becomes the ksm page itself, it can only be
+ * replaced by one.
+ */
+static bool ksm_file_page(struct vm_area_struct *vma, struct page *page)
+{
+	return ksm_merge_file_pages && vma->vm_file && vma->anon_vma &&
+	       !PageAnon(page) && page->mapping && !PageCompound(page);
+}
+
+static bool ksm_mergeable_page(struct vm_area_struct *vma, struct page *page)
+{
+	return PageAnon(page) || ksm_file_page(vma, page);
+}
+
 static struct page *get_mergeable_page(struct rmap_item *rmap_item)
 {
 	struct mm_struct *mm = rmap_item->mm;
@@ -564,7 +585,7 @@ static struct page *get_mergeable_page(struct rmap_item *rmap_item)
 	page = follow_page(vma, addr, FOLL_GET);
 	if (IS_ERR_OR_NULL(page))
 		goto out;
-	if (PageAnon(page)) {
+	if (ksm_mergeable_page(vma, page)) {
 		flush_anon_page(vma, page, addr);
 		flush_dcache_page(page);
 	} else {
@@ -1009,7 +1030,7 @@ static u32 calc_checksum(struct page *page)
 {
 	u32 checksum;
 	void *addr = kmap_atomic(page);
-	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	checksum = xxhash(addr, PAGE_SIZE, 0);
 	kunmap_atomic(addr);
 	return checksum;
 }
@@ -1158,17 +1179,25 @@ static int replace_page(struct vm_area_struct *vma, struct page *page,
 		get_page(kpage);
 		page_add_anon_rmap(kpage, vma, addr, false);
 		newpte = mk_pte(kpage, vma->vm_page_prot);
+		/* a page cache page is replaced by an anonymous one */
+		if (!PageAnon(page)) {
+			dec_mm_counter(mm, mm_counter_file(page));
+			inc_mm_counter(mm, MM_ANONPAGES);
+		}
 	} else {
 		newpte = pte_mkspecial(pfn_pte(page_to_pfn(kpage),
 					       vma->vm_page_prot));
 		/*
-		 * We're replacing an anonymous page with a zero page, which is
-		 * not anonymous. We need to do proper accounting otherwise we
+		 * We're replacing a page with a zero page, which is not
+		 * accounted. We need to do proper accounting otherwise we
 		 * will get wrong values in /proc, and a BUG message in dmesg
 		 * when tearing down the mm.
 		 */
-		dec_mm_counter(mm, MM_ANONPAGES);
+		dec_mm_counter(mm, mm_counter(page));
 	}
+	/* keep the userfaultfd write protection of the range */
+	if (pte_uffd_wp(orig_pte))
+		newpte = pte_mkuffd_wp(newpte);
 
 	flush_cache_page(vma, addr, pte_pfn(*ptep));
 	/*
@@ -1196,7 +1225,8 @@ static int replace_page(struct vm_area_struct *vma, struct page *page,
 /*
  * try_to_merge_one_page - take two pages and merge them into one
  * @vma: the vma that holds the pte pointing to page
- * @page: the PageAnon page that we want to replace with kpage
+ * @page: the PageAnon page that we want to replace with kpage, or a page
+ *        cache page of a private file mapping when merging into a kpage
  * @kpage: the PageKsm page that we want to map instead of page,
  *         or NULL the first time when we want to use page as kpage.
  *
@@ -1211,7 +1241,7 @@ static int try_to_merge_one_page(struct vm_area_struct *vma,
 	if (page == kpage)			/* ksm page forked */
 		return 0;
 
-	if (!PageAnon(page))
+	if (!PageAnon(page) && !(kpage && ksm_file_page(vma, page)))
 		goto out;
 
 	/*
@@ -1304,12 +1334,69 @@ static int try_to_merge_with_ksm_page(struct rmap_item *rmap_item,
 	return err;
 }
 
+/*
+ * ksm_copy_file_page - build a ksm page from a copy of the page cache page
+ * at rmap_item, and map it there in place of that page.
+ *
+ * Returns the ksm page with a reference held, or NULL on failure.
+ */
+static struct page *ksm_copy_file_page(struct rmap_item *rmap_item,
+				       struct page *page)
+{
+	struct mm_struct *mm = rmap_item->mm;
+	unsigned long addr = rmap_item->address;
+	struct vm_area_struct *vma;
+	struct mem_cgroup *memcg;
+	struct page *kpage = NULL;
+	int err;
+
+	down_read(&mm->mmap_sem);
+	vma = find_mergeable_vma(mm, addr);
+	if (!vma)
+		goto out;
+
+	kpage = alloc_page_vma(GFP_HIGHUSER_MOVABLE, vma, addr);
+	if (!kpage)
+		goto out;
+	if (mem_cgroup_try_charge(kpage, mm, GFP_KERNEL, &memcg, false)) {
+		put_page(kpage);
+		kpage = NULL;
+		goto out;
+	}
+
+	copy_user_highpage(kpage, page, addr, vma);
+	__SetPageUptodate(kpage);
+	__SetPageSwapBacked(kpage);
+	SetPageDirty(kpage);
+	set_page_stable_node(kpage, NULL);
+	mem_cgroup_commit_charge(kpage, memcg, false, false);
+	lru_cache_add_active_or_unevictable(kpage, vma);
+
+	/* compares the copy again once page is locked and write protected */
+	err = try_to_merge_one_page(vma, page, kpage);
+	if (err) {
+		put_page(kpage);
+		kpage = NULL;
+		goto out;
+	}
+
+	/* Unstable nid is in union with stable anon_vma: remove first */
+	remove_rmap_item_from_tree(rmap_item);
+
+	/* Must get reference to anon_vma while still holding mmap_sem */
+	rmap_item->anon_vma = vma->anon_vma;
+	get_anon_vma(vma->anon_vma);
+out:
+	up_read(&mm->mmap_sem);
+	return kpage;
+}
+
 /*
  * try_to_merge_two_pages - take two identical pages and prepare them
  * to be merged into one page.
  *
- * This function returns the kpage if we successfully merged two identical
- * pages into one ksm page, NULL otherwise.
+ * This function returns the kpage, with a reference held, if we successfully
+ * merged two identical pages into one ksm page, NULL otherwise.
  *
  * Note that this function upgrades page to ksm page: if one of the pages
  * is already a ksm page, try_to_merge_with_ksm_page should be used.
@@ -1319,20 +1406,44 @@ static struct page *try_to_merge_two_pages(struct rmap_item *rmap_item,
 					   struct rmap_item *tree_rmap_item,
 					   struct page *tree_page)
 {
+	struct page *kpage = NULL;
 	int err;
 
+	/* only an anonymous page can be upgraded to the ksm page */
+	if (!PageAnon(page)) {
+		if (!PageAnon(tree_page)) {
+			/*
+			 * Two page cache pages: the ksm page is a fresh
+			 * copy, mapped in place of page.
+			 */
+			kpage = ksm_copy_file_page(rmap_item, page);
+			if (!kpage)
+				return NULL;
+			page = kpage;
+			goto merge_tree_page;
+		}
+		swap(rmap_item, tree_rmap_item);
+		swap(page, tree_page);
+	}
+
 	err = try_to_merge_with_ksm_page(rmap_item, page, NULL);
-	if (!err) {
-		err = try_to_merge_with_ksm_page(tree_rmap_item,
-							tree_page, page);
+	if (err)
+		return NULL;
+	get_page(page);
+	kpage = page;
+
+merge_tree_page:
+	err = try_to_merge_with_ksm_page(tree_rmap_item, tree_page, kpage);
+	if (err) {
 		/*
-		 * If that fails, we have a ksm page with only one pte
-		 * pointing to it: so break it.
+		 * We have a ksm page with only one pte pointing to it:
+		 * so break it.
 		 */
-		if (err)
-			break_cow(rmap_item);
+		break_cow(rmap_item);
+		put_page(kpage);
+		return NULL;
 	}
-	return err ? NULL : page;
+	return kpage;
 }
 
 static __always_inline
@@ -2161,6 +2272,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 				break_cow(tree_rmap_item);
 				break_cow(rmap_item);
 			}
+			put_page(kpage);
 		} else if (split) {
 			/*
 			 * We are here if we tried to merge two pages and
@@ -2281,6 +2393,9 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 			continue;
 		if (ksm_scan.address < vma->vm_start)
 			ksm_scan.address = vma->vm_start;
+		/* ksm pages replacing page cache pages need an anon_vma */
+		if (!vma->anon_vma && ksm_merge_file_pages && vma->vm_file)
+			anon_vma_prepare(vma);
 		if (!vma->anon_vma)
 			ksm_scan.address = vma->vm_end;
 
@@ -2293,7 +2408,7 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 				cond_resched();
 				continue;
 			}
-			if (PageAnon(*page)) {
+			if (ksm_mergeable_page(vma, *page)) {
 				flush_anon_page(vma, *page, ksm_scan.address);
 				flush_dcache_page(*page);
 				rmap_item = get_next_rmap_item(slot,
@@ -2980,6 +3095,28 @@ static ssize_t use_zero_pages_store(struct kobject *kobj,
 }
 KSM_ATTR(use_zero_pages);
 
+static ssize_t merge_file_pages_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_merge_file_pages);
+}
+static ssize_t merge_file_pages_store(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      const char *buf, size_t count)
+{
+	int err;
+	bool value;
+
+	err = kstrtobool(buf, &value);
+	if (err)
+		return -EINVAL;
+
+	ksm_merge_file_pages = value;
+
+	return count;
+}
+KSM_ATTR(merge_file_pages);
+
 static ssize_t max_page_sharing_show(struct kobject *kobj,
 				     struct kobj_attribute *attr, char *buf)
 {
@@ -3123,6 +3260,7 @@ static struct attribute *ksm_attrs[] = {
 	&stable_node_dups_attr.attr,
 	&stable_node_chains_prune_millisecs_attr.attr,
 	&use_zero_pages_attr.attr,
+	&merge_file_pages_attr.attr,
 	NULL,
 };
 
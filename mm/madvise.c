@@ -24,6 +24,13 @@
 #include <linux/swapops.h>
 #include <linux/shmem_fs.h>
 #include <linux/mmu_notifier.h>
+#include <linux/page_idle.h>
+#include <linux/uio.h>
+#include <linux/slab.h>
+#include <linux/compat.h>
+#include <linux/proc_fs.h>
+#include <linux/ptrace.h>
+#include <linux/sched/mm.h>
 
 #include <asm/tlb.h>
 
@@ -40,6 +47,8 @@ static int madvise_need_mmap_write(int behavior)
 	case MADV_REMOVE:
 	case MADV_WILLNEED:
 	case MADV_DONTNEED:
+	case MADV_COLD:
+	case MADV_PAGEOUT:
 	case MADV_FREE:
 		return 0;
 	default:
@@ -307,6 +316,253 @@ static long madvise_willneed(struct vm_area_struct *vma,
 	return 0;
 }
 
+struct madvise_walk_private {
+	struct mmu_gather *tlb;
+	bool pageout;
+};
+
+static int madvise_cold_or_pageout_pte_range(pmd_t *pmd,
+				unsigned long addr, unsigned long end,
+				struct mm_walk *walk)
+{
+	struct madvise_walk_private *private = walk->private;
+	struct mmu_gather *tlb = private->tlb;
+	bool pageout = private->pageout;
+	struct mm_struct *mm = tlb->mm;
+	struct vm_area_struct *vma = walk->vma;
+	pte_t *orig_pte, *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+	LIST_HEAD(page_list);
+
+	if (fatal_signal_pending(current))
+		return -EINTR;
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (pmd_trans_huge(*pmd)) {
+		pmd_t orig_pmd;
+		unsigned long next = pmd_addr_end(addr, end);
+
+		ptl = pmd_trans_huge_lock(pmd, vma);
+		if (!ptl)
+			return 0;
+
+		orig_pmd = *pmd;
+		if (is_huge_zero_pmd(orig_pmd) || !pmd_present(orig_pmd))
+			goto huge_unlock;
+
+		page = pmd_page(orig_pmd);
+
+		/* Do not interfere with other mappings of this page */
+		if (page_mapcount(page) != 1)
+			goto huge_unlock;
+
+		if (next - addr != HPAGE_PMD_SIZE) {
+			int err;
+
+			get_page(page);
+			spin_unlock(ptl);
+			lock_page(page);
+			err = split_huge_page(page);
+			unlock_page(page);
+			put_page(page);
+			if (!err)
+				goto regular_page;
+			return 0;
+		}
+
+		if (pmd_young(orig_pmd)) {
+			pmdp_invalidate(vma, addr, pmd);
+			orig_pmd = pmd_mkold(orig_pmd);
+
+			set_pmd_at(mm, addr, pmd, orig_pmd);
+			tlb_remove_pmd_tlb_entry(tlb, pmd, addr);
+		}
+
+		ClearPageReferenced(page);
+		test_and_clear_page_young(page);
+		if (pageout) {
+			if (!isolate_lru_page(page))
+				list_add(&page->lru, &page_list);
+		} else {
+			deactivate_page(page);
+		}
+huge_unlock:
+		spin_unlock(ptl);
+		if (pageout)
+			reclaim_pages(&page_list);
+		return 0;
+	}
+
+regular_page:
+#endif
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	orig_pte = pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	flush_tlb_batched_pending(mm);
+	arch_enter_lazy_mmu_mode();
+	for (; addr < end; pte++, addr += PAGE_SIZE) {
+		ptent = *pte;
+
+		if (!pte_present(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page)
+			continue;
+
+		/*
+		 * Creating a THP page is expensive so split it only if we
+		 * are sure it's worth. Split it if we are only owner.
+		 */
+		if (PageTransCompound(page)) {
+			if (page_mapcount(page) != 1)
+				break;
+			get_page(page);
+			if (!trylock_page(page)) {
+				put_page(page);
+				break;
+			}
+			pte_unmap_unlock(orig_pte, ptl);
+			if (split_huge_page(page)) {
+				unlock_page(page);
+				put_page(page);
+				orig_pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
+				break;
+			}
+			unlock_page(page);
+			put_page(page);
+			orig_pte = pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
+			pte--;
+			addr -= PAGE_SIZE;
+			continue;
+		}
+
+		/* Do not interfere with other mappings of this page */
+		if (page_mapcount(page) != 1)
+			continue;
+
+		if (pte_young(ptent)) {
+			ptent = ptep_get_and_clear_full(mm, addr, pte,
+							tlb->fullmm);
+			ptent = pte_mkold(ptent);
+			set_pte_at(mm, addr, pte, ptent);
+			tlb_remove_tlb_entry(tlb, pte, addr);
+		}
+
+		/*
+		 * Reclaim does not pick the page while it looks referenced,
+		 * so drop PG_referenced and PG_young too. This makes idle
+		 * page tracking miss the recent accesses to the page.
+		 */
+		ClearPageReferenced(page);
+		test_and_clear_page_young(page);
+		if (pageout) {
+			if (!isolate_lru_page(page))
+				list_add(&page->lru, &page_list);
+		} else {
+			deactivate_page(page);
+		}
+	}
+
+	arch_leave_lazy_mmu_mode();
+	pte_unmap_unlock(orig_pte, ptl);
+	if (pageout)
+		reclaim_pages(&page_list);
+	cond_resched();
+
+	return 0;
+}
+
+static void madvise_cold_page_range(struct mmu_gather *tlb,
+			     struct vm_area_struct *vma,
+			     unsigned long addr, unsigned long end,
+			     bool pageout)
+{
+	struct madvise_walk_private walk_private = {
+		.tlb = tlb,
+		.pageout = pageout,
+	};
+	struct mm_walk cold_walk = {
+		.pmd_entry = madvise_cold_or_pageout_pte_range,
+		.mm = vma->vm_mm,
+		.private = &walk_private,
+	};
+
+	tlb_start_vma(tlb, vma);
+	walk_page_range(addr, end, &cold_walk);
+	tlb_end_vma(tlb, vma);
+}
+
+static inline bool can_madv_lru_vma(struct vm_area_struct *vma)
+{
+	return !(vma->vm_flags & (VM_LOCKED|VM_HUGETLB|VM_PFNMAP));
+}
+
+/*
+ * Only page out the file pages the caller could have written itself,
+ * to not let it evict the shared page cache of others.
+ */
+static inline bool can_do_pageout(struct vm_area_struct *vma)
+{
+	if (vma_is_anonymous(vma))
+		return true;
+	if (!vma->vm_file)
+		return false;
+	return inode_owner_or_capable(file_inode(vma->vm_file)) ||
+		inode_permission(file_inode(vma->vm_file), MAY_WRITE) == 0;
+}
+
+/*
+ * Move the pages of the range to the inactive list, to have them
+ * reclaimed before the others under memory pressure.
+ */
+static long madvise_cold(struct vm_area_struct *vma,
+			 struct vm_area_struct **prev,
+			 unsigned long start_addr, unsigned long end_addr)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	struct mmu_gather tlb;
+
+	*prev = vma;
+	if (!can_madv_lru_vma(vma))
+		return -EINVAL;
+
+	lru_add_drain();
+	tlb_gather_mmu(&tlb, mm, start_addr, end_addr);
+	madvise_cold_page_range(&tlb, vma, start_addr, end_addr, false);
+	tlb_finish_mmu(&tlb, start_addr, end_addr);
+
+	return 0;
+}
+
+/*
+ * Reclaim the pages of the range now, writing them to swap or back to
+ * their file where needed.
+ */
+static long madvise_pageout(struct vm_area_struct *vma,
+			    struct vm_area_struct **prev,
+			    unsigned long start_addr, unsigned long end_addr)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	struct mmu_gather tlb;
+
+	*prev = vma;
+	if (!can_madv_lru_vma(vma))
+		return -EINVAL;
+
+	if (!can_do_pageout(vma))
+		return 0;
+
+	lru_add_drain();
+	tlb_gather_mmu(&tlb, mm, start_addr, end_addr);
+	madvise_cold_page_range(&tlb, vma, start_addr, end_addr, true);
+	tlb_finish_mmu(&tlb, start_addr, end_addr);
+
+	return 0;
+}
+
 static int madvise_free_pte_range(pmd_t *pmd, unsigned long addr,
 				unsigned long end, struct mm_walk *walk)
 
@@ -511,11 +767,35 @@ static long madvise_dontneed_single_vma(struct vm_area_struct *vma,
 	return 0;
 }
 
+/*
+ * Extend a MADV_DONTNEED of [start, end) in @vma to the vmas that directly
+ * follow it, up to @range_end, so that zap_page_range() covers them all
+ * with a single mmu_gather and thus a single TLB shootdown instead of one
+ * per vma. *@prev is set to the last vma covered.
+ */
+static unsigned long madvise_dontneed_extend(struct vm_area_struct *vma,
+					     struct vm_area_struct **prev,
+					     unsigned long end,
+					     unsigned long range_end)
+{
+	struct vm_area_struct *next = vma->vm_next;
+
+	while (end < range_end && next && next->vm_start == end &&
+	       can_madv_dontneed_vma(next) && !userfaultfd_armed(next)) {
+		end = min(next->vm_end, range_end);
+		*prev = next;
+		next = next->vm_next;
+	}
+	return end;
+}
+
 static long madvise_dontneed_free(struct vm_area_struct *vma,
 				  struct vm_area_struct **prev,
 				  unsigned long start, unsigned long end,
-				  int behavior)
+				  unsigned long range_end, int behavior)
 {
+	struct mm_struct *mm = vma->vm_mm;
+
 	*prev = vma;
 	if (!can_madv_dontneed_vma(vma))
 		return -EINVAL;
@@ -523,8 +803,8 @@ static long madvise_dontneed_free(struct vm_area_struct *vma,
 	if (!userfaultfd_remove(vma, start, end)) {
 		*prev = NULL; /* mmap_sem has been dropped, prev is stale */
 
-		down_read(&current->mm->mmap_sem);
-		vma = find_vma(current->mm, start);
+		down_read(&mm->mmap_sem);
+		vma = find_vma(mm, start);
 		if (!vma)
 			return -ENOMEM;
 		if (start < vma->vm_start) {
@@ -559,8 +839,12 @@ static long madvise_dontneed_free(struct vm_area_struct *vma,
 		VM_WARN_ON(start >= end);
 	}
 
-	if (behavior == MADV_DONTNEED)
+	if (behavior == MADV_DONTNEED) {
+		if (*prev)
+			end = madvise_dontneed_extend(vma, prev, end,
+						      range_end);
 		return madvise_dontneed_single_vma(vma, start, end);
+	}
 	else if (behavior == MADV_FREE)
 		return madvise_free_single_vma(vma, start, end);
 	else
@@ -575,6 +859,7 @@ static long madvise_remove(struct vm_area_struct *vma,
 				struct vm_area_struct **prev,
 				unsigned long start, unsigned long end)
 {
+	struct mm_struct *mm = vma->vm_mm;
 	loff_t offset;
 	int error;
 	struct file *f;
@@ -605,13 +890,13 @@ static long madvise_remove(struct vm_area_struct *vma,
 	get_file(f);
 	if (userfaultfd_remove(vma, start, end)) {
 		/* mmap_sem was not released by userfaultfd_remove() */
-		up_read(&current->mm->mmap_sem);
+		up_read(&mm->mmap_sem);
 	}
 	error = vfs_fallocate(f,
 				FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
 				offset, end - start);
 	fput(f);
-	down_read(&current->mm->mmap_sem);
+	down_read(&mm->mmap_sem);
 	return error;
 }
 
@@ -686,16 +971,22 @@ static int madvise_inject_error(int behavior,
 
 static long
 madvise_vma(struct vm_area_struct *vma, struct vm_area_struct **prev,
-		unsigned long start, unsigned long end, int behavior)
+		unsigned long start, unsigned long end,
+		unsigned long range_end, int behavior)
 {
 	switch (behavior) {
 	case MADV_REMOVE:
 		return madvise_remove(vma, prev, start, end);
 	case MADV_WILLNEED:
 		return madvise_willneed(vma, prev, start, end);
+	case MADV_COLD:
+		return madvise_cold(vma, prev, start, end);
+	case MADV_PAGEOUT:
+		return madvise_pageout(vma, prev, start, end);
 	case MADV_FREE:
 	case MADV_DONTNEED:
-		return madvise_dontneed_free(vma, prev, start, end, behavior);
+		return madvise_dontneed_free(vma, prev, start, end, range_end,
+					     behavior);
 	default:
 		return madvise_behavior(vma, prev, start, end, behavior);
 	}
@@ -714,6 +1005,8 @@ madvise_behavior_valid(int behavior)
 	case MADV_WILLNEED:
 	case MADV_DONTNEED:
 	case MADV_FREE:
+	case MADV_COLD:
+	case MADV_PAGEOUT:
 #ifdef CONFIG_KSM
 	case MADV_MERGEABLE:
 	case MADV_UNMERGEABLE:
@@ -784,6 +1077,11 @@ madvise_behavior_valid(int behavior)
  *  MADV_DONTDUMP - the application wants to prevent pages in the given range
  *		from being included in its core dump.
  *  MADV_DODUMP - cancel MADV_DONTDUMP: no longer exclude from core dump.
+ *  MADV_COLD - the application is not expected to use this memory soon,
+ *		deactivate pages in this range so that they can be reclaimed
+ *		easily if memory pressure happens.
+ *  MADV_PAGEOUT - the application is not expected to use this memory soon,
+ *		page out the pages in this range immediately.
  *
  * return values:
  *  zero    - success
@@ -798,70 +1096,60 @@ madvise_behavior_valid(int behavior)
  *  -EBADF  - map exists, but area maps something that isn't a file.
  *  -EAGAIN - a kernel resource was temporarily unavailable.
  */
-SYSCALL_DEFINE3(madvise, unsigned long, start, size_t, len_in, int, behavior)
+/*
+ * Round up the range and check it. Returns 0 with *end set, or -EINVAL.
+ */
+static int madvise_check_range(unsigned long start, size_t len_in,
+			       unsigned long *end)
 {
-	unsigned long end, tmp;
-	struct vm_area_struct *vma, *prev;
-	int unmapped_error = 0;
-	int error = -EINVAL;
-	int write;
 	size_t len;
-	struct blk_plug plug;
-
-	if (!madvise_behavior_valid(behavior))
-		return error;
 
 	if (start & ~PAGE_MASK)
-		return error;
+		return -EINVAL;
 	len = (len_in + ~PAGE_MASK) & PAGE_MASK;
 
 	/* Check to see whether len was rounded up from small -ve to zero */
 	if (len_in && !len)
-		return error;
-
-	end = start + len;
-	if (end < start)
-		return error;
+		return -EINVAL;
 
-	error = 0;
-	if (end == start)
-		return error;
+	*end = start + len;
+	if (*end < start)
+		return -EINVAL;
 
-#ifdef CONFIG_MEMORY_FAILURE
-	if (behavior == MADV_HWPOISON || behavior == MADV_SOFT_OFFLINE)
-		return madvise_inject_error(behavior, start, start + len_in);
-#endif
+	return 0;
+}
 
-	write = madvise_need_mmap_write(behavior);
-	if (write) {
-		if (down_write_killable(&current->mm->mmap_sem))
-			return -EINTR;
-	} else {
-		down_read(&current->mm->mmap_sem);
-	}
+/*
+ * Apply @behavior to [start, end) of @mm, with mmap_sem held.
+ */
+static int madvise_walk_vmas(struct mm_struct *mm, unsigned long start,
+			     unsigned long end, int behavior)
+{
+	unsigned long tmp;
+	struct vm_area_struct *vma, *prev;
+	int unmapped_error = 0;
+	int error;
 
 	/*
 	 * If the interval [start,end) covers some unmapped address
 	 * ranges, just ignore them, but return -ENOMEM at the end.
 	 * - different from the way of handling in mlock etc.
 	 */
-	vma = find_vma_prev(current->mm, start, &prev);
+	vma = find_vma_prev(mm, start, &prev);
 	if (vma && start > vma->vm_start)
 		prev = vma;
 
-	blk_start_plug(&plug);
 	for (;;) {
 		/* Still start < end. */
-		error = -ENOMEM;
 		if (!vma)
-			goto out;
+			return -ENOMEM;
 
 		/* Here start < (end|vma->vm_end). */
 		if (start < vma->vm_start) {
 			unmapped_error = -ENOMEM;
 			start = vma->vm_start;
 			if (start >= end)
-				goto out;
+				return -ENOMEM;
 		}
 
 		/* Here vma->vm_start <= start < (end|vma->vm_end) */
@@ -870,26 +1158,223 @@ SYSCALL_DEFINE3(madvise, unsigned long, start, size_t, len_in, int, behavior)
 			tmp = end;
 
 		/* Here vma->vm_start <= start < tmp <= (end|vma->vm_end). */
-		error = madvise_vma(vma, &prev, start, tmp, behavior);
+		error = madvise_vma(vma, &prev, start, tmp, end, behavior);
 		if (error)
-			goto out;
+			return error;
 		start = tmp;
 		if (prev && start < prev->vm_end)
 			start = prev->vm_end;
-		error = unmapped_error;
 		if (start >= end)
-			goto out;
+			return unmapped_error;
 		if (prev)
 			vma = prev->vm_next;
 		else	/* madvise_remove dropped mmap_sem */
-			vma = find_vma(current->mm, start);
+			vma = find_vma(mm, start);
 	}
-out:
-	blk_finish_plug(&plug);
-	if (write)
-		up_write(&current->mm->mmap_sem);
+}
+
+static int madvise_lock(struct mm_struct *mm, int behavior)
+{
+	if (madvise_need_mmap_write(behavior)) {
+		if (down_write_killable(&mm->mmap_sem))
+			return -EINTR;
+	} else {
+		down_read(&mm->mmap_sem);
+	}
+	return 0;
+}
+
+static void madvise_unlock(struct mm_struct *mm, int behavior)
+{
+	if (madvise_need_mmap_write(behavior))
+		up_write(&mm->mmap_sem);
 	else
-		up_read(&current->mm->mmap_sem);
+		up_read(&mm->mmap_sem);
+}
+
+SYSCALL_DEFINE3(madvise, unsigned long, start, size_t, len_in, int, behavior)
+{
+	struct mm_struct *mm = current->mm;
+	unsigned long end;
+	int error;
+	struct blk_plug plug;
+
+	if (!madvise_behavior_valid(behavior))
+		return -EINVAL;
+
+	error = madvise_check_range(start, len_in, &end);
+	if (error || end == start)
+		return error;
+
+#ifdef CONFIG_MEMORY_FAILURE
+	if (behavior == MADV_HWPOISON || behavior == MADV_SOFT_OFFLINE)
+		return madvise_inject_error(behavior, start, start + len_in);
+#endif
+
+	error = madvise_lock(mm, behavior);
+	if (error)
+		return error;
+
+	blk_start_plug(&plug);
+	error = madvise_walk_vmas(mm, start, end, behavior);
+	blk_finish_plug(&plug);
+
+	madvise_unlock(mm, behavior);
 
 	return error;
 }
+
+/*
+ * The hints another process may apply to a task's memory: they change
+ * how the memory is cached, not what it contains.
+ */
+static bool process_madvise_remote_valid(int behavior)
+{
+	switch (behavior) {
+	case MADV_COLD:
+	case MADV_PAGEOUT:
+	case MADV_WILLNEED:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Apply @behavior to every range of @iter in @mm, under a single
+ * mmap_sem hold. Returns the number of bytes advised if any, or the
+ * error that stopped the first range.
+ */
+static ssize_t madvise_iter(struct mm_struct *mm, struct iov_iter *iter,
+			    int behavior)
+{
+	size_t total_len = iov_iter_count(iter);
+	struct blk_plug plug;
+	ssize_t ret = 0;
+
+	ret = madvise_lock(mm, behavior);
+	if (ret)
+		return ret;
+
+	blk_start_plug(&plug);
+	while (iov_iter_count(iter)) {
+		struct iovec iovec = iov_iter_iovec(iter);
+		unsigned long start = (unsigned long)iovec.iov_base;
+		unsigned long end;
+
+		ret = madvise_check_range(start, iovec.iov_len, &end);
+		if (ret)
+			break;
+		if (end != start) {
+			ret = madvise_walk_vmas(mm, start, end, behavior);
+			if (ret)
+				break;
+		}
+		iov_iter_advance(iter, iovec.iov_len);
+	}
+	blk_finish_plug(&plug);
+
+	madvise_unlock(mm, behavior);
+
+	return total_len == iov_iter_count(iter) ? ret :
+		total_len - iov_iter_count(iter);
+}
+
+static ssize_t do_process_madvise(int pidfd, struct iov_iter *iter,
+				  int behavior, unsigned int flags)
+{
+	struct task_struct *task;
+	struct mm_struct *mm;
+	struct fd f;
+	struct pid *pid;
+	ssize_t ret;
+
+	if (flags != 0)
+		return -EINVAL;
+
+	if (!madvise_behavior_valid(behavior) ||
+	    behavior == MADV_HWPOISON || behavior == MADV_SOFT_OFFLINE)
+		return -EINVAL;
+
+	f = fdget(pidfd);
+	if (!f.file)
+		return -EBADF;
+
+	pid = tgid_pidfd_to_pid(f.file);
+	if (IS_ERR(pid)) {
+		ret = PTR_ERR(pid);
+		goto put_fd;
+	}
+
+	task = get_pid_task(pid, PIDTYPE_PID);
+	if (!task) {
+		ret = -ESRCH;
+		goto put_fd;
+	}
+
+	if (task->mm != current->mm &&
+	    !process_madvise_remote_valid(behavior)) {
+		ret = -EINVAL;
+		goto put_task;
+	}
+
+	mm = mm_access(task, PTRACE_MODE_ATTACH_FSCREDS);
+	if (IS_ERR_OR_NULL(mm)) {
+		ret = IS_ERR(mm) ? PTR_ERR(mm) : -ESRCH;
+		goto put_task;
+	}
+
+	ret = madvise_iter(mm, iter, behavior);
+	mmput(mm);
+put_task:
+	put_task_struct(task);
+put_fd:
+	fdput(f);
+	return ret;
+}
+
+/*
+ * The process_madvise(2) system call.
+ *
+ * Applies madvise() to a vector of ranges of the process @pidfd, an
+ * open /proc/<pid> directory, taking its mmap_sem once for the whole
+ * vector. Another process than the caller may only be given the
+ * MADV_COLD, MADV_PAGEOUT and MADV_WILLNEED hints, and needs ptrace
+ * access to it. Returns the number of bytes advised.
+ */
+SYSCALL_DEFINE5(process_madvise, int, pidfd, const struct iovec __user *, vec,
+		unsigned long, vlen, int, behavior, unsigned int, flags)
+{
+	struct iovec iovstack[UIO_FASTIOV], *iov = iovstack;
+	struct iov_iter iter;
+	ssize_t ret;
+
+	ret = import_iovec(READ, vec, vlen, ARRAY_SIZE(iovstack), &iov, &iter);
+	if (ret < 0)
+		return ret;
+
+	ret = do_process_madvise(pidfd, &iter, behavior, flags);
+	kfree(iov);
+	return ret;
+}
+
+#ifdef CONFIG_COMPAT
+COMPAT_SYSCALL_DEFINE5(process_madvise, int, pidfd,
+		       const struct compat_iovec __user *, vec,
+		       compat_ulong_t, vlen, int, behavior,
+		       unsigned int, flags)
+{
+	struct iovec iovstack[UIO_FASTIOV], *iov = iovstack;
+	struct iov_iter iter;
+	ssize_t ret;
+
+	ret = compat_import_iovec(READ, vec, vlen, ARRAY_SIZE(iovstack),
+				  &iov, &iter);
+	if (ret < 0)
+		return ret;
+
+	ret = do_process_madvise(pidfd, &iter, behavior, flags);
+	kfree(iov);
+	return ret;
+}
+#endif
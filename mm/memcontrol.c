@@ -487,7 +487,11 @@ ino_t page_cgroup_ino(struct page *page)
 	unsigned long ino = 0;
 
 	rcu_read_lock();
-	memcg = READ_ONCE(page->mem_cgroup);
+	/* a slab page shared by objects of several memcgs belongs to none */
+	if (page_objcg_vec(page))
+		memcg = NULL;
+	else
+		memcg = READ_ONCE(page->mem_cgroup);
 	while (memcg && !(memcg->css.flags & CSS_ONLINE))
 		memcg = parent_mem_cgroup(memcg);
 	if (memcg)
@@ -686,6 +690,11 @@ static unsigned long memcg_sum_events(struct mem_cgroup *memcg,
 	return atomic_long_read(&memcg->events[event]);
 }
 
+static unsigned long memcg_events_local(struct mem_cgroup *memcg, int event)
+{
+	return atomic_long_read(&memcg->events_local[event]);
+}
+
 static void mem_cgroup_charge_statistics(struct mem_cgroup *memcg,
 					 struct page *page,
 					 bool compound, int nr_pages)
@@ -1339,7 +1348,7 @@ void mem_cgroup_print_oom_info(struct mem_cgroup *memcg, struct task_struct *p)
 			if (memcg1_stats[i] == MEMCG_SWAP && !do_swap_account)
 				continue;
 			pr_cont(" %s:%luKB", memcg1_stat_names[i],
-				K(memcg_page_state(iter, memcg1_stats[i])));
+				K(memcg_page_state_local(iter, memcg1_stats[i])));
 		}
 
 		for (i = 0; i < NR_LRU_LISTS; i++)
@@ -1919,9 +1928,24 @@ void unlock_page_memcg(struct page *page)
 }
 EXPORT_SYMBOL(unlock_page_memcg);
 
+/*
+ * Tasks of several cgroups commonly share a cpu.  The stock caches
+ * charges for a few of them, so switching between them does not drain
+ * and refill the page counters every time.
+ */
+#define MEMCG_STOCK_SIZE	4
+
 struct memcg_stock_pcp {
-	struct mem_cgroup *cached; /* this never be root cgroup */
-	unsigned int nr_pages;
+	struct mem_cgroup *cached[MEMCG_STOCK_SIZE]; /* never root cgroup */
+	unsigned int nr_pages[MEMCG_STOCK_SIZE];
+	unsigned int next_evict;
+#ifdef CONFIG_MEMCG_KMEM
+	/* bytes precharged for slab objects, see memcg_kmem_charge_obj() */
+	struct obj_cgroup *cached_objcg;
+	unsigned int nr_bytes;
+	/* slab vmstat deltas below a page, see mod_objcg_slab_state() */
+	int nr_slab_bytes[2];
+#endif
 	struct work_struct work;
 	unsigned long flags;
 #define FLUSHING_CACHED_CHARGE	0
@@ -1929,12 +1953,30 @@ struct memcg_stock_pcp {
 static DEFINE_PER_CPU(struct memcg_stock_pcp, memcg_stock);
 static DEFINE_MUTEX(percpu_charge_mutex);
 
+#ifdef CONFIG_MEMCG_KMEM
+/* protects the objcg_list of all memcgs and the reparenting */
+static DEFINE_SPINLOCK(objcg_lock);
+
+static void drain_obj_stock(struct memcg_stock_pcp *stock);
+static bool obj_stock_flush_needed(struct memcg_stock_pcp *stock,
+				   struct mem_cgroup *root_memcg);
+#else
+static inline void drain_obj_stock(struct memcg_stock_pcp *stock)
+{
+}
+static inline bool obj_stock_flush_needed(struct memcg_stock_pcp *stock,
+					  struct mem_cgroup *root_memcg)
+{
+	return false;
+}
+#endif
+
 /**
  * consume_stock: Try to consume stocked charge on this cpu.
  * @memcg: memcg to consume from.
  * @nr_pages: how many pages to charge.
  *
- * The charges will only happen if @memcg matches the current cpu's memcg
+ * The charges will only happen if @memcg is in the current cpu's memcg
  * stock, and at least @nr_pages are available in that stock.  Failure to
  * service an allocation will refill the stock.
  *
@@ -1945,6 +1987,7 @@ static bool consume_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 	struct memcg_stock_pcp *stock;
 	unsigned long flags;
 	bool ret = false;
+	int i;
 
 	if (nr_pages > MEMCG_CHARGE_BATCH)
 		return ret;
@@ -1952,9 +1995,14 @@ static bool consume_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 	local_irq_save(flags);
 
 	stock = this_cpu_ptr(&memcg_stock);
-	if (memcg == stock->cached && stock->nr_pages >= nr_pages) {
-		stock->nr_pages -= nr_pages;
-		ret = true;
+	for (i = 0; i < MEMCG_STOCK_SIZE; i++) {
+		if (memcg != stock->cached[i])
+			continue;
+		if (stock->nr_pages[i] >= nr_pages) {
+			stock->nr_pages[i] -= nr_pages;
+			ret = true;
+		}
+		break;
 	}
 
 	local_irq_restore(flags);
@@ -1962,21 +2010,30 @@ static bool consume_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 	return ret;
 }
 
+static void drain_stock_slot(struct memcg_stock_pcp *stock, int i)
+{
+	struct mem_cgroup *old = stock->cached[i];
+	unsigned int nr_pages = stock->nr_pages[i];
+
+	if (nr_pages) {
+		page_counter_uncharge(&old->memory, nr_pages);
+		if (do_memsw_account())
+			page_counter_uncharge(&old->memsw, nr_pages);
+		css_put_many(&old->css, nr_pages);
+		stock->nr_pages[i] = 0;
+	}
+	stock->cached[i] = NULL;
+}
+
 /*
  * Returns stocks cached in percpu and reset cached information.
  */
 static void drain_stock(struct memcg_stock_pcp *stock)
 {
-	struct mem_cgroup *old = stock->cached;
+	int i;
 
-	if (stock->nr_pages) {
-		page_counter_uncharge(&old->memory, stock->nr_pages);
-		if (do_memsw_account())
-			page_counter_uncharge(&old->memsw, stock->nr_pages);
-		css_put_many(&old->css, stock->nr_pages);
-		stock->nr_pages = 0;
-	}
-	stock->cached = NULL;
+	for (i = 0; i < MEMCG_STOCK_SIZE; i++)
+		drain_stock_slot(stock, i);
 }
 
 static void drain_local_stock(struct work_struct *dummy)
@@ -1991,6 +2048,7 @@ static void drain_local_stock(struct work_struct *dummy)
 	local_irq_save(flags);
 
 	stock = this_cpu_ptr(&memcg_stock);
+	drain_obj_stock(stock);
 	drain_stock(stock);
 	clear_bit(FLUSHING_CACHED_CHARGE, &stock->flags);
 
@@ -2005,33 +2063,52 @@ static void refill_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 {
 	struct memcg_stock_pcp *stock;
 	unsigned long flags;
+	int i, empty = -1;
+
+	/*
+	 * Don't stock charges of a dying memcg, with several slots they could
+	 * keep it pinned long after it went offline.  Whatever was stocked
+	 * before is drained by mem_cgroup_css_offline().
+	 */
+	if (unlikely(css_is_dying(&memcg->css))) {
+		page_counter_uncharge(&memcg->memory, nr_pages);
+		if (do_memsw_account())
+			page_counter_uncharge(&memcg->memsw, nr_pages);
+		css_put_many(&memcg->css, nr_pages);
+		return;
+	}
 
 	local_irq_save(flags);
 
 	stock = this_cpu_ptr(&memcg_stock);
-	if (stock->cached != memcg) { /* reset if necessary */
-		drain_stock(stock);
-		stock->cached = memcg;
+	for (i = 0; i < MEMCG_STOCK_SIZE; i++) {
+		if (stock->cached[i] == memcg)
+			goto found;
+		if (!stock->cached[i] && empty < 0)
+			empty = i;
 	}
-	stock->nr_pages += nr_pages;
 
-	if (stock->nr_pages > MEMCG_CHARGE_BATCH)
-		drain_stock(stock);
+	/* no free slot, evict the stocks in turn */
+	if (empty < 0) {
+		empty = stock->next_evict;
+		stock->next_evict = (empty + 1) % MEMCG_STOCK_SIZE;
+		drain_stock_slot(stock, empty);
+	}
+	i = empty;
+	stock->cached[i] = memcg;
+found:
+	stock->nr_pages[i] += nr_pages;
+
+	if (stock->nr_pages[i] > MEMCG_CHARGE_BATCH)
+		drain_stock_slot(stock, i);
 
 	local_irq_restore(flags);
 }
 
-/*
- * Drains all per-CPU charge caches for given root_memcg resp. subtree
- * of the hierarchy under it.
- */
-static void drain_all_stock(struct mem_cgroup *root_memcg)
+static void __drain_all_stock(struct mem_cgroup *root_memcg)
 {
 	int cpu, curcpu;
 
-	/* If someone's already draining, avoid adding running more workers. */
-	if (!mutex_trylock(&percpu_charge_mutex))
-		return;
 	/*
 	 * Notify other cpus that system-wide "drain" is running
 	 * We do not care about races with the cpu hotplug because cpu down
@@ -2041,24 +2118,42 @@ static void drain_all_stock(struct mem_cgroup *root_memcg)
 	curcpu = get_cpu();
 	for_each_online_cpu(cpu) {
 		struct memcg_stock_pcp *stock = &per_cpu(memcg_stock, cpu);
-		struct mem_cgroup *memcg;
+		bool flush = false;
+		int i;
 
-		memcg = stock->cached;
-		if (!memcg || !stock->nr_pages || !css_tryget(&memcg->css))
-			continue;
-		if (!mem_cgroup_is_descendant(memcg, root_memcg)) {
+		for (i = 0; i < MEMCG_STOCK_SIZE && !flush; i++) {
+			struct mem_cgroup *memcg = READ_ONCE(stock->cached[i]);
+
+			if (!memcg || !READ_ONCE(stock->nr_pages[i]) ||
+			    !css_tryget(&memcg->css))
+				continue;
+			flush = mem_cgroup_is_descendant(memcg, root_memcg);
 			css_put(&memcg->css);
-			continue;
 		}
-		if (!test_and_set_bit(FLUSHING_CACHED_CHARGE, &stock->flags)) {
+		if (!flush)
+			flush = obj_stock_flush_needed(stock, root_memcg);
+
+		if (flush &&
+		    !test_and_set_bit(FLUSHING_CACHED_CHARGE, &stock->flags)) {
 			if (cpu == curcpu)
 				drain_local_stock(&stock->work);
 			else
 				schedule_work_on(cpu, &stock->work);
 		}
-		css_put(&memcg->css);
 	}
 	put_cpu();
+}
+
+/*
+ * Drains all per-CPU charge caches for given root_memcg resp. subtree
+ * of the hierarchy under it.
+ */
+static void drain_all_stock(struct mem_cgroup *root_memcg)
+{
+	/* If someone's already draining, avoid adding running more workers. */
+	if (!mutex_trylock(&percpu_charge_mutex))
+		return;
+	__drain_all_stock(root_memcg);
 	mutex_unlock(&percpu_charge_mutex);
 }
 
@@ -2068,6 +2163,7 @@ static int memcg_hotplug_cpu_dead(unsigned int cpu)
 	struct mem_cgroup *memcg;
 
 	stock = &per_cpu(memcg_stock, cpu);
+	drain_obj_stock(stock);
 	drain_stock(stock);
 
 	for_each_mem_cgroup(memcg) {
@@ -2079,7 +2175,7 @@ static int memcg_hotplug_cpu_dead(unsigned int cpu)
 
 			x = this_cpu_xchg(memcg->stat_cpu->count[i], 0);
 			if (x)
-				atomic_long_add(x, &memcg->stat[i]);
+				__memcg_flush_state(memcg, i, x);
 
 			if (i >= NR_VM_NODE_STAT_ITEMS)
 				continue;
@@ -2099,7 +2195,7 @@ static int memcg_hotplug_cpu_dead(unsigned int cpu)
 
 			x = this_cpu_xchg(memcg->stat_cpu->events[i], 0);
 			if (x)
-				atomic_long_add(x, &memcg->events[i]);
+				__memcg_flush_events(memcg, i, x);
 		}
 	}
 
@@ -2126,6 +2222,54 @@ static void high_work_func(struct work_struct *work)
 	reclaim_high(memcg, MEMCG_CHARGE_BATCH, GFP_KERNEL);
 }
 
+/*
+ * With memory.high.async_ratio set, a worker reclaims a memcg back below
+ * that share of memory.high before the limit is hit, so its tasks rarely
+ * have to reclaim on their own on the way back to userland.
+ */
+static struct workqueue_struct *memcg_high_async_wq;
+
+static void memcg_update_high_async(struct mem_cgroup *memcg)
+{
+	unsigned long high = READ_ONCE(memcg->high);
+	unsigned int ratio = READ_ONCE(memcg->high_async_ratio);
+
+	if (!ratio || high == PAGE_COUNTER_MAX)
+		WRITE_ONCE(memcg->high_async, PAGE_COUNTER_MAX);
+	else
+		WRITE_ONCE(memcg->high_async, mult_frac(high, ratio, 100));
+}
+
+static void high_async_work_func(struct work_struct *work)
+{
+	int nr_retries = MEM_CGROUP_RECLAIM_RETRIES;
+	struct mem_cgroup *memcg;
+
+	memcg = container_of(work, struct mem_cgroup, high_async_work);
+	while (nr_retries--) {
+		unsigned long usage = page_counter_read(&memcg->memory);
+		unsigned long wmark = READ_ONCE(memcg->high_async);
+
+		if (usage <= wmark)
+			break;
+		if (!try_to_free_mem_cgroup_pages(memcg, usage - wmark,
+						  GFP_KERNEL, true))
+			break;
+	}
+}
+
+static void memcg_check_high_async(struct mem_cgroup *memcg)
+{
+	do {
+		if (page_counter_read(&memcg->memory) <=
+		    READ_ONCE(memcg->high_async))
+			continue;
+		if (!work_pending(&memcg->high_async_work))
+			queue_work(memcg_high_async_wq,
+				   &memcg->high_async_work);
+	} while ((memcg = parent_mem_cgroup(memcg)));
+}
+
 /*
  * Scheduled by try_charge() to be executed from the userland return path
  * and reclaims memory over the high limit.
@@ -2298,9 +2442,19 @@ static int try_charge(struct mem_cgroup *memcg, gfp_t gfp_mask,
 	 * not recorded as it most likely matches current's and won't
 	 * change in the meantime.  As high limit is checked again before
 	 * reclaim, the cost of mismatch is negligible.
+	 *
+	 * The same walk kicks the background worker of each memcg above its
+	 * high.async mark.  It stops at the first memcg above high, as the
+	 * task then reclaims the hierarchy on its own.
 	 */
 	do {
-		if (page_counter_read(&memcg->memory) > memcg->high) {
+		unsigned long usage = page_counter_read(&memcg->memory);
+
+		if (usage > READ_ONCE(memcg->high_async) &&
+		    !work_pending(&memcg->high_async_work))
+			queue_work(memcg_high_async_wq, &memcg->high_async_work);
+
+		if (usage > memcg->high) {
 			/* Don't bother a random interrupted task */
 			if (in_interrupt()) {
 				schedule_work(&memcg->high_work);
@@ -2558,10 +2712,9 @@ void memcg_kmem_put_cache(struct kmem_cache *cachep)
  *
  * Returns 0 on success, an error code on failure.
  */
-int memcg_kmem_charge_memcg(struct page *page, gfp_t gfp, int order,
-			    struct mem_cgroup *memcg)
+static int __memcg_kmem_charge(struct mem_cgroup *memcg, gfp_t gfp,
+				unsigned int nr_pages)
 {
-	unsigned int nr_pages = 1 << order;
 	struct page_counter *counter;
 	int ret;
 
@@ -2574,6 +2727,28 @@ int memcg_kmem_charge_memcg(struct page *page, gfp_t gfp, int order,
 		cancel_charge(memcg, nr_pages);
 		return -ENOMEM;
 	}
+	return 0;
+}
+
+static void __memcg_kmem_uncharge(struct mem_cgroup *memcg,
+				  unsigned int nr_pages)
+{
+	if (!cgroup_subsys_on_dfl(memory_cgrp_subsys))
+		page_counter_uncharge(&memcg->kmem, nr_pages);
+
+	page_counter_uncharge(&memcg->memory, nr_pages);
+	if (do_memsw_account())
+		page_counter_uncharge(&memcg->memsw, nr_pages);
+}
+
+int memcg_kmem_charge_memcg(struct page *page, gfp_t gfp, int order,
+			    struct mem_cgroup *memcg)
+{
+	int ret;
+
+	ret = __memcg_kmem_charge(memcg, gfp, 1 << order);
+	if (ret)
+		return ret;
 
 	page->mem_cgroup = memcg;
 
@@ -2613,27 +2788,363 @@ int memcg_kmem_charge(struct page *page, gfp_t gfp, int order)
 void memcg_kmem_uncharge(struct page *page, int order)
 {
 	struct mem_cgroup *memcg = page->mem_cgroup;
-	unsigned int nr_pages = 1 << order;
 
 	if (!memcg)
 		return;
 
 	VM_BUG_ON_PAGE(mem_cgroup_is_root(memcg), page);
 
-	if (!cgroup_subsys_on_dfl(memory_cgrp_subsys))
-		page_counter_uncharge(&memcg->kmem, nr_pages);
-
-	page_counter_uncharge(&memcg->memory, nr_pages);
-	if (do_memsw_account())
-		page_counter_uncharge(&memcg->memsw, nr_pages);
-
 	page->mem_cgroup = NULL;
 
 	/* slab pages do not have PageKmemcg flag set */
 	if (PageKmemcg(page))
 		__ClearPageKmemcg(page);
 
-	css_put_many(&memcg->css, nr_pages);
+	__memcg_kmem_uncharge(memcg, 1 << order);
+	css_put_many(&memcg->css, 1 << order);
+}
+
+/*
+ * Slab objects are charged by the byte. The page counters are charged a
+ * page at a time and the unused part of the page is kept in the per-cpu
+ * stock, so most objects only touch the stock.
+ */
+static bool consume_obj_stock(struct obj_cgroup *objcg, unsigned int nr_bytes)
+{
+	struct memcg_stock_pcp *stock;
+	unsigned long flags;
+	bool ret = false;
+
+	local_irq_save(flags);
+
+	stock = this_cpu_ptr(&memcg_stock);
+	if (objcg == stock->cached_objcg && stock->nr_bytes >= nr_bytes) {
+		stock->nr_bytes -= nr_bytes;
+		ret = true;
+	}
+
+	local_irq_restore(flags);
+
+	return ret;
+}
+
+/*
+ * Give back charged bytes. Remainders smaller than a page are collected
+ * in the obj_cgroup until they add up to pages the counters can take back.
+ */
+static void obj_cgroup_uncharge_bytes(struct obj_cgroup *objcg,
+				      unsigned int nr_bytes)
+{
+	unsigned int nr_pages = nr_bytes >> PAGE_SHIFT;
+
+	nr_bytes &= PAGE_SIZE - 1;
+	if (nr_bytes) {
+		int old = atomic_read(&objcg->nr_charged_bytes);
+		int new;
+
+		do {
+			new = old + nr_bytes;
+		} while (!atomic_try_cmpxchg(&objcg->nr_charged_bytes, &old,
+					     new & (PAGE_SIZE - 1)));
+		nr_pages += new >> PAGE_SHIFT;
+	}
+
+	if (nr_pages) {
+		rcu_read_lock();
+		__memcg_kmem_uncharge(obj_cgroup_memcg(objcg), nr_pages);
+		rcu_read_unlock();
+	}
+}
+
+/* Fold sub-page slab vmstat deltas in and flush the whole pages */
+static void obj_cgroup_flush_slab_bytes(struct obj_cgroup *objcg, int i,
+					int nr_bytes)
+{
+	int x = atomic_add_return(nr_bytes, &objcg->nr_slab_bytes[i]);
+	int nr_pages = x / (int)PAGE_SIZE;
+
+	if (!nr_pages)
+		return;
+
+	atomic_sub(nr_pages * (int)PAGE_SIZE, &objcg->nr_slab_bytes[i]);
+	rcu_read_lock();
+	mod_memcg_state(obj_cgroup_memcg(objcg), NR_SLAB_RECLAIMABLE + i,
+			nr_pages);
+	rcu_read_unlock();
+}
+
+static void drain_obj_stock(struct memcg_stock_pcp *stock)
+{
+	struct obj_cgroup *old = stock->cached_objcg;
+	int i;
+
+	if (!old)
+		return;
+
+	if (stock->nr_bytes) {
+		obj_cgroup_uncharge_bytes(old, stock->nr_bytes);
+		stock->nr_bytes = 0;
+	}
+	for (i = 0; i < 2; i++) {
+		if (stock->nr_slab_bytes[i]) {
+			obj_cgroup_flush_slab_bytes(old, i,
+						    stock->nr_slab_bytes[i]);
+			stock->nr_slab_bytes[i] = 0;
+		}
+	}
+	stock->cached_objcg = NULL;
+	obj_cgroup_put(old);
+}
+
+static bool obj_stock_flush_needed(struct memcg_stock_pcp *stock,
+				   struct mem_cgroup *root_memcg)
+{
+	struct obj_cgroup *objcg;
+	bool flush = false;
+
+	rcu_read_lock();
+	objcg = READ_ONCE(stock->cached_objcg);
+	if (objcg)
+		flush = mem_cgroup_is_descendant(obj_cgroup_memcg(objcg),
+						 root_memcg);
+	rcu_read_unlock();
+	return flush;
+}
+
+/* Called with irqs disabled */
+static struct memcg_stock_pcp *get_obj_stock(struct obj_cgroup *objcg)
+{
+	struct memcg_stock_pcp *stock = this_cpu_ptr(&memcg_stock);
+
+	if (stock->cached_objcg != objcg) {
+		drain_obj_stock(stock);
+		obj_cgroup_get(objcg);
+		stock->cached_objcg = objcg;
+	}
+	return stock;
+}
+
+static void refill_obj_stock(struct obj_cgroup *objcg, unsigned int nr_bytes)
+{
+	struct memcg_stock_pcp *stock;
+	unsigned long flags;
+
+	local_irq_save(flags);
+
+	stock = get_obj_stock(objcg);
+	stock->nr_bytes += nr_bytes;
+
+	if (stock->nr_bytes > PAGE_SIZE)
+		drain_obj_stock(stock);
+
+	local_irq_restore(flags);
+}
+
+/**
+ * mod_objcg_slab_state: update the slab vmstats of an obj_cgroup's memcg
+ * @objcg: obj_cgroup the objects are charged to
+ * @idx: NR_SLAB_RECLAIMABLE or NR_SLAB_UNRECLAIMABLE
+ * @nr_bytes: size of the objects in bytes (positive or negative)
+ *
+ * The memcg counters are kept in pages. Whole pages are flushed to them
+ * as they add up, the remainder stays in the per-cpu stock.
+ */
+void mod_objcg_slab_state(struct obj_cgroup *objcg, enum node_stat_item idx,
+			  int nr_bytes)
+{
+	struct memcg_stock_pcp *stock;
+	unsigned long flags;
+	int i = idx - NR_SLAB_RECLAIMABLE;
+	int x, nr_pages;
+
+	local_irq_save(flags);
+
+	stock = get_obj_stock(objcg);
+	x = stock->nr_slab_bytes[i] + nr_bytes;
+	nr_pages = x / (int)PAGE_SIZE;
+	if (nr_pages) {
+		rcu_read_lock();
+		__mod_memcg_state(obj_cgroup_memcg(objcg), idx, nr_pages);
+		rcu_read_unlock();
+		x -= nr_pages * (int)PAGE_SIZE;
+	}
+	stock->nr_slab_bytes[i] = x;
+
+	local_irq_restore(flags);
+}
+
+static void obj_cgroup_release(struct percpu_ref *ref)
+{
+	struct obj_cgroup *objcg = container_of(ref, struct obj_cgroup, refcnt);
+	unsigned long flags;
+
+	/* the stocks have been drained, only whole pages were flushed */
+	WARN_ON_ONCE(atomic_read(&objcg->nr_charged_bytes));
+
+	spin_lock_irqsave(&objcg_lock, flags);
+	list_del(&objcg->list);
+	css_put(&objcg->memcg->css);
+	spin_unlock_irqrestore(&objcg_lock, flags);
+
+	percpu_ref_exit(ref);
+	kfree_rcu(objcg, rcu);
+}
+
+static struct obj_cgroup *obj_cgroup_alloc(struct mem_cgroup *memcg)
+{
+	struct obj_cgroup *objcg;
+
+	objcg = kzalloc(sizeof(*objcg), GFP_KERNEL);
+	if (!objcg)
+		return NULL;
+
+	if (percpu_ref_init(&objcg->refcnt, obj_cgroup_release, 0,
+			    GFP_KERNEL)) {
+		kfree(objcg);
+		return NULL;
+	}
+	INIT_LIST_HEAD(&objcg->list);
+	objcg->memcg = memcg;
+	return objcg;
+}
+
+/*
+ * The obj_cgroup of an offline memcg and those reparented to it before
+ * move to the parent. They hold a reference to the memcg they charge,
+ * except for the active one, which the memcg owns.
+ */
+static void memcg_reparent_objcgs(struct mem_cgroup *memcg,
+				  struct mem_cgroup *parent)
+{
+	struct obj_cgroup *objcg, *iter;
+
+	objcg = rcu_dereference_protected(memcg->objcg, true);
+	if (!objcg)
+		return;
+	RCU_INIT_POINTER(memcg->objcg, NULL);
+
+	spin_lock_irq(&objcg_lock);
+
+	css_get(&parent->css);
+	WRITE_ONCE(objcg->memcg, parent);
+	list_add(&objcg->list, &parent->objcg_list);
+
+	list_for_each_entry(iter, &memcg->objcg_list, list) {
+		css_get(&parent->css);
+		WRITE_ONCE(iter->memcg, parent);
+		css_put(&memcg->css);
+	}
+	list_splice_init(&memcg->objcg_list, &parent->objcg_list);
+
+	spin_unlock_irq(&objcg_lock);
+
+	percpu_ref_kill(&objcg->refcnt);
+}
+
+/**
+ * get_obj_cgroup_from_current: return the obj_cgroup to charge slab objects to
+ *
+ * Returns NULL if the objects are not accounted. Otherwise the reference
+ * must be dropped with obj_cgroup_put().
+ */
+struct obj_cgroup *get_obj_cgroup_from_current(void)
+{
+	struct obj_cgroup *objcg = NULL;
+	struct mem_cgroup *memcg, *iter;
+
+	if (mem_cgroup_disabled() || memcg_kmem_bypass())
+		return NULL;
+
+	memcg = get_mem_cgroup_from_current();
+	rcu_read_lock();
+	for (iter = memcg; iter && !mem_cgroup_is_root(iter);
+	     iter = parent_mem_cgroup(iter)) {
+		objcg = rcu_dereference(iter->objcg);
+		if (objcg && percpu_ref_tryget(&objcg->refcnt))
+			break;
+		objcg = NULL;
+	}
+	rcu_read_unlock();
+	css_put(&memcg->css);
+
+	return objcg;
+}
+
+/**
+ * memcg_kmem_charge_obj: charge slab objects
+ * @objcg: obj_cgroup to charge
+ * @gfp: reclaim mode
+ * @size: size of the objects in bytes
+ *
+ * Returns 0 on success, an error code on failure.
+ */
+int memcg_kmem_charge_obj(struct obj_cgroup *objcg, gfp_t gfp, size_t size)
+{
+	struct mem_cgroup *memcg;
+	unsigned int nr_pages, nr_bytes;
+	int ret;
+
+	if (consume_obj_stock(objcg, size))
+		return 0;
+
+	nr_pages = size >> PAGE_SHIFT;
+	nr_bytes = size & (PAGE_SIZE - 1);
+	if (nr_bytes)
+		nr_pages++;
+
+	rcu_read_lock();
+	do {
+		memcg = obj_cgroup_memcg(objcg);
+	} while (!css_tryget(&memcg->css));
+	rcu_read_unlock();
+
+	ret = __memcg_kmem_charge(memcg, gfp, nr_pages);
+	if (!ret) {
+		/*
+		 * The charge follows the obj_cgroup to the parent and is
+		 * given back from there, it must not pin this memcg.
+		 */
+		if (!mem_cgroup_is_root(memcg))
+			css_put_many(&memcg->css, nr_pages);
+		if (nr_bytes)
+			refill_obj_stock(objcg, PAGE_SIZE - nr_bytes);
+	}
+	css_put(&memcg->css);
+
+	return ret;
+}
+
+/**
+ * memcg_kmem_uncharge_obj: uncharge slab objects
+ * @objcg: obj_cgroup the objects were charged to
+ * @size: size of the objects in bytes
+ */
+void memcg_kmem_uncharge_obj(struct obj_cgroup *objcg, size_t size)
+{
+	refill_obj_stock(objcg, size);
+}
+
+/**
+ * mem_cgroup_from_obj: return the memory cgroup a kernel object is charged to
+ * @p: the object
+ *
+ * For slab objects the memcg changes when it is reparented, the caller
+ * must hold rcu_read_lock() or a spinlock.
+ */
+struct mem_cgroup *mem_cgroup_from_obj(void *p)
+{
+	struct page *page = virt_to_head_page(p);
+#ifdef CONFIG_SLUB
+	struct obj_cgroup **vec = page_objcg_vec(page);
+
+	if (vec) {
+		struct obj_cgroup *objcg;
+
+		objcg = READ_ONCE(vec[obj_to_index(page->slab_cache, page, p)]);
+		return objcg ? obj_cgroup_memcg(objcg) : NULL;
+	}
+#endif
+	return page->mem_cgroup;
 }
 #endif /* CONFIG_MEMCG_KMEM */
 
@@ -2931,50 +3442,15 @@ static int mem_cgroup_hierarchy_write(struct cgroup_subsys_state *css,
 	return retval;
 }
 
-struct accumulated_stats {
-	unsigned long stat[MEMCG_NR_STAT];
-	unsigned long events[NR_VM_EVENT_ITEMS];
-	unsigned long lru_pages[NR_LRU_LISTS];
-	const unsigned int *stats_array;
-	const unsigned int *events_array;
-	int stats_size;
-	int events_size;
-};
-
-static void accumulate_memcg_tree(struct mem_cgroup *memcg,
-				  struct accumulated_stats *acc)
-{
-	struct mem_cgroup *mi;
-	int i;
-
-	for_each_mem_cgroup_tree(mi, memcg) {
-		for (i = 0; i < acc->stats_size; i++)
-			acc->stat[i] += memcg_page_state(mi,
-				acc->stats_array ? acc->stats_array[i] : i);
-
-		for (i = 0; i < acc->events_size; i++)
-			acc->events[i] += memcg_sum_events(mi,
-				acc->events_array ? acc->events_array[i] : i);
-
-		for (i = 0; i < NR_LRU_LISTS; i++)
-			acc->lru_pages[i] +=
-				mem_cgroup_nr_lru_pages(mi, BIT(i));
-	}
-}
-
 static unsigned long mem_cgroup_usage(struct mem_cgroup *memcg, bool swap)
 {
 	unsigned long val = 0;
 
 	if (mem_cgroup_is_root(memcg)) {
-		struct mem_cgroup *iter;
-
-		for_each_mem_cgroup_tree(iter, memcg) {
-			val += memcg_page_state(iter, MEMCG_CACHE);
-			val += memcg_page_state(iter, MEMCG_RSS);
-			if (swap)
-				val += memcg_page_state(iter, MEMCG_SWAP);
-		}
+		val += memcg_page_state(memcg, MEMCG_CACHE);
+		val += memcg_page_state(memcg, MEMCG_RSS);
+		if (swap)
+			val += memcg_page_state(memcg, MEMCG_SWAP);
 	} else {
 		if (!swap)
 			val = page_counter_read(&memcg->memory);
@@ -3038,6 +3514,7 @@ static u64 mem_cgroup_read_u64(struct cgroup_subsys_state *css,
 #ifdef CONFIG_MEMCG_KMEM
 static int memcg_online_kmem(struct mem_cgroup *memcg)
 {
+	struct obj_cgroup *objcg;
 	int memcg_id;
 
 	if (cgroup_memory_nokmem)
@@ -3050,6 +3527,14 @@ static int memcg_online_kmem(struct mem_cgroup *memcg)
 	if (memcg_id < 0)
 		return memcg_id;
 
+	objcg = obj_cgroup_alloc(memcg);
+	if (!objcg) {
+		memcg_free_cache_id(memcg_id);
+		return -ENOMEM;
+	}
+	rcu_assign_pointer(memcg->objcg, objcg);
+	INIT_LIST_HEAD(&memcg->objcg_list);
+
 	static_branch_inc(&memcg_kmem_enabled_key);
 	/*
 	 * A memory cgroup is considered kmem-online as soon as it gets
@@ -3107,6 +3592,7 @@ static void memcg_offline_kmem(struct mem_cgroup *memcg)
 	}
 	rcu_read_unlock();
 
+	memcg_reparent_objcgs(memcg, parent);
 	memcg_drain_all_list_lrus(kmemcg_id, parent);
 
 	memcg_free_cache_id(kmemcg_id);
@@ -3121,7 +3607,10 @@ static void memcg_free_kmem(struct mem_cgroup *memcg)
 	if (memcg->kmem_state == KMEM_ALLOCATED) {
 		memcg_destroy_kmem_caches(memcg);
 		static_branch_dec(&memcg_kmem_enabled_key);
-		WARN_ON(page_counter_read(&memcg->kmem));
+		WARN_ON(!list_empty(&memcg->objcg_list));
+		/* slab object charges moved to the parent stay in the counter */
+		WARN_ON(!IS_ENABLED(CONFIG_SLUB) &&
+			page_counter_read(&memcg->kmem));
 	}
 }
 #else
@@ -3369,7 +3858,6 @@ static int memcg_stat_show(struct seq_file *m, void *v)
 	unsigned long memory, memsw;
 	struct mem_cgroup *mi;
 	unsigned int i;
-	struct accumulated_stats acc;
 
 	BUILD_BUG_ON(ARRAY_SIZE(memcg1_stat_names) != ARRAY_SIZE(memcg1_stats));
 	BUILD_BUG_ON(ARRAY_SIZE(mem_cgroup_lru_names) != NR_LRU_LISTS);
@@ -3378,13 +3866,13 @@ static int memcg_stat_show(struct seq_file *m, void *v)
 		if (memcg1_stats[i] == MEMCG_SWAP && !do_memsw_account())
 			continue;
 		seq_printf(m, "%s %lu\n", memcg1_stat_names[i],
-			   memcg_page_state(memcg, memcg1_stats[i]) *
+			   memcg_page_state_local(memcg, memcg1_stats[i]) *
 			   PAGE_SIZE);
 	}
 
 	for (i = 0; i < ARRAY_SIZE(memcg1_events); i++)
 		seq_printf(m, "%s %lu\n", memcg1_event_names[i],
-			   memcg_sum_events(memcg, memcg1_events[i]));
+			   memcg_events_local(memcg, memcg1_events[i]));
 
 	for (i = 0; i < NR_LRU_LISTS; i++)
 		seq_printf(m, "%s %lu\n", mem_cgroup_lru_names[i],
@@ -3402,27 +3890,22 @@ static int memcg_stat_show(struct seq_file *m, void *v)
 		seq_printf(m, "hierarchical_memsw_limit %llu\n",
 			   (u64)memsw * PAGE_SIZE);
 
-	memset(&acc, 0, sizeof(acc));
-	acc.stats_size = ARRAY_SIZE(memcg1_stats);
-	acc.stats_array = memcg1_stats;
-	acc.events_size = ARRAY_SIZE(memcg1_events);
-	acc.events_array = memcg1_events;
-	accumulate_memcg_tree(memcg, &acc);
-
 	for (i = 0; i < ARRAY_SIZE(memcg1_stats); i++) {
 		if (memcg1_stats[i] == MEMCG_SWAP && !do_memsw_account())
 			continue;
 		seq_printf(m, "total_%s %llu\n", memcg1_stat_names[i],
-			   (u64)acc.stat[i] * PAGE_SIZE);
+			   (u64)memcg_page_state(memcg, memcg1_stats[i]) *
+			   PAGE_SIZE);
 	}
 
 	for (i = 0; i < ARRAY_SIZE(memcg1_events); i++)
 		seq_printf(m, "total_%s %llu\n", memcg1_event_names[i],
-			   (u64)acc.events[i]);
+			   (u64)memcg_sum_events(memcg, memcg1_events[i]));
 
 	for (i = 0; i < NR_LRU_LISTS; i++)
 		seq_printf(m, "total_%s %llu\n", mem_cgroup_lru_names[i],
-			   (u64)acc.lru_pages[i] * PAGE_SIZE);
+			   (u64)memcg_page_state(memcg, NR_LRU_BASE + i) *
+			   PAGE_SIZE);
 
 #ifdef CONFIG_DEBUG_VM
 	{
@@ -4388,9 +4871,44 @@ static void __mem_cgroup_free(struct mem_cgroup *memcg)
 	kfree(memcg);
 }
 
+/*
+ * The per-cpu batches of a dying memcg were never propagated, so hand
+ * them to the hierarchical counters of its ancestors before they go.
+ */
+static void memcg_flush_percpu_vmstats(struct mem_cgroup *memcg)
+{
+	struct mem_cgroup *mi;
+	int cpu, i;
+
+	for (i = 0; i < MEMCG_NR_STAT; i++) {
+		long x = 0;
+
+		for_each_possible_cpu(cpu)
+			x += per_cpu(memcg->stat_cpu->count[i], cpu);
+		if (!x)
+			continue;
+		for (mi = memcg_stat_parent(memcg); mi;
+		     mi = memcg_stat_parent(mi))
+			atomic_long_add(x, &mi->stat[i]);
+	}
+
+	for (i = 0; i < NR_VM_EVENT_ITEMS; i++) {
+		unsigned long x = 0;
+
+		for_each_possible_cpu(cpu)
+			x += per_cpu(memcg->stat_cpu->events[i], cpu);
+		if (!x)
+			continue;
+		for (mi = memcg_stat_parent(memcg); mi;
+		     mi = memcg_stat_parent(mi))
+			atomic_long_add(x, &mi->events[i]);
+	}
+}
+
 static void mem_cgroup_free(struct mem_cgroup *memcg)
 {
 	memcg_wb_domain_exit(memcg);
+	memcg_flush_percpu_vmstats(memcg);
 	__mem_cgroup_free(memcg);
 }
 
@@ -4425,6 +4943,7 @@ static struct mem_cgroup *mem_cgroup_alloc(void)
 		goto fail;
 
 	INIT_WORK(&memcg->high_work, high_work_func);
+	INIT_WORK(&memcg->high_async_work, high_async_work_func);
 	memcg->last_scanned_node = MAX_NUMNODES;
 	INIT_LIST_HEAD(&memcg->oom_notify);
 	mutex_init(&memcg->thresholds_lock);
@@ -4459,6 +4978,7 @@ mem_cgroup_css_alloc(struct cgroup_subsys_state *parent_css)
 		return ERR_PTR(error);
 
 	memcg->high = PAGE_COUNTER_MAX;
+	memcg->high_async = PAGE_COUNTER_MAX;
 	memcg->soft_limit = PAGE_COUNTER_MAX;
 	if (parent) {
 		memcg->swappiness = mem_cgroup_swappiness(parent);
@@ -4549,7 +5069,14 @@ static void mem_cgroup_css_offline(struct cgroup_subsys_state *css)
 	memcg_offline_kmem(memcg);
 	wb_memcg_offline(memcg);
 
-	drain_all_stock(memcg);
+	/*
+	 * Unlike drain_all_stock(), don't skip the drain if another one is
+	 * running: that one may not cover this memcg, whose stocked charges
+	 * would then pin it until their slots are evicted.
+	 */
+	mutex_lock(&percpu_charge_mutex);
+	__drain_all_stock(memcg);
+	mutex_unlock(&percpu_charge_mutex);
 
 	mem_cgroup_id_put(memcg);
 }
@@ -4573,6 +5100,7 @@ static void mem_cgroup_css_free(struct cgroup_subsys_state *css)
 
 	vmpressure_cleanup(&memcg->vmpressure);
 	cancel_work_sync(&memcg->high_work);
+	cancel_work_sync(&memcg->high_async_work);
 	mem_cgroup_remove_from_trees(memcg);
 	memcg_free_shrinker_maps(memcg);
 	memcg_free_kmem(memcg);
@@ -4604,6 +5132,8 @@ static void mem_cgroup_css_reset(struct cgroup_subsys_state *css)
 	page_counter_set_min(&memcg->memory, 0);
 	page_counter_set_low(&memcg->memory, 0);
 	memcg->high = PAGE_COUNTER_MAX;
+	memcg->high_async_ratio = 0;
+	memcg_update_high_async(memcg);
 	memcg->soft_limit = PAGE_COUNTER_MAX;
 	memcg_wb_domain_size_changed(memcg);
 }
@@ -5426,6 +5956,7 @@ static ssize_t memory_high_write(struct kernfs_open_file *of,
 		return err;
 
 	memcg->high = high;
+	memcg_update_high_async(memcg);
 
 	nr_pages = page_counter_read(&memcg->memory);
 	if (nr_pages > high)
@@ -5436,6 +5967,38 @@ static ssize_t memory_high_write(struct kernfs_open_file *of,
 	return nbytes;
 }
 
+static int memory_high_async_ratio_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(seq_css(m));
+
+	seq_printf(m, "%u\n", READ_ONCE(memcg->high_async_ratio));
+
+	return 0;
+}
+
+static ssize_t memory_high_async_ratio_write(struct kernfs_open_file *of,
+					     char *buf, size_t nbytes,
+					     loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned int ratio;
+	int err;
+
+	buf = strstrip(buf);
+	err = kstrtouint(buf, 0, &ratio);
+	if (err)
+		return err;
+
+	if (ratio > 100)
+		return -EINVAL;
+
+	WRITE_ONCE(memcg->high_async_ratio, ratio);
+	memcg_update_high_async(memcg);
+	memcg_check_high_async(memcg);
+
+	return nbytes;
+}
+
 static int memory_max_show(struct seq_file *m, void *v)
 {
 	struct mem_cgroup *memcg = mem_cgroup_from_css(seq_css(m));
@@ -5519,7 +6082,6 @@ static int memory_events_show(struct seq_file *m, void *v)
 static int memory_stat_show(struct seq_file *m, void *v)
 {
 	struct mem_cgroup *memcg = mem_cgroup_from_css(seq_css(m));
-	struct accumulated_stats acc;
 	int i;
 
 	/*
@@ -5533,62 +6095,65 @@ static int memory_stat_show(struct seq_file *m, void *v)
 	 * Current memory state:
 	 */
 
-	memset(&acc, 0, sizeof(acc));
-	acc.stats_size = MEMCG_NR_STAT;
-	acc.events_size = NR_VM_EVENT_ITEMS;
-	accumulate_memcg_tree(memcg, &acc);
-
 	seq_printf(m, "anon %llu\n",
-		   (u64)acc.stat[MEMCG_RSS] * PAGE_SIZE);
+		   (u64)memcg_page_state(memcg, MEMCG_RSS) * PAGE_SIZE);
 	seq_printf(m, "file %llu\n",
-		   (u64)acc.stat[MEMCG_CACHE] * PAGE_SIZE);
+		   (u64)memcg_page_state(memcg, MEMCG_CACHE) * PAGE_SIZE);
 	seq_printf(m, "kernel_stack %llu\n",
-		   (u64)acc.stat[MEMCG_KERNEL_STACK_KB] * 1024);
+		   (u64)memcg_page_state(memcg, MEMCG_KERNEL_STACK_KB) * 1024);
 	seq_printf(m, "slab %llu\n",
-		   (u64)(acc.stat[NR_SLAB_RECLAIMABLE] +
-			 acc.stat[NR_SLAB_UNRECLAIMABLE]) * PAGE_SIZE);
+		   (u64)(memcg_page_state(memcg, NR_SLAB_RECLAIMABLE) +
+			 memcg_page_state(memcg, NR_SLAB_UNRECLAIMABLE)) *
+		   PAGE_SIZE);
 	seq_printf(m, "sock %llu\n",
-		   (u64)acc.stat[MEMCG_SOCK] * PAGE_SIZE);
+		   (u64)memcg_page_state(memcg, MEMCG_SOCK) * PAGE_SIZE);
 
 	seq_printf(m, "shmem %llu\n",
-		   (u64)acc.stat[NR_SHMEM] * PAGE_SIZE);
+		   (u64)memcg_page_state(memcg, NR_SHMEM) * PAGE_SIZE);
 	seq_printf(m, "file_mapped %llu\n",
-		   (u64)acc.stat[NR_FILE_MAPPED] * PAGE_SIZE);
+		   (u64)memcg_page_state(memcg, NR_FILE_MAPPED) * PAGE_SIZE);
 	seq_printf(m, "file_dirty %llu\n",
-		   (u64)acc.stat[NR_FILE_DIRTY] * PAGE_SIZE);
+		   (u64)memcg_page_state(memcg, NR_FILE_DIRTY) * PAGE_SIZE);
 	seq_printf(m, "file_writeback %llu\n",
-		   (u64)acc.stat[NR_WRITEBACK] * PAGE_SIZE);
+		   (u64)memcg_page_state(memcg, NR_WRITEBACK) * PAGE_SIZE);
 
 	for (i = 0; i < NR_LRU_LISTS; i++)
 		seq_printf(m, "%s %llu\n", mem_cgroup_lru_names[i],
-			   (u64)acc.lru_pages[i] * PAGE_SIZE);
+			   (u64)memcg_page_state(memcg, NR_LRU_BASE + i) *
+			   PAGE_SIZE);
 
 	seq_printf(m, "slab_reclaimable %llu\n",
-		   (u64)acc.stat[NR_SLAB_RECLAIMABLE] * PAGE_SIZE);
+		   (u64)memcg_page_state(memcg, NR_SLAB_RECLAIMABLE) *
+		   PAGE_SIZE);
 	seq_printf(m, "slab_unreclaimable %llu\n",
-		   (u64)acc.stat[NR_SLAB_UNRECLAIMABLE] * PAGE_SIZE);
+		   (u64)memcg_page_state(memcg, NR_SLAB_UNRECLAIMABLE) *
+		   PAGE_SIZE);
 
 	/* Accumulated memory events */
 
-	seq_printf(m, "pgfault %lu\n", acc.events[PGFAULT]);
-	seq_printf(m, "pgmajfault %lu\n", acc.events[PGMAJFAULT]);
+	seq_printf(m, "pgfault %lu\n", memcg_sum_events(memcg, PGFAULT));
+	seq_printf(m, "pgmajfault %lu\n",
+		   memcg_sum_events(memcg, PGMAJFAULT));
 
 	seq_printf(m, "workingset_refault %lu\n",
-		   acc.stat[WORKINGSET_REFAULT]);
+		   memcg_page_state(memcg, WORKINGSET_REFAULT));
 	seq_printf(m, "workingset_activate %lu\n",
-		   acc.stat[WORKINGSET_ACTIVATE]);
+		   memcg_page_state(memcg, WORKINGSET_ACTIVATE));
 	seq_printf(m, "workingset_nodereclaim %lu\n",
-		   acc.stat[WORKINGSET_NODERECLAIM]);
-
-	seq_printf(m, "pgrefill %lu\n", acc.events[PGREFILL]);
-	seq_printf(m, "pgscan %lu\n", acc.events[PGSCAN_KSWAPD] +
-		   acc.events[PGSCAN_DIRECT]);
-	seq_printf(m, "pgsteal %lu\n", acc.events[PGSTEAL_KSWAPD] +
-		   acc.events[PGSTEAL_DIRECT]);
-	seq_printf(m, "pgactivate %lu\n", acc.events[PGACTIVATE]);
-	seq_printf(m, "pgdeactivate %lu\n", acc.events[PGDEACTIVATE]);
-	seq_printf(m, "pglazyfree %lu\n", acc.events[PGLAZYFREE]);
-	seq_printf(m, "pglazyfreed %lu\n", acc.events[PGLAZYFREED]);
+		   memcg_page_state(memcg, WORKINGSET_NODERECLAIM));
+
+	seq_printf(m, "pgrefill %lu\n", memcg_sum_events(memcg, PGREFILL));
+	seq_printf(m, "pgscan %lu\n",
+		   memcg_sum_events(memcg, PGSCAN_KSWAPD) +
+		   memcg_sum_events(memcg, PGSCAN_DIRECT));
+	seq_printf(m, "pgsteal %lu\n",
+		   memcg_sum_events(memcg, PGSTEAL_KSWAPD) +
+		   memcg_sum_events(memcg, PGSTEAL_DIRECT));
+	seq_printf(m, "pgactivate %lu\n", memcg_sum_events(memcg, PGACTIVATE));
+	seq_printf(m, "pgdeactivate %lu\n",
+		   memcg_sum_events(memcg, PGDEACTIVATE));
+	seq_printf(m, "pglazyfree %lu\n", memcg_sum_events(memcg, PGLAZYFREE));
+	seq_printf(m, "pglazyfreed %lu\n", memcg_sum_events(memcg, PGLAZYFREED));
 
 	return 0;
 }
@@ -5648,6 +6213,12 @@ static struct cftype memory_files[] = {
 		.seq_show = memory_high_show,
 		.write = memory_high_write,
 	},
+	{
+		.name = "high.async_ratio",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = memory_high_async_ratio_show,
+		.write = memory_high_async_ratio_write,
+	},
 	{
 		.name = "max",
 		.flags = CFTYPE_NOT_ON_ROOT,
@@ -6329,6 +6900,11 @@ static int __init mem_cgroup_init(void)
 	BUG_ON(!memcg_kmem_cache_wq);
 #endif
 
+	memcg_high_async_wq = alloc_workqueue("memcg_high_async",
+					      WQ_UNBOUND | WQ_FREEZABLE |
+					      WQ_MEM_RECLAIM, 0);
+	BUG_ON(!memcg_high_async_wq);
+
 	cpuhp_setup_state_nocalls(CPUHP_MM_MEMCQ_DEAD, "mm/memctrl:dead", NULL,
 				  memcg_hotplug_cpu_dead);
 
@@ -69,6 +69,7 @@
 #include <linux/userfaultfd_k.h>
 #include <linux/dax.h>
 #include <linux/oom.h>
+#include <linux/padata.h>
 
 #include <asm/io.h>
 #include <asm/mmu_context.h>
@@ -736,6 +737,8 @@ copy_one_pte(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 				pte = swp_entry_to_pte(entry);
 				if (pte_swp_soft_dirty(*src_pte))
 					pte = pte_swp_mksoft_dirty(pte);
+				if (pte_swp_uffd_wp(*src_pte))
+					pte = pte_swp_mkuffd_wp(pte);
 				set_pte_at(src_mm, addr, src_pte, pte);
 			}
 		} else if (is_device_private_entry(entry)) {
@@ -2482,6 +2485,11 @@ static vm_fault_t do_wp_page(struct vm_fault *vmf)
 {
 	struct vm_area_struct *vma = vmf->vma;
 
+	if (userfaultfd_pte_wp(vma, *vmf->pte)) {
+		pte_unmap_unlock(vmf->pte, vmf->ptl);
+		return handle_userfault(vmf, VM_UFFD_WP);
+	}
+
 	vmf->page = vm_normal_page(vma, vmf->address, vmf->orig_pte);
 	if (!vmf->page) {
 		/*
@@ -2799,7 +2807,9 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 	inc_mm_counter_fast(vma->vm_mm, MM_ANONPAGES);
 	dec_mm_counter_fast(vma->vm_mm, MM_SWAPENTS);
 	pte = mk_pte(page, vma->vm_page_prot);
-	if ((vmf->flags & FAULT_FLAG_WRITE) && reuse_swap_page(page, NULL)) {
+	/* a write to a userfaultfd protected page is for do_wp_page() */
+	if ((vmf->flags & FAULT_FLAG_WRITE) &&
+	    !pte_swp_uffd_wp(vmf->orig_pte) && reuse_swap_page(page, NULL)) {
 		pte = maybe_mkwrite(pte_mkdirty(pte), vma);
 		vmf->flags &= ~FAULT_FLAG_WRITE;
 		ret |= VM_FAULT_WRITE;
@@ -2808,6 +2818,8 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 	flush_icache_page(vma, page);
 	if (pte_swp_soft_dirty(vmf->orig_pte))
 		pte = pte_mksoft_dirty(pte);
+	if (pte_swp_uffd_wp(vmf->orig_pte))
+		pte = pte_mkuffd_wp(pte);
 	set_pte_at(vma->vm_mm, vmf->address, vmf->pte, pte);
 	arch_do_swap_page(vma->vm_mm, vma, vmf->address, pte, vmf->orig_pte);
 	vmf->orig_pte = pte;
@@ -4451,6 +4463,47 @@ void clear_huge_page(struct page *page,
 	process_huge_page(addr_hint, pages_per_huge_page, clear_subpage, page);
 }
 
+static void clear_huge_page_chunk(unsigned long start, unsigned long end,
+				  void *data)
+{
+	struct page *page = data;
+	struct page *p = nth_page(page, start);
+	unsigned long i;
+
+	for (i = start; i < end; i++, p = mem_map_next(p, page, i)) {
+		cond_resched();
+		clear_highpage_nocache(p);
+	}
+}
+
+/*
+ * Clear a huge page that is being preallocated rather than faulted in:
+ * nobody is waiting for its cache lines, so use non-temporal stores, and
+ * split the work in ranges of MAX_ORDER_NR_PAGES subpages over as many
+ * threads as the node of the page has CPUs.  The fault path does not do
+ * this, as the helper threads would not be bound by the faulting task's
+ * cpuset and CPU controller limits.
+ */
+void clear_huge_page_nocache(struct page *page,
+			     unsigned int pages_per_huge_page)
+{
+	int nid = page_to_nid(page);
+	int nr_cpus = cpumask_weight(cpumask_of_node(nid));
+	struct padata_mt_job job = {
+		.thread_fn	= clear_huge_page_chunk,
+		.fn_arg		= page,
+		.start		= 0,
+		.size		= pages_per_huge_page,
+		.align		= MAX_ORDER_NR_PAGES,
+		.min_chunk	= MAX_ORDER_NR_PAGES,
+		.max_threads	= max(nr_cpus, 1),
+		.nid		= nid,
+	};
+
+	might_sleep();
+	padata_do_multithreaded(&job);
+}
+
 static void copy_user_gigantic_page(struct page *dst, struct page *src,
 				    unsigned long addr,
 				    struct vm_area_struct *vma,
@@ -66,6 +66,7 @@
 #include <linux/lockdep.h>
 #include <linux/nmi.h>
 #include <linux/psi.h>
+#include <linux/padata.h>
 
 #include <asm/sections.h>
 #include <asm/tlbflush.h>
@@ -1538,18 +1539,35 @@ static unsigned long  __init deferred_init_pages(int nid, int zid,
 	return (nr_pages);
 }
 
+struct deferred_init_args {
+	int nid;
+	int zid;
+	atomic_long_t nr_pages;
+};
+
+static void __init deferred_init_pages_chunk(unsigned long start_pfn,
+					     unsigned long end_pfn, void *arg)
+{
+	struct deferred_init_args *args = arg;
+	unsigned long nr_pages;
+
+	nr_pages = deferred_init_pages(args->nid, args->zid, start_pfn, end_pfn);
+	atomic_long_add(nr_pages, &args->nr_pages);
+}
+
 /* Initialise remaining memory on a node */
 static int __init deferred_init_memmap(void *data)
 {
 	pg_data_t *pgdat = data;
 	int nid = pgdat->node_id;
 	unsigned long start = jiffies;
-	unsigned long nr_pages = 0;
+	struct deferred_init_args args = { .nid = nid };
 	unsigned long spfn, epfn, first_init_pfn, flags;
 	phys_addr_t spa, epa;
 	int zid;
 	struct zone *zone;
 	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	int max_threads = max_t(int, cpumask_weight(cpumask), 1);
 	u64 i;
 
 	/* Bind memory initialisation thread to a local node if possible */
@@ -1569,6 +1587,13 @@ static int __init deferred_init_memmap(void *data)
 	BUG_ON(pgdat->first_deferred_pfn > pgdat_end_pfn(pgdat));
 	pgdat->first_deferred_pfn = ULONG_MAX;
 
+	/*
+	 * Once we unlock here, deferred_grow_zone() finds nothing left to
+	 * grow, so the rest may run with interrupts enabled and on several
+	 * threads.
+	 */
+	pgdat_resize_unlock(pgdat, &flags);
+
 	/* Only the highest zone is deferred so find it */
 	for (zid = 0; zid < MAX_NR_ZONES; zid++) {
 		zone = pgdat->node_zones + zid;
@@ -1576,30 +1601,47 @@ static int __init deferred_init_memmap(void *data)
 			break;
 	}
 	first_init_pfn = max(zone->zone_start_pfn, first_init_pfn);
+	args.zid = zid;
 
 	/*
 	 * Initialize and free pages. We do it in two loops: first we initialize
 	 * struct page, than free to buddy allocator, because while we are
 	 * freeing pages we can access pages that are ahead (computing buddy
-	 * page in __free_one_page()).
+	 * page in __free_one_page()). Struct pages are independent of each
+	 * other, so the first loop is split across the cpus of the node.
 	 */
 	for_each_free_mem_range(i, nid, MEMBLOCK_NONE, &spa, &epa, NULL) {
+		struct padata_mt_job job = {
+			.thread_fn   = deferred_init_pages_chunk,
+			.fn_arg      = &args,
+			.align       = PAGES_PER_SECTION,
+			.min_chunk   = PAGES_PER_SECTION,
+			.max_threads = max_threads,
+			.nid         = nid,
+		};
+
 		spfn = max_t(unsigned long, first_init_pfn, PFN_UP(spa));
 		epfn = min_t(unsigned long, zone_end_pfn(zone), PFN_DOWN(epa));
-		nr_pages += deferred_init_pages(nid, zid, spfn, epfn);
+		if (spfn >= epfn)
+			continue;
+
+		job.start = spfn;
+		job.size = epfn - spfn;
+		padata_do_multithreaded(&job);
 	}
 	for_each_free_mem_range(i, nid, MEMBLOCK_NONE, &spa, &epa, NULL) {
 		spfn = max_t(unsigned long, first_init_pfn, PFN_UP(spa));
 		epfn = min_t(unsigned long, zone_end_pfn(zone), PFN_DOWN(epa));
 		deferred_free_pages(nid, zid, spfn, epfn);
+		cond_resched();
 	}
-	pgdat_resize_unlock(pgdat, &flags);
 
 	/* Sanity check that the next zone really is unpopulated */
 	WARN_ON(++zid < MAX_NR_ZONES && populated_zone(++zone));
 
-	pr_info("node %d initialised, %lu pages in %ums\n", nid, nr_pages,
-					jiffies_to_msecs(jiffies - start));
+	pr_info("node %d initialised, %lu pages in %ums\n", nid,
+		atomic_long_read(&args.nr_pages),
+		jiffies_to_msecs(jiffies - start));
 
 	pgdat_init_report_one_done();
 	return 0;
@@ -4369,6 +4411,21 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order, int preferred_nid,
 
 	finalise_ac(gfp_mask, &ac);
 
+	/* Zeroed user pages may already be waiting in the pool */
+	if (prezero_wants(gfp_mask, order) && ac.preferred_zoneref->zone) {
+		struct zone *zone = ac.preferred_zoneref->zone;
+		int nid = zone_to_nid(zone);
+
+		/* same cpuset check as get_page_from_freelist() */
+		if ((!ac.nodemask || node_isset(nid, *ac.nodemask)) &&
+		    (!cpusets_enabled() || !(alloc_flags & ALLOC_CPUSET) ||
+		     __cpuset_zone_allowed(zone, gfp_mask))) {
+			page = prezero_alloc_page(nid);
+			if (page)
+				goto out;
+		}
+	}
+
 	/* First allocation attempt */
 	page = get_page_from_freelist(alloc_mask, order, alloc_flags, &ac);
 	if (likely(page))
@@ -4405,6 +4462,150 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order, int preferred_nid,
 }
 EXPORT_SYMBOL(__alloc_pages_nodemask);
 
+/*
+ * __alloc_pages_bulk - Allocate a number of order-0 pages to a list or array
+ * @gfp_mask: GFP flags for the allocation
+ * @preferred_nid: The preferred NUMA node ID to allocate from
+ * @nodemask: Set of nodes to allocate from, may be NULL
+ * @nr_pages: The number of pages desired on the list or array
+ * @page_list: Optional list to store the allocated pages
+ * @page_array: Optional array to store the pages
+ *
+ * This is a batched version of the page allocator that takes up to
+ * @nr_pages pages from the per-cpu lists of a single zone, with interrupts
+ * disabled once for the whole batch. Pages are added to @page_list if it is
+ * not NULL, otherwise only the NULL elements of @page_array are populated.
+ *
+ * If the fast path cannot be used (no local zone above the low watermark,
+ * a single page wanted, accounted allocations), this falls back to a single
+ * regular allocation, which may enter reclaim as allowed by @gfp_mask.
+ *
+ * Returns the number of pages on the list or array.
+ */
+unsigned long __alloc_pages_bulk(gfp_t gfp_mask, int preferred_nid,
+				 nodemask_t *nodemask, int nr_pages,
+				 struct list_head *page_list,
+				 struct page **page_array)
+{
+	unsigned int alloc_flags = ALLOC_WMARK_LOW;
+	struct alloc_context ac = { };
+	struct per_cpu_pages *pcp;
+	struct list_head *pcp_list;
+	struct zone *zone;
+	struct zoneref *z;
+	struct page *page;
+	unsigned long flags;
+	gfp_t alloc_mask;
+	int nr_populated = 0;
+	int nr_account = 0;
+
+	if (unlikely(nr_pages <= 0))
+		return 0;
+
+	/* Skip populated array elements before disabling interrupts */
+	while (page_array && nr_populated < nr_pages &&
+	       page_array[nr_populated])
+		nr_populated++;
+
+	if (unlikely(nr_populated == nr_pages))
+		return nr_populated;
+
+	/* Use the single page allocator for one page */
+	if (nr_pages - nr_populated == 1)
+		goto failed;
+
+	/* Accounting is done page by page in the regular path */
+	if (memcg_kmem_enabled() && (gfp_mask & __GFP_ACCOUNT))
+		goto failed;
+
+	gfp_mask &= gfp_allowed_mask;
+	alloc_mask = gfp_mask;
+	if (!prepare_alloc_pages(gfp_mask, 0, preferred_nid, nodemask, &ac,
+				 &alloc_mask, &alloc_flags))
+		return nr_populated;
+
+	finalise_ac(gfp_mask, &ac);
+	if (ac.spread_dirty_pages)
+		goto failed;
+
+	/* Find an allowed local zone that meets the low watermark */
+	for_each_zone_zonelist_nodemask(zone, z, ac.zonelist, ac.high_zoneidx,
+					ac.nodemask) {
+		unsigned long mark;
+
+		if (cpusets_enabled() && (alloc_flags & ALLOC_CPUSET) &&
+		    !__cpuset_zone_allowed(zone, alloc_mask))
+			continue;
+
+		if (nr_online_nodes > 1 && zone != ac.preferred_zoneref->zone &&
+		    zone_to_nid(zone) != zone_to_nid(ac.preferred_zoneref->zone))
+			goto failed;
+
+		mark = zone->watermark[alloc_flags & ALLOC_WMARK_MASK] + nr_pages;
+		if (zone_watermark_fast(zone, 0, mark, ac_classzone_idx(&ac),
+					alloc_flags))
+			break;
+	}
+
+	/*
+	 * If no allowed local zone meets the watermark, try a single page
+	 * and let the regular path reclaim if necessary.
+	 */
+	if (unlikely(!zone))
+		goto failed;
+
+	/* Attempt the batch allocation */
+	local_irq_save(flags);
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	pcp_list = &pcp->lists[ac.migratetype];
+
+	while (nr_populated < nr_pages) {
+		/* Skip existing pages */
+		if (page_array && page_array[nr_populated]) {
+			nr_populated++;
+			continue;
+		}
+
+		page = __rmqueue_pcplist(zone, ac.migratetype, pcp, pcp_list);
+		if (unlikely(!page)) {
+			/* Try and get at least one page */
+			if (!nr_account)
+				goto failed_irq;
+			break;
+		}
+		nr_account++;
+		zone_statistics(ac.preferred_zoneref->zone, zone);
+
+		prep_new_page(page, 0, alloc_mask, alloc_flags);
+		if (page_list)
+			list_add(&page->lru, page_list);
+		else
+			page_array[nr_populated] = page;
+		nr_populated++;
+	}
+
+	__count_zid_vm_events(PGALLOC, zone_idx(zone), nr_account);
+	local_irq_restore(flags);
+
+	return nr_populated;
+
+failed_irq:
+	local_irq_restore(flags);
+
+failed:
+	page = __alloc_pages_nodemask(gfp_mask, 0, preferred_nid, nodemask);
+	if (page) {
+		if (page_list)
+			list_add(&page->lru, page_list);
+		else
+			page_array[nr_populated] = page;
+		nr_populated++;
+	}
+
+	return nr_populated;
+}
+EXPORT_SYMBOL_GPL(__alloc_pages_bulk);
+
 /*
  * Common helper functions. Never use with __GFP_HIGHMEM because the returned
  * address cannot represent highmem pages. Use alloc_pages and then kmap if
@@ -7906,7 +8107,7 @@ static int __alloc_contig_migrate_range(struct compact_control *cc,
 		cc->nr_migratepages -= nr_reclaimed;
 
 		ret = migrate_pages(&cc->migratepages, alloc_migrate_target,
-				    NULL, 0, cc->mode, MR_CONTIG_RANGE);
+				    NULL, 0, cc->mode, MR_CONTIG_RANGE, NULL);
 	}
 	if (ret < 0) {
 		putback_movable_pages(&cc->migratepages);
@@ -250,7 +250,14 @@ int swap_writepage(struct page *page, struct writeback_control *wbc)
 		unlock_page(page);
 		goto out;
 	}
-	if (frontswap_store(page) == 0) {
+	ret = frontswap_store(page);
+	if (ret == FRONTSWAP_STORE_ASYNC) {
+		/* writeback is ended by the frontswap backend */
+		unlock_page(page);
+		ret = 0;
+		goto out;
+	}
+	if (ret == 0) {
 		set_page_writeback(page);
 		unlock_page(page);
 		end_page_writeback(page);
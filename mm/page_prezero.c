@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Pool of pre-zeroed pages
+ *
+ * A low priority kthread per node allocates pages while the node has
+ * plenty of free memory, clears them and keeps them on a per-node list.
+ * Order-0 __GFP_ZERO allocations of user memory take a page from the
+ * pool instead of clearing one on the fault path, so the cost of
+ * zeroing moves to otherwise idle CPUs.
+ *
+ * The pages stay allocated while they sit in the pool: a zeroed flag on
+ * free buddy pages would be lost on every merge. They are given back
+ * through a shrinker under memory pressure and when vm.prezero_pages is
+ * set to 0.
+ *
+ * Sitting in the pool, the pages are neither on the LRU nor migratable,
+ * so they are not allocated as movable: in CMA areas, ZONE_MOVABLE or
+ * movable pageblocks they would make cma_alloc(), memory offlining and
+ * compaction fail.
+ */
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/highmem.h>
+#include <linux/kthread.h>
+#include <linux/jump_label.h>
+#include <linux/freezer.h>
+#include <linux/shrinker.h>
+#include <linux/nodemask.h>
+#include <linux/sysctl.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <uapi/linux/sched/types.h>
+#include "internal.h"
+
+/* per-node number of pages the pool is filled up to, 0 disables it */
+int sysctl_prezero_pages __read_mostly;
+
+DEFINE_STATIC_KEY_FALSE(prezero_enabled);
+static DEFINE_MUTEX(prezero_mutex);
+
+struct prezero_pool {
+	spinlock_t lock;
+	struct list_head pages;
+	unsigned long nr_pages;
+	wait_queue_head_t wait;
+	struct task_struct *task;
+	int nid;
+};
+
+static struct prezero_pool *prezero_pools[MAX_NUMNODES];
+
+#define PREZERO_GFP	((GFP_HIGHUSER & ~__GFP_RECLAIM) | \
+			 __GFP_NOWARN | __GFP_THISNODE)
+
+/*
+ * Only fill the pool while the node is well above its high watermarks,
+ * the pool must never be the reason kswapd wakes up.
+ */
+static bool prezero_node_has_room(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	unsigned long free = 0, high = 0;
+	int i;
+
+	for (i = 0; i < MAX_NR_ZONES; i++) {
+		struct zone *zone = &pgdat->node_zones[i];
+
+		if (!managed_zone(zone))
+			continue;
+		free += zone_page_state(zone, NR_FREE_PAGES);
+		high += high_wmark_pages(zone);
+	}
+	return free > 2 * high;
+}
+
+static bool prezero_pool_wants_pages(struct prezero_pool *pool)
+{
+	return READ_ONCE(pool->nr_pages) < READ_ONCE(sysctl_prezero_pages);
+}
+
+static int prezero_thread(void *data)
+{
+	struct prezero_pool *pool = data;
+	int nid = pool->nid;
+	struct sched_param param = { .sched_priority = 0 };
+	unsigned long flags;
+	struct page *page;
+
+	sched_setscheduler_nocheck(current, SCHED_IDLE, &param);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(pool->wait, kthread_should_stop() ||
+				     prezero_pool_wants_pages(pool));
+		if (kthread_should_stop())
+			break;
+
+		if (!prezero_node_has_room(nid)) {
+			schedule_timeout_interruptible(HZ);
+			continue;
+		}
+
+		page = alloc_pages_node(nid, PREZERO_GFP, 0);
+		if (!page) {
+			schedule_timeout_interruptible(HZ);
+			continue;
+		}
+		clear_highpage(page);
+
+		spin_lock_irqsave(&pool->lock, flags);
+		list_add(&page->lru, &pool->pages);
+		pool->nr_pages++;
+		spin_unlock_irqrestore(&pool->lock, flags);
+
+		cond_resched();
+	}
+	return 0;
+}
+
+/*
+ * Called from __alloc_pages_nodemask() for order-0 __GFP_ZERO user
+ * allocations. The page is already prepared; returns NULL when the pool
+ * of @nid is empty.
+ */
+struct page *prezero_alloc_page(int nid)
+{
+	struct prezero_pool *pool = prezero_pools[nid];
+	struct page *page = NULL;
+	unsigned long flags;
+
+	if (!pool || !READ_ONCE(pool->nr_pages))
+		return NULL;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if (!list_empty(&pool->pages)) {
+		page = list_first_entry(&pool->pages, struct page, lru);
+		list_del(&page->lru);
+		pool->nr_pages--;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	if (pool->nr_pages < READ_ONCE(sysctl_prezero_pages) / 2 &&
+	    waitqueue_active(&pool->wait))
+		wake_up_interruptible(&pool->wait);
+
+	return page;
+}
+
+static unsigned long prezero_pool_release(struct prezero_pool *pool,
+					  unsigned long nr_to_release)
+{
+	unsigned long flags, freed = 0;
+	struct page *page, *next;
+	LIST_HEAD(list);
+
+	spin_lock_irqsave(&pool->lock, flags);
+	while (freed < nr_to_release && !list_empty(&pool->pages)) {
+		page = list_first_entry(&pool->pages, struct page, lru);
+		list_move(&page->lru, &list);
+		pool->nr_pages--;
+		freed++;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	list_for_each_entry_safe(page, next, &list, lru) {
+		list_del(&page->lru);
+		__free_page(page);
+	}
+	return freed;
+}
+
+static unsigned long prezero_shrink_count(struct shrinker *shrink,
+					  struct shrink_control *sc)
+{
+	struct prezero_pool *pool = prezero_pools[sc->nid];
+
+	return pool ? READ_ONCE(pool->nr_pages) : 0;
+}
+
+static unsigned long prezero_shrink_scan(struct shrinker *shrink,
+					 struct shrink_control *sc)
+{
+	struct prezero_pool *pool = prezero_pools[sc->nid];
+	unsigned long freed;
+
+	if (!pool)
+		return SHRINK_STOP;
+	freed = prezero_pool_release(pool, sc->nr_to_scan);
+	return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker prezero_shrinker = {
+	.count_objects = prezero_shrink_count,
+	.scan_objects = prezero_shrink_scan,
+	.seeks = 0,
+	.flags = SHRINKER_NUMA_AWARE,
+};
+
+int prezero_pages_sysctl_handler(struct ctl_table *table, int write,
+				 void __user *buffer, size_t *length,
+				 loff_t *ppos)
+{
+	int old, ret, nid;
+
+	mutex_lock(&prezero_mutex);
+	old = sysctl_prezero_pages;
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write || old == sysctl_prezero_pages)
+		goto out;
+
+	if (!old)
+		static_branch_enable(&prezero_enabled);
+	else if (!sysctl_prezero_pages)
+		static_branch_disable(&prezero_enabled);
+
+	for_each_node_state(nid, N_MEMORY) {
+		struct prezero_pool *pool = prezero_pools[nid];
+
+		if (!pool)
+			continue;
+		if (pool->nr_pages > sysctl_prezero_pages)
+			prezero_pool_release(pool, pool->nr_pages -
+					     sysctl_prezero_pages);
+		else
+			wake_up_interruptible(&pool->wait);
+	}
+out:
+	mutex_unlock(&prezero_mutex);
+	return ret;
+}
+
+static int __init prezero_init(void)
+{
+	struct prezero_pool *pool;
+	int nid;
+
+	for_each_node_state(nid, N_MEMORY) {
+		pool = kzalloc_node(sizeof(*pool), GFP_KERNEL, nid);
+		if (!pool)
+			continue;
+		spin_lock_init(&pool->lock);
+		INIT_LIST_HEAD(&pool->pages);
+		init_waitqueue_head(&pool->wait);
+		pool->nid = nid;
+		pool->task = kthread_run(prezero_thread, pool,
+					 "kprezerod%d", nid);
+		if (IS_ERR(pool->task)) {
+			pr_err("Failed to start kprezerod on node %d\n", nid);
+			kfree(pool);
+			continue;
+		}
+		prezero_pools[nid] = pool;
+	}
+	return register_shrinker(&prezero_shrinker);
+}
+late_initcall(prezero_init);
@@ -1334,6 +1334,35 @@ static struct pcpu_chunk *pcpu_chunk_addr_search(void *addr)
 	return pcpu_get_page_chunk(pcpu_addr_to_page(addr));
 }
 
+/*
+ * Find and allocate a free area of @bits in the normal chunks, with
+ * pcpu_lock held.  With @pop_only, only in already populated pages.
+ * Returns the offset in *@chunkp, or -1.
+ */
+static int pcpu_alloc_normal(size_t size, int bits, size_t bit_align,
+			     bool pop_only, struct pcpu_chunk **chunkp)
+{
+	struct pcpu_chunk *chunk;
+	int slot, off;
+
+	for (slot = pcpu_size_to_slot(size); slot < pcpu_nr_slots; slot++) {
+		list_for_each_entry(chunk, &pcpu_slot[slot], list) {
+			off = pcpu_find_block_fit(chunk, bits, bit_align,
+						  pop_only);
+			if (off < 0)
+				continue;
+
+			off = pcpu_alloc_area(chunk, bits, bit_align, off);
+			if (off >= 0) {
+				*chunkp = chunk;
+				return off;
+			}
+		}
+	}
+
+	return -1;
+}
+
 /**
  * pcpu_alloc - the percpu allocator
  * @size: size of area to allocate in bytes
@@ -1357,9 +1386,10 @@ static void __percpu *pcpu_alloc(size_t size, size_t align, bool reserved,
 	bool is_atomic = (gfp & GFP_KERNEL) != GFP_KERNEL;
 	bool do_warn = !(gfp & __GFP_NOWARN);
 	static int warn_limit = 10;
+	bool has_mutex = false;
 	struct pcpu_chunk *chunk;
 	const char *err;
-	int slot, off, cpu, ret;
+	int off, cpu, ret;
 	unsigned long flags;
 	void __percpu *ptr;
 	size_t bits, bit_align;
@@ -1384,6 +1414,19 @@ static void __percpu *pcpu_alloc(size_t size, size_t align, bool reserved,
 		return NULL;
 	}
 
+	/*
+	 * pcpu_alloc_mutex is only needed to populate or create chunks.
+	 * Like atomic allocations, first try the already populated pages,
+	 * which the balance work keeps a reserve of, under pcpu_lock alone.
+	 */
+	if (!is_atomic && !reserved) {
+		spin_lock_irqsave(&pcpu_lock, flags);
+		off = pcpu_alloc_normal(size, bits, bit_align, true, &chunk);
+		if (off >= 0)
+			goto area_found;
+		spin_unlock_irqrestore(&pcpu_lock, flags);
+	}
+
 	if (!is_atomic) {
 		/*
 		 * pcpu_balance_workfn() allocates memory under this mutex,
@@ -1394,6 +1437,7 @@ static void __percpu *pcpu_alloc(size_t size, size_t align, bool reserved,
 			mutex_lock(&pcpu_alloc_mutex);
 		else if (mutex_lock_killable(&pcpu_alloc_mutex))
 			return NULL;
+		has_mutex = true;
 	}
 
 	spin_lock_irqsave(&pcpu_lock, flags);
@@ -1418,19 +1462,9 @@ static void __percpu *pcpu_alloc(size_t size, size_t align, bool reserved,
 
 restart:
 	/* search through normal chunks */
-	for (slot = pcpu_size_to_slot(size); slot < pcpu_nr_slots; slot++) {
-		list_for_each_entry(chunk, &pcpu_slot[slot], list) {
-			off = pcpu_find_block_fit(chunk, bits, bit_align,
-						  is_atomic);
-			if (off < 0)
-				continue;
-
-			off = pcpu_alloc_area(chunk, bits, bit_align, off);
-			if (off >= 0)
-				goto area_found;
-
-		}
-	}
+	off = pcpu_alloc_normal(size, bits, bit_align, is_atomic, &chunk);
+	if (off >= 0)
+		goto area_found;
 
 	spin_unlock_irqrestore(&pcpu_lock, flags);
 
@@ -1464,7 +1498,7 @@ static void __percpu *pcpu_alloc(size_t size, size_t align, bool reserved,
 	spin_unlock_irqrestore(&pcpu_lock, flags);
 
 	/* populate if not all pages are already there */
-	if (!is_atomic) {
+	if (has_mutex) {
 		int page_start, page_end, rs, re;
 
 		page_start = PFN_DOWN(off);
@@ -1520,7 +1554,7 @@ static void __percpu *pcpu_alloc(size_t size, size_t align, bool reserved,
 		/* see the flag handling in pcpu_blance_workfn() */
 		pcpu_atomic_alloc_failed = true;
 		pcpu_schedule_balance_work();
-	} else {
+	} else if (has_mutex) {
 		mutex_unlock(&pcpu_alloc_mutex);
 	}
 	return NULL;
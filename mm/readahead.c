@@ -387,6 +387,7 @@ ondemand_readahead(struct address_space *mapping,
 	unsigned long max_pages = ra->ra_pages;
 	unsigned long add_pages;
 	pgoff_t prev_offset;
+	unsigned long nr = 0;
 
 	/*
 	 * If the request exceeds the readahead window, allow the read to
@@ -413,6 +414,24 @@ ondemand_readahead(struct address_space *mapping,
 		goto readit;
 	}
 
+	prev_offset = (unsigned long long)ra->prev_pos >> PAGE_SHIFT;
+
+	/*
+	 * Strided access: the gap between the last page of the previous read
+	 * and this one is the same as last time. Read the next chunk of the
+	 * stride ahead, with its first page marked so that reaching it pulls
+	 * in the one after.
+	 */
+	if (offset - prev_offset > 1UL && offset - prev_offset == ra->stride &&
+	    req_size <= max_pages) {
+		if (!hit_readahead_marker)
+			nr = __do_page_cache_readahead(mapping, filp, offset,
+						       req_size, 0);
+		return nr + __do_page_cache_readahead(mapping, filp,
+					offset + ra->stride + req_size - 1,
+					req_size, req_size);
+	}
+
 	/*
 	 * Hit a marked page without valid readahead state.
 	 * E.g. interleaved reads.
@@ -448,7 +467,6 @@ ondemand_readahead(struct address_space *mapping,
 	 * trivial case: (offset - prev_offset) == 1
 	 * unaligned reads: (offset - prev_offset) == 0
 	 */
-	prev_offset = (unsigned long long)ra->prev_pos >> PAGE_SHIFT;
 	if (offset - prev_offset <= 1UL)
 		goto initial_readahead;
 
@@ -461,8 +479,10 @@ ondemand_readahead(struct address_space *mapping,
 
 	/*
 	 * standalone, small random read
-	 * Read as is, and do not pollute the readahead state.
+	 * Read as is, and do not pollute the readahead state beyond noting
+	 * the gap, in case the next read turns out to be strided.
 	 */
+	ra->stride = offset - prev_offset;
 	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
 
 initial_readahead:
@@ -513,6 +533,8 @@ void page_cache_sync_readahead(struct address_space *mapping,
 	if (!ra->ra_pages)
 		return;
 
+	ra->nr_misses++;
+
 	if (blk_cgroup_congested())
 		return;
 
@@ -523,7 +545,8 @@ void page_cache_sync_readahead(struct address_space *mapping,
 	}
 
 	/* do read-ahead */
-	ondemand_readahead(mapping, ra, filp, false, offset, req_size);
+	ra->nr_submitted += ondemand_readahead(mapping, ra, filp, false,
+					       offset, req_size);
 }
 EXPORT_SYMBOL_GPL(page_cache_sync_readahead);
 
@@ -559,6 +582,7 @@ page_cache_async_readahead(struct address_space *mapping,
 		return;
 
 	ClearPageReadahead(page);
+	ra->nr_hits++;
 
 	/*
 	 * Defer asynchronous read-ahead on IO congestion.
@@ -570,7 +594,8 @@ page_cache_async_readahead(struct address_space *mapping,
 		return;
 
 	/* do read-ahead */
-	ondemand_readahead(mapping, ra, filp, true, offset, req_size);
+	ra->nr_submitted += ondemand_readahead(mapping, ra, filp, true,
+					       offset, req_size);
 }
 EXPORT_SYMBOL_GPL(page_cache_async_readahead);
 
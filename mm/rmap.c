@@ -747,6 +747,54 @@ struct page_referenced_arg {
 	unsigned long vm_flags;
 	struct mem_cgroup *memcg;
 };
+
+/* Number of ptes checked around a young one, see page_referenced_look_around */
+#define LOOK_AROUND_PTES	BITS_PER_LONG
+
+/*
+ * A young pte found while walking the rmap of a page under reclaim is a good
+ * hint that its neighbours in the same page table are in use as well. Since
+ * we hold the page table lock anyway, check those ptes too and activate the
+ * inactive pages that shrink_page_list() would activate on finding them
+ * referenced, saving each of them a full rmap walk of its own.
+ */
+static void page_referenced_look_around(struct page_vma_mapped_walk *pvmw)
+{
+	struct vm_area_struct *vma = pvmw->vma;
+	unsigned long address = pvmw->address;
+	unsigned long start, end, addr;
+	pte_t *pte;
+
+	start = address & ~(LOOK_AROUND_PTES * PAGE_SIZE - 1);
+	start = max3(start, address & PMD_MASK, vma->vm_start);
+	end = pmd_addr_end(address, min(start + LOOK_AROUND_PTES * PAGE_SIZE,
+					vma->vm_end));
+
+	pte = pvmw->pte - ((address - start) >> PAGE_SHIFT);
+	for (addr = start; addr != end; addr += PAGE_SIZE, pte++) {
+		struct page *page;
+
+		if (addr == address || !pte_present(*pte) || !pte_young(*pte))
+			continue;
+
+		page = vm_normal_page(vma, addr, *pte);
+		if (!page || !PageLRU(page) || PageActive(page) ||
+		    PageUnevictable(page))
+			continue;
+
+		/*
+		 * Mirror page_check_references(): a single reference only
+		 * activates anon, exec or already referenced pages.
+		 */
+		if (!PageSwapBacked(page) && !PageReferenced(page) &&
+		    !(vma->vm_flags & VM_EXEC))
+			continue;
+
+		if (ptep_clear_young_notify(vma, addr, pte))
+			activate_page(page);
+	}
+}
+
 /*
  * arg: page_referenced_arg will be passed
  */
@@ -781,8 +829,10 @@ static bool page_referenced_one(struct page *page, struct vm_area_struct *vma,
 				 * already gone, the unmap path will have set
 				 * PG_referenced or activated the page.
 				 */
-				if (likely(!(vma->vm_flags & VM_SEQ_READ)))
+				if (likely(!(vma->vm_flags & VM_SEQ_READ))) {
 					referenced++;
+					page_referenced_look_around(&pvmw);
+				}
 			}
 		} else if (IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE)) {
 			if (pmdp_clear_flush_young_notify(vma, address,
@@ -1463,6 +1513,8 @@ static bool try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 			swp_pte = swp_entry_to_pte(entry);
 			if (pte_soft_dirty(pteval))
 				swp_pte = pte_swp_mksoft_dirty(swp_pte);
+			if (pte_uffd_wp(pteval))
+				swp_pte = pte_swp_mkuffd_wp(swp_pte);
 			set_pte_at(mm, pvmw.address, pvmw.pte, swp_pte);
 			/*
 			 * No need to invalidate here it will synchronize on
@@ -1555,6 +1607,8 @@ static bool try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 			swp_pte = swp_entry_to_pte(entry);
 			if (pte_soft_dirty(pteval))
 				swp_pte = pte_swp_mksoft_dirty(swp_pte);
+			if (pte_uffd_wp(pteval))
+				swp_pte = pte_swp_mkuffd_wp(swp_pte);
 			set_pte_at(mm, address, pvmw.pte, swp_pte);
 			/*
 			 * No need to invalidate here it will synchronize on
@@ -1621,6 +1675,8 @@ static bool try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 			swp_pte = swp_entry_to_pte(entry);
 			if (pte_soft_dirty(pteval))
 				swp_pte = pte_swp_mksoft_dirty(swp_pte);
+			if (pte_uffd_wp(pteval))
+				swp_pte = pte_swp_mkuffd_wp(swp_pte);
 			set_pte_at(mm, address, pvmw.pte, swp_pte);
 			/* Invalidate as we cleared the pte */
 			mmu_notifier_invalidate_range(mm, address,
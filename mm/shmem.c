@@ -357,7 +357,8 @@ static bool shmem_confirm_swap(struct address_space *mapping,
 }
 
 /*
- * Definitions for "huge tmpfs": tmpfs mounted with the huge= option
+ * Definitions for "huge tmpfs": tmpfs mounted with the huge= option, or
+ * a single file asking for huge pages, see shmem_file_set_huge()
  *
  * SHMEM_HUGE_NEVER:
  *	disables huge pages for the mount;
@@ -567,10 +568,19 @@ static unsigned long shmem_unused_huge_shrink(struct shmem_sb_info *sbinfo,
 }
 #endif /* CONFIG_TRANSPARENT_HUGE_PAGECACHE */
 
-static inline bool is_huge_enabled(struct shmem_sb_info *sbinfo)
+/*
+ * The huge page policy of an inode: its own if it was given one,
+ * otherwise that of its mount.
+ */
+static inline int shmem_huge_policy(struct inode *inode)
+{
+	return SHMEM_I(inode)->huge ?: SHMEM_SB(inode->i_sb)->huge;
+}
+
+static inline bool is_huge_enabled(struct inode *inode)
 {
 	if (IS_ENABLED(CONFIG_TRANSPARENT_HUGE_PAGECACHE) &&
-	    (shmem_huge == SHMEM_HUGE_FORCE || sbinfo->huge) &&
+	    (shmem_huge == SHMEM_HUGE_FORCE || shmem_huge_policy(inode)) &&
 	    shmem_huge != SHMEM_HUGE_DENY)
 		return true;
 	return false;
@@ -975,7 +985,6 @@ static int shmem_getattr(const struct path *path, struct kstat *stat,
 {
 	struct inode *inode = path->dentry->d_inode;
 	struct shmem_inode_info *info = SHMEM_I(inode);
-	struct shmem_sb_info *sb_info = SHMEM_SB(inode->i_sb);
 
 	if (info->alloced - info->swapped != inode->i_mapping->nrpages) {
 		spin_lock_irq(&info->lock);
@@ -984,7 +993,7 @@ static int shmem_getattr(const struct path *path, struct kstat *stat,
 	}
 	generic_fillattr(inode, stat);
 
-	if (is_huge_enabled(sb_info))
+	if (is_huge_enabled(inode))
 		stat->blksize = HPAGE_PMD_SIZE;
 
 	return 0;
@@ -1486,6 +1495,8 @@ static struct page *shmem_alloc_and_acct_page(gfp_t gfp,
 	err = -ENOMEM;
 	shmem_inode_unacct_blocks(inode, nr);
 failed:
+	if (huge)
+		count_vm_event(THP_FILE_FALLBACK);
 	return ERR_PTR(err);
 }
 
@@ -1731,7 +1742,7 @@ static int shmem_getpage_gfp(struct inode *inode, pgoff_t index,
 			goto alloc_nohuge;
 		if (shmem_huge == SHMEM_HUGE_FORCE)
 			goto alloc_huge;
-		switch (sbinfo->huge) {
+		switch (shmem_huge_policy(inode)) {
 			loff_t i_size;
 			pgoff_t off;
 		case SHMEM_HUGE_NEVER:
@@ -2032,11 +2043,11 @@ unsigned long shmem_get_unmapped_area(struct file *file,
 		return addr;
 
 	if (shmem_huge != SHMEM_HUGE_FORCE) {
-		struct super_block *sb;
+		int huge;
 
 		if (file) {
 			VM_BUG_ON(file->f_op != &shmem_file_operations);
-			sb = file_inode(file)->i_sb;
+			huge = shmem_huge_policy(file_inode(file));
 		} else {
 			/*
 			 * Called directly from mm/mmap.c, or drivers/char/mem.c
@@ -2044,9 +2055,9 @@ unsigned long shmem_get_unmapped_area(struct file *file,
 			 */
 			if (IS_ERR(shm_mnt))
 				return addr;
-			sb = shm_mnt->mnt_sb;
+			huge = SHMEM_SB(shm_mnt->mnt_sb)->huge;
 		}
-		if (SHMEM_SB(sb)->huge == SHMEM_HUGE_NEVER)
+		if (huge == SHMEM_HUGE_NEVER)
 			return addr;
 	}
 
@@ -2155,6 +2166,7 @@ static struct inode *shmem_get_inode(struct super_block *sb, const struct inode
 		spin_lock_init(&info->lock);
 		info->seals = F_SEAL_SEAL;
 		info->flags = flags & VM_NORESERVE;
+		info->huge = SHMEM_HUGE_NEVER;
 		INIT_LIST_HEAD(&info->shrinklist);
 		INIT_LIST_HEAD(&info->swaplist);
 		simple_xattrs_init(&info->xattrs);
@@ -3783,7 +3795,6 @@ struct kobj_attribute shmem_enabled_attr =
 bool shmem_huge_enabled(struct vm_area_struct *vma)
 {
 	struct inode *inode = file_inode(vma->vm_file);
-	struct shmem_sb_info *sbinfo = SHMEM_SB(inode->i_sb);
 	loff_t i_size;
 	pgoff_t off;
 
@@ -3791,7 +3802,7 @@ bool shmem_huge_enabled(struct vm_area_struct *vma)
 		return true;
 	if (shmem_huge == SHMEM_HUGE_DENY)
 		return false;
-	switch (sbinfo->huge) {
+	switch (shmem_huge_policy(inode)) {
 		case SHMEM_HUGE_NEVER:
 			return false;
 		case SHMEM_HUGE_ALWAYS:
@@ -3811,6 +3822,21 @@ bool shmem_huge_enabled(struct vm_area_struct *vma)
 			return false;
 	}
 }
+
+/*
+ * Make @file allocate huge pages whenever it can, whatever the huge=
+ * option of its mount says, e.g. for a memfd shared between processes as
+ * a ring buffer.  The shmem_enabled "deny" setting still wins.
+ */
+int shmem_file_set_huge(struct file *file)
+{
+	if (!shmem_file(file))
+		return -EINVAL;
+	if (shmem_huge == SHMEM_HUGE_DENY)
+		return -EINVAL;
+	SHMEM_I(file_inode(file))->huge = SHMEM_HUGE_ALWAYS;
+	return 0;
+}
 #endif /* CONFIG_TRANSPARENT_HUGE_PAGECACHE */
 
 #else /* !CONFIG_SHMEM */
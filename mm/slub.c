@@ -1451,6 +1451,176 @@ static inline bool slab_free_freelist_hook(struct kmem_cache *s,
 #endif
 }
 
+#ifdef CONFIG_MEMCG_KMEM
+/*
+ * Accounted objects are charged one by one to the obj_cgroup of the
+ * allocating task and share the slab pages of the cache with everybody
+ * else, rather than each memcg filling pages of its own clone of the
+ * cache. The obj_cgroup of every object is recorded in the vector of its
+ * page, which holds a reference to the obj_cgroup until the object is
+ * freed. The memcg itself is not pinned, its obj_cgroup moves to the
+ * parent when it goes offline.
+ */
+static inline int memcg_slab_pre_alloc_hook(struct kmem_cache *s, gfp_t flags,
+					    size_t size,
+					    struct obj_cgroup **objcgp)
+{
+	struct obj_cgroup *objcg;
+
+	*objcgp = NULL;
+	if (!memcg_kmem_enabled() ||
+	    !((flags & __GFP_ACCOUNT) || (s->flags & SLAB_ACCOUNT)))
+		return 0;
+
+	objcg = get_obj_cgroup_from_current();
+	if (!objcg)
+		return 0;
+
+	if (memcg_kmem_charge_obj(objcg, flags, size * s->size)) {
+		obj_cgroup_put(objcg);
+		return -ENOMEM;
+	}
+
+	*objcgp = objcg;
+	return 0;
+}
+
+static struct obj_cgroup **memcg_alloc_page_vec(struct page *page, gfp_t flags)
+{
+	struct obj_cgroup **vec;
+	unsigned long new;
+
+	vec = kcalloc_node(page->objects, sizeof(*vec),
+			   flags & ~__GFP_ACCOUNT, page_to_nid(page));
+	if (!vec)
+		return NULL;
+
+	new = (unsigned long)vec | MEMCG_OBJ_VEC;
+	if (cmpxchg(&page->mem_cgroup, NULL, (struct mem_cgroup *)new)) {
+		/* raced with another allocation from the page */
+		kfree(vec);
+		vec = page_objcg_vec(page);
+	}
+	return vec;
+}
+
+static void memcg_slab_post_alloc_hook(struct kmem_cache *s,
+				       struct obj_cgroup *objcg, gfp_t flags,
+				       size_t size, void **p)
+{
+	struct obj_cgroup **vec;
+	struct page *page;
+	size_t i, unused = 0;
+
+	if (!objcg)
+		return;
+
+	for (i = 0; i < size; i++) {
+		if (unlikely(!p[i])) {
+			unused++;
+			continue;
+		}
+		page = virt_to_head_page(p[i]);
+		vec = page_objcg_vec(page);
+		if (!vec)
+			vec = memcg_alloc_page_vec(page, flags);
+		if (unlikely(!vec)) {
+			unused++;
+			continue;
+		}
+		obj_cgroup_get(objcg);
+		vec[obj_to_index(s, page, p[i])] = objcg;
+	}
+
+	if (size > unused)
+		mod_objcg_slab_state(objcg, cache_vmstat_idx(s),
+				     (size - unused) * s->size);
+	if (unused)
+		memcg_kmem_uncharge_obj(objcg, unused * s->size);
+	obj_cgroup_put(objcg);
+}
+
+static void memcg_slab_free_hook(struct page *page, void *object)
+{
+	struct kmem_cache *s = page->slab_cache;
+	struct obj_cgroup **vec;
+	struct obj_cgroup *objcg;
+	unsigned int off;
+
+	if (!memcg_kmem_enabled())
+		return;
+
+	vec = page_objcg_vec(page);
+	if (!vec)
+		return;
+
+	off = obj_to_index(s, page, object);
+	objcg = vec[off];
+	if (!objcg)
+		return;
+
+	vec[off] = NULL;
+	mod_objcg_slab_state(objcg, cache_vmstat_idx(s), -(int)s->size);
+	memcg_kmem_uncharge_obj(objcg, s->size);
+	obj_cgroup_put(objcg);
+}
+
+static void memcg_slab_free_bulk_hook(size_t size, void **p)
+{
+	struct page *page;
+	size_t i;
+
+	if (!memcg_kmem_enabled())
+		return;
+
+	for (i = 0; i < size; i++) {
+		if (!p[i])
+			continue;
+		page = virt_to_head_page(p[i]);
+		if (PageSlab(page))
+			memcg_slab_free_hook(page, p[i]);
+	}
+}
+
+/* Objects still in the page have been freed, the vector goes with it */
+static inline void memcg_free_page_vec(struct page *page)
+{
+	struct obj_cgroup **vec = page_objcg_vec(page);
+
+	if (vec) {
+		page->mem_cgroup = NULL;
+		kfree(vec);
+	}
+}
+#else /* CONFIG_MEMCG_KMEM */
+static inline int memcg_slab_pre_alloc_hook(struct kmem_cache *s, gfp_t flags,
+					    size_t size,
+					    struct obj_cgroup **objcgp)
+{
+	*objcgp = NULL;
+	return 0;
+}
+
+static inline void memcg_slab_post_alloc_hook(struct kmem_cache *s,
+					      struct obj_cgroup *objcg,
+					      gfp_t flags, size_t size,
+					      void **p)
+{
+}
+
+static inline void memcg_slab_free_hook(struct page *page, void *object)
+{
+}
+
+static inline void memcg_slab_free_bulk_hook(size_t size, void **p)
+{
+}
+
+static inline void memcg_free_page_vec(struct page *page)
+{
+}
+#endif /* CONFIG_MEMCG_KMEM */
+
 static void setup_object(struct kmem_cache *s, struct page *page,
 				void *object)
 {
@@ -1707,6 +1877,8 @@ static void __free_slab(struct kmem_cache *s, struct page *page)
 			check_object(s, page, p, SLUB_RED_INACTIVE);
 	}
 
+	memcg_free_page_vec(page);
+
 	mod_lruvec_page_state(page,
 		(s->flags & SLAB_RECLAIM_ACCOUNT) ?
 		NR_SLAB_RECLAIMABLE : NR_SLAB_UNRECLAIMABLE,
@@ -2296,6 +2468,12 @@ static void put_cpu_partial(struct kmem_cache *s, struct page *page, int drain)
 #endif
 }
 
+static void cpu_array_drain(struct kmem_cache *s, struct kmem_cache_array *ca);
+static __always_inline void *cpu_array_alloc(struct kmem_cache *s,
+					     gfp_t gfpflags);
+static __always_inline bool cpu_array_free(struct kmem_cache *s,
+					   struct page *page, void *object);
+
 static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 {
 	stat(s, CPUSLAB_FLUSH);
@@ -2313,6 +2491,9 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+	if (s->cpu_array)
+		cpu_array_drain(s, per_cpu_ptr(s->cpu_array, cpu));
+
 	if (likely(c)) {
 		if (c->page)
 			flush_slab(s, c);
@@ -2333,6 +2514,9 @@ static bool has_cpu_slab(int cpu, void *info)
 	struct kmem_cache *s = info;
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+	if (s->cpu_array && per_cpu_ptr(s->cpu_array, cpu)->count)
+		return true;
+
 	return c->page || slub_percpu_partial(c);
 }
 
@@ -2666,10 +2850,19 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 	struct kmem_cache_cpu *c;
 	struct page *page;
 	unsigned long tid;
+	struct obj_cgroup *objcg;
 
 	s = slab_pre_alloc_hook(s, gfpflags);
 	if (!s)
 		return NULL;
+
+	if (memcg_slab_pre_alloc_hook(s, gfpflags, 1, &objcg))
+		return NULL;
+
+	if (s->cpu_array && node == NUMA_NO_NODE) {
+		object = cpu_array_alloc(s, gfpflags);
+		goto out;
+	}
 redo:
 	/*
 	 * Must read kmem_cache cpu data via this cpu ptr. Preemption is
@@ -2737,11 +2930,12 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 		prefetch_freepointer(s, next_object);
 		stat(s, ALLOC_FASTPATH);
 	}
-
+out:
 	if (unlikely(gfpflags & __GFP_ZERO) && object)
 		memset(object, 0, s->object_size);
 
 	slab_post_alloc_hook(s, gfpflags, 1, &object);
+	memcg_slab_post_alloc_hook(s, objcg, gfpflags, 1, &object);
 
 	return object;
 }
@@ -2988,8 +3182,15 @@ static __always_inline void slab_free(struct kmem_cache *s, struct page *page,
 	 * With KASAN enabled slab_free_freelist_hook modifies the freelist
 	 * to remove objects, whose reuse must be delayed.
 	 */
-	if (slab_free_freelist_hook(s, &head, &tail))
+	/* bulk frees have been uncharged by kmem_cache_free_bulk() */
+	if (!tail)
+		memcg_slab_free_hook(page, head);
+
+	if (slab_free_freelist_hook(s, &head, &tail)) {
+		if (s->cpu_array && !tail && cpu_array_free(s, page, head))
+			return;
 		do_slab_free(s, page, head, tail, cnt, addr);
+	}
 }
 
 #ifdef CONFIG_KASAN
@@ -3106,6 +3307,8 @@ void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
 	if (WARN_ON(!size))
 		return;
 
+	memcg_slab_free_bulk_hook(size, p);
+
 	do {
 		struct detached_freelist df;
 
@@ -3118,23 +3321,23 @@ void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
 }
 EXPORT_SYMBOL(kmem_cache_free_bulk);
 
-/* Note that interrupts must be enabled when calling this function. */
-int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
-			  void **p)
+/*
+ * Takes up to @size objects straight from the slabs, without running any of
+ * the alloc hooks. Returns the number of objects stored in @p.
+ */
+static int __kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags,
+				   size_t size, void **p)
 {
 	struct kmem_cache_cpu *c;
+	unsigned long irqflags;
 	int i;
 
-	/* memcg and kmem_cache debug support */
-	s = slab_pre_alloc_hook(s, flags);
-	if (unlikely(!s))
-		return false;
 	/*
 	 * Drain objects in the per cpu slab, while disabling local
 	 * IRQs, which protects against PREEMPT and interrupts
 	 * handlers invoking normal fastpath.
 	 */
-	local_irq_disable();
+	local_irq_save(irqflags);
 	c = this_cpu_ptr(s->cpu_slab);
 
 	for (i = 0; i < size; i++) {
@@ -3148,7 +3351,7 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 			p[i] = ___slab_alloc(s, flags, NUMA_NO_NODE,
 					    _RET_IP_, c);
 			if (unlikely(!p[i]))
-				goto error;
+				goto out;
 
 			c = this_cpu_ptr(s->cpu_slab);
 			continue; /* goto for-loop */
@@ -3157,7 +3360,29 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 		p[i] = object;
 	}
 	c->tid = next_tid(c->tid);
-	local_irq_enable();
+out:
+	local_irq_restore(irqflags);
+	return i;
+}
+
+/* Note that interrupts must be enabled when calling this function. */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
+			  void **p)
+{
+	struct obj_cgroup *objcg;
+	int i;
+
+	/* memcg and kmem_cache debug support */
+	s = slab_pre_alloc_hook(s, flags);
+	if (unlikely(!s))
+		return false;
+
+	if (memcg_slab_pre_alloc_hook(s, flags, size, &objcg))
+		return false;
+
+	i = __kmem_cache_alloc_bulk(s, flags, size, p);
+	if (unlikely(i < size))
+		goto error;
 
 	/* Clear memory outside IRQ disabled fastpath loop */
 	if (unlikely(flags & __GFP_ZERO)) {
@@ -3169,15 +3394,140 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 
 	/* memcg and kmem_cache debug support */
 	slab_post_alloc_hook(s, flags, size, p);
+	memcg_slab_post_alloc_hook(s, objcg, flags, size, p);
 	return i;
 error:
-	local_irq_enable();
+	if (objcg)
+		memcg_kmem_uncharge_obj(objcg, (size - i) * s->size);
 	slab_post_alloc_hook(s, flags, i, p);
+	memcg_slab_post_alloc_hook(s, objcg, flags, i, p);
 	__kmem_cache_free_bulk(s, i, p);
 	return 0;
 }
 EXPORT_SYMBOL(kmem_cache_alloc_bulk);
 
+/*
+ * Per cpu object arrays, see SLAB_CPU_ARRAY.
+ *
+ * Objects sitting in a cpu array are free as far as the debug, KASAN and
+ * kmemleak hooks are concerned: they either went through the free hooks on
+ * the way in or came straight from the slabs on refill, and they go through
+ * the alloc hooks on the way out. Moving them between an array and the
+ * slabs thus uses the raw primitives.
+ */
+static void cpu_array_free_objects(struct kmem_cache *s, size_t size,
+				   void **p)
+{
+	do {
+		struct detached_freelist df;
+
+		size = build_detached_freelist(s, size, p, &df);
+		if (!df.page)
+			continue;
+
+		do_slab_free(df.s, df.page, df.freelist, df.tail, df.cnt,
+			     _RET_IP_);
+	} while (likely(size));
+}
+
+/* Returns the @nr coldest objects of @ca to the slabs, IRQs disabled */
+static noinline void cpu_array_flush(struct kmem_cache *s,
+				     struct kmem_cache_array *ca,
+				     unsigned int nr)
+{
+	if (!nr)
+		return;
+
+	cpu_array_free_objects(s, nr, ca->objects);
+	ca->count -= nr;
+	memmove(ca->objects, ca->objects + nr, ca->count * sizeof(void *));
+	stat(s, CPU_ARRAY_FLUSH);
+}
+
+static void cpu_array_drain(struct kmem_cache *s, struct kmem_cache_array *ca)
+{
+	cpu_array_flush(s, ca, ca->count);
+}
+
+static noinline void *cpu_array_refill(struct kmem_cache *s, gfp_t gfpflags)
+{
+	void *objects[SLUB_CPU_ARRAY_BATCH];
+	struct kmem_cache_array *ca;
+	unsigned long flags;
+	int i, nr, left = 0;
+	void *object;
+
+	nr = __kmem_cache_alloc_bulk(s, gfpflags, SLUB_CPU_ARRAY_BATCH,
+				     objects);
+	if (unlikely(!nr))
+		return NULL;
+
+	object = objects[0];
+
+	local_irq_save(flags);
+	ca = this_cpu_ptr(s->cpu_array);
+	for (i = 1; i < nr; i++) {
+		/*
+		 * Objects of pfmemalloc slabs are only meant for allocations
+		 * allowed to dip into the reserves, keep them out.
+		 */
+		if (ca->count < SLUB_CPU_ARRAY_SIZE &&
+		    !PageSlabPfmemalloc(virt_to_head_page(objects[i])))
+			ca->objects[ca->count++] = objects[i];
+		else
+			objects[left++] = objects[i];
+	}
+	local_irq_restore(flags);
+	stat(s, CPU_ARRAY_REFILL);
+
+	if (unlikely(left))
+		cpu_array_free_objects(s, left, objects);
+
+	return object;
+}
+
+static __always_inline void *cpu_array_alloc(struct kmem_cache *s,
+					     gfp_t gfpflags)
+{
+	struct kmem_cache_array *ca;
+	unsigned long flags;
+	void *object = NULL;
+
+	local_irq_save(flags);
+	ca = this_cpu_ptr(s->cpu_array);
+	if (likely(ca->count))
+		object = ca->objects[--ca->count];
+	local_irq_restore(flags);
+
+	if (unlikely(!object))
+		return cpu_array_refill(s, gfpflags);
+
+	stat(s, CPU_ARRAY_ALLOC);
+	return object;
+}
+
+static __always_inline bool cpu_array_free(struct kmem_cache *s,
+					   struct page *page, void *object)
+{
+	struct kmem_cache_array *ca;
+	unsigned long flags;
+
+	/* Remote and pfmemalloc objects go back to their slab right away */
+	if (unlikely(page_to_nid(page) != numa_mem_id() ||
+		     PageSlabPfmemalloc(page)))
+		return false;
+
+	local_irq_save(flags);
+	ca = this_cpu_ptr(s->cpu_array);
+	if (unlikely(ca->count == SLUB_CPU_ARRAY_SIZE))
+		cpu_array_flush(s, ca, SLUB_CPU_ARRAY_BATCH);
+	ca->objects[ca->count++] = object;
+	local_irq_restore(flags);
+
+	stat(s, CPU_ARRAY_FREE);
+	return true;
+}
+
 
 /*
  * Object placement in a slab is made very easy because we always start at
@@ -3333,6 +3683,17 @@ static inline int alloc_kmem_cache_cpus(struct kmem_cache *s)
 
 	init_kmem_cache_cpus(s);
 
+	/*
+	 * The cpu array bypasses the per object debug processing done on
+	 * the slow paths, so it is not used on caches being debugged. Nor is
+	 * it used on per memcg caches: there may be thousands of them, and
+	 * cached objects would keep dead ones pinned. It is an optimization
+	 * only, go without it if it can't be allocated.
+	 */
+	if ((s->flags & SLAB_CPU_ARRAY) && !kmem_cache_debug(s) &&
+	    is_root_cache(s))
+		s->cpu_array = alloc_percpu(struct kmem_cache_array);
+
 	return 1;
 }
 
@@ -3398,6 +3759,7 @@ static void free_kmem_cache_nodes(struct kmem_cache *s)
 void __kmem_cache_release(struct kmem_cache *s)
 {
 	cache_random_seq_destroy(s);
+	free_percpu(s->cpu_array);
 	free_percpu(s->cpu_slab);
 	free_kmem_cache_nodes(s);
 }
@@ -5400,6 +5762,10 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(CPU_ARRAY_ALLOC, cpu_array_alloc);
+STAT_ATTR(CPU_ARRAY_FREE, cpu_array_free);
+STAT_ATTR(CPU_ARRAY_REFILL, cpu_array_refill);
+STAT_ATTR(CPU_ARRAY_FLUSH, cpu_array_flush);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -5466,6 +5832,10 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&cpu_array_alloc_attr.attr,
+	&cpu_array_free_attr.attr,
+	&cpu_array_refill_attr.attr,
+	&cpu_array_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
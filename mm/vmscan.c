@@ -50,6 +50,7 @@
 #include <linux/printk.h>
 #include <linux/dax.h>
 #include <linux/psi.h>
+#include <linux/migrate.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -1100,6 +1101,105 @@ static void page_check_dirty_writeback(struct page *page,
 		mapping->a_ops->is_dirty_writeback(page, dirty, writeback);
 }
 
+#ifdef CONFIG_MIGRATION
+/*
+ * The node cold pages of @nid are demoted to instead of being reclaimed:
+ * the nearest node with memory but no CPUs, which is how slower memory
+ * tiers such as persistent memory onlined by dax/kmem show up. Pages are
+ * not demoted any further once on such a node.
+ */
+static int next_demotion_node(int nid)
+{
+	int node, target = NUMA_NO_NODE;
+	int best_distance = INT_MAX;
+
+	if (!sysctl_numa_demotion || !node_state(nid, N_CPU))
+		return NUMA_NO_NODE;
+
+	for_each_node_state(node, N_MEMORY) {
+		if (node == nid || node_state(node, N_CPU))
+			continue;
+		if (node_distance(nid, node) < best_distance) {
+			best_distance = node_distance(nid, node);
+			target = node;
+		}
+	}
+	return target;
+}
+
+static struct page *alloc_demote_page(struct page *page, unsigned long node)
+{
+	/*
+	 * Allocate from @node only, and fail quickly and quietly: the page
+	 * is then just reclaimed instead.
+	 */
+	gfp_t gfp_mask = (GFP_HIGHUSER_MOVABLE & ~__GFP_RECLAIM) |
+			 __GFP_THISNODE | __GFP_NOWARN | __GFP_NOMEMALLOC;
+	struct page *newpage;
+
+	if (PageTransHuge(page)) {
+		newpage = alloc_pages_node(node, gfp_mask | __GFP_COMP,
+					   HPAGE_PMD_ORDER);
+		if (newpage)
+			prep_transhuge_page(newpage);
+		return newpage;
+	}
+	return alloc_pages_node(node, gfp_mask, 0);
+}
+
+/*
+ * Migrate the isolated pages on @demote_pages to the demotion target of
+ * @pgdat. Returns the number of base pages demoted, the ones which could not
+ * be migrated for now are left on the list.
+ */
+static unsigned int demote_page_list(struct list_head *demote_pages,
+				     struct pglist_data *pgdat)
+{
+	int target_nid = next_demotion_node(pgdat->node_id);
+	long isolated[2] = { 0, 0 };
+	unsigned int nr_succeeded = 0;
+	struct page *page;
+
+	if (list_empty(demote_pages) || target_nid == NUMA_NO_NODE)
+		return 0;
+
+	list_for_each_entry(page, demote_pages, lru)
+		isolated[page_is_file_cache(page)] += hpage_nr_pages(page);
+
+	/*
+	 * Demotion ignores all cpuset and mempolicy settings. The pages
+	 * migrated before a failure, -ENOMEM included, are gone all the same.
+	 */
+	migrate_pages(demote_pages, alloc_demote_page, NULL, target_nid,
+		      MIGRATE_ASYNC, MR_DEMOTION, &nr_succeeded);
+
+	list_for_each_entry(page, demote_pages, lru)
+		isolated[page_is_file_cache(page)] -= hpage_nr_pages(page);
+
+	/*
+	 * migrate_pages() took the pages it migrated, or gave up on and put
+	 * back on the LRU, out of NR_ISOLATED_*, which our caller is going
+	 * to do as well for all the pages it isolated.
+	 */
+	mod_node_page_state(pgdat, NR_ISOLATED_ANON, isolated[0]);
+	mod_node_page_state(pgdat, NR_ISOLATED_FILE, isolated[1]);
+
+	count_vm_events(PGDEMOTE, nr_succeeded);
+	return nr_succeeded;
+}
+#else
+static inline int next_demotion_node(int nid)
+{
+	return NUMA_NO_NODE;
+}
+
+static inline unsigned int demote_page_list(struct list_head *demote_pages,
+					    struct pglist_data *pgdat)
+{
+	return 0;
+}
+#endif /* CONFIG_MIGRATION */
+
 /*
  * shrink_page_list() returns the number of reclaimed pages
  */
@@ -1112,6 +1212,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 {
 	LIST_HEAD(ret_pages);
 	LIST_HEAD(free_pages);
+	LIST_HEAD(demote_pages);
 	int pgactivate = 0;
 	unsigned nr_unqueued_dirty = 0;
 	unsigned nr_dirty = 0;
@@ -1121,9 +1222,18 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 	unsigned nr_immediate = 0;
 	unsigned nr_ref_keep = 0;
 	unsigned nr_unmap_fail = 0;
+	bool do_demote_pass;
 
 	cond_resched();
 
+	/*
+	 * Demotion frees memory on this node but not in a memcg, and does
+	 * not help callers that need specific pages freed.
+	 */
+	do_demote_pass = !force_reclaim && global_reclaim(sc) &&
+			 next_demotion_node(pgdat->node_id) != NUMA_NO_NODE;
+
+retry:
 	while (!list_empty(page_list)) {
 		struct address_space *mapping;
 		struct page *page;
@@ -1274,6 +1384,19 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			; /* try to reclaim the page below */
 		}
 
+		/*
+		 * Before reclaiming the page, try to relocate its contents
+		 * to a slower memory node. Lazyfree pages are cheaper to
+		 * just drop.
+		 */
+		if (do_demote_pass &&
+		    !(PageAnon(page) && !PageSwapBacked(page)) &&
+		    (thp_migration_supported() || !PageTransHuge(page))) {
+			list_add(&page->lru, &demote_pages);
+			unlock_page(page);
+			continue;
+		}
+
 		/*
 		 * Anonymous process memory has backing store?
 		 * Try to allocate it some swap space here.
@@ -1496,6 +1619,15 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		VM_BUG_ON_PAGE(PageLRU(page) || PageUnevictable(page), page);
 	}
 
+	/* Migrate the pages selected for demotion */
+	nr_reclaimed += demote_page_list(&demote_pages, pgdat);
+	/* Pages which could not be demoted go through reclaim after all */
+	if (!list_empty(&demote_pages)) {
+		list_splice_init(&demote_pages, page_list);
+		do_demote_pass = false;
+		goto retry;
+	}
+
 	mem_cgroup_uncharge_list(&free_pages);
 	try_to_unmap_flush();
 	free_unref_page_list(&free_pages);
@@ -1543,6 +1675,63 @@ unsigned long reclaim_clean_pages_from_list(struct zone *zone,
 	return ret;
 }
 
+static unsigned long reclaim_node_pages(struct list_head *page_list,
+					int nid)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.priority = DEF_PRIORITY,
+		.may_writepage = 1,
+		.may_unmap = 1,
+		.may_swap = 1,
+	};
+	unsigned long nr_reclaimed;
+	struct page *page;
+
+	nr_reclaimed = shrink_page_list(page_list, NODE_DATA(nid), &sc, 0,
+					NULL, true);
+	while (!list_empty(page_list)) {
+		page = lru_to_page(page_list);
+		list_del(&page->lru);
+		putback_lru_page(page);
+	}
+
+	return nr_reclaimed;
+}
+
+/*
+ * Reclaim the isolated pages on @page_list right away, ignoring their
+ * references: the caller knows they are cold.  The pages which could
+ * not be reclaimed go back to the LRU.
+ */
+unsigned long reclaim_pages(struct list_head *page_list)
+{
+	int nid = NUMA_NO_NODE;
+	unsigned long nr_reclaimed = 0;
+	LIST_HEAD(node_page_list);
+	struct page *page;
+
+	while (!list_empty(page_list)) {
+		page = lru_to_page(page_list);
+		if (nid == NUMA_NO_NODE)
+			nid = page_to_nid(page);
+
+		if (nid == page_to_nid(page)) {
+			ClearPageActive(page);
+			list_move(&page->lru, &node_page_list);
+			continue;
+		}
+
+		nr_reclaimed += reclaim_node_pages(&node_page_list, nid);
+		nid = NUMA_NO_NODE;
+	}
+
+	if (!list_empty(&node_page_list))
+		nr_reclaimed += reclaim_node_pages(&node_page_list, nid);
+
+	return nr_reclaimed;
+}
+
 /*
  * Attempt to remove the specified page from its LRU.  Only take this page
  * if it is of the appropriate PageActive status.  Pages which are being
@@ -2233,7 +2422,7 @@ static bool inactive_list_is_low(struct lruvec *lruvec, bool file,
 	active = lruvec_lru_size(lruvec, active_lru, sc->reclaim_idx);
 
 	if (memcg)
-		refaults = memcg_page_state(memcg, WORKINGSET_ACTIVATE);
+		refaults = memcg_page_state_local(memcg, WORKINGSET_ACTIVATE);
 	else
 		refaults = node_page_state(pgdat, WORKINGSET_ACTIVATE);
 
@@ -3004,7 +3193,7 @@ static void snapshot_refaults(struct mem_cgroup *root_memcg, pg_data_t *pgdat)
 		struct lruvec *lruvec;
 
 		if (memcg)
-			refaults = memcg_page_state(memcg, WORKINGSET_ACTIVATE);
+			refaults = memcg_page_state_local(memcg, WORKINGSET_ACTIVATE);
 		else
 			refaults = node_page_state(pgdat, WORKINGSET_ACTIVATE);
 
@@ -31,6 +31,7 @@
 #include <linux/atomic.h>
 #include <linux/frontswap.h>
 #include <linux/rbtree.h>
+#include <linux/llist.h>
 #include <linux/swap.h>
 #include <linux/crypto.h>
 #include <linux/mempool.h>
@@ -51,6 +52,8 @@ static u64 zswap_pool_total_size;
 static atomic_t zswap_stored_pages = ATOMIC_INIT(0);
 /* The number of same-value filled pages currently stored in zswap */
 static atomic_t zswap_same_filled_pages = ATOMIC_INIT(0);
+/* The number of pages queued for compression by the store workers */
+static atomic_t zswap_pending_pages = ATOMIC_INIT(0);
 
 /*
  * The statistics below are not protected from concurrent access for
@@ -123,6 +126,14 @@ static bool zswap_same_filled_pages_enabled = true;
 module_param_named(same_filled_pages_enabled, zswap_same_filled_pages_enabled,
 		   bool, 0644);
 
+/*
+ * Enable/disable handing pages off to the per-node store workers for
+ * compression instead of compressing them in the reclaiming task
+ * (disabled by default)
+ */
+static bool zswap_async_store_enabled;
+module_param_named(async_store_enabled, zswap_async_store_enabled, bool, 0644);
+
 /*********************************
 * data structures
 **********************************/
@@ -156,6 +167,12 @@ struct zswap_pool {
  * pool - the zswap_pool the entry's data is in
  * handle - zpool allocation handle that stores the compressed page data
  * value - value of the same-value filled pages which have same content
+ * swpentry - swap entry of a pending entry, used by the store worker
+ * page - for an entry still waiting to be compressed by a store worker,
+ *        the swap cache page holding its data.  No page reference is held:
+ *        the page stays under writeback for as long as the entry is on the
+ *        tree with page set, which keeps it from being freed or migrated.
+ * llnode - links a pending entry into its node's store queue
  */
 struct zswap_entry {
 	struct rb_node rbnode;
@@ -166,7 +183,10 @@ struct zswap_entry {
 	union {
 		unsigned long handle;
 		unsigned long value;
+		swp_entry_t swpentry;
 	};
+	struct page *page;
+	struct llist_node llnode;
 };
 
 struct zswap_header {
@@ -185,6 +205,22 @@ struct zswap_tree {
 
 static struct zswap_tree *zswap_trees[MAX_SWAPFILES];
 
+/*
+ * Per-node queue of entries waiting to be compressed.  A store worker
+ * drains the whole queue in one go, so the compression and zpool writes
+ * of a burst of swapouts are batched on the node that produced them.
+ */
+#define ZSWAP_STORE_QUEUE_MAX	256
+
+struct zswap_store_queue {
+	struct llist_head list;
+	atomic_t nr;
+	struct work_struct work;
+} ____cacheline_aligned_in_smp;
+
+static struct workqueue_struct *zswap_store_wq;
+static struct zswap_store_queue *zswap_store_queues;
+
 /* RCU-protected iteration */
 static LIST_HEAD(zswap_pools);
 /* protects zswap_pools list modification */
@@ -261,6 +297,7 @@ static struct zswap_entry *zswap_entry_cache_alloc(gfp_t gfp)
 	if (!entry)
 		return NULL;
 	entry->refcount = 1;
+	entry->page = NULL;
 	RB_CLEAR_NODE(&entry->rbnode);
 	return entry;
 }
@@ -331,7 +368,9 @@ static void zswap_rb_erase(struct rb_root *root, struct zswap_entry *entry)
  */
 static void zswap_free_entry(struct zswap_entry *entry)
 {
-	if (!entry->length)
+	if (entry->page)
+		atomic_dec(&zswap_pending_pages);
+	else if (!entry->length)
 		atomic_dec(&zswap_same_filled_pages);
 	else {
 		zpool_free(entry->pool->zpool, entry->handle);
@@ -990,6 +1029,216 @@ static void zswap_fill_page(void *ptr, unsigned long value)
 	memset_l(page, value, PAGE_SIZE / sizeof(unsigned long));
 }
 
+/*
+ * Compresses @page into a new allocation from @pool's zpool.  On success
+ * the handle and compressed length are returned through @handlep and
+ * @dlenp.
+ */
+static int zswap_compress_page(struct zswap_pool *pool, struct page *page,
+			       swp_entry_t swpentry, unsigned long *handlep,
+			       unsigned int *dlenp)
+{
+	struct zswap_header zhdr = { .swpentry = swpentry };
+	struct crypto_comp *tfm;
+	unsigned int hlen, dlen = PAGE_SIZE;
+	unsigned long handle;
+	char *buf;
+	u8 *src, *dst;
+	int ret;
+
+	/* compress */
+	dst = get_cpu_var(zswap_dstmem);
+	tfm = *get_cpu_ptr(pool->tfm);
+	src = kmap_atomic(page);
+	ret = crypto_comp_compress(tfm, src, PAGE_SIZE, dst, &dlen);
+	kunmap_atomic(src);
+	put_cpu_ptr(pool->tfm);
+	if (ret) {
+		ret = -EINVAL;
+		goto put_dstmem;
+	}
+
+	/* store */
+	hlen = zpool_evictable(pool->zpool) ? sizeof(zhdr) : 0;
+	ret = zpool_malloc(pool->zpool, hlen + dlen,
+			   __GFP_NORETRY | __GFP_NOWARN | __GFP_KSWAPD_RECLAIM,
+			   &handle);
+	if (ret == -ENOSPC) {
+		zswap_reject_compress_poor++;
+		goto put_dstmem;
+	}
+	if (ret) {
+		zswap_reject_alloc_fail++;
+		goto put_dstmem;
+	}
+	buf = zpool_map_handle(pool->zpool, handle, ZPOOL_MM_RW);
+	memcpy(buf, &zhdr, hlen);
+	memcpy(buf + hlen, dst, dlen);
+	zpool_unmap_handle(pool->zpool, handle);
+
+	*handlep = handle;
+	*dlenp = dlen;
+put_dstmem:
+	put_cpu_var(zswap_dstmem);
+	return ret;
+}
+
+/* caller must hold the tree lock */
+static void zswap_insert_entry(struct zswap_tree *tree,
+			       struct zswap_entry *entry)
+{
+	struct zswap_entry *dupentry;
+	int ret;
+
+	do {
+		ret = zswap_rb_insert(&tree->rbroot, entry, &dupentry);
+		if (ret == -EEXIST) {
+			zswap_duplicate_entry++;
+			/* remove from rbtree */
+			zswap_rb_erase(&tree->rbroot, dupentry);
+			zswap_entry_put(tree, dupentry);
+		}
+	} while (ret == -EEXIST);
+}
+
+/*
+ * The compression of a pending entry failed: take the entry off the tree,
+ * as it no longer pins its page, then redirty the page and end the
+ * writeback, as a failed swap device write does.  The data stays in the
+ * page, which remains in the swap cache until reclaim writes it out again.
+ * The page lock can't be taken here, its holder may be waiting for the
+ * writeback to end.
+ */
+static void zswap_store_fallback(struct zswap_tree *tree,
+				 struct zswap_entry *entry)
+{
+	struct page *page = entry->page;
+
+	spin_lock(&tree->lock);
+	if (!RB_EMPTY_NODE(&entry->rbnode)) {
+		zswap_rb_erase(&tree->rbroot, entry);
+		/* drop the tree's reference, the worker still holds one */
+		zswap_entry_put(tree, entry);
+	}
+	spin_unlock(&tree->lock);
+
+	set_page_dirty(page);
+	end_page_writeback(page);
+}
+
+/* compresses a pending entry and turns it into a regular one */
+static void zswap_store_pending(struct zswap_entry *entry)
+{
+	struct zswap_tree *tree = zswap_trees[swp_type(entry->swpentry)];
+	struct page *page = entry->page;
+	struct zswap_pool *pool;
+	bool stored = false;
+	unsigned long handle;
+	unsigned int dlen;
+	int ret = -EINVAL;
+
+	pool = zswap_pool_current_get();
+	if (pool) {
+		ret = zswap_compress_page(pool, page, entry->swpentry,
+					  &handle, &dlen);
+		if (ret)
+			zswap_pool_put(pool);
+	}
+	if (ret) {
+		zswap_store_fallback(tree, entry);
+		goto put;
+	}
+
+	spin_lock(&tree->lock);
+	/*
+	 * The entry may have been invalidated meanwhile, then it stays
+	 * pending and zswap_free_entry() accounts for it.
+	 */
+	if (!RB_EMPTY_NODE(&entry->rbnode)) {
+		entry->page = NULL;
+		entry->pool = pool;
+		entry->handle = handle;
+		entry->length = dlen;
+		atomic_dec(&zswap_pending_pages);
+		stored = true;
+	}
+	spin_unlock(&tree->lock);
+
+	if (!stored) {
+		zpool_free(pool->zpool, handle);
+		zswap_pool_put(pool);
+	}
+	/*
+	 * pageout() marked the page PageReclaim, so this rotates it to the
+	 * tail of the inactive list where the next reclaim pass frees it.
+	 */
+	end_page_writeback(page);
+put:
+	/* drop the store worker's reference */
+	spin_lock(&tree->lock);
+	zswap_entry_put(tree, entry);
+	spin_unlock(&tree->lock);
+}
+
+static void zswap_store_work(struct work_struct *work)
+{
+	struct zswap_store_queue *queue = container_of(work,
+			struct zswap_store_queue, work);
+	struct zswap_entry *entry, *next;
+	struct llist_node *list;
+
+	list = llist_reverse_order(llist_del_all(&queue->list));
+	llist_for_each_entry_safe(entry, next, list, llnode) {
+		atomic_dec(&queue->nr);
+		zswap_store_pending(entry);
+		cond_resched();
+	}
+}
+
+/*
+ * Queues @page for compression by the store worker of the local node.
+ * The entry is put on the tree right away, so that loads and invalidations
+ * see it.  No page reference is taken: the page is put under writeback,
+ * which keeps it in the swap cache, unchanged and skipped by reclaim until
+ * the worker is done with it, just like a page under swap device I/O.
+ * Returns false if the queue is full and the caller has to compress the
+ * page itself.
+ */
+static bool zswap_queue_store(struct zswap_tree *tree,
+			      struct zswap_entry *entry, unsigned type,
+			      pgoff_t offset, struct page *page)
+{
+	struct zswap_store_queue *queue;
+
+	if (!zswap_store_queues)
+		return false;
+	queue = &zswap_store_queues[numa_node_id()];
+	if (atomic_inc_return(&queue->nr) > ZSWAP_STORE_QUEUE_MAX) {
+		atomic_dec(&queue->nr);
+		return false;
+	}
+
+	entry->offset = offset;
+	entry->length = 0;
+	entry->swpentry = swp_entry(type, offset);
+	entry->page = page;
+
+	spin_lock(&tree->lock);
+	zswap_insert_entry(tree, entry);
+	/* reference for the store worker */
+	zswap_entry_get(entry);
+	spin_unlock(&tree->lock);
+
+	atomic_inc(&zswap_pending_pages);
+	atomic_inc(&zswap_stored_pages);
+	zswap_update_total_size();
+
+	set_page_writeback(page);
+	if (llist_add(&entry->llnode, &queue->list))
+		queue_work(zswap_store_wq, &queue->work);
+	return true;
+}
+
 /*********************************
 * frontswap hooks
 **********************************/
@@ -998,14 +1247,11 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 				struct page *page)
 {
 	struct zswap_tree *tree = zswap_trees[type];
-	struct zswap_entry *entry, *dupentry;
-	struct crypto_comp *tfm;
+	struct zswap_entry *entry;
 	int ret;
-	unsigned int hlen, dlen = PAGE_SIZE;
+	unsigned int dlen;
 	unsigned long handle, value;
-	char *buf;
-	u8 *src, *dst;
-	struct zswap_header zhdr = { .swpentry = swp_entry(type, offset) };
+	u8 *src;
 
 	/* THP isn't supported */
 	if (PageTransHuge(page)) {
@@ -1058,6 +1304,10 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 		kunmap_atomic(src);
 	}
 
+	if (zswap_async_store_enabled &&
+	    zswap_queue_store(tree, entry, type, offset, page))
+		return FRONTSWAP_STORE_ASYNC;
+
 	/* if entry is successfully added, it keeps the reference */
 	entry->pool = zswap_pool_current_get();
 	if (!entry->pool) {
@@ -1065,36 +1315,10 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 		goto freepage;
 	}
 
-	/* compress */
-	dst = get_cpu_var(zswap_dstmem);
-	tfm = *get_cpu_ptr(entry->pool->tfm);
-	src = kmap_atomic(page);
-	ret = crypto_comp_compress(tfm, src, PAGE_SIZE, dst, &dlen);
-	kunmap_atomic(src);
-	put_cpu_ptr(entry->pool->tfm);
-	if (ret) {
-		ret = -EINVAL;
-		goto put_dstmem;
-	}
-
-	/* store */
-	hlen = zpool_evictable(entry->pool->zpool) ? sizeof(zhdr) : 0;
-	ret = zpool_malloc(entry->pool->zpool, hlen + dlen,
-			   __GFP_NORETRY | __GFP_NOWARN | __GFP_KSWAPD_RECLAIM,
-			   &handle);
-	if (ret == -ENOSPC) {
-		zswap_reject_compress_poor++;
-		goto put_dstmem;
-	}
-	if (ret) {
-		zswap_reject_alloc_fail++;
-		goto put_dstmem;
-	}
-	buf = zpool_map_handle(entry->pool->zpool, handle, ZPOOL_MM_RW);
-	memcpy(buf, &zhdr, hlen);
-	memcpy(buf + hlen, dst, dlen);
-	zpool_unmap_handle(entry->pool->zpool, handle);
-	put_cpu_var(zswap_dstmem);
+	ret = zswap_compress_page(entry->pool, page, swp_entry(type, offset),
+				  &handle, &dlen);
+	if (ret)
+		goto put_pool;
 
 	/* populate entry */
 	entry->offset = offset;
@@ -1104,15 +1328,7 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 insert_entry:
 	/* map */
 	spin_lock(&tree->lock);
-	do {
-		ret = zswap_rb_insert(&tree->rbroot, entry, &dupentry);
-		if (ret == -EEXIST) {
-			zswap_duplicate_entry++;
-			/* remove from rbtree */
-			zswap_rb_erase(&tree->rbroot, dupentry);
-			zswap_entry_put(tree, dupentry);
-		}
-	} while (ret == -EEXIST);
+	zswap_insert_entry(tree, entry);
 	spin_unlock(&tree->lock);
 
 	/* update stats */
@@ -1121,8 +1337,7 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 
 	return 0;
 
-put_dstmem:
-	put_cpu_var(zswap_dstmem);
+put_pool:
 	zswap_pool_put(entry->pool);
 freepage:
 	zswap_entry_cache_free(entry);
@@ -1139,6 +1354,7 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 {
 	struct zswap_tree *tree = zswap_trees[type];
 	struct zswap_entry *entry;
+	struct page *pending;
 	struct crypto_comp *tfm;
 	u8 *src, *dst;
 	unsigned int dlen;
@@ -1152,8 +1368,25 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 		spin_unlock(&tree->lock);
 		return -1;
 	}
+	pending = entry->page;
 	spin_unlock(&tree->lock);
 
+	if (pending) {
+		/*
+		 * Not compressed yet.  The pending page stays in the swap
+		 * cache under writeback until the worker is done with it, so
+		 * a swapin finds it there rather than allocating a new page;
+		 * any other page can't be filled from it safely.
+		 */
+		ret = 0;
+		if (WARN_ON_ONCE(pending != page))
+			ret = -1;
+		spin_lock(&tree->lock);
+		zswap_entry_put(tree, entry);
+		spin_unlock(&tree->lock);
+		return ret;
+	}
+
 	if (!entry->length) {
 		dst = kmap_atomic(page);
 		zswap_fill_page(dst, entry->value);
@@ -1215,6 +1448,10 @@ static void zswap_frontswap_invalidate_area(unsigned type)
 	if (!tree)
 		return;
 
+	/* wait for the store workers to let go of the pending entries */
+	if (zswap_store_wq)
+		flush_workqueue(zswap_store_wq);
+
 	/* walk the tree and free everything */
 	spin_lock(&tree->lock);
 	rbtree_postorder_for_each_entry_safe(entry, n, &tree->rbroot, rbnode)
@@ -1285,6 +1522,8 @@ static int __init zswap_debugfs_init(void)
 				zswap_debugfs_root, &zswap_stored_pages);
 	debugfs_create_atomic_t("same_filled_pages", 0444,
 				zswap_debugfs_root, &zswap_same_filled_pages);
+	debugfs_create_atomic_t("pending_pages", 0444,
+				zswap_debugfs_root, &zswap_pending_pages);
 
 	return 0;
 }
@@ -1305,6 +1544,33 @@ static void __exit zswap_debugfs_exit(void) { }
 /*********************************
 * module init and exit
 **********************************/
+static void __init zswap_store_queues_init(void)
+{
+	int nid;
+
+	zswap_store_wq = alloc_workqueue("zswap-store",
+					 WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	if (!zswap_store_wq)
+		goto fail;
+
+	zswap_store_queues = kcalloc(nr_node_ids, sizeof(*zswap_store_queues),
+				     GFP_KERNEL);
+	if (!zswap_store_queues) {
+		destroy_workqueue(zswap_store_wq);
+		zswap_store_wq = NULL;
+		goto fail;
+	}
+
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		init_llist_head(&zswap_store_queues[nid].list);
+		atomic_set(&zswap_store_queues[nid].nr, 0);
+		INIT_WORK(&zswap_store_queues[nid].work, zswap_store_work);
+	}
+	return;
+fail:
+	pr_warn("store workers unavailable, pages are compressed synchronously\n");
+}
+
 static int __init init_zswap(void)
 {
 	struct zswap_pool *pool;
@@ -1342,6 +1608,8 @@ static int __init init_zswap(void)
 		zswap_enabled = false;
 	}
 
+	zswap_store_queues_init();
+
 	frontswap_register_ops(&zswap_frontswap_ops);
 	if (zswap_debugfs_init())
 		pr_warn("debugfs initialization failed\n");
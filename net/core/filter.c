@@ -3378,6 +3378,7 @@ static int xdp_do_generic_redirect_map(struct net_device *dev,
 	} else if (map->map_type == BPF_MAP_TYPE_XSKMAP) {
 		struct xdp_sock *xs = fwd;
 
+		sk_mark_napi_id_once(&xs->sk, skb);
 		err = xsk_generic_rcv(xs, xdp);
 		if (err)
 			goto err;
@@ -4998,7 +4999,7 @@ bool bpf_helper_changes_pkt_data(void *func)
 	return false;
 }
 
-static const struct bpf_func_proto *
+const struct bpf_func_proto *
 bpf_base_func_proto(enum bpf_func_id func_id)
 {
 	switch (func_id) {
@@ -5014,6 +5015,16 @@ bpf_base_func_proto(enum bpf_func_id func_id)
 		return &bpf_map_pop_elem_proto;
 	case BPF_FUNC_map_peek_elem:
 		return &bpf_map_peek_elem_proto;
+	case BPF_FUNC_ringbuf_output:
+		return &bpf_ringbuf_output_proto;
+	case BPF_FUNC_ringbuf_reserve:
+		return &bpf_ringbuf_reserve_proto;
+	case BPF_FUNC_ringbuf_submit:
+		return &bpf_ringbuf_submit_proto;
+	case BPF_FUNC_ringbuf_discard:
+		return &bpf_ringbuf_discard_proto;
+	case BPF_FUNC_ringbuf_query:
+		return &bpf_ringbuf_query_proto;
 	case BPF_FUNC_get_prandom_u32:
 		return &bpf_get_prandom_u32_proto;
 	case BPF_FUNC_get_smp_processor_id:
@@ -5817,6 +5828,16 @@ void bpf_warn_invalid_xdp_action(u32 act)
 }
 EXPORT_SYMBOL_GPL(bpf_warn_invalid_xdp_action);
 
+DEFINE_BPF_DISPATCHER(xdp)
+
+/* Called with the program a device runs in XDP_SETUP_PROG mode changing
+ * from @prev_prog to @prog, either of which may be NULL.
+ */
+void bpf_prog_change_xdp(struct bpf_prog *prev_prog, struct bpf_prog *prog)
+{
+	bpf_dispatcher_change_prog(BPF_DISPATCHER_PTR(xdp), prev_prog, prog);
+}
+
 static bool sock_addr_is_valid_access(int off, int size,
 				      enum bpf_access_type type,
 				      const struct bpf_prog *prog,
@@ -7659,4 +7680,231 @@ const struct bpf_verifier_ops sk_reuseport_verifier_ops = {
 
 const struct bpf_prog_ops sk_reuseport_prog_ops = {
 };
+
+DEFINE_STATIC_KEY_FALSE(bpf_sk_lookup_enabled);
+EXPORT_SYMBOL(bpf_sk_lookup_enabled);
+
+static DEFINE_MUTEX(sk_lookup_mutex);
+
+/* Called under rcu_read_lock() from the listener lookup. Returns the
+ * socket selected by the program, NULL to fall back to the regular
+ * lookup, or an error pointer if the program refused the connection.
+ */
+struct sock *bpf_run_sk_lookup(struct bpf_sk_lookup_kern *ctx)
+{
+	struct bpf_prog *prog;
+	u32 action;
+
+	prog = rcu_dereference(ctx->net->sk_lookup_prog);
+	if (!prog)
+		return NULL;
+
+	ctx->selected_sk = NULL;
+	action = BPF_PROG_RUN(prog, ctx);
+	if (action == SK_DROP)
+		return ERR_PTR(-ECONNREFUSED);
+
+	return ctx->selected_sk;
+}
+EXPORT_SYMBOL_GPL(bpf_run_sk_lookup);
+
+int sk_lookup_bpf_prog_attach(const union bpf_attr *attr,
+			      struct bpf_prog *prog)
+{
+	struct bpf_prog *attached;
+	struct net *net;
+
+	net = current->nsproxy->net_ns;
+	mutex_lock(&sk_lookup_mutex);
+	attached = rcu_dereference_protected(net->sk_lookup_prog,
+					     lockdep_is_held(&sk_lookup_mutex));
+	if (attached) {
+		/* Only one BPF program can be attached at a time */
+		mutex_unlock(&sk_lookup_mutex);
+		return -EEXIST;
+	}
+	rcu_assign_pointer(net->sk_lookup_prog, prog);
+	static_branch_inc(&bpf_sk_lookup_enabled);
+	mutex_unlock(&sk_lookup_mutex);
+	return 0;
+}
+
+static int __sk_lookup_bpf_prog_detach(struct net *net)
+{
+	struct bpf_prog *attached;
+
+	mutex_lock(&sk_lookup_mutex);
+	attached = rcu_dereference_protected(net->sk_lookup_prog,
+					     lockdep_is_held(&sk_lookup_mutex));
+	if (!attached) {
+		mutex_unlock(&sk_lookup_mutex);
+		return -ENOENT;
+	}
+	RCU_INIT_POINTER(net->sk_lookup_prog, NULL);
+	static_branch_dec(&bpf_sk_lookup_enabled);
+	bpf_prog_put(attached);
+	mutex_unlock(&sk_lookup_mutex);
+	return 0;
+}
+
+int sk_lookup_bpf_prog_detach(const union bpf_attr *attr)
+{
+	return __sk_lookup_bpf_prog_detach(current->nsproxy->net_ns);
+}
+
+static void __net_exit sk_lookup_net_exit(struct net *net)
+{
+	__sk_lookup_bpf_prog_detach(net);
+}
+
+static struct pernet_operations sk_lookup_net_ops = {
+	.exit = sk_lookup_net_exit,
+};
+
+static int __init sk_lookup_init(void)
+{
+	return register_pernet_subsys(&sk_lookup_net_ops);
+}
+subsys_initcall(sk_lookup_init);
+
+BPF_CALL_4(sk_lookup_assign, struct bpf_sk_lookup_kern *, ctx,
+	   struct bpf_map *, map, void *, key, u64, flags)
+{
+	struct sock *sk;
+
+	if (unlikely(flags))
+		return -EINVAL;
+
+	sk = map->ops->map_lookup_elem(map, key);
+	if (!sk)
+		return -ENOENT;
+
+	if (!net_eq(sock_net(sk), ctx->net))
+		return -EINVAL;
+	if (sk->sk_protocol != ctx->protocol)
+		return -EPROTOTYPE;
+	/* A dual stack IPv6 listener may serve IPv4 requests */
+	if (sk->sk_family != ctx->family &&
+	    !(ctx->family == AF_INET && sk->sk_family == AF_INET6 &&
+	      !ipv6_only_sock(sk)))
+		return -EAFNOSUPPORT;
+	if (sk->sk_state != TCP_LISTEN)
+		return -ESOCKTNOSUPPORT;
+
+	ctx->selected_sk = sk;
+
+	return 0;
+}
+
+static const struct bpf_func_proto sk_lookup_assign_proto = {
+	.func		= sk_lookup_assign,
+	.gpl_only	= false,
+	.ret_type	= RET_INTEGER,
+	.arg1_type	= ARG_PTR_TO_CTX,
+	.arg2_type	= ARG_CONST_MAP_PTR,
+	.arg3_type	= ARG_PTR_TO_MAP_KEY,
+	.arg4_type	= ARG_ANYTHING,
+};
+
+static const struct bpf_func_proto *
+sk_lookup_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
+{
+	switch (func_id) {
+	case BPF_FUNC_sk_lookup_assign:
+		return &sk_lookup_assign_proto;
+	default:
+		return bpf_base_func_proto(func_id);
+	}
+}
+
+static bool sk_lookup_is_valid_access(int off, int size,
+				      enum bpf_access_type type,
+				      const struct bpf_prog *prog,
+				      struct bpf_insn_access_aux *info)
+{
+	if (off < 0 || off >= sizeof(struct bpf_sk_lookup) ||
+	    off % size || type != BPF_READ)
+		return false;
+
+	switch (off) {
+	case offsetof(struct bpf_sk_lookup, family):
+	case offsetof(struct bpf_sk_lookup, protocol):
+	case offsetof(struct bpf_sk_lookup, remote_ip4):
+	case offsetof(struct bpf_sk_lookup, local_ip4):
+	case bpf_ctx_range_till(struct bpf_sk_lookup,
+				remote_ip6[0], remote_ip6[3]):
+	case bpf_ctx_range_till(struct bpf_sk_lookup,
+				local_ip6[0], local_ip6[3]):
+	case offsetof(struct bpf_sk_lookup, remote_port):
+	case offsetof(struct bpf_sk_lookup, local_port):
+		return size == sizeof(__u32);
+	default:
+		return false;
+	}
+}
+
+#define SK_LOOKUP_LOAD_FIELD(F, EXTRA_OFF)				\
+	(*insn++ = BPF_LDX_MEM(BPF_FIELD_SIZEOF(struct bpf_sk_lookup_kern, F), \
+			       si->dst_reg, si->src_reg,		\
+			       offsetof(struct bpf_sk_lookup_kern, F) + \
+			       (EXTRA_OFF)))
+
+static u32 sk_lookup_convert_ctx_access(enum bpf_access_type type,
+					const struct bpf_insn *si,
+					struct bpf_insn *insn_buf,
+					struct bpf_prog *prog,
+					u32 *target_size)
+{
+	struct bpf_insn *insn = insn_buf;
+	int off;
+
+	switch (si->off) {
+	case offsetof(struct bpf_sk_lookup, family):
+		SK_LOOKUP_LOAD_FIELD(family, 0);
+		break;
+
+	case offsetof(struct bpf_sk_lookup, protocol):
+		SK_LOOKUP_LOAD_FIELD(protocol, 0);
+		break;
+
+	case offsetof(struct bpf_sk_lookup, remote_ip4):
+		SK_LOOKUP_LOAD_FIELD(v4.saddr, 0);
+		break;
+
+	case offsetof(struct bpf_sk_lookup, local_ip4):
+		SK_LOOKUP_LOAD_FIELD(v4.daddr, 0);
+		break;
+
+	case bpf_ctx_range_till(struct bpf_sk_lookup,
+				remote_ip6[0], remote_ip6[3]):
+		off = si->off - offsetof(struct bpf_sk_lookup, remote_ip6[0]);
+		SK_LOOKUP_LOAD_FIELD(v6.saddr.s6_addr32[0], off);
+		break;
+
+	case bpf_ctx_range_till(struct bpf_sk_lookup,
+				local_ip6[0], local_ip6[3]):
+		off = si->off - offsetof(struct bpf_sk_lookup, local_ip6[0]);
+		SK_LOOKUP_LOAD_FIELD(v6.daddr.s6_addr32[0], off);
+		break;
+
+	case offsetof(struct bpf_sk_lookup, remote_port):
+		SK_LOOKUP_LOAD_FIELD(sport, 0);
+		break;
+
+	case offsetof(struct bpf_sk_lookup, local_port):
+		SK_LOOKUP_LOAD_FIELD(dport, 0);
+		break;
+	}
+
+	return insn - insn_buf;
+}
+
+const struct bpf_verifier_ops sk_lookup_verifier_ops = {
+	.get_func_proto		= sk_lookup_func_proto,
+	.is_valid_access	= sk_lookup_is_valid_access,
+	.convert_ctx_access	= sk_lookup_convert_ctx_access,
+};
+
+const struct bpf_prog_ops sk_lookup_prog_ops = {
+};
 #endif /* CONFIG_INET */
@@ -12,6 +12,7 @@
 #include <linux/dma-direction.h>
 #include <linux/dma-mapping.h>
 #include <linux/page-flags.h>
+#include <linux/poison.h>
 #include <linux/mm.h> /* for __put_page() */
 
 static int page_pool_init(struct page_pool *pool,
@@ -43,6 +44,8 @@ static int page_pool_init(struct page_pool *pool,
 	if (ptr_ring_init(&pool->ring, ring_qsize, GFP_KERNEL) < 0)
 		return -ENOMEM;
 
+	refcount_set(&pool->users, 1);
+
 	return 0;
 }
 
@@ -71,10 +74,6 @@ static struct page *__page_pool_get_cached(struct page_pool *pool)
 	struct ptr_ring *r = &pool->ring;
 	struct page *page;
 
-	/* Quicker fallback, avoid locks when ring is empty */
-	if (__ptr_ring_empty(r))
-		return NULL;
-
 	/* Test for safe-context, caller should provide this guarantee */
 	if (likely(in_serving_softirq())) {
 		if (likely(pool->alloc.count)) {
@@ -82,6 +81,11 @@ static struct page *__page_pool_get_cached(struct page_pool *pool)
 			page = pool->alloc.cache[--pool->alloc.count];
 			return page;
 		}
+
+		/* Quicker fallback, avoid locks when ring is empty */
+		if (__ptr_ring_empty(r))
+			return NULL;
+
 		/* Slower-path: Alloc array empty, time to refill
 		 *
 		 * Open-coded bulk ptr_ring consumer.
@@ -101,58 +105,131 @@ static struct page *__page_pool_get_cached(struct page_pool *pool)
 		return page;
 	}
 
+	if (__ptr_ring_empty(r))
+		return NULL;
+
 	/* Slow-path: Get page from locked ring queue */
 	page = ptr_ring_consume(&pool->ring);
 	return page;
 }
 
-/* slow path */
-noinline
-static struct page *__page_pool_alloc_pages_slow(struct page_pool *pool,
-						 gfp_t _gfp)
+static bool page_pool_dma_map(struct page_pool *pool, struct page *page)
 {
-	struct page *page;
-	gfp_t gfp = _gfp;
 	dma_addr_t dma;
 
+	/* Setup DMA mapping: use page->private for DMA-addr
+	 * This mapping is kept for lifetime of page, until leaving pool.
+	 */
+	dma = dma_map_page(pool->p.dev, page, 0,
+			   (PAGE_SIZE << pool->p.order),
+			   pool->p.dma_dir);
+	if (dma_mapping_error(pool->p.dev, dma))
+		return false;
+
+	set_page_private(page, dma); /* page->private = dma; */
+	return true;
+}
+
+static void page_pool_set_pp_info(struct page_pool *pool,
+				  struct page *page)
+{
+	refcount_inc(&pool->users);
+	page->pp = pool;
+	page->pp_magic = PP_SIGNATURE;
+}
+
+static void page_pool_clear_pp_info(struct page *page)
+{
+	page->pp_magic = 0;
+	page->pp = NULL;
+}
+
+static void page_pool_free(struct page_pool *pool)
+{
+	ptr_ring_cleanup(&pool->ring, NULL);
+	kfree(pool);
+}
+
+static void page_pool_put_users(struct page_pool *pool)
+{
+	if (refcount_dec_and_test(&pool->users))
+		page_pool_free(pool);
+}
+
+static struct page *__page_pool_alloc_page_order(struct page_pool *pool,
+						 gfp_t gfp)
+{
+	struct page *page;
+
 	/* We could always set __GFP_COMP, and avoid this branch, as
 	 * prep_new_page() can handle order-0 with __GFP_COMP.
 	 */
 	if (pool->p.order)
 		gfp |= __GFP_COMP;
 
-	/* FUTURE development:
-	 *
-	 * Current slow-path essentially falls back to single page
-	 * allocations, which doesn't improve performance.  This code
-	 * need bulk allocation support from the page allocator code.
-	 */
-
-	/* Cache was empty, do real allocation */
 	page = alloc_pages_node(pool->p.nid, gfp, pool->p.order);
 	if (!page)
 		return NULL;
 
-	if (!(pool->p.flags & PP_FLAG_DMA_MAP))
-		goto skip_dma_map;
-
-	/* Setup DMA mapping: use page->private for DMA-addr
-	 * This mapping is kept for lifetime of page, until leaving pool.
-	 */
-	dma = dma_map_page(pool->p.dev, page, 0,
-			   (PAGE_SIZE << pool->p.order),
-			   pool->p.dma_dir);
-	if (dma_mapping_error(pool->p.dev, dma)) {
+	if ((pool->p.flags & PP_FLAG_DMA_MAP) &&
+	    unlikely(!page_pool_dma_map(pool, page))) {
 		put_page(page);
 		return NULL;
 	}
-	set_page_private(page, dma); /* page->private = dma; */
+	page_pool_set_pp_info(pool, page);
 
-skip_dma_map:
 	/* When page just alloc'ed is should/must have refcnt 1. */
 	return page;
 }
 
+/* slow path */
+noinline
+static struct page *__page_pool_alloc_pages_slow(struct page_pool *pool,
+						 gfp_t gfp)
+{
+	const int bulk = PP_ALLOC_CACHE_REFILL;
+	struct page *page;
+	int i, nr_pages;
+
+	/* Bulk refill needs the alloc cache, which is only safe to touch
+	 * from softirq context, and does not handle high-order pages.
+	 */
+	if (unlikely(pool->p.order || !in_serving_softirq()))
+		return __page_pool_alloc_page_order(pool, gfp);
+
+	/* Unnecessary as alloc cache is empty, but guarantees zero count */
+	if (unlikely(pool->alloc.count > 0))
+		return pool->alloc.cache[--pool->alloc.count];
+
+	/* Mark empty alloc.cache slots "empty" for alloc_pages_bulk_array */
+	memset(&pool->alloc.cache, 0, sizeof(void *) * bulk);
+
+	nr_pages = alloc_pages_bulk_array_node(gfp, pool->p.nid, bulk,
+					       (struct page **)pool->alloc.cache);
+	if (unlikely(!nr_pages))
+		return NULL;
+
+	/* Pages have been filled into alloc.cache, but count is zero and
+	 * the pages have not been DMA mapped yet.
+	 */
+	for (i = 0; i < nr_pages; i++) {
+		page = pool->alloc.cache[i];
+		if ((pool->p.flags & PP_FLAG_DMA_MAP) &&
+		    unlikely(!page_pool_dma_map(pool, page))) {
+			put_page(page);
+			continue;
+		}
+		page_pool_set_pp_info(pool, page);
+		pool->alloc.cache[pool->alloc.count++] = page;
+	}
+
+	/* Return last page */
+	if (likely(pool->alloc.count > 0))
+		return pool->alloc.cache[--pool->alloc.count];
+
+	return NULL;
+}
+
 /* For using page_pool replace: alloc_pages() API calls, but provide
  * synchronization guarantee for allocation side.
  */
@@ -171,17 +248,21 @@ struct page *page_pool_alloc_pages(struct page_pool *pool, gfp_t gfp)
 }
 EXPORT_SYMBOL(page_pool_alloc_pages);
 
-/* Cleanup page_pool state from page */
+/* Cleanup page_pool state from page.  The page leaves the pool, and
+ * may drop the last reference on the pool.
+ */
 static void __page_pool_clean_page(struct page_pool *pool,
 				   struct page *page)
 {
-	if (!(pool->p.flags & PP_FLAG_DMA_MAP))
-		return;
+	if (pool->p.flags & PP_FLAG_DMA_MAP) {
+		/* DMA unmap */
+		dma_unmap_page(pool->p.dev, page_private(page),
+			       PAGE_SIZE << pool->p.order, pool->p.dma_dir);
+		set_page_private(page, 0);
+	}
 
-	/* DMA unmap */
-	dma_unmap_page(pool->p.dev, page_private(page),
-		       PAGE_SIZE << pool->p.order, pool->p.dma_dir);
-	set_page_private(page, 0);
+	page_pool_clear_pp_info(page);
+	page_pool_put_users(pool);
 }
 
 /* Return a page to the page allocator, cleaning up our state */
@@ -264,6 +345,90 @@ void __page_pool_put_page(struct page_pool *pool,
 }
 EXPORT_SYMBOL(__page_pool_put_page);
 
+/* Called when an skb marked with skb_mark_for_recycle() releases a
+ * page.  Returns false if the page does not belong to a page_pool, in
+ * which case the caller must release it with put_page().
+ */
+bool page_pool_return_skb_page(struct page *page)
+{
+	struct page_pool *pool;
+
+	page = compound_head(page);
+	if (unlikely(page->pp_magic != PP_SIGNATURE))
+		return false;
+
+	pool = page->pp;
+
+	/* The ptr_ring producer lock cannot be taken from hardirq, and
+	 * nobody consumes the ring of a destroyed pool.  The rcu read
+	 * section orders the destroyed check against the final ring
+	 * cleanup in __page_pool_destroy_rcu().
+	 */
+	rcu_read_lock();
+	if (unlikely(in_irq() || irqs_disabled() ||
+		     READ_ONCE(pool->destroyed))) {
+		__page_pool_clean_page(pool, page);
+		put_page(page);
+	} else {
+		__page_pool_put_page(pool, page, false);
+	}
+	rcu_read_unlock();
+
+	return true;
+}
+EXPORT_SYMBOL(page_pool_return_skb_page);
+
+/* Bulk variant of __page_pool_put_page(), for returning a batch of pages
+ * that all belong to @pool, e.g. on TX completion of XDP_REDIRECT'ed
+ * frames.  Pages owned by the pool (refcnt == 1) keep their DMA mapping
+ * and are placed in the ptr_ring under a single producer_lock, instead
+ * of taking the lock once per page.  Pages that do not fit in the ring
+ * are released to the page allocator.
+ */
+void page_pool_put_page_bulk(struct page_pool *pool, void **data,
+			     int count)
+{
+	int i, bulk_len = 0;
+	bool in_softirq;
+
+	for (i = 0; i < count; i++) {
+		struct page *page = virt_to_head_page(data[i]);
+
+		if (likely(page_ref_count(page) == 1)) {
+			data[bulk_len++] = page;
+			continue;
+		}
+		/* Elevated refcnt, see __page_pool_put_page() */
+		__page_pool_clean_page(pool, page);
+		put_page(page);
+	}
+
+	if (unlikely(!bulk_len))
+		return;
+
+	/* Bulk producer into ptr_ring page_pool cache */
+	in_softirq = in_serving_softirq();
+	if (in_softirq)
+		spin_lock(&pool->ring.producer_lock);
+	else
+		spin_lock_bh(&pool->ring.producer_lock);
+
+	for (i = 0; i < bulk_len; i++) {
+		if (__ptr_ring_produce(&pool->ring, data[i]))
+			break; /* ring full */
+	}
+
+	if (in_softirq)
+		spin_unlock(&pool->ring.producer_lock);
+	else
+		spin_unlock_bh(&pool->ring.producer_lock);
+
+	/* Hopefully all pages were returned into the ptr_ring */
+	for (; i < bulk_len; i++)
+		__page_pool_return_page(pool, data[i]);
+}
+EXPORT_SYMBOL(page_pool_put_page_bulk);
+
 static void __page_pool_empty_ring(struct page_pool *pool)
 {
 	struct page *page;
@@ -287,9 +452,11 @@ static void __page_pool_destroy_rcu(struct rcu_head *rcu)
 
 	WARN(pool->alloc.count, "API usage violation");
 
+	/* Catch skb pages recycled before they saw pool->destroyed */
 	__page_pool_empty_ring(pool);
-	ptr_ring_cleanup(&pool->ring, NULL);
-	kfree(pool);
+
+	/* Pages still in-flight in skbs keep the pool alive */
+	page_pool_put_users(pool);
 }
 
 /* Cleanup and release resources */
@@ -309,6 +476,7 @@ void page_pool_destroy(struct page_pool *pool)
 	/* No more consumers should exist, but producers could still
 	 * be in-flight.
 	 */
+	WRITE_ONCE(pool->destroyed, true);
 	__page_pool_empty_ring(pool);
 
 	/* An xdp_mem_allocator can still ref page_pool pointer */
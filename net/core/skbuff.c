@@ -253,6 +253,30 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 }
 EXPORT_SYMBOL(__alloc_skb);
 
+/* Caller must provide SKB that is memset cleared */
+static void __build_skb_around(struct sk_buff *skb, void *data,
+			       unsigned int frag_size)
+{
+	struct skb_shared_info *shinfo;
+	unsigned int size = frag_size ? : ksize(data);
+
+	size -= SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+
+	skb->truesize = SKB_TRUESIZE(size);
+	refcount_set(&skb->users, 1);
+	skb->head = data;
+	skb->data = data;
+	skb_reset_tail_pointer(skb);
+	skb->end = skb->tail + size;
+	skb->mac_header = (typeof(skb->mac_header))~0U;
+	skb->transport_header = (typeof(skb->transport_header))~0U;
+
+	/* make sure we initialize shinfo sequentially */
+	shinfo = skb_shinfo(skb);
+	memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
+	atomic_set(&shinfo->dataref, 1);
+}
+
 /**
  * __build_skb - build a network buffer
  * @data: data buffer provided by caller
@@ -274,30 +298,14 @@ EXPORT_SYMBOL(__alloc_skb);
  */
 struct sk_buff *__build_skb(void *data, unsigned int frag_size)
 {
-	struct skb_shared_info *shinfo;
 	struct sk_buff *skb;
-	unsigned int size = frag_size ? : ksize(data);
 
 	skb = kmem_cache_alloc(skbuff_head_cache, GFP_ATOMIC);
 	if (!skb)
 		return NULL;
 
-	size -= SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
-
 	memset(skb, 0, offsetof(struct sk_buff, tail));
-	skb->truesize = SKB_TRUESIZE(size);
-	refcount_set(&skb->users, 1);
-	skb->head = data;
-	skb->data = data;
-	skb_reset_tail_pointer(skb);
-	skb->end = skb->tail + size;
-	skb->mac_header = (typeof(skb->mac_header))~0U;
-	skb->transport_header = (typeof(skb->transport_header))~0U;
-
-	/* make sure we initialize shinfo sequentially */
-	shinfo = skb_shinfo(skb);
-	memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
-	atomic_set(&shinfo->dataref, 1);
+	__build_skb_around(skb, data, frag_size);
 
 	return skb;
 }
@@ -320,6 +328,32 @@ struct sk_buff *build_skb(void *data, unsigned int frag_size)
 }
 EXPORT_SYMBOL(build_skb);
 
+/**
+ * build_skb_around - build a network buffer around provided skb
+ * @skb: sk_buff provide by caller, must be memset cleared
+ * @data: data buffer provided by caller
+ * @frag_size: size of data, or 0 if head was kmalloced
+ *
+ * Like build_skb(), for callers that allocate the sk_buff themselves,
+ * e.g. in bulk from skbuff_head_cache.
+ */
+struct sk_buff *build_skb_around(struct sk_buff *skb,
+				 void *data, unsigned int frag_size)
+{
+	if (unlikely(!skb))
+		return NULL;
+
+	__build_skb_around(skb, data, frag_size);
+
+	if (frag_size) {
+		skb->head_frag = 1;
+		if (page_is_pfmemalloc(virt_to_head_page(data)))
+			skb->pfmemalloc = 1;
+	}
+	return skb;
+}
+EXPORT_SYMBOL(build_skb_around);
+
 #define NAPI_SKB_CACHE_SIZE	64
 
 struct napi_alloc_cache {
@@ -544,10 +578,13 @@ static void skb_free_head(struct sk_buff *skb)
 {
 	unsigned char *head = skb->head;
 
-	if (skb->head_frag)
+	if (skb->head_frag) {
+		if (skb_pp_recycle(skb, head))
+			return;
 		skb_free_frag(head);
-	else
+	} else {
 		kfree(head);
+	}
 }
 
 static void skb_release_data(struct sk_buff *skb)
@@ -561,7 +598,7 @@ static void skb_release_data(struct sk_buff *skb)
 		return;
 
 	for (i = 0; i < shinfo->nr_frags; i++)
-		__skb_frag_unref(&shinfo->frags[i]);
+		skb_frag_unref(skb, i);
 
 	if (shinfo->frag_list)
 		kfree_skb_list(shinfo->frag_list);
@@ -1022,6 +1059,12 @@ static bool skb_zerocopy_notify_extend(struct sk_buff *skb, u32 lo, u16 len)
 	if (sum_len >= (1ULL << 32))
 		return false;
 
+	/* a retransmitted skb may complete after the ones sent behind it */
+	if (lo + len == old_lo) {
+		serr->ee.ee_info = lo;
+		return true;
+	}
+
 	if (lo != old_hi + 1)
 		return false;
 
@@ -3104,6 +3147,9 @@ int skb_shift(struct sk_buff *tgt, struct sk_buff *skb, int shiftlen)
 		return 0;
 	if (skb_zcopy(tgt) || skb_zcopy(skb))
 		return 0;
+	/* Frags must not move between recycling and non-recycling skbs */
+	if (skb_pp_recycle_mismatch(tgt, skb))
+		return 0;
 
 	todo = shiftlen;
 	from = 0;
@@ -3773,6 +3819,10 @@ int skb_gro_receive(struct sk_buff *p, struct sk_buff *skb)
 	if (unlikely(p->len + len >= 65536))
 		return -E2BIG;
 
+	/* Do not mix page_pool recycled frags with regular ones */
+	if (unlikely(skb_pp_recycle_mismatch(p, skb)))
+		return -ETOOMANYREFS;
+
 	lp = NAPI_GRO_CB(p)->last;
 	pinfo = skb_shinfo(lp);
 
@@ -3878,7 +3928,8 @@ void __init skb_init(void)
 	skbuff_head_cache = kmem_cache_create_usercopy("skbuff_head_cache",
 					      sizeof(struct sk_buff),
 					      0,
-					      SLAB_HWCACHE_ALIGN|SLAB_PANIC,
+					      SLAB_HWCACHE_ALIGN|SLAB_PANIC|
+					      SLAB_CPU_ARRAY,
 					      offsetof(struct sk_buff, cb),
 					      sizeof_field(struct sk_buff, cb),
 					      NULL);
@@ -4197,6 +4248,65 @@ struct sk_buff *sock_dequeue_err_skb(struct sock *sk)
 }
 EXPORT_SYMBOL(sock_dequeue_err_skb);
 
+/**
+ * sock_zerocopy_reap - move MSG_ZEROCOPY completions to user memory
+ * @sk: socket
+ * @ubuf: user buffer that receives the notifications
+ *
+ * Dequeues the zerocopy notifications found at the head of the error
+ * queue, stopping at the first entry of any other kind so that ordering
+ * with regard to those is preserved.
+ */
+int sock_zerocopy_reap(struct sock *sk, struct zerocopy_notif_buf __user *ubuf)
+{
+	struct sk_buff_head *q = &sk->sk_error_queue;
+	struct zerocopy_notif notif = {};
+	struct sock_exterr_skb *serr;
+	struct sk_buff *skb, *skb_next;
+	unsigned long flags;
+	u32 nr, count = 0;
+	int err = 0;
+
+	if (get_user(nr, &ubuf->nr))
+		return -EFAULT;
+
+	while (count < nr) {
+		spin_lock_irqsave(&q->lock, flags);
+		skb = skb_peek(q);
+		if (skb && SKB_EXT_ERR(skb)->ee.ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+			__skb_unlink(skb, q);
+			skb_next = skb_peek(q);
+			if (is_icmp_err_skb(skb_next))
+				sk->sk_err = SKB_EXT_ERR(skb_next)->ee.ee_origin;
+		} else {
+			skb = NULL;
+		}
+		spin_unlock_irqrestore(&q->lock, flags);
+
+		if (!skb)
+			break;
+
+		serr = SKB_EXT_ERR(skb);
+		notif.lo = serr->ee.ee_info;
+		notif.hi = serr->ee.ee_data;
+		notif.code = serr->ee.ee_code;
+		if (copy_to_user(&ubuf->notif[count], &notif, sizeof(notif))) {
+			skb_queue_head(q, skb);
+			err = -EFAULT;
+			break;
+		}
+		consume_skb(skb);
+		count++;
+	}
+
+	if (count && !skb_queue_empty(q))
+		sk->sk_error_report(sk);
+
+	if (put_user(count, &ubuf->count))
+		return -EFAULT;
+	return err;
+}
+
 /**
  * skb_clone_sk - create clone of skb, and take reference to socket
  * @skb: the skb to clone
@@ -4778,6 +4888,8 @@ bool skb_try_coalesce(struct sk_buff *to, struct sk_buff *from,
 		return false;
 	if (skb_zcopy(to) || skb_zcopy(from))
 		return false;
+	if (skb_pp_recycle_mismatch(to, from))
+		return false;
 
 	if (skb_headlen(from) != 0) {
 		struct page *page;
@@ -407,6 +407,32 @@ static int sk_psock_skb_ingress(struct sk_psock *psock, struct sk_buff *skb)
 	return copied;
 }
 
+/*
+ * Queue a redirected skb on the target right away instead of through the
+ * backlog work, provided nothing is waiting ahead of it and the target is
+ * not owned by a user.  Only a trylock: the caller holds the lock of the
+ * source socket, and redirects may well go both ways.
+ */
+static bool sk_psock_skb_ingress_direct(struct sk_psock *psock,
+					struct sk_buff *skb)
+{
+	struct sock *sk = psock->sk;
+	bool done = false;
+
+	local_bh_disable();
+	if (!spin_trylock(&sk->sk_lock.slock))
+		goto out;
+
+	if (!sock_owned_by_user(sk) && sk->sk_socket &&
+	    !psock->work_state.skb && skb_queue_empty(&psock->ingress_skb))
+		done = sk_psock_skb_ingress(psock, skb) > 0;
+
+	spin_unlock(&sk->sk_lock.slock);
+out:
+	local_bh_enable();
+	return done;
+}
+
 static int sk_psock_handle_skb(struct sk_psock *psock, struct sk_buff *skb,
 			       u32 off, u32 len, bool ingress)
 {
@@ -684,6 +710,8 @@ static void sk_psock_verdict_apply(struct sk_psock *psock,
 		     sk_other->sk_rcvbuf)) {
 			if (!ingress)
 				skb_set_owner_w(skb, sk_other);
+			else if (sk_psock_skb_ingress_direct(psock_other, skb))
+				break;
 			skb_queue_tail(&psock_other->ingress_skb, skb);
 			schedule_work(&psock_other->work);
 			break;
@@ -2132,6 +2132,13 @@ int __sock_cmsg_send(struct sock *sk, struct msghdr *msg, struct cmsghdr *cmsg,
 			return -EINVAL;
 		sockc->transmit_time = get_unaligned((u64 *)CMSG_DATA(cmsg));
 		break;
+	case SCM_ZEROCOPY_NOTIF:
+		if (!sock_flag(sk, SOCK_ZEROCOPY))
+			return -EINVAL;
+		if (cmsg->cmsg_len != CMSG_LEN(sizeof(u64)))
+			return -EINVAL;
+		return sock_zerocopy_reap(sk,
+			u64_to_user_ptr(get_unaligned((u64 *)CMSG_DATA(cmsg))));
 	/* SCM_RIGHTS and SCM_CREDENTIALS are semantically in SOL_UNIX. */
 	case SCM_RIGHTS:
 	case SCM_CREDENTIALS:
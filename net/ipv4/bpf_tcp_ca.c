@@ -0,0 +1,484 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bpf_tcp_ca.c: TCP congestion controls implemented by BPF programs
+ *
+ * Each op of struct tcp_congestion_ops is implemented by a
+ * BPF_PROG_TYPE_STRUCT_OPS program, loaded with attach_func_name naming
+ * the op. The JIT generates a trampoline per op, a native function with
+ * the op's prototype that runs the program on the u64 array of its
+ * arguments and returns what the program returned. A
+ * BPF_MAP_TYPE_STRUCT_OPS map ties the programs together and registers
+ * the result with tcp_register_congestion_control().
+ */
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <linux/moduleloader.h>
+#include <linux/refcount.h>
+#include <net/tcp.h>
+
+struct bpf_tcp_ca_op {
+	const char *name;
+	/* offset of the op in struct tcp_congestion_ops */
+	u32 koff;
+	/* offset of its program fd in struct bpf_tcp_congestion_ops */
+	u32 uoff;
+	/* arguments, including the socket */
+	u32 nr_args;
+	/* size of the argument after the socket, if narrower than a u32 */
+	u32 arg1_size;
+};
+
+#define BPF_TCP_CA_OP(op, n) {					\
+	.name = #op,						\
+	.koff = offsetof(struct tcp_congestion_ops, op),	\
+	.uoff = offsetof(struct bpf_tcp_congestion_ops, op),	\
+	.nr_args = n,						\
+	.arg1_size = sizeof(u32),				\
+}
+
+#define BPF_TCP_CA_OP_ARG1(op, n, size) {			\
+	.name = #op,						\
+	.koff = offsetof(struct tcp_congestion_ops, op),	\
+	.uoff = offsetof(struct bpf_tcp_congestion_ops, op),	\
+	.nr_args = n,						\
+	.arg1_size = size,					\
+}
+
+/* cong_control and get_info take pointers to structures that are not
+ * exposed to programs, so they cannot be implemented in BPF yet.
+ */
+static const struct bpf_tcp_ca_op bpf_tcp_ca_ops[] = {
+	BPF_TCP_CA_OP(init, 1),
+	BPF_TCP_CA_OP(release, 1),
+	BPF_TCP_CA_OP(ssthresh, 1),
+	BPF_TCP_CA_OP(cong_avoid, 3),
+	BPF_TCP_CA_OP_ARG1(set_state, 2, sizeof(u8)),
+	BPF_TCP_CA_OP(cwnd_event, 2),
+	BPF_TCP_CA_OP(in_ack_event, 2),
+	BPF_TCP_CA_OP(undo_cwnd, 1),
+	BPF_TCP_CA_OP(pkts_acked, 2),
+	BPF_TCP_CA_OP(min_tso_segs, 1),
+	BPF_TCP_CA_OP(sndbuf_expand, 1),
+};
+
+#define BPF_TCP_CA_NR_OPS ARRAY_SIZE(bpf_tcp_ca_ops)
+
+enum bpf_tcp_ca_state {
+	BPF_TCP_CA_INIT,
+	BPF_TCP_CA_REGISTERED,
+	/* sockets may still use it, but it cannot be registered again */
+	BPF_TCP_CA_UNREGISTERED,
+};
+
+struct bpf_tcp_ca_map {
+	struct bpf_map map;
+	/* serializes update and delete */
+	struct mutex mutex;
+	enum bpf_tcp_ca_state state;
+	/* Sockets using the congestion control, plus one for the
+	 * registration. Those together hold a single map reference, so
+	 * the number of sockets is not bounded by BPF_MAX_REFCNT.
+	 */
+	refcount_t users;
+	struct bpf_tcp_congestion_ops uvalue;
+	struct bpf_prog *progs[BPF_TCP_CA_NR_OPS];
+	/* one page holding the trampolines of all ops */
+	void *image;
+	struct tcp_congestion_ops kops;
+};
+
+int bpf_struct_ops_resolve(struct bpf_prog *prog, const char *op_name)
+{
+	int i;
+
+	for (i = 0; i < BPF_TCP_CA_NR_OPS; i++) {
+		if (!strcmp(op_name, bpf_tcp_ca_ops[i].name)) {
+			prog->aux->struct_ops_member = i;
+			prog->aux->attach_func_nr_args = bpf_tcp_ca_ops[i].nr_args;
+			return 0;
+		}
+	}
+	return -ENOENT;
+}
+
+static const struct bpf_func_proto *
+bpf_tcp_ca_get_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
+{
+	return bpf_base_func_proto(func_id);
+}
+
+static bool bpf_tcp_ca_is_valid_access(int off, int size,
+				       enum bpf_access_type type,
+				       const struct bpf_prog *prog,
+				       struct bpf_insn_access_aux *info)
+{
+	const struct bpf_tcp_ca_op *op;
+	bool pkts_acked;
+
+	op = &bpf_tcp_ca_ops[prog->aux->struct_ops_member];
+	pkts_acked = op->koff == offsetof(struct tcp_congestion_ops, pkts_acked);
+
+	if (off < 0 || off >= sizeof(struct bpf_tcp_ca_ctx))
+		return false;
+	/* every field is a u32 */
+	if (size != sizeof(__u32) || off % size != 0)
+		return false;
+
+	switch (off) {
+	case offsetof(struct bpf_tcp_ca_ctx, arg1):
+		return type == BPF_READ && !pkts_acked && op->nr_args > 1;
+	case offsetof(struct bpf_tcp_ca_ctx, arg2):
+		return type == BPF_READ && op->nr_args > 2;
+	case offsetof(struct bpf_tcp_ca_ctx, sample_pkts_acked):
+	case offsetof(struct bpf_tcp_ca_ctx, sample_rtt_us):
+	case offsetof(struct bpf_tcp_ca_ctx, sample_in_flight):
+		return type == BPF_READ && pkts_acked;
+	case offsetof(struct bpf_tcp_ca_ctx, snd_cwnd):
+	case offsetof(struct bpf_tcp_ca_ctx, snd_ssthresh):
+	case offsetof(struct bpf_tcp_ca_ctx, snd_cwnd_cnt):
+	case bpf_ctx_range(struct bpf_tcp_ca_ctx, ca_priv):
+		return true;
+	default:
+		return type == BPF_READ;
+	}
+}
+
+#define TCP_CA_SOCK_FIELD(FIELD)					\
+	({								\
+		BUILD_BUG_ON(FIELD_SIZEOF(struct tcp_sock, FIELD) !=	\
+			     sizeof(u32));				\
+		offsetof(struct tcp_sock, FIELD);			\
+	})
+
+#define TCP_CA_SAMPLE_FIELD(FIELD)					\
+	({								\
+		BUILD_BUG_ON(FIELD_SIZEOF(struct ack_sample, FIELD) !=	\
+			     sizeof(u32));				\
+		offsetof(struct ack_sample, FIELD);			\
+	})
+
+/* Offset of the field behind a context field, in the object the @arg'th
+ * op argument points to.
+ */
+static u32 bpf_tcp_ca_field_off(u32 off, u32 *arg)
+{
+	*arg = 0;
+
+	switch (off) {
+	case offsetof(struct bpf_tcp_ca_ctx, sample_pkts_acked):
+		*arg = 1;
+		return TCP_CA_SAMPLE_FIELD(pkts_acked);
+	case offsetof(struct bpf_tcp_ca_ctx, sample_rtt_us):
+		*arg = 1;
+		return TCP_CA_SAMPLE_FIELD(rtt_us);
+	case offsetof(struct bpf_tcp_ca_ctx, sample_in_flight):
+		*arg = 1;
+		return TCP_CA_SAMPLE_FIELD(in_flight);
+	case offsetof(struct bpf_tcp_ca_ctx, snd_cwnd):
+		return TCP_CA_SOCK_FIELD(snd_cwnd);
+	case offsetof(struct bpf_tcp_ca_ctx, snd_ssthresh):
+		return TCP_CA_SOCK_FIELD(snd_ssthresh);
+	case offsetof(struct bpf_tcp_ca_ctx, snd_cwnd_cnt):
+		return TCP_CA_SOCK_FIELD(snd_cwnd_cnt);
+	case offsetof(struct bpf_tcp_ca_ctx, snd_cwnd_clamp):
+		return TCP_CA_SOCK_FIELD(snd_cwnd_clamp);
+	case offsetof(struct bpf_tcp_ca_ctx, srtt_us):
+		return TCP_CA_SOCK_FIELD(srtt_us);
+	case offsetof(struct bpf_tcp_ca_ctx, mss_cache):
+		return TCP_CA_SOCK_FIELD(mss_cache);
+	case offsetof(struct bpf_tcp_ca_ctx, packets_out):
+		return TCP_CA_SOCK_FIELD(packets_out);
+	case offsetof(struct bpf_tcp_ca_ctx, prior_cwnd):
+		return TCP_CA_SOCK_FIELD(prior_cwnd);
+	default:
+		/* ca_priv, checked by bpf_tcp_ca_is_valid_access() */
+		BUILD_BUG_ON(FIELD_SIZEOF(struct bpf_tcp_ca_ctx, ca_priv) >
+			     ICSK_CA_PRIV_SIZE);
+		return offsetof(struct inet_connection_sock, icsk_ca_priv) +
+		       off - offsetof(struct bpf_tcp_ca_ctx, ca_priv);
+	}
+}
+
+/* The context is the u64 array of the op's arguments, the socket first. */
+static u32 bpf_tcp_ca_convert_ctx_access(enum bpf_access_type type,
+					 const struct bpf_insn *si,
+					 struct bpf_insn *insn_buf,
+					 struct bpf_prog *prog, u32 *target_size)
+{
+	const struct bpf_tcp_ca_op *op;
+	struct bpf_insn *insn = insn_buf;
+	u32 off, arg;
+	int reg;
+
+	switch (si->off) {
+	case offsetof(struct bpf_tcp_ca_ctx, arg1):
+	case offsetof(struct bpf_tcp_ca_ctx, arg2):
+		/* args[1] or args[2], truncated to the type they hold: the
+		 * bits above it are not defined by the calling convention
+		 */
+		op = &bpf_tcp_ca_ops[prog->aux->struct_ops_member];
+		arg = (si->off - offsetof(struct bpf_tcp_ca_ctx, arg1)) /
+		      sizeof(__u32) + 1;
+		*insn++ = BPF_LDX_MEM(BPF_DW, si->dst_reg, si->src_reg,
+				      arg * sizeof(u64));
+		if (arg == 1 && op->arg1_size == sizeof(u8))
+			*insn++ = BPF_ALU32_IMM(BPF_AND, si->dst_reg, 0xff);
+		else
+			*insn++ = BPF_MOV32_REG(si->dst_reg, si->dst_reg);
+		return insn - insn_buf;
+	}
+
+	off = bpf_tcp_ca_field_off(si->off, &arg);
+	if (type == BPF_WRITE) {
+		/* Like SOCK_OPS_SET_FIELD(), borrow a register for the
+		 * socket pointer. It is saved in the slot after the
+		 * arguments, which the trampoline only uses for the return
+		 * value once the program is done.
+		 */
+		u32 temp = prog->aux->attach_func_nr_args * sizeof(u64);
+
+		reg = BPF_REG_9;
+		if (si->dst_reg == reg || si->src_reg == reg)
+			reg--;
+		if (si->dst_reg == reg || si->src_reg == reg)
+			reg--;
+		*insn++ = BPF_STX_MEM(BPF_DW, si->dst_reg, reg, temp);
+		*insn++ = BPF_LDX_MEM(BPF_DW, reg, si->dst_reg, 0);
+		*insn++ = BPF_STX_MEM(BPF_W, reg, si->src_reg, off);
+		*insn++ = BPF_LDX_MEM(BPF_DW, reg, si->dst_reg, temp);
+	} else {
+		*insn++ = BPF_LDX_MEM(BPF_DW, si->dst_reg, si->src_reg,
+				      arg * sizeof(u64));
+		*insn++ = BPF_LDX_MEM(BPF_W, si->dst_reg, si->dst_reg, off);
+	}
+
+	return insn - insn_buf;
+}
+
+const struct bpf_verifier_ops bpf_tcp_ca_verifier_ops = {
+	.get_func_proto		= bpf_tcp_ca_get_func_proto,
+	.is_valid_access	= bpf_tcp_ca_is_valid_access,
+	.convert_ctx_access	= bpf_tcp_ca_convert_ctx_access,
+};
+
+const struct bpf_prog_ops bpf_tcp_ca_prog_ops = {
+};
+
+static int bpf_tcp_ca_map_alloc_check(union bpf_attr *attr)
+{
+	if (attr->key_size != sizeof(u32) || attr->max_entries != 1 ||
+	    attr->value_size != sizeof(struct bpf_tcp_congestion_ops) ||
+	    attr->map_flags)
+		return -EINVAL;
+	return 0;
+}
+
+static struct bpf_map *bpf_tcp_ca_map_alloc(union bpf_attr *attr)
+{
+	struct bpf_tcp_ca_map *st_map;
+	u64 cost;
+	int err;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return ERR_PTR(-EPERM);
+
+	/* the map and the page of trampolines */
+	cost = (round_up(sizeof(*st_map), PAGE_SIZE) >> PAGE_SHIFT) + 1;
+	err = bpf_map_precharge_memlock(cost);
+	if (err)
+		return ERR_PTR(err);
+
+	st_map = bpf_map_area_alloc(sizeof(*st_map), NUMA_NO_NODE);
+	if (!st_map)
+		return ERR_PTR(-ENOMEM);
+
+	st_map->image = module_alloc(PAGE_SIZE);
+	if (!st_map->image) {
+		bpf_map_area_free(st_map);
+		return ERR_PTR(-ENOMEM);
+	}
+	set_memory_x((unsigned long)st_map->image, 1);
+
+	mutex_init(&st_map->mutex);
+	bpf_map_init_from_attr(&st_map->map, attr);
+	st_map->map.pages = cost;
+
+	return &st_map->map;
+}
+
+static void bpf_tcp_ca_put_progs(struct bpf_tcp_ca_map *st_map)
+{
+	int i;
+
+	for (i = 0; i < BPF_TCP_CA_NR_OPS; i++) {
+		if (st_map->progs[i]) {
+			bpf_prog_put(st_map->progs[i]);
+			st_map->progs[i] = NULL;
+		}
+	}
+}
+
+/* The registration and the sockets using the congestion control hold a
+ * reference on the map, so nothing runs the trampolines anymore.
+ */
+static void bpf_tcp_ca_map_free(struct bpf_map *map)
+{
+	struct bpf_tcp_ca_map *st_map = container_of(map, struct bpf_tcp_ca_map, map);
+
+	bpf_tcp_ca_put_progs(st_map);
+	set_memory_nx((unsigned long)st_map->image, 1);
+	module_memfree(st_map->image);
+	bpf_map_area_free(st_map);
+}
+
+static int bpf_tcp_ca_map_get_next_key(struct bpf_map *map, void *key,
+				       void *next_key)
+{
+	u32 *next = next_key;
+
+	if (key && *(u32 *)key == 0)
+		return -ENOENT;
+
+	*next = 0;
+	return 0;
+}
+
+static void *bpf_tcp_ca_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_tcp_ca_map *st_map = container_of(map, struct bpf_tcp_ca_map, map);
+
+	if (*(u32 *)key != 0)
+		return NULL;
+
+	return &st_map->uvalue;
+}
+
+/* Called from syscall only, and allowed to sleep */
+static int bpf_tcp_ca_map_update_elem(struct bpf_map *map, void *key,
+				      void *value, u64 flags)
+{
+	struct bpf_tcp_ca_map *st_map = container_of(map, struct bpf_tcp_ca_map, map);
+	const struct bpf_tcp_congestion_ops *uvalue = value;
+	struct tcp_congestion_ops *kops = &st_map->kops;
+	void *image = st_map->image, *image_end = image + PAGE_SIZE;
+	int i, err;
+
+	if (flags != BPF_ANY || *(u32 *)key != 0)
+		return -EINVAL;
+	if (uvalue->flags & ~(TCP_CONG_NON_RESTRICTED | TCP_CONG_NEEDS_ECN))
+		return -EINVAL;
+	if (strnlen(uvalue->name, sizeof(uvalue->name)) == sizeof(uvalue->name))
+		return -EINVAL;
+
+	mutex_lock(&st_map->mutex);
+	if (st_map->state != BPF_TCP_CA_INIT) {
+		err = -EBUSY;
+		goto unlock;
+	}
+
+	for (i = 0; i < BPF_TCP_CA_NR_OPS; i++) {
+		const struct bpf_tcp_ca_op *op = &bpf_tcp_ca_ops[i];
+		u32 fd = *(u32 *)((void *)uvalue + op->uoff);
+		struct bpf_prog *prog;
+
+		if (!fd)
+			continue;
+
+		prog = bpf_prog_get_type(fd, BPF_PROG_TYPE_STRUCT_OPS);
+		if (IS_ERR(prog)) {
+			err = PTR_ERR(prog);
+			goto reset;
+		}
+		st_map->progs[i] = prog;
+
+		if (prog->aux->struct_ops_member != i) {
+			err = -EINVAL;
+			goto reset;
+		}
+
+		err = arch_prepare_bpf_trampoline(image, image_end, op->nr_args,
+						  BPF_TRAMP_F_RET_FENTRY_RET,
+						  &prog, 1, NULL, 0, NULL, NULL);
+		if (err < 0)
+			goto reset;
+
+		*(void **)((void *)kops + op->koff) = image;
+		image += err;
+	}
+
+	BUILD_BUG_ON(sizeof(kops->name) != sizeof(uvalue->name));
+	memcpy(kops->name, uvalue->name, sizeof(kops->name));
+	kops->flags = uvalue->flags | TCP_CONG_BPF;
+
+	/* the registration holds a reference, dropped on delete */
+	if (IS_ERR(bpf_map_inc(map, false))) {
+		err = -EBUSY;
+		goto reset;
+	}
+	refcount_set(&st_map->users, 1);
+	err = tcp_register_congestion_control(kops);
+	if (err) {
+		bpf_map_put(map);
+		goto reset;
+	}
+
+	memcpy(&st_map->uvalue, uvalue, sizeof(*uvalue));
+	st_map->state = BPF_TCP_CA_REGISTERED;
+	goto unlock;
+
+reset:
+	bpf_tcp_ca_put_progs(st_map);
+	memset(kops, 0, sizeof(*kops));
+unlock:
+	mutex_unlock(&st_map->mutex);
+	return err;
+}
+
+/* Called from syscall only, and allowed to sleep */
+static int bpf_tcp_ca_map_delete_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_tcp_ca_map *st_map = container_of(map, struct bpf_tcp_ca_map, map);
+	int err = 0;
+
+	if (*(u32 *)key != 0)
+		return -EINVAL;
+
+	mutex_lock(&st_map->mutex);
+	if (st_map->state != BPF_TCP_CA_REGISTERED) {
+		err = -ENOENT;
+	} else {
+		tcp_unregister_congestion_control(&st_map->kops);
+		st_map->state = BPF_TCP_CA_UNREGISTERED;
+		bpf_tcp_ca_put(&st_map->kops);
+	}
+	mutex_unlock(&st_map->mutex);
+
+	return err;
+}
+
+const struct bpf_map_ops bpf_tcp_ca_map_ops = {
+	.map_alloc_check = bpf_tcp_ca_map_alloc_check,
+	.map_alloc = bpf_tcp_ca_map_alloc,
+	.map_free = bpf_tcp_ca_map_free,
+	.map_get_next_key = bpf_tcp_ca_map_get_next_key,
+	.map_lookup_elem = bpf_tcp_ca_map_lookup_elem,
+	.map_update_elem = bpf_tcp_ca_map_update_elem,
+	.map_delete_elem = bpf_tcp_ca_map_delete_elem,
+};
+
+bool bpf_tcp_ca_get(const struct tcp_congestion_ops *ca)
+{
+	struct bpf_tcp_ca_map *st_map;
+
+	st_map = container_of(ca, struct bpf_tcp_ca_map, kops);
+	return refcount_inc_not_zero(&st_map->users);
+}
+
+void bpf_tcp_ca_put(const struct tcp_congestion_ops *ca)
+{
+	struct bpf_tcp_ca_map *st_map;
+
+	st_map = container_of(ca, struct bpf_tcp_ca_map, kops);
+	if (refcount_dec_and_test(&st_map->users))
+		bpf_map_put(&st_map->map);
+}
@@ -34,10 +34,15 @@ static struct sk_buff *esp4_gro_receive(struct list_head *head,
 	int offset = skb_gro_offset(skb);
 	struct xfrm_offload *xo;
 	struct xfrm_state *x;
+	int encap_type = -2;
 	__be32 seq;
 	__be32 spi;
 	int err;
 
+	/* ESP in UDP, passed on by xfrm4_gro_udp_encap_rcv() */
+	if (ip_hdr(skb)->protocol == IPPROTO_UDP)
+		encap_type = -3;
+
 	if (!pskb_pull(skb, offset))
 		return NULL;
 
@@ -69,6 +74,19 @@ static struct sk_buff *esp4_gro_receive(struct list_head *head,
 		}
 	}
 
+	/* As in xfrm4_udp_encap_rcv(), the IP length no longer covers the
+	 * UDP header, which stays in front of ESP until decapsulation.
+	 */
+	if (encap_type == -3) {
+		struct iphdr *iph;
+
+		if (skb_unclone(skb, GFP_ATOMIC))
+			goto out;
+		iph = ip_hdr(skb);
+		iph->tot_len = htons(ntohs(iph->tot_len) -
+				     sizeof(struct udphdr));
+	}
+
 	xo->flags |= XFRM_GRO;
 
 	XFRM_TUNNEL_SKB_CB(skb)->tunnel.ip4 = NULL;
@@ -78,7 +96,7 @@ static struct sk_buff *esp4_gro_receive(struct list_head *head,
 
 	/* We don't need to handle errors from xfrm_input, it does all
 	 * the error handling and frees the resources on error. */
-	xfrm_input(skb, IPPROTO_ESP, spi, -2);
+	xfrm_input(skb, IPPROTO_ESP, spi, encap_type);
 
 	return ERR_PTR(-EINPROGRESS);
 out:
@@ -75,6 +75,7 @@
 #include <linux/export.h>
 #include <linux/vmalloc.h>
 #include <linux/notifier.h>
+#include <linux/hash.h>
 #include <net/net_namespace.h>
 #include <net/ip.h>
 #include <net/protocol.h>
@@ -175,8 +176,38 @@ struct trie_stat {
 	unsigned int nodesizes[MAX_STAT_DEPTH];
 };
 
+/* Per cpu direct mapped cache of fib_table_lookup() results. Entries are
+ * only valid for the fib_lookup_cache_genid they were filled in, which is
+ * bumped by every rt_cache_flush(), so any route, rule, address or
+ * nexthop state change drops them all.
+ */
+#define FIB_LOOKUP_CACHE_BITS	6
+#define FIB_LOOKUP_CACHE_SIZE	(1U << FIB_LOOKUP_CACHE_BITS)
+
+/* flowi4/fib_flags bits that change the outcome of a lookup */
+#define FIB_LC_IGNORE_LINKSTATE	0x1
+#define FIB_LC_SKIP_NH_OIF	0x2
+
+struct fib_lookup_cache_entry {
+	int			genid;
+	__be32			daddr;
+	int			oif;
+	u8			tos;
+	u8			scope;
+	u8			flags;
+	struct fib_result	res;
+};
+
+struct fib_lookup_cache {
+	struct fib_lookup_cache_entry ent[FIB_LOOKUP_CACHE_SIZE];
+};
+
+int sysctl_fib_lookup_cache __read_mostly;
+atomic_t fib_lookup_cache_genid = ATOMIC_INIT(0);
+
 struct trie {
 	struct key_vector kv[1];
+	struct fib_lookup_cache __percpu *cache;
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	struct trie_use_stats __percpu *stats;
 #endif
@@ -1312,11 +1343,87 @@ static inline t_key prefix_mismatch(t_key key, struct key_vector *n)
 	return (key ^ prefix) & (prefix | -prefix);
 }
 
+static u8 fib_lookup_cache_flags(const struct flowi4 *flp, int fib_flags)
+{
+	u8 flags = 0;
+
+	if (fib_flags & FIB_LOOKUP_IGNORE_LINKSTATE)
+		flags |= FIB_LC_IGNORE_LINKSTATE;
+	if (flp->flowi4_flags & FLOWI_FLAG_SKIP_NH_OIF)
+		flags |= FIB_LC_SKIP_NH_OIF;
+	return flags;
+}
+
+/* The cache is only used with BHs disabled, so that neither preemption
+ * nor a softirq can interleave with an update of the same entry. This
+ * covers the forwarding path it is meant for.
+ */
+static struct fib_lookup_cache_entry *
+fib_lookup_cache_slot(struct trie *t, const struct flowi4 *flp)
+{
+	u32 hash;
+
+	if (!sysctl_fib_lookup_cache || !t->cache || !in_softirq())
+		return NULL;
+
+	hash = (__force u32)flp->daddr ^ flp->flowi4_oif ^
+	       ((u32)flp->flowi4_tos << 24) ^ ((u32)flp->flowi4_scope << 16);
+	return &this_cpu_ptr(t->cache)->ent[hash_32(hash,
+						     FIB_LOOKUP_CACHE_BITS)];
+}
+
+static bool fib_lookup_cache_get(struct fib_lookup_cache_entry *ce,
+				 const struct fib_table *tb,
+				 const struct flowi4 *flp,
+				 struct fib_result *res, int fib_flags)
+{
+	struct fib_info *fi;
+
+	if (ce->genid != atomic_read(&fib_lookup_cache_genid) ||
+	    ce->res.table != tb ||
+	    ce->daddr != flp->daddr ||
+	    ce->oif != flp->flowi4_oif ||
+	    ce->tos != flp->flowi4_tos ||
+	    ce->scope != flp->flowi4_scope ||
+	    ce->flags != fib_lookup_cache_flags(flp, fib_flags))
+		return false;
+
+	fi = ce->res.fi;
+	if (!(fib_flags & FIB_LOOKUP_NOREF))
+		refcount_inc(&fi->fib_clntref);
+
+	res->prefix = ce->res.prefix;
+	res->prefixlen = ce->res.prefixlen;
+	res->nh_sel = ce->res.nh_sel;
+	res->type = ce->res.type;
+	res->scope = ce->res.scope;
+	res->fi = fi;
+	res->table = ce->res.table;
+	res->fa_head = ce->res.fa_head;
+	trace_fib_table_lookup(tb->tb_id, flp, &fi->fib_nh[res->nh_sel], 0);
+	return true;
+}
+
+static void fib_lookup_cache_set(struct fib_lookup_cache_entry *ce,
+				 int genid, const struct flowi4 *flp,
+				 const struct fib_result *res, int fib_flags)
+{
+	ce->genid = genid;
+	ce->daddr = flp->daddr;
+	ce->oif = flp->flowi4_oif;
+	ce->tos = flp->flowi4_tos;
+	ce->scope = flp->flowi4_scope;
+	ce->flags = fib_lookup_cache_flags(flp, fib_flags);
+	ce->res = *res;
+}
+
 /* should be called with rcu_read_lock */
 int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 		     struct fib_result *res, int fib_flags)
 {
 	struct trie *t = (struct trie *) tb->tb_data;
+	struct fib_lookup_cache_entry *ce;
+	int genid = 0;
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	struct trie_use_stats __percpu *stats = t->stats;
 #endif
@@ -1326,6 +1433,16 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 	unsigned long index;
 	t_key cindex;
 
+	ce = fib_lookup_cache_slot(t, flp);
+	if (ce) {
+		if (fib_lookup_cache_get(ce, tb, flp, res, fib_flags))
+			return 0;
+		/* sample before the walk, a flush racing with it then
+		 * makes the entry stale rather than leaving it valid
+		 */
+		genid = atomic_read_acquire(&fib_lookup_cache_genid);
+	}
+
 	pn = t->kv;
 	cindex = 0;
 
@@ -1495,6 +1612,9 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 			res->fi = fi;
 			res->table = tb;
 			res->fa_head = &n->leaf;
+			if (ce && !err)
+				fib_lookup_cache_set(ce, genid, flp, res,
+						     fib_flags);
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 			this_cpu_inc(stats->semantic_match_passed);
 #endif
@@ -1722,6 +1842,7 @@ static void fib_trie_free(struct fib_table *tb)
 		node_free(n);
 	}
 
+	free_percpu(t->cache);
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	free_percpu(t->stats);
 #endif
@@ -1795,6 +1916,9 @@ void fib_table_flush_external(struct fib_table *tb)
 	struct hlist_node *tmp;
 	struct fib_alias *fa;
 
+	/* local routes leave the main table without a rt_cache_flush() */
+	fib_lookup_cache_flush();
+
 	/* walk trie in reverse order */
 	for (;;) {
 		unsigned char slen = 0;
@@ -1988,12 +2112,14 @@ void fib_notify(struct net *net, struct notifier_block *nb)
 static void __trie_free_rcu(struct rcu_head *head)
 {
 	struct fib_table *tb = container_of(head, struct fib_table, rcu);
-#ifdef CONFIG_IP_FIB_TRIE_STATS
 	struct trie *t = (struct trie *)tb->tb_data;
 
-	if (tb->tb_data == tb->__data)
+	if (tb->tb_data == tb->__data) {
+		free_percpu(t->cache);
+#ifdef CONFIG_IP_FIB_TRIE_STATS
 		free_percpu(t->stats);
 #endif /* CONFIG_IP_FIB_TRIE_STATS */
+	}
 	kfree(tb);
 }
 
@@ -2130,9 +2256,12 @@ struct fib_table *fib_trie_table(u32 id, struct fib_table *alias)
 	t = (struct trie *) tb->tb_data;
 	t->kv[0].pos = KEYLENGTH;
 	t->kv[0].slen = KEYLENGTH;
+	/* optional, lookups go straight to the trie without it */
+	t->cache = alloc_percpu(struct fib_lookup_cache);
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	t->stats = alloc_percpu(struct trie_use_stats);
 	if (!t->stats) {
+		free_percpu(t->cache);
 		kfree(tb);
 		tb = NULL;
 	}
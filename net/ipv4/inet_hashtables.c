@@ -296,6 +296,36 @@ static struct sock *inet_lhash2_lookup(struct net *net,
 	return result;
 }
 
+static struct sock *inet_lookup_run_bpf(struct net *net,
+					struct inet_hashinfo *hashinfo,
+					struct sk_buff *skb, int doff,
+					__be32 saddr, __be16 sport,
+					__be32 daddr, u16 hnum)
+{
+	struct bpf_sk_lookup_kern ctx = {
+		.net		= net,
+		.family		= AF_INET,
+		.protocol	= IPPROTO_TCP,
+		.v4.saddr	= saddr,
+		.v4.daddr	= daddr,
+		.sport		= sport,
+		.dport		= hnum,
+	};
+	struct sock *sk, *reuse_sk;
+	u32 phash;
+
+	if (hashinfo != &tcp_hashinfo)
+		return NULL; /* only TCP is supported */
+
+	sk = bpf_run_sk_lookup(&ctx);
+	if (IS_ERR_OR_NULL(sk) || !sk->sk_reuseport)
+		return sk;
+
+	phash = inet_ehashfn(net, daddr, hnum, saddr, sport);
+	reuse_sk = reuseport_select_sock(sk, phash, skb, doff);
+	return reuse_sk ? : sk;
+}
+
 struct sock *__inet_lookup_listener(struct net *net,
 				    struct inet_hashinfo *hashinfo,
 				    struct sk_buff *skb, int doff,
@@ -312,6 +342,14 @@ struct sock *__inet_lookup_listener(struct net *net,
 	unsigned int hash2;
 	u32 phash = 0;
 
+	/* Lookup redirect from BPF */
+	if (static_branch_unlikely(&bpf_sk_lookup_enabled)) {
+		result = inet_lookup_run_bpf(net, hashinfo, skb, doff,
+					     saddr, sport, daddr, hnum);
+		if (result)
+			goto done;
+	}
+
 	if (ilb->count <= 10 || !hashinfo->lhash2)
 		goto port_lookup;
 
@@ -188,51 +188,50 @@ bool ip_call_ra_chain(struct sk_buff *skb)
 	return false;
 }
 
-static int ip_local_deliver_finish(struct net *net, struct sock *sk, struct sk_buff *skb)
+void ip_protocol_deliver_rcu(struct net *net, struct sk_buff *skb, int protocol)
 {
-	__skb_pull(skb, skb_network_header_len(skb));
-
-	rcu_read_lock();
-	{
-		int protocol = ip_hdr(skb)->protocol;
-		const struct net_protocol *ipprot;
-		int raw;
+	const struct net_protocol *ipprot;
+	int raw, ret;
 
-	resubmit:
-		raw = raw_local_deliver(skb, protocol);
+resubmit:
+	raw = raw_local_deliver(skb, protocol);
 
-		ipprot = rcu_dereference(inet_protos[protocol]);
-		if (ipprot) {
-			int ret;
-
-			if (!ipprot->no_policy) {
-				if (!xfrm4_policy_check(NULL, XFRM_POLICY_IN, skb)) {
-					kfree_skb(skb);
-					goto out;
-				}
-				nf_reset(skb);
+	ipprot = rcu_dereference(inet_protos[protocol]);
+	if (ipprot) {
+		if (!ipprot->no_policy) {
+			if (!xfrm4_policy_check(NULL, XFRM_POLICY_IN, skb)) {
+				kfree_skb(skb);
+				return;
 			}
-			ret = ipprot->handler(skb);
-			if (ret < 0) {
-				protocol = -ret;
-				goto resubmit;
+			nf_reset(skb);
+		}
+		ret = ipprot->handler(skb);
+		if (ret < 0) {
+			protocol = -ret;
+			goto resubmit;
+		}
+		__IP_INC_STATS(net, IPSTATS_MIB_INDELIVERS);
+	} else {
+		if (!raw) {
+			if (xfrm4_policy_check(NULL, XFRM_POLICY_IN, skb)) {
+				__IP_INC_STATS(net, IPSTATS_MIB_INUNKNOWNPROTOS);
+				icmp_send(skb, ICMP_DEST_UNREACH,
+					  ICMP_PROT_UNREACH, 0);
 			}
-			__IP_INC_STATS(net, IPSTATS_MIB_INDELIVERS);
+			kfree_skb(skb);
 		} else {
-			if (!raw) {
-				if (xfrm4_policy_check(NULL, XFRM_POLICY_IN, skb)) {
-					__IP_INC_STATS(net, IPSTATS_MIB_INUNKNOWNPROTOS);
-					icmp_send(skb, ICMP_DEST_UNREACH,
-						  ICMP_PROT_UNREACH, 0);
-				}
-				kfree_skb(skb);
-			} else {
-				__IP_INC_STATS(net, IPSTATS_MIB_INDELIVERS);
-				consume_skb(skb);
-			}
+			__IP_INC_STATS(net, IPSTATS_MIB_INDELIVERS);
+			consume_skb(skb);
 		}
 	}
- out:
+}
+
+static int ip_local_deliver_finish(struct net *net, struct sock *sk, struct sk_buff *skb)
+{
+	__skb_pull(skb, skb_network_header_len(skb));
+
+	rcu_read_lock();
+	ip_protocol_deliver_rcu(net, skb, ip_hdr(skb)->protocol);
 	rcu_read_unlock();
 
 	return 0;
@@ -526,10 +525,101 @@ int ip_rcv(struct sk_buff *skb, struct net_device *dev, struct packet_type *pt,
 		       ip_rcv_finish);
 }
 
+static void ip_protocol_deliver_list_rcu(struct net *net,
+					 struct list_head *head, int protocol)
+{
+	const struct net_protocol *ipprot;
+	struct sk_buff *skb, *next;
+	unsigned int n = 0;
+
+	ipprot = rcu_dereference(inet_protos[protocol]);
+	if (!ipprot || !ipprot->list_handler || !ipprot->no_policy) {
+		list_for_each_entry_safe(skb, next, head, list) {
+			skb_list_del_init(skb);
+			ip_protocol_deliver_rcu(net, skb, protocol);
+		}
+		return;
+	}
+
+	list_for_each_entry(skb, head, list) {
+		raw_local_deliver(skb, protocol);
+		n++;
+	}
+	__IP_ADD_STATS(net, IPSTATS_MIB_INDELIVERS, n);
+	ipprot->list_handler(head);
+}
+
+static void ip_list_local_deliver_finish(struct net *net,
+					 struct list_head *head)
+{
+	struct sk_buff *skb, *next;
+	struct list_head sublist;
+	int curr_proto = -1;
+
+	rcu_read_lock();
+	INIT_LIST_HEAD(&sublist);
+	list_for_each_entry_safe(skb, next, head, list) {
+		int protocol;
+
+		skb_list_del_init(skb);
+		__skb_pull(skb, skb_network_header_len(skb));
+		protocol = ip_hdr(skb)->protocol;
+		if (protocol != curr_proto) {
+			/* dispatch old sublist */
+			if (!list_empty(&sublist))
+				ip_protocol_deliver_list_rcu(net, &sublist,
+							     curr_proto);
+			/* start new sublist */
+			INIT_LIST_HEAD(&sublist);
+			curr_proto = protocol;
+		}
+		list_add_tail(&skb->list, &sublist);
+	}
+	/* dispatch final sublist */
+	if (!list_empty(&sublist))
+		ip_protocol_deliver_list_rcu(net, &sublist, curr_proto);
+	rcu_read_unlock();
+}
+
+/* List version of ip_local_deliver(), for skbs that share a dst */
+static void ip_list_local_deliver(struct list_head *head)
+{
+	struct sk_buff *skb, *next;
+	struct list_head sublist;
+	struct net_device *dev;
+	struct net *net;
+
+	skb = list_first_entry(head, struct sk_buff, list);
+	dev = skb->dev;
+	net = dev_net(dev);
+
+	INIT_LIST_HEAD(&sublist);
+	list_for_each_entry_safe(skb, next, head, list) {
+		skb_list_del_init(skb);
+		/* Fragments are reassembled and delivered on their own */
+		if (ip_is_fragment(ip_hdr(skb))) {
+			ip_local_deliver(skb);
+			continue;
+		}
+		list_add_tail(&skb->list, &sublist);
+	}
+
+	NF_HOOK_LIST(NFPROTO_IPV4, NF_INET_LOCAL_IN, net, NULL,
+		     &sublist, dev, NULL, ip_local_deliver_finish);
+	ip_list_local_deliver_finish(net, &sublist);
+}
+
 static void ip_sublist_rcv_finish(struct list_head *head)
 {
 	struct sk_buff *skb, *next;
 
+	/* The sublist shares a dst, keep locally destined skbs batched */
+	skb = list_first_entry_or_null(head, struct sk_buff, list);
+	if (skb && skb_dst(skb)->input == ip_local_deliver) {
+		ip_list_local_deliver(head);
+		return;
+	}
+
 	list_for_each_entry_safe(skb, next, head, list) {
 		skb_list_del_init(skb);
 		dst_input(skb);
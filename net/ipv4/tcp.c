@@ -1744,14 +1744,103 @@ int tcp_mmap(struct file *file, struct socket *sock,
 }
 EXPORT_SYMBOL(tcp_mmap);
 
+/*
+ * Returns how many of the @len bytes queued at @seq have to be copied before
+ * reaching a full, page aligned frag that can be remapped.
+ */
+static u32 tcp_zc_skip_len(struct sock *sk, u32 seq, u32 len)
+{
+	struct sk_buff *skb = NULL;
+	u32 skip = 0, offset;
+	int i;
+
+	while (skip < len) {
+		if (!skb) {
+			skb = tcp_recv_skb(sk, seq, &offset);
+			if (!skb)
+				break;
+		} else {
+			if (skb_queue_is_last(&sk->sk_receive_queue, skb))
+				break;
+			skb = skb->next;
+			offset = 0;
+		}
+
+		if (skb_has_frag_list(skb)) {
+			skip += skb->len - offset;
+			continue;
+		}
+		if (offset < skb_headlen(skb)) {
+			skip += skb_headlen(skb) - offset;
+			offset = 0;
+		} else {
+			offset -= skb_headlen(skb);
+		}
+		for (i = 0; i < skb_shinfo(skb)->nr_frags; i++) {
+			const skb_frag_t *frag = &skb_shinfo(skb)->frags[i];
+			u32 size = skb_frag_size(frag);
+
+			if (offset >= size) {
+				offset -= size;
+				continue;
+			}
+			if (!offset && size == PAGE_SIZE && !frag->page_offset)
+				return min(skip, len);
+			skip += size - offset;
+			offset = 0;
+		}
+	}
+	return min(skip, len);
+}
+
+/* Copies @len bytes of the receive queue, starting at @seq, to @buf. */
+static int tcp_zc_copy(struct sock *sk, u32 seq, void __user *buf, int len)
+{
+	struct sk_buff *skb = NULL;
+	struct iov_iter to;
+	struct iovec iov;
+	int copied = 0;
+	u32 offset;
+	int err;
+
+	err = import_single_range(READ, buf, len, &iov, &to);
+	if (err)
+		return err;
+
+	while (copied < len) {
+		int chunk;
+
+		if (!skb) {
+			skb = tcp_recv_skb(sk, seq, &offset);
+			if (!skb)
+				break;
+		} else {
+			if (skb_queue_is_last(&sk->sk_receive_queue, skb))
+				break;
+			skb = skb->next;
+			offset = 0;
+		}
+
+		chunk = min_t(int, skb->len - offset, len - copied);
+		err = skb_copy_datagram_iter(skb, offset, &to, chunk);
+		if (err)
+			return copied ? : err;
+		copied += chunk;
+	}
+	return copied;
+}
+
 static int tcp_zerocopy_receive(struct sock *sk,
 				struct tcp_zerocopy_receive *zc)
 {
 	unsigned long address = (unsigned long)zc->address;
+	void __user *copybuf = u64_to_user_ptr(zc->copybuf_address);
+	int copybuf_len = copybuf ? zc->copybuf_len : 0;
+	u32 length = 0, head = 0, tail = 0, seq, offset;
 	const skb_frag_t *frags = NULL;
-	u32 length = 0, seq, offset;
 	struct vm_area_struct *vma;
 	struct sk_buff *skb = NULL;
+	bool zapped = false;
 	struct tcp_sock *tp;
 	int inq;
 	int ret;
@@ -1759,11 +1848,40 @@ static int tcp_zerocopy_receive(struct sock *sk,
 	if (address & (PAGE_SIZE - 1) || address != zc->address)
 		return -EINVAL;
 
+	if (copybuf_len < 0 || zc->reserved ||
+	    zc->flags & ~TCP_RECEIVE_ZEROCOPY_FLAG_TLB_CLEAN_HINT)
+		return -EINVAL;
+
 	if (sk->sk_state == TCP_LISTEN)
 		return -ENOTCONN;
 
 	sock_rps_record_flow(sk);
 
+	tp = tcp_sk(sk);
+	seq = tp->copied_seq;
+	inq = tcp_inq(sk);
+
+	/*
+	 * Copy whatever sits in front of the first remappable page (a header
+	 * split linear part, a partial frag...) so that mapping can start
+	 * right away. This has to happen before taking mmap_sem, as faulting
+	 * in copybuf may need it.
+	 */
+	if (copybuf_len) {
+		head = tcp_zc_skip_len(sk, seq, inq);
+		if (head) {
+			ret = tcp_zc_copy(sk, seq, copybuf,
+					  min_t(int, head, copybuf_len));
+			if (ret < 0)
+				return ret;
+			head = ret;
+			seq += head;
+			inq -= head;
+			copybuf += head;
+			copybuf_len -= head;
+		}
+	}
+
 	down_read(&current->mm->mmap_sem);
 
 	ret = -EINVAL;
@@ -1772,13 +1890,18 @@ static int tcp_zerocopy_receive(struct sock *sk,
 		goto out;
 	zc->length = min_t(unsigned long, zc->length, vma->vm_end - address);
 
-	tp = tcp_sk(sk);
-	seq = tp->copied_seq;
-	inq = tcp_inq(sk);
 	zc->length = min_t(u32, zc->length, inq);
 	zc->length &= ~(PAGE_SIZE - 1);
 	if (zc->length) {
-		zap_page_range(vma, address, zc->length);
+		/*
+		 * The caller may tell us the range has already been unmapped,
+		 * e.g. by a single madvise(MADV_DONTNEED) covering the buffers
+		 * of several calls, so that the TLB is not flushed every time.
+		 */
+		if (!(zc->flags & TCP_RECEIVE_ZEROCOPY_FLAG_TLB_CLEAN_HINT)) {
+			zap_page_range(vma, address, zc->length);
+			zapped = true;
+		}
 		zc->recv_skip_hint = 0;
 	} else {
 		zc->recv_skip_hint = inq;
@@ -1818,6 +1941,14 @@ static int tcp_zerocopy_receive(struct sock *sk,
 		}
 		ret = vm_insert_page(vma, address + length,
 				     skb_frag_page(frags));
+		if (ret == -EBUSY && !zapped) {
+			/* The hint was wrong, zap what is left of the range. */
+			zap_page_range(vma, address + length,
+				       zc->length - length);
+			zapped = true;
+			ret = vm_insert_page(vma, address + length,
+					     skb_frag_page(frags));
+		}
 		if (ret)
 			break;
 		length += PAGE_SIZE;
@@ -1827,21 +1958,36 @@ static int tcp_zerocopy_receive(struct sock *sk,
 	}
 out:
 	up_read(&current->mm->mmap_sem);
-	if (length) {
+
+	/* Copy the unmappable data following the mapping, if it fits. */
+	if (!ret && copybuf_len && inq > length) {
+		tail = tcp_zc_skip_len(sk, seq, inq - length);
+		if (tail) {
+			ret = tcp_zc_copy(sk, seq, copybuf,
+					  min_t(int, tail, copybuf_len));
+			tail = max(ret, 0);
+			seq += tail;
+			zc->recv_skip_hint -= min(zc->recv_skip_hint, tail);
+		}
+	}
+
+	if (length + head + tail) {
 		tp->copied_seq = seq;
 		tcp_rcv_space_adjust(sk);
 
 		/* Clean up data we have read: This will do ACK frames. */
 		tcp_recv_skb(sk, seq, &offset);
-		tcp_cleanup_rbuf(sk, length);
+		tcp_cleanup_rbuf(sk, length + head + tail);
 		ret = 0;
-		if (length == zc->length)
+		if (length && length == zc->length)
 			zc->recv_skip_hint = 0;
 	} else {
 		if (!zc->recv_skip_hint && sock_flag(sk, SOCK_DONE))
 			ret = -EIO;
 	}
 	zc->length = length;
+	zc->copybuf_head = head;
+	zc->copybuf_len = head + tail;
 	return ret;
 }
 #endif
@@ -3556,12 +3702,15 @@ static int do_tcp_getsockopt(struct sock *sk, int level,
 	}
 #ifdef CONFIG_MMU
 	case TCP_ZEROCOPY_RECEIVE: {
-		struct tcp_zerocopy_receive zc;
+		struct tcp_zerocopy_receive zc = {};
 		int err;
 
 		if (get_user(len, optlen))
 			return -EFAULT;
-		if (len != sizeof(zc))
+		/* Older binaries stop right after recv_skip_hint */
+		if (len < offsetofend(struct tcp_zerocopy_receive,
+				      recv_skip_hint) ||
+		    len > sizeof(zc))
 			return -EINVAL;
 		if (copy_from_user(&zc, optval, len))
 			return -EFAULT;
@@ -3833,6 +3982,102 @@ static void __init tcp_init_mem(void)
 	sysctl_tcp_mem[2] = sysctl_tcp_mem[0] * 2;	/* 9.37 % */
 }
 
+/* Bit-fields can not be checked with offsetof(), the u8 words holding
+ * nonagle, syn_data and chrono_type are part of the read_txrx, write_tx
+ * and write_txrx groups respectively.
+ */
+static void __init tcp_struct_check(void)
+{
+	/* TX read-mostly fields */
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_tx, max_window);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_tx, rcv_ssthresh);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_tx, reordering);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_tx, notsent_lowat);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_tx, gso_segs);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_tx, lost_skb_hint);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_tx, retransmit_skb_hint);
+	CACHELINE_ASSERT_GROUP_SIZE(struct tcp_sock, tcp_sock_read_tx, 40);
+
+	/* TXRX read-mostly fields */
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_txrx, tsoffset);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_txrx, snd_wnd);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_txrx, mss_cache);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_txrx, snd_cwnd);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_txrx, prr_out);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_txrx, lost_out);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_txrx, sacked_out);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_txrx, tcp_header_len);
+	CACHELINE_ASSERT_GROUP_SIZE(struct tcp_sock, tcp_sock_read_txrx, 31);
+
+	/* RX read-mostly fields */
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_rx, copied_seq);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_rx, rcv_tstamp);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_rx, snd_wl1);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_rx, tlp_high_seq);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_rx, rttvar_us);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_rx, retrans_out);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_rx, advmss);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_rx, urg_data);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_rx, lost);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_rx, rtt_min);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_rx, out_of_order_queue);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_read_rx, snd_ssthresh);
+	CACHELINE_ASSERT_GROUP_SIZE(struct tcp_sock, tcp_sock_read_rx, 69);
+
+	/* TX read-write fields */
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, segs_out);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, data_segs_out);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, bytes_sent);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, snd_sml);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, chrono_start);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, chrono_stat);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, write_seq);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, pushed_seq);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, lsndtime);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, mdev_us);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, rtt_seq);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, tcp_wstamp_ns);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, tsorted_sent_queue);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, highest_sack);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_tx, ecn_flags);
+	CACHELINE_ASSERT_GROUP_SIZE(struct tcp_sock, tcp_sock_write_tx, 90);
+
+	/* TXRX read-write fields */
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, pred_flags);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, tcp_clock_cache);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, tcp_mstamp);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, rcv_nxt);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, snd_nxt);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, snd_una);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, window_clamp);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, srtt_us);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, packets_out);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, snd_up);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, delivered);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, delivered_ce);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, app_limited);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, rcv_wnd);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_txrx, rx_opt);
+	CACHELINE_ASSERT_GROUP_SIZE(struct tcp_sock, tcp_sock_write_txrx, 91);
+
+	/* RX read-write fields */
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, bytes_received);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, segs_in);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, data_segs_in);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, rcv_wup);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, max_packets_out);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, max_packets_seq);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, rate_delivered);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, rate_interval_us);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, rcv_rtt_last_tsecr);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, first_tx_mstamp);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, delivered_mstamp);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, bytes_acked);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, rcv_rtt_est);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct tcp_sock, tcp_sock_write_rx, rcvq_space);
+	CACHELINE_ASSERT_GROUP_SIZE(struct tcp_sock, tcp_sock_write_rx, 96);
+}
+
 void __init tcp_init(void)
 {
 	int max_rshare, max_wshare, cnt;
@@ -3841,6 +4086,7 @@ void __init tcp_init(void)
 
 	BUILD_BUG_ON(sizeof(struct tcp_skb_cb) >
 		     FIELD_SIZEOF(struct sk_buff, cb));
+	tcp_struct_check();
 
 	percpu_counter_init(&tcp_sockets_allocated, 0, GFP_KERNEL);
 	percpu_counter_init(&tcp_orphan_count, 0, GFP_KERNEL);
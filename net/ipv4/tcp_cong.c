@@ -152,6 +152,24 @@ char *tcp_ca_get_name_by_key(u32 key, char *buffer)
 }
 EXPORT_SYMBOL_GPL(tcp_ca_get_name_by_key);
 
+/* A socket using @ca pins the module it comes from, or for a BPF
+ * congestion control the map holding its programs.
+ */
+bool tcp_ca_get(const struct tcp_congestion_ops *ca)
+{
+	if (ca->flags & TCP_CONG_BPF)
+		return bpf_tcp_ca_get(ca);
+	return try_module_get(ca->owner);
+}
+
+void tcp_ca_put(const struct tcp_congestion_ops *ca)
+{
+	if (ca->flags & TCP_CONG_BPF)
+		bpf_tcp_ca_put(ca);
+	else
+		module_put(ca->owner);
+}
+
 /* Assign choice of congestion control. */
 void tcp_assign_congestion_control(struct sock *sk)
 {
@@ -161,7 +179,7 @@ void tcp_assign_congestion_control(struct sock *sk)
 
 	rcu_read_lock();
 	ca = rcu_dereference(net->ipv4.tcp_congestion_control);
-	if (unlikely(!try_module_get(ca->owner)))
+	if (unlikely(!tcp_ca_get(ca)))
 		ca = &tcp_reno;
 	icsk->icsk_ca_ops = ca;
 	rcu_read_unlock();
@@ -207,7 +225,7 @@ void tcp_cleanup_congestion_control(struct sock *sk)
 
 	if (icsk->icsk_ca_ops->release)
 		icsk->icsk_ca_ops->release(sk);
-	module_put(icsk->icsk_ca_ops->owner);
+	tcp_ca_put(icsk->icsk_ca_ops);
 }
 
 /* Used by sysctl to change default congestion control */
@@ -221,12 +239,12 @@ int tcp_set_default_congestion_control(struct net *net, const char *name)
 	ca = tcp_ca_find_autoload(net, name);
 	if (!ca) {
 		ret = -ENOENT;
-	} else if (!try_module_get(ca->owner)) {
+	} else if (!tcp_ca_get(ca)) {
 		ret = -EBUSY;
 	} else {
 		prev = xchg(&net->ipv4.tcp_congestion_control, ca);
 		if (prev)
-			module_put(prev->owner);
+			tcp_ca_put(prev);
 
 		ca->flags |= TCP_CONG_NON_RESTRICTED;
 		ret = 0;
@@ -358,12 +376,12 @@ int tcp_set_congestion_control(struct sock *sk, const char *name, bool load, boo
 	} else if (!load) {
 		const struct tcp_congestion_ops *old_ca = icsk->icsk_ca_ops;
 
-		if (try_module_get(ca->owner)) {
+		if (tcp_ca_get(ca)) {
 			if (reinit) {
 				tcp_reinit_congestion_control(sk, ca);
 			} else {
 				icsk->icsk_ca_ops = ca;
-				module_put(old_ca->owner);
+				tcp_ca_put(old_ca);
 			}
 		} else {
 			err = -EBUSY;
@@ -371,7 +389,7 @@ int tcp_set_congestion_control(struct sock *sk, const char *name, bool load, boo
 	} else if (!((ca->flags & TCP_CONG_NON_RESTRICTED) ||
 		     ns_capable(sock_net(sk)->user_ns, CAP_NET_ADMIN))) {
 		err = -EPERM;
-	} else if (!try_module_get(ca->owner)) {
+	} else if (!tcp_ca_get(ca)) {
 		err = -EBUSY;
 	} else {
 		tcp_reinit_congestion_control(sk, ca);
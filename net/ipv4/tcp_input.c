@@ -588,6 +588,60 @@ static inline void tcp_rcv_rtt_measure_ts(struct sock *sk,
 	}
 }
 
+/* Receive buffer needed to hold rcvwin bytes of payload */
+static int tcp_rcvbuf_from_win(const struct sock *sk, u64 rcvwin)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	int rcvmem;
+
+	rcvmem = SKB_TRUESIZE(tp->advmss + MAX_TCP_HEADER);
+	while (tcp_win_from_space(sk, rcvmem) < tp->advmss)
+		rcvmem += 128;
+
+	do_div(rcvwin, tp->advmss);
+	return min_t(u64, rcvwin * rcvmem,
+		     sock_net(sk)->ipv4.sysctl_tcp_rmem[2]);
+}
+
+/* Number of receiver RTTs without reads after which the measured
+ * consumption rate is forgotten instead of slowly decayed.
+ */
+#define TCP_RCV_SPACE_IDLE_RTTS	16
+
+/* With tcp_moderate_rcvbuf == 2, give back receive buffer space when the
+ * application consumes less than what was last measured: the estimate
+ * decays by 1/4 per measurement, or is reset after an idle period, and
+ * sk_rcvbuf follows it down to tcp_rmem[1]. The window clamp is lowered
+ * with it. Neither goes below the window already offered or the memory
+ * already queued, or in-window data would be dropped.
+ */
+static void tcp_rcv_space_shrink(struct sock *sk, u32 copied, int time)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	u32 space = tp->rcvq_space.space;
+	u32 rcv_wnd = tcp_receive_window(tp);
+	int rcvbuf;
+
+	if (time > (tp->rcv_rtt_est.rtt_us >> 3) * TCP_RCV_SPACE_IDLE_RTTS)
+		space = copied;
+	else
+		space -= (space - copied) >> 2;
+	space = max_t(u32, space, TCP_INIT_CWND * tp->advmss);
+	tp->rcvq_space.space = space;
+
+	rcvbuf = tcp_rcvbuf_from_win(sk, ((u64)space << 1) + 16 * tp->advmss);
+	rcvbuf = max(rcvbuf, sock_net(sk)->ipv4.sysctl_tcp_rmem[1]);
+	rcvbuf = max(rcvbuf, tcp_rcvbuf_from_win(sk, rcv_wnd));
+	rcvbuf = max(rcvbuf, atomic_read(&sk->sk_rmem_alloc));
+	if (rcvbuf >= sk->sk_rcvbuf)
+		return;
+
+	sk->sk_rcvbuf = rcvbuf;
+	tp->window_clamp = max_t(u32, tcp_win_from_space(sk, rcvbuf), rcv_wnd);
+	tp->rcv_ssthresh = min(tp->rcv_ssthresh, tp->window_clamp);
+	sk_mem_reclaim(sk);
+}
+
 /*
  * This function should be called every time data is copied to user space.
  * It calculates the appropriate TCP receive buffer space.
@@ -607,8 +661,12 @@ void tcp_rcv_space_adjust(struct sock *sk)
 
 	/* Number of bytes copied to user in last RTT */
 	copied = tp->copied_seq - tp->rcvq_space.seq;
-	if (copied <= tp->rcvq_space.space)
+	if (copied <= tp->rcvq_space.space) {
+		if (sock_net(sk)->ipv4.sysctl_tcp_moderate_rcvbuf == 2 &&
+		    !(sk->sk_userlocks & SOCK_RCVBUF_LOCK))
+			tcp_rcv_space_shrink(sk, copied, time);
 		goto new_measure;
+	}
 
 	/* A bit of theory :
 	 * copied = bytes received in previous RTT, our base window
@@ -621,8 +679,8 @@ void tcp_rcv_space_adjust(struct sock *sk)
 
 	if (sock_net(sk)->ipv4.sysctl_tcp_moderate_rcvbuf &&
 	    !(sk->sk_userlocks & SOCK_RCVBUF_LOCK)) {
-		int rcvmem, rcvbuf;
 		u64 rcvwin, grow;
+		int rcvbuf;
 
 		/* minimal window to cope with packet losses, assuming
 		 * steady state. Add some cushion because of small variations.
@@ -634,13 +692,7 @@ void tcp_rcv_space_adjust(struct sock *sk)
 		do_div(grow, tp->rcvq_space.space);
 		rcvwin += (grow << 1);
 
-		rcvmem = SKB_TRUESIZE(tp->advmss + MAX_TCP_HEADER);
-		while (tcp_win_from_space(sk, rcvmem) < tp->advmss)
-			rcvmem += 128;
-
-		do_div(rcvwin, tp->advmss);
-		rcvbuf = min_t(u64, rcvwin * rcvmem,
-			       sock_net(sk)->ipv4.sysctl_tcp_rmem[2]);
+		rcvbuf = tcp_rcvbuf_from_win(sk, rcvwin);
 		if (rcvbuf > sk->sk_rcvbuf) {
 			sk->sk_rcvbuf = rcvbuf;
 
@@ -5155,7 +5207,9 @@ static void tcp_check_space(struct sock *sk)
 
 static inline void tcp_data_snd_check(struct sock *sk)
 {
-	tcp_push_pending_frames(sk);
+	if (!sock_net(sk)->ipv4.sysctl_tcp_ack_xmit_batch ||
+	    !tcp_defer_xmit(sk))
+		tcp_push_pending_frames(sk);
 	tcp_check_space(sk);
 }
 
@@ -5217,8 +5271,12 @@ static void __tcp_ack_snd_check(struct sock *sk, int ofo_possible)
 	delay = min_t(unsigned long, sock_net(sk)->ipv4.sysctl_tcp_comp_sack_delay_ns,
 		      rtt * (NSEC_PER_USEC >> 3)/20);
 	sock_hold(sk);
-	hrtimer_start(&tp->compressed_ack_timer, ns_to_ktime(delay),
-		      HRTIMER_MODE_REL_PINNED_SOFT);
+	/* The exact firing time does not matter, let the timer expire
+	 * together with other timers of this cpu.
+	 */
+	hrtimer_start_range_ns(&tp->compressed_ack_timer, ns_to_ktime(delay),
+			       sock_net(sk)->ipv4.sysctl_tcp_comp_sack_slack_ns,
+			       HRTIMER_MODE_REL_PINNED_SOFT);
 }
 
 static inline void tcp_ack_snd_check(struct sock *sk)
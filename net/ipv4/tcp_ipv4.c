@@ -1689,7 +1689,18 @@ static void tcp_v4_fill_cb(struct sk_buff *skb, const struct iphdr *iph,
  *	From tcp_input.c
  */
 
-int tcp_v4_rcv(struct sk_buff *skb)
+static void tcp_v4_release_held(struct sock **held)
+{
+	bh_unlock_sock(*held);
+	sock_put(*held);
+	*held = NULL;
+}
+
+/* @held is only set by tcp_v4_list_rcv(): the socket lock (and a
+ * reference) of the previous segment's socket may be kept in *held, and
+ * is reused if this segment goes to the same socket.
+ */
+static int __tcp_v4_rcv(struct sk_buff *skb, struct sock **held)
 {
 	struct net *net = dev_net(skb->dev);
 	int sdif = inet_sdif(skb);
@@ -1819,15 +1830,31 @@ int tcp_v4_rcv(struct sk_buff *skb)
 
 	sk_incoming_cpu_update(sk);
 
-	bh_lock_sock_nested(sk);
+	if (held && *held && *held != sk)
+		tcp_v4_release_held(held);
+	if (!held || !*held)
+		bh_lock_sock_nested(sk);
 	tcp_segs_in(tcp_sk(sk), skb);
 	ret = 0;
 	if (!sock_owned_by_user(sk)) {
 		ret = tcp_v4_do_rcv(sk, skb);
 	} else if (tcp_add_backlog(sk, skb)) {
+		/* tcp_add_backlog() released the socket lock */
+		if (held && *held) {
+			sock_put(*held);
+			*held = NULL;
+		}
 		goto discard_and_relse;
 	}
-	bh_unlock_sock(sk);
+	if (!held) {
+		bh_unlock_sock(sk);
+	} else if (!*held) {
+		/* Keep the lock, and a reference, for the next segment */
+		if (!refcounted)
+			sock_hold(sk);
+		refcounted = false;
+		*held = sk;
+	}
 
 put_and_return:
 	if (refcounted)
@@ -1904,6 +1931,31 @@ int tcp_v4_rcv(struct sk_buff *skb)
 	goto discard_it;
 }
 
+int tcp_v4_rcv(struct sk_buff *skb)
+{
+	return __tcp_v4_rcv(skb, NULL);
+}
+
+/* Receive a list of segments sharing a dst.  Consecutive segments that
+ * early demux steered to the same socket are processed under a single
+ * acquisition of that socket's lock.
+ */
+void tcp_v4_list_rcv(struct list_head *head)
+{
+	struct sk_buff *skb, *next;
+	struct sock *held = NULL;
+
+	list_for_each_entry_safe(skb, next, head, list) {
+		skb_list_del_init(skb);
+		/* Never process another socket's segment under our lock */
+		if (held && skb->sk != held)
+			tcp_v4_release_held(&held);
+		__tcp_v4_rcv(skb, &held);
+	}
+	if (held)
+		tcp_v4_release_held(&held);
+}
+
 static struct timewait_sock_ops tcp_timewait_sock_ops = {
 	.twsk_obj_size	= sizeof(struct tcp_timewait_sock),
 	.twsk_unique	= tcp_twsk_unique,
@@ -2496,7 +2548,7 @@ static void __net_exit tcp_sk_exit(struct net *net)
 {
 	int cpu;
 
-	module_put(net->ipv4.tcp_congestion_control->owner);
+	tcp_ca_put(net->ipv4.tcp_congestion_control);
 
 	for_each_possible_cpu(cpu)
 		inet_ctl_sock_destroy(*per_cpu_ptr(net->ipv4.tcp_sk, cpu));
@@ -2580,6 +2632,7 @@ static int __net_init tcp_sk_init(struct net *net)
 	net->ipv4.sysctl_tcp_min_tso_segs = 2;
 	net->ipv4.sysctl_tcp_min_rtt_wlen = 300;
 	net->ipv4.sysctl_tcp_autocorking = 1;
+	net->ipv4.sysctl_tcp_ack_xmit_batch = 0;
 	net->ipv4.sysctl_tcp_invalid_ratelimit = HZ/2;
 	net->ipv4.sysctl_tcp_pacing_ss_ratio = 200;
 	net->ipv4.sysctl_tcp_pacing_ca_ratio = 120;
@@ -2592,6 +2645,7 @@ static int __net_init tcp_sk_init(struct net *net)
 		       sizeof(init_net.ipv4.sysctl_tcp_wmem));
 	}
 	net->ipv4.sysctl_tcp_comp_sack_delay_ns = NSEC_PER_MSEC;
+	net->ipv4.sysctl_tcp_comp_sack_slack_ns = 100 * NSEC_PER_USEC;
 	net->ipv4.sysctl_tcp_comp_sack_nr = 44;
 	net->ipv4.sysctl_tcp_fastopen = TFO_CLIENT_ENABLE;
 	spin_lock_init(&net->ipv4.tcp_fastopen_ctx_lock);
@@ -2600,7 +2654,7 @@ static int __net_init tcp_sk_init(struct net *net)
 
 	/* Reno is always built in */
 	if (!net_eq(net, &init_net) &&
-	    try_module_get(init_net.ipv4.tcp_congestion_control->owner))
+	    tcp_ca_get(init_net.ipv4.tcp_congestion_control))
 		net->ipv4.tcp_congestion_control = init_net.ipv4.tcp_congestion_control;
 	else
 		net->ipv4.tcp_congestion_control = &tcp_reno;
@@ -961,6 +961,53 @@ void tcp_wfree(struct sk_buff *skb)
 	sk_free(sk);
 }
 
+/* Called from the receive softirq when an incoming ACK opened room in
+ * the window. Rather than sending right away, queue the socket to the
+ * TSQ tasklet, which runs once the current NAPI batch is processed:
+ * all ACKs received in that batch then result in a single
+ * tcp_write_xmit() call, building fewer and larger TSO packets and
+ * walking the IP output path and the qdisc once per burst.
+ * Only done with packets in flight, so that the RTO timer covers us and
+ * the zero window probe timer logic of tcp_push_pending_frames() is not
+ * needed. Returns false if the caller should transmit itself.
+ * Off unless net.ipv4.tcp_ack_xmit_batch is set: delaying the transmit
+ * to the tasklet trades latency for fewer calls, and that has not been
+ * measured beyond bulk transfers.
+ */
+bool tcp_defer_xmit(struct sock *sk)
+{
+	unsigned long flags, nval, oval;
+
+	if (!in_serving_softirq() || !tcp_send_head(sk) ||
+	    !tcp_sk(sk)->packets_out)
+		return false;
+
+	for (oval = READ_ONCE(sk->sk_tsq_flags);; oval = nval) {
+		struct tsq_tasklet *tsq;
+		bool empty;
+
+		/* Already queued, the pending tasklet run will transmit */
+		if (oval & TSQF_QUEUED)
+			return true;
+
+		nval = cmpxchg(&sk->sk_tsq_flags, oval, oval | TSQF_QUEUED);
+		if (nval != oval)
+			continue;
+
+		/* Same reference tcp_wfree() keeps for the tasklet */
+		refcount_inc(&sk->sk_wmem_alloc);
+
+		local_irq_save(flags);
+		tsq = this_cpu_ptr(&tsq_tasklet);
+		empty = list_empty(&tsq->head);
+		list_add(&tcp_sk(sk)->tsq_node, &tsq->head);
+		if (empty)
+			tasklet_schedule(&tsq->tasklet);
+		local_irq_restore(flags);
+		return true;
+	}
+}
+
 /* Note: Called under soft irq.
  * We can call TCP stack right away, unless socket is owned by user.
  */
@@ -3303,8 +3350,8 @@ static void tcp_ca_dst_init(struct sock *sk, const struct dst_entry *dst)
 
 	rcu_read_lock();
 	ca = tcp_ca_find_key(ca_key);
-	if (likely(ca && try_module_get(ca->owner))) {
-		module_put(icsk->icsk_ca_ops->owner);
+	if (likely(ca && tcp_ca_get(ca))) {
+		tcp_ca_put(icsk->icsk_ca_ops);
 		icsk->icsk_ca_dst_locked = tcp_ca_dst_locked(dst);
 		icsk->icsk_ca_ops = ca;
 	}
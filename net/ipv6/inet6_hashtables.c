@@ -24,6 +24,7 @@
 #include <net/secure_seq.h>
 #include <net/ip.h>
 #include <net/sock_reuseport.h>
+#include <net/tcp.h>
 
 u32 inet6_ehashfn(const struct net *net,
 		  const struct in6_addr *laddr, const u16 lport,
@@ -159,6 +160,38 @@ static struct sock *inet6_lhash2_lookup(struct net *net,
 	return result;
 }
 
+static struct sock *inet6_lookup_run_bpf(struct net *net,
+					 struct inet_hashinfo *hashinfo,
+					 struct sk_buff *skb, int doff,
+					 const struct in6_addr *saddr,
+					 const __be16 sport,
+					 const struct in6_addr *daddr,
+					 const u16 hnum)
+{
+	struct bpf_sk_lookup_kern ctx = {
+		.net		= net,
+		.family		= AF_INET6,
+		.protocol	= IPPROTO_TCP,
+		.v6.saddr	= *saddr,
+		.v6.daddr	= *daddr,
+		.sport		= sport,
+		.dport		= hnum,
+	};
+	struct sock *sk, *reuse_sk;
+	u32 phash;
+
+	if (hashinfo != &tcp_hashinfo)
+		return NULL; /* only TCP is supported */
+
+	sk = bpf_run_sk_lookup(&ctx);
+	if (IS_ERR_OR_NULL(sk) || !sk->sk_reuseport)
+		return sk;
+
+	phash = inet6_ehashfn(net, daddr, hnum, saddr, sport);
+	reuse_sk = reuseport_select_sock(sk, phash, skb, doff);
+	return reuse_sk ? : sk;
+}
+
 struct sock *inet6_lookup_listener(struct net *net,
 		struct inet_hashinfo *hashinfo,
 		struct sk_buff *skb, int doff,
@@ -175,6 +208,14 @@ struct sock *inet6_lookup_listener(struct net *net,
 	unsigned int hash2;
 	u32 phash = 0;
 
+	/* Lookup redirect from BPF */
+	if (static_branch_unlikely(&bpf_sk_lookup_enabled)) {
+		result = inet6_lookup_run_bpf(net, hashinfo, skb, doff,
+					      saddr, sport, daddr, hnum);
+		if (result)
+			goto done;
+	}
+
 	if (ilb->count <= 10 || !hashinfo->lhash2)
 		goto port_lookup;
 
@@ -86,6 +86,8 @@ static __read_mostly bool nf_conntrack_locks_all;
 #define GC_MAX_SCAN_JIFFIES	(16u * HZ)
 /* desired ratio of entries found to be expired */
 #define GC_EVICT_RATIO	50u
+/* buckets scanned per rcu read side section / resched point */
+#define GC_SCAN_BATCH	16u
 
 static struct conntrack_gc_work conntrack_gc_work;
 
@@ -1155,7 +1157,8 @@ static void gc_worker(struct work_struct *work)
 		struct nf_conn *tmp;
 
 		i++;
-		rcu_read_lock();
+		if (buckets % GC_SCAN_BATCH == 0)
+			rcu_read_lock();
 
 		nf_conntrack_get_ht(&ct_hash, &hashsz);
 		if (i >= hashsz)
@@ -1203,10 +1206,17 @@ static void gc_worker(struct work_struct *work)
 		/* could check get_nulls_value() here and restart if ct
 		 * was moved to another chain.  But given gc is best-effort
 		 * we will just continue with next hash slot.
+		 *
+		 * Empty and short chains are the common case, so only leave
+		 * the rcu read side section and offer to reschedule once per
+		 * batch of buckets instead of once per bucket.
 		 */
-		rcu_read_unlock();
-		cond_resched();
-	} while (++buckets < goal);
+		buckets++;
+		if (buckets % GC_SCAN_BATCH == 0 || buckets >= goal) {
+			rcu_read_unlock();
+			cond_resched();
+		}
+	} while (buckets < goal);
 
 	if (gc_work->exiting)
 		return;
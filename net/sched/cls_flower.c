@@ -84,6 +84,9 @@ struct fl_flow_tmplt {
 struct cls_fl_head {
 	struct rhashtable ht;
 	struct list_head masks;
+	/* union of the dissectors and key ranges of all masks, only grows */
+	struct flow_dissector dissector;
+	struct fl_flow_mask_range range;
 	struct rcu_work rwork;
 	struct idr handle_idr;
 };
@@ -173,12 +176,6 @@ static bool fl_mask_fits_tmplt(struct fl_flow_tmplt *tmplt,
 	return true;
 }
 
-static void fl_clear_masked_range(struct fl_flow_key *key,
-				  struct fl_flow_mask *mask)
-{
-	memset(fl_key_get_start(key, mask), 0, fl_mask_range(mask));
-}
-
 static struct cls_fl_filter *fl_lookup(struct fl_flow_mask *mask,
 				       struct fl_flow_key *mkey)
 {
@@ -194,17 +191,37 @@ static int fl_classify(struct sk_buff *skb, const struct tcf_proto *tp,
 	struct fl_flow_mask *mask;
 	struct fl_flow_key skb_key;
 	struct fl_flow_key skb_mkey;
+	unsigned short int start, end;
+	unsigned int used_keys;
 
-	list_for_each_entry_rcu(mask, &head->masks, list) {
-		fl_clear_masked_range(&skb_key, mask);
+	if (list_empty(&head->masks))
+		return -1;
 
-		skb_key.indev_ifindex = skb->skb_iif;
-		/* skb_flow_dissect() does not set n_proto in case an unknown
-		 * protocol, so do it rather here.
+	/* Dissect once for all masks, each of them only looks at the
+	 * fields it has set.  The acquire pairs with fl_head_add_mask():
+	 * the range read below covers every key in used_keys.
+	 */
+	used_keys = smp_load_acquire(&head->dissector.used_keys);
+	start = READ_ONCE(head->range.start);
+	end = READ_ONCE(head->range.end);
+	if (end > start)
+		memset((u8 *) &skb_key + start, 0, end - start);
+
+	skb_key.indev_ifindex = skb->skb_iif;
+	/* skb_flow_dissect() does not set n_proto in case an unknown
+	 * protocol, so do it rather here.
+	 */
+	skb_key.basic.n_proto = skb->protocol;
+	skb_flow_dissect_tunnel_info(skb, &head->dissector, &skb_key);
+	skb_flow_dissect(skb, &head->dissector, &skb_key, 0);
+
+	list_for_each_entry_rcu(mask, &head->masks, list) {
+		/* added after the snapshot above, its fields may be left
+		 * undissected or uncleared; the packet raced the insert
 		 */
-		skb_key.basic.n_proto = skb->protocol;
-		skb_flow_dissect_tunnel_info(skb, &mask->dissector, &skb_key);
-		skb_flow_dissect(skb, &mask->dissector, &skb_key, 0);
+		if ((mask->dissector.used_keys & ~used_keys) ||
+		    mask->range.start < start || mask->range.end > end)
+			continue;
 
 		fl_set_masked_key(&skb_mkey, &skb_key, mask);
 
@@ -226,6 +243,7 @@ static int fl_init(struct tcf_proto *tp)
 		return -ENOBUFS;
 
 	INIT_LIST_HEAD_RCU(&head->masks);
+	head->range.start = sizeof(struct fl_flow_key);
 	rcu_assign_pointer(tp->root, head);
 	idr_init(&head->handle_idr);
 
@@ -1074,6 +1092,33 @@ static void fl_init_dissector(struct flow_dissector *dissector,
 	skb_flow_dissector_init(dissector, keys, cnt);
 }
 
+/*
+ * Grow the dissector and key range that fl_classify() uses for all masks
+ * to cover @mask.  Offsets and range are written before the release of
+ * used_keys, so a classify that sees a key with its acquire never
+ * dissects into a bogus offset or leaves the key's bytes uncleared.
+ */
+static void fl_head_add_mask(struct cls_fl_head *head,
+			     struct fl_flow_mask *mask)
+{
+	unsigned int used_keys = head->dissector.used_keys;
+	int i;
+
+	for (i = 0; i < FLOW_DISSECTOR_KEY_MAX; i++) {
+		if (dissector_uses_key(&mask->dissector, i) &&
+		    !(used_keys & (1U << i))) {
+			head->dissector.offset[i] = mask->dissector.offset[i];
+			used_keys |= 1U << i;
+		}
+	}
+	if (mask->range.start < head->range.start)
+		WRITE_ONCE(head->range.start, mask->range.start);
+	if (mask->range.end > head->range.end)
+		WRITE_ONCE(head->range.end, mask->range.end);
+
+	smp_store_release(&head->dissector.used_keys, used_keys);
+}
+
 static struct fl_flow_mask *fl_create_new_mask(struct cls_fl_head *head,
 					       struct fl_flow_mask *mask)
 {
@@ -1099,6 +1144,7 @@ static struct fl_flow_mask *fl_create_new_mask(struct cls_fl_head *head,
 	if (err)
 		goto errout_destroy;
 
+	fl_head_add_mask(head, newmask);
 	list_add_tail_rcu(&newmask->list, &head->masks);
 
 	return newmask;
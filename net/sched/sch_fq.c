@@ -68,9 +68,13 @@ struct fq_flow {
 	int		qlen;		/* number of packets in flow queue */
 	int		credit;
 	u32		socket_hash;	/* sk_hash */
+	u32		wheel_slot;	/* q->wheel[] index, or FQ_WHEEL_NONE */
 	struct fq_flow *next;		/* next pointer in RR lists, or &detached */
 
-	struct rb_node  rate_node;	/* anchor in q->delayed tree */
+	union {
+		struct rb_node   rate_node;	/* anchor in q->delayed tree */
+		struct list_head wheel_node;	/* anchor in q->wheel[] slot */
+	};
 	u64		time_next_packet;
 };
 
@@ -88,6 +92,12 @@ struct fq_sched_data {
 	u64		time_next_delayed_flow;
 	unsigned long	unthrottle_latency_ns;
 
+	struct list_head *wheel;	/* optional timing wheel for rate limited flows */
+	unsigned long	*wheel_map;	/* non empty slots of q->wheel[] */
+	u64		wheel_clock;	/* first slot not yet scanned */
+	u32		timer_slack;	/* hrtimer slack in ns */
+	u8		wheel_log;
+
 	struct fq_flow	internal;	/* for non classified or high prio packets */
 	u32		quantum;
 	u32		initial_quantum;
@@ -142,9 +152,25 @@ static void fq_flow_add_tail(struct fq_flow_head *head, struct fq_flow *flow)
 	flow->next = NULL;
 }
 
+/* Throttled flows whose next packet is due within the span of the timing
+ * wheel are hashed into a slot of 2^FQ_WHEEL_GRAN_LOG ns, instead of being
+ * inserted into the q->delayed rb-tree. Slots are only released once they
+ * are entirely in the past, so a flow can be held back at most one slot
+ * longer than its time_next_packet, but never released early.
+ */
+#define FQ_WHEEL_GRAN_LOG	13	/* 8.192 usec per slot */
+#define FQ_WHEEL_MAX_LOG	16
+#define FQ_WHEEL_NONE		(~0U)
+
 static void fq_flow_unset_throttled(struct fq_sched_data *q, struct fq_flow *f)
 {
-	rb_erase(&f->rate_node, &q->delayed);
+	if (f->wheel_slot != FQ_WHEEL_NONE) {
+		list_del(&f->wheel_node);
+		if (list_empty(&q->wheel[f->wheel_slot]))
+			__clear_bit(f->wheel_slot, q->wheel_map);
+	} else {
+		rb_erase(&f->rate_node, &q->delayed);
+	}
 	q->throttled_flows--;
 	fq_flow_add_tail(&q->old_flows, f);
 }
@@ -152,7 +178,23 @@ static void fq_flow_unset_throttled(struct fq_sched_data *q, struct fq_flow *f)
 static void fq_flow_set_throttled(struct fq_sched_data *q, struct fq_flow *f)
 {
 	struct rb_node **p = &q->delayed.rb_node, *parent = NULL;
+	u64 slot = f->time_next_packet >> FQ_WHEEL_GRAN_LOG;
+	u64 next = f->time_next_packet;
 
+	q->throttled_flows++;
+	q->stat_throttled++;
+	f->next = &throttled;
+
+	/* fq_check_throttled() just moved q->wheel_clock to the current slot */
+	if (q->wheel && slot - q->wheel_clock < (1ULL << q->wheel_log)) {
+		f->wheel_slot = slot & ((1U << q->wheel_log) - 1);
+		list_add_tail(&f->wheel_node, &q->wheel[f->wheel_slot]);
+		__set_bit(f->wheel_slot, q->wheel_map);
+		next = (slot + 1) << FQ_WHEEL_GRAN_LOG;
+		goto out;
+	}
+
+	f->wheel_slot = FQ_WHEEL_NONE;
 	while (*p) {
 		struct fq_flow *aux;
 
@@ -165,12 +207,9 @@ static void fq_flow_set_throttled(struct fq_sched_data *q, struct fq_flow *f)
 	}
 	rb_link_node(&f->rate_node, parent, p);
 	rb_insert_color(&f->rate_node, &q->delayed);
-	q->throttled_flows++;
-	q->stat_throttled++;
-
-	f->next = &throttled;
-	if (q->time_next_delayed_flow > f->time_next_packet)
-		q->time_next_delayed_flow = f->time_next_packet;
+out:
+	if (q->time_next_delayed_flow > next)
+		q->time_next_delayed_flow = next;
 }
 
 
@@ -382,13 +421,66 @@ static int fq_enqueue(struct sk_buff *skb, struct Qdisc *sch,
 	return NET_XMIT_SUCCESS;
 }
 
+static void fq_wheel_release_slot(struct fq_sched_data *q, unsigned long idx)
+{
+	struct fq_flow *f, *tmp;
+
+	list_for_each_entry_safe(f, tmp, &q->wheel[idx], wheel_node) {
+		q->throttled_flows--;
+		fq_flow_add_tail(&q->old_flows, f);
+	}
+	INIT_LIST_HEAD(&q->wheel[idx]);
+	__clear_bit(idx, q->wheel_map);
+}
+
+/* Release all wheel slots older than the slot of @now, and return the time
+ * at which the next non empty slot will be over (or ~0ULL).
+ */
+static u64 fq_wheel_advance(struct fq_sched_data *q, u64 now)
+{
+	unsigned long nslots = 1UL << q->wheel_log;
+	unsigned long mask = nslots - 1;
+	u64 now_slot = now >> FQ_WHEEL_GRAN_LOG;
+	u64 todo = min_t(u64, now_slot - q->wheel_clock, nslots);
+	unsigned long idx = q->wheel_clock & mask;
+	unsigned long bit;
+
+	while (todo) {
+		unsigned long end = idx + min_t(u64, todo, nslots - idx);
+
+		bit = find_next_bit(q->wheel_map, end, idx);
+		if (bit == end) {
+			todo -= end - idx;
+			idx = end & mask;
+			continue;
+		}
+		fq_wheel_release_slot(q, bit);
+		todo -= bit + 1 - idx;
+		idx = (bit + 1) & mask;
+	}
+	q->wheel_clock = now_slot;
+
+	idx = now_slot & mask;
+	bit = find_next_bit(q->wheel_map, nslots, idx);
+	if (bit == nslots) {
+		bit = find_first_bit(q->wheel_map, idx);
+		if (bit == idx)
+			return ~0ULL;
+	}
+	return (now_slot + ((bit - idx) & mask) + 1) << FQ_WHEEL_GRAN_LOG;
+}
+
 static void fq_check_throttled(struct fq_sched_data *q, u64 now)
 {
 	unsigned long sample;
 	struct rb_node *p;
 
-	if (q->time_next_delayed_flow > now)
+	if (q->time_next_delayed_flow > now) {
+		/* No wheel slot older than @now can hold a flow. */
+		if (q->wheel)
+			q->wheel_clock = now >> FQ_WHEEL_GRAN_LOG;
 		return;
+	}
 
 	/* Update unthrottle latency EWMA.
 	 * This is cheap and can help diagnosing timer/latency problems.
@@ -407,6 +499,9 @@ static void fq_check_throttled(struct fq_sched_data *q, u64 now)
 		}
 		fq_flow_unset_throttled(q, f);
 	}
+	if (q->wheel)
+		q->time_next_delayed_flow = min(q->time_next_delayed_flow,
+						fq_wheel_advance(q, now));
 }
 
 static struct sk_buff *fq_dequeue(struct Qdisc *sch)
@@ -429,8 +524,9 @@ static struct sk_buff *fq_dequeue(struct Qdisc *sch)
 		head = &q->old_flows;
 		if (!head->first) {
 			if (q->time_next_delayed_flow != ~0ULL)
-				qdisc_watchdog_schedule_ns(&q->watchdog,
-							   q->time_next_delayed_flow);
+				qdisc_watchdog_schedule_range_ns(&q->watchdog,
+							q->time_next_delayed_flow,
+							q->timer_slack);
 			return NULL;
 		}
 	}
@@ -559,6 +655,12 @@ static void fq_reset(struct Qdisc *sch)
 	q->flows		= 0;
 	q->inactive_flows	= 0;
 	q->throttled_flows	= 0;
+
+	if (q->wheel) {
+		for_each_set_bit(idx, q->wheel_map, 1U << q->wheel_log)
+			INIT_LIST_HEAD(&q->wheel[idx]);
+		bitmap_zero(q->wheel_map, 1U << q->wheel_log);
+	}
 }
 
 static void fq_rehash(struct fq_sched_data *q,
@@ -646,6 +748,65 @@ static int fq_resize(struct Qdisc *sch, u32 log)
 	return 0;
 }
 
+/* Caller holds the tree lock. Flows sitting in the old wheel go back to
+ * old_flows, fq_dequeue() throttles them again if they are still early.
+ */
+static void fq_wheel_flush(struct fq_sched_data *q)
+{
+	unsigned long idx;
+	struct rb_node *p;
+
+	if (!q->wheel)
+		return;
+	for_each_set_bit(idx, q->wheel_map, 1U << q->wheel_log)
+		fq_wheel_release_slot(q, idx);
+
+	p = rb_first(&q->delayed);
+	q->time_next_delayed_flow = p ?
+		rb_entry(p, struct fq_flow, rate_node)->time_next_packet : ~0ULL;
+}
+
+static int fq_wheel_resize(struct Qdisc *sch, u32 log)
+{
+	struct fq_sched_data *q = qdisc_priv(sch);
+	struct list_head *wheel = NULL;
+	unsigned long *map = NULL;
+	void *old_wheel;
+	u32 idx;
+
+	if (log == (q->wheel ? q->wheel_log : 0))
+		return 0;
+
+	if (log) {
+		wheel = kvmalloc_node((sizeof(struct list_head) << log) +
+				      BITS_TO_LONGS(1U << log) * sizeof(long),
+				      GFP_KERNEL | __GFP_RETRY_MAYFAIL,
+				      netdev_queue_numa_node_read(sch->dev_queue));
+		if (!wheel)
+			return -ENOMEM;
+
+		for (idx = 0; idx < (1U << log); idx++)
+			INIT_LIST_HEAD(&wheel[idx]);
+		map = (unsigned long *)&wheel[1U << log];
+		bitmap_zero(map, 1U << log);
+	}
+
+	sch_tree_lock(sch);
+
+	old_wheel = q->wheel;
+	fq_wheel_flush(q);
+	q->wheel = wheel;
+	q->wheel_map = map;
+	q->wheel_log = log;
+	q->wheel_clock = ktime_get_ns() >> FQ_WHEEL_GRAN_LOG;
+
+	sch_tree_unlock(sch);
+
+	fq_free(old_wheel);
+
+	return 0;
+}
+
 static const struct nla_policy fq_policy[TCA_FQ_MAX + 1] = {
 	[TCA_FQ_PLIMIT]			= { .type = NLA_U32 },
 	[TCA_FQ_FLOW_PLIMIT]		= { .type = NLA_U32 },
@@ -657,6 +818,8 @@ static const struct nla_policy fq_policy[TCA_FQ_MAX + 1] = {
 	[TCA_FQ_BUCKETS_LOG]		= { .type = NLA_U32 },
 	[TCA_FQ_FLOW_REFILL_DELAY]	= { .type = NLA_U32 },
 	[TCA_FQ_LOW_RATE_THRESHOLD]	= { .type = NLA_U32 },
+	[TCA_FQ_TIMER_SLACK]		= { .type = NLA_U32 },
+	[TCA_FQ_WHEEL_LOG]		= { .type = NLA_U32 },
 };
 
 static int fq_change(struct Qdisc *sch, struct nlattr *opt,
@@ -666,7 +829,7 @@ static int fq_change(struct Qdisc *sch, struct nlattr *opt,
 	struct nlattr *tb[TCA_FQ_MAX + 1];
 	int err, drop_count = 0;
 	unsigned drop_len = 0;
-	u32 fq_log;
+	u32 fq_log, wheel_log;
 
 	if (!opt)
 		return -EINVAL;
@@ -678,6 +841,7 @@ static int fq_change(struct Qdisc *sch, struct nlattr *opt,
 	sch_tree_lock(sch);
 
 	fq_log = q->fq_trees_log;
+	wheel_log = q->wheel ? q->wheel_log : 0;
 
 	if (tb[TCA_FQ_BUCKETS_LOG]) {
 		u32 nval = nla_get_u32(tb[TCA_FQ_BUCKETS_LOG]);
@@ -736,9 +900,23 @@ static int fq_change(struct Qdisc *sch, struct nlattr *opt,
 	if (tb[TCA_FQ_ORPHAN_MASK])
 		q->orphan_mask = nla_get_u32(tb[TCA_FQ_ORPHAN_MASK]);
 
+	if (tb[TCA_FQ_TIMER_SLACK])
+		q->timer_slack = nla_get_u32(tb[TCA_FQ_TIMER_SLACK]);
+
+	if (tb[TCA_FQ_WHEEL_LOG]) {
+		u32 nval = nla_get_u32(tb[TCA_FQ_WHEEL_LOG]);
+
+		if (nval <= FQ_WHEEL_MAX_LOG)
+			wheel_log = nval;
+		else
+			err = -EINVAL;
+	}
+
 	if (!err) {
 		sch_tree_unlock(sch);
 		err = fq_resize(sch, fq_log);
+		if (!err)
+			err = fq_wheel_resize(sch, wheel_log);
 		sch_tree_lock(sch);
 	}
 	while (sch->q.qlen > sch->limit) {
@@ -762,6 +940,7 @@ static void fq_destroy(struct Qdisc *sch)
 
 	fq_reset(sch);
 	fq_free(q->fq_root);
+	fq_free(q->wheel);
 	qdisc_watchdog_cancel(&q->watchdog);
 }
 
@@ -782,6 +961,8 @@ static int fq_init(struct Qdisc *sch, struct nlattr *opt,
 	q->new_flows.first	= NULL;
 	q->old_flows.first	= NULL;
 	q->delayed		= RB_ROOT;
+	q->wheel		= NULL;
+	q->timer_slack		= 10 * NSEC_PER_USEC;
 	q->fq_root		= NULL;
 	q->fq_trees_log		= ilog2(1024);
 	q->orphan_mask		= 1024 - 1;
@@ -819,7 +1000,9 @@ static int fq_dump(struct Qdisc *sch, struct sk_buff *skb)
 	    nla_put_u32(skb, TCA_FQ_ORPHAN_MASK, q->orphan_mask) ||
 	    nla_put_u32(skb, TCA_FQ_LOW_RATE_THRESHOLD,
 			q->low_rate_threshold) ||
-	    nla_put_u32(skb, TCA_FQ_BUCKETS_LOG, q->fq_trees_log))
+	    nla_put_u32(skb, TCA_FQ_BUCKETS_LOG, q->fq_trees_log) ||
+	    nla_put_u32(skb, TCA_FQ_TIMER_SLACK, q->timer_slack) ||
+	    nla_put_u32(skb, TCA_FQ_WHEEL_LOG, q->wheel ? q->wheel_log : 0))
 		goto nla_put_failure;
 
 	return nla_nest_end(skb, opts);
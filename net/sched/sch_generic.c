@@ -105,6 +105,8 @@ static inline void qdisc_enqueue_skb_bad_txq(struct Qdisc *q,
 	}
 
 	__skb_queue_tail(&q->skb_bad_txq, skb);
+	if (lock)
+		WRITE_ONCE(q->empty, false);
 
 	if (qdisc_is_percpu_stats(q)) {
 		qdisc_qstats_cpu_backlog_inc(q, skb);
@@ -118,6 +120,22 @@ static inline void qdisc_enqueue_skb_bad_txq(struct Qdisc *q,
 		spin_unlock(lock);
 }
 
+/* A stopped txq is woken up through __netif_schedule(), so MISSED does
+ * not have to keep rescheduling the qdisc meanwhile.
+ */
+static void qdisc_maybe_clear_missed(struct Qdisc *q,
+				     const struct netdev_queue *txq)
+{
+	clear_bit(__QDISC_STATE_MISSED, &q->state);
+
+	/* Order the clear_bit() before the txq state check below */
+	smp_mb__after_atomic();
+
+	/* The txq may have been woken, and MISSED set by that, in between */
+	if (!netif_xmit_frozen_or_stopped(txq))
+		set_bit(__QDISC_STATE_MISSED, &q->state);
+}
+
 static inline int __dev_requeue_skb(struct sk_buff *skb, struct Qdisc *q)
 {
 	while (skb) {
@@ -151,6 +169,7 @@ static inline int dev_requeue_skb_locked(struct sk_buff *skb, struct Qdisc *q)
 
 		skb = next;
 	}
+	WRITE_ONCE(q->empty, false);
 	spin_unlock(lock);
 
 	__netif_schedule(q);
@@ -259,6 +278,8 @@ static struct sk_buff *dequeue_skb(struct Qdisc *q, bool *validate,
 			}
 		} else {
 			skb = NULL;
+			if (lock)
+				qdisc_maybe_clear_missed(q, txq);
 		}
 		if (lock)
 			spin_unlock(lock);
@@ -268,8 +289,11 @@ static struct sk_buff *dequeue_skb(struct Qdisc *q, bool *validate,
 	*validate = true;
 
 	if ((q->flags & TCQ_F_ONETXQUEUE) &&
-	    netif_xmit_frozen_or_stopped(txq))
+	    netif_xmit_frozen_or_stopped(txq)) {
+		if (q->flags & TCQ_F_NOLOCK)
+			qdisc_maybe_clear_missed(q, txq);
 		return skb;
+	}
 
 	skb = qdisc_dequeue_skb_bad_txq(q);
 	if (unlikely(skb))
@@ -645,6 +669,7 @@ static int pfifo_fast_enqueue(struct sk_buff *skb, struct Qdisc *qdisc,
 	if (unlikely(err))
 		return qdisc_drop_cpu(skb, qdisc, to_free);
 
+	WRITE_ONCE(qdisc->empty, false);
 	qdisc_qstats_cpu_qlen_inc(qdisc);
 	/* Note: skb can not be used after skb_array_produce(),
 	 * so we better not use qdisc_qstats_cpu_backlog_inc()
@@ -657,8 +682,10 @@ static struct sk_buff *pfifo_fast_dequeue(struct Qdisc *qdisc)
 {
 	struct pfifo_fast_priv *priv = qdisc_priv(qdisc);
 	struct sk_buff *skb = NULL;
+	bool need_retry = true;
 	int band;
 
+retry:
 	for (band = 0; band < PFIFO_FAST_BANDS && !skb; band++) {
 		struct skb_array *q = band2list(priv, band);
 
@@ -671,6 +698,19 @@ static struct sk_buff *pfifo_fast_dequeue(struct Qdisc *qdisc)
 		qdisc_qstats_cpu_backlog_dec(qdisc, skb);
 		qdisc_bstats_cpu_update(qdisc, skb);
 		qdisc_qstats_cpu_qlen_dec(qdisc);
+	} else if (need_retry &&
+		   test_bit(__QDISC_STATE_MISSED, &qdisc->state)) {
+		/* Clearing MISSED this late saves the second trylock in
+		 * qdisc_run_begin() and the __netif_schedule() in
+		 * qdisc_run_end() while the queue is busy.  Dequeue once
+		 * more after clearing it, for skbs enqueued meanwhile.
+		 */
+		clear_bit(__QDISC_STATE_MISSED, &qdisc->state);
+		smp_mb__after_atomic();
+		need_retry = false;
+		goto retry;
+	} else {
+		WRITE_ONCE(qdisc->empty, true);
 	}
 
 	return skb;
@@ -876,6 +916,8 @@ struct Qdisc *qdisc_alloc(struct netdev_queue *dev_queue,
 	lockdep_set_class(&sch->running,
 			  dev->qdisc_running_key ?: &qdisc_running_key);
 
+	sch->empty = true;
+
 	sch->ops = ops;
 	sch->flags = ops->static_flags;
 	sch->enqueue = ops->enqueue;
@@ -940,6 +982,8 @@ void qdisc_reset(struct Qdisc *qdisc)
 
 	qdisc->q.qlen = 0;
 	qdisc->qstats.backlog = 0;
+	clear_bit(__QDISC_STATE_MISSED, &qdisc->state);
+	WRITE_ONCE(qdisc->empty, true);
 }
 EXPORT_SYMBOL(qdisc_reset);
 
@@ -1717,7 +1717,7 @@ static int tls_read_size(struct strparser *strp, struct sk_buff *skb)
 
 #ifdef CONFIG_TLS_DEVICE
 	handle_device_resync(strp->sk, TCP_SKB_CB(skb)->seq + rxm->offset,
-			     *(u64*)tls_ctx->rx.rec_seq);
+			     data_len + TLS_HEADER_SIZE);
 #endif
 	return data_len + TLS_HEADER_SIZE;
 
@@ -1858,14 +1858,13 @@ static void tx_work_handler(struct work_struct *work)
 int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 {
 	struct tls_crypto_info *crypto_info;
-	struct tls12_crypto_info_aes_gcm_128 *gcm_128_info;
 	struct tls_sw_context_tx *sw_ctx_tx = NULL;
 	struct tls_sw_context_rx *sw_ctx_rx = NULL;
 	struct cipher_context *cctx;
 	struct crypto_aead **aead;
 	struct strp_callbacks cb;
-	u16 nonce_size, tag_size, iv_size, rec_seq_size;
-	char *iv, *rec_seq;
+	u16 nonce_size, tag_size, iv_size, rec_seq_size, key_size, salt_size;
+	char *iv, *rec_seq, *key, *salt;
 	int rc = 0;
 
 	if (!ctx) {
@@ -1923,8 +1922,24 @@ int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 		rec_seq_size = TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE;
 		rec_seq =
 		 ((struct tls12_crypto_info_aes_gcm_128 *)crypto_info)->rec_seq;
-		gcm_128_info =
-			(struct tls12_crypto_info_aes_gcm_128 *)crypto_info;
+		key = ((struct tls12_crypto_info_aes_gcm_128 *)crypto_info)->key;
+		key_size = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+		salt = ((struct tls12_crypto_info_aes_gcm_128 *)crypto_info)->salt;
+		salt_size = TLS_CIPHER_AES_GCM_128_SALT_SIZE;
+		break;
+	}
+	case TLS_CIPHER_AES_GCM_256: {
+		nonce_size = TLS_CIPHER_AES_GCM_256_IV_SIZE;
+		tag_size = TLS_CIPHER_AES_GCM_256_TAG_SIZE;
+		iv_size = TLS_CIPHER_AES_GCM_256_IV_SIZE;
+		iv = ((struct tls12_crypto_info_aes_gcm_256 *)crypto_info)->iv;
+		rec_seq_size = TLS_CIPHER_AES_GCM_256_REC_SEQ_SIZE;
+		rec_seq =
+		 ((struct tls12_crypto_info_aes_gcm_256 *)crypto_info)->rec_seq;
+		key = ((struct tls12_crypto_info_aes_gcm_256 *)crypto_info)->key;
+		key_size = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+		salt = ((struct tls12_crypto_info_aes_gcm_256 *)crypto_info)->salt;
+		salt_size = TLS_CIPHER_AES_GCM_256_SALT_SIZE;
 		break;
 	}
 	default:
@@ -1942,14 +1957,13 @@ int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 	cctx->tag_size = tag_size;
 	cctx->overhead_size = cctx->prepend_size + cctx->tag_size;
 	cctx->iv_size = iv_size;
-	cctx->iv = kmalloc(iv_size + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
-			   GFP_KERNEL);
+	cctx->iv = kmalloc(iv_size + salt_size, GFP_KERNEL);
 	if (!cctx->iv) {
 		rc = -ENOMEM;
 		goto free_priv;
 	}
-	memcpy(cctx->iv, gcm_128_info->salt, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
-	memcpy(cctx->iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE, iv, iv_size);
+	memcpy(cctx->iv, salt, salt_size);
+	memcpy(cctx->iv + salt_size, iv, iv_size);
 	cctx->rec_seq_size = rec_seq_size;
 	cctx->rec_seq = kmemdup(rec_seq, rec_seq_size, GFP_KERNEL);
 	if (!cctx->rec_seq) {
@@ -1968,8 +1982,7 @@ int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx, int tx)
 
 	ctx->push_pending_record = tls_sw_push_pending_record;
 
-	rc = crypto_aead_setkey(*aead, gcm_128_info->key,
-				TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+	rc = crypto_aead_setkey(*aead, key, key_size);
 	if (rc)
 		goto free_aead;
 
@@ -105,9 +105,22 @@ int xdp_umem_assign_dev(struct xdp_umem *umem, struct net_device *dev,
 	bpf.xsk.umem = umem;
 	bpf.xsk.queue_id = queue_id;
 
+	umem->flags &= ~XDP_UMEM_ZC_SETS_NEED_WAKEUP;
 	err = dev->netdev_ops->ndo_bpf(dev, &bpf);
 	if (err)
 		goto err_unreg_umem;
+
+	/* A driver that never sets the need_wakeup flags would leave a
+	 * need_wakeup user waiting for them forever.
+	 */
+	if ((umem->flags & XDP_UMEM_USES_NEED_WAKEUP) &&
+	    !(umem->flags & XDP_UMEM_ZC_SETS_NEED_WAKEUP)) {
+		bpf.xsk.umem = NULL;
+		if (dev->netdev_ops->ndo_bpf(dev, &bpf))
+			WARN(1, "failed to disable umem!\n");
+		err = -EOPNOTSUPP;
+		goto err_unreg_umem;
+	}
 	rtnl_unlock();
 
 	dev_hold(dev);
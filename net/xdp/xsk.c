@@ -22,6 +22,7 @@
 #include <linux/net.h>
 #include <linux/netdevice.h>
 #include <linux/rculist.h>
+#include <net/busy_poll.h>
 #include <net/xdp_sock.h>
 #include <net/xdp.h>
 
@@ -29,6 +30,7 @@
 #include "xdp_umem.h"
 
 #define TX_BATCH_SIZE 16
+#define XSK_MAX_FRAGS (MAX_SKB_FRAGS + 1)
 
 static struct xdp_sock *xdp_sk(struct sock *sk)
 {
@@ -53,20 +55,138 @@ void xsk_umem_discard_addr(struct xdp_umem *umem)
 }
 EXPORT_SYMBOL(xsk_umem_discard_addr);
 
-static int __xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len)
+/*
+ * The need_wakeup helpers below are called by zero-copy drivers from
+ * NAPI context, on umems bound with XDP_USE_NEED_WAKEUP, to tell user
+ * space whether it has to kick the driver to get the rings serviced.
+ */
+void xsk_set_rx_need_wakeup(struct xdp_umem *umem)
 {
-	void *to_buf, *from_buf;
-	u32 metalen;
+	if (umem->need_wakeup & XDP_WAKEUP_RX)
+		return;
+
+	umem->fq->ring->flags |= XDP_RING_NEED_WAKEUP;
+	umem->need_wakeup |= XDP_WAKEUP_RX;
+}
+EXPORT_SYMBOL(xsk_set_rx_need_wakeup);
+
+void xsk_set_tx_need_wakeup(struct xdp_umem *umem)
+{
+	struct xdp_sock *xs;
+
+	if (umem->need_wakeup & XDP_WAKEUP_TX)
+		return;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(xs, &umem->xsk_list, list) {
+		if (xs->tx)
+			xs->tx->ring->flags |= XDP_RING_NEED_WAKEUP;
+	}
+	rcu_read_unlock();
+
+	umem->need_wakeup |= XDP_WAKEUP_TX;
+}
+EXPORT_SYMBOL(xsk_set_tx_need_wakeup);
+
+void xsk_clear_rx_need_wakeup(struct xdp_umem *umem)
+{
+	if (!(umem->need_wakeup & XDP_WAKEUP_RX))
+		return;
+
+	umem->fq->ring->flags &= ~XDP_RING_NEED_WAKEUP;
+	umem->need_wakeup &= ~XDP_WAKEUP_RX;
+}
+EXPORT_SYMBOL(xsk_clear_rx_need_wakeup);
+
+void xsk_clear_tx_need_wakeup(struct xdp_umem *umem)
+{
+	struct xdp_sock *xs;
+
+	if (!(umem->need_wakeup & XDP_WAKEUP_TX))
+		return;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(xs, &umem->xsk_list, list) {
+		if (xs->tx)
+			xs->tx->ring->flags &= ~XDP_RING_NEED_WAKEUP;
+	}
+	rcu_read_unlock();
+
+	umem->need_wakeup &= ~XDP_WAKEUP_TX;
+}
+EXPORT_SYMBOL(xsk_clear_tx_need_wakeup);
+
+/*
+ * Copies a frame of @len bytes, preceded by @metalen bytes of metadata,
+ * into the umem.  On XDP_SG sockets a frame that does not fit in a chunk
+ * is spread over as many chunks as needed, all but the last descriptor
+ * carrying XDP_PKT_CONTD.
+ */
+static int xsk_rcv_copy(struct xdp_sock *xs, void *from_buf, u32 len,
+			u32 metalen)
+{
+	u32 frame_size = xs->umem->chunk_size_nohr - XDP_PACKET_HEADROOM;
+	void *data = from_buf + metalen;
+	u64 addrs[XSK_MAX_FRAGS];
+	u32 i, nr_frags, copied;
+	void *to_buf;
 	u64 addr;
 	int err;
 
-	if (!xskq_peek_addr(xs->umem->fq, &addr) ||
-	    len > xs->umem->chunk_size_nohr - XDP_PACKET_HEADROOM) {
+	if (len <= frame_size) {
+		if (!xskq_peek_addr(xs->umem->fq, &addr)) {
+			xs->rx_dropped++;
+			return -ENOSPC;
+		}
+
+		addr += xs->umem->headroom;
+		to_buf = xdp_umem_get_data(xs->umem, addr);
+		memcpy(to_buf, from_buf, len + metalen);
+		addr += metalen;
+		err = xskq_produce_batch_desc(xs->rx, addr, len, 0);
+		if (!err) {
+			xskq_discard_addr(xs->umem->fq);
+			return 0;
+		}
+
+		xs->rx_dropped++;
+		return err;
+	}
+
+	nr_frags = DIV_ROUND_UP(len, frame_size);
+	if (!xs->sg || nr_frags > XSK_MAX_FRAGS ||
+	    !xskq_has_free_descs(xs->rx, nr_frags) ||
+	    !xskq_consume_addrs(xs->umem->fq, addrs, nr_frags)) {
 		xs->rx_dropped++;
 		return -ENOSPC;
 	}
 
-	addr += xs->umem->headroom;
+	for (i = 0, copied = 0; i < nr_frags; i++) {
+		u32 frag_len = min(len - copied, frame_size);
+
+		addr = addrs[i] + xs->umem->headroom;
+		to_buf = xdp_umem_get_data(xs->umem, addr);
+		if (!i) {
+			/* metadata only goes in front of the first chunk */
+			memcpy(to_buf, from_buf, metalen + frag_len);
+			addr += metalen;
+		} else {
+			memcpy(to_buf, data + copied, frag_len);
+		}
+		/* cannot fail, the rx ring was checked above */
+		xskq_produce_batch_desc(xs->rx, addr, frag_len,
+					i < nr_frags - 1 ? XDP_PKT_CONTD : 0);
+		copied += frag_len;
+	}
+
+	return 0;
+}
+
+static int __xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len)
+{
+	void *from_buf;
+	u32 metalen;
+	int err;
 
 	if (unlikely(xdp_data_meta_unsupported(xdp))) {
 		from_buf = xdp->data;
@@ -76,23 +196,16 @@ static int __xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len)
 		metalen = xdp->data - xdp->data_meta;
 	}
 
-	to_buf = xdp_umem_get_data(xs->umem, addr);
-	memcpy(to_buf, from_buf, len + metalen);
-	addr += metalen;
-	err = xskq_produce_batch_desc(xs->rx, addr, len);
-	if (!err) {
-		xskq_discard_addr(xs->umem->fq);
+	err = xsk_rcv_copy(xs, from_buf, len, metalen);
+	if (!err)
 		xdp_return_buff(xdp);
-		return 0;
-	}
 
-	xs->rx_dropped++;
 	return err;
 }
 
 static int __xsk_rcv_zc(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len)
 {
-	int err = xskq_produce_batch_desc(xs->rx, (u64)xdp->handle, len);
+	int err = xskq_produce_batch_desc(xs->rx, (u64)xdp->handle, len, 0);
 
 	if (err)
 		xs->rx_dropped++;
@@ -107,6 +220,7 @@ int xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 	if (xs->dev != xdp->rxq->dev || xs->queue_id != xdp->rxq->queue_index)
 		return -EINVAL;
 
+	sk_mark_napi_id_once_xdp(&xs->sk, xdp);
 	len = xdp->data_end - xdp->data;
 
 	return (xdp->rxq->mem.type == MEM_TYPE_ZERO_COPY) ?
@@ -123,32 +237,15 @@ int xsk_generic_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 {
 	u32 metalen = xdp->data - xdp->data_meta;
 	u32 len = xdp->data_end - xdp->data;
-	void *buffer;
-	u64 addr;
 	int err;
 
 	if (xs->dev != xdp->rxq->dev || xs->queue_id != xdp->rxq->queue_index)
 		return -EINVAL;
 
-	if (!xskq_peek_addr(xs->umem->fq, &addr) ||
-	    len > xs->umem->chunk_size_nohr - XDP_PACKET_HEADROOM) {
-		xs->rx_dropped++;
-		return -ENOSPC;
-	}
-
-	addr += xs->umem->headroom;
-
-	buffer = xdp_umem_get_data(xs->umem, addr);
-	memcpy(buffer, xdp->data_meta, len + metalen);
-	addr += metalen;
-	err = xskq_produce_batch_desc(xs->rx, addr, len);
-	if (!err) {
-		xskq_discard_addr(xs->umem->fq);
+	err = xsk_rcv_copy(xs, xdp->data_meta, len, metalen);
+	if (!err)
 		xsk_flush(xs);
-		return 0;
-	}
 
-	xs->rx_dropped++;
 	return err;
 }
 
@@ -218,35 +315,78 @@ static void xsk_destruct_skb(struct sk_buff *skb)
 	sock_wfree(skb);
 }
 
+/*
+ * Appends the data of a continuation descriptor to @skb as a page
+ * fragment.  The data is copied, so the chunk is completed right away.
+ */
+static int xsk_skb_add_frag(struct xdp_sock *xs, struct sk_buff *skb,
+			    struct xdp_desc *desc)
+{
+	unsigned long flags;
+	struct page *page;
+	int err = -ENOMEM;
+
+	page = alloc_page(xs->sk.sk_allocation);
+	if (page) {
+		memcpy(page_address(page),
+		       xdp_umem_get_data(xs->umem, desc->addr), desc->len);
+		skb_add_rx_frag(skb, skb_shinfo(skb)->nr_frags, page, 0,
+				desc->len, PAGE_SIZE);
+		refcount_add(PAGE_SIZE, &xs->sk.sk_wmem_alloc);
+		err = 0;
+	}
+
+	spin_lock_irqsave(&xs->tx_completion_lock, flags);
+	WARN_ON_ONCE(xskq_produce_addr(xs->umem->cq, desc->addr));
+	spin_unlock_irqrestore(&xs->tx_completion_lock, flags);
+
+	return err;
+}
+
 static int xsk_generic_xmit(struct sock *sk, struct msghdr *m,
 			    size_t total_len)
 {
+	struct xdp_desc descs[XSK_MAX_FRAGS];
 	u32 max_batch = TX_BATCH_SIZE;
 	struct xdp_sock *xs = xdp_sk(sk);
 	bool sent_frame = false;
-	struct xdp_desc desc;
 	struct sk_buff *skb;
 	int err = 0;
 
 	mutex_lock(&xs->mutex);
 
-	while (xskq_peek_desc(xs->tx, &desc)) {
+	for (;;) {
+		int i, nr_descs = 1;
 		char *buffer;
 		u64 addr;
 		u32 len;
 
+		if (xs->sg) {
+			nr_descs = xskq_peek_pkt(xs->tx, descs, XSK_MAX_FRAGS);
+			if (!nr_descs)
+				break;
+			if (nr_descs < 0) {
+				/* invalid or too many fragments, drop it */
+				while (nr_descs++)
+					xskq_discard_desc(xs->tx);
+				continue;
+			}
+		} else if (!xskq_peek_desc(xs->tx, &descs[0])) {
+			break;
+		}
+
 		if (max_batch-- == 0) {
 			err = -EAGAIN;
 			goto out;
 		}
 
-		if (xskq_reserve_addr(xs->umem->cq))
+		if (xskq_reserve_addrs(xs->umem->cq, nr_descs))
 			goto out;
 
 		if (xs->queue_id >= xs->dev->real_num_tx_queues)
 			goto out;
 
-		len = desc.len;
+		len = descs[0].len;
 		skb = sock_alloc_send_skb(sk, len, 1, &err);
 		if (unlikely(!skb)) {
 			err = -EAGAIN;
@@ -254,7 +394,7 @@ static int xsk_generic_xmit(struct sock *sk, struct msghdr *m,
 		}
 
 		skb_put(skb, len);
-		addr = desc.addr;
+		addr = descs[0].addr;
 		buffer = xdp_umem_get_data(xs->umem, addr);
 		err = skb_store_bits(skb, 0, buffer, len);
 		if (unlikely(err)) {
@@ -268,6 +408,21 @@ static int xsk_generic_xmit(struct sock *sk, struct msghdr *m,
 		skb_shinfo(skb)->destructor_arg = (void *)(long)addr;
 		skb->destructor = xsk_destruct_skb;
 
+		/* the packet is consumed from here on, even if it is dropped */
+		for (i = 1; i < nr_descs; i++) {
+			int ret = xsk_skb_add_frag(xs, skb, &descs[i]);
+
+			if (!err)
+				err = ret;
+		}
+		for (i = 1; i < nr_descs; i++)
+			xskq_discard_desc(xs->tx);
+		if (unlikely(err)) {
+			xskq_discard_desc(xs->tx);
+			kfree_skb(skb);
+			goto out;
+		}
+
 		err = dev_direct_xmit(skb, xs->queue_id);
 		xskq_discard_desc(xs->tx);
 		/* Ignore NET_XMIT_CN as packet might have been sent */
@@ -303,9 +458,40 @@ static int xsk_sendmsg(struct socket *sock, struct msghdr *m, size_t total_len)
 	if (need_wait)
 		return -EOPNOTSUPP;
 
+	if (sk_can_busy_loop(sk))
+		sk_busy_loop(sk, 1); /* only support non-blocking sockets */
+
 	return (xs->zc) ? xsk_zc_xmit(sk) : xsk_generic_xmit(sk, m, total_len);
 }
 
+/*
+ * Nothing is ever copied out: recvmsg() only exists so that a non-blocking
+ * call can busy poll the NAPI context feeding the socket, or wake it up.
+ */
+static int xsk_recvmsg(struct socket *sock, struct msghdr *m, size_t len,
+		       int flags)
+{
+	bool need_wait = !(flags & MSG_DONTWAIT);
+	struct sock *sk = sock->sk;
+	struct xdp_sock *xs = xdp_sk(sk);
+
+	if (unlikely(!xs->dev))
+		return -ENXIO;
+	if (unlikely(!(xs->dev->flags & IFF_UP)))
+		return -ENETDOWN;
+	if (unlikely(!xs->rx))
+		return -ENOBUFS;
+	if (need_wait)
+		return -EOPNOTSUPP;
+
+	if (sk_can_busy_loop(sk))
+		sk_busy_loop(sk, 1); /* only support non-blocking sockets */
+
+	if (xs->zc && xsk_umem_uses_need_wakeup(xs->umem))
+		return xsk_zc_xmit(sk);
+	return 0;
+}
+
 static unsigned int xsk_poll(struct file *file, struct socket *sock,
 			     struct poll_table_struct *wait)
 {
@@ -313,6 +499,15 @@ static unsigned int xsk_poll(struct file *file, struct socket *sock,
 	struct sock *sk = sock->sk;
 	struct xdp_sock *xs = xdp_sk(sk);
 
+	/* With need_wakeup, poll() is what user space kicks the driver with */
+	if (xs->dev && xsk_umem_uses_need_wakeup(xs->umem)) {
+		if (xs->zc)
+			xsk_zc_xmit(sk);
+		else if (xs->tx)
+			/* Poll needs to drive Tx also in copy mode */
+			xsk_generic_xmit(sk, NULL, 0);
+	}
+
 	if (xs->rx && !xskq_empty_desc(xs->rx))
 		mask |= POLLIN | POLLRDNORM;
 	if (xs->tx && !xskq_full_desc(xs->tx))
@@ -427,6 +622,12 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 	qid = sxdp->sxdp_queue_id;
 	flags = sxdp->sxdp_flags;
 
+	if ((flags & XDP_SG) && (flags & XDP_ZEROCOPY)) {
+		/* Zero-copy drivers only handle single chunk frames. */
+		err = -EINVAL;
+		goto out_unlock;
+	}
+
 	if (flags & XDP_SHARED_UMEM) {
 		struct xdp_sock *umem_xs;
 		struct socket *sock;
@@ -455,7 +656,8 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 			err = -EBADF;
 			sockfd_put(sock);
 			goto out_unlock;
-		} else if (umem_xs->dev != dev || umem_xs->queue_id != qid) {
+		} else if (umem_xs->dev != dev || umem_xs->queue_id != qid ||
+			   ((flags & XDP_SG) && umem_xs->umem->zc)) {
 			err = -EINVAL;
 			sockfd_put(sock);
 			goto out_unlock;
@@ -474,6 +676,10 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 		xskq_set_umem(xs->umem->cq, xs->umem->size,
 			      xs->umem->chunk_mask);
 
+		if (flags & XDP_SG)
+			flags |= XDP_COPY;
+		if (flags & XDP_USE_NEED_WAKEUP)
+			xs->umem->flags |= XDP_UMEM_USES_NEED_WAKEUP;
 		err = xdp_umem_assign_dev(xs->umem, dev, qid, flags);
 		if (err)
 			goto out_unlock;
@@ -481,6 +687,11 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 
 	xs->dev = dev;
 	xs->zc = xs->umem->zc;
+	xs->sg = flags & XDP_SG;
+	if (xs->tx && xsk_umem_uses_need_wakeup(xs->umem) &&
+	    (!xs->zc || (xs->umem->need_wakeup & XDP_WAKEUP_TX)))
+		/* Tx in copy mode is only ever driven by sendmsg() and poll() */
+		xs->tx->ring->flags |= XDP_RING_NEED_WAKEUP;
 	xs->queue_id = qid;
 	xskq_set_umem(xs->rx, xs->umem->size, xs->umem->chunk_mask);
 	xskq_set_umem(xs->tx, xs->umem->size, xs->umem->chunk_mask);
@@ -576,6 +787,37 @@ static int xsk_setsockopt(struct socket *sock, int level, int optname,
 	return -ENOPROTOOPT;
 }
 
+/* Layout of XDP_MMAP_OFFSETS before the ring flags were added */
+struct xdp_ring_offset_v1 {
+	__u64 producer;
+	__u64 consumer;
+	__u64 desc;
+};
+
+struct xdp_mmap_offsets_v1 {
+	struct xdp_ring_offset_v1 rx;
+	struct xdp_ring_offset_v1 tx;
+	struct xdp_ring_offset_v1 fr;
+	struct xdp_ring_offset_v1 cr;
+};
+
+static void xsk_ring_offset_v1(struct xdp_ring_offset_v1 *v1,
+			       struct xdp_ring_offset *off)
+{
+	v1->producer = off->producer;
+	v1->consumer = off->consumer;
+	v1->desc = off->desc;
+}
+
+static void xsk_mmap_offsets_v1(struct xdp_mmap_offsets_v1 *v1,
+				struct xdp_mmap_offsets *off)
+{
+	xsk_ring_offset_v1(&v1->rx, &off->rx);
+	xsk_ring_offset_v1(&v1->tx, &off->tx);
+	xsk_ring_offset_v1(&v1->fr, &off->fr);
+	xsk_ring_offset_v1(&v1->cr, &off->cr);
+}
+
 static int xsk_getsockopt(struct socket *sock, int level, int optname,
 			  char __user *optval, int __user *optlen)
 {
@@ -615,26 +857,41 @@ static int xsk_getsockopt(struct socket *sock, int level, int optname,
 	case XDP_MMAP_OFFSETS:
 	{
 		struct xdp_mmap_offsets off;
+		struct xdp_mmap_offsets_v1 off_v1;
+		void *to_copy;
 
-		if (len < sizeof(off))
+		if (len < sizeof(off_v1))
 			return -EINVAL;
 
 		off.rx.producer = offsetof(struct xdp_rxtx_ring, ptrs.producer);
 		off.rx.consumer = offsetof(struct xdp_rxtx_ring, ptrs.consumer);
 		off.rx.desc	= offsetof(struct xdp_rxtx_ring, desc);
+		off.rx.flags	= offsetof(struct xdp_rxtx_ring, ptrs.flags);
 		off.tx.producer = offsetof(struct xdp_rxtx_ring, ptrs.producer);
 		off.tx.consumer = offsetof(struct xdp_rxtx_ring, ptrs.consumer);
 		off.tx.desc	= offsetof(struct xdp_rxtx_ring, desc);
+		off.tx.flags	= offsetof(struct xdp_rxtx_ring, ptrs.flags);
 
 		off.fr.producer = offsetof(struct xdp_umem_ring, ptrs.producer);
 		off.fr.consumer = offsetof(struct xdp_umem_ring, ptrs.consumer);
 		off.fr.desc	= offsetof(struct xdp_umem_ring, desc);
+		off.fr.flags	= offsetof(struct xdp_umem_ring, ptrs.flags);
 		off.cr.producer = offsetof(struct xdp_umem_ring, ptrs.producer);
 		off.cr.consumer = offsetof(struct xdp_umem_ring, ptrs.consumer);
 		off.cr.desc	= offsetof(struct xdp_umem_ring, desc);
+		off.cr.flags	= offsetof(struct xdp_umem_ring, ptrs.flags);
+
+		if (len < sizeof(off)) {
+			/* Old user space without the flags offsets */
+			xsk_mmap_offsets_v1(&off_v1, &off);
+			to_copy = &off_v1;
+			len = sizeof(off_v1);
+		} else {
+			to_copy = &off;
+			len = sizeof(off);
+		}
 
-		len = sizeof(off);
-		if (copy_to_user(optval, &off, len))
+		if (copy_to_user(optval, to_copy, len))
 			return -EFAULT;
 		if (put_user(len, optlen))
 			return -EFAULT;
@@ -708,7 +965,7 @@ static const struct proto_ops xsk_proto_ops = {
 	.setsockopt	= xsk_setsockopt,
 	.getsockopt	= xsk_getsockopt,
 	.sendmsg	= xsk_sendmsg,
-	.recvmsg	= sock_no_recvmsg,
+	.recvmsg	= xsk_recvmsg,
 	.mmap		= xsk_mmap,
 	.sendpage	= sock_no_sendpage,
 };
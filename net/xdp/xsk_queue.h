@@ -16,6 +16,7 @@
 struct xdp_ring {
 	u32 producer ____cacheline_aligned_in_smp;
 	u32 consumer ____cacheline_aligned_in_smp;
+	u32 flags;
 };
 
 /* Used for the RX and TX queues for packets */
@@ -121,6 +122,36 @@ static inline void xskq_discard_addr(struct xsk_queue *q)
 	q->cons_tail++;
 }
 
+/* Consumes @cnt valid addresses at once, or none of them. */
+static inline bool xskq_consume_addrs(struct xsk_queue *q, u64 *addrs,
+				      u32 cnt)
+{
+	u32 cons_tail = q->cons_tail;
+	u32 i;
+
+	if (q->cons_head - q->cons_tail < cnt) {
+		WRITE_ONCE(q->ring->consumer, q->cons_tail);
+		q->prod_tail = READ_ONCE(q->ring->producer);
+		q->cons_head = q->cons_tail + min_t(u32,
+				q->prod_tail - q->cons_tail,
+				max_t(u32, cnt, RX_BATCH_SIZE));
+
+		/* Order consumer and data */
+		smp_rmb();
+	}
+
+	for (i = 0; i < cnt; i++) {
+		/* The consumer has not been published since cons_tail */
+		if (!xskq_validate_addr(q, &addrs[i])) {
+			q->cons_tail = cons_tail;
+			return false;
+		}
+		q->cons_tail++;
+	}
+
+	return true;
+}
+
 static inline int xskq_produce_addr(struct xsk_queue *q, u64 addr)
 {
 	struct xdp_umem_ring *ring = (struct xdp_umem_ring *)q->ring;
@@ -167,6 +198,15 @@ static inline int xskq_reserve_addr(struct xsk_queue *q)
 	return 0;
 }
 
+static inline int xskq_reserve_addrs(struct xsk_queue *q, u32 cnt)
+{
+	if (xskq_nb_free(q, q->prod_head, cnt) < cnt)
+		return -ENOSPC;
+
+	q->prod_head += cnt;
+	return 0;
+}
+
 /* Rx/Tx queue */
 
 static inline bool xskq_is_valid_desc(struct xsk_queue *q, struct xdp_desc *d)
@@ -219,8 +259,65 @@ static inline void xskq_discard_desc(struct xsk_queue *q)
 	q->cons_tail++;
 }
 
+/* Is the entry @i places after cons_tail available to the consumer? */
+static inline bool xskq_has_desc(struct xsk_queue *q, u32 i)
+{
+	if (i < q->cons_head - q->cons_tail)
+		return true;
+
+	WRITE_ONCE(q->ring->consumer, q->cons_tail);
+	q->prod_tail = READ_ONCE(q->ring->producer);
+	q->cons_head = q->cons_tail + min_t(u32, q->prod_tail - q->cons_tail,
+					    max_t(u32, i + 1, RX_BATCH_SIZE));
+
+	/* Order consumer and data */
+	smp_rmb();
+
+	return i < q->cons_head - q->cons_tail;
+}
+
+/*
+ * Looks at the packet at the head of the queue, which is made of all the
+ * descriptors up to the first one without XDP_PKT_CONTD, and copies up to
+ * @max of them to @descs.  Nothing is consumed.  Returns the number of
+ * descriptors in the packet; negated if the packet is invalid or has more
+ * than @max descriptors, and has to be dropped.  Returns 0 if the queue
+ * does not hold a complete packet.
+ */
+static inline int xskq_peek_pkt(struct xsk_queue *q, struct xdp_desc *descs,
+				u32 max)
+{
+	struct xdp_rxtx_ring *ring = (struct xdp_rxtx_ring *)q->ring;
+	bool valid = true;
+	struct xdp_desc desc;
+	u32 i;
+
+	for (i = 0; i < q->nentries; i++) {
+		if (!xskq_has_desc(q, i))
+			return 0;
+
+		desc = READ_ONCE(ring->desc[(q->cons_tail + i) & q->ring_mask]);
+		if (i >= max || !xskq_is_valid_desc(q, &desc))
+			valid = false;
+		else
+			descs[i] = desc;
+
+		if (!(desc.options & XDP_PKT_CONTD))
+			return valid ? i + 1 : -(i + 1);
+	}
+
+	/* XDP_PKT_CONTD on the whole ring, drop it all */
+	q->invalid_descs++;
+	return -i;
+}
+
+static inline bool xskq_has_free_descs(struct xsk_queue *q, u32 cnt)
+{
+	return xskq_nb_free(q, q->prod_head, cnt) >= cnt;
+}
+
 static inline int xskq_produce_batch_desc(struct xsk_queue *q,
-					  u64 addr, u32 len)
+					  u64 addr, u32 len, u32 options)
 {
 	struct xdp_rxtx_ring *ring = (struct xdp_rxtx_ring *)q->ring;
 	unsigned int idx;
@@ -231,6 +328,7 @@ static inline int xskq_produce_batch_desc(struct xsk_queue *q,
 	idx = (q->prod_head++) & q->ring_mask;
 	ring->desc[idx].addr = addr;
 	ring->desc[idx].len = len;
+	ring->desc[idx].options = options;
 
 	return 0;
 }
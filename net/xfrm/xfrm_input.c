@@ -15,6 +15,7 @@
 #include <linux/module.h>
 #include <linux/netdevice.h>
 #include <linux/percpu.h>
+#include <linux/udp.h>
 #include <net/dst.h>
 #include <net/ip.h>
 #include <net/xfrm.h>
@@ -258,8 +259,10 @@ int xfrm_input(struct sk_buff *skb, int nexthdr, __be32 spi, int encap_type)
 			goto resume;
 		}
 
-		/* encap_type < -1 indicates a GRO call. */
-		encap_type = 0;
+		/* encap_type < -1 indicates a GRO call, -3 one of a
+		 * UDP_ENCAP_ESPINUDP packet.
+		 */
+		encap_type = encap_type == -3 ? UDP_ENCAP_ESPINUDP : 0;
 		seq = XFRM_SPI_SKB_CB(skb)->seq;
 
 		if (xo && (xo->flags & CRYPTO_DONE)) {
@@ -75,6 +75,7 @@ static const char * const prog_type_name[] = {
 	[BPF_PROG_TYPE_CGROUP_SOCK_ADDR] = "cgroup_sock_addr",
 	[BPF_PROG_TYPE_LIRC_MODE2]	= "lirc_mode2",
 	[BPF_PROG_TYPE_FLOW_DISSECTOR]	= "flow_dissector",
+	[BPF_PROG_TYPE_SK_LOOKUP]	= "sk_lookup",
 };
 
 static const char * const attach_type_strings[] = {
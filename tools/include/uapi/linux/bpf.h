@@ -104,6 +104,10 @@ enum bpf_cmd {
 	BPF_BTF_GET_FD_BY_ID,
 	BPF_TASK_FD_QUERY,
 	BPF_MAP_LOOKUP_AND_DELETE_ELEM,
+	BPF_MAP_LOOKUP_BATCH,
+	BPF_MAP_LOOKUP_AND_DELETE_BATCH,
+	BPF_MAP_UPDATE_BATCH,
+	BPF_MAP_DELETE_BATCH,
 };
 
 enum bpf_map_type {
@@ -131,6 +135,8 @@ enum bpf_map_type {
 	BPF_MAP_TYPE_PERCPU_CGROUP_STORAGE,
 	BPF_MAP_TYPE_QUEUE,
 	BPF_MAP_TYPE_STACK,
+	BPF_MAP_TYPE_RINGBUF,
+	BPF_MAP_TYPE_STRUCT_OPS,
 };
 
 enum bpf_prog_type {
@@ -157,6 +163,9 @@ enum bpf_prog_type {
 	BPF_PROG_TYPE_LIRC_MODE2,
 	BPF_PROG_TYPE_SK_REUSEPORT,
 	BPF_PROG_TYPE_FLOW_DISSECTOR,
+	BPF_PROG_TYPE_SK_LOOKUP,
+	BPF_PROG_TYPE_TRACING,
+	BPF_PROG_TYPE_STRUCT_OPS,
 };
 
 enum bpf_attach_type {
@@ -178,6 +187,10 @@ enum bpf_attach_type {
 	BPF_CGROUP_UDP6_SENDMSG,
 	BPF_LIRC_MODE2,
 	BPF_FLOW_DISSECTOR,
+	BPF_SK_LOOKUP,
+	BPF_RPS_CPU,
+	BPF_TRACE_FENTRY,
+	BPF_TRACE_FEXIT,
 	__MAX_BPF_ATTACH_TYPE
 };
 
@@ -269,6 +282,11 @@ enum bpf_attach_type {
 /* Flag for stack_map, store build_id+offset instead of pointer */
 #define BPF_F_STACK_BUILD_ID	(1U << 5)
 
+/* Flag for array maps: the values can be mmap()'ed by user space and
+ * accessed with no syscall
+ */
+#define BPF_F_MMAPABLE		(1U << 10)
+
 enum bpf_stack_build_id_status {
 	/* user space need an empty entry to identify end of a trace */
 	BPF_STACK_BUILD_ID_EMPTY = 0,
@@ -318,6 +336,23 @@ union bpf_attr {
 		__u64		flags;
 	};
 
+	struct { /* struct used by BPF_MAP_*_BATCH commands */
+		__aligned_u64	in_batch;	/* start batch,
+						 * NULL to start from beginning
+						 */
+		__aligned_u64	out_batch;	/* output: next start batch */
+		__aligned_u64	keys;
+		__aligned_u64	values;
+		__u32		count;		/* input/output:
+						 * input: # of key/value
+						 * elements
+						 * output: # of filled elements
+						 */
+		__u32		map_fd;
+		__u64		elem_flags;
+		__u64		flags;
+	} batch;
+
 	struct { /* anonymous struct used by BPF_PROG_LOAD command */
 		__u32		prog_type;	/* one of enum bpf_prog_type */
 		__u32		insn_cnt;
@@ -335,6 +370,11 @@ union bpf_attr {
 		 * (context accesses, allowed helpers, etc).
 		 */
 		__u32		expected_attach_type;
+		/* Kernel function a BPF_PROG_TYPE_TRACING program attaches
+		 * to, and the number of its arguments (at most 6).
+		 */
+		__aligned_u64	attach_func_name;
+		__u32		attach_func_nr_args;
 	};
 
 	struct { /* anonymous struct used by BPF_OBJ_* commands */
@@ -2265,6 +2305,86 @@ union bpf_attr {
  *
  *	Return
  *		0 on success, or a negative error in case of failure.
+ *
+ * int bpf_sk_lookup_assign(struct bpf_sk_lookup *ctx, struct bpf_map *map, void *key, u64 flags)
+ *	Description
+ *		Select the listening socket stored at index *key* of *map*,
+ *		a **BPF_MAP_TYPE_REUSEPORT_SOCKARRAY**, as the result of the
+ *		socket lookup a **BPF_PROG_TYPE_SK_LOOKUP** program runs for.
+ *		The selection only takes effect if the program returns
+ *		**SK_PASS**. When the selected socket belongs to a reuseport
+ *		group, the group still picks the final socket.
+ *
+ *		All values for *flags* are reserved for future usage, and must
+ *		be left at zero.
+ *	Return
+ *		0 on success, or a negative error in case of failure:
+ *
+ *		**-ENOENT** if there is no socket at *key*.
+ *
+ *		**-EPROTOTYPE** if the socket protocol does not match.
+ *
+ *		**-EAFNOSUPPORT** if the socket can not serve the address
+ *		family of the lookup.
+ *
+ *		**-ESOCKTNOSUPPORT** if the socket is not listening.
+ *
+ *		**-EINVAL** if *flags* is not zero, or if the socket belongs
+ *		to another network namespace.
+ *
+ * int bpf_ringbuf_output(void *ringbuf, void *data, u64 size, u64 flags)
+ *	Description
+ *		Copy *size* bytes from *data* into the ring buffer *ringbuf*,
+ *		a map of type **BPF_MAP_TYPE_RINGBUF**.
+ *
+ *		If **BPF_RB_NO_WAKEUP** is specified in *flags*, no
+ *		notification of new data availability is sent. If
+ *		**BPF_RB_FORCE_WAKEUP** is specified, it is sent
+ *		unconditionally. Otherwise it is sent only when the consumer
+ *		has caught up with the new record.
+ *	Return
+ *		0 on success, or a negative error in case of failure.
+ *
+ * void *bpf_ringbuf_reserve(void *ringbuf, u64 size, u64 flags)
+ *	Description
+ *		Reserve *size* bytes of payload in the ring buffer *ringbuf*.
+ *		*size* must be a known constant. The record has to be passed
+ *		to **bpf_ringbuf_submit**\ () or **bpf_ringbuf_discard**\ ()
+ *		before the program exits. *flags* must be 0.
+ *	Return
+ *		Valid pointer with *size* bytes of memory available; NULL,
+ *		otherwise.
+ *
+ * void bpf_ringbuf_submit(void *data, u64 flags)
+ *	Description
+ *		Submit the record *data* reserved earlier with
+ *		**bpf_ringbuf_reserve**\ (), making it visible to the consumer.
+ *		See **bpf_ringbuf_output**\ () for the definition of *flags*.
+ *	Return
+ *		Nothing. Always succeeds.
+ *
+ * void bpf_ringbuf_discard(void *data, u64 flags)
+ *	Description
+ *		Discard the record *data* reserved earlier with
+ *		**bpf_ringbuf_reserve**\ (); the consumer skips it. See
+ *		**bpf_ringbuf_output**\ () for the definition of *flags*.
+ *	Return
+ *		Nothing. Always succeeds.
+ *
+ * u64 bpf_ringbuf_query(void *ringbuf, u64 flags)
+ *	Description
+ *		Query various characteristics of the ring buffer *ringbuf*,
+ *		as selected by *flags*:
+ *
+ *		* **BPF_RB_AVAIL_DATA**: amount of data not yet consumed.
+ *		* **BPF_RB_RING_SIZE**: the size of the ring buffer.
+ *		* **BPF_RB_CONS_POS**: consumer position.
+ *		* **BPF_RB_PROD_POS**: producer position.
+ *
+ *		The values are snapshots, and may be stale by the time the
+ *		program looks at them.
+ *	Return
+ *		Requested value, or 0 if *flags* is not recognized.
  */
 #define __BPF_FUNC_MAPPER(FN)		\
 	FN(unspec),			\
@@ -2357,7 +2477,13 @@ union bpf_attr {
 	FN(map_push_elem),		\
 	FN(map_pop_elem),		\
 	FN(map_peek_elem),		\
-	FN(msg_push_data),
+	FN(msg_push_data),		\
+	FN(sk_lookup_assign),		\
+	FN(ringbuf_output),		\
+	FN(ringbuf_reserve),		\
+	FN(ringbuf_submit),		\
+	FN(ringbuf_discard),		\
+	FN(ringbuf_query),
 
 /* integer value in 'imm' field of BPF_CALL instruction selects which helper
  * function eBPF program intends to call
@@ -2416,6 +2542,28 @@ enum bpf_func_id {
 /* Current network namespace */
 #define BPF_F_CURRENT_NETNS		(-1L)
 
+/* BPF_FUNC_ringbuf_output, BPF_FUNC_ringbuf_submit and
+ * BPF_FUNC_ringbuf_discard flags.
+ */
+#define BPF_RB_NO_WAKEUP		(1ULL << 0)
+#define BPF_RB_FORCE_WAKEUP		(1ULL << 1)
+
+/* BPF_FUNC_ringbuf_query flags */
+enum {
+	BPF_RB_AVAIL_DATA = 0,
+	BPF_RB_RING_SIZE = 1,
+	BPF_RB_CONS_POS = 2,
+	BPF_RB_PROD_POS = 3,
+};
+
+/* BPF_MAP_TYPE_RINGBUF record header, in front of each record's data.
+ * The length word has the busy bit set while the record is reserved but
+ * not yet submitted, and the discard bit set if it was discarded.
+ */
+#define BPF_RINGBUF_BUSY_BIT		(1U << 31)
+#define BPF_RINGBUF_DISCARD_BIT		(1U << 30)
+#define BPF_RINGBUF_HDR_SZ		8
+
 /* Mode for BPF_FUNC_skb_adjust_room helper. */
 enum bpf_adj_room_mode {
 	BPF_ADJ_ROOM_NET,
@@ -2626,6 +2774,20 @@ struct sk_reuseport_md {
 	__u32 hash;		/* A hash of the packet 4 tuples */
 };
 
+/* User accessible data for BPF_PROG_TYPE_SK_LOOKUP programs, run when a
+ * connection request looks for a listening socket.
+ */
+struct bpf_sk_lookup {
+	__u32 family;		/* AF_INET or AF_INET6 */
+	__u32 protocol;		/* IPPROTO_TCP */
+	__u32 remote_ip4;	/* Stored in network byte order */
+	__u32 remote_ip6[4];	/* Stored in network byte order */
+	__u32 remote_port;	/* Stored in network byte order */
+	__u32 local_ip4;	/* Stored in network byte order */
+	__u32 local_ip6[4];	/* Stored in network byte order */
+	__u32 local_port;	/* Stored in host byte order */
+};
+
 #define BPF_TAG_SIZE	8
 
 struct bpf_prog_info {
@@ -2960,4 +3122,50 @@ struct bpf_flow_keys {
 	};
 };
 
+/* Value of the only element (key 0) of a BPF_MAP_TYPE_STRUCT_OPS map: a
+ * TCP congestion control made of BPF_PROG_TYPE_STRUCT_OPS programs.
+ * Updating the element registers it under @name, deleting it unregisters
+ * it for good.
+ */
+struct bpf_tcp_congestion_ops {
+	char	name[16];	/* as in struct tcp_congestion_ops */
+	__u32	flags;		/* TCP_CONG_NEEDS_ECN (0x2) only */
+	/* Program fds implementing each op, 0 for an op left unset.
+	 * The programs are loaded with attach_func_name naming the op.
+	 */
+	__u32	init;
+	__u32	release;
+	__u32	ssthresh;	/* required */
+	__u32	cong_avoid;	/* required */
+	__u32	set_state;
+	__u32	cwnd_event;
+	__u32	in_ack_event;
+	__u32	undo_cwnd;	/* required */
+	__u32	pkts_acked;
+	__u32	min_tso_segs;
+	__u32	sndbuf_expand;
+};
+
+/* User accessible data for BPF_PROG_TYPE_STRUCT_OPS programs implementing
+ * a tcp_congestion_ops op. The ops' own arguments after the socket are in
+ * arg1 and arg2, and in the sample_ fields for pkts_acked. The socket
+ * fields marked (rw) may be written.
+ */
+struct bpf_tcp_ca_ctx {
+	__u32 arg1;
+	__u32 arg2;
+	__u32 sample_pkts_acked;
+	__s32 sample_rtt_us;
+	__u32 sample_in_flight;
+	__u32 snd_cwnd;		/* (rw) */
+	__u32 snd_ssthresh;	/* (rw) */
+	__u32 snd_cwnd_cnt;	/* (rw) */
+	__u32 snd_cwnd_clamp;
+	__u32 srtt_us;
+	__u32 mss_cache;
+	__u32 packets_out;
+	__u32 prior_cwnd;
+	__u32 ca_priv[16];	/* (rw) the congestion control's own state */
+};
+
 #endif /* _UAPI__LINUX_BPF_H__ */
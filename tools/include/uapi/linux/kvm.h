@@ -235,6 +235,7 @@ struct kvm_hyperv_exit {
 #define KVM_EXIT_S390_STSI        25
 #define KVM_EXIT_IOAPIC_EOI       26
 #define KVM_EXIT_HYPERV           27
+#define KVM_EXIT_DIRTY_RING_FULL  28
 
 /* For KVM_EXIT_INTERNAL_ERROR */
 /* Emulate instruction failed. */
@@ -445,6 +446,27 @@ struct kvm_coalesced_mmio_ring {
 	((PAGE_SIZE - sizeof(struct kvm_coalesced_mmio_ring)) / \
 	 sizeof(struct kvm_coalesced_mmio))
 
+/*
+ * for KVM_CAP_DIRTY_LOG_RING: the entries of the per-vcpu dirty ring,
+ * mapped at KVM_DIRTY_LOG_PAGE_OFFSET of the vcpu fd.  KVM sets
+ * KVM_DIRTY_GFN_F_DIRTY when it publishes an entry; userspace sets
+ * KVM_DIRTY_GFN_F_RESET once it has collected it, and KVM_RESET_DIRTY_RINGS
+ * reenables dirty tracking for the collected pages.
+ */
+#ifndef KVM_DIRTY_LOG_PAGE_OFFSET
+#define KVM_DIRTY_LOG_PAGE_OFFSET 0
+#endif
+
+#define KVM_DIRTY_GFN_F_DIRTY		(1 << 0)
+#define KVM_DIRTY_GFN_F_RESET		(1 << 1)
+#define KVM_DIRTY_GFN_F_MASK		0x3
+
+struct kvm_dirty_gfn {
+	__u32 flags;
+	__u32 slot;	/* as_id << 16 | slot id, as in KVM_GET_DIRTY_LOG */
+	__u64 offset;	/* pages from the start of the slot */
+};
+
 /* for KVM_TRANSLATE */
 struct kvm_translation {
 	/* in */
@@ -975,6 +997,8 @@ struct kvm_ppc_resize_hpt {
 #define KVM_CAP_HYPERV_ENLIGHTENED_VMCS 163
 #define KVM_CAP_EXCEPTION_PAYLOAD 164
 #define KVM_CAP_ARM_VM_IPA_SIZE 165
+#define KVM_CAP_DIRTY_LOG_RING 166
+#define KVM_CAP_HALT_POLL 167
 
 #ifdef KVM_CAP_IRQ_ROUTING
 
@@ -1421,6 +1445,9 @@ struct kvm_enc_region {
 #define KVM_GET_NESTED_STATE         _IOWR(KVMIO, 0xbe, struct kvm_nested_state)
 #define KVM_SET_NESTED_STATE         _IOW(KVMIO,  0xbf, struct kvm_nested_state)
 
+/* Available with KVM_CAP_DIRTY_LOG_RING */
+#define KVM_RESET_DIRTY_RINGS        _IO(KVMIO, 0xc0)
+
 /* Secure Encrypted Virtualization command */
 enum sev_cmd_id {
 	/* Guest initialization commands */
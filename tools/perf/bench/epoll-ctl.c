@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * epoll-ctl: have a bunch of threads add, modify and remove their eventfds
+ * in an epoll instance, as fast as they can.
+ *
+ * This program is particularly useful to measure the cost of interest list
+ * updates in fs/eventpoll.c: with a single epoll instance shared by all the
+ * workers (the default) they contend on its mutex and rbtree, with --multiq
+ * each worker gets an instance of its own.
+ */
+
+/* For the CLR_() macros */
+#include <string.h>
+#include <pthread.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "../util/stat.h"
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "cpumap.h"
+#include "threads.h"
+
+#include <err.h>
+
+enum {
+	OP_EPOLL_ADD,
+	OP_EPOLL_MOD,
+	OP_EPOLL_DEL,
+	EPOLL_NR_OPS,
+};
+
+static const char * const op_names[EPOLL_NR_OPS] = {
+	[OP_EPOLL_ADD] = "ADD",
+	[OP_EPOLL_MOD] = "MOD",
+	[OP_EPOLL_DEL] = "DEL",
+};
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 8;
+/* amount of eventfds per thread */
+static unsigned int nfds     = 64;
+static bool done = false, silent = false, multiq = false;
+static int epollfd = -1;
+
+static struct timeval start, end, runtime;
+static struct bench_threads threads;
+static struct stats all_stats[EPOLL_NR_OPS];
+
+struct worker {
+	int tid;
+	int epollfd;
+	int *fds;
+	bool *added;
+	pthread_t thread;
+	unsigned long ops[EPOLL_NR_OPS];
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('f', "nfds",    &nfds,     "Specify amount of file descriptors per thread"),
+	OPT_BOOLEAN( 'm', "multiq",  &multiq,   "Use an epoll instance per thread"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_ctl_usage[] = {
+	"perf bench epoll ctl <options>",
+	NULL
+};
+
+/*
+ * A descriptor that is not in the interest list gets added, one that is
+ * gets modified or deleted with equal odds.
+ */
+static void do_epoll_op(struct worker *w, unsigned int i, unsigned int *seed)
+{
+	struct epoll_event ev;
+	int fd = w->fds[i];
+	int op;
+
+	if (!w->added[i])
+		op = OP_EPOLL_ADD;
+	else
+		op = rand_r(seed) & 1 ? OP_EPOLL_MOD : OP_EPOLL_DEL;
+
+	ev.events = EPOLLIN | (op == OP_EPOLL_MOD && rand_r(seed) & 1 ? EPOLLET : 0);
+	ev.data.fd = fd;
+
+	switch (op) {
+	case OP_EPOLL_ADD:
+		if (epoll_ctl(w->epollfd, EPOLL_CTL_ADD, fd, &ev))
+			err(EXIT_FAILURE, "epoll_ctl(ADD)");
+		w->added[i] = true;
+		break;
+	case OP_EPOLL_MOD:
+		if (epoll_ctl(w->epollfd, EPOLL_CTL_MOD, fd, &ev))
+			err(EXIT_FAILURE, "epoll_ctl(MOD)");
+		break;
+	case OP_EPOLL_DEL:
+		if (epoll_ctl(w->epollfd, EPOLL_CTL_DEL, fd, NULL))
+			err(EXIT_FAILURE, "epoll_ctl(DEL)");
+		w->added[i] = false;
+		break;
+	}
+
+	w->ops[op]++;
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	unsigned int seed = w->tid;
+	unsigned int i;
+
+	bench_threads__wait_start(&threads);
+
+	do {
+		for (i = 0; i < nfds; i++)
+			do_epoll_op(w, i, &seed);
+	}  while (!done);
+
+	return NULL;
+}
+
+static void setup_worker(struct worker *w)
+{
+	unsigned int i;
+
+	if (multiq) {
+		w->epollfd = epoll_create1(0);
+		if (w->epollfd < 0)
+			err(EXIT_FAILURE, "epoll_create1");
+	} else
+		w->epollfd = epollfd;
+
+	w->fds = calloc(nfds, sizeof(*w->fds));
+	w->added = calloc(nfds, sizeof(*w->added));
+	if (!w->fds || !w->added)
+		err(EXIT_FAILURE, "calloc");
+
+	for (i = 0; i < nfds; i++) {
+		w->fds[i] = eventfd(0, EFD_NONBLOCK);
+		if (w->fds[i] < 0)
+			err(EXIT_FAILURE, "eventfd");
+	}
+}
+
+static void cleanup_worker(struct worker *w)
+{
+	unsigned int i;
+
+	for (i = 0; i < nfds; i++)
+		close(w->fds[i]);
+	free(w->fds);
+	free(w->added);
+	if (multiq)
+		close(w->epollfd);
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	int op;
+
+	printf("\n");
+	for (op = 0; op < EPOLL_NR_OPS; op++) {
+		unsigned long avg = avg_stats(&all_stats[op]);
+		double stddev = stddev_stats(&all_stats[op]);
+
+		printf("Averaged %ld %s operations/sec (+- %.2f%%), total secs = %d\n",
+		       avg, op_names[op], rel_stddev_stats(stddev, avg),
+		       (int) runtime.tv_sec);
+	}
+}
+
+int bench_epoll_ctl(int argc, const char **argv)
+{
+	int ret = 0;
+	struct sigaction act;
+	unsigned int i;
+	int op;
+	struct worker *worker = NULL;
+	struct cpu_map *cpu;
+
+	argc = parse_options(argc, argv, options, bench_epoll_ctl_usage, 0);
+	if (argc) {
+		usage_with_options(bench_epoll_ctl_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	cpu = cpu_map__new(NULL);
+	if (!cpu)
+		goto errmem;
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs */
+		nthreads = cpu->nr;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		goto errmem;
+
+	if (!multiq) {
+		epollfd = epoll_create1(0);
+		if (epollfd < 0)
+			err(EXIT_FAILURE, "epoll_create1");
+	}
+
+	printf("Run summary [PID %d]: %d threads, each updating %d eventfds "
+	       "in %s epoll instance for %d secs.\n\n",
+	       getpid(), nthreads, nfds, multiq ? "its own" : "a shared", nsecs);
+
+	for (op = 0; op < EPOLL_NR_OPS; op++)
+		init_stats(&all_stats[op]);
+
+	bench_threads__init(&threads, nthreads);
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+		setup_worker(&worker[i]);
+		bench_threads__create(&worker[i].thread, cpu, i, workerfn, &worker[i]);
+	}
+
+	bench_threads__start(&threads, &start);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	bench_threads__exit(&threads);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long secs = runtime.tv_sec ?: 1;
+
+		for (op = 0; op < EPOLL_NR_OPS; op++)
+			update_stats(&all_stats[op], worker[i].ops[op] / secs);
+
+		if (!silent)
+			printf("[thread %2d] fdmap: %p [ add: %ld, mod: %ld, del: %ld ops/sec ]\n",
+			       worker[i].tid, worker[i].fds,
+			       worker[i].ops[OP_EPOLL_ADD] / secs,
+			       worker[i].ops[OP_EPOLL_MOD] / secs,
+			       worker[i].ops[OP_EPOLL_DEL] / secs);
+
+		cleanup_worker(&worker[i]);
+	}
+
+	print_summary();
+
+	if (!multiq)
+		close(epollfd);
+	free(worker);
+	free(cpu);
+	return ret;
+errmem:
+	err(EXIT_FAILURE, "calloc");
+}
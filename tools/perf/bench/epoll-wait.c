@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * epoll-wait: keep a bunch of threads busy in epoll_wait(2) while a writer
+ * thread makes their eventfds ready, one at a time.
+ *
+ * This program is particularly useful to measure the wakeup and ready
+ * list handling of fs/eventpoll.c: with a single epoll instance shared by
+ * all the workers (the default) they contend on it, with --multiq each
+ * worker gets an instance of its own.
+ */
+
+/* For the CLR_() macros */
+#include <string.h>
+#include <pthread.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "../util/stat.h"
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "cpumap.h"
+#include "threads.h"
+
+#include <err.h>
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 8;
+/* amount of eventfds per thread */
+static unsigned int nfds     = 64;
+static bool done = false, silent = false, multiq = false, et = false;
+static int epollfd = -1;
+
+static struct timeval start, end, runtime;
+static struct bench_threads threads;
+static struct stats throughput_stats;
+
+struct worker {
+	int tid;
+	int epollfd;
+	int *fds;
+	pthread_t thread;
+	unsigned long ops;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('f', "nfds",    &nfds,     "Specify amount of file descriptors per thread"),
+	OPT_BOOLEAN( 'm', "multiq",  &multiq,   "Use an epoll instance per thread"),
+	OPT_BOOLEAN( 'E', "edge",    &et,       "Use edge-triggered events"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_wait_usage[] = {
+	"perf bench epoll wait <options>",
+	NULL
+};
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	unsigned long ops = w->ops; /* avoid cacheline bouncing */
+	struct epoll_event ev;
+	uint64_t val;
+	int ret;
+
+	bench_threads__wait_start(&threads);
+
+	do {
+		/* time out now and then to notice the end of the run */
+		ret = epoll_wait(w->epollfd, &ev, 1, 100);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, "epoll_wait");
+		}
+		if (!ret)
+			continue;
+
+		/* consume the event, the writer makes it ready again */
+		if (read(ev.data.fd, &val, sizeof(val)) == sizeof(val))
+			ops++;
+		else if (errno != EAGAIN)
+			err(EXIT_FAILURE, "read");
+	}  while (!done);
+
+	w->ops = ops;
+	return NULL;
+}
+
+/* round robin over all the eventfds, making each of them ready */
+static void *writerfn(void *arg)
+{
+	struct worker *worker = (struct worker *) arg;
+	uint64_t val = 1;
+	unsigned int i, j;
+
+	do {
+		for (i = 0; i < nthreads && !done; i++) {
+			for (j = 0; j < nfds && !done; j++) {
+				if (write(worker[i].fds[j], &val, sizeof(val)) != sizeof(val))
+					err(EXIT_FAILURE, "write");
+			}
+		}
+	} while (!done);
+
+	return NULL;
+}
+
+static void setup_worker(struct worker *w)
+{
+	struct epoll_event ev;
+	unsigned int i;
+
+	if (multiq) {
+		w->epollfd = epoll_create1(0);
+		if (w->epollfd < 0)
+			err(EXIT_FAILURE, "epoll_create1");
+	} else
+		w->epollfd = epollfd;
+
+	w->fds = calloc(nfds, sizeof(*w->fds));
+	if (!w->fds)
+		err(EXIT_FAILURE, "calloc");
+
+	for (i = 0; i < nfds; i++) {
+		w->fds[i] = eventfd(0, EFD_NONBLOCK);
+		if (w->fds[i] < 0)
+			err(EXIT_FAILURE, "eventfd");
+
+		ev.events = EPOLLIN | (et ? EPOLLET : 0);
+		ev.data.fd = w->fds[i];
+		if (epoll_ctl(w->epollfd, EPOLL_CTL_ADD, w->fds[i], &ev))
+			err(EXIT_FAILURE, "epoll_ctl");
+	}
+}
+
+static void cleanup_worker(struct worker *w)
+{
+	unsigned int i;
+
+	for (i = 0; i < nfds; i++)
+		close(w->fds[i]);
+	free(w->fds);
+	if (multiq)
+		close(w->epollfd);
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+
+	printf("%sAveraged %ld operations/sec (+- %.2f%%), total secs = %d\n",
+	       !silent ? "\n" : "", avg, rel_stddev_stats(stddev, avg),
+	       (int) runtime.tv_sec);
+}
+
+int bench_epoll_wait(int argc, const char **argv)
+{
+	int ret = 0;
+	struct sigaction act;
+	unsigned int i;
+	pthread_t writer;
+	struct worker *worker = NULL;
+	struct cpu_map *cpu;
+
+	argc = parse_options(argc, argv, options, bench_epoll_wait_usage, 0);
+	if (argc) {
+		usage_with_options(bench_epoll_wait_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	cpu = cpu_map__new(NULL);
+	if (!cpu)
+		goto errmem;
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	/* default to the number of CPUs, one is left for the writer */
+	if (!nthreads)
+		nthreads = cpu->nr > 1 ? cpu->nr - 1 : 1;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		goto errmem;
+
+	if (!multiq) {
+		epollfd = epoll_create1(0);
+		if (epollfd < 0)
+			err(EXIT_FAILURE, "epoll_create1");
+	}
+
+	printf("Run summary [PID %d]: %d threads, each waiting on %d %s-triggered eventfds "
+	       "in %s epoll instance for %d secs.\n\n",
+	       getpid(), nthreads, nfds, et ? "edge" : "level",
+	       multiq ? "its own" : "a shared", nsecs);
+
+	init_stats(&throughput_stats);
+
+	bench_threads__init(&threads, nthreads);
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+		setup_worker(&worker[i]);
+		bench_threads__create(&worker[i].thread, cpu, i, workerfn, &worker[i]);
+	}
+
+	bench_threads__start(&threads, &start);
+
+	ret = pthread_create(&writer, NULL, writerfn, worker);
+	if (ret)
+		err(EXIT_FAILURE, "pthread_create");
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	ret = pthread_join(writer, NULL);
+	if (ret)
+		err(EXIT_FAILURE, "pthread_join");
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	bench_threads__exit(&threads);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t = worker[i].ops / (runtime.tv_sec ?: 1);
+
+		update_stats(&throughput_stats, t);
+		if (!silent)
+			printf("[thread %2d] fdmap: %p [ %ld ops/sec ]\n",
+			       worker[i].tid, worker[i].fds, t);
+
+		cleanup_worker(&worker[i]);
+	}
+
+	print_summary();
+
+	if (!multiq)
+		close(epollfd);
+	free(worker);
+	free(cpu);
+	return ret;
+errmem:
+	err(EXIT_FAILURE, "calloc");
+}
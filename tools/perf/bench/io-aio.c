@@ -0,0 +1,335 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * io-aio: a bunch of threads keeping native AIO reads in flight against a
+ * block device, null_blk by default, for a fixed time.
+ *
+ * This program is particularly useful to measure the submission and
+ * completion paths of fs/aio.c and of the block layer: with null_blk
+ * there is no device time to hide their cost.  The AIO syscalls are
+ * called directly, like the futex benchmarks do, so no libaio is needed.
+ */
+
+/* For the CLR_() macros */
+#include <string.h>
+#include <pthread.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/aio_abi.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+
+#include "../util/stat.h"
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "cpumap.h"
+#include "threads.h"
+
+#include <err.h>
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 8;
+static unsigned int depth    = 32;
+static unsigned int batch    = 8;
+static unsigned int bs       = 4096;
+static const char *device    = "/dev/nullb0";
+static bool done = false, silent = false;
+static off_t nblocks;
+
+static struct timeval start, end, runtime;
+static struct bench_threads threads;
+static struct stats throughput_stats;
+
+struct worker {
+	int tid;
+	int fd;
+	aio_context_t ctx;
+	struct iocb *iocbs;
+	struct iocb **iocbp;
+	struct io_event *events;
+	void *buf;
+	unsigned int seed;
+	pthread_t thread;
+	unsigned long ios;
+	unsigned long submits;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('q', "depth",   &depth,    "Specify amount of I/Os in flight per thread"),
+	OPT_UINTEGER('b', "batch",   &batch,    "Specify amount of I/Os per io_submit(2)"),
+	OPT_UINTEGER('B', "bs",      &bs,       "Specify block size (in bytes)"),
+	OPT_STRING(  'd', "device",  &device,   "path", "Specify the block device to read from"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_io_aio_usage[] = {
+	"perf bench io aio <options>",
+	NULL
+};
+
+/* native AIO syscall wrappers */
+static inline int sys_io_setup(unsigned int nr, aio_context_t *ctx)
+{
+	return syscall(SYS_io_setup, nr, ctx);
+}
+
+static inline int sys_io_destroy(aio_context_t ctx)
+{
+	return syscall(SYS_io_destroy, ctx);
+}
+
+static inline int sys_io_submit(aio_context_t ctx, long nr, struct iocb **iocbp)
+{
+	return syscall(SYS_io_submit, ctx, nr, iocbp);
+}
+
+static inline int sys_io_getevents(aio_context_t ctx, long min_nr, long nr,
+				   struct io_event *events,
+				   struct timespec *timeout)
+{
+	return syscall(SYS_io_getevents, ctx, min_nr, nr, events, timeout);
+}
+
+static void prep_read(struct worker *w, struct iocb *iocb)
+{
+	off_t block = (off_t)rand_r(&w->seed) % nblocks;
+
+	memset(iocb, 0, sizeof(*iocb));
+	iocb->aio_fildes = w->fd;
+	iocb->aio_lio_opcode = IOCB_CMD_PREAD;
+	iocb->aio_buf = (unsigned long)w->buf;
+	iocb->aio_nbytes = bs;
+	iocb->aio_offset = block * bs;
+	iocb->aio_data = (unsigned long)iocb;
+}
+
+/* submits the first @nr of w->iocbp, returns how many made it */
+static int submit(struct worker *w, long nr)
+{
+	int ret;
+
+	do {
+		ret = sys_io_submit(w->ctx, nr, w->iocbp);
+	} while (ret < 0 && (errno == EAGAIN || errno == EINTR) && !done);
+
+	if (ret < 0 && !done)
+		err(EXIT_FAILURE, "io_submit");
+	w->submits++;
+	return ret < 0 ? 0 : ret;
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	/* time out now and then to notice the end of the run */
+	struct timespec timeout = { .tv_nsec = 100000000 };
+	unsigned long ios = 0;
+	unsigned int i, inflight = 0, pending = 0;
+	int ret;
+
+	bench_threads__wait_start(&threads);
+
+	/* fill the queue */
+	for (i = 0; i < depth; i++) {
+		prep_read(w, &w->iocbs[i]);
+		w->iocbp[pending++] = &w->iocbs[i];
+		if (pending == batch || i == depth - 1) {
+			inflight += submit(w, pending);
+			pending = 0;
+		}
+	}
+
+	do {
+		ret = sys_io_getevents(w->ctx, min(batch, inflight), depth,
+				       w->events, &timeout);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, "io_getevents");
+		}
+		inflight -= ret;
+
+		/* resubmit the completed iocbs */
+		for (i = 0; i < (unsigned int)ret; i++) {
+			struct iocb *iocb = (struct iocb *)(unsigned long)
+					    w->events[i].data;
+
+			if (w->events[i].res != bs)
+				errx(EXIT_FAILURE, "read: %lld",
+				     (long long)w->events[i].res);
+			ios++;
+			prep_read(w, iocb);
+			w->iocbp[pending++] = iocb;
+			if (pending == batch || i == (unsigned int)ret - 1) {
+				inflight += submit(w, pending);
+				pending = 0;
+			}
+		}
+	} while (!done);
+
+	/* reap what is still in flight before tearing the context down */
+	while (inflight) {
+		ret = sys_io_getevents(w->ctx, inflight, depth, w->events, NULL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, "io_getevents");
+		}
+		inflight -= ret;
+	}
+
+	w->ios = ios;
+	return NULL;
+}
+
+static void setup_worker(struct worker *w)
+{
+	w->fd = open(device, O_RDONLY | O_DIRECT);
+	if (w->fd < 0)
+		err(EXIT_FAILURE, "open: %s", device);
+
+	if (sys_io_setup(depth, &w->ctx))
+		err(EXIT_FAILURE, "io_setup");
+
+	w->iocbs = calloc(depth, sizeof(*w->iocbs));
+	w->iocbp = calloc(depth, sizeof(*w->iocbp));
+	w->events = calloc(depth, sizeof(*w->events));
+	if (!w->iocbs || !w->iocbp || !w->events)
+		err(EXIT_FAILURE, "calloc");
+
+	/* the data is thrown away, all reads can share a buffer */
+	if (posix_memalign(&w->buf, sysconf(_SC_PAGESIZE), bs))
+		err(EXIT_FAILURE, "posix_memalign");
+}
+
+static void cleanup_worker(struct worker *w)
+{
+	sys_io_destroy(w->ctx);
+	close(w->fd);
+	free(w->buf);
+	free(w->events);
+	free(w->iocbp);
+	free(w->iocbs);
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+
+	printf("%sAveraged %ld IOPS (+- %.2f%%), total secs = %d\n",
+	       !silent ? "\n" : "", avg, rel_stddev_stats(stddev, avg),
+	       (int) runtime.tv_sec);
+}
+
+int bench_io_aio(int argc, const char **argv)
+{
+	int ret = 0, fd;
+	struct sigaction act;
+	unsigned int i;
+	struct worker *worker = NULL;
+	struct cpu_map *cpu;
+
+	argc = parse_options(argc, argv, options, bench_io_aio_usage, 0);
+	if (argc) {
+		usage_with_options(bench_io_aio_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!depth)
+		depth = 1;
+	if (!batch || batch > depth)
+		batch = depth;
+	if (!bs || bs % 512)
+		errx(EXIT_FAILURE, "block size must be a multiple of 512");
+
+	fd = open(device, O_RDONLY);
+	if (fd < 0)
+		err(EXIT_FAILURE, "open: %s", device);
+	nblocks = lseek(fd, 0, SEEK_END) / bs;
+	close(fd);
+	if (nblocks <= 0)
+		errx(EXIT_FAILURE, "%s: smaller than a block", device);
+
+	cpu = cpu_map__new(NULL);
+	if (!cpu)
+		goto errmem;
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	/* default to a thread per CPU */
+	if (!nthreads)
+		nthreads = cpu->nr;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		goto errmem;
+
+	printf("Run summary [PID %d]: %d threads doing %d byte reads from %s, "
+	       "%d in flight, %d per submit, for %d secs.\n\n",
+	       getpid(), nthreads, bs, device, depth, batch, nsecs);
+
+	init_stats(&throughput_stats);
+
+	bench_threads__init(&threads, nthreads);
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+		worker[i].seed = i;
+		setup_worker(&worker[i]);
+		bench_threads__create(&worker[i].thread, cpu, i, workerfn, &worker[i]);
+	}
+
+	bench_threads__start(&threads, &start);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	bench_threads__exit(&threads);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t = worker[i].ios / (runtime.tv_sec ?: 1);
+
+		update_stats(&throughput_stats, t);
+		if (!silent)
+			printf("[thread %2d] [ %ld IOPS, %.1f I/Os per submit ]\n",
+			       worker[i].tid, t, (double)worker[i].ios /
+			       (worker[i].submits ?: 1));
+
+		cleanup_worker(&worker[i]);
+	}
+
+	print_summary();
+
+	free(worker);
+	free(cpu);
+	return ret;
+errmem:
+	err(EXIT_FAILURE, "calloc");
+}
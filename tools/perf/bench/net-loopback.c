@@ -0,0 +1,290 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * net-loopback: pairs of threads streaming messages to each other over a
+ * local socket, as fast as they can.
+ *
+ * This program is particularly useful to measure the per packet cost of
+ * the socket layer and of the loopback TCP, UDP or AF_UNIX paths, without
+ * any device in the way.
+ */
+
+/* For the CLR_() macros */
+#include <string.h>
+#include <pthread.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../util/stat.h"
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "cpumap.h"
+#include "threads.h"
+
+#include <err.h>
+
+static unsigned int npairs   = 0;
+static unsigned int nsecs    = 8;
+static unsigned int msgsize  = 64;
+static const char *proto_str = "udp";
+static bool done = false, silent = false;
+
+enum {
+	PROTO_UDP,
+	PROTO_TCP,
+	PROTO_UNIX,
+};
+static int proto;
+
+static struct timeval start, end, runtime;
+static struct bench_threads threads;
+static struct stats throughput_stats;
+
+struct pair {
+	int id;
+	int fds[2];
+	pthread_t sender, receiver;
+	unsigned long msgs;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "pairs",   &npairs,    "Specify amount of sender/receiver pairs"),
+	OPT_UINTEGER('r', "runtime", &nsecs,     "Specify runtime (in seconds)"),
+	OPT_UINTEGER('S', "size",    &msgsize,   "Specify message size (in bytes)"),
+	OPT_STRING(  'p', "proto",   &proto_str, "udp|tcp|unix", "Specify the socket type"),
+	OPT_BOOLEAN( 's', "silent",  &silent,    "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_net_loopback_usage[] = {
+	"perf bench net loopback <options>",
+	NULL
+};
+
+static void *senderfn(void *arg)
+{
+	struct pair *p = (struct pair *) arg;
+	char *buf = calloc(1, msgsize);
+
+	if (!buf)
+		err(EXIT_FAILURE, "calloc");
+
+	bench_threads__wait_start(&threads);
+
+	do {
+		if (send(p->fds[0], buf, msgsize, 0) < 0 &&
+		    errno != EAGAIN && errno != ENOBUFS && errno != EINTR)
+			err(EXIT_FAILURE, "send");
+	} while (!done);
+
+	free(buf);
+	return NULL;
+}
+
+static void *receiverfn(void *arg)
+{
+	struct pair *p = (struct pair *) arg;
+	unsigned long bytes = 0, msgs = 0;
+	char *buf = calloc(1, msgsize);
+	ssize_t ret;
+
+	if (!buf)
+		err(EXIT_FAILURE, "calloc");
+
+	bench_threads__wait_start(&threads);
+
+	do {
+		ret = recv(p->fds[1], buf, msgsize, 0);
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, "recv");
+		}
+		/* stream sockets may split and coalesce the messages */
+		if (proto == PROTO_UDP)
+			msgs++;
+		else
+			bytes += ret;
+	} while (!done);
+
+	p->msgs = proto == PROTO_UDP ? msgs : bytes / msgsize;
+	free(buf);
+	return NULL;
+}
+
+static void connect_inet(struct pair *p)
+{
+	int type = proto == PROTO_TCP ? SOCK_STREAM : SOCK_DGRAM;
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	int one = 1, fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	fd = socket(AF_INET, type, 0);
+	if (fd < 0)
+		err(EXIT_FAILURE, "socket");
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    getsockname(fd, (struct sockaddr *)&addr, &len))
+		err(EXIT_FAILURE, "bind");
+	if (proto == PROTO_TCP && listen(fd, 1))
+		err(EXIT_FAILURE, "listen");
+
+	p->fds[0] = socket(AF_INET, type, 0);
+	if (p->fds[0] < 0)
+		err(EXIT_FAILURE, "socket");
+	if (connect(p->fds[0], (struct sockaddr *)&addr, sizeof(addr)))
+		err(EXIT_FAILURE, "connect");
+
+	if (proto == PROTO_TCP) {
+		p->fds[1] = accept(fd, NULL, NULL);
+		if (p->fds[1] < 0)
+			err(EXIT_FAILURE, "accept");
+		close(fd);
+		setsockopt(p->fds[0], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	} else
+		p->fds[1] = fd;
+}
+
+static void setup_pair(struct pair *p)
+{
+	/* let the receiver notice the end of the run */
+	struct timeval tv = { .tv_usec = 100000 };
+
+	if (proto == PROTO_UNIX) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, p->fds))
+			err(EXIT_FAILURE, "socketpair");
+	} else
+		connect_inet(p);
+
+	if (setsockopt(p->fds[1], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) ||
+	    setsockopt(p->fds[0], SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)))
+		err(EXIT_FAILURE, "setsockopt");
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+
+	printf("%sAveraged %ld messages/sec (+- %.2f%%), total secs = %d\n",
+	       !silent ? "\n" : "", avg, rel_stddev_stats(stddev, avg),
+	       (int) runtime.tv_sec);
+}
+
+int bench_net_loopback(int argc, const char **argv)
+{
+	int ret = 0;
+	struct sigaction act;
+	unsigned int i;
+	struct pair *pair = NULL;
+	struct cpu_map *cpu;
+
+	argc = parse_options(argc, argv, options, bench_net_loopback_usage, 0);
+	if (argc) {
+		usage_with_options(bench_net_loopback_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!strcmp(proto_str, "udp"))
+		proto = PROTO_UDP;
+	else if (!strcmp(proto_str, "tcp"))
+		proto = PROTO_TCP;
+	else if (!strcmp(proto_str, "unix"))
+		proto = PROTO_UNIX;
+	else {
+		usage_with_options(bench_net_loopback_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!msgsize)
+		msgsize = 1;
+
+	cpu = cpu_map__new(NULL);
+	if (!cpu)
+		goto errmem;
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	/* default to a thread per CPU */
+	if (!npairs)
+		npairs = cpu->nr > 1 ? cpu->nr / 2 : 1;
+
+	pair = calloc(npairs, sizeof(*pair));
+	if (!pair)
+		goto errmem;
+
+	printf("Run summary [PID %d]: %d pairs streaming %d byte messages over %s for %d secs.\n\n",
+	       getpid(), npairs, msgsize, proto_str, nsecs);
+
+	init_stats(&throughput_stats);
+
+	bench_threads__init(&threads, npairs * 2);
+	for (i = 0; i < npairs; i++) {
+		pair[i].id = i;
+		setup_pair(&pair[i]);
+
+		bench_threads__create(&pair[i].sender, cpu, 2 * i,
+				      senderfn, &pair[i]);
+		bench_threads__create(&pair[i].receiver, cpu, 2 * i + 1,
+				      receiverfn, &pair[i]);
+	}
+
+	bench_threads__start(&threads, &start);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < npairs; i++) {
+		ret = pthread_join(pair[i].sender, NULL);
+		if (!ret)
+			ret = pthread_join(pair[i].receiver, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	bench_threads__exit(&threads);
+
+	for (i = 0; i < npairs; i++) {
+		unsigned long t = pair[i].msgs / (runtime.tv_sec ?: 1);
+
+		update_stats(&throughput_stats, t);
+		if (!silent)
+			printf("[pair %2d] [ %ld messages/sec ]\n", pair[i].id, t);
+
+		close(pair[i].fds[0]);
+		close(pair[i].fds[1]);
+	}
+
+	print_summary();
+
+	free(pair);
+	free(cpu);
+	return ret;
+errmem:
+	err(EXIT_FAILURE, "calloc");
+}
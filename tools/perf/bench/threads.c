@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Thread setup shared by the epoll, io and net benchmarks.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "cpumap.h"
+#include "threads.h"
+
+#include <err.h>
+
+void bench_threads__init(struct bench_threads *bt, unsigned int nr)
+{
+	pthread_mutex_init(&bt->lock, NULL);
+	pthread_cond_init(&bt->parent, NULL);
+	pthread_cond_init(&bt->worker, NULL);
+	bt->starting = nr;
+	bt->started = false;
+}
+
+void bench_threads__exit(struct bench_threads *bt)
+{
+	pthread_cond_destroy(&bt->parent);
+	pthread_cond_destroy(&bt->worker);
+	pthread_mutex_destroy(&bt->lock);
+}
+
+void bench_threads__wait_start(struct bench_threads *bt)
+{
+	pthread_mutex_lock(&bt->lock);
+	bt->starting--;
+	if (!bt->starting)
+		pthread_cond_signal(&bt->parent);
+	while (!bt->started)
+		pthread_cond_wait(&bt->worker, &bt->lock);
+	pthread_mutex_unlock(&bt->lock);
+}
+
+void bench_threads__start(struct bench_threads *bt, struct timeval *start)
+{
+	pthread_mutex_lock(&bt->lock);
+	while (bt->starting)
+		pthread_cond_wait(&bt->parent, &bt->lock);
+	gettimeofday(start, NULL);
+	bt->started = true;
+	pthread_cond_broadcast(&bt->worker);
+	pthread_mutex_unlock(&bt->lock);
+}
+
+void bench_threads__create(pthread_t *thread, struct cpu_map *cpu,
+			   unsigned int n, void *(*fn)(void *), void *arg)
+{
+	pthread_attr_t thread_attr;
+	cpu_set_t cpuset;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu->map[n % cpu->nr], &cpuset);
+
+	pthread_attr_init(&thread_attr);
+	if (pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpuset))
+		err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+	if (pthread_create(thread, &thread_attr, fn, arg))
+		err(EXIT_FAILURE, "pthread_create");
+	pthread_attr_destroy(&thread_attr);
+}
@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _BENCH_THREADS_H
+#define _BENCH_THREADS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <sys/time.h>
+
+struct cpu_map;
+
+/*
+ * Start barrier for the benchmarks that run a set of threads for a fixed
+ * time: each thread calls bench_threads__wait_start() once it is ready,
+ * and bench_threads__start() returns in the parent once all of them got
+ * there, having stamped @start and released them.
+ */
+struct bench_threads {
+	pthread_mutex_t	lock;
+	pthread_cond_t	parent;
+	pthread_cond_t	worker;
+	unsigned int	starting;
+	bool		started;
+};
+
+void bench_threads__init(struct bench_threads *bt, unsigned int nr);
+void bench_threads__exit(struct bench_threads *bt);
+void bench_threads__wait_start(struct bench_threads *bt);
+void bench_threads__start(struct bench_threads *bt, struct timeval *start);
+
+/* create a thread pinned to the @n'th cpu of @cpu, wrapping around */
+void bench_threads__create(pthread_t *thread, struct cpu_map *cpu,
+			   unsigned int n, void *(*fn)(void *), void *arg);
+
+#endif /* _BENCH_THREADS_H */
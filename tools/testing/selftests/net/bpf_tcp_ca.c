@@ -0,0 +1,407 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Test TCP congestion controls implemented by BPF_PROG_TYPE_STRUCT_OPS
+ * programs. A minimal Reno-like congestion control is registered through
+ * a BPF_MAP_TYPE_STRUCT_OPS map and used for a loopback transfer. The
+ * test checks that its ops run, that the u8 argument of set_state reaches
+ * the program without garbage above it, that more sockets than a BPF map
+ * reference count allows can use it, and that it keeps working for its
+ * sockets after being unregistered.
+ *
+ * Runs in a network namespace of its own, so the default congestion
+ * control of the host is left alone.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <linux/bpf.h>
+#include <linux/unistd.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#endif
+
+#ifndef TCP_CA_NAME_MAX
+#define TCP_CA_NAME_MAX 16
+#endif
+
+#define CA_NAME		"bpf_test_ca"
+/* more than BPF_MAX_REFCNT */
+#define NR_SOCKS	33000
+#define XFER_LEN	(16 << 20)
+
+/* counters shared with the programs */
+enum {
+	CNT_CONG_AVOID,
+	CNT_SET_STATE_BITS,
+	CNT_MAX,
+};
+
+#define CTX_OFF(field)	offsetof(struct bpf_tcp_ca_ctx, field)
+
+#define INSN(code, dst, src, off, imm)					\
+	((struct bpf_insn) { code, dst, src, off, imm })
+#define MOV64_REG(dst, src)	INSN(BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0)
+#define MOV64_IMM(dst, imm)	INSN(BPF_ALU64 | BPF_MOV | BPF_K, dst, 0, 0, imm)
+#define ADD64_IMM(dst, imm)	INSN(BPF_ALU64 | BPF_ADD | BPF_K, dst, 0, 0, imm)
+#define RSH64_IMM(dst, imm)	INSN(BPF_ALU64 | BPF_RSH | BPF_K, dst, 0, 0, imm)
+#define OR64_REG(dst, src)	INSN(BPF_ALU64 | BPF_OR | BPF_X, dst, src, 0, 0)
+#define LDX_W(dst, src, off)	INSN(BPF_LDX | BPF_MEM | BPF_W, dst, src, off, 0)
+#define LDX_DW(dst, src, off)	INSN(BPF_LDX | BPF_MEM | BPF_DW, dst, src, off, 0)
+#define STX_W(dst, src, off)	INSN(BPF_STX | BPF_MEM | BPF_W, dst, src, off, 0)
+#define STX_DW(dst, src, off)	INSN(BPF_STX | BPF_MEM | BPF_DW, dst, src, off, 0)
+#define ST_W(dst, off, imm)	INSN(BPF_ST | BPF_MEM | BPF_W, dst, 0, off, imm)
+#define XADD_DW(dst, src, off)	INSN(BPF_STX | BPF_XADD | BPF_DW, dst, src, off, 0)
+#define JGT_IMM(dst, imm, off)	INSN(BPF_JMP | BPF_JGT | BPF_K, dst, 0, off, imm)
+#define JGE_REG(dst, src, off)	INSN(BPF_JMP | BPF_JGE | BPF_X, dst, src, off, 0)
+#define JEQ_IMM(dst, imm, off)	INSN(BPF_JMP | BPF_JEQ | BPF_K, dst, 0, off, imm)
+#define CALL(func)		INSN(BPF_JMP | BPF_CALL, 0, 0, 0, func)
+#define EXIT()			INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+/* two instruction load of a map fd */
+#define LD_MAP_FD(dst, fd)						\
+	INSN(BPF_LD | BPF_DW | BPF_IMM, dst, BPF_PSEUDO_MAP_FD, 0, fd),	\
+	INSN(0, 0, 0, 0, 0)
+
+/* r0 = lookup(map, key) */
+#define LOOKUP(fd, key)							\
+	ST_W(BPF_REG_10, -4, key),					\
+	MOV64_REG(BPF_REG_2, BPF_REG_10),				\
+	ADD64_IMM(BPF_REG_2, -4),					\
+	LD_MAP_FD(BPF_REG_1, fd),					\
+	CALL(BPF_FUNC_map_lookup_elem)
+
+static int sys_bpf(int cmd, union bpf_attr *attr)
+{
+	return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+static int load_prog(const char *op, const struct bpf_insn *insns,
+		     size_t insn_cnt)
+{
+	static char log_buf[65536];
+	static const char license[] = "GPL";
+	union bpf_attr attr;
+	int fd;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.prog_type = BPF_PROG_TYPE_STRUCT_OPS;
+	attr.insn_cnt = insn_cnt;
+	attr.insns = (unsigned long)insns;
+	attr.license = (unsigned long)license;
+	attr.log_buf = (unsigned long)log_buf;
+	attr.log_size = sizeof(log_buf);
+	attr.log_level = 1;
+	attr.attach_func_name = (unsigned long)op;
+
+	fd = sys_bpf(BPF_PROG_LOAD, &attr);
+	if (fd < 0)
+		error(1, errno, "load %s: %s", op, log_buf);
+	return fd;
+}
+
+static int create_map(enum bpf_map_type type, size_t key_size,
+		      size_t value_size, size_t max_entries)
+{
+	union bpf_attr attr;
+	int fd;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = type;
+	attr.key_size = key_size;
+	attr.value_size = value_size;
+	attr.max_entries = max_entries;
+
+	fd = sys_bpf(BPF_MAP_CREATE, &attr);
+	if (fd < 0)
+		error(1, errno, "map create %d", type);
+	return fd;
+}
+
+static int map_op(int cmd, int fd, uint32_t key, void *value)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = fd;
+	attr.key = (unsigned long)&key;
+	attr.value = (unsigned long)value;
+	attr.flags = BPF_ANY;
+
+	return sys_bpf(cmd, &attr);
+}
+
+static uint64_t read_counter(int cnt_fd, uint32_t idx)
+{
+	uint64_t val;
+
+	if (map_op(BPF_MAP_LOOKUP_ELEM, cnt_fd, idx, &val))
+		error(1, errno, "lookup counter %u", idx);
+	return val;
+}
+
+static void register_ca(int st_fd, int cnt_fd)
+{
+	const struct bpf_insn ssthresh[] = {
+		/* return max(snd_cwnd / 2, 2) */
+		LDX_W(BPF_REG_0, BPF_REG_1, CTX_OFF(snd_cwnd)),
+		RSH64_IMM(BPF_REG_0, 1),
+		JGT_IMM(BPF_REG_0, 2, 1),
+		MOV64_IMM(BPF_REG_0, 2),
+		EXIT(),
+	};
+	const struct bpf_insn undo_cwnd[] = {
+		LDX_W(BPF_REG_0, BPF_REG_1, CTX_OFF(snd_cwnd)),
+		EXIT(),
+	};
+	const struct bpf_insn cong_avoid[] = {
+		/* grow snd_cwnd by one up to snd_cwnd_clamp */
+		MOV64_REG(BPF_REG_6, BPF_REG_1),
+		LDX_W(BPF_REG_2, BPF_REG_6, CTX_OFF(snd_cwnd)),
+		LDX_W(BPF_REG_3, BPF_REG_6, CTX_OFF(snd_cwnd_clamp)),
+		JGE_REG(BPF_REG_2, BPF_REG_3, 2),
+		ADD64_IMM(BPF_REG_2, 1),
+		STX_W(BPF_REG_6, BPF_REG_2, CTX_OFF(snd_cwnd)),
+		/* counters[CNT_CONG_AVOID]++ */
+		LOOKUP(cnt_fd, CNT_CONG_AVOID),
+		JEQ_IMM(BPF_REG_0, 0, 2),
+		MOV64_IMM(BPF_REG_1, 1),
+		XADD_DW(BPF_REG_0, BPF_REG_1, 0),
+		MOV64_IMM(BPF_REG_0, 0),
+		EXIT(),
+	};
+	const struct bpf_insn set_state[] = {
+		/* counters[CNT_SET_STATE_BITS] |= new_state */
+		LDX_W(BPF_REG_6, BPF_REG_1, CTX_OFF(arg1)),
+		LOOKUP(cnt_fd, CNT_SET_STATE_BITS),
+		JEQ_IMM(BPF_REG_0, 0, 3),
+		LDX_DW(BPF_REG_1, BPF_REG_0, 0),
+		OR64_REG(BPF_REG_1, BPF_REG_6),
+		STX_DW(BPF_REG_0, BPF_REG_1, 0),
+		MOV64_IMM(BPF_REG_0, 0),
+		EXIT(),
+	};
+	struct bpf_tcp_congestion_ops ops;
+
+	memset(&ops, 0, sizeof(ops));
+	strcpy(ops.name, CA_NAME);
+	ops.ssthresh = load_prog("ssthresh", ssthresh, ARRAY_SIZE(ssthresh));
+	ops.undo_cwnd = load_prog("undo_cwnd", undo_cwnd,
+				  ARRAY_SIZE(undo_cwnd));
+	ops.cong_avoid = load_prog("cong_avoid", cong_avoid,
+				   ARRAY_SIZE(cong_avoid));
+	ops.set_state = load_prog("set_state", set_state,
+				  ARRAY_SIZE(set_state));
+
+	if (map_op(BPF_MAP_UPDATE_ELEM, st_fd, 0, &ops))
+		error(1, errno, "register " CA_NAME);
+	/* the programs stay loaded through the map */
+	close(ops.ssthresh);
+	close(ops.undo_cwnd);
+	close(ops.cong_avoid);
+	close(ops.set_state);
+
+	if (!map_op(BPF_MAP_UPDATE_ELEM, st_fd, 0, &ops) || errno != EBUSY)
+		error(1, errno, "registered twice");
+}
+
+static void loopback_up(void)
+{
+	struct ifreq ifr;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		error(1, errno, "socket");
+
+	memset(&ifr, 0, sizeof(ifr));
+	strcpy(ifr.ifr_name, "lo");
+	if (ioctl(fd, SIOCGIFFLAGS, &ifr))
+		error(1, errno, "SIOCGIFFLAGS");
+	ifr.ifr_flags |= IFF_UP;
+	if (ioctl(fd, SIOCSIFFLAGS, &ifr))
+		error(1, errno, "SIOCSIFFLAGS");
+	close(fd);
+}
+
+static void check_ca(int fd, const char *expected)
+{
+	char name[TCP_CA_NAME_MAX];
+	socklen_t len = sizeof(name);
+
+	memset(name, 0, sizeof(name));
+	if (getsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, name, &len))
+		error(1, errno, "getsockopt TCP_CONGESTION");
+	if (strcmp(name, expected))
+		error(1, 0, "congestion control %s, expected %s",
+		      name, expected);
+}
+
+static void connect_pair(int *client, int *server)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	int listener;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener < 0)
+		error(1, errno, "socket");
+	if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    getsockname(listener, (struct sockaddr *)&addr, &len) ||
+	    listen(listener, 1))
+		error(1, errno, "listen");
+
+	*client = socket(AF_INET, SOCK_STREAM, 0);
+	if (*client < 0)
+		error(1, errno, "socket");
+	if (setsockopt(*client, IPPROTO_TCP, TCP_CONGESTION, CA_NAME,
+		       strlen(CA_NAME)))
+		error(1, errno, "setsockopt TCP_CONGESTION");
+	if (connect(*client, (struct sockaddr *)&addr, sizeof(addr)))
+		error(1, errno, "connect");
+
+	*server = accept(listener, NULL, NULL);
+	if (*server < 0)
+		error(1, errno, "accept");
+	close(listener);
+}
+
+/* send len bytes from client to server */
+static void transfer(int client, int server, size_t len)
+{
+	static char buf[1 << 16];
+	size_t sent = 0, rcvd = 0;
+	ssize_t ret;
+
+	while (rcvd < len) {
+		if (sent < len) {
+			ret = send(client, buf, sizeof(buf), MSG_DONTWAIT);
+			if (ret < 0 && errno != EAGAIN)
+				error(1, errno, "send");
+			if (ret > 0)
+				sent += ret;
+		}
+		ret = recv(server, buf, sizeof(buf),
+			   sent < len ? MSG_DONTWAIT : 0);
+		if (ret < 0 && errno != EAGAIN)
+			error(1, errno, "recv");
+		if (ret == 0)
+			error(1, 0, "recv: connection closed");
+		if (ret > 0)
+			rcvd += ret;
+	}
+}
+
+static void set_default_ca(const char *name)
+{
+	int fd;
+
+	fd = open("/proc/sys/net/ipv4/tcp_congestion_control", O_WRONLY);
+	if (fd < 0)
+		error(1, errno, "open tcp_congestion_control");
+	if (write(fd, name, strlen(name)) != strlen(name))
+		error(1, errno, "set default congestion control %s", name);
+	close(fd);
+}
+
+/* Every socket created in the namespace pins the default congestion
+ * control, many more of them than a map can count references for.
+ */
+static void test_many_socks(void)
+{
+	struct rlimit rlim = {
+		.rlim_cur = NR_SOCKS + 64,
+		.rlim_max = NR_SOCKS + 64,
+	};
+	int *fds, i;
+
+	if (setrlimit(RLIMIT_NOFILE, &rlim))
+		error(1, errno, "setrlimit");
+
+	fds = calloc(NR_SOCKS, sizeof(*fds));
+	if (!fds)
+		error(1, errno, "calloc");
+
+	set_default_ca(CA_NAME);
+	for (i = 0; i < NR_SOCKS; i++) {
+		fds[i] = socket(AF_INET, SOCK_STREAM, 0);
+		if (fds[i] < 0)
+			error(1, errno, "socket %d", i);
+	}
+	/* falls back to reno if no reference could be taken */
+	check_ca(fds[NR_SOCKS - 1], CA_NAME);
+	set_default_ca("reno");
+
+	for (i = 0; i < NR_SOCKS; i++)
+		close(fds[i]);
+	free(fds);
+}
+
+int main(void)
+{
+	int st_fd, cnt_fd, client, server;
+	uint64_t bits;
+
+	if (unshare(CLONE_NEWNET))
+		error(1, errno, "unshare");
+	loopback_up();
+
+	cnt_fd = create_map(BPF_MAP_TYPE_ARRAY, sizeof(uint32_t),
+			    sizeof(uint64_t), CNT_MAX);
+	st_fd = create_map(BPF_MAP_TYPE_STRUCT_OPS, sizeof(uint32_t),
+			   sizeof(struct bpf_tcp_congestion_ops), 1);
+
+	fprintf(stderr, "register\n");
+	register_ca(st_fd, cnt_fd);
+
+	fprintf(stderr, "transfer\n");
+	connect_pair(&client, &server);
+	check_ca(client, CA_NAME);
+	transfer(client, server, XFER_LEN);
+	if (!read_counter(cnt_fd, CNT_CONG_AVOID))
+		error(1, 0, "cong_avoid did not run");
+	bits = read_counter(cnt_fd, CNT_SET_STATE_BITS);
+	if (bits & ~0xffULL)
+		error(1, 0, "set_state saw bits above its u8: %#llx",
+		      (unsigned long long)bits);
+
+	fprintf(stderr, "many sockets\n");
+	test_many_socks();
+
+	fprintf(stderr, "unregister\n");
+	if (map_op(BPF_MAP_DELETE_ELEM, st_fd, 0, NULL))
+		error(1, errno, "unregister " CA_NAME);
+	if (!map_op(BPF_MAP_DELETE_ELEM, st_fd, 0, NULL) || errno != ENOENT)
+		error(1, errno, "unregistered twice");
+	/* the connection keeps it, the map is released with it */
+	close(st_fd);
+	check_ca(client, CA_NAME);
+	transfer(client, server, XFER_LEN);
+
+	close(client);
+	close(server);
+	close(cnt_fd);
+
+	fprintf(stderr, "SUCCESS\n");
+	return 0;
+}
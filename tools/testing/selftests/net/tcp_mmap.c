@@ -169,14 +169,23 @@ void *child_thread(void *arg)
 			socklen_t zc_len = sizeof(zc);
 			int res;
 
+			memset(&zc, 0, sizeof(zc));
 			zc.address = (__u64)addr;
 			zc.length = chunk_size;
-			zc.recv_skip_hint = 0;
+			zc.copybuf_address = (__u64)buffer;
+			zc.copybuf_len = chunk_size;
 			res = getsockopt(fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE,
 					 &zc, &zc_len);
 			if (res == -1)
 				break;
 
+			/* copybuf holds the bytes before, then after the mapping */
+			assert(zc.copybuf_head <= zc.copybuf_len);
+			if (zc.copybuf_head) {
+				if (xflg)
+					hash_zone(buffer, zc.copybuf_head);
+				total += zc.copybuf_head;
+			}
 			if (zc.length) {
 				assert(zc.length <= chunk_size);
 				total_mmap += zc.length;
@@ -184,6 +193,12 @@ void *child_thread(void *arg)
 					hash_zone(addr, zc.length);
 				total += zc.length;
 			}
+			if (zc.copybuf_len > zc.copybuf_head) {
+				lu = zc.copybuf_len - zc.copybuf_head;
+				if (xflg)
+					hash_zone(buffer + zc.copybuf_head, lu);
+				total += lu;
+			}
 			if (zc.recv_skip_hint) {
 				assert(zc.recv_skip_hint <= chunk_size);
 				lu = read(fd, buffer, zc.recv_skip_hint);
@@ -31,9 +31,14 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#ifndef UDP_GRO
+#define UDP_GRO		104
+#endif
+
 static int  cfg_port		= 8000;
 static bool cfg_tcp;
 static bool cfg_verify;
+static bool cfg_gro;
 
 static bool interrupted;
 static unsigned long packets, bytes;
@@ -89,6 +94,10 @@ static int do_socket(bool do_tcp)
 	if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &val, sizeof(val)))
 		error(1, errno, "setsockopt reuseport");
 
+	if (!do_tcp && cfg_gro &&
+	    setsockopt(fd, IPPROTO_UDP, UDP_GRO, &val, sizeof(val)))
+		error(1, errno, "setsockopt udp gro");
+
 	addr.sin6_family =	PF_INET6;
 	addr.sin6_port =	htons(cfg_port);
 	addr.sin6_addr =	in6addr_any;
@@ -192,15 +201,18 @@ static void do_flush_udp(int fd)
 
 static void usage(const char *filepath)
 {
-	error(1, 0, "Usage: %s [-tv] [-p port]", filepath);
+	error(1, 0, "Usage: %s [-Gtv] [-p port]", filepath);
 }
 
 static void parse_opts(int argc, char **argv)
 {
 	int c;
 
-	while ((c = getopt(argc, argv, "ptv")) != -1) {
+	while ((c = getopt(argc, argv, "Gptv")) != -1) {
 		switch (c) {
+		case 'G':
+			cfg_gro = true;
+			break;
 		case 'p':
 			cfg_port = htons(strtoul(optarg, NULL, 0));
 			break;
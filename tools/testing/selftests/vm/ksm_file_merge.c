@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * With /sys/kernel/mm/ksm/merge_file_pages set, KSM merges identical page
+ * cache pages of MAP_PRIVATE file mappings marked MADV_MERGEABLE.
+ *
+ * Maps two files with the same content, lets ksmd scan them and checks
+ * that every page got merged, that the content is unchanged, and that a
+ * write to one mapping does not show through the other.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../kselftest.h"
+
+#define KSM_SYSFS	"/sys/kernel/mm/ksm/"
+#define NR_PAGES	64
+#define MAX_SCANS	10
+
+static long page_size;
+
+static int ksm_read(const char *name, unsigned long *val)
+{
+	char path[128];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), KSM_SYSFS "%s", name);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	ret = fscanf(f, "%lu", val) == 1 ? 0 : -1;
+	fclose(f);
+	return ret;
+}
+
+static int ksm_write(const char *name, unsigned long val)
+{
+	char path[128];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), KSM_SYSFS "%s", name);
+	f = fopen(path, "w");
+	if (!f)
+		return -1;
+	ret = fprintf(f, "%lu", val) > 0 ? 0 : -1;
+	if (fclose(f))
+		ret = -1;
+	return ret;
+}
+
+static char *map_file(char *tmpl, const char *buf, size_t size)
+{
+	char *map;
+	int fd;
+
+	fd = mkstemp(tmpl);
+	if (fd < 0) {
+		perror("mkstemp");
+		return NULL;
+	}
+	unlink(tmpl);
+	if (write(fd, buf, size) != (ssize_t)size) {
+		perror("write");
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+	if (madvise(map, size, MADV_MERGEABLE)) {
+		perror("madvise");
+		return NULL;
+	}
+	return map;
+}
+
+static int wait_full_scans(int nr)
+{
+	unsigned long start, scans;
+
+	if (ksm_read("full_scans", &start))
+		return -1;
+	do {
+		usleep(100000);
+		if (ksm_read("full_scans", &scans))
+			return -1;
+	} while (scans < start + nr);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long run, merge_file, pages_to_scan, sleep_ms;
+	unsigned long sharing_before, sharing;
+	char tmpl1[] = "./ksm_file_merge.XXXXXX";
+	char tmpl2[] = "./ksm_file_merge.XXXXXX";
+	size_t size, i;
+	char *buf, *map1, *map2;
+	int ret = KSFT_FAIL;
+	volatile char c;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	size = NR_PAGES * page_size;
+
+	if (ksm_read("run", &run) || ksm_read("merge_file_pages", &merge_file) ||
+	    ksm_read("pages_to_scan", &pages_to_scan) ||
+	    ksm_read("sleep_millisecs", &sleep_ms)) {
+		printf("KSM with merge_file_pages not available, skipping\n");
+		return KSFT_SKIP;
+	}
+	if (ksm_write("merge_file_pages", 1) || ksm_write("pages_to_scan", 1000) ||
+	    ksm_write("sleep_millisecs", 0) || ksm_write("run", 1)) {
+		printf("Cannot configure KSM, please run as root\n");
+		ret = KSFT_SKIP;
+		goto restore;
+	}
+
+	buf = malloc(size);
+	if (!buf) {
+		perror("malloc");
+		goto restore;
+	}
+	/* identical across the files, distinct across the pages */
+	srand(getpid());
+	for (i = 0; i < size; i++)
+		buf[i] = rand();
+
+	map1 = map_file(tmpl1, buf, size);
+	map2 = map_file(tmpl2, buf, size);
+	if (!map1 || !map2)
+		goto restore;
+
+	/* read faults map the page cache pages themselves */
+	for (i = 0; i < size; i += page_size)
+		c = map1[i] + map2[i];
+	(void)c;
+
+	if (ksm_read("pages_sharing", &sharing_before) || wait_full_scans(2))
+		goto restore;
+
+	for (i = 0; i < MAX_SCANS; i++) {
+		if (ksm_read("pages_sharing", &sharing))
+			goto restore;
+		if (sharing >= sharing_before + NR_PAGES)
+			break;
+		if (wait_full_scans(1))
+			goto restore;
+	}
+	if (i == MAX_SCANS) {
+		printf("[FAIL]\tpages_sharing grew by %ld, expected %d\n",
+		       (long)(sharing - sharing_before), NR_PAGES);
+		goto restore;
+	}
+
+	if (memcmp(map1, buf, size) || memcmp(map2, buf, size)) {
+		printf("[FAIL]\tmerged content differs from the files\n");
+		goto restore;
+	}
+
+	/* breaking the ksm page must leave the other mapping alone */
+	map1[0] = ~buf[0];
+	if (map2[0] != buf[0] || memcmp(map2, buf, size)) {
+		printf("[FAIL]\twrite went through to the other mapping\n");
+		goto restore;
+	}
+
+	printf("[PASS]\t%d page cache pages merged\n", NR_PAGES);
+	ret = KSFT_PASS;
+
+restore:
+	ksm_write("run", run);
+	ksm_write("sleep_millisecs", sleep_ms);
+	ksm_write("pages_to_scan", pages_to_scan);
+	ksm_write("merge_file_pages", merge_file);
+	return ret;
+}
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KVM dirty ring implementation
+ *
+ * Each vcpu has a ring of dirty gfns, mapped into userspace through the
+ * vcpu fd at KVM_DIRTY_LOG_PAGE_OFFSET. The vcpu pushes the gfns it
+ * dirties; userspace harvests the entries flagged KVM_DIRTY_GFN_F_DIRTY,
+ * flags them KVM_DIRTY_GFN_F_RESET and calls KVM_RESET_DIRTY_RINGS, which
+ * write protects the pages again and gives the entries back to the vcpu.
+ * Unlike KVM_GET_DIRTY_LOG, the cost of a pass depends on the number of
+ * pages dirtied, not on the size of the guest.
+ */
+#include <linux/kvm_host.h>
+#include <linux/kvm.h>
+#include <linux/vmalloc.h>
+#include <linux/kvm_dirty_ring.h>
+
+int __weak kvm_cpu_dirty_log_size(void)
+{
+	return 0;
+}
+
+u32 kvm_dirty_ring_get_rsvd_entries(void)
+{
+	return KVM_DIRTY_RING_RSVD_ENTRIES + kvm_cpu_dirty_log_size();
+}
+
+static u32 kvm_dirty_ring_used(struct kvm_dirty_ring *ring)
+{
+	return READ_ONCE(ring->dirty_index) - READ_ONCE(ring->reset_index);
+}
+
+bool kvm_dirty_ring_soft_full(struct kvm_dirty_ring *ring)
+{
+	return kvm_dirty_ring_used(ring) >= ring->soft_limit;
+}
+
+static bool kvm_dirty_ring_full(struct kvm_dirty_ring *ring)
+{
+	return kvm_dirty_ring_used(ring) >= ring->size;
+}
+
+static void kvm_reset_dirty_gfn(struct kvm *kvm, u32 slot, u64 offset, u64 mask)
+{
+	struct kvm_memory_slot *memslot;
+	int as_id, id;
+
+	as_id = slot >> 16;
+	id = (u16)slot;
+
+	if (as_id >= KVM_ADDRESS_SPACE_NUM || id >= KVM_USER_MEM_SLOTS)
+		return;
+
+	memslot = id_to_memslot(__kvm_memslots(kvm, as_id), id);
+	/* the slot may have gone away since the page was dirtied */
+	if (!memslot->dirty_bitmap || offset + __fls(mask) >= memslot->npages)
+		return;
+
+	spin_lock(&kvm->mmu_lock);
+	kvm_arch_mmu_enable_log_dirty_pt_masked(kvm, memslot, offset, mask);
+	spin_unlock(&kvm->mmu_lock);
+}
+
+int kvm_dirty_ring_alloc(struct kvm_dirty_ring *ring, u32 size)
+{
+	ring->dirty_gfns = vzalloc(size);
+	if (!ring->dirty_gfns)
+		return -ENOMEM;
+
+	ring->size = size / sizeof(struct kvm_dirty_gfn);
+	ring->soft_limit = ring->size - kvm_dirty_ring_get_rsvd_entries();
+	ring->dirty_index = 0;
+	ring->reset_index = 0;
+
+	return 0;
+}
+
+void kvm_dirty_ring_free(struct kvm_dirty_ring *ring)
+{
+	vfree(ring->dirty_gfns);
+	ring->dirty_gfns = NULL;
+}
+
+int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring)
+{
+	u32 cur_slot = 0, next_slot;
+	u64 cur_offset = 0, next_offset;
+	unsigned long mask = 0;
+	int count = 0;
+	struct kvm_dirty_gfn *entry;
+
+	while (true) {
+		entry = &ring->dirty_gfns[ring->reset_index & (ring->size - 1)];
+
+		/* pairs with the release in userspace once it is harvested */
+		if (!(smp_load_acquire(&entry->flags) & KVM_DIRTY_GFN_F_RESET))
+			break;
+
+		next_slot = READ_ONCE(entry->slot);
+		next_offset = READ_ONCE(entry->offset);
+
+		/* hand the entry back to the vcpu */
+		WRITE_ONCE(entry->flags, 0);
+		ring->reset_index++;
+		count++;
+
+		/*
+		 * Pages of one slot tend to be dirtied together; gather the
+		 * neighbours into one mask and write protect them in one go.
+		 */
+		if (mask) {
+			s64 delta = next_offset - cur_offset;
+
+			if (next_slot == cur_slot && delta >= 0 &&
+			    delta < BITS_PER_LONG) {
+				mask |= 1ull << delta;
+				continue;
+			}
+
+			/* the entry belongs before the current base */
+			if (next_slot == cur_slot && delta < 0 &&
+			    __fls(mask) - delta < BITS_PER_LONG) {
+				mask = (mask << -delta) | 1;
+				cur_offset = next_offset;
+				continue;
+			}
+
+			kvm_reset_dirty_gfn(kvm, cur_slot, cur_offset, mask);
+		}
+		cur_slot = next_slot;
+		cur_offset = next_offset;
+		mask = 1;
+	}
+
+	if (mask)
+		kvm_reset_dirty_gfn(kvm, cur_slot, cur_offset, mask);
+
+	return count;
+}
+
+void kvm_dirty_ring_push(struct kvm_dirty_ring *ring, u32 slot, u64 offset)
+{
+	struct kvm_dirty_gfn *entry;
+
+	/* the vcpu exits at the soft limit, the reserve should never run out */
+	if (WARN_ON_ONCE(kvm_dirty_ring_full(ring)))
+		return;
+
+	entry = &ring->dirty_gfns[ring->dirty_index & (ring->size - 1)];
+	entry->slot = slot;
+	entry->offset = offset;
+	/* publish slot and offset before userspace can see the entry */
+	smp_store_release(&entry->flags, KVM_DIRTY_GFN_F_DIRTY);
+	ring->dirty_index++;
+}
+
+struct page *kvm_dirty_ring_get_page(struct kvm_dirty_ring *ring, u32 offset)
+{
+	return vmalloc_to_page((void *)ring->dirty_gfns + offset * PAGE_SIZE);
+}
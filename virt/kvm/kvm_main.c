@@ -51,6 +51,7 @@
 #include <linux/slab.h>
 #include <linux/sort.h>
 #include <linux/bsearch.h>
+#include <linux/log2.h>
 
 #include <asm/processor.h>
 #include <asm/io.h>
@@ -86,6 +87,14 @@ unsigned int halt_poll_ns_shrink;
 module_param(halt_poll_ns_shrink, uint, 0644);
 EXPORT_SYMBOL_GPL(halt_poll_ns_shrink);
 
+/*
+ * Percentage of recent wakeups the per-vcpu poll window should catch.
+ * 0 goes back to growing and shrinking by the factors above.
+ */
+unsigned int halt_poll_ns_cover = 75;
+module_param(halt_poll_ns_cover, uint, 0644);
+EXPORT_SYMBOL_GPL(halt_poll_ns_cover);
+
 /*
  * Ordering of locks:
  *
@@ -105,6 +114,9 @@ EXPORT_SYMBOL_GPL(kvm_vcpu_cache);
 
 static __read_mostly struct preempt_ops kvm_preempt_ops;
 
+/* the vcpu loaded on this cpu, if any; the dirty ring goes by it */
+static DEFINE_PER_CPU(struct kvm_vcpu *, kvm_running_vcpu);
+
 struct dentry *kvm_debugfs_dir;
 EXPORT_SYMBOL_GPL(kvm_debugfs_dir);
 
@@ -127,7 +139,8 @@ static void hardware_disable_all(void);
 
 static void kvm_io_bus_destroy(struct kvm_io_bus *bus);
 
-static void mark_page_dirty_in_slot(struct kvm_memory_slot *memslot, gfn_t gfn);
+static void mark_page_dirty_in_slot(struct kvm *kvm,
+				    struct kvm_memory_slot *memslot, gfn_t gfn);
 
 __visible bool kvm_rebooting;
 EXPORT_SYMBOL_GPL(kvm_rebooting);
@@ -160,6 +173,8 @@ bool kvm_is_reserved_pfn(kvm_pfn_t pfn)
 void vcpu_load(struct kvm_vcpu *vcpu)
 {
 	int cpu = get_cpu();
+
+	__this_cpu_write(kvm_running_vcpu, vcpu);
 	preempt_notifier_register(&vcpu->preempt_notifier);
 	kvm_arch_vcpu_load(vcpu, cpu);
 	put_cpu();
@@ -171,6 +186,7 @@ void vcpu_put(struct kvm_vcpu *vcpu)
 	preempt_disable();
 	kvm_arch_vcpu_put(vcpu);
 	preempt_notifier_unregister(&vcpu->preempt_notifier);
+	__this_cpu_write(kvm_running_vcpu, NULL);
 	preempt_enable();
 }
 EXPORT_SYMBOL_GPL(vcpu_put);
@@ -312,11 +328,20 @@ int kvm_vcpu_init(struct kvm_vcpu *vcpu, struct kvm *kvm, unsigned id)
 	kvm_vcpu_set_dy_eligible(vcpu, false);
 	vcpu->preempted = false;
 
+	if (kvm->dirty_ring_size) {
+		r = kvm_dirty_ring_alloc(&vcpu->dirty_ring,
+					 kvm->dirty_ring_size);
+		if (r)
+			goto fail_free_run;
+	}
+
 	r = kvm_arch_vcpu_init(vcpu);
 	if (r < 0)
-		goto fail_free_run;
+		goto fail_free_ring;
 	return 0;
 
+fail_free_ring:
+	kvm_dirty_ring_free(&vcpu->dirty_ring);
 fail_free_run:
 	free_page((unsigned long)vcpu->run);
 fail:
@@ -333,6 +358,7 @@ void kvm_vcpu_uninit(struct kvm_vcpu *vcpu)
 	 */
 	put_pid(rcu_dereference_protected(vcpu->pid, 1));
 	kvm_arch_vcpu_uninit(vcpu);
+	kvm_dirty_ring_free(&vcpu->dirty_ring);
 	free_page((unsigned long)vcpu->run);
 }
 EXPORT_SYMBOL_GPL(kvm_vcpu_uninit);
@@ -748,8 +774,11 @@ static void kvm_destroy_vm(struct kvm *kvm)
 #endif
 	kvm_arch_destroy_vm(kvm);
 	kvm_destroy_devices(kvm);
-	for (i = 0; i < KVM_ADDRESS_SPACE_NUM; i++)
+	for (i = 0; i < KVM_ADDRESS_SPACE_NUM; i++) {
 		kvm_free_memslots(kvm, __kvm_memslots(kvm, i));
+		/* the memory of its slots went with the live copy */
+		kvfree(kvm->memslots_spare[i]);
+	}
 	cleanup_srcu_struct(&kvm->irq_srcu);
 	cleanup_srcu_struct(&kvm->srcu);
 	kvm_arch_free_vm(kvm);
@@ -904,6 +933,25 @@ static struct kvm_memslots *install_new_memslots(struct kvm *kvm,
 	return old_memslots;
 }
 
+/*
+ * Return the copy of the memslots of @as_id not in use, to apply an update
+ * to before installing it.  The first update pays for the copy.
+ */
+static struct kvm_memslots *kvm_get_spare_memslots(struct kvm *kvm, int as_id)
+{
+	struct kvm_memslots *slots = kvm->memslots_spare[as_id];
+
+	if (slots)
+		return slots;
+
+	slots = kvmalloc(sizeof(struct kvm_memslots), GFP_KERNEL);
+	if (!slots)
+		return NULL;
+	memcpy(slots, __kvm_memslots(kvm, as_id), sizeof(struct kvm_memslots));
+	kvm->memslots_spare[as_id] = slots;
+	return slots;
+}
+
 /*
  * Allocate some memory and give it an address in the guest physical address
  * space.
@@ -959,6 +1007,7 @@ int __kvm_set_memory_region(struct kvm *kvm,
 	new = old = *slot;
 
 	new.id = id;
+	new.as_id = as_id;
 	new.base_gfn = base_gfn;
 	new.npages = npages;
 	new.flags = mem->flags;
@@ -1020,16 +1069,16 @@ int __kvm_set_memory_region(struct kvm *kvm,
 			goto out_free;
 	}
 
-	slots = kvzalloc(sizeof(struct kvm_memslots), GFP_KERNEL);
+	slots = kvm_get_spare_memslots(kvm, as_id);
 	if (!slots)
 		goto out_free;
-	memcpy(slots, __kvm_memslots(kvm, as_id), sizeof(struct kvm_memslots));
 
 	if ((change == KVM_MR_DELETE) || (change == KVM_MR_MOVE)) {
 		slot = id_to_memslot(slots, id);
 		slot->flags |= KVM_MEMSLOT_INVALID;
 
 		old_memslots = install_new_memslots(kvm, as_id, slots);
+		kvm->memslots_spare[as_id] = old_memslots;
 
 		/* From this point no new shadow pages pointing to a deleted,
 		 * or moved, memslot will be created.
@@ -1061,14 +1110,25 @@ int __kvm_set_memory_region(struct kvm *kvm,
 	update_memslots(slots, &new, change);
 	old_memslots = install_new_memslots(kvm, as_id, slots);
 
+	/*
+	 * Nobody looks at the old copy any more: apply the same change to
+	 * it, which also drops the invalid flag, and keep it for next time.
+	 */
+	update_memslots(old_memslots, &new, change);
+	kvm->memslots_spare[as_id] = old_memslots;
+
 	kvm_arch_commit_memory_region(kvm, mem, &old, &new, change);
 
 	kvm_free_memslot(kvm, &old, &new);
-	kvfree(old_memslots);
 	return 0;
 
 out_slots:
-	kvfree(slots);
+	if ((change == KVM_MR_DELETE) || (change == KVM_MR_MOVE)) {
+		/* put back the copy without the invalid flag */
+		old_memslots = install_new_memslots(kvm, as_id, slots);
+		id_to_memslot(old_memslots, id)->flags &= ~KVM_MEMSLOT_INVALID;
+		kvm->memslots_spare[as_id] = old_memslots;
+	}
 out_free:
 	kvm_free_memslot(kvm, &new, &old);
 out:
@@ -1228,7 +1288,8 @@ EXPORT_SYMBOL_GPL(gfn_to_memslot);
 
 struct kvm_memory_slot *kvm_vcpu_gfn_to_memslot(struct kvm_vcpu *vcpu, gfn_t gfn)
 {
-	return __gfn_to_memslot(kvm_vcpu_memslots(vcpu), gfn);
+	return __search_memslots(kvm_vcpu_memslots(vcpu), gfn,
+				 &vcpu->last_used_slot);
 }
 
 bool kvm_is_visible_gfn(struct kvm *kvm, gfn_t gfn)
@@ -1843,7 +1904,8 @@ int kvm_vcpu_read_guest_atomic(struct kvm_vcpu *vcpu, gpa_t gpa,
 }
 EXPORT_SYMBOL_GPL(kvm_vcpu_read_guest_atomic);
 
-static int __kvm_write_guest_page(struct kvm_memory_slot *memslot, gfn_t gfn,
+static int __kvm_write_guest_page(struct kvm *kvm,
+				  struct kvm_memory_slot *memslot, gfn_t gfn,
 			          const void *data, int offset, int len)
 {
 	int r;
@@ -1855,7 +1917,7 @@ static int __kvm_write_guest_page(struct kvm_memory_slot *memslot, gfn_t gfn,
 	r = __copy_to_user((void __user *)addr + offset, data, len);
 	if (r)
 		return -EFAULT;
-	mark_page_dirty_in_slot(memslot, gfn);
+	mark_page_dirty_in_slot(kvm, memslot, gfn);
 	return 0;
 }
 
@@ -1864,7 +1926,7 @@ int kvm_write_guest_page(struct kvm *kvm, gfn_t gfn,
 {
 	struct kvm_memory_slot *slot = gfn_to_memslot(kvm, gfn);
 
-	return __kvm_write_guest_page(slot, gfn, data, offset, len);
+	return __kvm_write_guest_page(kvm, slot, gfn, data, offset, len);
 }
 EXPORT_SYMBOL_GPL(kvm_write_guest_page);
 
@@ -1873,7 +1935,7 @@ int kvm_vcpu_write_guest_page(struct kvm_vcpu *vcpu, gfn_t gfn,
 {
 	struct kvm_memory_slot *slot = kvm_vcpu_gfn_to_memslot(vcpu, gfn);
 
-	return __kvm_write_guest_page(slot, gfn, data, offset, len);
+	return __kvm_write_guest_page(vcpu->kvm, slot, gfn, data, offset, len);
 }
 EXPORT_SYMBOL_GPL(kvm_vcpu_write_guest_page);
 
@@ -1985,7 +2047,7 @@ int kvm_write_guest_offset_cached(struct kvm *kvm, struct gfn_to_hva_cache *ghc,
 	r = __copy_to_user((void __user *)ghc->hva + offset, data, len);
 	if (r)
 		return -EFAULT;
-	mark_page_dirty_in_slot(ghc->memslot, gpa >> PAGE_SHIFT);
+	mark_page_dirty_in_slot(kvm, ghc->memslot, gpa >> PAGE_SHIFT);
 
 	return 0;
 }
@@ -2050,13 +2112,29 @@ int kvm_clear_guest(struct kvm *kvm, gpa_t gpa, unsigned long len)
 }
 EXPORT_SYMBOL_GPL(kvm_clear_guest);
 
-static void mark_page_dirty_in_slot(struct kvm_memory_slot *memslot,
+static void mark_page_dirty_in_slot(struct kvm *kvm,
+				    struct kvm_memory_slot *memslot,
 				    gfn_t gfn)
 {
 	if (memslot && memslot->dirty_bitmap) {
 		unsigned long rel_gfn = gfn - memslot->base_gfn;
+		struct kvm_vcpu *vcpu;
 
-		set_bit_le(rel_gfn, memslot->dirty_bitmap);
+		/*
+		 * With the dirty ring, the page goes to the ring of the
+		 * vcpu dirtying it.  Pages written outside of vcpu context,
+		 * or by a vcpu of another VM, still end up in the bitmap and
+		 * in KVM_GET_DIRTY_LOG.
+		 */
+		preempt_disable();
+		vcpu = __this_cpu_read(kvm_running_vcpu);
+		if (vcpu && vcpu->kvm == kvm && kvm->dirty_ring_size)
+			kvm_dirty_ring_push(&vcpu->dirty_ring,
+					    (memslot->as_id << 16) | memslot->id,
+					    rel_gfn);
+		else
+			set_bit_le(rel_gfn, memslot->dirty_bitmap);
+		preempt_enable();
 	}
 }
 
@@ -2065,7 +2143,7 @@ void mark_page_dirty(struct kvm *kvm, gfn_t gfn)
 	struct kvm_memory_slot *memslot;
 
 	memslot = gfn_to_memslot(kvm, gfn);
-	mark_page_dirty_in_slot(memslot, gfn);
+	mark_page_dirty_in_slot(kvm, memslot, gfn);
 }
 EXPORT_SYMBOL_GPL(mark_page_dirty);
 
@@ -2074,7 +2152,7 @@ void kvm_vcpu_mark_page_dirty(struct kvm_vcpu *vcpu, gfn_t gfn)
 	struct kvm_memory_slot *memslot;
 
 	memslot = kvm_vcpu_gfn_to_memslot(vcpu, gfn);
-	mark_page_dirty_in_slot(memslot, gfn);
+	mark_page_dirty_in_slot(vcpu->kvm, memslot, gfn);
 }
 EXPORT_SYMBOL_GPL(kvm_vcpu_mark_page_dirty);
 
@@ -2101,7 +2179,14 @@ void kvm_sigset_deactivate(struct kvm_vcpu *vcpu)
 	sigemptyset(&current->real_blocked);
 }
 
-static void grow_halt_poll_ns(struct kvm_vcpu *vcpu)
+static unsigned int kvm_max_halt_poll_ns(struct kvm *kvm)
+{
+	if (READ_ONCE(kvm->override_halt_poll_ns))
+		return READ_ONCE(kvm->max_halt_poll_ns);
+	return READ_ONCE(halt_poll_ns);
+}
+
+static void grow_halt_poll_ns(struct kvm_vcpu *vcpu, unsigned int max)
 {
 	unsigned int old, val, grow;
 
@@ -2113,8 +2198,8 @@ static void grow_halt_poll_ns(struct kvm_vcpu *vcpu)
 	else
 		val *= grow;
 
-	if (val > halt_poll_ns)
-		val = halt_poll_ns;
+	if (val > max)
+		val = max;
 
 	vcpu->halt_poll_ns = val;
 	trace_kvm_halt_poll_ns_grow(vcpu->vcpu_id, val, old);
@@ -2135,6 +2220,61 @@ static void shrink_halt_poll_ns(struct kvm_vcpu *vcpu)
 	trace_kvm_halt_poll_ns_shrink(vcpu->vcpu_id, val, old);
 }
 
+/* halve the counts every so many blocks, so the histogram follows the guest */
+#define KVM_HALT_HIST_DECAY		64
+/* a contended poll halves the next window, up to this many times */
+#define KVM_HALT_POLL_CONTENDED_MAX	4
+
+/*
+ * Record a block of @block_ns, and poll next time as long as it takes to
+ * catch @cover percent of the recent wakeups, if that fits in @max.  A
+ * guest that mostly sleeps for long does not poll at all.
+ */
+static void kvm_vcpu_update_halt_poll(struct kvm_vcpu *vcpu, u64 block_ns,
+				      unsigned int max, unsigned int cover)
+{
+	u16 *count = vcpu->halt_hist.count;
+	unsigned int old = vcpu->halt_poll_ns, val = 0;
+	u32 total = 0, sum = 0;
+	int i, b;
+
+	/* a wakeup the guest did not ask for is no reason to poll */
+	if (!vcpu_valid_wakeup(vcpu) || block_ns >> 11 >= 1ULL << 32)
+		b = KVM_HALT_HIST_BUCKETS - 1;
+	else if (block_ns < KVM_HALT_HIST_BOUND(0))
+		b = 0;
+	else
+		b = min(ilog2((u32)(block_ns >> 11)) + 1,
+			KVM_HALT_HIST_BUCKETS - 1);
+
+	count[b]++;
+	if (++vcpu->halt_hist.samples >= KVM_HALT_HIST_DECAY) {
+		vcpu->halt_hist.samples = 0;
+		for (i = 0; i < KVM_HALT_HIST_BUCKETS; i++)
+			count[i] >>= 1;
+	}
+
+	for (i = 0; i < KVM_HALT_HIST_BUCKETS; i++)
+		total += count[i];
+
+	cover = min(cover, 100U);
+	for (i = 0; i < KVM_HALT_HIST_BUCKETS - 1; i++) {
+		if (KVM_HALT_HIST_BOUND(i) > max)
+			break;
+		sum += count[i];
+		if (sum * 100 >= total * cover) {
+			val = KVM_HALT_HIST_BOUND(i) >> vcpu->halt_hist.contended;
+			break;
+		}
+	}
+
+	vcpu->halt_poll_ns = val;
+	if (val > old)
+		trace_kvm_halt_poll_ns_grow(vcpu->vcpu_id, val, old);
+	else if (val < old)
+		trace_kvm_halt_poll_ns_shrink(vcpu->vcpu_id, val, old);
+}
+
 static int kvm_vcpu_check_block(struct kvm_vcpu *vcpu)
 {
 	int ret = -EINTR;
@@ -2163,6 +2303,7 @@ void kvm_vcpu_block(struct kvm_vcpu *vcpu)
 	ktime_t start, cur;
 	DECLARE_SWAITQUEUE(wait);
 	bool waited = false;
+	unsigned int max, cover;
 	u64 block_ns;
 
 	start = cur = ktime_get();
@@ -2179,10 +2320,19 @@ void kvm_vcpu_block(struct kvm_vcpu *vcpu)
 				++vcpu->stat.halt_successful_poll;
 				if (!vcpu_valid_wakeup(vcpu))
 					++vcpu->stat.halt_poll_invalid;
+				vcpu->halt_hist.contended = 0;
 				goto out;
 			}
 			cur = ktime_get();
 		} while (single_task_running() && ktime_before(cur, stop));
+
+		/* another task wants this cpu, leave it sooner next time */
+		if (!single_task_running()) {
+			if (vcpu->halt_hist.contended < KVM_HALT_POLL_CONTENDED_MAX)
+				vcpu->halt_hist.contended++;
+		} else {
+			vcpu->halt_hist.contended = 0;
+		}
 	}
 
 	kvm_arch_vcpu_blocking(vcpu);
@@ -2203,19 +2353,22 @@ void kvm_vcpu_block(struct kvm_vcpu *vcpu)
 	kvm_arch_vcpu_unblocking(vcpu);
 out:
 	block_ns = ktime_to_ns(cur) - ktime_to_ns(start);
+	max = kvm_max_halt_poll_ns(vcpu->kvm);
+	cover = READ_ONCE(halt_poll_ns_cover);
 
-	if (!vcpu_valid_wakeup(vcpu))
+	if (max && cover)
+		kvm_vcpu_update_halt_poll(vcpu, block_ns, max, cover);
+	else if (!vcpu_valid_wakeup(vcpu))
 		shrink_halt_poll_ns(vcpu);
-	else if (halt_poll_ns) {
+	else if (max) {
 		if (block_ns <= vcpu->halt_poll_ns)
 			;
 		/* we had a long block, shrink polling */
-		else if (vcpu->halt_poll_ns && block_ns > halt_poll_ns)
+		else if (vcpu->halt_poll_ns && block_ns > max)
 			shrink_halt_poll_ns(vcpu);
 		/* we had a short halt and our poll time is too small */
-		else if (vcpu->halt_poll_ns < halt_poll_ns &&
-			block_ns < halt_poll_ns)
-			grow_halt_poll_ns(vcpu);
+		else if (vcpu->halt_poll_ns < max && block_ns < max)
+			grow_halt_poll_ns(vcpu, max);
 	} else
 		vcpu->halt_poll_ns = 0;
 
@@ -2388,6 +2541,9 @@ static vm_fault_t kvm_vcpu_fault(struct vm_fault *vmf)
 	else if (vmf->pgoff == KVM_COALESCED_MMIO_PAGE_OFFSET)
 		page = virt_to_page(vcpu->kvm->coalesced_mmio_ring);
 #endif
+	else if (kvm_page_in_dirty_ring(vcpu->kvm, vmf->pgoff))
+		page = kvm_dirty_ring_get_page(&vcpu->dirty_ring,
+				vmf->pgoff - KVM_DIRTY_LOG_PAGE_OFFSET);
 	else
 		return kvm_arch_vcpu_fault(vcpu, vmf);
 	get_page(page);
@@ -2401,6 +2557,15 @@ static const struct vm_operations_struct kvm_vcpu_vm_ops = {
 
 static int kvm_vcpu_mmap(struct file *file, struct vm_area_struct *vma)
 {
+	struct kvm_vcpu *vcpu = file->private_data;
+	unsigned long pages = vma_pages(vma);
+
+	/* the dirty ring is shared with KVM, a private copy is of no use */
+	if ((kvm_page_in_dirty_ring(vcpu->kvm, vma->vm_pgoff) ||
+	     kvm_page_in_dirty_ring(vcpu->kvm, vma->vm_pgoff + pages - 1)) &&
+	    ((vma->vm_flags & VM_EXEC) || !(vma->vm_flags & VM_SHARED)))
+		return -EINVAL;
+
 	vma->vm_ops = &kvm_vcpu_vm_ops;
 	return 0;
 }
@@ -2965,12 +3130,85 @@ static long kvm_vm_ioctl_check_extension_generic(struct kvm *kvm, long arg)
 #endif
 	case KVM_CAP_MAX_VCPU_ID:
 		return KVM_MAX_VCPU_ID;
+#ifdef CONFIG_HAVE_KVM_DIRTY_RING
+	case KVM_CAP_DIRTY_LOG_RING:
+		return KVM_DIRTY_RING_MAX_ENTRIES * sizeof(struct kvm_dirty_gfn);
+#endif
+	case KVM_CAP_HALT_POLL:
+		return 1;
 	default:
 		break;
 	}
 	return kvm_vm_ioctl_check_extension(kvm, arg);
 }
 
+#ifdef CONFIG_HAVE_KVM_DIRTY_RING
+static int kvm_vm_ioctl_enable_dirty_log_ring(struct kvm *kvm, u32 size)
+{
+	int r;
+
+	/* a power of two of pages, leaving room above the reserve */
+	if (size < PAGE_SIZE || !is_power_of_2(size))
+		return -EINVAL;
+	if (size / sizeof(struct kvm_dirty_gfn) <=
+	    kvm_dirty_ring_get_rsvd_entries() ||
+	    size > KVM_DIRTY_RING_MAX_ENTRIES * sizeof(struct kvm_dirty_gfn))
+		return -EINVAL;
+
+	mutex_lock(&kvm->lock);
+	/* the rings are allocated along with the vcpus */
+	if (kvm->created_vcpus || kvm->dirty_ring_size)
+		r = -EINVAL;
+	else {
+		kvm->dirty_ring_size = size;
+		r = 0;
+	}
+	mutex_unlock(&kvm->lock);
+	return r;
+}
+
+static int kvm_vm_ioctl_reset_dirty_pages(struct kvm *kvm)
+{
+	struct kvm_vcpu *vcpu;
+	int i, cleared = 0;
+
+	if (!kvm->dirty_ring_size)
+		return -EINVAL;
+
+	mutex_lock(&kvm->slots_lock);
+	kvm_for_each_vcpu(i, vcpu, kvm)
+		cleared += kvm_dirty_ring_reset(kvm, &vcpu->dirty_ring);
+	mutex_unlock(&kvm->slots_lock);
+
+	if (cleared)
+		kvm_flush_remote_tlbs(kvm);
+
+	return cleared;
+}
+#endif
+
+static int kvm_vm_ioctl_enable_cap_generic(struct kvm *kvm,
+					   struct kvm_enable_cap *cap)
+{
+	if (cap->flags)
+		return -EINVAL;
+
+	switch (cap->cap) {
+#ifdef CONFIG_HAVE_KVM_DIRTY_RING
+	case KVM_CAP_DIRTY_LOG_RING:
+		return kvm_vm_ioctl_enable_dirty_log_ring(kvm, cap->args[0]);
+#endif
+	case KVM_CAP_HALT_POLL:
+		if (cap->args[0] != (unsigned int)cap->args[0])
+			return -EINVAL;
+		WRITE_ONCE(kvm->max_halt_poll_ns, cap->args[0]);
+		WRITE_ONCE(kvm->override_halt_poll_ns, true);
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
 static long kvm_vm_ioctl(struct file *filp,
 			   unsigned int ioctl, unsigned long arg)
 {
@@ -3004,6 +3242,26 @@ static long kvm_vm_ioctl(struct file *filp,
 		r = kvm_vm_ioctl_get_dirty_log(kvm, &log);
 		break;
 	}
+	case KVM_ENABLE_CAP: {
+		struct kvm_enable_cap cap;
+
+		r = -EFAULT;
+		if (copy_from_user(&cap, argp, sizeof(cap)))
+			goto out;
+		/* the other capabilities are up to the architecture */
+		if (cap.cap != KVM_CAP_DIRTY_LOG_RING &&
+		    cap.cap != KVM_CAP_HALT_POLL) {
+			r = kvm_arch_vm_ioctl(filp, ioctl, arg);
+			break;
+		}
+		r = kvm_vm_ioctl_enable_cap_generic(kvm, &cap);
+		break;
+	}
+#ifdef CONFIG_HAVE_KVM_DIRTY_RING
+	case KVM_RESET_DIRTY_RINGS:
+		r = kvm_vm_ioctl_reset_dirty_pages(kvm);
+		break;
+#endif
 #ifdef CONFIG_KVM_MMIO
 	case KVM_REGISTER_COALESCED_MMIO: {
 		struct kvm_coalesced_mmio_zone zone;
@@ -3978,6 +4236,7 @@ static void kvm_sched_in(struct preempt_notifier *pn, int cpu)
 	if (vcpu->preempted)
 		vcpu->preempted = false;
 
+	__this_cpu_write(kvm_running_vcpu, vcpu);
 	kvm_arch_sched_in(vcpu, cpu);
 
 	kvm_arch_vcpu_load(vcpu, cpu);
@@ -3991,6 +4250,7 @@ static void kvm_sched_out(struct preempt_notifier *pn,
 	if (current->state == TASK_RUNNING)
 		vcpu->preempted = true;
 	kvm_arch_vcpu_put(vcpu);
+	__this_cpu_write(kvm_running_vcpu, NULL);
 }
 
 int kvm_init(void *opaque, unsigned vcpu_size, unsigned vcpu_align,